@@ -0,0 +1,264 @@
+#ifndef __BENCH_HARNESS_H__
+#define __BENCH_HARNESS_H__
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../src/CycleCounter.h"
+
+// Keeps the compiler from discarding a value a benchmark computes but never uses.
+template <typename T>
+inline void benchKeep(const T& value) {
+    asm volatile("" : : "g"(&value) : "memory");
+}
+
+// Microbenchmark runner. Every iteration is timed on its own with the cycle counter, so a
+// benchmark can do untimed preparation in between (advancing simulated time, staging a sample);
+// the cost of reading the counter itself is measured once and subtracted. Each benchmark reports
+// min / median / p90 / p99 / mean cycles, as a table and as JSON.
+//
+// Baselines are the JSON of an earlier run. A benchmark whose median exceeds its baseline by more
+// than the threshold (percent, per benchmark or the default) and by more than SLACK_NS is a
+// regression; the slack keeps nanosecond-scale benchmarks from failing on timer noise.
+//
+// Figures that aren't a time per iteration (throughput, compression ratio, estimation error) are
+// reported with metric(); they are printed and written to the JSON but not compared.
+class BenchRunner {
+public:
+    static constexpr size_t MAX_BENCHES    = 48;
+    static constexpr size_t MAX_METRICS    = 32;
+    static constexpr size_t MAX_ITERATIONS = 4096;
+    static constexpr size_t NAME_LENGTH    = 32;
+    static constexpr double SLACK_NS       = 20.0;
+
+    struct Result {
+        char name[NAME_LENGTH];
+        uint32_t iterations;
+        uint32_t minCycles;
+        uint32_t medianCycles;
+        uint32_t p90Cycles;
+        uint32_t p99Cycles;
+        double meanCycles;
+        bool hasBaseline;
+        double baselineNs;      // baseline median
+        double thresholdPct;
+        bool regressed;
+    };
+
+    struct Metric {
+        char name[NAME_LENGTH];
+        double value;
+        const char* unit;
+    };
+
+    BenchRunner() : count(0), metricCount(0), overheadCycles(0), scale(1.0), defaultThresholdPct(25.0), filter(nullptr) {}
+
+    void setFilter(const char* substring) { filter = substring; }
+    void setScale(double s) { scale = s > 0 ? s : 1.0; }
+    void setDefaultThreshold(double pct) { defaultThresholdPct = pct; }
+
+    // Median cost of back-to-back counter reads, subtracted from every sample.
+    void calibrate() {
+        for (size_t i = 0; i < MAX_ITERATIONS; i++) {
+            uint32_t start = CycleCounter::now();
+            samples[i] = CycleCounter::now() - start;
+        }
+        qsort(samples, MAX_ITERATIONS, sizeof(samples[0]), compare);
+        overheadCycles = samples[MAX_ITERATIONS / 2];
+    }
+
+    template <typename Prep, typename Body>
+    void run(const char* name, uint32_t iterations, Prep prep, Body body) {
+        if (filter && !strstr(name, filter)) return;
+        if (count >= MAX_BENCHES) return;
+        uint32_t n = (uint32_t)(iterations * scale);
+        if (n < 1) n = 1;
+        if (n > MAX_ITERATIONS) n = MAX_ITERATIONS;
+
+        for (uint32_t i = 0; i < n / 10 + 1; i++) { // warm caches and branch predictors
+            prep();
+            body();
+        }
+        double total = 0;
+        for (uint32_t i = 0; i < n; i++) {
+            prep();
+            uint32_t start = CycleCounter::now();
+            body();
+            uint32_t cycles = CycleCounter::now() - start;
+            samples[i] = cycles > overheadCycles ? cycles - overheadCycles : 0;
+            total += samples[i];
+        }
+        qsort(samples, n, sizeof(samples[0]), compare);
+
+        Result& r = results[count++];
+        snprintf(r.name, sizeof(r.name), "%s", name);
+        r.iterations = n;
+        r.minCycles = samples[0];
+        r.medianCycles = samples[n / 2];
+        r.p90Cycles = samples[(size_t)(n * 0.90)];
+        r.p99Cycles = samples[(size_t)(n * 0.99)];
+        r.meanCycles = total / n;
+        r.hasBaseline = false;
+        r.baselineNs = 0;
+        r.thresholdPct = defaultThresholdPct;
+        r.regressed = false;
+    }
+
+    template <typename Body>
+    void run(const char* name, uint32_t iterations, Body body) {
+        run(name, iterations, [] {}, body);
+    }
+
+    // True if a benchmark or metric of this name would run under the filter.
+    bool selected(const char* name) const { return !filter || strstr(name, filter); }
+
+    // The result of a benchmark run earlier, or nullptr (filtered out, or never run).
+    const Result* result(const char* name) const {
+        for (size_t i = 0; i < count; i++) {
+            if (strcmp(results[i].name, name) == 0) return &results[i];
+        }
+        return nullptr;
+    }
+
+    // Mean time per iteration of an earlier benchmark, 0 if it didn't run.
+    double meanNs(const char* name) const {
+        const Result* r = result(name);
+        return r ? CycleCounter::toNs((uint32_t)r->meanCycles) : 0;
+    }
+
+    void metric(const char* name, double value, const char* unit) {
+        if (!selected(name) || metricCount >= MAX_METRICS) return;
+        Metric& m = metrics[metricCount++];
+        snprintf(m.name, sizeof(m.name), "%s", name);
+        m.value = value;
+        m.unit = unit;
+    }
+
+    // Reads medians (and per-benchmark thresholds) from a previous writeJson(); returns how many
+    // benchmarks of this run it has a baseline for.
+    size_t compareWithBaseline(const char* path) {
+        FILE* fp = fopen(path, "r");
+        if (!fp) return 0;
+        size_t matched = 0;
+        char line[512];
+        while (fgets(line, sizeof(line), fp)) {
+            char name[NAME_LENGTH];
+            double medianNs, thresholdPct = defaultThresholdPct;
+            if (!readString(line, "\"name\"", name, sizeof(name)) || !readNumber(line, "\"median_ns\"", medianNs)) continue;
+            readNumber(line, "\"threshold_pct\"", thresholdPct);
+            Result* r = find(name);
+            if (!r) continue;
+            r->hasBaseline = true;
+            r->baselineNs = medianNs;
+            r->thresholdPct = thresholdPct;
+            double nowNs = CycleCounter::toNs(r->medianCycles);
+            r->regressed = nowNs > medianNs * (1.0 + thresholdPct / 100.0) && nowNs - medianNs > SLACK_NS;
+            matched++;
+        }
+        fclose(fp);
+        return matched;
+    }
+
+    size_t regressions() const {
+        size_t n = 0;
+        for (size_t i = 0; i < count; i++) n += results[i].regressed ? 1 : 0;
+        return n;
+    }
+
+    void printTable(FILE* out) const {
+        fprintf(out, "%-20s %7s %9s %9s %9s %9s %10s %11s\n", "benchmark", "iters", "min", "median", "p90", "p99",
+                "median ns", "vs baseline");
+        for (size_t i = 0; i < count; i++) {
+            const Result& r = results[i];
+            double ns = CycleCounter::toNs(r.medianCycles);
+            fprintf(out, "%-20s %7u %9u %9u %9u %9u %10.1f", r.name, r.iterations, r.minCycles, r.medianCycles,
+                    r.p90Cycles, r.p99Cycles, ns);
+            if (r.hasBaseline) {
+                fprintf(out, " %+10.1f%%%s", (ns / r.baselineNs - 1.0) * 100.0, r.regressed ? "  REGRESSION" : "");
+            }
+            fprintf(out, "\n");
+        }
+        fprintf(out, "cycle counter: %lu Hz, %u cycles read overhead subtracted\n", (unsigned long)CycleCounter::hz(),
+                overheadCycles);
+        if (metricCount > 0) fprintf(out, "\n%-32s %14s\n", "metric", "value");
+        for (size_t i = 0; i < metricCount; i++) {
+            fprintf(out, "%-32s %14.3f %s\n", metrics[i].name, metrics[i].value, metrics[i].unit);
+        }
+    }
+
+    // One benchmark per line, so a baseline can be read back without a JSON parser.
+    void writeJson(FILE* out) const {
+        fprintf(out, "{\n  \"cycle_hz\": %lu,\n  \"overhead_cycles\": %u,\n  \"benchmarks\": [\n",
+                (unsigned long)CycleCounter::hz(), overheadCycles);
+        for (size_t i = 0; i < count; i++) {
+            const Result& r = results[i];
+            fprintf(out,
+                    "    {\"name\": \"%s\", \"iterations\": %u, \"min_cycles\": %u, \"median_cycles\": %u, "
+                    "\"p90_cycles\": %u, \"p99_cycles\": %u, \"mean_cycles\": %.1f, \"median_ns\": %.1f, "
+                    "\"threshold_pct\": %.0f",
+                    r.name, r.iterations, r.minCycles, r.medianCycles, r.p90Cycles, r.p99Cycles, r.meanCycles,
+                    CycleCounter::toNs(r.medianCycles), r.thresholdPct);
+            if (r.hasBaseline) {
+                fprintf(out, ", \"baseline_ns\": %.1f, \"regressed\": %s", r.baselineNs, r.regressed ? "true" : "false");
+            }
+            fprintf(out, "}%s\n", i + 1 < count ? "," : "");
+        }
+        fprintf(out, "  ],\n  \"metrics\": [\n");
+        for (size_t i = 0; i < metricCount; i++) {
+            fprintf(out, "    {\"metric\": \"%s\", \"value\": %.6g, \"unit\": \"%s\"}%s\n", metrics[i].name,
+                    metrics[i].value, metrics[i].unit, i + 1 < metricCount ? "," : "");
+        }
+        fprintf(out, "  ]\n}\n");
+    }
+
+private:
+    static int compare(const void* a, const void* b) {
+        uint32_t x = *(const uint32_t*)a, y = *(const uint32_t*)b;
+        return x < y ? -1 : x > y;
+    }
+
+    Result* find(const char* name) { return const_cast<Result*>(result(name)); }
+
+    static const char* valueOf(const char* line, const char* key) {
+        const char* p = strstr(line, key);
+        if (!p) return nullptr;
+        p = strchr(p + strlen(key), ':');
+        if (!p) return nullptr;
+        p++;
+        while (*p == ' ') p++;
+        return p;
+    }
+
+    static bool readString(const char* line, const char* key, char* out, size_t size) {
+        const char* p = valueOf(line, key);
+        if (!p || *p != '"') return false;
+        const char* end = strchr(++p, '"');
+        if (!end || (size_t)(end - p) >= size) return false;
+        memcpy(out, p, end - p);
+        out[end - p] = '\0';
+        return true;
+    }
+
+    static bool readNumber(const char* line, const char* key, double& out) {
+        const char* p = valueOf(line, key);
+        if (!p) return false;
+        char* end;
+        double v = strtod(p, &end);
+        if (end == p) return false;
+        out = v;
+        return true;
+    }
+
+    Result results[MAX_BENCHES];
+    size_t count;
+    Metric metrics[MAX_METRICS];
+    size_t metricCount;
+    uint32_t samples[MAX_ITERATIONS];
+    uint32_t overheadCycles;
+    double scale;
+    double defaultThresholdPct;
+    const char* filter;
+};
+
+#endif // __BENCH_HARNESS_H__
@@ -0,0 +1,124 @@
+#ifndef __CODEC_BENCH_H__
+#define __CODEC_BENCH_H__
+
+#include <stdio.h>
+#include <vector>
+#include "../src/SampleCodec.h"
+#include "../src/SampleLog.h"
+#include "BenchHarness.h"
+
+// SampleCodec on the synthetic trace (TraceFixture.h): bytes per record against the 16-byte raw
+// record, and the cost of encoding and decoding one. Records go into log-block sized chunks that
+// each start from a reset state, the way SampleLog writes them. Ratios are reported at the
+// conversion rate and with the trace thinned to one sample a second, the shortest interval the
+// log is set to. They describe the modelled scene and its shot noise; ratios on real light wait
+// for a captured trace.
+
+static const size_t CODEC_CHUNK = SampleLog::BLOCK_SIZE - SampleLog::HEADER_SIZE;
+
+struct CodecChunk {
+    uint8_t data[CODEC_CHUNK];
+    size_t len;
+    uint32_t records;
+};
+
+// Encodes samples into chunks.
+static void encodeChunks(const std::vector<LightSample>& samples, std::vector<CodecChunk>& chunks) {
+    SampleCodec::Encoder encoder;
+    chunks.clear();
+    for (const LightSample& s : samples) {
+        if (chunks.empty()) chunks.push_back(CodecChunk());
+        CodecChunk* c = &chunks.back();
+        size_t n = encoder.encode(s, c->data + c->len, CODEC_CHUNK - c->len);
+        if (n == 0) {
+            encoder.reset();
+            chunks.push_back(CodecChunk());
+            c = &chunks.back();
+            n = encoder.encode(s, c->data, CODEC_CHUNK);
+        }
+        c->len += n;
+        c->records++;
+    }
+}
+
+// Decodes the chunks and checks every record against the input; false on the first mismatch.
+static bool decodeMatches(const std::vector<CodecChunk>& chunks, const std::vector<LightSample>& samples) {
+    size_t k = 0;
+    for (const CodecChunk& c : chunks) {
+        SampleCodec::Decoder decoder;
+        size_t offset = 0;
+        for (uint32_t r = 0; r < c.records; r++, k++) {
+            LightSample s = {};
+            size_t n = decoder.decode(c.data + offset, c.len - offset, s);
+            const LightSample& e = samples[k];
+            if (n == 0 || s.timestampMs != e.timestampMs || s.centiLux != e.centiLux || s.fullCount != e.fullCount ||
+                s.irCount != e.irCount || s.control != e.control || s.flags != e.flags) return false;
+            offset += n;
+        }
+    }
+    return k == samples.size();
+}
+
+static void codecRatio(BenchRunner& runner, const std::vector<LightSample>& samples, const char* bytesName, const char* ratioName) {
+    std::vector<CodecChunk> chunks;
+    encodeChunks(samples, chunks);
+    if (!decodeMatches(chunks, samples)) {
+        fprintf(stderr, "bench: SampleCodec round trip failed on the light trace\n");
+        return;
+    }
+    size_t bytes = 0;
+    for (const CodecChunk& c : chunks) bytes += c.len;
+    double perRecord = (double)bytes / (double)samples.size();
+    runner.metric(bytesName, perRecord, "bytes");
+    runner.metric(ratioName, (double)SampleLog::RECORD_SIZE / perRecord, "x raw");
+}
+
+static void benchSampleCodec(BenchRunner& runner, const LightSample* trace, size_t n) {
+    std::vector<LightSample> all(trace, trace + n);
+    std::vector<LightSample> perSecond;
+    for (size_t i = 0; i < n; i++) {
+        if (perSecond.empty() || trace[i].timestampMs >= perSecond.back().timestampMs + 1000) perSecond.push_back(trace[i]);
+    }
+    codecRatio(runner, all, "codec_bytes_per_record", "codec_ratio");
+    codecRatio(runner, perSecond, "codec_bytes_per_record_1s", "codec_ratio_1s");
+
+    // One record per call into a chunk; a full chunk starts the next one, as a sealed block does.
+    SampleCodec::Encoder encoder;
+    uint8_t chunk[CODEC_CHUNK];
+    size_t used = 0;
+    uint32_t i = 0;
+    const uint64_t span = trace[n - 1].timestampMs - trace[0].timestampMs + 1000;
+    LightSample s;
+    runner.run("codec_encode", 4096, [&] {
+        s = trace[i % n];
+        s.timestampMs += (uint64_t)(i / n) * span;
+        i++;
+        if (CODEC_CHUNK - used < SampleCodec::MAX_RECORD_SIZE) {
+            encoder.reset();
+            used = 0;
+        }
+    }, [&] { used += encoder.encode(s, chunk + used, CODEC_CHUNK - used); });
+
+    // One record per call from the encoded trace, moving on to the next chunk at the end of one.
+    std::vector<CodecChunk> chunks;
+    encodeChunks(all, chunks);
+    SampleCodec::Decoder decoder;
+    size_t chunkIndex = 0, offset = 0;
+    uint32_t record = 0;
+    LightSample out = {};
+    runner.run("codec_decode", 4096, [&] {
+        if (record == chunks[chunkIndex].records) {
+            chunkIndex = (chunkIndex + 1) % chunks.size();
+            decoder.reset();
+            offset = 0;
+            record = 0;
+        }
+    }, [&] {
+        const CodecChunk& c = chunks[chunkIndex];
+        offset += decoder.decode(c.data + offset, c.len - offset, out);
+        record++;
+        benchKeep(out);
+    });
+}
+
+#endif // __CODEC_BENCH_H__
@@ -0,0 +1,283 @@
+// Benchmarks for the sample-to-notify path, run on the native board (hal/native): each stage on
+// its own, then the whole path the way the firmware wires it (SensorTask -> rings -> publishLight).
+// The TSL2591 and the BLE link are simulated, so the numbers cover the firmware's own work plus
+// the I2C register traffic it generates, not bus or radio time. The SD log is measured on a
+// file-backed card (StorageBench.h); the statistics and the sample codec replay a synthetic light
+// trace (bench/fixtures/lux_trace.csv, see TraceFixture.h; StatsBench.h and CodecBench.h).
+//
+//   photoniq_bench [--json FILE] [--baseline FILE] [--threshold PCT] [--filter NAME] [--scale X]
+//                  [--fixture FILE]
+//
+// With --baseline the run fails (exit status 1) if any benchmark's median is more than its
+// threshold above the baseline's. bench/baseline.json is the reference for CI; regenerate it with
+// --json bench/baseline.json after an intended change, on the machine the comparison runs on.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <Arduino.h>
+#include "../hal/native/NativeBoard.h"
+#include "../src/LightSensor.h"
+#include "../src/LuxEngine.h"
+#include "../src/LightPayload.h"
+#include "../src/SensorTask.h"
+#include "../src/Settings.h"
+#include "../src/PreferencesSettingsStore.h"
+#include "../src/BLELightSensorService.h"
+#include "../src/LatencyStats.h"
+#include "../src/TraceLog.h"
+#include "BenchHarness.h"
+#include "StorageBench.h"
+#include "StatsBench.h"
+#include "CodecBench.h"
+#include "TraceFixture.h"
+
+// The firmware's objects, as main.cpp declares them.
+static PreferencesSettingsStore settingsStore;
+static SettingsManager settingsManager(settingsStore);
+static LightSensor lightSensor;
+static BleLightSensorService bleLightSensorService;
+static SensorTask::SampleRing sampleRings[SensorTask::MAX_SINKS];
+static LightSample lightTrace[8192];
+
+static void usage(const char* program) {
+    fprintf(stderr,
+            "usage: %s [options]\n"
+            "  --json FILE         write results as JSON\n"
+            "  --baseline FILE     compare against an earlier --json; exit 1 on a regression\n"
+            "  --threshold PCT     allowed median increase where the baseline sets none (default 25)\n"
+            "  --filter NAME       only benchmarks whose name contains NAME\n"
+            "  --scale X           multiply iteration counts by X\n"
+            "  --fixture FILE      light trace to replay (default %s)\n",
+            program, LIGHT_TRACE_PATH);
+    exit(2);
+}
+
+// Sleeps (in simulated time) until the TSL2591 has a conversion waiting.
+static void waitForConversion(NativeBoard& board) {
+    while (!board.getTsl().interruptAsserted()) delay(1);
+}
+
+// Swallows formatted trace output, so trace_drain_format measures formatting and not a console.
+class NullPrint : public Print {
+public:
+    size_t write(uint8_t) override { return 1; }
+    size_t write(const uint8_t* buffer, size_t size) override {
+        benchKeep(buffer);
+        return size;
+    }
+};
+
+static void makeSample(LightSample& s, uint32_t sequence, uint32_t centiLux) {
+    s.sequence = sequence;
+    s.timestampMs = 1760000000000ULL + sequence * 1000ULL;
+    s.centiLux = centiLux;
+    s.fullCount = 21000;
+    s.irCount = 5200;
+    s.control = 0x10;
+    s.flags = 0;
+}
+
+int main(int argc, char** argv) {
+    const char* jsonPath = nullptr;
+    const char* baselinePath = nullptr;
+    const char* fixturePath = LIGHT_TRACE_PATH;
+    BenchRunner runner;
+    for (int i = 1; i < argc; i++) {
+        if (i + 1 >= argc) usage(argv[0]);
+        const char* arg = argv[i++];
+        if (strcmp(arg, "--json") == 0) jsonPath = argv[i];
+        else if (strcmp(arg, "--baseline") == 0) baselinePath = argv[i];
+        else if (strcmp(arg, "--threshold") == 0) runner.setDefaultThreshold(atof(argv[i]));
+        else if (strcmp(arg, "--filter") == 0) runner.setFilter(argv[i]);
+        else if (strcmp(arg, "--scale") == 0) runner.setScale(atof(argv[i]));
+        else if (strcmp(arg, "--fixture") == 0) fixturePath = argv[i];
+        else usage(argv[0]);
+    }
+
+    NativeBoardOptions options = {};
+    options.speed = 0;
+    options.dataDir = "native-bench-data";
+    options.lux = 250;
+    options.centralAtS = 0;
+    options.apSsid = "PhotonIQ-Lab";
+    options.apPassword = "photoniq";
+    options.collector = "127.0.0.1";
+    options.quiet = true;
+    options.seed = 1;
+    NativeBoard& board = NativeBoard::instance();
+    board.begin(options);
+
+    settingsManager.begin();
+    bleLightSensorService.SetSettings(&settingsManager);
+    bleLightSensorService.begin();
+    if (!lightSensor.begin() || !lightSensor.startInterrupts(AlsAcquisition::MODE_CONVERSION)) {
+        fprintf(stderr, "bench: TSL2591 did not start\n");
+        _exit(2);
+    }
+    delay(200); // the central connects and subscribes
+    runner.calibrate();
+
+    // --- stages ---
+
+    uint32_t counts = 0;
+    runner.run("lux_compute", 4096, [&] {
+        counts = (counts + 7919) & 0xFFFF;
+        benchKeep(LuxEngine::centiLuxFromControl((uint16_t)(counts | 1), (uint16_t)(counts >> 2), 0x11));
+    });
+
+    // INT service, register reads, auto-ranging and the conversion to a sample.
+    AlsAcquisition::Reading reading;
+    LightSample sample;
+    runner.run("tsl_service", 1024, [&] { waitForConversion(board); }, [&] {
+        lightSensor.service(true, reading);
+        lightSensor.toSample(reading, sample, millis());
+        benchKeep(sample);
+    });
+
+    uint32_t sequence = 0;
+    makeSample(sample, 0, 25000);
+    runner.run("ring_handoff", 4096, [&] {
+        sample.sequence = sequence++;
+        for (SensorTask::SampleRing& ring : sampleRings) ring.push(sample);
+        LightSample out;
+        sampleRings[0].popLatest(out);
+        for (size_t i = 1; i < SensorTask::MAX_SINKS; i++) sampleRings[i].pop(out);
+        benchKeep(out);
+    });
+
+    uint8_t payload[LightPayload::SIZE];
+    runner.run("payload_encode", 4096, [&] {
+        sample.centiLux += 13;
+        benchKeep(LightPayload::encode(sample, payload, sizeof(payload)));
+        benchKeep(payload);
+    });
+
+    char text[32];
+    runner.run("payload_text", 4096, [&] {
+        sample.centiLux += 13;
+        benchKeep(LightPayload::formatText(sample, text, sizeof(text)));
+        benchKeep(text);
+    });
+
+    NimBLECharacteristic* lightChar = NimBLEDevice::getServer()->nativeFind(BleLightSensorService::UUID_LIGHT_CHARACTERISTIC);
+    if (lightChar) {
+        runner.run("set_value", 4096, [&] {
+            payload[0]++;
+            lightChar->setValue(payload, sizeof(payload));
+        });
+    }
+
+    // A new value every 30 ms, outside the deadband, so every call notifies both characteristics.
+    runner.run("notify", 2048, [&] {
+        delay(30);
+        sequence++;
+        makeSample(sample, sequence, sequence & 1 ? 25000 : 30000);
+    }, [&] {
+        bleLightSensorService.updateLightValue(sample, (uint64_t)esp_timer_get_time());
+    });
+
+    // Instrumentation cost: what every timed stage pays on top of its own work.
+    uint32_t fakeCycles = 1;
+    runner.run("latency_record", 4096, [&] {
+        fakeCycles = fakeCycles * 1103515245u + 12345u;
+        latencyStats.record(LatencyStats::STAGE_LUX, fakeCycles >> 12);
+    });
+    runner.run("latency_scope", 4096, [&] { LatencyStats::Scope timed(latencyStats, LatencyStats::STAGE_LUX); });
+
+    uint8_t snapshot[LatencyStats::SNAPSHOT_SIZE];
+    runner.run("latency_snapshot", 1024, [&] { benchKeep(latencyStats.encode(snapshot, sizeof(snapshot), millis())); });
+
+    // Trace cost at the call site (a record into the ring), against formatting the same line there.
+    uint32_t traceValue = 0;
+    runner.run("trace_record_ints", 4096, [&] {
+        traceValue += 7;
+        TRACE_INFO("bench: conn %u handle %u value %d", traceValue & 7, traceValue & 0xFF, (int)traceValue);
+    });
+    runner.run("trace_record_string", 4096, [&] { TRACE_INFO("bench: name <- %s", TraceBytes("PhotonIQ-Lab", 12)); });
+    runner.run("trace_stripped", 4096, [&] { TRACE_DEBUG("bench: value %d", (int)++traceValue); });
+
+    char line[TraceLog::MAX_LINE];
+    runner.run("snprintf_line", 4096, [&] {
+        traceValue += 7;
+        benchKeep(snprintf(line, sizeof(line), "[%5lu.%06lu] I bench: conn %u handle %u value %d\r\n",
+                           (unsigned long)(millis() / 1000), (unsigned long)(millis() % 1000) * 1000,
+                           (unsigned)(traceValue & 7), (unsigned)(traceValue & 0xFF), (int)traceValue));
+        benchKeep(line);
+    });
+
+    // What the trace task pays later, per record.
+    NullPrint nullPrint;
+    while (traceLog.drain(nullPrint, TraceLog::CAPACITY)) {} // the records above
+    runner.run("trace_drain_format", 4096, [&] {
+        traceValue += 7;
+        TRACE_INFO("bench: conn %u handle %u value %d", traceValue & 7, traceValue & 0xFF, (int)traceValue);
+    }, [&] { benchKeep(traceLog.drain(nullPrint, 1)); });
+
+    // --- statistics and sample codec ---
+
+    size_t traceSamples = loadLightTrace(fixturePath, lightTrace, sizeof(lightTrace) / sizeof(lightTrace[0]), STORAGE_BENCH_EPOCH_MS);
+    if (traceSamples > 0) {
+        size_t mismatch = checkLightTraceRanging(lightTrace, traceSamples);
+        if (mismatch < traceSamples) {
+            fprintf(stderr, "bench: %s row %u: control 0x%02x is not what AutoRange picks; regenerate it with tools/make_lux_trace.py\n",
+                    fixturePath, (unsigned)mismatch, lightTrace[mismatch].control);
+            _exit(2);
+        }
+        benchStreamingStats(runner, lightTrace, traceSamples);
+        benchSampleCodec(runner, lightTrace, traceSamples);
+    } else {
+        fprintf(stderr, "bench: no light trace at %s, statistics and codec skipped\n", fixturePath);
+    }
+
+    // --- storage ---
+
+    benchSdWrite(runner, "native-bench-data/card");
+    benchRangeQuery(runner, "native-bench-data/card");
+
+    runner.run("scan_for_peers", 1024, [&] { bleLightSensorService.scanForPeers(); });
+
+    // --- end to end ---
+
+    // One conversion from INT to notify: what SensorTask does with it, then publishLight().
+    // The scene alternates between readings so each one clears the publish deadband.
+    bool bright = false;
+    runner.run("pipeline", 1024, [&] {
+        bright = !bright;
+        board.setLux(bright ? 300 : 250);
+        waitForConversion(board);
+    }, [&] {
+        if (lightSensor.service(true, reading) != AlsAcquisition::EVENT_CONVERSION) return;
+        LightSample fresh;
+        lightSensor.toSample(reading, fresh, millis());
+        for (SensorTask::SampleRing& ring : sampleRings) ring.push(fresh);
+        LightSample latest;
+        if (sampleRings[0].popLatest(latest)) {
+            bleLightSensorService.updateLightValue(latest, (uint64_t)esp_timer_get_time());
+        }
+        for (size_t i = 1; i < SensorTask::MAX_SINKS; i++) sampleRings[i].pop(latest);
+    });
+
+    if (baselinePath && runner.compareWithBaseline(baselinePath) == 0) {
+        fprintf(stderr, "bench: nothing to compare in %s\n", baselinePath);
+    }
+    runner.printTable(stdout);
+    fprintf(stdout, "ble: %u notifications, %u rejected\n", board.getStats().notifications,
+            board.getStats().notifyRejected);
+    if (jsonPath) {
+        FILE* fp = fopen(jsonPath, "w");
+        if (!fp) {
+            fprintf(stderr, "bench: cannot write %s\n", jsonPath);
+            _exit(2);
+        }
+        runner.writeJson(fp);
+        fclose(fp);
+    }
+    fflush(stdout);
+
+    size_t regressions = runner.regressions();
+    if (regressions) fprintf(stderr, "bench: %u regression(s) against %s\n", (unsigned)regressions, baselinePath);
+    // Other tasks (the NimBLE host) are parked in the simulated kernel; don't wait for them.
+    _exit(regressions ? 1 : 0);
+}
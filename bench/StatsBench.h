@@ -0,0 +1,83 @@
+#ifndef __STATS_BENCH_H__
+#define __STATS_BENCH_H__
+
+#include <algorithm>
+#include <math.h>
+#include <vector>
+#include "../src/StreamingStats.h"
+#include "BenchHarness.h"
+
+// StreamingStats on the synthetic trace (TraceFixture.h): the per-sample cost, and how far the
+// P² estimates land from the exact quantiles of each window (all of the window's samples,
+// sorted). The error is taken as a share of the window's range (max - min), not of the exact
+// value: in the dark windows a few centi-lux off is thousands of percent of a value near zero.
+// The mean shows the usual accuracy; the max is dominated by windows where the light changes
+// level abruptly.
+
+// Exact p-quantile of sorted values, interpolated between ranks the way P² aims for.
+static double exactQuantile(const std::vector<uint32_t>& sorted, double p) {
+    double rank = p * (double)(sorted.size() - 1);
+    size_t lo = (size_t)rank;
+    size_t hi = lo + 1 < sorted.size() ? lo + 1 : lo;
+    return sorted[lo] + (rank - (double)lo) * ((double)sorted[hi] - sorted[lo]);
+}
+
+static void benchStreamingStats(BenchRunner& runner, const LightSample* trace, size_t n) {
+    const uint64_t span = trace[n - 1].timestampMs - trace[0].timestampMs + 1000;
+
+    // Per sample, replaying the trace lap after lap so windows keep closing as they would live.
+    StreamingStats stats;
+    LightSample s;
+    uint32_t i = 0;
+    runner.run("stats_add", 4096, [&] {
+        s = trace[i % n];
+        s.timestampMs += (uint64_t)(i / n) * span;
+        i++;
+    }, [&] { benchKeep(stats.add(s)); });
+
+    P2Quantile p90(0.9f);
+    float x = 0.0f;
+    i = 0;
+    runner.run("p2_add", 4096, [&] { x = (float)trace[i++ % n].centiLux; }, [&] { p90.add(x); });
+
+    // Accuracy: each closed window's P² quantiles against the exact ones. Saturated samples are
+    // left out on both sides, as StreamingStats does.
+    if (!runner.selected("p2_")) return;
+    StreamingStats windows;
+    const StreamingStats::Config& config = windows.getConfig();
+    std::vector<uint32_t> values;
+    double sumError[StreamingStats::QUANTILES] = {}, maxError[StreamingStats::QUANTILES] = {};
+    uint32_t closed = 0;
+    auto compare = [&] {
+        const StreamingStats::Summary& summary = windows.last();
+        if (values.size() < 5) return;
+        std::sort(values.begin(), values.end());
+        double range = (double)(values.back() - values.front());
+        for (size_t q = 0; q < StreamingStats::QUANTILES; q++) {
+            double exact = exactQuantile(values, config.quantiles[q]);
+            double error = fabs((double)summary.quantileCentiLux[q] - exact) / (range > 1.0 ? range : 1.0) * 100.0;
+            sumError[q] += error;
+            if (error > maxError[q]) maxError[q] = error;
+        }
+        closed++;
+    };
+    for (size_t k = 0; k < n; k++) {
+        if (windows.add(trace[k])) {
+            compare();
+            values.clear();
+        }
+        if (!(trace[k].flags & LightSample::FLAG_SATURATED)) values.push_back(trace[k].centiLux);
+    }
+    if (windows.closeIfDue(trace[n - 1].timestampMs + config.windowMs)) compare();
+    if (closed == 0) return;
+
+    static const char* const MEAN_NAMES[] = { "p2_p50_error_mean", "p2_p90_error_mean", "p2_p99_error_mean" };
+    static const char* const MAX_NAMES[]  = { "p2_p50_error_max", "p2_p90_error_max", "p2_p99_error_max" };
+    for (size_t q = 0; q < StreamingStats::QUANTILES; q++) {
+        runner.metric(MEAN_NAMES[q], sumError[q] / closed, "% of range");
+        runner.metric(MAX_NAMES[q], maxError[q], "% of range");
+    }
+    runner.metric("p2_windows", closed, "windows");
+}
+
+#endif // __STATS_BENCH_H__
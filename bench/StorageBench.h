@@ -0,0 +1,149 @@
+#ifndef __STORAGE_BENCH_H__
+#define __STORAGE_BENCH_H__
+
+#include <stdint.h>
+#include <string.h>
+#include "../hal/native/FileBlockFile.h"
+#include "../src/SampleLog.h"
+#include "../src/SampleLogReader.h"
+#include "BenchHarness.h"
+
+// The SD log on a file-backed card (FileBlockFile, a directory on the host): what the write path
+// costs per block and per record. Host file I/O stands in for the card's SPI time, so the
+// numbers compare revisions of the log code, not SD cards.
+
+static const uint64_t STORAGE_BENCH_EPOCH_MS = 1760000000000ULL;   // 2025-10-09, mid-day
+
+// Deletes the day files (data and index) a benchmark is about to write, so every run starts empty.
+static void removeDayFiles(FileBlockFile& card, uint32_t firstDay, uint32_t days) {
+    char name[SampleLog::FILE_NAME_LEN];
+    for (uint32_t d = firstDay; d < firstDay + days; d++) {
+        SampleLog::formatFileName(d, name, sizeof(name));
+        card.remove(name);
+        SampleLog::formatFileName(d, name, sizeof(name), "idx");
+        card.remove(name);
+    }
+}
+
+// A slowly drifting scene with sensor noise, the shape of a real day's log.
+static void nextLoggedSample(LightSample& s, uint32_t intervalMs, uint32_t& rng) {
+    rng = rng * 1103515245u + 12345u;
+    s.sequence++;
+    s.timestampMs += intervalMs;
+    s.centiLux = 25000 + (s.sequence % 600) * 10 + ((rng >> 16) % 64);
+    s.fullCount = (uint16_t)(s.centiLux / 2 + ((rng >> 8) & 7));
+    s.irCount = (uint16_t)(s.fullCount / 4);
+    s.control = 0x11;
+    s.flags = 0;
+}
+
+static void benchSdWrite(BenchRunner& runner, const char* dir) {
+    FileBlockFile card(dir);
+
+    // Whole preallocated sectors, sequentially, as SampleLog hands them down.
+    const uint32_t blocks = 4096;
+    uint8_t block[BlockFile::BLOCK_SIZE];
+    memset(block, 0x5A, sizeof(block));
+    card.remove("blocks.bin");
+    if (runner.selected("sd_block_write") && card.open("blocks.bin", true, blocks)) {
+        uint32_t i = 0;
+        runner.run("sd_block_write", blocks, [&] {
+            block[0] = (uint8_t)i;
+            card.writeBlock(i++ % blocks, block);
+        });
+        card.sync();
+        card.close();
+        double ns = runner.meanNs("sd_block_write");
+        if (ns > 0) runner.metric("sd_block_write_throughput", BlockFile::BLOCK_SIZE / ns * 1e3, "MB/s");
+    }
+    card.remove("blocks.bin");
+
+    // append() + service() at the TSL2591's fastest rate (100 ms conversions), delta-encoded as
+    // FileLogger logs, block writes and partial commits included.
+    const uint32_t intervalMs = 100;
+    FileBlockFile logFile(dir), indexFile(dir);
+    uint32_t day = (uint32_t)(STORAGE_BENCH_EPOCH_MS / SampleLog::MS_PER_DAY);
+    removeDayFiles(card, day, 1);
+    SampleLog log(logFile, indexFile, SampleLog::blocksPerDay(intervalMs, SampleLog::ENCODING_DELTA),
+                  SampleLog::commitIntervalFor(intervalMs));
+    log.setEncoding(SampleLog::ENCODING_DELTA);
+    LightSample s = {};
+    s.timestampMs = STORAGE_BENCH_EPOCH_MS;
+    uint32_t rng = 1;
+    runner.run("sd_log_append", 4096, [&] {
+        nextLoggedSample(s, intervalMs, rng);
+        log.append(s);
+        log.service(s.timestampMs);
+    });
+    log.flush();
+    const SampleLog::Stats& st = log.getStats();
+    double ns = runner.meanNs("sd_log_append");
+    if (ns > 0 && st.recordsAppended > 0) {
+        runner.metric("sd_log_records_per_second", 1e9 / ns, "records/s");
+        runner.metric("sd_log_bytes_per_record", (double)st.blocksWritten * BlockFile::BLOCK_SIZE / st.recordsAppended,
+                      "bytes");
+    }
+    removeDayFiles(card, day, 1);
+}
+
+// Range queries over a month of 10 s samples (31 day files, built fresh each run): seeking to a
+// random instant, and reading a random hour end to end. The sector-read counts are what the
+// index is for: a seek costs a handful of reads however much is logged.
+static void benchRangeQuery(BenchRunner& runner, const char* dir) {
+    if (!runner.selected("range_query")) return;
+    const uint32_t intervalMs = 10000, days = 31;
+    FileBlockFile card(dir), logFile(dir), indexFile(dir);
+    uint32_t firstDay = (uint32_t)(STORAGE_BENCH_EPOCH_MS / SampleLog::MS_PER_DAY);
+    removeDayFiles(card, firstDay, days);
+    {
+        SampleLog log(logFile, indexFile, SampleLog::blocksPerDay(intervalMs, SampleLog::ENCODING_DELTA),
+                      SampleLog::commitIntervalFor(intervalMs));
+        log.setEncoding(SampleLog::ENCODING_DELTA);
+        LightSample s = {};
+        s.timestampMs = (uint64_t)firstDay * SampleLog::MS_PER_DAY;
+        uint32_t rng = 7;
+        while (s.timestampMs < (uint64_t)(firstDay + days) * SampleLog::MS_PER_DAY - intervalMs) {
+            nextLoggedSample(s, intervalMs, rng);
+            log.append(s);
+            log.service(s.timestampMs);
+        }
+        log.flush();
+    }
+
+    FileBlockFile dataFile(dir), queryIndexFile(dir);
+    SampleLogReader reader(dataFile, queryIndexFile);
+    const uint64_t spanMs = (uint64_t)(days - 1) * SampleLog::MS_PER_DAY;
+    const uint64_t hourMs = 3600000ULL;
+    uint32_t rng = 11;
+    uint64_t fromMs = 0;
+    auto pick = [&] {
+        rng = rng * 1103515245u + 12345u;
+        fromMs = (uint64_t)firstDay * SampleLog::MS_PER_DAY + (uint64_t)rng % spanMs;
+    };
+
+    uint64_t reads = 0, queries = 0;
+    LightSample s;
+    runner.run("range_query_seek", 1024, pick, [&] {
+        if (reader.seek(fromMs, fromMs + hourMs) && reader.next(s)) benchKeep(s);
+        reads += reader.blocksRead();
+        queries++;
+    });
+    if (queries) runner.metric("range_query_seek_sectors", (double)reads / queries, "sectors/query");
+
+    reads = queries = 0;
+    uint64_t records = 0;
+    runner.run("range_query_hour", 1024, pick, [&] {
+        reader.seek(fromMs, fromMs + hourMs);
+        while (reader.next(s)) records++;
+        reads += reader.blocksRead();
+        queries++;
+    });
+    if (queries) {
+        runner.metric("range_query_hour_sectors", (double)reads / queries, "sectors/query");
+        runner.metric("range_query_hour_records", (double)records / queries, "records/query");
+    }
+    reader.close();
+    removeDayFiles(card, firstDay, days);
+}
+
+#endif // __STORAGE_BENCH_H__
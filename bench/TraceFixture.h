@@ -0,0 +1,64 @@
+#ifndef __TRACE_FIXTURE_H__
+#define __TRACE_FIXTURE_H__
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "../src/AutoRange.h"
+#include "../src/LightSample.h"
+#include "../src/LuxEngine.h"
+
+// The light trace the benches replay (bench/fixtures/lux_trace.csv): one row per TSL2591
+// conversion, "ms,full,ir,control". It is synthetic, a modelled scene read through the sensor's
+// count model by tools/make_lux_trace.py, not a capture from a real sensor; none is checked in
+// yet. A captured trace in the same format can be replayed with --fixture. Samples are filled in
+// from the counts the way LightSensor::fill() does, so lux and flags match what the firmware
+// would have produced for the same readings.
+//
+// The control column is only as good as the ranging that produced it: the generator carries its
+// own copy of AutoRange's rules, so checkLightTraceRanging() replays the counts through the real
+// AutoRange and reports the first row where the setting differs from the one it would have picked.
+
+static const char* const LIGHT_TRACE_PATH = "bench/fixtures/lux_trace.csv";
+
+// Loads up to capacity samples, timestamped from epochMs; returns how many (0 if unreadable).
+static size_t loadLightTrace(const char* path, LightSample* out, size_t capacity, uint64_t epochMs) {
+    FILE* f = fopen(path, "r");
+    if (!f) return 0;
+    char line[96];
+    size_t n = 0;
+    while (n < capacity && fgets(line, sizeof(line), f)) {
+        unsigned long long ms;
+        unsigned full, ir, control;
+        if (line[0] == '#' || sscanf(line, "%llu,%u,%u,%u", &ms, &full, &ir, &control) != 4) continue;
+        LightSample& s = out[n];
+        s.sequence = (uint32_t)n;
+        s.timestampMs = epochMs + ms;
+        s.fullCount = (uint16_t)full;
+        s.irCount = (uint16_t)ir;
+        s.control = (uint8_t)control;
+        s.flags = 0;
+        s.centiLux = 0;
+        uint16_t ceiling = AutoRange::maxCount(s.control & 0x07);
+        if (s.fullCount >= ceiling || s.irCount >= ceiling) s.flags |= LightSample::FLAG_SATURATED;
+        else if (s.fullCount == 0) s.flags |= LightSample::FLAG_NO_SIGNAL;
+        else s.centiLux = LuxEngine::centiLuxFromControl(s.fullCount, s.irCount, s.control);
+        n++;
+    }
+    fclose(f);
+    return n;
+}
+
+// Feeds each row's counts to an AutoRange started at the first row's setting; returns the index of
+// the first row whose control is not the setting AutoRange chose after the row before, or n.
+static size_t checkLightTraceRanging(const LightSample* samples, size_t n) {
+    AutoRange range;
+    if (n > 0) range.setSetting({ (uint8_t)(samples[0].control >> 4), (uint8_t)(samples[0].control & 0x07) });
+    for (size_t k = 0; k < n; k++) {
+        AutoRange::Setting s = range.setting();
+        if (samples[k].control != (uint8_t)((s.gain << 4) | s.time)) return k;
+        range.update(samples[k].fullCount, samples[k].irCount);
+    }
+    return n;
+}
+
+#endif // __TRACE_FIXTURE_H__
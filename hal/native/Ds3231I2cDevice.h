@@ -0,0 +1,100 @@
+#ifndef __DS3231_I2C_DEVICE_H__
+#define __DS3231_I2C_DEVICE_H__
+
+#include <string.h>
+#include <time.h>
+#include "I2cBus.h"
+#include "SimulatedDs3231.h"
+
+// Puts a SimulatedDs3231 (or any RtcDevice) on the I2C bus as the DS3231's register map: BCD time
+// in 0x00..0x06, control 0x0E, status 0x0F (OSF from lostPower(), never busy), aging 0x10 and a
+// fixed 25 C in the temperature registers. A write touching the time registers sets the clock
+// once the transaction ends, as the part does when the seconds register is written.
+class Ds3231I2cDevice : public I2cDevice {
+public:
+    static constexpr uint8_t ADDRESS     = 0x68;
+    static constexpr uint8_t REG_CONTROL = 0x0E;
+    static constexpr uint8_t REG_STATUS  = 0x0F;
+    static constexpr uint8_t REG_AGING   = 0x10;
+    static constexpr uint8_t REG_TEMP    = 0x11;
+    static constexpr uint8_t REG_COUNT   = 0x13;
+
+    static constexpr uint8_t STATUS_OSF   = 0x80;
+    static constexpr uint8_t CONTROL_CONV = 0x20;
+
+    explicit Ds3231I2cDevice(RtcDevice& rtc_) : rtc(rtc_), pointer(0), control(0x1C), osfCleared(false) {}
+
+    bool write(const uint8_t* data, size_t len) override {
+        if (len == 0) return true; // address probe
+        pointer = data[0] % REG_COUNT;
+        if (len == 1) return true;
+
+        uint8_t regs[REG_COUNT];
+        if (!snapshot(regs)) return false;
+        bool timeWritten = false;
+        for (size_t i = 1; i < len; i++) {
+            uint8_t reg = pointer;
+            regs[reg] = data[i];
+            if (reg <= 0x06) timeWritten = true;
+            else if (reg == REG_CONTROL) control = data[i] & ~CONTROL_CONV; // conversions finish at once
+            else if (reg == REG_STATUS && !(data[i] & STATUS_OSF)) osfCleared = true;
+            else if (reg == REG_AGING && !rtc.writeAging((int8_t)data[i])) return false;
+            pointer = (uint8_t)((pointer + 1) % REG_COUNT);
+        }
+        if (timeWritten) {
+            struct tm tm = {};
+            tm.tm_sec = bcd2bin(regs[0] & 0x7F);
+            tm.tm_min = bcd2bin(regs[1] & 0x7F);
+            tm.tm_hour = bcd2bin(regs[2] & 0x3F);
+            tm.tm_mday = bcd2bin(regs[4] & 0x3F);
+            tm.tm_mon = bcd2bin(regs[5] & 0x1F) - 1;
+            tm.tm_year = bcd2bin(regs[6]) + 100;
+            if (!rtc.writeSeconds((uint32_t)timegm(&tm))) return false;
+            osfCleared = true;
+        }
+        return true;
+    }
+
+    bool read(uint8_t* out, size_t len) override {
+        uint8_t regs[REG_COUNT];
+        if (!snapshot(regs)) return false;
+        for (size_t i = 0; i < len; i++) {
+            out[i] = regs[pointer];
+            pointer = (uint8_t)((pointer + 1) % REG_COUNT);
+        }
+        return true;
+    }
+
+private:
+    static uint8_t bin2bcd(int v) { return (uint8_t)(v + 6 * (v / 10)); }
+    static int bcd2bin(uint8_t v) { return v - 6 * (v >> 4); }
+
+    bool snapshot(uint8_t* regs) {
+        uint32_t epoch;
+        int8_t aging;
+        if (!rtc.readSeconds(epoch) || !rtc.readAging(aging)) return false;
+        time_t seconds = (time_t)epoch;
+        struct tm tm;
+        gmtime_r(&seconds, &tm);
+        memset(regs, 0, REG_COUNT);
+        regs[0] = bin2bcd(tm.tm_sec);
+        regs[1] = bin2bcd(tm.tm_min);
+        regs[2] = bin2bcd(tm.tm_hour);
+        regs[3] = bin2bcd(tm.tm_wday == 0 ? 7 : tm.tm_wday);
+        regs[4] = bin2bcd(tm.tm_mday);
+        regs[5] = bin2bcd(tm.tm_mon + 1);
+        regs[6] = bin2bcd(tm.tm_year % 100);
+        regs[REG_CONTROL] = control;
+        regs[REG_STATUS] = rtc.lostPower() && !osfCleared ? STATUS_OSF : 0;
+        regs[REG_AGING] = (uint8_t)aging;
+        regs[REG_TEMP] = 25;
+        return true;
+    }
+
+    RtcDevice& rtc;
+    uint8_t pointer;
+    uint8_t control;
+    bool osfCleared;
+};
+
+#endif // __DS3231_I2C_DEVICE_H__
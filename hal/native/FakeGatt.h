@@ -0,0 +1,61 @@
+#ifndef __FAKE_GATT_H__
+#define __FAKE_GATT_H__
+
+#include <string.h>
+#include "../../src/GattRegistry.h"
+
+// GattBuilder adapter that stands in for the BLE stack in native builds. Handles are assigned in
+// declaration order with the attributes an ATT server would add (a declaration per service; per
+// characteristic a declaration, the value, and a CCCD when it notifies or indicates), values are
+// kept in fixed slots, and write() feeds a central's write through the registry dispatcher.
+template <size_t MAX_CHARS = 32, size_t MAX_VALUE = GATT_MAX_VALUE>
+class FakeGatt {
+public:
+    FakeGatt() : nextHandle(1), serviceCount(0), charCount(0) {}
+
+    void createService(size_t index, const GattServiceDef&) {
+        serviceHandles[index] = nextHandle++;
+        serviceCount = index + 1;
+    }
+
+    void createCharacteristic(size_t index, const GattCharacteristicDef& def) {
+        nextHandle++;                       // characteristic declaration
+        valueHandles[index] = nextHandle++; // value
+        if (def.properties & (GATT_NOTIFY | GATT_INDICATE)) nextHandle++; // CCCD
+        properties[index] = def.properties;
+        lengths[index] = 0;
+        charCount = index + 1;
+    }
+
+    void setValue(size_t index, const uint8_t* data, size_t len) {
+        if (len > MAX_VALUE) len = MAX_VALUE;
+        memcpy(values[index], data, len);
+        lengths[index] = len;
+    }
+
+    uint16_t handleOf(size_t index) { return valueHandles[index]; }
+
+    // A central writing to handle: stores the value like the stack would, then dispatches.
+    bool write(GattDispatcher& dispatcher, uint16_t handle, const uint8_t* data, size_t len, uint16_t connHandle = 0) {
+        int index = dispatcher.indexOf(handle);
+        if (index >= 0 && (properties[index] & (GATT_WRITE | GATT_WRITE_NR))) setValue((size_t)index, data, len);
+        return dispatcher.dispatch(handle, data, len, connHandle);
+    }
+
+    const uint8_t* value(size_t index) const { return values[index]; }
+    size_t valueLength(size_t index) const { return lengths[index]; }
+    size_t characteristics() const { return charCount; }
+    uint16_t attributeCount() const { return (uint16_t)(nextHandle - 1); }
+
+private:
+    uint16_t nextHandle;
+    size_t serviceCount;
+    size_t charCount;
+    uint16_t serviceHandles[MAX_CHARS];
+    uint16_t valueHandles[MAX_CHARS];
+    uint16_t properties[MAX_CHARS];
+    uint8_t values[MAX_CHARS][MAX_VALUE];
+    size_t lengths[MAX_CHARS];
+};
+
+#endif // __FAKE_GATT_H__
@@ -0,0 +1,75 @@
+#ifndef __FILE_BLOCK_FILE_H__
+#define __FILE_BLOCK_FILE_H__
+
+#include <stdio.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "../../src/BlockFile.h"
+
+// BlockFile backed by a regular file in a host directory; stands in for the SD card in
+// native builds and lets the log's write path be measured off-device.
+class FileBlockFile : public BlockFile {
+public:
+    explicit FileBlockFile(const char* rootDir_) : rootDir(rootDir_), fp(nullptr) {}
+    ~FileBlockFile() override { close(); }
+
+    bool open(const char* name, bool create, uint32_t preallocBlocks = 0) override {
+        close();
+        char path[512];
+        snprintf(path, sizeof(path), "%s/%s", rootDir, name);
+        fp = fopen(path, "r+b");
+        if (!fp) {
+            if (!create) return false;
+            mkdir(rootDir, 0755);
+            fp = fopen(path, "w+b");
+            if (!fp) return false;
+            if (preallocBlocks > 0) {
+                uint8_t zero = 0;
+                fseek(fp, (long)preallocBlocks * BLOCK_SIZE - 1, SEEK_SET);
+                fwrite(&zero, 1, 1, fp);
+                fflush(fp);
+            }
+        }
+        return true;
+    }
+
+    bool isOpen() const override { return fp != nullptr; }
+
+    void close() override {
+        if (fp) fclose(fp);
+        fp = nullptr;
+    }
+
+    uint32_t blockCount() override {
+        if (!fp) return 0;
+        fseek(fp, 0, SEEK_END);
+        return (uint32_t)(ftell(fp) / BLOCK_SIZE);
+    }
+
+    bool readBlock(uint32_t index, uint8_t* out) override {
+        if (!fp || fseek(fp, (long)index * BLOCK_SIZE, SEEK_SET) != 0) return false;
+        return fread(out, 1, BLOCK_SIZE, fp) == BLOCK_SIZE;
+    }
+
+    bool writeBlock(uint32_t index, const uint8_t* data) override {
+        if (!fp || fseek(fp, (long)index * BLOCK_SIZE, SEEK_SET) != 0) return false;
+        return fwrite(data, 1, BLOCK_SIZE, fp) == BLOCK_SIZE;
+    }
+
+    bool sync() override {
+        return fp && fflush(fp) == 0;
+    }
+
+    // Deletes name from the directory (not part of BlockFile; benchmarks and tests start clean).
+    bool remove(const char* name) {
+        char path[512];
+        snprintf(path, sizeof(path), "%s/%s", rootDir, name);
+        return unlink(path) == 0;
+    }
+
+private:
+    const char* rootDir;
+    FILE* fp;
+};
+
+#endif // __FILE_BLOCK_FILE_H__
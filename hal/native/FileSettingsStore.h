@@ -0,0 +1,46 @@
+#ifndef __FILE_SETTINGS_STORE_H__
+#define __FILE_SETTINGS_STORE_H__
+
+#include <stdio.h>
+#include "../../src/Settings.h"
+
+// SettingsStore backed by a host file; stands in for NVS in native builds. Writes go to a
+// temporary file that is renamed over the old one, so a blob is either old or new, never torn.
+class FileSettingsStore : public SettingsStore {
+public:
+    explicit FileSettingsStore(const char* path_) : path(path_), writes(0) {}
+
+    size_t read(uint8_t* out, size_t capacity) override {
+        FILE* fp = fopen(path, "rb");
+        if (!fp) return 0;
+        size_t len = fread(out, 1, capacity, fp);
+        // A file longer than capacity is not a blob we wrote.
+        if (len == capacity && fgetc(fp) != EOF) len = 0;
+        fclose(fp);
+        return len;
+    }
+
+    bool write(const uint8_t* data, size_t len) override {
+        char tmp[512];
+        snprintf(tmp, sizeof(tmp), "%s.tmp", path);
+        FILE* fp = fopen(tmp, "wb");
+        if (!fp) return false;
+        bool ok = fwrite(data, 1, len, fp) == len;
+        ok = (fclose(fp) == 0) && ok;
+        if (!ok || rename(tmp, path) != 0) {
+            remove(tmp);
+            return false;
+        }
+        writes++;
+        return true;
+    }
+
+    // Blob writes so far; each would be one NVS write (and eventually a sector erase) on the device.
+    uint32_t writeCount() const { return writes; }
+
+private:
+    const char* path;
+    uint32_t writes;
+};
+
+#endif // __FILE_SETTINGS_STORE_H__
@@ -0,0 +1,65 @@
+#ifndef __I2C_BUS_H__
+#define __I2C_BUS_H__
+
+#include <stddef.h>
+#include <stdint.h>
+
+// A device on the native board's I2C bus, seen at the transaction level: a write (which may be
+// the register-pointer half of a repeated-start read) and a read. Returning false NAKs.
+class I2cDevice {
+public:
+    virtual ~I2cDevice() {}
+
+    virtual bool write(const uint8_t* data, size_t len) = 0;
+    virtual bool read(uint8_t* out, size_t len) = 0;
+};
+
+// The bus itself: routes Wire transactions to the device at the address, NAKing the others.
+class I2cBus {
+public:
+    static constexpr size_t MAX_DEVICES = 8;
+
+    // Wire.endTransmission() results.
+    static constexpr uint8_t OK           = 0;
+    static constexpr uint8_t NACK_ADDRESS = 2;
+    static constexpr uint8_t NACK_DATA    = 3;
+
+    I2cBus() : count(0), transactions(0) {}
+
+    bool attach(uint8_t address, I2cDevice* device) {
+        if (count >= MAX_DEVICES) return false;
+        addresses[count] = address;
+        devices[count++] = device;
+        return true;
+    }
+
+    uint8_t write(uint8_t address, const uint8_t* data, size_t len) {
+        transactions++;
+        I2cDevice* device = find(address);
+        if (!device) return NACK_ADDRESS;
+        return device->write(data, len) ? OK : NACK_DATA;
+    }
+
+    size_t read(uint8_t address, uint8_t* out, size_t len) {
+        transactions++;
+        I2cDevice* device = find(address);
+        return device && device->read(out, len) ? len : 0;
+    }
+
+    uint32_t transactionCount() const { return transactions; }
+
+private:
+    I2cDevice* find(uint8_t address) {
+        for (size_t i = 0; i < count; i++) {
+            if (addresses[i] == address) return devices[i];
+        }
+        return nullptr;
+    }
+
+    uint8_t addresses[MAX_DEVICES];
+    I2cDevice* devices[MAX_DEVICES];
+    size_t count;
+    uint32_t transactions;
+};
+
+#endif // __I2C_BUS_H__
@@ -0,0 +1,108 @@
+#ifndef __LOCAL_NTP_SERVER_H__
+#define __LOCAL_NTP_SERVER_H__
+
+#include <string.h>
+#include "../../src/NtpSync.h"
+
+// NtpTransport answered by an in-process SNTP server for native builds. The server's clock is
+// true time plus skewUs; requests and replies take the configured one-way delays (with optional
+// pseudo-random jitter), and replies can be lost or replaced by a kiss-o'-death. The host drives
+// true time with advance().
+class LocalNtpServer : public NtpTransport {
+public:
+    explicit LocalNtpServer(int64_t trueUs_)
+        : trueUs(trueUs_), skewUs(0), uplinkUs(5000), downlinkUs(5000), jitterUs(0), openUs(0), reachable(true),
+          dropEvery(0), kissOfDeath(false), seed(1), opened(false), openStartedUs(-1), pending(false),
+          requestAtUs(0), replyAtUs(0), replyReady(false), request(), reply(), requests(0), replies(0) {}
+
+    void advance(uint64_t us) {
+        trueUs += (int64_t)us;
+        if (pending && trueUs >= requestAtUs) answer();
+    }
+
+    int64_t now() const { return trueUs; }
+    void setSkewUs(int64_t skew) { skewUs = skew; }
+    void setDelays(uint32_t uplink, uint32_t downlink, uint32_t jitter = 0) { uplinkUs = uplink; downlinkUs = downlink; jitterUs = jitter; }
+    void setOpenUs(uint32_t us) { openUs = us; }   // DNS lookup time
+    void setReachable(bool r) { reachable = r; }
+    void setDropEvery(uint32_t n) { dropEvery = n; } // lose every nth request (0: none)
+    void setKissOfDeath(bool k) { kissOfDeath = k; }
+    uint32_t requestCount() const { return requests; }
+
+    bool open() override {
+        if (!reachable) return false;
+        if (openStartedUs < 0) openStartedUs = trueUs;
+        opened = trueUs - openStartedUs >= (int64_t)openUs;
+        return opened;
+    }
+
+    bool send(const uint8_t* packet, size_t len) override {
+        if (!opened || len < NtpSync::PACKET_SIZE) return false;
+        requests++;
+        if (dropEvery && requests % dropEvery == 0) return true;
+        memcpy(request, packet, NtpSync::PACKET_SIZE);
+        pending = true;
+        replyReady = false;
+        requestAtUs = trueUs + uplinkUs + jitter();
+        return true;
+    }
+
+    size_t receive(uint8_t* out, size_t capacity) override {
+        if (!replyReady || trueUs < replyAtUs || capacity < NtpSync::PACKET_SIZE) return 0;
+        replyReady = false;
+        memcpy(out, reply, NtpSync::PACKET_SIZE);
+        return NtpSync::PACKET_SIZE;
+    }
+
+    void close() override {
+        opened = false;
+        openStartedUs = -1;
+        pending = false;
+        replyReady = false;
+    }
+
+private:
+    uint32_t jitter() {
+        if (!jitterUs) return 0;
+        seed = seed * 1103515245u + 12345u;
+        return (seed >> 8) % jitterUs;
+    }
+
+    void answer() {
+        pending = false;
+        int64_t receivedUs = requestAtUs + skewUs;
+        int64_t transmitUs = receivedUs + 100;
+        memset(reply, 0, sizeof(reply));
+        reply[0] = (0 << 6) | (4 << 3) | 4; // LI 0, version 4, mode 4 (server)
+        reply[1] = kissOfDeath ? 0 : 2;
+        memcpy(reply + 24, request + 40, 8);
+        NtpSync::putTimestamp(reply + 32, receivedUs);
+        NtpSync::putTimestamp(reply + 40, transmitUs);
+        replyAtUs = requestAtUs + 100 + downlinkUs + jitter();
+        replyReady = true;
+        replies++;
+    }
+
+    int64_t trueUs;
+    int64_t skewUs;
+    uint32_t uplinkUs;
+    uint32_t downlinkUs;
+    uint32_t jitterUs;
+    uint32_t openUs;
+    bool reachable;
+    uint32_t dropEvery;
+    bool kissOfDeath;
+    uint32_t seed;
+    bool opened;
+    int64_t openStartedUs;
+    bool pending;
+    int64_t requestAtUs;
+    int64_t replyAtUs;
+    bool replyReady;
+    uint8_t request[NtpSync::PACKET_SIZE];
+    uint8_t reply[NtpSync::PACKET_SIZE];
+    uint32_t requests;
+    uint32_t replies;
+};
+
+#endif // __LOCAL_NTP_SERVER_H__
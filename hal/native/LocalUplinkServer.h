@@ -0,0 +1,212 @@
+#ifndef __LOCAL_UPLINK_SERVER_H__
+#define __LOCAL_UPLINK_SERVER_H__
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include "../../src/Uplink.h"
+
+// UplinkTransport answered by an in-process HTTP collector, for host tests of Uplink. It decodes
+// every batch it acknowledges, hands the samples to an optional callback and counts duplicates
+// and gaps, so outage and recovery runs can check that nothing was lost or delivered twice.
+//
+// Outages are set up with setReachable() (connects fail, an open connection drops),
+// setStatus() (e.g. 503), setDropReplyEvery() (the request arrives but the reply is lost, as
+// when the link dies mid-request) and setCloseAfter() (the server ends keep-alive connections
+// after that many requests). The host drives time with advance().
+class LocalUplinkServer : public UplinkTransport {
+public:
+    static constexpr size_t MAX_REQUEST = 1024;
+    static constexpr size_t MAX_BOOTS   = 4;
+
+    using SampleFn = void (*)(void* context, const LightSample& s);
+
+    struct Counters {
+        uint32_t connections;
+        uint32_t requests;
+        uint32_t batches;       // accepted, not counting duplicates
+        uint32_t duplicates;    // resends of a batch already accepted
+        uint32_t samples;
+        uint32_t gaps;          // batches whose first sequence did not follow the previous batch
+        uint32_t malformed;
+        uint32_t repliesDropped;
+    };
+
+    LocalUplinkServer()
+        : nowMs(0), reachable(true), connectMs(0), replyMs(20), statusCode(204), closeAfter(0), dropReplyEvery(0),
+          onSample(nullptr), sampleContext(nullptr), connecting(false), connectStartedMs(0), open(false),
+          requestsOnConnection(0), requestLen(0), replyLen(0), replyRead(0), replyAtMs(0), replyPending(false),
+          closeAfterReply(false), bootsSeen(0), counters() {}
+
+    void advance(uint32_t ms) { nowMs += ms; }
+    uint32_t now() const { return nowMs; }
+
+    void setReachable(bool r) {
+        reachable = r;
+        if (!r) open = connecting = false;
+    }
+    void setConnectMs(uint32_t ms) { connectMs = ms; }
+    void setReplyMs(uint32_t ms) { replyMs = ms; }
+    void setStatus(uint16_t code) { statusCode = code; }
+    void setCloseAfter(uint32_t requests) { closeAfter = requests; }  // 0: keep connections open
+    void setDropReplyEvery(uint32_t n) { dropReplyEvery = n; }         // 0: answer every request
+    void setSampleCallback(SampleFn fn, void* context) { onSample = fn; sampleContext = context; }
+    const Counters& getCounters() const { return counters; }
+
+    bool connect() override {
+        if (!reachable) return false;
+        if (open) return true;
+        if (!connecting) {
+            connecting = true;
+            connectStartedMs = nowMs;
+        }
+        if (nowMs - connectStartedMs < connectMs) return false;
+        connecting = false;
+        open = true;
+        requestsOnConnection = 0;
+        requestLen = 0;
+        replyPending = false;
+        counters.connections++;
+        return true;
+    }
+
+    bool connected() override { return open || (replyPending && replyRead < replyLen); }
+
+    size_t write(const uint8_t* data, size_t len) override {
+        if (!open || replyPending) return 0;
+        size_t n = len < MAX_REQUEST - requestLen ? len : MAX_REQUEST - requestLen;
+        memcpy(request + requestLen, data, n);
+        requestLen += n;
+        takeRequest();
+        return n;
+    }
+
+    size_t read(uint8_t* out, size_t capacity) override {
+        if (!replyPending || nowMs < replyAtMs) return 0;
+        size_t n = replyLen - replyRead < capacity ? replyLen - replyRead : capacity;
+        memcpy(out, reply + replyRead, n);
+        replyRead += n;
+        if (replyRead == replyLen) {
+            replyPending = false;
+            if (closeAfterReply) open = false;
+        }
+        return n;
+    }
+
+    void close() override {
+        open = connecting = false;
+        replyPending = false;
+        requestLen = 0;
+    }
+
+private:
+    // Handles a request once its head and Content-Length bytes of body have arrived.
+    void takeRequest() {
+        request[requestLen] = 0;
+        const char* end = strstr((const char*)request, "\r\n\r\n");
+        if (!end) return;
+        size_t headLen = (size_t)(end - (const char*)request) + 4;
+        const char* length = strcasestr((const char*)request, "\r\nContent-Length:");
+        size_t bodyLen = length ? strtoul(length + 17, nullptr, 10) : 0;
+        if (requestLen < headLen + bodyLen) return;
+
+        counters.requests++;
+        requestsOnConnection++;
+        uint16_t code = statusCode;
+        if (code >= 200 && code < 300 && !accept(request + headLen, bodyLen)) code = 400;
+        requestLen = 0;
+
+        if (dropReplyEvery && counters.requests % dropReplyEvery == 0) {
+            counters.repliesDropped++;
+            open = false;
+            return;
+        }
+        closeAfterReply = closeAfter && requestsOnConnection >= closeAfter;
+        int n = snprintf((char*)reply, sizeof(reply), "HTTP/1.1 %u %s\r\nContent-Length: 2\r\n%s\r\nok",
+                         (unsigned)code, code < 300 ? "OK" : "Error", closeAfterReply ? "Connection: close\r\n" : "");
+        replyLen = n > 0 ? (size_t)n : 0;
+        replyRead = 0;
+        replyAtMs = nowMs + replyMs;
+        replyPending = true;
+    }
+
+    bool accept(const uint8_t* body, size_t len) {
+        Uplink::BatchHeader h;
+        if (!Uplink::parseHeader(body, len, h) || h.encoding != Uplink::ENCODING_DELTA) {
+            counters.malformed++;
+            return false;
+        }
+        Boot* boot = findBoot(h.bootId);
+        if (boot->seen && (int32_t)(h.batchSequence - boot->lastBatch) <= 0) {
+            counters.duplicates++;
+            return true;
+        }
+        LightSample samples[Uplink::MAX_BATCH / SampleCodec::MIN_RECORD_SIZE];
+        SampleCodec::Decoder decoder;
+        size_t n = Uplink::HEADER_SIZE;
+        for (uint16_t i = 0; i < h.recordCount; i++) {
+            samples[i].sequence = h.firstSequence + i;
+            size_t used = decoder.decode(body + n, len - n, samples[i]);
+            if (used == 0) {
+                counters.malformed++;
+                return false;
+            }
+            n += used;
+        }
+        if (boot->seen && h.firstSequence != boot->nextSequence) counters.gaps++;
+        boot->seen = true;
+        boot->lastBatch = h.batchSequence;
+        boot->nextSequence = h.firstSequence + h.recordCount;
+        counters.batches++;
+        counters.samples += h.recordCount;
+        if (onSample) {
+            for (uint16_t i = 0; i < h.recordCount; i++) onSample(sampleContext, samples[i]);
+        }
+        return true;
+    }
+
+    struct Boot {
+        uint32_t id;
+        bool seen;
+        uint32_t lastBatch;
+        uint32_t nextSequence;
+    };
+
+    Boot* findBoot(uint32_t id) {
+        for (size_t i = 0; i < bootsSeen; i++) {
+            if (boots[i].id == id) return &boots[i];
+        }
+        Boot* b = &boots[bootsSeen < MAX_BOOTS ? bootsSeen++ : MAX_BOOTS - 1];
+        b->id = id;
+        b->seen = false;
+        return b;
+    }
+
+    uint32_t nowMs;
+    bool reachable;
+    uint32_t connectMs;
+    uint32_t replyMs;
+    uint16_t statusCode;
+    uint32_t closeAfter;
+    uint32_t dropReplyEvery;
+    SampleFn onSample;
+    void* sampleContext;
+    bool connecting;
+    uint32_t connectStartedMs;
+    bool open;
+    uint32_t requestsOnConnection;
+    uint8_t request[MAX_REQUEST + 1];
+    size_t requestLen;
+    uint8_t reply[128];
+    size_t replyLen;
+    size_t replyRead;
+    uint32_t replyAtMs;
+    bool replyPending;
+    bool closeAfterReply;
+    Boot boots[MAX_BOOTS];
+    size_t bootsSeen;
+    Counters counters;
+};
+
+#endif // __LOCAL_UPLINK_SERVER_H__
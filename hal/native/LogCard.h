@@ -0,0 +1,49 @@
+#ifndef __LOG_CARD_H__
+#define __LOG_CARD_H__
+
+#include "FileBlockFile.h"
+#include "TempDir.h"
+#include "../../src/SampleLog.h"
+#include "../../src/SampleLogReader.h"
+
+// A delta-encoded sample log on a scratch directory and a reader over it, with their own file
+// handles as main.cpp wires them on the SD card. For host tests of the log and what reads it
+// (HTTP /history, the BLE history transfer). Samples written by write() follow sampleAt(), so
+// anything read back can be checked against its timestamp.
+class LogCard {
+public:
+    TempDir dir;
+    FileBlockFile logFile, indexFile, readData, readIndex;
+    SampleLog log;
+    SampleLogReader reader;
+
+    LogCard()
+        : logFile(dir.path()), indexFile(dir.path()), readData(dir.path()), readIndex(dir.path()),
+          log(logFile, indexFile, SampleLog::blocksPerDay(1000, SampleLog::ENCODING_DELTA)), reader(readData, readIndex) {
+        log.setEncoding(SampleLog::ENCODING_DELTA);
+    }
+
+    // count samples, intervalMs apart, from fromMs, then commits them. False if an append failed.
+    bool write(uint64_t fromMs, uint32_t count, uint32_t intervalMs = 1000) {
+        for (uint32_t i = 0; i < count; i++) {
+            if (!log.append(sampleAt(fromMs + (uint64_t)i * intervalMs))) return false;
+        }
+        log.flush();
+        return true;
+    }
+
+    static uint32_t luxAt(uint64_t ms) { return 20000 + (uint32_t)((ms / 1000) % 5000); }
+
+    // The sample write() logs at ms (the log assigns the sequence).
+    static LightSample sampleAt(uint64_t ms) {
+        LightSample s = {};
+        s.timestampMs = ms;
+        s.centiLux = luxAt(ms);
+        s.fullCount = (uint16_t)(s.centiLux / 4);
+        s.irCount = (uint16_t)(s.centiLux / 16);
+        s.control = 0x11;
+        return s;
+    }
+};
+
+#endif // __LOG_CARD_H__
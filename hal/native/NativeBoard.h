@@ -0,0 +1,262 @@
+#ifndef __NATIVE_BOARD_H__
+#define __NATIVE_BOARD_H__
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <NimBLEDevice.h>
+#include "NativeKernel.h"
+#include "I2cBus.h"
+#include "SimulatedTsl2591.h"
+#include "Tsl2591I2cDevice.h"
+#include "SimulatedDs3231.h"
+#include "Ds3231I2cDevice.h"
+#include "SimulatedAccessPoint.h"
+#include "LocalNtpServer.h"
+
+// How the native board is set up; filled in from the command line (see NativeMain.cpp).
+struct NativeBoardOptions {
+    double speed;              // simulated seconds per host second; 0: as fast as possible
+    double durationS;          // stop after this much simulated time; 0: run until killed
+    const char* dataDir;       // holds sd/ (the card) and nvs/ (Preferences)
+    bool sdCard;
+    double lux;                // scene brightness
+    double noisePercent;       // +/- per second
+    double centralAtS;         // when the simulated central connects; < 0: never
+    const char* provision;     // "SSID,PASS" written by the central after connecting, or nullptr
+    const char* apSsid;
+    const char* apPassword;
+    const char* collector;     // address the uplink collector name resolves to
+    double rtcDriftPpm;
+    double rtcOffsetS;         // RTC minus true time at power-up
+    bool quiet;                // no console output from the firmware
+    uint32_t seed;
+};
+
+// The simulated ESP32 board behind NativeHal.h: the kernel, a TSL2591 (INT on GPIO 4) and a
+// DS3231 on the I2C bus, one access point with an NTP server behind it, and a BLE central that
+// connects, subscribes to everything that notifies and optionally provisions Wi-Fi. Devices are
+// stepped by the kernel in simulated time; the collector and the HTTP server use host sockets.
+class NativeBoard {
+public:
+    static constexpr int TSL_INT_PIN = 4;
+    static constexpr uint32_t NTP_ADDRESS = 0x7B7100CBu;   // 203.0.113.123, network byte order
+    static constexpr uint32_t LOCAL_ADDRESS = 0x0100007Fu; // 127.0.0.1: the HTTP server is on the host
+    static constexpr uint16_t NTP_PORT = 123;
+
+    static constexpr uint16_t CENTRAL_CONN_HANDLE  = 1;
+    static constexpr uint16_t CENTRAL_INTERVAL     = 24;   // 30 ms
+    static constexpr uint16_t CENTRAL_MTU          = 247;
+    static constexpr uint32_t CREDITS_PER_INTERVAL = 8;    // notifications the link takes per event
+    static constexpr int CENTRAL_PRIORITY = 5;             // the NimBLE host task's, relative to the app's
+
+    // The settings characteristic taking "SSID,PASS" (BleLightSensorService).
+    static constexpr const char* UUID_WIFI_CREDENTIALS = "B2C1A3B2-7E2F-4F4C-9F1D-3A2B1C0D4E5F";
+
+    static constexpr double IR_FRACTION = 0.25;
+
+    struct Stats {
+        uint32_t notifications;
+        uint64_t notifyBytes;
+        uint32_t notifyRejected;  // out of credits, too long, or not connected
+        uint32_t udpSent;
+        uint32_t lookups;
+    };
+
+    static NativeBoard& instance() {
+        static NativeBoard board;
+        return board;
+    }
+
+    NativeBoard()
+        : options{}, tslDevice(tsl), rtc(0, 0), rtcDevice(rtc), ap(apSsid, apPassword), ntp(0),
+          rngState(1), sceneLux(0), centralConnected(false), creditEvent(UINT64_MAX), credits(0),
+          advertising(false), stats{} {
+        sdRoot[0] = nvsRoot[0] = apSsid[0] = apPassword[0] = '\0';
+    }
+
+    // Powers the board up: wires devices, sets clocks from the host's, starts the central. The
+    // calling thread becomes the Arduino loopTask.
+    void begin(const NativeBoardOptions& o) {
+        options = o;
+        rngState = o.seed ? o.seed : 1;
+        snprintf(sdRoot, sizeof(sdRoot), "%s/sd", o.dataDir);
+        snprintf(nvsRoot, sizeof(nvsRoot), "%s/nvs", o.dataDir);
+        mkdir(o.dataDir, 0755);
+
+        struct timeval tv;
+        gettimeofday(&tv, nullptr);
+        int64_t wallUs = (int64_t)tv.tv_sec * 1000000 + tv.tv_usec;
+        ntp = LocalNtpServer(wallUs);
+        rtc = SimulatedDs3231((uint32_t)(tv.tv_sec + (int64_t)o.rtcOffsetS), (float)o.rtcDriftPpm);
+
+        snprintf(apSsid, sizeof(apSsid), "%s", o.apSsid);
+        snprintf(apPassword, sizeof(apPassword), "%s", o.apPassword);
+        ap.addNeighbour("Cafe-Guest", -78, 1, WifiDriver::AUTH_OPEN);
+        ap.addNeighbour("Neighbour-5G", -84, 36, WifiDriver::AUTH_WPA2_PSK);
+        ap.addNeighbour("Printer-Direct", -71, 11, WifiDriver::AUTH_WPA2_WPA3_PSK);
+
+        bus.attach(Tsl2591I2cDevice::ADDRESS, &tslDevice);
+        bus.attach(Ds3231I2cDevice::ADDRESS, &rtcDevice);
+        updateScene();
+
+        kernel.setSpeed(o.speed);
+        kernel.addStepHook(stepDevices, this);
+        kernel.wirePin(TSL_INT_PIN, tslInterruptLevel, this);
+        kernel.adoptCurrentThread("loopTask", 1);
+        if (o.centralAtS >= 0) kernel.create(centralEntry, "nimble_host", this, CENTRAL_PRIORITY);
+    }
+
+    void stopAfter(uint64_t us, NativeKernel::DeadlineHook hook, void* ctx) { kernel.setDeadline(us, hook, ctx); }
+
+    NativeKernel& getKernel() { return kernel; }
+    I2cBus& getBus() { return bus; }
+    SimulatedTsl2591& getTsl() { return tsl; }
+    SimulatedDs3231& getRtc() { return rtc; }
+    LocalNtpServer& getNtp() { return ntp; }
+    SimulatedAccessPoint& getAccessPoint() { return ap; }
+    const NativeBoardOptions& getOptions() const { return options; }
+    const Stats& getStats() const { return stats; }
+
+    // Changes the scene brightness from the next conversion on (benchmarks step it to defeat the deadband).
+    void setLux(double lux) {
+        options.lux = lux;
+        updateScene();
+    }
+
+    const char* sdPath() const { return options.sdCard ? sdRoot : nullptr; }
+    const char* nvsPath() const { return nvsRoot; }
+
+    // xorshift32: reproducible for a given --seed.
+    uint32_t random() {
+        rngState ^= rngState << 13;
+        rngState ^= rngState >> 17;
+        rngState ^= rngState << 5;
+        return rngState;
+    }
+
+    // --- Wi-Fi and the network behind the access point ---
+
+    bool wifiUp() { return ap.status() == WifiDriver::LINK_UP; }
+
+    bool resolve(const char* host, uint32_t& address) {
+        stats.lookups++;
+        if (!wifiUp()) return false;
+        if (strcmp(host, "pool.ntp.org") == 0) {
+            address = NTP_ADDRESS;
+            return true;
+        }
+        if (strcmp(host, "photoniq-collector.local") == 0) host = options.collector;
+        return resolveOnHost(host, address);
+    }
+
+    bool udpSend(uint32_t address, uint16_t port, const uint8_t* data, size_t len) {
+        if (!wifiUp()) return false;
+        stats.udpSent++;
+        if (address != NTP_ADDRESS || port != NTP_PORT) return true; // sent, and lost
+        return ntp.open() && ntp.send(data, len);
+    }
+
+    size_t udpReceive(uint8_t* out, size_t capacity) {
+        return wifiUp() ? ntp.receive(out, capacity) : 0;
+    }
+
+    // --- BLE: the central's end of the link ---
+
+    // The link takes CREDITS_PER_INTERVAL notifications per connection event; beyond that the
+    // stack's queue is full and notify() fails until the next event.
+    bool bleNotify(uint16_t connHandle, uint16_t attrHandle, const uint8_t* data, size_t len) {
+        if (!centralConnected || connHandle != CENTRAL_CONN_HANDLE || len > (size_t)CENTRAL_MTU - 3) {
+            stats.notifyRejected++;
+            return false;
+        }
+        uint64_t event = kernel.now() / ((uint64_t)CENTRAL_INTERVAL * 1250);
+        if (event != creditEvent) {
+            creditEvent = event;
+            credits = CREDITS_PER_INTERVAL;
+        }
+        if (credits == 0) {
+            stats.notifyRejected++;
+            return false;
+        }
+        credits--;
+        stats.notifications++;
+        stats.notifyBytes += len;
+        return true;
+    }
+
+    void bleAdvertising(bool on) { advertising = on; }
+
+private:
+    static bool resolveOnHost(const char* host, uint32_t& address);
+
+    static void stepDevices(void* ctx, uint64_t nowUs) {
+        NativeBoard* self = static_cast<NativeBoard*>(ctx);
+        uint32_t ms = (uint32_t)(NativeKernel::STEP_US / 1000);
+        self->tsl.advance(ms);
+        self->rtc.advance(NativeKernel::STEP_US);
+        self->ap.advance(ms);
+        self->ntp.advance(NativeKernel::STEP_US);
+        if (nowUs % 1000000 == 0) self->updateScene();
+    }
+
+    // INT is active low.
+    static int tslInterruptLevel(void* ctx) {
+        return static_cast<NativeBoard*>(ctx)->tsl.interruptAsserted() ? 0 : 1;
+    }
+
+    void updateScene() {
+        double noise = options.noisePercent / 100.0 * ((double)(random() % 20001) / 10000.0 - 1.0);
+        sceneLux = options.lux * (1.0 + noise);
+        if (sceneLux < 0) sceneLux = 0;
+        tsl.setScene(sceneLux / (408.0 * (1 - IR_FRACTION) * (1 - IR_FRACTION)), IR_FRACTION);
+    }
+
+    static void centralEntry(void* arg) { static_cast<NativeBoard*>(arg)->runCentral(); }
+
+    // Waits for the server to advertise, connects, subscribes to every characteristic that
+    // notifies, and writes the provisioning credentials if there are any.
+    void runCentral() {
+        nativeSleepUntilUs((uint64_t)(options.centralAtS * 1e6));
+        NimBLEServer* server = NimBLEDevice::getServer();
+        while (!server || !server->isStarted() || !advertising) {
+            nativeSleepUntilUs(kernel.now() + 100000);
+            server = NimBLEDevice::getServer();
+        }
+        NimBLEConnInfo info(CENTRAL_CONN_HANDLE, CENTRAL_INTERVAL, CENTRAL_MTU, "4a:11:c0:de:00:01");
+        centralConnected = true;
+        server->nativeConnect(info, NimBLEDevice::getAdvertising());
+        for (NimBLECharacteristic* c : server->nativeCharacteristics()) c->nativeSubscribe(info, 1);
+        if (options.provision) {
+            NimBLECharacteristic* c = server->nativeFind(UUID_WIFI_CREDENTIALS);
+            if (c) c->nativeWrite(info, (const uint8_t*)options.provision, strlen(options.provision));
+        }
+        nativeTaskExit();
+    }
+
+    NativeBoardOptions options;
+    NativeKernel kernel;
+    I2cBus bus;
+    SimulatedTsl2591 tsl;
+    Tsl2591I2cDevice tslDevice;
+    SimulatedDs3231 rtc;
+    Ds3231I2cDevice rtcDevice;
+    SimulatedAccessPoint ap;
+    LocalNtpServer ntp;
+    uint32_t rngState;
+    double sceneLux;
+    bool centralConnected;
+    uint64_t creditEvent;
+    uint32_t credits;
+    bool advertising;
+    char apSsid[33];
+    char apPassword[65];
+    char sdRoot[256];
+    char nvsRoot[256];
+    Stats stats;
+};
+
+#endif // __NATIVE_BOARD_H__
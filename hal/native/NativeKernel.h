@@ -0,0 +1,314 @@
+#ifndef __NATIVE_KERNEL_H__
+#define __NATIVE_KERNEL_H__
+
+#include <stdint.h>
+#include <string.h>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include "include/NativeHal.h"
+
+// One task of the native kernel. Each runs on its own host thread, but only the one the kernel
+// has chosen (NativeKernel::running) ever executes; the others wait on their condition variable.
+struct NativeTask {
+    enum State : uint8_t { READY, SLEEPING, WAITING, DONE };
+
+    char name[16];
+    int priority;
+    State state;
+    uint64_t wakeUs;        // SLEEPING: wake time; WAITING: notification deadline
+    uint32_t notifications;
+    void (*entry)(void*);
+    void* arg;
+    std::condition_variable turn;
+};
+
+// FreeRTOS semantics on one simulated core, in simulated time. The highest-priority ready task
+// runs (round-robin among equals) until it blocks; a notification to a higher-priority task
+// preempts the giver. Time stands still while a task runs and only moves when every task is
+// blocked: the kernel then steps it a millisecond at a time, running the board's device models
+// and raising pin interrupts after each step, and stops as soon as something is ready again.
+// With speed > 0 the steps are paced against the host clock (1: real time); 0 runs flat out.
+class NativeKernel {
+public:
+    static constexpr size_t MAX_TASKS = 16;
+    static constexpr size_t MAX_HOOKS = 8;
+    static constexpr size_t MAX_PINS  = 8;
+    static constexpr uint64_t STEP_US = 1000;
+
+    typedef void (*StepHook)(void* ctx, uint64_t nowUs);
+    typedef int (*PinLevel)(void* ctx);
+    typedef void (*DeadlineHook)(void* ctx);
+
+    struct Stats {
+        uint64_t steps;
+        uint64_t contextSwitches;
+        uint32_t tasksCreated;
+        uint32_t interrupts;
+    };
+
+    NativeKernel()
+        : nowUs(0), running(nullptr), taskCount(0), cursor(0), hookCount(0), pinCount(0), speed(1.0),
+          deadlineUs(NATIVE_FOREVER), onDeadline(nullptr), deadlineCtx(nullptr), inInterrupt(false), stats{} {}
+
+    void setSpeed(double s) { speed = s; }
+
+    // Called once, from the thread that has reached the deadline, with every task parked.
+    void setDeadline(uint64_t us, DeadlineHook hook, void* ctx) {
+        deadlineUs = us;
+        onDeadline = hook;
+        deadlineCtx = ctx;
+    }
+
+    bool addStepHook(StepHook hook, void* ctx) {
+        if (hookCount >= MAX_HOOKS) return false;
+        hooks[hookCount].fn = hook;
+        hooks[hookCount++].ctx = ctx;
+        return true;
+    }
+
+    // Wires a device output to a GPIO; unwired pins read high (pulled up).
+    bool wirePin(int pin, PinLevel level, void* ctx) {
+        Pin* p = pinFor(pin);
+        if (!p) return false;
+        p->level = level;
+        p->levelCtx = ctx;
+        p->last = level(ctx);
+        return true;
+    }
+
+    // The calling thread becomes a task (the Arduino loopTask) and starts running.
+    NativeTask* adoptCurrentThread(const char* name, int priority) {
+        std::lock_guard<std::mutex> lock(mutex);
+        NativeTask* t = allocate(name, priority, nullptr, nullptr);
+        self() = t;
+        running = t;
+        realStart = std::chrono::steady_clock::now();
+        return t;
+    }
+
+    uint64_t now() const { return nowUs; }
+    NativeTask* current() const { return self(); }
+    const Stats& getStats() const { return stats; }
+
+    NativeTask* create(void (*entry)(void*), const char* name, void* arg, int priority) {
+        std::unique_lock<std::mutex> lock(mutex);
+        NativeTask* t = allocate(name, priority, entry, arg);
+        if (!t) return nullptr;
+        stats.tasksCreated++;
+        std::thread(&NativeKernel::trampoline, this, t).detach();
+        NativeTask* me = self();
+        if (me && running == me && priority > me->priority) block(lock, me, NativeTask::READY);
+        return t;
+    }
+
+    void sleepUntil(uint64_t us) {
+        std::unique_lock<std::mutex> lock(mutex);
+        NativeTask* me = self();
+        me->wakeUs = us;
+        block(lock, me, us > nowUs ? NativeTask::SLEEPING : NativeTask::READY);
+    }
+
+    void yield() {
+        std::unique_lock<std::mutex> lock(mutex);
+        block(lock, self(), NativeTask::READY);
+    }
+
+    // The calling task ends. Its thread stays parked; nothing is reclaimed.
+    [[noreturn]] void exit() {
+        std::unique_lock<std::mutex> lock(mutex);
+        NativeTask* me = self();
+        me->state = NativeTask::DONE;
+        dispatch(lock);
+        for (;;) me->turn.wait(lock);
+    }
+
+    uint32_t notifyTake(bool clear, uint64_t deadline) {
+        std::unique_lock<std::mutex> lock(mutex);
+        NativeTask* me = self();
+        if (me->notifications == 0 && deadline > nowUs) {
+            me->wakeUs = deadline;
+            block(lock, me, NativeTask::WAITING);
+        }
+        uint32_t value = me->notifications;
+        if (value) me->notifications = clear ? 0 : value - 1;
+        return value;
+    }
+
+    // From a task or from an interrupt handler; only a task giving is preempted.
+    void notifyGive(NativeTask* t) {
+        if (!t) return;
+        std::unique_lock<std::mutex> lock(mutex);
+        t->notifications++;
+        if (t->state == NativeTask::WAITING) t->state = NativeTask::READY;
+        NativeTask* me = self();
+        if (!inInterrupt && me && running == me && t->priority > me->priority) block(lock, me, NativeTask::READY);
+    }
+
+    int pinRead(int pin) {
+        for (size_t i = 0; i < pinCount; i++) {
+            if (pins[i].pin == pin) return pins[i].level ? pins[i].level(pins[i].levelCtx) : 1;
+        }
+        return 1;
+    }
+
+    void attachInterrupt(int pin, void (*handler)(void*), void* arg, int mode) {
+        Pin* p = pinFor(pin);
+        if (!p) return;
+        p->handler = handler;
+        p->handlerArg = arg;
+        p->mode = mode;
+    }
+
+    void detachInterrupt(int pin) {
+        Pin* p = pinFor(pin);
+        if (p) p->handler = nullptr;
+    }
+
+private:
+    struct Hook {
+        StepHook fn;
+        void* ctx;
+    };
+
+    struct Pin {
+        int pin;
+        PinLevel level;
+        void* levelCtx;
+        int last;
+        void (*handler)(void*);
+        void* handlerArg;
+        int mode;
+    };
+
+    static constexpr int MODE_RISING  = 0x01;
+    static constexpr int MODE_FALLING = 0x02;
+
+    static NativeTask*& self() {
+        thread_local NativeTask* task = nullptr;
+        return task;
+    }
+
+    NativeTask* allocate(const char* name, int priority, void (*entry)(void*), void* arg) {
+        if (taskCount >= MAX_TASKS) return nullptr;
+        NativeTask* t = &tasks[taskCount++];
+        strncpy(t->name, name, sizeof(t->name) - 1);
+        t->name[sizeof(t->name) - 1] = '\0';
+        t->priority = priority;
+        t->state = NativeTask::READY;
+        t->wakeUs = 0;
+        t->notifications = 0;
+        t->entry = entry;
+        t->arg = arg;
+        return t;
+    }
+
+    Pin* pinFor(int pin) {
+        for (size_t i = 0; i < pinCount; i++) {
+            if (pins[i].pin == pin) return &pins[i];
+        }
+        if (pinCount >= MAX_PINS) return nullptr;
+        Pin* p = &pins[pinCount++];
+        *p = Pin{pin, nullptr, nullptr, 1, nullptr, nullptr, 0};
+        return p;
+    }
+
+    void trampoline(NativeTask* t) {
+        self() = t;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            t->turn.wait(lock, [&] { return running == t; });
+        }
+        t->entry(t->arg);
+        exit();
+    }
+
+    // Gives up the core in the given state and returns once the task is chosen to run again.
+    void block(std::unique_lock<std::mutex>& lock, NativeTask* me, NativeTask::State state) {
+        me->state = state;
+        dispatch(lock);
+        me->turn.wait(lock, [&] { return running == me; });
+    }
+
+    // Chooses the next task to run, moving time forward until there is one.
+    void dispatch(std::unique_lock<std::mutex>& lock) {
+        for (;;) {
+            NativeTask* next = pick();
+            if (next) {
+                if (next != running) stats.contextSwitches++;
+                running = next;
+                next->turn.notify_one();
+                return;
+            }
+            running = nullptr;
+            step(lock);
+        }
+    }
+
+    NativeTask* pick() {
+        NativeTask* best = nullptr;
+        size_t bestIndex = cursor;
+        for (size_t i = 0; i < taskCount; i++) {
+            size_t index = (cursor + 1 + i) % taskCount;
+            NativeTask* t = &tasks[index];
+            if ((t->state == NativeTask::SLEEPING || t->state == NativeTask::WAITING) && nowUs >= t->wakeUs) {
+                t->state = NativeTask::READY;
+            }
+            if (t->state == NativeTask::READY && (!best || t->priority > best->priority)) {
+                best = t;
+                bestIndex = index;
+            }
+        }
+        cursor = bestIndex;
+        return best;
+    }
+
+    // One millisecond of the board: device models, then pin edges, then pacing. Runs with the
+    // lock released (no task is running), so interrupt handlers can notify tasks.
+    void step(std::unique_lock<std::mutex>& lock) {
+        nowUs += STEP_US;
+        stats.steps++;
+        lock.unlock();
+        if (nowUs >= deadlineUs && onDeadline) onDeadline(deadlineCtx);
+        inInterrupt = true;
+        for (size_t i = 0; i < hookCount; i++) hooks[i].fn(hooks[i].ctx, nowUs);
+        for (size_t i = 0; i < pinCount; i++) {
+            Pin& p = pins[i];
+            if (!p.level) continue;
+            int level = p.level(p.levelCtx);
+            if (level == p.last) continue;
+            p.last = level;
+            bool fire = (level && (p.mode & MODE_RISING)) || (!level && (p.mode & MODE_FALLING));
+            if (fire && p.handler) {
+                stats.interrupts++;
+                p.handler(p.handlerArg);
+            }
+        }
+        inInterrupt = false;
+        if (speed > 0) {
+            std::this_thread::sleep_until(realStart + std::chrono::microseconds((int64_t)(nowUs / speed)));
+        }
+        lock.lock();
+    }
+
+    std::mutex mutex;
+    uint64_t nowUs;
+    NativeTask* running;
+    NativeTask tasks[MAX_TASKS];
+    size_t taskCount;
+    size_t cursor;
+    Hook hooks[MAX_HOOKS];
+    size_t hookCount;
+    Pin pins[MAX_PINS];
+    size_t pinCount;
+    double speed;
+    uint64_t deadlineUs;
+    DeadlineHook onDeadline;
+    void* deadlineCtx;
+    bool inInterrupt;
+    std::chrono::steady_clock::time_point realStart;
+    Stats stats;
+};
+
+#endif // __NATIVE_KERNEL_H__
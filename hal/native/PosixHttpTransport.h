@@ -0,0 +1,84 @@
+#ifndef __POSIX_HTTP_TRANSPORT_H__
+#define __POSIX_HTTP_TRANSPORT_H__
+
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include "../../src/HttpServer.h"
+
+// HttpTransport over host sockets, for host tests of HttpServer (test_http_server). listen(0)
+// takes an ephemeral port, so tests can run side by side. Listens on the loopback interface
+// unless told otherwise. (The native simulation runs the firmware's ArduinoHttpTransport, whose
+// lwIP sockets are the host's there.)
+class PosixHttpTransport : public HttpTransport {
+public:
+    explicit PosixHttpTransport(bool loopbackOnly_ = true) : loopbackOnly(loopbackOnly_), listener(-1) {}
+    ~PosixHttpTransport() override {
+        if (listener >= 0) ::close(listener);
+    }
+
+    bool listen(uint16_t port) override {
+        listener = socket(AF_INET, SOCK_STREAM, 0);
+        if (listener < 0) return false;
+        int one = 1;
+        setsockopt(listener, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+        sockaddr_in addr;
+        memset(&addr, 0, sizeof(addr));
+        addr.sin_family = AF_INET;
+        addr.sin_port = htons(port);
+        addr.sin_addr.s_addr = htonl(loopbackOnly ? INADDR_LOOPBACK : INADDR_ANY);
+        if (bind(listener, (sockaddr*)&addr, sizeof(addr)) != 0 || ::listen(listener, 8) != 0) {
+            ::close(listener);
+            listener = -1;
+            return false;
+        }
+        fcntl(listener, F_SETFL, fcntl(listener, F_GETFL, 0) | O_NONBLOCK);
+        return true;
+    }
+
+    // The port actually bound, for listen(0).
+    uint16_t boundPort() const {
+        sockaddr_in addr;
+        socklen_t len = sizeof(addr);
+        if (listener < 0 || getsockname(listener, (sockaddr*)&addr, &len) != 0) return 0;
+        return ntohs(addr.sin_port);
+    }
+
+    int accept() override {
+        if (listener < 0) return -1;
+        int fd = ::accept(listener, nullptr, nullptr);
+        if (fd < 0) return -1;
+        fcntl(fd, F_SETFL, fcntl(fd, F_GETFL, 0) | O_NONBLOCK);
+        int one = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+        return fd;
+    }
+
+    int read(int conn, uint8_t* out, size_t capacity) override {
+        ssize_t n = recv(conn, out, capacity, MSG_DONTWAIT);
+        if (n > 0) return (int)n;
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) return 0;
+        return -1;
+    }
+
+    int write(int conn, const uint8_t* data, size_t len) override {
+        ssize_t n = send(conn, data, len, MSG_DONTWAIT | MSG_NOSIGNAL);
+        if (n >= 0) return (int)n;
+        return errno == EAGAIN || errno == EWOULDBLOCK ? 0 : -1;
+    }
+
+    void close(int conn) override {
+        ::close(conn);
+    }
+
+private:
+    bool loopbackOnly;
+    int listener;
+};
+
+#endif // __POSIX_HTTP_TRANSPORT_H__
@@ -0,0 +1,139 @@
+#ifndef __SIMULATED_ACCESS_POINT_H__
+#define __SIMULATED_ACCESS_POINT_H__
+
+#include <string.h>
+#include "../../src/WifiDriver.h"
+
+// WifiDriver backed by a single simulated access point for native builds. Association takes
+// associateMs of simulated time; a wrong SSID, an AP out of range, or a wrong password is
+// reported then, the way the ESP32 stack reports it after its own scan and handshake. The host
+// drives time with advance() and can take the AP away or drop the link mid-connection.
+// Scans take scanMs and report the AP itself (while in range) plus any neighbours added with
+// addNeighbour().
+class SimulatedAccessPoint : public WifiDriver {
+public:
+    SimulatedAccessPoint(const char* ssid_, const char* password_, uint32_t associateMs_ = 500)
+        : ssid(ssid_), password(password_), associateMs(associateMs_), inRange(true), silent(false),
+          associating(false), elapsedMs(0), link(LINK_DOWN), begins(0),
+          scanMs(2000), scanning(false), scanElapsedMs(0), scanFails(false), scanCount(-1), scans(0), neighbourCount(0) {
+        setEntry(self, ssid, -55, 6, AUTH_WPA2_PSK);
+    }
+
+    static constexpr size_t MAX_NEIGHBOURS = 63;
+
+    bool addNeighbour(const char* name, int8_t rssi, uint8_t channel, uint8_t auth) {
+        if (neighbourCount >= MAX_NEIGHBOURS) return false;
+        setEntry(neighbours[neighbourCount++], name, rssi, channel, auth);
+        return true;
+    }
+
+    void setRssi(int8_t rssi) { self.rssi = rssi; }
+    void setScanMs(uint32_t ms) { scanMs = ms; }
+    void setScanFails(bool fails) { scanFails = fails; }
+    uint32_t scanStartCount() const { return scans; }
+
+    void setInRange(bool inRange_) {
+        inRange = inRange_;
+        if (!inRange && link == LINK_UP) link = LINK_DOWN;
+    }
+
+    // An AP that never answers: attempts only end by the connection's own timeout.
+    void setSilent(bool silent_) { silent = silent_; }
+
+    void setAssociateMs(uint32_t ms) { associateMs = ms; }
+
+    void dropLink() {
+        if (link == LINK_UP) link = LINK_DOWN;
+    }
+
+    void advance(uint32_t ms) {
+        if (scanning) {
+            scanElapsedMs += ms;
+            if (scanElapsedMs >= scanMs) {
+                scanning = false;
+                scanCount = scanFails ? SCAN_FAILED : (int)neighbourCount + (inRange ? 1 : 0);
+            }
+        }
+        if (!associating) return;
+        elapsedMs += ms;
+        if (silent || elapsedMs < associateMs) return;
+        associating = false;
+        if (!inRange || strcmp(requestedSsid, ssid) != 0) link = LINK_NO_AP;
+        else if (strcmp(requestedPassword, password) != 0) link = LINK_AUTH_FAILED;
+        else link = LINK_UP;
+    }
+
+    void begin(const char* ssid_, const char* password_) override {
+        strncpy(requestedSsid, ssid_, sizeof(requestedSsid) - 1);
+        requestedSsid[sizeof(requestedSsid) - 1] = '\0';
+        strncpy(requestedPassword, password_, sizeof(requestedPassword) - 1);
+        requestedPassword[sizeof(requestedPassword) - 1] = '\0';
+        associating = true;
+        elapsedMs = 0;
+        link = LINK_DOWN;
+        begins++;
+    }
+
+    void disconnect() override {
+        associating = false;
+        link = LINK_DOWN;
+    }
+
+    LinkStatus status() override { return link; }
+
+    bool startScan() override {
+        if (scanning) return false;
+        scanning = true;
+        scanElapsedMs = 0;
+        scans++;
+        return true;
+    }
+
+    int scanStatus() override { return scanning ? SCAN_RUNNING : scanCount; }
+
+    bool scanEntry(int index, ScanEntry& out) override {
+        if (scanning || index < 0 || index >= scanCount) return false;
+        if (inRange && index == 0) out = self;
+        else out = neighbours[index - (inRange ? 1 : 0)];
+        return true;
+    }
+
+    void scanDelete() override { scanCount = -1; }
+
+    uint32_t beginCount() const { return begins; }
+
+private:
+    const char* ssid;
+    const char* password;
+    uint32_t associateMs;
+    bool inRange;
+    bool silent;
+    bool associating;
+    uint32_t elapsedMs;
+    LinkStatus link;
+    uint32_t begins;
+
+    static void setEntry(ScanEntry& e, const char* name, int8_t rssi, uint8_t channel, uint8_t auth) {
+        size_t n = 0; // strnlen() would do, but GCC's overread check trips on short literal names
+        while (n < sizeof(e.ssid) - 1 && name[n]) n++;
+        memcpy(e.ssid, name, n);
+        e.ssid[n] = '\0';
+        e.rssi = rssi;
+        e.channel = channel;
+        e.auth = auth;
+    }
+
+    uint32_t scanMs;
+    bool scanning;
+    uint32_t scanElapsedMs;
+    bool scanFails;
+    int scanCount;
+    uint32_t scans;
+    ScanEntry self;
+    ScanEntry neighbours[MAX_NEIGHBOURS];
+    size_t neighbourCount;
+    char requestedSsid[33];
+    char requestedPassword[65];
+};
+
+#endif // __SIMULATED_ACCESS_POINT_H__
@@ -0,0 +1,66 @@
+#ifndef __SIMULATED_DS3231_H__
+#define __SIMULATED_DS3231_H__
+
+#include <stdint.h>
+#include "../../src/RtcDevice.h"
+
+// DS3231 stand-in for native builds. It keeps its own time, which runs at a configurable
+// frequency error (driftPpm, positive: fast) corrected by the aging offset the way the real
+// part's is, so clock discipline can be checked against a known oscillator. The host drives it
+// with advance() in true microseconds.
+class SimulatedDs3231 : public RtcDevice {
+public:
+    explicit SimulatedDs3231(uint32_t epoch = 1700000000UL, float driftPpm_ = 0)
+        : baseSeconds(epoch), elapsedUs(0), driftPpm(driftPpm_), aging(0), powerLost(false), reads(0), writes(0) {}
+
+    void advance(uint64_t trueUs) {
+        elapsedUs += (double)trueUs * (1.0 + (driftPpm - AGING_PPM_PER_STEP * aging) * 1e-6);
+    }
+
+    void setDriftPpm(float ppm) { driftPpm = ppm; }
+    void setLostPower(bool lost) { powerLost = lost; }
+
+    // The RTC's time with sub-second resolution, for checking the result.
+    double timeSeconds() const { return (double)baseSeconds + elapsedUs / 1e6; }
+    int8_t agingOffset() const { return aging; }
+    uint32_t readCount() const { return reads; }
+    uint32_t writeCount() const { return writes; }
+
+    bool readSeconds(uint32_t& epoch) override {
+        reads++;
+        epoch = baseSeconds + (uint32_t)(elapsedUs / 1e6);
+        return true;
+    }
+
+    bool writeSeconds(uint32_t epoch) override {
+        writes++;
+        baseSeconds = epoch;
+        elapsedUs = 0;
+        powerLost = false;
+        return true;
+    }
+
+    bool readAging(int8_t& out) override {
+        out = aging;
+        return true;
+    }
+
+    bool writeAging(int8_t value) override {
+        aging = value;
+        return true;
+    }
+
+    bool lostPower() override { return powerLost; }
+
+private:
+    // Whole seconds at the last write plus the time since, so sub-ppm rates survive double precision.
+    uint32_t baseSeconds;
+    double elapsedUs;
+    float driftPpm;
+    int8_t aging;
+    bool powerLost;
+    uint32_t reads;
+    uint32_t writes;
+};
+
+#endif // __SIMULATED_DS3231_H__
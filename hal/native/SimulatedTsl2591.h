@@ -0,0 +1,115 @@
+#ifndef __SIMULATED_TSL2591_H__
+#define __SIMULATED_TSL2591_H__
+
+#include <string.h>
+#include "../../src/AutoRange.h"
+#include "../../src/Tsl2591Bus.h"
+
+// Register-level model of a TSL2591 for native builds: continuous ALS cycles, the CH0 interrupt
+// thresholds with the PERSIST filter, and the INT line. The scene is set as counts per
+// (gain x ms); the host drives time with advance() and checks interruptAsserted() the way the
+// firmware's GPIO edge would.
+class SimulatedTsl2591 : public Tsl2591Bus {
+public:
+    SimulatedTsl2591() : rate(0), irFraction(0.25), elapsedMs(0), outside(0), cycles(0), busFailures(0) {
+        memset(regs, 0, sizeof(regs));
+    }
+
+    void setScene(double countsPerGainMs, double irFraction_ = 0.25) {
+        rate = countsPerGainMs;
+        irFraction = irFraction_;
+    }
+
+    // Makes the next n bus transactions fail.
+    void failNext(uint32_t n) { busFailures = n; }
+
+    void advance(uint32_t ms) {
+        if ((regs[REG_ENABLE] & (ENABLE_PON | ENABLE_AEN)) != (ENABLE_PON | ENABLE_AEN)) return;
+        elapsedMs += ms;
+        while (elapsedMs >= cycleMs()) {
+            elapsedMs -= cycleMs();
+            completeCycle();
+        }
+    }
+
+    // INT is open-drain, active low: true means the pin is pulled low.
+    bool interruptAsserted() const {
+        return (regs[REG_ENABLE] & ENABLE_AIEN) && (regs[REG_STATUS] & STATUS_AINT);
+    }
+
+    uint32_t cycleMs() const { return AutoRange::TIMES[regs[REG_CONTROL] & 0x07]; }
+    uint32_t cyclesCompleted() const { return cycles; }
+
+    bool write8(uint8_t reg, uint8_t value) override {
+        if (fail() || reg >= sizeof(regs)) return false;
+        if (reg == REG_ENABLE && !(value & ENABLE_AEN)) {
+            regs[REG_STATUS] &= ~STATUS_AVALID;
+            elapsedMs = 0;
+            outside = 0;
+        }
+        regs[reg] = value;
+        return true;
+    }
+
+    bool command(uint8_t cmd) override {
+        if (fail()) return false;
+        if (cmd == CMD_CLEAR_INTERRUPTS) regs[REG_STATUS] &= ~STATUS_AINT;
+        return true;
+    }
+
+    bool read(uint8_t reg, uint8_t* out, size_t len) override {
+        if (fail() || reg + len > sizeof(regs)) return false;
+        memcpy(out, regs + reg, len);
+        return true;
+    }
+
+private:
+    bool fail() {
+        if (busFailures == 0) return false;
+        busFailures--;
+        return true;
+    }
+
+    // Consecutive out-of-range cycles required by a PERSIST value.
+    static uint32_t persistCycles(uint8_t p) {
+        if (p <= 3) return p;
+        return (uint32_t)(p - 3) * 5;
+    }
+
+    void completeCycle() {
+        uint8_t time = regs[REG_CONTROL] & 0x07;
+        uint8_t gain = (regs[REG_CONTROL] >> 4) & 0x03;
+        double counts = rate * AutoRange::GAINS[gain] * AutoRange::TIMES[time];
+        double ceiling = AutoRange::maxCount(time);
+        uint16_t full = (uint16_t)(counts < ceiling ? counts : ceiling);
+        double irCounts = counts * irFraction;
+        uint16_t ir = (uint16_t)(irCounts < ceiling ? irCounts : ceiling);
+
+        regs[REG_C0DATAL]     = (uint8_t)full;
+        regs[REG_C0DATAL + 1] = (uint8_t)(full >> 8);
+        regs[REG_C0DATAL + 2] = (uint8_t)ir;
+        regs[REG_C0DATAL + 3] = (uint8_t)(ir >> 8);
+        regs[REG_STATUS] |= STATUS_AVALID;
+        cycles++;
+
+        uint8_t persist = regs[REG_PERSIST] & 0x0F;
+        uint16_t lo = (uint16_t)(regs[REG_AILTL] | (regs[REG_AILTL + 1] << 8));
+        uint16_t hi = (uint16_t)(regs[REG_AILTL + 2] | (regs[REG_AILTL + 3] << 8));
+        if (full < lo || full > hi) outside++;
+        else outside = 0;
+        if (persist == PERSIST_EVERY || outside >= persistCycles(persist)) {
+            if (persist != PERSIST_EVERY) outside = 0;
+            regs[REG_STATUS] |= STATUS_AINT;
+        }
+    }
+
+    uint8_t regs[0x20];
+    double rate;
+    double irFraction;
+    uint32_t elapsedMs;
+    uint32_t outside;
+    uint32_t cycles;
+    uint32_t busFailures;
+};
+
+#endif // __SIMULATED_TSL2591_H__
@@ -0,0 +1,36 @@
+#ifndef __TEMP_DIR_H__
+#define __TEMP_DIR_H__
+
+#include <ftw.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+// A fresh directory under /tmp, removed with everything in it when this goes out of scope.
+// For host tests of code that keeps files (the SD log, the settings blob).
+class TempDir {
+public:
+    TempDir() {
+        snprintf(dir, sizeof(dir), "/tmp/photoniq-test-XXXXXX");
+        if (!mkdtemp(dir)) dir[0] = '\0';
+    }
+
+    ~TempDir() {
+        if (dir[0]) nftw(dir, removeEntry, 8, FTW_DEPTH | FTW_PHYS);
+    }
+
+    TempDir(const TempDir&) = delete;
+    TempDir& operator=(const TempDir&) = delete;
+
+    const char* path() const { return dir; }
+
+private:
+    static int removeEntry(const char* path, const struct stat*, int, struct FTW*) {
+        ::remove(path);
+        return 0;
+    }
+
+    char dir[64];
+};
+
+#endif // __TEMP_DIR_H__
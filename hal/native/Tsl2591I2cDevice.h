@@ -0,0 +1,47 @@
+#ifndef __TSL2591_I2C_DEVICE_H__
+#define __TSL2591_I2C_DEVICE_H__
+
+#include "I2cBus.h"
+#include "SimulatedTsl2591.h"
+
+// Puts a SimulatedTsl2591 on the I2C bus. The first byte of a write is the command byte:
+// 0xA0 | register for a normal transaction (further bytes are written there, auto-incrementing),
+// 0xE0 | function for a special function. Reads continue from the last register addressed; the
+// ID register answers 0x50 like the real part.
+class Tsl2591I2cDevice : public I2cDevice {
+public:
+    static constexpr uint8_t ADDRESS     = 0x29;
+    static constexpr uint8_t REG_ID      = 0x12;
+    static constexpr uint8_t ID          = 0x50;
+
+    explicit Tsl2591I2cDevice(SimulatedTsl2591& sensor_) : sensor(sensor_), pointer(0) {}
+
+    bool write(const uint8_t* data, size_t len) override {
+        if (len == 0) return true; // address probe
+        uint8_t cmd = data[0];
+        if ((cmd & 0xE0) == 0xE0) return sensor.command(cmd);
+        if ((cmd & 0xE0) != 0xA0) return false;
+        pointer = cmd & 0x1F;
+        for (size_t i = 1; i < len; i++) {
+            if (!sensor.write8(pointer++, data[i])) return false;
+        }
+        return true;
+    }
+
+    bool read(uint8_t* out, size_t len) override {
+        if (pointer == REG_ID && len == 1) {
+            out[0] = ID;
+            pointer++;
+            return true;
+        }
+        if (!sensor.read(pointer, out, len)) return false;
+        pointer += (uint8_t)len;
+        return true;
+    }
+
+private:
+    SimulatedTsl2591& sensor;
+    uint8_t pointer;
+};
+
+#endif // __TSL2591_I2C_DEVICE_H__
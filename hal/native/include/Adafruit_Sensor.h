@@ -0,0 +1,6 @@
+#ifndef __NATIVE_ADAFRUIT_SENSOR_H__
+#define __NATIVE_ADAFRUIT_SENSOR_H__
+
+// The unified sensor base is not used by the firmware; the header only has to exist.
+
+#endif // __NATIVE_ADAFRUIT_SENSOR_H__
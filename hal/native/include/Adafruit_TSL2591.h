@@ -0,0 +1,120 @@
+#ifndef __NATIVE_ADAFRUIT_TSL2591_H__
+#define __NATIVE_ADAFRUIT_TSL2591_H__
+
+#include <stdint.h>
+#include "Arduino.h"
+#include "Wire.h"
+
+#define TSL2591_ADDR        0x29
+#define TSL2591_COMMAND_BIT 0xA0
+
+#define TSL2591_ENABLE_POWEROFF 0x00
+#define TSL2591_ENABLE_POWERON  0x01
+#define TSL2591_ENABLE_AEN      0x02
+#define TSL2591_ENABLE_AIEN     0x10
+#define TSL2591_ENABLE_NPIEN    0x80
+
+enum {
+    TSL2591_REGISTER_ENABLE     = 0x00,
+    TSL2591_REGISTER_CONTROL    = 0x01,
+    TSL2591_REGISTER_DEVICE_ID  = 0x12,
+    TSL2591_REGISTER_CHAN0_LOW  = 0x14,
+    TSL2591_REGISTER_CHAN1_LOW  = 0x16,
+};
+
+typedef enum {
+    TSL2591_INTEGRATIONTIME_100MS = 0x00,
+    TSL2591_INTEGRATIONTIME_200MS = 0x01,
+    TSL2591_INTEGRATIONTIME_300MS = 0x02,
+    TSL2591_INTEGRATIONTIME_400MS = 0x03,
+    TSL2591_INTEGRATIONTIME_500MS = 0x04,
+    TSL2591_INTEGRATIONTIME_600MS = 0x05,
+} tsl2591IntegrationTime_t;
+
+typedef enum {
+    TSL2591_GAIN_LOW  = 0x00,
+    TSL2591_GAIN_MED  = 0x10,
+    TSL2591_GAIN_HIGH = 0x20,
+    TSL2591_GAIN_MAX  = 0x30,
+} tsl2591Gain_t;
+
+// Adafruit's TSL2591 driver, register for register: the chip is powered up for each reading,
+// the driver waits out the integration with delay() and powers it down again.
+class Adafruit_TSL2591 {
+public:
+    Adafruit_TSL2591(int32_t sensorId = -1)
+        : wire(&Wire), address(TSL2591_ADDR), initialized(false),
+          integration(TSL2591_INTEGRATIONTIME_100MS), gain(TSL2591_GAIN_MED) {}
+
+    bool begin(TwoWire* wire_ = &Wire, uint8_t address_ = TSL2591_ADDR) {
+        wire = wire_;
+        address = address_;
+        uint8_t id;
+        if (!read(TSL2591_REGISTER_DEVICE_ID, &id, 1) || id != 0x50) return false;
+        initialized = true;
+        setTiming(integration);
+        setGain(gain);
+        disable();
+        return true;
+    }
+
+    void enable() {
+        write8(TSL2591_REGISTER_ENABLE,
+               TSL2591_ENABLE_POWERON | TSL2591_ENABLE_AEN | TSL2591_ENABLE_AIEN | TSL2591_ENABLE_NPIEN);
+    }
+    void disable() { write8(TSL2591_REGISTER_ENABLE, TSL2591_ENABLE_POWEROFF); }
+
+    void setGain(tsl2591Gain_t g) {
+        enable();
+        gain = g;
+        write8(TSL2591_REGISTER_CONTROL, integration | gain);
+        disable();
+    }
+    tsl2591Gain_t getGain() { return gain; }
+
+    void setTiming(tsl2591IntegrationTime_t t) {
+        enable();
+        integration = t;
+        write8(TSL2591_REGISTER_CONTROL, integration | gain);
+        disable();
+    }
+    tsl2591IntegrationTime_t getTiming() { return integration; }
+
+    uint32_t getFullLuminosity() {
+        if (!initialized) return 0;
+        enable();
+        for (uint8_t d = 0; d <= integration; d++) delay(120);
+        uint8_t c0[2] = {0, 0}, c1[2] = {0, 0};
+        read(TSL2591_REGISTER_CHAN0_LOW, c0, 2);
+        read(TSL2591_REGISTER_CHAN1_LOW, c1, 2);
+        disable();
+        uint32_t full = (uint32_t)c0[0] | ((uint32_t)c0[1] << 8);
+        uint32_t ir = (uint32_t)c1[0] | ((uint32_t)c1[1] << 8);
+        return (ir << 16) | full;
+    }
+
+private:
+    bool read(uint8_t reg, uint8_t* out, uint8_t len) {
+        wire->beginTransmission(address);
+        wire->write((uint8_t)(TSL2591_COMMAND_BIT | reg));
+        if (wire->endTransmission() != 0) return false;
+        if (wire->requestFrom(address, len) != len) return false;
+        for (uint8_t i = 0; i < len; i++) out[i] = (uint8_t)wire->read();
+        return true;
+    }
+
+    void write8(uint8_t reg, uint8_t value) {
+        wire->beginTransmission(address);
+        wire->write((uint8_t)(TSL2591_COMMAND_BIT | reg));
+        wire->write(value);
+        wire->endTransmission();
+    }
+
+    TwoWire* wire;
+    uint8_t address;
+    bool initialized;
+    tsl2591IntegrationTime_t integration;
+    tsl2591Gain_t gain;
+};
+
+#endif // __NATIVE_ADAFRUIT_TSL2591_H__
@@ -0,0 +1,110 @@
+#ifndef __NATIVE_ARDUINO_H__
+#define __NATIVE_ARDUINO_H__
+
+#include <math.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "NativeHal.h"
+#include "IPAddress.h"
+#include "Print.h"
+#include "WString.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+// The ESP32 Arduino core as the firmware sees it: timing, GPIO and interrupts, the console,
+// esp_timer, and the few ESP-IDF calls made from src/. Everything lands on the native board
+// through NativeHal.h.
+
+#define IRAM_ATTR
+#define DRAM_ATTR
+
+#define LOW          0x0
+#define HIGH         0x1
+#define INPUT        0x01
+#define OUTPUT       0x03
+#define INPUT_PULLUP 0x05
+
+#define RISING  0x01
+#define FALLING 0x02
+#define CHANGE  0x03
+
+#define digitalPinToInterrupt(pin) (pin)
+
+void setup();
+void loop();
+
+// 32-bit, like the ESP32's: they wrap after 49.7 days and 71.6 minutes respectively.
+inline unsigned long millis() { return (uint32_t)(nativeNowUs() / 1000); }
+inline unsigned long micros() { return (uint32_t)nativeNowUs(); }
+
+inline void delay(uint32_t ms) { vTaskDelay(pdMS_TO_TICKS(ms)); }
+inline void delayMicroseconds(uint32_t us) { nativeSleepUntilUs(nativeNowUs() + us); }
+inline void yield() { nativeYield(); }
+
+inline void pinMode(uint8_t pin, uint8_t mode) {}
+inline void digitalWrite(uint8_t pin, uint8_t level) {}
+inline int digitalRead(uint8_t pin) { return nativePinRead(pin); }
+
+inline void nativeCallPlainHandler(void* handler) { reinterpret_cast<void (*)()>(handler)(); }
+
+inline void attachInterrupt(uint8_t pin, void (*handler)(), int mode) {
+    nativeAttachInterrupt(pin, nativeCallPlainHandler, reinterpret_cast<void*>(handler), mode);
+}
+inline void attachInterruptArg(uint8_t pin, void (*handler)(void*), void* arg, int mode) {
+    nativeAttachInterrupt(pin, handler, arg, mode);
+}
+inline void detachInterrupt(uint8_t pin) { nativeDetachInterrupt(pin); }
+
+inline int64_t esp_timer_get_time() { return (int64_t)nativeNowUs(); }
+inline uint32_t esp_random() { return nativeRandom(); }
+
+class EspClass {
+public:
+    uint32_t getFreeHeap() { return nativeFreeHeap(); }
+    uint32_t getMinFreeHeap() { return nativeMinFreeHeap(); }
+    uint32_t getHeapSize() { return 320 * 1024; }
+    uint32_t getCycleCount() { return nativeCycleCount(); }
+    uint32_t getCpuFreqMHz() { return nativeCycleHz() / 1000000; }
+};
+inline EspClass ESP;
+
+// The console goes to the process's standard output.
+class HardwareSerial : public Print {
+public:
+    using Print::write;
+
+    void begin(unsigned long baud) {}
+    void end() {}
+    operator bool() const { return true; }
+    int available() { return 0; }
+    int read() { return -1; }
+    void flush() {}
+
+    size_t write(uint8_t c) override {
+        nativeSerialWrite(&c, 1);
+        return 1;
+    }
+    size_t write(const uint8_t* data, size_t len) override {
+        nativeSerialWrite(data, len);
+        return len;
+    }
+};
+inline HardwareSerial Serial;
+
+#if defined(__GLIBC__) && (__GLIBC__ < 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ < 38))
+inline size_t strlcpy(char* dst, const char* src, size_t size) {
+    size_t len = strlen(src);
+    if (size > 0) {
+        size_t n = len < size - 1 ? len : size - 1;
+        memcpy(dst, src, n);
+        dst[n] = '\0';
+    }
+    return len;
+}
+#endif
+
+#endif // __NATIVE_ARDUINO_H__
@@ -0,0 +1,31 @@
+#ifndef __NATIVE_IP_ADDRESS_H__
+#define __NATIVE_IP_ADDRESS_H__
+
+#include <stdint.h>
+#include <stdio.h>
+#include "Print.h"
+
+// IPv4 address kept in network byte order, as lwIP and the ESP32 core keep it.
+class IPAddress : public Printable {
+public:
+    IPAddress() : address(0) {}
+    IPAddress(uint32_t networkOrder) : address(networkOrder) {}
+    IPAddress(uint8_t a, uint8_t b, uint8_t c, uint8_t d)
+        : address((uint32_t)a | ((uint32_t)b << 8) | ((uint32_t)c << 16) | ((uint32_t)d << 24)) {}
+
+    operator uint32_t() const { return address; }
+    uint8_t operator[](int i) const { return (uint8_t)(address >> (8 * i)); }
+
+    String toString() const {
+        char buf[16];
+        snprintf(buf, sizeof(buf), "%u.%u.%u.%u", (*this)[0], (*this)[1], (*this)[2], (*this)[3]);
+        return String(buf);
+    }
+
+    size_t printTo(Print& p) const override { return p.print(toString()); }
+
+private:
+    uint32_t address;
+};
+
+#endif // __NATIVE_IP_ADDRESS_H__
@@ -0,0 +1,80 @@
+#ifndef __NATIVE_HAL_H__
+#define __NATIVE_HAL_H__
+
+#include <stddef.h>
+#include <stdint.h>
+
+// The seam between the library stand-ins in this directory (Arduino core, FreeRTOS, Wire, SD,
+// Preferences, WiFi, lwIP, RTClib, Adafruit TSL2591, NimBLE) and the simulated board behind them
+// (NativeBoard). The stand-ins only translate library calls into these functions; time, tasks,
+// pins and the devices on the far side of the bus all live in the board, so the firmware in src/
+// builds for the host without a single change.
+
+// --- Time and tasks: FreeRTOS on one simulated core, see NativeKernel ---
+
+struct NativeTask;
+using NativeTaskHandle = NativeTask*;
+
+constexpr uint64_t NATIVE_FOREVER = UINT64_MAX;
+
+uint64_t nativeNowUs();                       // simulated microseconds since reset
+void nativeSleepUntilUs(uint64_t us);         // blocks the calling task
+void nativeYield();
+NativeTaskHandle nativeTaskCreate(void (*entry)(void*), const char* name, void* arg, int priority);
+NativeTaskHandle nativeTaskCurrent();
+void nativeTaskExit();
+// Takes the calling task's notification count, waiting until deadlineUs for one to arrive.
+uint32_t nativeTaskNotifyTake(bool clear, uint64_t deadlineUs);
+void nativeTaskNotifyGive(NativeTaskHandle task);
+
+// --- GPIO: levels come from the simulated devices wired to the pin ---
+
+int nativePinRead(int pin);
+void nativeAttachInterrupt(int pin, void (*handler)(void*), void* arg, int mode);
+void nativeDetachInterrupt(int pin);
+
+// --- I2C: 0 on success, else a Wire error code (2: address not acknowledged) ---
+
+uint8_t nativeI2cWrite(uint8_t address, const uint8_t* data, size_t len, bool stop);
+size_t nativeI2cRead(uint8_t address, uint8_t* out, size_t len);
+
+// --- Console, system ---
+
+void nativeSerialWrite(const uint8_t* data, size_t len);
+uint32_t nativeRandom();
+uint32_t nativeFreeHeap();
+uint32_t nativeMinFreeHeap();
+uint32_t nativeCycleCount();                  // the host's cycle counter (TSC), low 32 bits
+uint32_t nativeCycleHz();
+
+// --- Storage: host directories standing in for the SD card and the NVS partition ---
+
+const char* nativeSdRoot();   // nullptr when the board has no card
+const char* nativeNvsRoot();
+
+// --- Wi-Fi station, backed by a simulated access point ---
+
+enum NativeWifiStatus : uint8_t { NATIVE_WIFI_DOWN, NATIVE_WIFI_UP, NATIVE_WIFI_NO_AP, NATIVE_WIFI_AUTH_FAILED };
+
+void nativeWifiBegin(const char* ssid, const char* password);
+void nativeWifiDisconnect();
+NativeWifiStatus nativeWifiStatus();
+bool nativeWifiStartScan();
+int nativeWifiScanStatus();                   // -1 running, -2 failed, else the number of networks
+bool nativeWifiScanEntry(int index, char* ssid, size_t ssidSize, int8_t& rssi, uint8_t& channel, uint8_t& auth);
+void nativeWifiScanDelete();
+int8_t nativeWifiRssi();
+uint32_t nativeLocalAddress();                // IPv4, network byte order
+
+// --- Name lookup and datagrams. Stream sockets are the host's own (see lwip/sockets.h) ---
+
+bool nativeResolve(const char* host, uint32_t& address);
+bool nativeUdpSend(uint32_t address, uint16_t port, const uint8_t* data, size_t len);
+size_t nativeUdpReceive(uint8_t* out, size_t capacity);
+
+// --- BLE: notifications leave the GATT server for the simulated central ---
+
+bool nativeBleNotify(uint16_t connHandle, uint16_t attrHandle, const uint8_t* data, size_t len);
+void nativeBleAdvertising(bool on);
+
+#endif // __NATIVE_HAL_H__
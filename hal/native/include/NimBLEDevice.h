@@ -0,0 +1,417 @@
+#ifndef __NATIVE_NIMBLE_DEVICE_H__
+#define __NATIVE_NIMBLE_DEVICE_H__
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <strings.h>
+#include <string>
+#include <vector>
+#include "NativeHal.h"
+
+// The NimBLE-Arduino 2.x GATT server API as used by src/, without a radio. Attributes get
+// handles when the server starts, in the order the host stack assigns them; notifications go to
+// nativeBleNotify() for each subscribed connection. The native board plays the central through
+// the native*() hooks: connecting, subscribing and writing land in the application's callbacks
+// just as they would from the NimBLE host task.
+
+#define BLE_HS_CONN_HANDLE_NONE 0xffff
+#define BLE_ATT_ATTR_MAX_LEN    512
+
+namespace NIMBLE_PROPERTY {
+constexpr uint16_t READ     = 0x0002;
+constexpr uint16_t WRITE_NR = 0x0004;
+constexpr uint16_t WRITE    = 0x0008;
+constexpr uint16_t NOTIFY   = 0x0010;
+constexpr uint16_t INDICATE = 0x0020;
+}
+
+class NimBLEServer;
+class NimBLECharacteristic;
+
+class NimBLEUUID {
+public:
+    NimBLEUUID(const char* uuid = "") : value(uuid) {}
+    std::string toString() const { return value; }
+    bool operator==(const NimBLEUUID& other) const { return strcasecmp(value.c_str(), other.value.c_str()) == 0; }
+
+private:
+    std::string value;
+};
+
+class NimBLEAddress {
+public:
+    NimBLEAddress(const char* address = "00:00:00:00:00:00") : value(address) {}
+    std::string toString() const { return value; }
+
+    // The six address bytes, most significant first in the string: "4a:11:c0:de:00:01" is 0x4a11c0de0001.
+    operator uint64_t() const {
+        uint64_t v = 0;
+        for (char ch : value) {
+            if (ch >= '0' && ch <= '9') v = (v << 4) | (uint64_t)(ch - '0');
+            else if (ch >= 'a' && ch <= 'f') v = (v << 4) | (uint64_t)(ch - 'a' + 10);
+            else if (ch >= 'A' && ch <= 'F') v = (v << 4) | (uint64_t)(ch - 'A' + 10);
+        }
+        return v;
+    }
+
+private:
+    std::string value;
+};
+
+class NimBLEConnInfo {
+public:
+    NimBLEConnInfo(uint16_t handle = BLE_HS_CONN_HANDLE_NONE, uint16_t interval = 24, uint16_t mtu = 23,
+                   const char* address = "00:00:00:00:00:00")
+        : handle(handle), interval(interval), mtu(mtu), address(address) {}
+
+    uint16_t getConnHandle() const { return handle; }
+    uint16_t getConnInterval() const { return interval; }   // units of 1.25 ms
+    uint16_t getMTU() const { return mtu; }
+    NimBLEAddress getAddress() const { return address; }
+    NimBLEAddress getIdAddress() const { return address; }
+
+private:
+    friend class NimBLEServer;
+    uint16_t handle;
+    uint16_t interval;
+    uint16_t mtu;
+    NimBLEAddress address;
+};
+
+class NimBLEAttValue {
+public:
+    NimBLEAttValue() {}
+    NimBLEAttValue(const uint8_t* data, size_t len) : bytes(data, data + len) {}
+
+    const uint8_t* data() const { return bytes.data(); }
+    size_t size() const { return bytes.size(); }
+    size_t length() const { return bytes.size(); }
+    const char* c_str() const {
+        text.assign(bytes.begin(), bytes.end());
+        return text.c_str();
+    }
+
+private:
+    std::vector<uint8_t> bytes;
+    mutable std::string text;
+};
+
+class NimBLECharacteristicCallbacks {
+public:
+    virtual ~NimBLECharacteristicCallbacks() {}
+    virtual void onRead(NimBLECharacteristic* characteristic, NimBLEConnInfo& connInfo) {}
+    virtual void onWrite(NimBLECharacteristic* characteristic, NimBLEConnInfo& connInfo) {}
+    virtual void onSubscribe(NimBLECharacteristic* characteristic, NimBLEConnInfo& connInfo, uint16_t subValue) {}
+};
+
+class NimBLEServerCallbacks {
+public:
+    virtual ~NimBLEServerCallbacks() {}
+    virtual void onConnect(NimBLEServer* server, NimBLEConnInfo& connInfo) {}
+    virtual void onDisconnect(NimBLEServer* server, NimBLEConnInfo& connInfo, int reason) {}
+    virtual void onMTUChange(uint16_t mtu, NimBLEConnInfo& connInfo) {}
+    virtual void onConnParamsUpdate(NimBLEConnInfo& connInfo) {}
+};
+
+class NimBLEDescriptor {
+public:
+    NimBLEDescriptor(const char* uuid, uint16_t properties, uint16_t maxLen)
+        : uuid(uuid), properties(properties), maxLen(maxLen), handle(0) {}
+
+    void setValue(const uint8_t* data, size_t len) { value = NimBLEAttValue(data, len < maxLen ? len : maxLen); }
+    NimBLEAttValue getValue() const { return value; }
+    uint16_t getHandle() const { return handle; }
+    NimBLEUUID getUUID() const { return uuid; }
+
+private:
+    friend class NimBLEServer;
+    NimBLEUUID uuid;
+    uint16_t properties;
+    uint16_t maxLen;
+    uint16_t handle;
+    NimBLEAttValue value;
+};
+
+class NimBLECharacteristic {
+public:
+    NimBLECharacteristic(const char* uuid, uint16_t properties, uint16_t maxLen)
+        : uuid(uuid), properties(properties), maxLen(maxLen), handle(0), callbacks(nullptr), server(nullptr) {}
+
+    ~NimBLECharacteristic() {
+        for (NimBLEDescriptor* d : descriptors) delete d;
+    }
+
+    void setValue(const uint8_t* data, size_t len) { value = NimBLEAttValue(data, len < maxLen ? len : maxLen); }
+    void setValue(const char* text) { setValue((const uint8_t*)text, strlen(text)); }
+    NimBLEAttValue getValue() const { return value; }
+
+    uint16_t getHandle() const { return handle; }
+    NimBLEUUID getUUID() const { return uuid; }
+    uint16_t getProperties() const { return properties; }
+
+    NimBLEDescriptor* createDescriptor(const char* descUuid, uint32_t props = NIMBLE_PROPERTY::READ,
+                                       uint16_t len = 100) {
+        descriptors.push_back(new NimBLEDescriptor(descUuid, (uint16_t)props, len));
+        return descriptors.back();
+    }
+
+    void setCallbacks(NimBLECharacteristicCallbacks* cb) { callbacks = cb; }
+
+    // Sends the current value.
+    bool notify(uint16_t connHandle = BLE_HS_CONN_HANDLE_NONE) { return notify(value.data(), value.size(), connHandle); }
+
+    // Sends data to connHandle, or to every subscriber; true when all of them were queued.
+    bool notify(const uint8_t* data, size_t len, uint16_t connHandle = BLE_HS_CONN_HANDLE_NONE) {
+        bool sent = true;
+        for (uint16_t conn : subscribers) {
+            if (connHandle != BLE_HS_CONN_HANDLE_NONE && conn != connHandle) continue;
+            sent &= nativeBleNotify(conn, handle, data, len);
+        }
+        return sent;
+    }
+
+    // --- Native board: a central writing and subscribing ---
+
+    void nativeWrite(NimBLEConnInfo& connInfo, const uint8_t* data, size_t len) {
+        if (!(properties & (NIMBLE_PROPERTY::WRITE | NIMBLE_PROPERTY::WRITE_NR))) return;
+        setValue(data, len);
+        if (callbacks) callbacks->onWrite(this, connInfo);
+    }
+
+    void nativeSubscribe(NimBLEConnInfo& connInfo, uint16_t subValue) {
+        if (!(properties & (NIMBLE_PROPERTY::NOTIFY | NIMBLE_PROPERTY::INDICATE))) return;
+        nativeUnsubscribe(connInfo.getConnHandle());
+        if (subValue) subscribers.push_back(connInfo.getConnHandle());
+        if (callbacks) callbacks->onSubscribe(this, connInfo, subValue);
+    }
+
+    void nativeUnsubscribe(uint16_t connHandle) {
+        for (size_t i = 0; i < subscribers.size(); i++) {
+            if (subscribers[i] == connHandle) {
+                subscribers.erase(subscribers.begin() + i);
+                return;
+            }
+        }
+    }
+
+private:
+    friend class NimBLEServer;
+    NimBLEUUID uuid;
+    uint16_t properties;
+    uint16_t maxLen;
+    uint16_t handle;
+    NimBLEAttValue value;
+    NimBLECharacteristicCallbacks* callbacks;
+    NimBLEServer* server;
+    std::vector<NimBLEDescriptor*> descriptors;
+    std::vector<uint16_t> subscribers;
+};
+
+class NimBLEService {
+public:
+    explicit NimBLEService(const char* uuid) : uuid(uuid), handle(0), started(false) {}
+
+    ~NimBLEService() {
+        for (NimBLECharacteristic* c : characteristics) delete c;
+    }
+
+    NimBLECharacteristic* createCharacteristic(const char* charUuid,
+                                               uint32_t properties = NIMBLE_PROPERTY::READ | NIMBLE_PROPERTY::WRITE,
+                                               uint16_t maxLen = BLE_ATT_ATTR_MAX_LEN) {
+        characteristics.push_back(new NimBLECharacteristic(charUuid, (uint16_t)properties, maxLen));
+        return characteristics.back();
+    }
+
+    bool start() {
+        started = true;
+        return true;
+    }
+
+    NimBLEUUID getUUID() const { return uuid; }
+
+private:
+    friend class NimBLEServer;
+    NimBLEUUID uuid;
+    uint16_t handle;
+    bool started;
+    std::vector<NimBLECharacteristic*> characteristics;
+};
+
+class NimBLEAdvertising {
+public:
+    NimBLEAdvertising() : advertising(false) {}
+
+    bool addServiceUUID(const char* uuid) {
+        serviceUuids.push_back(NimBLEUUID(uuid));
+        return true;
+    }
+
+    bool start() {
+        advertising = true;
+        nativeBleAdvertising(true);
+        return true;
+    }
+
+    bool stop() {
+        advertising = false;
+        nativeBleAdvertising(false);
+        return true;
+    }
+
+    bool isAdvertising() const { return advertising; }
+
+private:
+    bool advertising;
+    std::vector<NimBLEUUID> serviceUuids;
+};
+
+class NimBLEServer {
+public:
+    NimBLEServer() : callbacks(nullptr), advertiseAfterDisconnect(true), started(false) {}
+
+    ~NimBLEServer() {
+        for (NimBLEService* s : services) delete s;
+    }
+
+    NimBLEService* createService(const char* uuid) {
+        services.push_back(new NimBLEService(uuid));
+        return services.back();
+    }
+
+    void setCallbacks(NimBLEServerCallbacks* cb, bool deleteCallbacks = true) { callbacks = cb; }
+
+    // Assigns handles like the host stack: a declaration per service; per characteristic a
+    // declaration, the value, a CCCD when it notifies or indicates, then its descriptors.
+    void start() {
+        uint16_t next = 1;
+        for (NimBLEService* s : services) {
+            s->handle = next++;
+            for (NimBLECharacteristic* c : s->characteristics) {
+                next++;
+                c->handle = next++;
+                c->server = this;
+                if (c->properties & (NIMBLE_PROPERTY::NOTIFY | NIMBLE_PROPERTY::INDICATE)) next++;
+                for (NimBLEDescriptor* d : c->descriptors) d->handle = next++;
+            }
+        }
+        started = true;
+    }
+
+    void advertiseOnDisconnect(bool on) { advertiseAfterDisconnect = on; }
+
+    std::vector<uint16_t> getPeerDevices() const {
+        std::vector<uint16_t> handles;
+        for (const NimBLEConnInfo& p : peers) handles.push_back(p.handle);
+        return handles;
+    }
+
+    NimBLEConnInfo getPeerInfo(uint16_t connHandle) const {
+        for (const NimBLEConnInfo& p : peers) {
+            if (p.handle == connHandle) return p;
+        }
+        return NimBLEConnInfo();
+    }
+
+    uint16_t getPeerMTU(uint16_t connHandle) const {
+        for (const NimBLEConnInfo& p : peers) {
+            if (p.handle == connHandle) return p.mtu;
+        }
+        return 0;
+    }
+
+    size_t getConnectedCount() const { return peers.size(); }
+
+    // --- Native board: the central's side of the link ---
+
+    // A central connects: advertising stops (one connection at a time, as configured on the
+    // ESP32), then the MTU exchange follows.
+    void nativeConnect(NimBLEConnInfo& connInfo, NimBLEAdvertising* advertising) {
+        if (advertising && advertising->isAdvertising()) advertising->stop();
+        uint16_t mtu = connInfo.mtu;
+        connInfo.mtu = 23;
+        peers.push_back(connInfo);
+        if (callbacks) callbacks->onConnect(this, connInfo);
+        if (mtu != 23) {
+            connInfo.mtu = mtu;
+            peers.back().mtu = mtu;
+            if (callbacks) callbacks->onMTUChange(mtu, connInfo);
+        }
+    }
+
+    void nativeDisconnect(uint16_t connHandle, int reason, NimBLEAdvertising* advertising) {
+        for (size_t i = 0; i < peers.size(); i++) {
+            if (peers[i].handle != connHandle) continue;
+            NimBLEConnInfo info = peers[i];
+            peers.erase(peers.begin() + i);
+            for (NimBLEService* s : services) {
+                for (NimBLECharacteristic* c : s->characteristics) c->nativeUnsubscribe(connHandle);
+            }
+            if (callbacks) callbacks->onDisconnect(this, info, reason);
+            if (advertiseAfterDisconnect && advertising && !advertising->isAdvertising()) advertising->start();
+            return;
+        }
+    }
+
+    NimBLECharacteristic* nativeFind(const char* uuid) const {
+        NimBLEUUID wanted(uuid);
+        for (NimBLEService* s : services) {
+            for (NimBLECharacteristic* c : s->characteristics) {
+                if (c->uuid == wanted) return c;
+            }
+        }
+        return nullptr;
+    }
+
+    // Every characteristic, in handle order, for a central discovering the database.
+    std::vector<NimBLECharacteristic*> nativeCharacteristics() const {
+        std::vector<NimBLECharacteristic*> all;
+        for (NimBLEService* s : services) {
+            for (NimBLECharacteristic* c : s->characteristics) all.push_back(c);
+        }
+        return all;
+    }
+
+    bool isStarted() const { return started; }
+
+private:
+    NimBLEServerCallbacks* callbacks;
+    bool advertiseAfterDisconnect;
+    bool started;
+    std::vector<NimBLEService*> services;
+    std::vector<NimBLEConnInfo> peers;
+};
+
+class NimBLEDevice {
+public:
+    static bool init(const std::string& deviceName) {
+        name() = deviceName;
+        return true;
+    }
+
+    static NimBLEServer* createServer() {
+        if (!server()) server() = new NimBLEServer();
+        return server();
+    }
+
+    static NimBLEServer* getServer() { return server(); }
+
+    static NimBLEAdvertising* getAdvertising() {
+        static NimBLEAdvertising advertising;
+        return &advertising;
+    }
+
+    static std::string getDeviceName() { return name(); }
+
+private:
+    static NimBLEServer*& server() {
+        static NimBLEServer* instance = nullptr;
+        return instance;
+    }
+    static std::string& name() {
+        static std::string deviceName;
+        return deviceName;
+    }
+};
+
+#endif // __NATIVE_NIMBLE_DEVICE_H__
@@ -0,0 +1,111 @@
+#ifndef __NATIVE_PREFERENCES_H__
+#define __NATIVE_PREFERENCES_H__
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/stat.h>
+#include "NativeHal.h"
+#include "WString.h"
+
+// The ESP32 Preferences (NVS) API on the host: a namespace is a directory under the board's NVS
+// root and each key one file holding the raw value. Writes go to a temporary file that is then
+// renamed over the old one, so an interrupted run leaves either value but never half of one,
+// the way an NVS entry is either committed or not.
+class Preferences {
+public:
+    Preferences() : opened(false), readOnly(false) { dir[0] = '\0'; }
+
+    bool begin(const char* name, bool readOnly_ = false, const char* partition = nullptr) {
+        const char* root = nativeNvsRoot();
+        if (!root || strlen(name) > 15) return false;
+        ::mkdir(root, 0755);
+        snprintf(dir, sizeof(dir), "%s/%s", root, name);
+        if (!readOnly_) ::mkdir(dir, 0755);
+        opened = true;
+        readOnly = readOnly_;
+        return true;
+    }
+
+    void end() { opened = false; }
+
+    bool isKey(const char* key) { return getBytesLength(key) > 0; }
+
+    bool remove(const char* key) {
+        char path[256];
+        return writable() && keyPath(key, path, sizeof(path)) && ::remove(path) == 0;
+    }
+
+    size_t getBytesLength(const char* key) {
+        char path[256];
+        struct stat st;
+        if (!opened || !keyPath(key, path, sizeof(path)) || ::stat(path, &st) != 0) return 0;
+        return (size_t)st.st_size;
+    }
+
+    size_t getBytes(const char* key, void* out, size_t maxLen) {
+        size_t len = getBytesLength(key);
+        if (len == 0 || len > maxLen) return 0;
+        char path[256];
+        keyPath(key, path, sizeof(path));
+        FILE* fp = fopen(path, "rb");
+        if (!fp) return 0;
+        size_t n = fread(out, 1, len, fp);
+        fclose(fp);
+        return n;
+    }
+
+    size_t putBytes(const char* key, const void* data, size_t len) {
+        char path[256], temp[264];
+        if (!writable() || !keyPath(key, path, sizeof(path))) return 0;
+        snprintf(temp, sizeof(temp), "%s.tmp", path);
+        FILE* fp = fopen(temp, "wb");
+        if (!fp) return 0;
+        bool ok = fwrite(data, 1, len, fp) == len;
+        ok = fclose(fp) == 0 && ok;
+        if (!ok || ::rename(temp, path) != 0) {
+            ::remove(temp);
+            return 0;
+        }
+        return len;
+    }
+
+    String getString(const char* key, const String& defaultValue = String()) {
+        char value[4000];
+        size_t n = getBytes(key, value, sizeof(value) - 1);
+        if (n == 0) return defaultValue;
+        value[n] = '\0';
+        return String(value);
+    }
+    size_t putString(const char* key, const char* value) { return putBytes(key, value, strlen(value)); }
+
+    int32_t getInt(const char* key, int32_t defaultValue = 0) {
+        int32_t v;
+        return getBytes(key, &v, sizeof(v)) == sizeof(v) ? v : defaultValue;
+    }
+    size_t putInt(const char* key, int32_t value) { return putBytes(key, &value, sizeof(value)); }
+
+    bool getBool(const char* key, bool defaultValue = false) {
+        uint8_t v;
+        return getBytes(key, &v, sizeof(v)) == sizeof(v) ? v != 0 : defaultValue;
+    }
+    size_t putBool(const char* key, bool value) {
+        uint8_t v = value ? 1 : 0;
+        return putBytes(key, &v, sizeof(v));
+    }
+
+private:
+    bool writable() const { return opened && !readOnly; }
+
+    bool keyPath(const char* key, char* out, size_t size) {
+        if (strlen(key) > 15) return false;
+        int n = snprintf(out, size, "%s/%s", dir, key);
+        return n > 0 && (size_t)n < size;
+    }
+
+    bool opened;
+    bool readOnly;
+    char dir[200];
+};
+
+#endif // __NATIVE_PREFERENCES_H__
@@ -0,0 +1,92 @@
+#ifndef __NATIVE_PRINT_H__
+#define __NATIVE_PRINT_H__
+
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include "WString.h"
+
+#define DEC 10
+#define HEX 16
+#define OCT 8
+#define BIN 2
+
+class Print;
+
+class Printable {
+public:
+    virtual ~Printable() {}
+    virtual size_t printTo(Print& p) const = 0;
+};
+
+// Arduino's Print: formatting on top of write(). Integers print without a prefix in any base,
+// upper case in hex, like the core's.
+class Print {
+public:
+    virtual ~Print() {}
+    virtual size_t write(uint8_t c) = 0;
+    virtual size_t write(const uint8_t* data, size_t len) {
+        size_t n = 0;
+        while (len--) n += write(*data++);
+        return n;
+    }
+    size_t write(const char* s) { return s ? write((const uint8_t*)s, strlen(s)) : 0; }
+    size_t write(const char* s, size_t len) { return write((const uint8_t*)s, len); }
+
+    size_t printf(const char* format, ...) __attribute__((format(printf, 2, 3))) {
+        char small[256];
+        va_list args;
+        va_start(args, format);
+        int n = vsnprintf(small, sizeof(small), format, args);
+        va_end(args);
+        if (n < 0) return 0;
+        if ((size_t)n < sizeof(small)) return write((const uint8_t*)small, (size_t)n);
+        char* big = new char[n + 1];
+        va_start(args, format);
+        vsnprintf(big, (size_t)n + 1, format, args);
+        va_end(args);
+        size_t written = write((const uint8_t*)big, (size_t)n);
+        delete[] big;
+        return written;
+    }
+
+    size_t print(const char* s) { return write(s); }
+    size_t print(const String& s) { return write(s.c_str()); }
+    size_t print(char c) { return write((uint8_t)c); }
+    size_t print(unsigned char v, int base = DEC) { return printUnsigned(v, base); }
+    size_t print(int v, int base = DEC) { return printSigned(v, base); }
+    size_t print(unsigned int v, int base = DEC) { return printUnsigned(v, base); }
+    size_t print(long v, int base = DEC) { return printSigned(v, base); }
+    size_t print(unsigned long v, int base = DEC) { return printUnsigned(v, base); }
+    size_t print(long long v, int base = DEC) { return printSigned(v, base); }
+    size_t print(unsigned long long v, int base = DEC) { return printUnsigned(v, base); }
+    size_t print(double v, int digits = 2) { return printf("%.*f", digits, v); }
+    size_t print(const Printable& p) { return p.printTo(*this); }
+
+    size_t println() { return write("\r\n"); }
+    template <typename T> size_t println(const T& v) { size_t n = print(v); return n + println(); }
+    template <typename T> size_t println(const T& v, int format) { size_t n = print(v, format); return n + println(); }
+
+private:
+    size_t printSigned(long long v, int base) {
+        if (v < 0 && base == DEC) return print('-') + printUnsigned((unsigned long long)-v, base);
+        return printUnsigned((unsigned long long)v, base);
+    }
+
+    size_t printUnsigned(unsigned long long v, int base) {
+        if (base < 2) base = DEC;
+        char buf[72];
+        char* p = buf + sizeof(buf) - 1;
+        *p = '\0';
+        do {
+            unsigned d = (unsigned)(v % (unsigned)base);
+            *--p = (char)(d < 10 ? '0' + d : 'A' + d - 10);
+            v /= (unsigned)base;
+        } while (v);
+        return write(p);
+    }
+};
+
+#endif // __NATIVE_PRINT_H__
@@ -0,0 +1,151 @@
+#ifndef __NATIVE_RTCLIB_H__
+#define __NATIVE_RTCLIB_H__
+
+#include <stdint.h>
+#include <stdio.h>
+#include <time.h>
+#include "WString.h"
+#include "Wire.h"
+
+#define SECONDS_FROM_1970_TO_2000 946684800UL
+
+// RTClib's DateTime (UTC, years 2000..2099), with the date arithmetic left to the C library.
+class DateTime {
+public:
+    enum timestampOpt { TIMESTAMP_FULL, TIMESTAMP_TIME, TIMESTAMP_DATE };
+
+    DateTime(uint32_t t = SECONDS_FROM_1970_TO_2000) {
+        time_t seconds = (time_t)t;
+        struct tm tm;
+        gmtime_r(&seconds, &tm);
+        set(tm.tm_year + 1900, tm.tm_mon + 1, tm.tm_mday, tm.tm_hour, tm.tm_min, tm.tm_sec);
+    }
+
+    DateTime(uint16_t year, uint8_t month, uint8_t day, uint8_t hour = 0, uint8_t min = 0, uint8_t sec = 0) {
+        set(year, month, day, hour, min, sec);
+    }
+
+    uint16_t year() const { return 2000U + yOff; }
+    uint8_t month() const { return m; }
+    uint8_t day() const { return d; }
+    uint8_t hour() const { return hh; }
+    uint8_t minute() const { return mm; }
+    uint8_t second() const { return ss; }
+
+    uint8_t dayOfTheWeek() const { // 0 = Sunday
+        return (uint8_t)((unixtime() / 86400UL + 4) % 7);
+    }
+
+    uint32_t unixtime() const {
+        struct tm tm = {};
+        tm.tm_year = year() - 1900;
+        tm.tm_mon = m - 1;
+        tm.tm_mday = d;
+        tm.tm_hour = hh;
+        tm.tm_min = mm;
+        tm.tm_sec = ss;
+        return (uint32_t)timegm(&tm);
+    }
+
+    String timestamp(timestampOpt opt = TIMESTAMP_FULL) const {
+        char buf[20];
+        if (opt == TIMESTAMP_TIME) snprintf(buf, sizeof(buf), "%02u:%02u:%02u", hh, mm, ss);
+        else if (opt == TIMESTAMP_DATE) snprintf(buf, sizeof(buf), "%u-%02u-%02u", year(), m, d);
+        else snprintf(buf, sizeof(buf), "%u-%02u-%02uT%02u:%02u:%02u", year(), m, d, hh, mm, ss);
+        return String(buf);
+    }
+
+private:
+    void set(int year, int month, int day, int hour, int min, int sec) {
+        yOff = (uint8_t)(year >= 2000 ? year - 2000 : year);
+        m = (uint8_t)month;
+        d = (uint8_t)day;
+        hh = (uint8_t)hour;
+        mm = (uint8_t)min;
+        ss = (uint8_t)sec;
+    }
+
+    uint8_t yOff, m, d, hh, mm, ss;
+};
+
+enum Ds3231SqwPinMode {
+    DS3231_OFF            = 0x1C,
+    DS3231_SquareWave1Hz  = 0x00,
+    DS3231_SquareWave1kHz = 0x08,
+    DS3231_SquareWave4kHz = 0x10,
+    DS3231_SquareWave8kHz = 0x18
+};
+
+// RTClib's DS3231 driver: the same register traffic over Wire as the library's, so the time,
+// oscillator-stop flag and control register all come from the device model on the bus.
+class RTC_DS3231 {
+public:
+    static constexpr uint8_t ADDRESS     = 0x68;
+    static constexpr uint8_t REG_TIME    = 0x00;
+    static constexpr uint8_t REG_CONTROL = 0x0E;
+    static constexpr uint8_t REG_STATUS  = 0x0F;
+
+    RTC_DS3231() : wire(&Wire) {}
+
+    bool begin(TwoWire* wire_ = &Wire) {
+        wire = wire_;
+        wire->beginTransmission(ADDRESS);
+        return wire->endTransmission() == 0;
+    }
+
+    bool lostPower() {
+        uint8_t status;
+        return read(REG_STATUS, &status, 1) && (status & 0x80);
+    }
+
+    void adjust(const DateTime& dt) {
+        uint8_t regs[8] = { REG_TIME, bin2bcd(dt.second()), bin2bcd(dt.minute()), bin2bcd(dt.hour()),
+                            bin2bcd(dt.dayOfTheWeek() == 0 ? 7 : dt.dayOfTheWeek()), bin2bcd(dt.day()),
+                            bin2bcd(dt.month()), bin2bcd((uint8_t)(dt.year() - 2000U)) };
+        wire->beginTransmission(ADDRESS);
+        wire->write(regs, sizeof(regs));
+        wire->endTransmission();
+        uint8_t status;
+        if (read(REG_STATUS, &status, 1)) write8(REG_STATUS, status & ~0x80);
+    }
+
+    DateTime now() {
+        uint8_t r[7];
+        if (!read(REG_TIME, r, sizeof(r))) return DateTime();
+        return DateTime(bcd2bin(r[6]) + 2000U, bcd2bin(r[5] & 0x7F), bcd2bin(r[4]), bcd2bin(r[2]), bcd2bin(r[1]),
+                        bcd2bin(r[0] & 0x7F));
+    }
+
+    void writeSqwPinMode(Ds3231SqwPinMode mode) {
+        uint8_t control;
+        if (!read(REG_CONTROL, &control, 1)) return;
+        control &= ~0x04; // INTCN: SQW instead of alarm interrupts
+        control &= ~0x18; // rate select
+        control |= mode;
+        write8(REG_CONTROL, control);
+    }
+
+private:
+    static uint8_t bin2bcd(uint8_t v) { return (uint8_t)(v + 6 * (v / 10)); }
+    static uint8_t bcd2bin(uint8_t v) { return (uint8_t)(v - 6 * (v >> 4)); }
+
+    bool read(uint8_t reg, uint8_t* out, uint8_t len) {
+        wire->beginTransmission(ADDRESS);
+        wire->write(reg);
+        if (wire->endTransmission(false) != 0) return false;
+        if (wire->requestFrom(ADDRESS, len) != len) return false;
+        for (uint8_t i = 0; i < len; i++) out[i] = (uint8_t)wire->read();
+        return true;
+    }
+
+    void write8(uint8_t reg, uint8_t value) {
+        wire->beginTransmission(ADDRESS);
+        wire->write(reg);
+        wire->write(value);
+        wire->endTransmission();
+    }
+
+    TwoWire* wire;
+};
+
+#endif // __NATIVE_RTCLIB_H__
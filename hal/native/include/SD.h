@@ -0,0 +1,129 @@
+#ifndef __NATIVE_SD_H__
+#define __NATIVE_SD_H__
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <memory>
+#include <sys/stat.h>
+#include "NativeHal.h"
+
+#define FILE_READ   "r"
+#define FILE_WRITE  "w"
+#define FILE_APPEND "a"
+
+// The ESP32 SD library's File: copies share one open file, and close() closes it for all of
+// them. Backed by a stdio stream on the card directory.
+class File {
+public:
+    File() {}
+    explicit File(FILE* fp, const char* path) : handle(std::make_shared<Handle>(fp, path)) {}
+
+    operator bool() const { return handle && handle->fp; }
+
+    size_t read(uint8_t* out, size_t len) { return *this ? fread(out, 1, len, handle->fp) : 0; }
+    int read() {
+        uint8_t c;
+        return read(&c, 1) == 1 ? c : -1;
+    }
+    size_t write(const uint8_t* data, size_t len) { return *this ? fwrite(data, 1, len, handle->fp) : 0; }
+    size_t write(uint8_t c) { return write(&c, 1); }
+
+    bool seek(uint32_t position) { return *this && fseek(handle->fp, (long)position, SEEK_SET) == 0; }
+    size_t position() const { return *this ? (size_t)ftell(handle->fp) : 0; }
+    size_t size() const {
+        if (!*this) return 0;
+        long at = ftell(handle->fp);
+        fseek(handle->fp, 0, SEEK_END);
+        long end = ftell(handle->fp);
+        fseek(handle->fp, at, SEEK_SET);
+        return end > 0 ? (size_t)end : 0;
+    }
+    int available() const { return (int)(size() - position()); }
+    void flush() {
+        if (*this) fflush(handle->fp);
+    }
+    const char* path() const { return handle ? handle->path : ""; }
+    bool isDirectory() const { return false; }
+
+    void close() {
+        if (handle && handle->fp) {
+            fclose(handle->fp);
+            handle->fp = nullptr;
+        }
+        handle.reset();
+    }
+
+private:
+    struct Handle {
+        Handle(FILE* fp_, const char* path_) : fp(fp_) {
+            strncpy(path, path_, sizeof(path) - 1);
+            path[sizeof(path) - 1] = '\0';
+        }
+        ~Handle() {
+            if (fp) fclose(fp);
+        }
+        FILE* fp;
+        char path[128];
+    };
+
+    std::shared_ptr<Handle> handle;
+};
+
+// The card is a directory on the host (NativeBoard --data); paths are relative to it. Modes are
+// the ESP32 VFS ones: "w" truncates, "a" appends, "r+" updates in place.
+class SDClass {
+public:
+    SDClass() : mounted(false) {}
+
+    bool begin(uint8_t csPin = 5) {
+        const char* root = nativeSdRoot();
+        if (!root) return false;
+        ::mkdir(root, 0755);
+        struct stat st;
+        mounted = ::stat(root, &st) == 0 && S_ISDIR(st.st_mode);
+        return mounted;
+    }
+
+    void end() { mounted = false; }
+
+    bool exists(const char* path) {
+        char full[512];
+        struct stat st;
+        return resolve(path, full, sizeof(full)) && ::stat(full, &st) == 0;
+    }
+
+    bool mkdir(const char* path) {
+        char full[512];
+        return resolve(path, full, sizeof(full)) && ::mkdir(full, 0755) == 0;
+    }
+
+    bool remove(const char* path) {
+        char full[512];
+        return resolve(path, full, sizeof(full)) && ::remove(full) == 0;
+    }
+
+    File open(const char* path, const char* mode = FILE_READ) {
+        char full[512];
+        if (!resolve(path, full, sizeof(full))) return File();
+        const char* stdioMode = strcmp(mode, "w") == 0 ? "w+b"
+                              : strcmp(mode, "a") == 0 ? "a+b"
+                              : strcmp(mode, "r+") == 0 ? "r+b"
+                              : "rb";
+        FILE* fp = fopen(full, stdioMode);
+        return fp ? File(fp, path) : File();
+    }
+
+private:
+    bool resolve(const char* path, char* out, size_t size) {
+        if (!mounted) return false;
+        int n = snprintf(out, size, "%s%s%s", nativeSdRoot(), path[0] == '/' ? "" : "/", path);
+        return n > 0 && (size_t)n < size;
+    }
+
+    bool mounted;
+};
+
+inline SDClass SD;
+
+#endif // __NATIVE_SD_H__
@@ -0,0 +1,15 @@
+#ifndef __NATIVE_SPI_H__
+#define __NATIVE_SPI_H__
+
+#include <stdint.h>
+
+// Nothing in the firmware drives SPI directly; the SD stand-in talks to the host file system.
+class SPIClass {
+public:
+    void begin(int8_t sck = -1, int8_t miso = -1, int8_t mosi = -1, int8_t ss = -1) {}
+    void end() {}
+};
+
+inline SPIClass SPI;
+
+#endif // __NATIVE_SPI_H__
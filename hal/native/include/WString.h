@@ -0,0 +1,93 @@
+#ifndef __NATIVE_WSTRING_H__
+#define __NATIVE_WSTRING_H__
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string>
+
+// The part of Arduino's String the firmware uses, over std::string.
+class String {
+public:
+    String() {}
+    String(const char* s) : text(s ? s : "") {}
+    String(const std::string& s) : text(s) {}
+    explicit String(char c) : text(1, c) {}
+    explicit String(int v, unsigned char base = 10) { fromSigned(v, base); }
+    explicit String(unsigned int v, unsigned char base = 10) { fromUnsigned(v, base); }
+    explicit String(long v, unsigned char base = 10) { fromSigned(v, base); }
+    explicit String(unsigned long v, unsigned char base = 10) { fromUnsigned(v, base); }
+    explicit String(double v, unsigned int decimals = 2) {
+        char buf[64];
+        snprintf(buf, sizeof(buf), "%.*f", (int)decimals, v);
+        text = buf;
+    }
+
+    const char* c_str() const { return text.c_str(); }
+    unsigned int length() const { return (unsigned int)text.size(); }
+    bool isEmpty() const { return text.empty(); }
+    char charAt(unsigned int i) const { return i < text.size() ? text[i] : 0; }
+    char operator[](unsigned int i) const { return charAt(i); }
+
+    int indexOf(char c, unsigned int from = 0) const { return position(text.find(c, from)); }
+    int indexOf(const char* s, unsigned int from = 0) const { return position(text.find(s, from)); }
+    int lastIndexOf(char c) const { return position(text.rfind(c)); }
+
+    String substring(unsigned int from) const { return from < text.size() ? String(text.substr(from)) : String(); }
+    String substring(unsigned int from, unsigned int to) const {
+        if (from > to) { unsigned int t = from; from = to; to = t; }
+        if (from >= text.size()) return String();
+        return String(text.substr(from, to - from));
+    }
+
+    long toInt() const { return strtol(text.c_str(), nullptr, 10); }
+    float toFloat() const { return strtof(text.c_str(), nullptr); }
+    void trim() {
+        size_t b = text.find_first_not_of(" \t\r\n");
+        size_t e = text.find_last_not_of(" \t\r\n");
+        text = b == std::string::npos ? std::string() : text.substr(b, e - b + 1);
+    }
+
+    String& operator+=(const String& s) { text += s.text; return *this; }
+    String& operator+=(const char* s) { text += s; return *this; }
+    String& operator+=(char c) { text += c; return *this; }
+
+    bool operator==(const String& s) const { return text == s.text; }
+    bool operator==(const char* s) const { return text == s; }
+    bool operator!=(const String& s) const { return text != s.text; }
+    bool operator!=(const char* s) const { return text != s; }
+    bool equals(const String& s) const { return text == s.text; }
+
+    friend String operator+(const String& a, const String& b) { return String(a.text + b.text); }
+    friend String operator+(const String& a, const char* b) { return String(a.text + b); }
+    friend String operator+(const char* a, const String& b) { return String(a + b.text); }
+    friend String operator+(const String& a, char b) { return String(a.text + b); }
+
+private:
+    static int position(size_t p) { return p == std::string::npos ? -1 : (int)p; }
+
+    void fromSigned(long v, unsigned char base) {
+        if (v < 0 && base == 10) {
+            fromUnsigned((unsigned long)-v, base);
+            text.insert(text.begin(), '-');
+        } else {
+            fromUnsigned((unsigned long)v, base);
+        }
+    }
+
+    void fromUnsigned(unsigned long v, unsigned char base) {
+        if (base < 2 || base > 36) base = 10;
+        char buf[72];
+        char* p = buf + sizeof(buf) - 1;
+        *p = '\0';
+        do {
+            unsigned d = (unsigned)(v % base);
+            *--p = (char)(d < 10 ? '0' + d : 'a' + d - 10);
+            v /= base;
+        } while (v);
+        text = p;
+    }
+
+    std::string text;
+};
+
+#endif // __NATIVE_WSTRING_H__
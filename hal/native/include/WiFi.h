@@ -0,0 +1,126 @@
+#ifndef __NATIVE_WIFI_H__
+#define __NATIVE_WIFI_H__
+
+#include <stdint.h>
+#include <string.h>
+#include "Arduino.h"
+#include "IPAddress.h"
+#include "NativeHal.h"
+#include "WString.h"
+#include "esp_wifi.h"
+
+typedef enum {
+    WL_NO_SHIELD       = 255,
+    WL_IDLE_STATUS     = 0,
+    WL_NO_SSID_AVAIL   = 1,
+    WL_SCAN_COMPLETED  = 2,
+    WL_CONNECTED       = 3,
+    WL_CONNECT_FAILED  = 4,
+    WL_CONNECTION_LOST = 5,
+    WL_DISCONNECTED    = 6
+} wl_status_t;
+
+typedef enum { WIFI_MODE_NULL = 0, WIFI_MODE_STA, WIFI_MODE_AP, WIFI_MODE_APSTA } wifi_mode_t;
+#define WIFI_OFF WIFI_MODE_NULL
+#define WIFI_STA WIFI_MODE_STA
+
+#define WIFI_SCAN_RUNNING (-1)
+#define WIFI_SCAN_FAILED  (-2)
+
+// The ESP32 WiFi class in station mode, on the native board's simulated access point. Like the
+// real one, begin() and scanNetworks(true) return at once and status() / scanComplete() report
+// progress as simulated time passes.
+class WiFiClass {
+public:
+    WiFiClass() : currentMode(WIFI_MODE_NULL) { ssid[0] = '\0'; }
+
+    bool mode(wifi_mode_t m) {
+        currentMode = m;
+        if (m == WIFI_MODE_NULL) nativeWifiDisconnect();
+        return true;
+    }
+    wifi_mode_t getMode() { return currentMode; }
+    bool setAutoReconnect(bool autoReconnect) { return true; }
+
+    wl_status_t begin(const char* ssid_, const char* password = nullptr) {
+        if (currentMode == WIFI_MODE_NULL) currentMode = WIFI_MODE_STA;
+        strncpy(ssid, ssid_, sizeof(ssid) - 1);
+        ssid[sizeof(ssid) - 1] = '\0';
+        nativeWifiBegin(ssid_, password ? password : "");
+        return status();
+    }
+
+    bool disconnect(bool wifiOff = false, bool eraseAp = false) {
+        nativeWifiDisconnect();
+        if (wifiOff) currentMode = WIFI_MODE_NULL;
+        return true;
+    }
+
+    wl_status_t status() {
+        switch (nativeWifiStatus()) {
+            case NATIVE_WIFI_UP:          return WL_CONNECTED;
+            case NATIVE_WIFI_NO_AP:       return WL_NO_SSID_AVAIL;
+            case NATIVE_WIFI_AUTH_FAILED: return WL_CONNECT_FAILED;
+            default:                      return WL_DISCONNECTED;
+        }
+    }
+
+    int16_t scanNetworks(bool async = false) {
+        if (!nativeWifiStartScan()) return WIFI_SCAN_FAILED;
+        if (!async) {
+            while (nativeWifiScanStatus() == WIFI_SCAN_RUNNING) delay(10);
+            return scanComplete();
+        }
+        return WIFI_SCAN_RUNNING;
+    }
+
+    int16_t scanComplete() { return (int16_t)nativeWifiScanStatus(); }
+    void scanDelete() { nativeWifiScanDelete(); }
+
+    String SSID(uint8_t i) {
+        Entry e;
+        return entry(i, e) ? String(e.ssid) : String();
+    }
+    int32_t RSSI(uint8_t i) {
+        Entry e;
+        return entry(i, e) ? e.rssi : 0;
+    }
+    int32_t channel(uint8_t i) {
+        Entry e;
+        return entry(i, e) ? e.channel : 0;
+    }
+    wifi_auth_mode_t encryptionType(uint8_t i) {
+        Entry e;
+        return entry(i, e) ? (wifi_auth_mode_t)e.auth : WIFI_AUTH_OPEN;
+    }
+
+    String SSID() { return isConnected() ? String(ssid) : String(); }
+    int8_t RSSI() { return isConnected() ? nativeWifiRssi() : 0; }
+    String BSSIDstr() { return String("02:00:00:00:00:01"); }
+    uint8_t* BSSID() {
+        static uint8_t bssid[6] = {0x02, 0x00, 0x00, 0x00, 0x00, 0x01};
+        return bssid;
+    }
+    String macAddress() { return String("02:00:00:00:00:02"); }
+    IPAddress localIP() { return isConnected() ? IPAddress(nativeLocalAddress()) : IPAddress(); }
+    bool isConnected() { return status() == WL_CONNECTED; }
+
+private:
+    struct Entry {
+        char ssid[33];
+        int8_t rssi;
+        uint8_t channel;
+        uint8_t auth;
+    };
+
+    bool entry(uint8_t i, Entry& e) {
+        return nativeWifiScanEntry(i, e.ssid, sizeof(e.ssid), e.rssi, e.channel, e.auth);
+    }
+
+    wifi_mode_t currentMode;
+    char ssid[33];
+};
+
+inline WiFiClass WiFi;
+
+#endif // __NATIVE_WIFI_H__
@@ -0,0 +1,75 @@
+#ifndef __NATIVE_WIFI_UDP_H__
+#define __NATIVE_WIFI_UDP_H__
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include "IPAddress.h"
+#include "NativeHal.h"
+
+// WiFiUDP on the native board's datagram service, which answers the addresses it knows (the
+// in-process NTP server) and drops everything else, as an unroutable packet would be.
+class WiFiUDP {
+public:
+    static constexpr size_t MAX_DATAGRAM = 1472;
+
+    WiFiUDP() : localPort(0), remoteAddress(0), remotePort(0), txLength(0), rxLength(0), rxIndex(0) {}
+
+    uint8_t begin(uint16_t port) {
+        localPort = port;
+        return 1;
+    }
+
+    void stop() {
+        localPort = 0;
+        rxLength = rxIndex = 0;
+    }
+
+    int beginPacket(IPAddress address, uint16_t port) {
+        remoteAddress = address;
+        remotePort = port;
+        txLength = 0;
+        return localPort != 0;
+    }
+
+    size_t write(uint8_t c) { return write(&c, 1); }
+    size_t write(const uint8_t* data, size_t len) {
+        size_t n = len < MAX_DATAGRAM - txLength ? len : MAX_DATAGRAM - txLength;
+        memcpy(tx + txLength, data, n);
+        txLength += n;
+        return n;
+    }
+
+    int endPacket() { return nativeUdpSend(remoteAddress, remotePort, tx, txLength) ? 1 : 0; }
+
+    int parsePacket() {
+        if (localPort == 0) return 0;
+        rxLength = nativeUdpReceive(rx, sizeof(rx));
+        rxIndex = 0;
+        return (int)rxLength;
+    }
+
+    int available() { return (int)(rxLength - rxIndex); }
+    int read() { return rxIndex < rxLength ? rx[rxIndex++] : -1; }
+    int read(uint8_t* out, size_t len) {
+        size_t n = len < rxLength - rxIndex ? len : rxLength - rxIndex;
+        memcpy(out, rx + rxIndex, n);
+        rxIndex += n;
+        return (int)n;
+    }
+
+    // Discards the rest of the received datagram.
+    void flush() { rxIndex = rxLength; }
+
+private:
+    uint16_t localPort;
+    uint32_t remoteAddress;
+    uint16_t remotePort;
+    uint8_t tx[MAX_DATAGRAM];
+    size_t txLength;
+    uint8_t rx[MAX_DATAGRAM];
+    size_t rxLength;
+    size_t rxIndex;
+};
+
+#endif // __NATIVE_WIFI_UDP_H__
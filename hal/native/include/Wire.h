@@ -0,0 +1,66 @@
+#ifndef __NATIVE_WIRE_H__
+#define __NATIVE_WIRE_H__
+
+#include <stddef.h>
+#include <stdint.h>
+#include "NativeHal.h"
+
+// Arduino TwoWire over the native board's I2C bus. A transmission is buffered and handed to the
+// device at endTransmission(); requestFrom() reads the reply in one transfer, like the ESP32 core.
+class TwoWire {
+public:
+    static constexpr size_t BUFFER_SIZE = 128;
+
+    TwoWire() : txAddress(0), txLength(0), rxLength(0), rxIndex(0) {}
+
+    bool begin(int sda = -1, int scl = -1, uint32_t frequency = 0) { return true; }
+    bool end() { return true; }
+    bool setClock(uint32_t frequency) { return true; }
+
+    void beginTransmission(uint8_t address) {
+        txAddress = address;
+        txLength = 0;
+    }
+    void beginTransmission(int address) { beginTransmission((uint8_t)address); }
+
+    uint8_t endTransmission(bool sendStop = true) {
+        uint8_t result = nativeI2cWrite(txAddress, tx, txLength, sendStop);
+        txLength = 0;
+        return result;
+    }
+
+    size_t write(uint8_t value) {
+        if (txLength >= BUFFER_SIZE) return 0;
+        tx[txLength++] = value;
+        return 1;
+    }
+    size_t write(const uint8_t* data, size_t len) {
+        size_t n = 0;
+        while (n < len && write(data[n])) n++;
+        return n;
+    }
+
+    uint8_t requestFrom(uint8_t address, uint8_t quantity, bool sendStop = true) {
+        if (quantity > BUFFER_SIZE) quantity = BUFFER_SIZE;
+        rxLength = nativeI2cRead(address, rx, quantity);
+        rxIndex = 0;
+        return (uint8_t)rxLength;
+    }
+    uint8_t requestFrom(int address, int quantity) { return requestFrom((uint8_t)address, (uint8_t)quantity); }
+
+    int available() { return (int)(rxLength - rxIndex); }
+    int read() { return rxIndex < rxLength ? rx[rxIndex++] : -1; }
+    int peek() { return rxIndex < rxLength ? rx[rxIndex] : -1; }
+
+private:
+    uint8_t txAddress;
+    uint8_t tx[BUFFER_SIZE];
+    size_t txLength;
+    uint8_t rx[BUFFER_SIZE];
+    size_t rxLength;
+    size_t rxIndex;
+};
+
+inline TwoWire Wire;
+
+#endif // __NATIVE_WIRE_H__
@@ -0,0 +1,46 @@
+#ifndef __NATIVE_ESP_WIFI_H__
+#define __NATIVE_ESP_WIFI_H__
+
+#include <stdint.h>
+#include <string.h>
+#include "NativeHal.h"
+
+typedef int esp_err_t;
+#define ESP_OK   0
+#define ESP_FAIL -1
+#define ESP_ERR_WIFI_NOT_CONNECT 0x300A
+
+// ESP-IDF's wifi_auth_mode_t values; WifiDriver::AuthMode mirrors them.
+typedef enum {
+    WIFI_AUTH_OPEN = 0,
+    WIFI_AUTH_WEP,
+    WIFI_AUTH_WPA_PSK,
+    WIFI_AUTH_WPA2_PSK,
+    WIFI_AUTH_WPA_WPA2_PSK,
+    WIFI_AUTH_WPA2_ENTERPRISE,
+    WIFI_AUTH_WPA3_PSK,
+    WIFI_AUTH_WPA2_WPA3_PSK,
+    WIFI_AUTH_MAX
+} wifi_auth_mode_t;
+
+typedef struct {
+    uint8_t bssid[6];
+    uint8_t ssid[33];
+    uint8_t primary;
+    int8_t rssi;
+    wifi_auth_mode_t authmode;
+} wifi_ap_record_t;
+
+// The simulated AP, while the station is associated with it.
+inline esp_err_t esp_wifi_sta_get_ap_info(wifi_ap_record_t* ap) {
+    if (nativeWifiStatus() != NATIVE_WIFI_UP) return ESP_ERR_WIFI_NOT_CONNECT;
+    memset(ap, 0, sizeof(*ap));
+    ap->bssid[0] = 0x02;
+    ap->bssid[5] = 0x01;
+    ap->rssi = nativeWifiRssi();
+    ap->primary = 6;
+    ap->authmode = WIFI_AUTH_WPA2_PSK;
+    return ESP_OK;
+}
+
+#endif // __NATIVE_ESP_WIFI_H__
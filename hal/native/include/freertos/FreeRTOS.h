@@ -0,0 +1,25 @@
+#ifndef __NATIVE_FREERTOS_H__
+#define __NATIVE_FREERTOS_H__
+
+#include <stdint.h>
+#include "../NativeHal.h"
+
+// FreeRTOS types and constants with the values the ESP32 Arduino core builds with (1 kHz tick).
+typedef uint32_t TickType_t;
+typedef int BaseType_t;
+typedef unsigned int UBaseType_t;
+
+#define pdFALSE ((BaseType_t)0)
+#define pdTRUE  ((BaseType_t)1)
+#define pdPASS  pdTRUE
+#define pdFAIL  pdFALSE
+
+#define configTICK_RATE_HZ 1000
+#define portTICK_PERIOD_MS ((TickType_t)1000 / configTICK_RATE_HZ)
+#define portMAX_DELAY      ((TickType_t)0xffffffffUL)
+#define pdMS_TO_TICKS(ms)  ((TickType_t)(((uint64_t)(ms) * configTICK_RATE_HZ) / 1000))
+
+// One simulated core: an ISR's wake-up takes effect when the interrupted task next blocks.
+#define portYIELD_FROM_ISR(...) do {} while (0)
+
+#endif // __NATIVE_FREERTOS_H__
@@ -0,0 +1,67 @@
+#ifndef __NATIVE_FREERTOS_TASK_H__
+#define __NATIVE_FREERTOS_TASK_H__
+
+#include "FreeRTOS.h"
+
+// Task API on the native kernel. Cores and stack sizes are accepted and ignored: every task runs
+// on the one simulated core, highest priority first, and only switches when it blocks.
+typedef NativeTaskHandle TaskHandle_t;
+typedef void (*TaskFunction_t)(void*);
+
+#define tskNO_AFFINITY ((BaseType_t)0x7FFFFFFF)
+#define tskIDLE_PRIORITY ((UBaseType_t)0)
+
+inline uint64_t nativeTickUs(uint64_t tick) { return tick * (1000000ULL / configTICK_RATE_HZ); }
+
+inline BaseType_t xTaskCreatePinnedToCore(TaskFunction_t entry, const char* name, uint32_t stackDepth, void* arg,
+                                          UBaseType_t priority, TaskHandle_t* created, BaseType_t core) {
+    TaskHandle_t task = nativeTaskCreate(entry, name, arg, (int)priority);
+    if (created) *created = task;
+    return task ? pdPASS : pdFAIL;
+}
+
+inline BaseType_t xTaskCreate(TaskFunction_t entry, const char* name, uint32_t stackDepth, void* arg,
+                              UBaseType_t priority, TaskHandle_t* created) {
+    return xTaskCreatePinnedToCore(entry, name, stackDepth, arg, priority, created, tskNO_AFFINITY);
+}
+
+// Only a task deleting itself is supported.
+inline void vTaskDelete(TaskHandle_t task) {
+    if (task == nullptr || task == nativeTaskCurrent()) nativeTaskExit();
+}
+
+inline TaskHandle_t xTaskGetCurrentTaskHandle() { return nativeTaskCurrent(); }
+
+inline TickType_t xTaskGetTickCount() {
+    return (TickType_t)(nativeNowUs() / nativeTickUs(1));
+}
+
+inline void vTaskDelay(TickType_t ticks) {
+    nativeSleepUntilUs(nativeTickUs(nativeNowUs() / nativeTickUs(1) + ticks));
+}
+
+inline void vTaskDelayUntil(TickType_t* previousWake, TickType_t increment) {
+    *previousWake += increment;
+    uint64_t now = nativeNowUs() / nativeTickUs(1);
+    int32_t ahead = (int32_t)(*previousWake - (TickType_t)now);
+    nativeSleepUntilUs(nativeTickUs(ahead > 0 ? now + (uint64_t)ahead : now));
+}
+
+inline uint32_t ulTaskNotifyTake(BaseType_t clearOnExit, TickType_t ticksToWait) {
+    uint64_t deadline = ticksToWait == portMAX_DELAY
+        ? NATIVE_FOREVER
+        : nativeTickUs(nativeNowUs() / nativeTickUs(1) + ticksToWait);
+    return nativeTaskNotifyTake(clearOnExit != pdFALSE, deadline);
+}
+
+inline BaseType_t xTaskNotifyGive(TaskHandle_t task) {
+    nativeTaskNotifyGive(task);
+    return pdPASS;
+}
+
+inline void vTaskNotifyGiveFromISR(TaskHandle_t task, BaseType_t* higherPriorityTaskWoken) {
+    nativeTaskNotifyGive(task);
+    if (higherPriorityTaskWoken) *higherPriorityTaskWoken = pdTRUE;
+}
+
+#endif // __NATIVE_FREERTOS_TASK_H__
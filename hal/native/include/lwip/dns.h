@@ -0,0 +1,19 @@
+#ifndef __NATIVE_LWIP_DNS_H__
+#define __NATIVE_LWIP_DNS_H__
+
+#include "../NativeHal.h"
+#include "ip_addr.h"
+
+typedef void (*dns_found_callback)(const char* name, const ip_addr_t* ipaddr, void* callback_arg);
+
+// Names resolve against the native board's host table (and the host resolver after that), and
+// always answer at once, like a DNS cache hit.
+inline err_t dns_gethostbyname(const char* hostname, ip_addr_t* addr, dns_found_callback found, void* callback_arg) {
+    uint32_t address;
+    if (!hostname || !nativeResolve(hostname, address)) return ERR_VAL;
+    addr->u_addr.ip4.addr = address;
+    addr->type = IPADDR_TYPE_V4;
+    return ERR_OK;
+}
+
+#endif // __NATIVE_LWIP_DNS_H__
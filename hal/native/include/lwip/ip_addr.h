@@ -0,0 +1,30 @@
+#ifndef __NATIVE_LWIP_IP_ADDR_H__
+#define __NATIVE_LWIP_IP_ADDR_H__
+
+#include <stdint.h>
+
+typedef int8_t err_t;
+#define ERR_OK         0
+#define ERR_INPROGRESS -5
+#define ERR_VAL        -6
+#define ERR_ARG        -16
+
+typedef struct ip4_addr {
+    uint32_t addr; // network byte order
+} ip4_addr_t;
+
+#define IPADDR_TYPE_V4 0U
+#define IPADDR_TYPE_V6 6U
+
+typedef struct ip_addr {
+    union {
+        ip4_addr_t ip4;
+    } u_addr;
+    uint8_t type;
+} ip_addr_t;
+
+#define IP_IS_V4(ipaddr)              ((ipaddr)->type == IPADDR_TYPE_V4)
+#define ip_2_ip4(ipaddr)              (&((ipaddr)->u_addr.ip4))
+#define ip4_addr_get_u32(src_ipaddr)  ((src_ipaddr)->addr)
+
+#endif // __NATIVE_LWIP_IP_ADDR_H__
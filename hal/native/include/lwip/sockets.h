@@ -0,0 +1,16 @@
+#ifndef __NATIVE_LWIP_SOCKETS_H__
+#define __NATIVE_LWIP_SOCKETS_H__
+
+// lwIP's BSD socket API is the host's: stream sockets in a native build are real ones, so the
+// HTTP server can be reached with curl and the uplink can talk to a collector on the host.
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/select.h>
+#include <sys/socket.h>
+#include <sys/types.h>
+
+#endif // __NATIVE_LWIP_SOCKETS_H__
@@ -0,0 +1,14 @@
+#ifndef __NATIVE_LWIP_TCPIP_H__
+#define __NATIVE_LWIP_TCPIP_H__
+
+#include "ip_addr.h"
+
+typedef void (*tcpip_callback_fn)(void* ctx);
+
+// There is no separate lwIP thread: the callback runs on the caller, which holds the only core.
+inline err_t tcpip_callback(tcpip_callback_fn function, void* ctx) {
+    function(ctx);
+    return ERR_OK;
+}
+
+#endif // __NATIVE_LWIP_TCPIP_H__
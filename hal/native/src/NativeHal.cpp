@@ -0,0 +1,160 @@
+// NativeHal.h bound to the simulated board.
+
+#include <malloc.h>
+#include <netdb.h>
+#include <stdio.h>
+#include <time.h>
+#include <arpa/inet.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+#include "../NativeBoard.h"
+
+#define BOARD NativeBoard::instance()
+
+static const uint32_t HEAP_SIZE = 320 * 1024;
+static uint32_t minFreeHeap = HEAP_SIZE;
+
+uint64_t nativeNowUs() { return BOARD.getKernel().now(); }
+void nativeSleepUntilUs(uint64_t us) { BOARD.getKernel().sleepUntil(us); }
+void nativeYield() { BOARD.getKernel().yield(); }
+
+NativeTaskHandle nativeTaskCreate(void (*entry)(void*), const char* name, void* arg, int priority) {
+    return BOARD.getKernel().create(entry, name, arg, priority);
+}
+
+NativeTaskHandle nativeTaskCurrent() { return BOARD.getKernel().current(); }
+void nativeTaskExit() { BOARD.getKernel().exit(); }
+
+uint32_t nativeTaskNotifyTake(bool clear, uint64_t deadlineUs) {
+    return BOARD.getKernel().notifyTake(clear, deadlineUs);
+}
+
+void nativeTaskNotifyGive(NativeTaskHandle task) { BOARD.getKernel().notifyGive(task); }
+
+int nativePinRead(int pin) { return BOARD.getKernel().pinRead(pin); }
+
+void nativeAttachInterrupt(int pin, void (*handler)(void*), void* arg, int mode) {
+    BOARD.getKernel().attachInterrupt(pin, handler, arg, mode);
+}
+
+void nativeDetachInterrupt(int pin) { BOARD.getKernel().detachInterrupt(pin); }
+
+uint8_t nativeI2cWrite(uint8_t address, const uint8_t* data, size_t len, bool stop) {
+    return BOARD.getBus().write(address, data, len);
+}
+
+size_t nativeI2cRead(uint8_t address, uint8_t* out, size_t len) { return BOARD.getBus().read(address, out, len); }
+
+void nativeSerialWrite(const uint8_t* data, size_t len) {
+    if (!BOARD.getOptions().quiet) fwrite(data, 1, len, stdout);
+}
+
+uint32_t nativeRandom() { return BOARD.random(); }
+
+// The firmware's own allocations, against the ESP32's usable heap.
+uint32_t nativeFreeHeap() {
+#if defined(__GLIBC__) && (__GLIBC__ > 2 || __GLIBC_MINOR__ >= 33)
+    size_t used = mallinfo2().uordblks;
+#else
+    size_t used = (size_t)mallinfo().uordblks;
+#endif
+    uint32_t free = used < HEAP_SIZE ? HEAP_SIZE - (uint32_t)used : 0;
+    if (free < minFreeHeap) minFreeHeap = free;
+    return free;
+}
+
+uint32_t nativeMinFreeHeap() {
+    nativeFreeHeap();
+    return minFreeHeap;
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+static uint64_t hostCycles() { return __rdtsc(); }
+#else
+static uint64_t hostCycles() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+#endif
+
+uint32_t nativeCycleCount() { return (uint32_t)hostCycles(); }
+
+// The counter's rate, measured once against the monotonic clock.
+uint32_t nativeCycleHz() {
+    static uint32_t hz = [] {
+        struct timespec start, now;
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        uint64_t c0 = hostCycles();
+        double elapsed;
+        do {
+            clock_gettime(CLOCK_MONOTONIC, &now);
+            elapsed = (double)(now.tv_sec - start.tv_sec) + (double)(now.tv_nsec - start.tv_nsec) / 1e9;
+        } while (elapsed < 0.02);
+        return (uint32_t)((double)(hostCycles() - c0) / elapsed);
+    }();
+    return hz;
+}
+
+const char* nativeSdRoot() { return BOARD.sdPath(); }
+const char* nativeNvsRoot() { return BOARD.nvsPath(); }
+
+void nativeWifiBegin(const char* ssid, const char* password) { BOARD.getAccessPoint().begin(ssid, password); }
+void nativeWifiDisconnect() { BOARD.getAccessPoint().disconnect(); }
+
+NativeWifiStatus nativeWifiStatus() {
+    switch (BOARD.getAccessPoint().status()) {
+        case WifiDriver::LINK_UP:          return NATIVE_WIFI_UP;
+        case WifiDriver::LINK_NO_AP:       return NATIVE_WIFI_NO_AP;
+        case WifiDriver::LINK_AUTH_FAILED: return NATIVE_WIFI_AUTH_FAILED;
+        default:                           return NATIVE_WIFI_DOWN;
+    }
+}
+
+bool nativeWifiStartScan() { return BOARD.getAccessPoint().startScan(); }
+int nativeWifiScanStatus() { return BOARD.getAccessPoint().scanStatus(); }
+
+bool nativeWifiScanEntry(int index, char* ssid, size_t ssidSize, int8_t& rssi, uint8_t& channel, uint8_t& auth) {
+    WifiDriver::ScanEntry e;
+    if (!BOARD.getAccessPoint().scanEntry(index, e)) return false;
+    snprintf(ssid, ssidSize, "%s", e.ssid);
+    rssi = e.rssi;
+    channel = e.channel;
+    auth = e.auth;
+    return true;
+}
+
+void nativeWifiScanDelete() { BOARD.getAccessPoint().scanDelete(); }
+int8_t nativeWifiRssi() { return -55; }
+uint32_t nativeLocalAddress() { return NativeBoard::LOCAL_ADDRESS; }
+
+bool nativeResolve(const char* host, uint32_t& address) { return BOARD.resolve(host, address); }
+
+bool nativeUdpSend(uint32_t address, uint16_t port, const uint8_t* data, size_t len) {
+    return BOARD.udpSend(address, port, data, len);
+}
+
+size_t nativeUdpReceive(uint8_t* out, size_t capacity) { return BOARD.udpReceive(out, capacity); }
+
+bool nativeBleNotify(uint16_t connHandle, uint16_t attrHandle, const uint8_t* data, size_t len) {
+    return BOARD.bleNotify(connHandle, attrHandle, data, len);
+}
+
+void nativeBleAdvertising(bool on) { BOARD.bleAdvertising(on); }
+
+// Names the board doesn't know go to the host's resolver (blocking, in host time).
+bool NativeBoard::resolveOnHost(const char* host, uint32_t& address) {
+    struct in_addr literal;
+    if (inet_pton(AF_INET, host, &literal) == 1) {
+        address = literal.s_addr;
+        return true;
+    }
+    struct addrinfo hints = {};
+    hints.ai_family = AF_INET;
+    struct addrinfo* result = nullptr;
+    if (getaddrinfo(host, nullptr, &hints, &result) != 0 || !result) return false;
+    address = ((struct sockaddr_in*)result->ai_addr)->sin_addr.s_addr;
+    freeaddrinfo(result);
+    return true;
+}
@@ -0,0 +1,146 @@
+// Entry point of the native build: parses the board options, powers the board up and runs the
+// firmware's setup() and loop() on it, as the ESP32 Arduino core's app_main does.
+//
+//   photoniq [--speed X] [--duration S] [--data DIR] [--no-sd] [--lux L] [--noise PCT]
+//            [--central S | --no-central] [--provision SSID,PASS] [--ap SSID,PASS]
+//            [--collector HOST] [--rtc-drift PPM] [--rtc-offset S] [--seed N] [--quiet] [--trace FILE]
+
+#include <chrono>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <Arduino.h>
+#include "../NativeBoard.h"
+#include "../../../src/TraceLog.h"
+
+static std::chrono::steady_clock::time_point hostStart;
+static const char* tracePath = nullptr;
+
+static void usage(const char* program) {
+    fprintf(stderr,
+            "usage: %s [options]\n"
+            "  --speed X           simulated seconds per host second, 0 = flat out (default 1)\n"
+            "  --duration S        stop after S simulated seconds and print a summary\n"
+            "  --data DIR          directory for sd/ and nvs/ (default native-data)\n"
+            "  --no-sd             boot without a card\n"
+            "  --lux L             scene brightness (default 250)\n"
+            "  --noise PCT         scene noise, +/- percent per second (default 2)\n"
+            "  --central S         a BLE central connects after S seconds (default 2)\n"
+            "  --no-central        nothing connects over BLE\n"
+            "  --provision S,P     the central writes Wi-Fi credentials S,P after connecting\n"
+            "  --ap S,P            the access point's SSID and password (default PhotonIQ-Lab,photoniq)\n"
+            "  --collector HOST    where photoniq-collector.local resolves (default 127.0.0.1)\n"
+            "  --rtc-drift PPM     DS3231 frequency error (default 15)\n"
+            "  --rtc-offset S      DS3231 minus true time at power-up (default -3)\n"
+            "  --seed N            noise seed (default 1)\n"
+            "  --quiet             no firmware console output\n"
+            "  --trace FILE        at the end of the run, write the trace ring to FILE (tools/trace_decode.py)\n",
+            program);
+    exit(2);
+}
+
+// Splits "A,B" in place.
+static void splitPair(char* pair, const char*& first, const char*& second) {
+    char* comma = strchr(pair, ',');
+    if (comma) *comma = '\0';
+    first = pair;
+    second = comma ? comma + 1 : "";
+}
+
+static NativeBoardOptions parseOptions(int argc, char** argv) {
+    NativeBoardOptions o = {};
+    o.speed = 1;
+    o.dataDir = "native-data";
+    o.sdCard = true;
+    o.lux = 250;
+    o.noisePercent = 2;
+    o.centralAtS = 2;
+    o.apSsid = "PhotonIQ-Lab";
+    o.apPassword = "photoniq";
+    o.collector = "127.0.0.1";
+    o.rtcDriftPpm = 15;
+    o.rtcOffsetS = -3;
+    o.seed = 1;
+
+    for (int i = 1; i < argc; i++) {
+        const char* arg = argv[i];
+        bool hasValue = i + 1 < argc;
+        if (strcmp(arg, "--no-sd") == 0) o.sdCard = false;
+        else if (strcmp(arg, "--no-central") == 0) o.centralAtS = -1;
+        else if (strcmp(arg, "--quiet") == 0) o.quiet = true;
+        else if (!hasValue) usage(argv[0]);
+        else if (strcmp(arg, "--speed") == 0) o.speed = atof(argv[++i]);
+        else if (strcmp(arg, "--duration") == 0) o.durationS = atof(argv[++i]);
+        else if (strcmp(arg, "--data") == 0) o.dataDir = argv[++i];
+        else if (strcmp(arg, "--lux") == 0) o.lux = atof(argv[++i]);
+        else if (strcmp(arg, "--noise") == 0) o.noisePercent = atof(argv[++i]);
+        else if (strcmp(arg, "--central") == 0) o.centralAtS = atof(argv[++i]);
+        else if (strcmp(arg, "--provision") == 0) o.provision = argv[++i];
+        else if (strcmp(arg, "--ap") == 0) splitPair(argv[++i], o.apSsid, o.apPassword);
+        else if (strcmp(arg, "--collector") == 0) o.collector = argv[++i];
+        else if (strcmp(arg, "--rtc-drift") == 0) o.rtcDriftPpm = atof(argv[++i]);
+        else if (strcmp(arg, "--rtc-offset") == 0) o.rtcOffsetS = atof(argv[++i]);
+        else if (strcmp(arg, "--seed") == 0) o.seed = (uint32_t)strtoul(argv[++i], nullptr, 0);
+        else if (strcmp(arg, "--trace") == 0) tracePath = argv[++i];
+        else usage(argv[0]);
+    }
+    return o;
+}
+
+// The trace ring as GET /trace would serve it.
+static void writeTrace(const char* path) {
+    FILE* fp = fopen(path, "wb");
+    if (!fp) {
+        fprintf(stderr, "trace: cannot write %s\n", path);
+        return;
+    }
+    uint8_t chunk[1024];
+    uint32_t cursor = 0;
+    size_t bytes = 0;
+    for (size_t n; (n = traceLog.dump(cursor, chunk, sizeof(chunk))) > 0; bytes += n) fwrite(chunk, 1, n, fp);
+    fclose(fp);
+    fprintf(stderr, "trace: %u records written, %u lost before printing; %u bytes to %s\n",
+            (unsigned)traceLog.writtenCount(), (unsigned)traceLog.lostCount(), (unsigned)bytes, path);
+}
+
+// Runs on whichever task's thread reaches the end of the run, with every task parked.
+static void printSummary(void* ctx) {
+    NativeBoard& board = NativeBoard::instance();
+    const NativeKernel::Stats& k = board.getKernel().getStats();
+    const NativeBoard::Stats& s = board.getStats();
+    double hostS = std::chrono::duration<double>(std::chrono::steady_clock::now() - hostStart).count();
+    double simS = board.getKernel().now() / 1e6;
+
+    fflush(stdout);
+    fprintf(stderr, "\n--- native run: %.1f s simulated in %.2f s host (x%.0f) ---\n", simS, hostS,
+            hostS > 0 ? simS / hostS : 0.0);
+    fprintf(stderr, "kernel: %u tasks, %llu context switches, %u interrupts\n", k.tasksCreated,
+            (unsigned long long)k.contextSwitches, k.interrupts);
+    fprintf(stderr, "tsl2591: %u ALS cycles, i2c: %u transactions\n", board.getTsl().cyclesCompleted(),
+            board.getBus().transactionCount());
+    fprintf(stderr, "ble: %u notifications (%llu bytes), %u rejected\n", s.notifications,
+            (unsigned long long)s.notifyBytes, s.notifyRejected);
+    fprintf(stderr, "wifi: %u association attempts, %u scans; ntp: %u requests; dns: %u lookups\n",
+            board.getAccessPoint().beginCount(), board.getAccessPoint().scanStartCount(), board.getNtp().requestCount(),
+            s.lookups);
+    fprintf(stderr, "ds3231: %+.3f s from true time, aging %d\n",
+            board.getRtc().timeSeconds() - board.getNtp().now() / 1e6, board.getRtc().agingOffset());
+    fprintf(stderr, "heap: %u free, %u minimum\n", nativeFreeHeap(), nativeMinFreeHeap());
+    if (tracePath) writeTrace(tracePath);
+    fflush(stderr);
+    _exit(0);
+}
+
+int main(int argc, char** argv) {
+    NativeBoardOptions options = parseOptions(argc, argv);
+    setvbuf(stdout, nullptr, _IOLBF, 0);
+    hostStart = std::chrono::steady_clock::now();
+
+    NativeBoard& board = NativeBoard::instance();
+    board.begin(options);
+    if (options.durationS > 0) board.stopAfter((uint64_t)(options.durationS * 1e6), printSummary, nullptr);
+
+    setup();
+    for (;;) loop();
+}
@@ -0,0 +1,183 @@
+#ifndef __ALS_ACQUISITION_H__
+#define __ALS_ACQUISITION_H__
+
+#include <stddef.h>
+#include <stdint.h>
+#include "AutoRange.h"
+#include "ByteCodec.h"
+#include "Tsl2591Bus.h"
+
+// Interrupt-driven TSL2591 acquisition. The ALS runs continuously and raises INT when a
+// conversion completes (MODE_CONVERSION) or when CH0 leaves a window around the last reading
+// for `persist` cycles (MODE_THRESHOLD), so the sensor task sleeps until there is something to
+// read instead of blocking through every integration.
+//
+// service() is called after each INT edge (interrupted = true) or on a timer (false). Either
+// way it reads STATUS and, if a conversion is available, the channels, then releases INT. A
+// timer poll just picks up the latest completed conversion, so it never waits on the chip.
+// In threshold mode the window is re-armed around every reading that produced an event or fell
+// outside it. After a gain / time change the window is held open and PERSIST drops to "every
+// cycle", so the first conversion at the new setting interrupts and re-arms it.
+// Pure logic over Tsl2591Bus: runs against the real chip or a simulated one.
+class AlsAcquisition {
+public:
+    enum Mode : uint8_t { MODE_CONVERSION, MODE_THRESHOLD };
+
+    enum Event : uint8_t {
+        EVENT_NONE,         // nothing to read (no conversion yet, or spurious edge)
+        EVENT_CONVERSION,   // a reading, nothing crossed
+        EVENT_THRESHOLD,    // a reading that left the armed window
+        EVENT_ERROR,        // bus error
+    };
+
+    struct Reading {
+        uint16_t full;
+        uint16_t ir;
+        uint8_t control;    // CONTROL register value the reading was taken at
+    };
+
+    struct Stats {
+        uint32_t interrupts;      // service() calls made for an INT edge
+        uint32_t spurious;        // ... of which found no conversion to read
+        uint32_t readings;
+        uint32_t thresholdEvents;
+        uint32_t rearms;
+        uint32_t busErrors;
+    };
+
+    static constexpr uint16_t MIN_WINDOW_COUNTS = 4; // keeps a dark reading from re-arming on noise
+
+    explicit AlsAcquisition(Tsl2591Bus& bus_)
+        : bus(bus_), mode(MODE_CONVERSION), control(0), windowPermille(50), persist(Tsl2591Bus::PERSIST_ANY),
+          active(false), armed(false), low(0), high(0xFFFF), stats() {}
+
+    static uint8_t controlFor(AutoRange::Setting s) { return (uint8_t)((s.gain << 4) | s.time); }
+
+    // Window half-width as 1/1000 of the reading it is armed around, and the PERSIST register
+    // value applied once armed (1 = first cycle outside, 2 = two consecutive, ...).
+    void setThresholdWindow(uint16_t permille, uint8_t persistValue) {
+        windowPermille = permille;
+        persist = persistValue == Tsl2591Bus::PERSIST_EVERY ? Tsl2591Bus::PERSIST_ANY : persistValue;
+    }
+
+    // Powers the ALS up in continuous mode at setting s with the interrupt enabled.
+    bool begin(Mode m, AutoRange::Setting s) {
+        mode = m;
+        control = controlFor(s);
+        active = restart();
+        return active;
+    }
+
+    void stop() {
+        if (active && !bus.write8(Tsl2591Bus::REG_ENABLE, 0)) stats.busErrors++;
+        active = false;
+    }
+
+    bool running() const { return active; }
+    Mode getMode() const { return mode; }
+
+    // Changes gain / integration time. AEN is cycled so the next conversion is entirely at the
+    // new setting; nothing from the old one is reported after this returns.
+    bool setSetting(AutoRange::Setting s) {
+        control = controlFor(s);
+        if (!active) return true;
+        return restart();
+    }
+
+    Event service(bool interrupted, Reading& out) {
+        if (!active) return EVENT_NONE;
+        if (interrupted) stats.interrupts++;
+
+        uint8_t status;
+        if (!bus.read(Tsl2591Bus::REG_STATUS, &status, 1)) return busError();
+        if (!(status & Tsl2591Bus::STATUS_AVALID)) {
+            if (interrupted) stats.spurious++;
+            return EVENT_NONE;
+        }
+
+        uint8_t data[4];
+        if (!bus.read(Tsl2591Bus::REG_C0DATAL, data, sizeof(data))) return busError();
+        out.full = getLe16(data);
+        out.ir = getLe16(data + 2);
+        out.control = control;
+        stats.readings++;
+
+        Event event = EVENT_CONVERSION;
+        if (status & Tsl2591Bus::STATUS_AINT) {
+            if (!bus.command(Tsl2591Bus::CMD_CLEAR_INTERRUPTS)) stats.busErrors++;
+            if (mode == MODE_THRESHOLD && armed) {
+                event = EVENT_THRESHOLD;
+                stats.thresholdEvents++;
+            }
+        }
+        if (mode == MODE_THRESHOLD && (event == EVENT_THRESHOLD || !armed || out.full < low || out.full > high)) {
+            arm(out.full);
+        }
+        return event;
+    }
+
+    uint16_t lowThreshold() const { return low; }
+    uint16_t highThreshold() const { return high; }
+    const Stats& getStats() const { return stats; }
+
+private:
+    static constexpr uint8_t ENABLE_RUN = Tsl2591Bus::ENABLE_PON | Tsl2591Bus::ENABLE_AEN | Tsl2591Bus::ENABLE_AIEN;
+
+    // AEN off, new CONTROL, open window, INT released, AEN back on: a fresh cycle at `control`.
+    bool restart() {
+        bool ok = bus.write8(Tsl2591Bus::REG_ENABLE, Tsl2591Bus::ENABLE_PON)
+               && bus.write8(Tsl2591Bus::REG_CONTROL, control)
+               && disarm()
+               && bus.command(Tsl2591Bus::CMD_CLEAR_INTERRUPTS)
+               && bus.write8(Tsl2591Bus::REG_ENABLE, ENABLE_RUN);
+        if (!ok) stats.busErrors++;
+        return ok;
+    }
+
+    Event busError() {
+        stats.busErrors++;
+        return EVENT_ERROR;
+    }
+
+    bool writeThresholds(uint16_t lo, uint16_t hi) {
+        low = lo;
+        high = hi;
+        return bus.write8(Tsl2591Bus::REG_AILTL,     (uint8_t)lo)
+            && bus.write8(Tsl2591Bus::REG_AILTL + 1, (uint8_t)(lo >> 8))
+            && bus.write8(Tsl2591Bus::REG_AILTL + 2, (uint8_t)hi)
+            && bus.write8(Tsl2591Bus::REG_AILTL + 3, (uint8_t)(hi >> 8));
+    }
+
+    // Open window, interrupt on every cycle: the next conversion is always reported.
+    bool disarm() {
+        armed = false;
+        return writeThresholds(0, 0xFFFF)
+            && bus.write8(Tsl2591Bus::REG_PERSIST, Tsl2591Bus::PERSIST_EVERY);
+    }
+
+    void arm(uint16_t full) {
+        uint32_t span = (uint32_t)full * windowPermille / 1000;
+        if (span < MIN_WINDOW_COUNTS) span = MIN_WINDOW_COUNTS;
+        uint16_t lo = full > span ? (uint16_t)(full - span) : 0;
+        uint16_t hi = (uint32_t)full + span < 0xFFFF ? (uint16_t)(full + span) : 0xFFFF;
+        if (writeThresholds(lo, hi) && bus.write8(Tsl2591Bus::REG_PERSIST, persist)) {
+            armed = true;
+            stats.rearms++;
+        } else {
+            stats.busErrors++;
+        }
+    }
+
+    Tsl2591Bus& bus;
+    Mode mode;
+    uint8_t control;
+    uint16_t windowPermille;
+    uint8_t persist;
+    bool active;
+    bool armed;
+    uint16_t low;
+    uint16_t high;
+    Stats stats;
+};
+
+#endif // __ALS_ACQUISITION_H__
@@ -0,0 +1,74 @@
+#ifndef __ARDUINO_HTTP_TRANSPORT_H__
+#define __ARDUINO_HTTP_TRANSPORT_H__
+
+#include <Arduino.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <lwip/sockets.h>
+#include "HttpServer.h"
+
+// HttpTransport over non-blocking lwIP sockets. WiFiServer/WiFiClient would do, but their
+// available()/write() block or allocate per call; plain sockets keep every call a single
+// non-blocking syscall.
+class ArduinoHttpTransport : public HttpTransport {
+public:
+    static constexpr int BACKLOG = 2;
+
+    ArduinoHttpTransport() : listener(-1) {}
+
+    bool listen(uint16_t port) override {
+        listener = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+        if (listener < 0) return false;
+        int one = 1;
+        setsockopt(listener, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+        sockaddr_in addr;
+        memset(&addr, 0, sizeof(addr));
+        addr.sin_family = AF_INET;
+        addr.sin_port = htons(port);
+        addr.sin_addr.s_addr = htonl(INADDR_ANY);
+        if (bind(listener, (sockaddr*)&addr, sizeof(addr)) != 0 || ::listen(listener, BACKLOG) != 0) {
+            ::close(listener);
+            listener = -1;
+            return false;
+        }
+        setNonBlocking(listener);
+        return true;
+    }
+
+    int accept() override {
+        if (listener < 0) return -1;
+        int fd = ::accept(listener, nullptr, nullptr);
+        if (fd < 0) return -1;
+        setNonBlocking(fd);
+        int one = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+        return fd;
+    }
+
+    int read(int conn, uint8_t* out, size_t capacity) override {
+        ssize_t n = recv(conn, out, capacity, MSG_DONTWAIT);
+        if (n > 0) return (int)n;
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) return 0;
+        return -1;
+    }
+
+    int write(int conn, const uint8_t* data, size_t len) override {
+        ssize_t n = send(conn, data, len, MSG_DONTWAIT);
+        if (n >= 0) return (int)n;
+        return errno == EAGAIN || errno == EWOULDBLOCK ? 0 : -1;
+    }
+
+    void close(int conn) override {
+        ::close(conn);
+    }
+
+private:
+    static void setNonBlocking(int fd) {
+        fcntl(fd, F_SETFL, fcntl(fd, F_GETFL, 0) | O_NONBLOCK);
+    }
+
+    int listener;
+};
+
+#endif // __ARDUINO_HTTP_TRANSPORT_H__
@@ -0,0 +1,51 @@
+#ifndef __ARDUINO_NTP_TRANSPORT_H__
+#define __ARDUINO_NTP_TRANSPORT_H__
+
+#include <Arduino.h>
+#include <WiFi.h>
+#include <WiFiUdp.h>
+#include "HostLookup.h"
+#include "NtpSync.h"
+
+// NtpTransport over WiFiUDP. The server name is resolved in the background (HostLookup) rather
+// than by WiFiUDP::beginPacket(host), and looked up again for every sync so a pool server that
+// went away is not reused.
+class ArduinoNtpTransport : public NtpTransport {
+public:
+    static constexpr uint16_t NTP_PORT   = 123;
+    static constexpr uint16_t LOCAL_PORT = 2390;
+
+    explicit ArduinoNtpTransport(const char* host) : lookup(host), bound(false) {}
+
+    bool open() override {
+        if (!bound) bound = udp.begin(LOCAL_PORT) == 1;
+        bool resolved = lookup.resolve();
+        return bound && resolved;
+    }
+
+    bool send(const uint8_t* packet, size_t len) override {
+        if (!udp.beginPacket(IPAddress(lookup.address()), NTP_PORT)) return false;
+        udp.write(packet, len);
+        return udp.endPacket() == 1;
+    }
+
+    size_t receive(uint8_t* out, size_t capacity) override {
+        if (udp.parsePacket() <= 0) return 0;
+        int n = udp.read(out, capacity);
+        udp.flush();
+        return n > 0 ? (size_t)n : 0;
+    }
+
+    void close() override {
+        udp.stop();
+        bound = false;
+        lookup.reset();
+    }
+
+private:
+    WiFiUDP udp;
+    HostLookup lookup;
+    bool bound;
+};
+
+#endif // __ARDUINO_NTP_TRANSPORT_H__
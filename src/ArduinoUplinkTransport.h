@@ -0,0 +1,124 @@
+#ifndef __ARDUINO_UPLINK_TRANSPORT_H__
+#define __ARDUINO_UPLINK_TRANSPORT_H__
+
+#include <Arduino.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <lwip/sockets.h>
+#include "HostLookup.h"
+#include "Uplink.h"
+
+// UplinkTransport over a plain lwIP TCP socket. WiFiClient::connect() resolves the name and
+// waits for the handshake on the calling task; here the name is resolved in the background
+// (HostLookup) and the socket is non-blocking, so connect() only checks on progress.
+//
+// One connect() sequence is one attempt: after a failed lookup or a refused connection it keeps
+// returning false until the Uplink gives up on the attempt and calls close(), so retries follow
+// the Uplink's backoff rather than its 10 ms poll. The address is kept across failed attempts and
+// only looked up again after REFRESH_AFTER_FAILURES of them in a row (the server may have moved).
+class ArduinoUplinkTransport : public UplinkTransport {
+public:
+    static constexpr uint8_t REFRESH_AFTER_FAILURES = 3;
+
+    ArduinoUplinkTransport(const char* host, uint16_t port_)
+        : lookup(host), port(port_), fd(-1), established(false), broken(false), attemptFailed(false), failures(0) {}
+
+    bool connect() override {
+        if (fd >= 0 && established) return !broken;
+        if (fd < 0) return !attemptFailed && startConnect();
+
+        fd_set writable;
+        FD_ZERO(&writable);
+        FD_SET(fd, &writable);
+        timeval poll = {0, 0};
+        if (select(fd + 1, nullptr, &writable, nullptr, &poll) <= 0) return false;
+        int err = 0;
+        socklen_t len = sizeof(err);
+        if (getsockopt(fd, SOL_SOCKET, SO_ERROR, &err, &len) != 0 || err != 0) {
+            abandon();
+            return false;
+        }
+        established = true;
+        failures = 0;
+        return true;
+    }
+
+    bool connected() override { return fd >= 0 && established && !broken; }
+
+    size_t write(const uint8_t* data, size_t len) override {
+        if (!connected()) return 0;
+        ssize_t n = send(fd, data, len, MSG_DONTWAIT);
+        if (n > 0) return (size_t)n;
+        if (n < 0 && errno != EAGAIN && errno != EWOULDBLOCK) broken = true;
+        return 0;
+    }
+
+    size_t read(uint8_t* out, size_t capacity) override {
+        if (fd < 0 || !established) return 0;
+        ssize_t n = recv(fd, out, capacity, MSG_DONTWAIT);
+        if (n > 0) return (size_t)n;
+        if (n == 0 || (errno != EAGAIN && errno != EWOULDBLOCK)) broken = true;
+        return 0;
+    }
+
+    void close() override {
+        closeSocket();
+        attemptFailed = false;
+        lookup.retry();
+        if (failures >= REFRESH_AFTER_FAILURES) {
+            lookup.reset();
+            failures = 0;
+        }
+    }
+
+private:
+    bool startConnect() {
+        if (!lookup.resolve()) return false; // a failed lookup waits for close() to be retried
+        fd = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+        if (fd < 0) {
+            abandon();
+            return false;
+        }
+        fcntl(fd, F_SETFL, fcntl(fd, F_GETFL, 0) | O_NONBLOCK);
+        int one = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one)); // the body follows the head at once
+
+        sockaddr_in addr;
+        memset(&addr, 0, sizeof(addr));
+        addr.sin_family = AF_INET;
+        addr.sin_port = htons(port);
+        addr.sin_addr.s_addr = lookup.address();
+        if (::connect(fd, (sockaddr*)&addr, sizeof(addr)) == 0) {
+            established = true;
+            failures = 0;
+            return true;
+        }
+        if (errno != EINPROGRESS) abandon();
+        return false;
+    }
+
+    // Ends this attempt without starting another.
+    void abandon() {
+        closeSocket();
+        attemptFailed = true;
+        if (failures < 255) failures++;
+    }
+
+    void closeSocket() {
+        if (fd >= 0) ::close(fd);
+        fd = -1;
+        established = false;
+        broken = false;
+    }
+
+    HostLookup lookup;
+    uint16_t port;
+    int fd;
+    bool established;
+    bool broken;
+    bool attemptFailed;
+    uint8_t failures;   // attempts in a row that failed to connect
+};
+
+#endif // __ARDUINO_UPLINK_TRANSPORT_H__
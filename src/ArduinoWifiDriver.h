@@ -0,0 +1,71 @@
+#ifndef __ARDUINO_WIFI_DRIVER_H__
+#define __ARDUINO_WIFI_DRIVER_H__
+
+#include <Arduino.h>
+#include <WiFi.h>
+#include "LatencyStats.h"
+#include "WifiDriver.h"
+
+// WifiDriver on the ESP32 Arduino WiFi class. Reconnection is left to WifiConnection, so the
+// stack's own auto-reconnect is turned off to keep the two from racing. Every call into the
+// stack is timed into LatencyStats::STAGE_WIFI.
+class ArduinoWifiDriver : public WifiDriver {
+public:
+    void begin(const char* ssid, const char* password) override {
+        LatencyStats::Scope timed(latencyStats, LatencyStats::STAGE_WIFI);
+        WiFi.mode(WIFI_STA);
+        WiFi.setAutoReconnect(false);
+        WiFi.begin(ssid, password);
+    }
+
+    void disconnect() override {
+        LatencyStats::Scope timed(latencyStats, LatencyStats::STAGE_WIFI);
+        WiFi.disconnect();
+    }
+
+    LinkStatus status() override {
+        LatencyStats::Scope timed(latencyStats, LatencyStats::STAGE_WIFI);
+        switch (WiFi.status()) {
+            case WL_CONNECTED:     return LINK_UP;
+            case WL_NO_SSID_AVAIL: return LINK_NO_AP;
+            case WL_CONNECT_FAILED: return LINK_AUTH_FAILED;
+            default:               return LINK_DOWN;
+        }
+    }
+
+    bool startScan() override {
+        LatencyStats::Scope timed(latencyStats, LatencyStats::STAGE_WIFI);
+        if (WiFi.getMode() == WIFI_OFF) WiFi.mode(WIFI_STA);
+        if (WiFi.scanNetworks(true) != WIFI_SCAN_FAILED) return true;
+        latencyStats.fail(LatencyStats::STAGE_WIFI);
+        return false;
+    }
+
+    int scanStatus() override {
+        LatencyStats::Scope timed(latencyStats, LatencyStats::STAGE_WIFI);
+        int16_t n = WiFi.scanComplete();
+        if (n == WIFI_SCAN_RUNNING) return SCAN_RUNNING;
+        if (n < 0) {
+            latencyStats.fail(LatencyStats::STAGE_WIFI);
+            return SCAN_FAILED;
+        }
+        return n;
+    }
+
+    bool scanEntry(int index, ScanEntry& out) override {
+        String ssid = WiFi.SSID(index);
+        strlcpy(out.ssid, ssid.c_str(), sizeof(out.ssid));
+        int32_t rssi = WiFi.RSSI(index);
+        out.rssi = (int8_t)(rssi < -128 ? -128 : rssi > 127 ? 127 : rssi);
+        out.channel = (uint8_t)WiFi.channel(index);
+        out.auth = (uint8_t)WiFi.encryptionType(index);
+        return true;
+    }
+
+    void scanDelete() override {
+        LatencyStats::Scope timed(latencyStats, LatencyStats::STAGE_WIFI);
+        WiFi.scanDelete();
+    }
+};
+
+#endif // __ARDUINO_WIFI_DRIVER_H__
@@ -0,0 +1,118 @@
+#ifndef __AUTO_RANGE_H__
+#define __AUTO_RANGE_H__
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Gain / integration-time selection for the TSL2591 from raw channel counts.
+// From the last reading it estimates the scene's count rate per (gain x ms), then picks the
+// shortest integration time, and at that time the lowest gain, whose predicted CH0 count reaches
+// targetCounts without crossing the high-water mark. Shorter integration means a faster sample
+// rate in bright light; the target keeps enough counts for the requested resolution in the dark.
+// A saturated reading says nothing about the true rate, so it steps sensitivity down one notch.
+// Hysteresis: the current setting is kept while its counts stay inside
+// [targetCounts / HYSTERESIS, high-water], unless a shorter integration would clear the target
+// by the same margin.
+// Pure logic: settings are indices into GAINS / TIMES, mapping to the driver is the caller's job.
+class AutoRange {
+public:
+    struct Setting {
+        uint8_t gain;   // index into GAINS
+        uint8_t time;   // index into TIMES
+
+        bool operator==(const Setting& o) const { return gain == o.gain && time == o.time; }
+        bool operator!=(const Setting& o) const { return !(*this == o); }
+    };
+
+    static constexpr size_t   GAIN_COUNT = 4;
+    static constexpr size_t   TIME_COUNT = 6;
+    static constexpr uint16_t GAINS[GAIN_COUNT] = { 1, 25, 428, 9876 };          // LOW, MED, HIGH, MAX
+    static constexpr uint16_t TIMES[TIME_COUNT] = { 100, 200, 300, 400, 500, 600 }; // ms
+    static constexpr uint32_t HYSTERESIS = 2;
+
+    // ADC full scale: the 100 ms setting tops out below 16 bits.
+    static constexpr uint16_t maxCount(uint8_t time) { return time == 0 ? 37888 : 65535; }
+
+    explicit AutoRange(uint16_t targetCounts_ = 1000, uint8_t highWaterPercent_ = 80)
+        : targetCounts(targetCounts_), highWaterPercent(highWaterPercent_), adjustments(0) {
+        current.gain = 1;
+        current.time = 0;
+    }
+
+    void setTarget(uint16_t counts) { targetCounts = counts; }
+    void setSetting(Setting s) { current = s; }
+    Setting setting() const { return current; }
+    uint32_t adjustmentCount() const { return adjustments; }
+
+    // Feeds one reading taken at the current setting. Returns true if the setting changed,
+    // in which case the next reading belongs to the new one.
+    bool update(uint16_t full, uint16_t ir) {
+        Setting next = choose(full, ir);
+        if (next == current) return false;
+        current = next;
+        adjustments++;
+        return true;
+    }
+
+    Setting choose(uint16_t full, uint16_t ir) const {
+        uint16_t ceiling = maxCount(current.time);
+        if (full >= ceiling || ir >= ceiling) return stepDown(current);
+
+        // Counts per (gain x ms), scaled by 2^16 to stay in integers. A zero reading is treated
+        // as one count so a dark scene still steers towards more sensitivity.
+        uint64_t rate = ((uint64_t)(full ? full : 1) << 16) / ((uint64_t)GAINS[current.gain] * TIMES[current.time]);
+
+        Setting best = mostSensitive();
+        bool found = false;
+        for (uint8_t t = 0; t < TIME_COUNT && !found; t++) {
+            for (uint8_t g = 0; g < GAIN_COUNT; g++) {
+                uint64_t predicted = predict(rate, { g, t });
+                if (predicted >= targetCounts && predicted <= highWater(t)) {
+                    best = { g, t };
+                    found = true;
+                    break;
+                }
+            }
+        }
+        if (!found) {
+            // Nothing reaches the target without risking saturation: take the most sensitive
+            // setting that stays below the high-water mark (or the least sensitive if it's that bright).
+            best = { 0, 0 };
+            for (uint8_t t = 0; t < TIME_COUNT; t++)
+                for (uint8_t g = 0; g < GAIN_COUNT; g++)
+                    if (predict(rate, { g, t }) <= highWater(t) && sensitivity({ g, t }) > sensitivity(best)) best = { g, t };
+        }
+
+        bool inBand = full >= targetCounts / HYSTERESIS && full <= highWater(current.time);
+        if (inBand) {
+            bool faster = found && best.time < current.time && predict(rate, best) >= (uint64_t)targetCounts * HYSTERESIS;
+            if (!faster) return current;
+        }
+        return best;
+    }
+
+private:
+    static uint32_t sensitivity(Setting s) { return (uint32_t)GAINS[s.gain] * TIMES[s.time]; }
+
+    static uint64_t predict(uint64_t rate, Setting s) {
+        return (rate * sensitivity(s)) >> 16;
+    }
+
+    uint32_t highWater(uint8_t time) const { return (uint32_t)maxCount(time) * highWaterPercent / 100; }
+
+    static Setting mostSensitive() { return { GAIN_COUNT - 1, TIME_COUNT - 1 }; }
+
+    // Saturated: shorten integration first (it also speeds sampling up), then drop gain.
+    static Setting stepDown(Setting s) {
+        if (s.time > 0) return { s.gain, 0 };
+        if (s.gain > 0) return { (uint8_t)(s.gain - 1), 0 };
+        return s;
+    }
+
+    uint16_t targetCounts;
+    uint8_t highWaterPercent;
+    uint32_t adjustments;
+    Setting current;
+};
+
+#endif // __AUTO_RANGE_H__
@@ -1,10 +1,19 @@
 #ifndef BLE_LIGHT_SENSOR_SERVICE_H
 #define BLE_LIGHT_SENSOR_SERVICE_H
 
-#include <algorithm>
+#include <mutex>
 #include <NimBLEDevice.h>
+#include "BootSequence.h"
+#include "GattRegistry.h"
+#include "HistoryTransfer.h"
+#include "LatencyStats.h"
+#include "LightPayload.h"
+#include "PublishPolicy.h"
+#include "StreamingStats.h"
 #include "Settings.h"
-#include "WifiNetwork.h"
+#include "TraceLog.h"
+#include "WifiConnection.h"
+#include "WifiScanner.h"
 // This class migrates the original ArduinoBLE-based implementation to NimBLE-Arduino.
 // Key differences:
 //  - Uses NimBLEServer/NimBLEService/NimBLECharacteristic.
@@ -15,255 +24,384 @@
 class BleLightSensorService;
 static BleLightSensorService* gBleInstance = nullptr; // for static-style access inside callbacks.
 
-struct CharactersticWriteCallback {
-    const char* uuid;
-    void (*callback)(BleLightSensorService*, NimBLECharacteristic*);
-};
-
-
-
 class BleLightSensorService : public NimBLEServerCallbacks {
 private:
-    WifiNetwork* pWifiNetwork;
+    WifiConnection* pWifiConnection;
+    WifiScanner* pWifiScanner;
 
 public:
     // UUID constants (same values as previous implementation to maintain compatibility)
     static constexpr const char* UUID_LIGHT_SERVICE               = "3d80c0aa-56b9-458f-82a1-12ce0310e076";
     static constexpr const char* UUID_LIGHT_CHARACTERISTIC        = "646bd4e2-0927-45ac-bf41-fd9c69aa31dd";
+    static constexpr const char* UUID_LIGHT_FORMAT_DESCRIPTOR     = "646bd4e3-0927-45ac-bf41-fd9c69aa31dd";
+    static constexpr const char* UUID_LIGHT_TEXT_CHARACTERISTIC   = "646bd4e4-0927-45ac-bf41-fd9c69aa31dd";
+    static constexpr const char* UUID_LIGHT_STATS_CHARACTERISTIC  = "646bd4e5-0927-45ac-bf41-fd9c69aa31dd";
     static constexpr const char* UUID_WIFI_SERVICE                = "458800E6-FC10-46BD-8CDA-7F0F74BB1DBF";
     static constexpr const char* UUID_WIFI_SSIDS_CHAR             = "B30041A1-23DF-473A-AEEC-0C8514514B03";
     static constexpr const char* UUID_WIFI_SCAN_CMD_CHAR          = "5F8B1E42-1A56-4B5A-8026-8B15BC7EE5F3";
     static constexpr const char* UUID_WIFI_CONNECTED_SSID_CHAR    = "A1B2C3D4-E5F6-4789-ABCD-EF0123456789";
     static constexpr const char* UUID_WIFI_CONNECTED_STATUS_CHAR  = "12345678-9ABC-DEF0-1234-56789ABCDEF0";
+    static constexpr const char* UUID_WIFI_SCAN_RESULTS_CHAR      = "5F8B1E43-1A56-4B5A-8026-8B15BC7EE5F3";
     static constexpr const char* UUID_SETTINGS_SERVICE            = "C1D5A3B2-7E2F-4F4C-9F1D-3A2B1C0D4E5F";
     static constexpr const char* UUID_SENSOR_NAME_CHAR            = "D2C1A3B2-7E2F-4F4C-9F1D-3A2B1C0D4E5F";
     static constexpr const char* UUID_SCAN_INTERVAL_CHAR          = "E3F4B5C6-8D9E-4F0A-B1C2-D3E4F5A6B7C8";
     static constexpr const char* UUID_WIFI_SSID_AND_PASSWORD_CHAR = "B2C1A3B2-7E2F-4F4C-9F1D-3A2B1C0D4E5F";
     static constexpr const char* UUID_WIFI_ENABLED_CHAR           = "D3C1A3B2-7E2F-4F4C-9F1D-3A2B1C0D4E5F";
+    static constexpr const char* UUID_HISTORY_SERVICE             = "9a3d0001-6b7c-4f2e-9d1a-5c3e8b7f2a10";
+    static constexpr const char* UUID_HISTORY_CONTROL_CHAR        = "9a3d0002-6b7c-4f2e-9d1a-5c3e8b7f2a10";
+    static constexpr const char* UUID_HISTORY_DATA_CHAR           = "9a3d0003-6b7c-4f2e-9d1a-5c3e8b7f2a10";
+    static constexpr const char* UUID_DIAGNOSTICS_SERVICE         = "9a3d0100-6b7c-4f2e-9d1a-5c3e8b7f2a10";
+    static constexpr const char* UUID_BOOT_TIMING_CHAR            = "9a3d0101-6b7c-4f2e-9d1a-5c3e8b7f2a10";
+    static constexpr const char* UUID_LATENCY_STATS_CHAR          = "9a3d0102-6b7c-4f2e-9d1a-5c3e8b7f2a10";
+
+    // Written to the latency stats characteristic: zero the histograms.
+    static constexpr uint8_t LATENCY_STATS_RESET = 1;
+
+    // Upper bound on history notifications queued per pumpHistory() call.
+    static constexpr int MAX_HISTORY_PACKETS_PER_PUMP = 16;
+
+    // Largest scan-result chunk; the MTU usually limits it first.
+    static constexpr size_t MAX_SCAN_CHUNK = 512;
 
 private:
     NimBLEServer*  pServer          = nullptr;
     NimBLEService* pLightService    = nullptr;
     NimBLEService* pWifiService     = nullptr;
     NimBLEService* pSettingsService = nullptr;
+    NimBLEService* pHistoryService  = nullptr;
+    NimBLEService* pDiagnosticsService = nullptr;
 
     NimBLECharacteristic* pLightLevelChar          = nullptr;
+    NimBLECharacteristic* pLightTextChar           = nullptr;
+    NimBLECharacteristic* pLightStatsChar          = nullptr;
     NimBLECharacteristic* pWifiSSIDsChar           = nullptr;
     NimBLECharacteristic* pWifiScanCmdChar         = nullptr;
     NimBLECharacteristic* pWifiConnectedSSIDChar   = nullptr;
     NimBLECharacteristic* pWifiConnectedStatusChar = nullptr;
+    NimBLECharacteristic* pWifiScanResultsChar     = nullptr;
     NimBLECharacteristic* pSensorNameChar          = nullptr;
     NimBLECharacteristic* pScanIntervalChar        = nullptr;
     NimBLECharacteristic* pWifiSSIDCharAndPassword = nullptr;
     NimBLECharacteristic* pWifiEnabledChar         = nullptr;
+    NimBLECharacteristic* pHistoryControlChar      = nullptr;
+    NimBLECharacteristic* pHistoryDataChar         = nullptr;
+    NimBLECharacteristic* pBootTimingChar          = nullptr;
+    NimBLECharacteristic* pLatencyStatsChar        = nullptr;
 
-    // Write callback map for when characteristics are written to from the central
-    static constexpr size_t callbacksLen = 6;
-    CharactersticWriteCallback writeCallbacks[callbacksLen] = {
-        { UUID_SENSOR_NAME_CHAR, &BleLightSensorService::onWriteSensorName    },
-        { UUID_SCAN_INTERVAL_CHAR, &BleLightSensorService::onWriteScanInterval },
-        { UUID_WIFI_SSID_AND_PASSWORD_CHAR, &BleLightSensorService::onWriteWifiSSIDAndPassword },
-        { UUID_WIFI_ENABLED_CHAR, &BleLightSensorService::onWriteWifiEnabled   },
-        { UUID_WIFI_SCAN_CMD_CHAR, &BleLightSensorService::onWriteWifiScanCmd  }
-    };  
-
-    static void onWriteSensorName(BleLightSensorService* bleSvcInst, NimBLECharacteristic* c) {
-        String newName = c->getValue().c_str();
-        Serial.print("Received new sensor name: "); Serial.println(newName);
-        if (bleSvcInst) bleSvcInst->saveSensorName(newName);
-    }
-
-    static void onWriteScanInterval(BleLightSensorService* bleSvcInst, NimBLECharacteristic* c) {
-        std::string value = c->getValue();
-        int interval = 0;
-        if(!value.empty()) interval = atoi(value.c_str());
-        Serial.print("Received new scan interval: "); Serial.println(interval);
-        if (bleSvcInst) bleSvcInst->saveScanInterval(interval);
-    }
-
-    static void onWriteWifiSSIDAndPassword(BleLightSensorService* bleSvcInst, NimBLECharacteristic* c) {
-        String ssid = c->getValue().c_str();
-        Serial.print("Received new WiFi SSID and Password: "); Serial.println(ssid);
-        SettingsManager settings; settings.begin(); settings.loadSettings();
-        String wifiSSIDAndPassword = c->getValue().c_str();
-        settings.setWiFiCredentials(wifiSSIDAndPassword); settings.end();
-        Serial.println("Wi-Fi SSID and password saved to settings.");
-
-        WifiCredentials creds = WifiNetwork::parseCredentials(wifiSSIDAndPassword);
-        bool result = bleSvcInst->pWifiNetwork->connect(creds);
-        if(result) {
-            Serial.println("Connected to new Wi-Fi network successfully.");
-            bleSvcInst->pWifiConnectedSSIDChar->setValue(creds.ssid.c_str());
-            bleSvcInst->pWifiConnectedSSIDChar->notify();
-            bleSvcInst->pWifiConnectedStatusChar->setValue("1");
-            bleSvcInst->pWifiConnectedStatusChar->notify();
-        } else {
-            Serial.println("Failed to connect to new Wi-Fi network.");
-            bleSvcInst->pWifiConnectedSSIDChar->setValue("");
-            bleSvcInst->pWifiConnectedSSIDChar->notify();
-            bleSvcInst->pWifiConnectedStatusChar->setValue("0");
-            bleSvcInst->pWifiConnectedStatusChar->notify();
-        }
+    HistoryTransfer* pHistory = nullptr;
+    volatile uint16_t historyConnHandle = BLE_HS_CONN_HANDLE_NONE;
+
+    uint64_t advertisingSinceUs = 0; // esp_timer time advertising first started
+
+    SettingsManager* pSettings = nullptr;
+    SensorSettings initialSettings; // snapshot taken in begin() for the settings characteristics' initial values
+
+public:
+    // --- GATT registry ---
+    // One line per service / characteristic. begin() builds the server from these tables and
+    // writes are dispatched by attribute handle to the handler named here.
+    enum ServiceId : uint8_t { SVC_LIGHT, SVC_WIFI, SVC_SETTINGS, SVC_HISTORY, SVC_DIAGNOSTICS, SVC_COUNT };
+
+    enum CharacteristicId : uint8_t {
+        CHAR_LIGHT, CHAR_LIGHT_TEXT, CHAR_LIGHT_STATS,
+        CHAR_WIFI_SSIDS, CHAR_WIFI_SCAN_CMD, CHAR_WIFI_CONNECTED_SSID, CHAR_WIFI_CONNECTED_STATUS, CHAR_WIFI_SCAN_RESULTS,
+        CHAR_SENSOR_NAME, CHAR_SCAN_INTERVAL, CHAR_WIFI_SSID_AND_PASSWORD, CHAR_WIFI_ENABLED,
+        CHAR_HISTORY_CONTROL, CHAR_HISTORY_DATA,
+        CHAR_BOOT_TIMING, CHAR_LATENCY_STATS,
+        CHAR_COUNT
+    };
 
-        settings.end();
+private:
+    static size_t initLightPayload(void*, uint8_t* out, size_t cap) {
+        LightSample empty = {};
+        empty.flags = LightSample::FLAG_NO_SIGNAL;
+        return LightPayload::encode(empty, out, cap);
+    }
+    static size_t initStatsPayload(void*, uint8_t* out, size_t cap) {
+        StreamingStats::Summary empty = {};
+        return StreamingStats::encode(empty, out, cap);
+    }
+    static size_t initText(const char* text, uint8_t* out, size_t cap) {
+        size_t len = strlen(text);
+        if (len > cap) len = cap;
+        memcpy(out, text, len);
+        return len;
+    }
+    static size_t initLatencyStats(void*, uint8_t* out, size_t cap) {
+        return latencyStats.encode(out, cap, millis());
+    }
+    static size_t initLightText(void*, uint8_t* out, size_t cap) { return initText("-1", out, cap); }
+    static size_t initZeroText(void*, uint8_t* out, size_t cap) { return initText("0", out, cap); }
+    static size_t initSensorName(void* owner, uint8_t* out, size_t cap) {
+        return initText(static_cast<BleLightSensorService*>(owner)->initialSettings.sensorName, out, cap);
+    }
+    static size_t initScanInterval(void* owner, uint8_t* out, size_t cap) {
+        char text[12];
+        snprintf(text, sizeof(text), "%d", static_cast<BleLightSensorService*>(owner)->initialSettings.updateInterval);
+        return initText(text, out, cap);
+    }
+    static size_t initWifiCredentials(void* owner, uint8_t* out, size_t cap) {
+        return initText(static_cast<BleLightSensorService*>(owner)->initialSettings.pWifiSSIDCharAndPassword, out, cap);
+    }
+    static size_t initWifiEnabled(void* owner, uint8_t* out, size_t cap) {
+        return initText(static_cast<BleLightSensorService*>(owner)->initialSettings.wifiEnabled ? "1" : "0", out, cap);
     }
 
-    static void onWriteWifiEnabled(BleLightSensorService* bleSvcInst, NimBLECharacteristic* c) {
-        std::string value = c->getValue();
-        bool enabled = (!value.empty() && (value[0] == '1' || value[0] == 't' || value[0] == 'T'));
-        Serial.print("Received Wi-Fi Enabled state: "); Serial.println(enabled ? "Enabled" : "Disabled");
-        SettingsManager settings; settings.begin(); settings.loadSettings(); 
-        settings.setWifiEnabled(enabled); settings.end();
-        Serial.println("Wi-Fi enabled state saved.");
+    static void onWriteSensorName(void* owner, const uint8_t* data, size_t len, uint16_t) {
+        TRACE_INFO("ble: sensor name <- %s", TraceBytes(data, len));
+        static_cast<BleLightSensorService*>(owner)->pSettings->setSensorName((const char*)data, len);
     }
 
-    static void onWriteWifiScanCmd(BleLightSensorService* bleSvcInst, NimBLECharacteristic* c) {
-        Serial.println("=== onWriteWifiScanCmd called ===");
-        std::string value = c->getValue();
-        Serial.print("Received value length: "); Serial.println(value.length());
-        
-        if (!value.empty()) {
-            Serial.print("First byte (decimal): "); Serial.println((int)value[0]);
-            Serial.print("First byte (hex): 0x"); Serial.println((int)value[0], HEX);
-        }
-        
+    static void onWriteScanInterval(void* owner, const uint8_t* data, size_t len, uint16_t) {
+        char text[12];
+        size_t n = len < sizeof(text) - 1 ? len : sizeof(text) - 1;
+        memcpy(text, data, n);
+        text[n] = '\0';
+        int interval = atoi(text);
+        TRACE_INFO("ble: scan interval <- %d", interval);
+        static_cast<BleLightSensorService*>(owner)->pSettings->setScanInterval(interval);
+    }
+
+    // Only stores the credentials; the settings listener hands them to WifiConnection, which
+    // connects in the background and reports the outcome through onWifiStateChanged(). The trace
+    // gets the SSID only.
+    static void onWriteWifiSSIDAndPassword(void* owner, const uint8_t* data, size_t len, uint16_t) {
+        const uint8_t* comma = (const uint8_t*)memchr(data, ',', len);
+        TRACE_INFO("ble: Wi-Fi credentials <- %s", TraceBytes(data, comma ? (size_t)(comma - data) : len));
+        static_cast<BleLightSensorService*>(owner)->pSettings->setWiFiCredentials((const char*)data, len);
+    }
+
+    static void onWriteWifiEnabled(void* owner, const uint8_t* data, size_t len, uint16_t) {
+        bool enabled = (len > 0 && (data[0] == '1' || data[0] == 't' || data[0] == 'T'));
+        TRACE_INFO("ble: Wi-Fi enabled <- %d", enabled);
+        static_cast<BleLightSensorService*>(owner)->pSettings->setWifiEnabled(enabled);
+    }
+
+    static void onWriteWifiScanCmd(void* owner, const uint8_t* data, size_t len, uint16_t) {
+        BleLightSensorService* bleSvcInst = static_cast<BleLightSensorService*>(owner);
         // iOS sends a UInt8 with value 1 (not ASCII '1' which is 49)
-        bool doScan = (!value.empty() && (value[0] == 1 || value[0] == '1'));
-        Serial.print("doScan: "); Serial.println(doScan ? "true" : "false");
-        Serial.print("bleSvcInst: "); Serial.println(bleSvcInst ? "valid" : "NULL");
-        
-        if(doScan && bleSvcInst) {
-            Serial.println("Start scanning for Wi-Fi SSIDs...");
-            int n = WiFi.scanNetworks();
-            Serial.println("Scan complete.");
-            String ssidList;
-            for(int i=0; i<n; i++) {
-                if(i>0) ssidList += ", ";
-                ssidList += WiFi.SSID(i);
-            }
-            bleSvcInst->pWifiSSIDsChar->setValue(ssidList.c_str());
-            bleSvcInst->pWifiSSIDsChar->notify();
-            Serial.println("Notified SSID list characteristic.");
+        bool doScan = (len > 0 && (data[0] == 1 || data[0] == '1'));
+        TRACE_DEBUG("ble: scan command, %u bytes, first 0x%02x", len, len > 0 ? data[0] : 0);
+
+        if(doScan && bleSvcInst->pWifiScanner) {
+            // Returns at once; results arrive through onScanResults() on loop().
+            WifiScanner::Request r = bleSvcInst->pWifiScanner->request(millis());
+            TRACE_INFO("ble: Wi-Fi scan %s", r == WifiScanner::REQUEST_CACHED ? "from cache" :
+                                             r == WifiScanner::REQUEST_PENDING ? "already running" : "started");
             // Reset to 0 (raw byte, not ASCII)
             uint8_t zero = 0;
-            c->setValue(&zero, 1);
-            Serial.print("Found SSIDs: "); Serial.println(ssidList);
+            bleSvcInst->pWifiScanCmdChar->setValue(&zero, 1);
         }
     }
 
-    // --- Callback classes ---
-    class GenericWriteCallback : public NimBLECharacteristicCallbacks {
+    // History requests remember the writer's connection so the stream goes back to it.
+    static void onWriteHistoryControl(void* owner, const uint8_t* data, size_t len, uint16_t conn) {
+        BleLightSensorService* bleSvcInst = static_cast<BleLightSensorService*>(owner);
+        if (!bleSvcInst->pHistory) return;
+        if (bleSvcInst->pHistory->handleCommand(data, len)) bleSvcInst->historyConnHandle = conn;
+    }
+
+    // Reads take a fresh snapshot (GattCallbacks::onRead); writing LATENCY_STATS_RESET starts over.
+    static void onWriteLatencyStats(void*, const uint8_t* data, size_t len, uint16_t) {
+        if (len > 0 && (data[0] == LATENCY_STATS_RESET || data[0] == '1')) latencyStats.reset(millis());
+    }
+
+public:
+    static constexpr GattServiceDef SERVICES[SVC_COUNT] = {
+        { UUID_LIGHT_SERVICE,    true  },
+        { UUID_WIFI_SERVICE,     true  },
+        { UUID_SETTINGS_SERVICE, true  },
+        { UUID_HISTORY_SERVICE,  false },
+        { UUID_DIAGNOSTICS_SERVICE, false },
+    };
+
+    static constexpr uint16_t RN  = GATT_READ | GATT_NOTIFY;
+    static constexpr uint16_t RWN = GATT_READ | GATT_WRITE | GATT_NOTIFY;
+    static constexpr uint16_t RW  = GATT_READ | GATT_WRITE;
+
+    static constexpr GattCharacteristicDef CHARACTERISTICS[CHAR_COUNT] = {
+        { CHAR_LIGHT,                  SVC_LIGHT,    UUID_LIGHT_CHARACTERISTIC,        RN,          LightPayload::SIZE,           &initLightPayload,    nullptr },
+        { CHAR_LIGHT_TEXT,             SVC_LIGHT,    UUID_LIGHT_TEXT_CHARACTERISTIC,   RN,          24,                           &initLightText,       nullptr },
+        { CHAR_LIGHT_STATS,            SVC_LIGHT,    UUID_LIGHT_STATS_CHARACTERISTIC,  RN,          StreamingStats::SUMMARY_SIZE, &initStatsPayload,    nullptr },
+        { CHAR_WIFI_SSIDS,             SVC_WIFI,     UUID_WIFI_SSIDS_CHAR,             RN,          0,                            nullptr,              nullptr },
+        { CHAR_WIFI_SCAN_CMD,          SVC_WIFI,     UUID_WIFI_SCAN_CMD_CHAR,          GATT_WRITE,  0,                            &initZeroText,        &onWriteWifiScanCmd },
+        { CHAR_WIFI_CONNECTED_SSID,    SVC_WIFI,     UUID_WIFI_CONNECTED_SSID_CHAR,    RN,          0,                            nullptr,              nullptr },
+        { CHAR_WIFI_CONNECTED_STATUS,  SVC_WIFI,     UUID_WIFI_CONNECTED_STATUS_CHAR,  RN,          0,                            &initZeroText,        nullptr },
+        { CHAR_WIFI_SCAN_RESULTS,      SVC_WIFI,     UUID_WIFI_SCAN_RESULTS_CHAR,      GATT_NOTIFY, MAX_SCAN_CHUNK,               nullptr,              nullptr },
+        { CHAR_SENSOR_NAME,            SVC_SETTINGS, UUID_SENSOR_NAME_CHAR,            RWN,         0,                            &initSensorName,      &onWriteSensorName },
+        { CHAR_SCAN_INTERVAL,          SVC_SETTINGS, UUID_SCAN_INTERVAL_CHAR,          RWN,         0,                            &initScanInterval,    &onWriteScanInterval },
+        { CHAR_WIFI_SSID_AND_PASSWORD, SVC_SETTINGS, UUID_WIFI_SSID_AND_PASSWORD_CHAR, RWN,         0,                            &initWifiCredentials, &onWriteWifiSSIDAndPassword },
+        { CHAR_WIFI_ENABLED,           SVC_SETTINGS, UUID_WIFI_ENABLED_CHAR,           RWN,         0,                            &initWifiEnabled,     &onWriteWifiEnabled },
+        { CHAR_HISTORY_CONTROL,        SVC_HISTORY,  UUID_HISTORY_CONTROL_CHAR,        GATT_WRITE,  0,                            nullptr,              &onWriteHistoryControl },
+        { CHAR_HISTORY_DATA,           SVC_HISTORY,  UUID_HISTORY_DATA_CHAR,           GATT_NOTIFY, HistoryTransfer::MAX_PACKET,  nullptr,              nullptr },
+        { CHAR_BOOT_TIMING,            SVC_DIAGNOSTICS, UUID_BOOT_TIMING_CHAR,         GATT_READ,   BootSequence::MAX_REPORT,     nullptr,              nullptr },
+        { CHAR_LATENCY_STATS,          SVC_DIAGNOSTICS, UUID_LATENCY_STATS_CHAR,       RW,          LatencyStats::SNAPSHOT_SIZE,  &initLatencyStats,    &onWriteLatencyStats },
+    };
 
-        // Note: add your characteristic callbacks to the writeCallbacks array in BleLightSensorService
-        // if you want to handle more writable characteristics.
-        
-        std::string toLower(const std::string& str) {
-            std::string result = str;
-            std::transform(result.begin(), result.end(), result.begin(), ::tolower);
-            return result;
+private:
+    // Builds NimBLE objects for GattBuilder and keeps them indexed by registry id.
+    struct NimBLEGattAdapter {
+        NimBLEServer* server = nullptr;
+        NimBLEService* services[SVC_COUNT] = {};
+        NimBLECharacteristic* characteristics[CHAR_COUNT] = {};
+
+        void createService(size_t index, const GattServiceDef& def) {
+            services[index] = server->createService(def.uuid);
+        }
+        void createCharacteristic(size_t index, const GattCharacteristicDef& def) {
+            NimBLEService* svc = services[def.service];
+            characteristics[index] = def.maxLength
+                ? svc->createCharacteristic(def.uuid, def.properties, def.maxLength)
+                : svc->createCharacteristic(def.uuid, def.properties);
+        }
+        void setValue(size_t index, const uint8_t* data, size_t len) {
+            characteristics[index]->setValue(data, len);
         }
-        
-        void onRead(NimBLECharacteristic* c, NimBLEConnInfo& connInfo) override {
-            Serial.println("GenericWriteCallback::onRead called");
+        uint16_t handleOf(size_t index) {
+            return characteristics[index]->getHandle();
+        }
+    };
+
+    NimBLEGattAdapter gatt;
+    GattDispatcher dispatcher{CHARACTERISTICS, CHAR_COUNT, this};
+
+    // One callbacks object for every characteristic: writes go through the registry dispatcher,
+    // subscriptions to the light characteristics feed the publish policies. All of them run on
+    // the NimBLE host task and are timed, so one that blocks it shows up in the diagnostics.
+    class GattCallbacks : public NimBLECharacteristicCallbacks {
+        void onRead(NimBLECharacteristic* c, NimBLEConnInfo&) override {
+            LatencyStats::Scope timed(latencyStats, LatencyStats::STAGE_BLE_CALLBACK);
+            if (!gBleInstance || c != gBleInstance->pLatencyStatsChar) return;
+            size_t len = latencyStats.encode(gBleInstance->latencyPayload, sizeof(gBleInstance->latencyPayload), millis());
+            c->setValue(gBleInstance->latencyPayload, len);
         }
-        
+
         void onWrite(NimBLECharacteristic* c, NimBLEConnInfo& connInfo) override {
-            Serial.println("===== GenericWriteCallback::onWrite called =====");
-            if(!gBleInstance) {
-                Serial.println("ERROR: onWrite called but gBleInstance is null!");
-                return;
-            }
-            std::string uuid = toLower(c->getUUID().toString());
-            Serial.print("UUID: "); 
-            Serial.println(uuid.c_str());
-            
-            size_t callbacksLen = sizeof(gBleInstance->writeCallbacks)/sizeof(CharactersticWriteCallback);
-            for (size_t i = 0; i< callbacksLen; i++){
-                std::string storedUuid = toLower(gBleInstance->writeCallbacks[i].uuid);
-                
-                if (uuid == storedUuid){
-                    Serial.print("Found matching callback at index "); Serial.println(i);
-                    gBleInstance->writeCallbacks[i].callback(gBleInstance, c);
-                    return;
-                }
+            LatencyStats::Scope timed(latencyStats, LatencyStats::STAGE_BLE_CALLBACK);
+            if (!gBleInstance) return;
+            NimBLEAttValue value = c->getValue();
+            if (!gBleInstance->dispatcher.dispatch(c->getHandle(), value.data(), value.size(), connInfo.getConnHandle())) {
+                TRACE_WARN("ble: no write handler for handle %u", c->getHandle());
             }
-            Serial.println("WARNING: No matching callback found for this UUID");
-        }
-        
-        void onStatus(NimBLECharacteristic* c, int code) override {
-            Serial.print("GenericWriteCallback::onStatus called, code: "); Serial.println(code);
         }
-        
+
         void onSubscribe(NimBLECharacteristic* c, NimBLEConnInfo& connInfo, uint16_t subValue) override {
-            Serial.print("GenericWriteCallback::onSubscribe called, subValue: "); Serial.println(subValue);
+            LatencyStats::Scope timed(latencyStats, LatencyStats::STAGE_BLE_CALLBACK);
+            if (!gBleInstance) return;
+            PublishPolicy* policy = gBleInstance->policyFor(c);
+            if (!policy) return;
+            std::lock_guard<std::mutex> lock(gBleInstance->publishMutex);
+            policy->subscribe(connInfo.getConnHandle(), subValue != 0, connIntervalUs(connInfo));
         }
     };
 
-    GenericWriteCallback genericCallback; // Single instance reused for all writable characteristics
+    GattCallbacks gattCallbacks;
+
+    // Subscriptions arrive on the NimBLE host task while publishing runs on loop(); the mutex
+    // keeps the two from interleaving on the policies.
+    PublishPolicy lightPolicy;
+    PublishPolicy lightTextPolicy;
+    std::mutex publishMutex;
+
+    PublishPolicy* policyFor(NimBLECharacteristic* c) {
+        if (c == pLightLevelChar) return &lightPolicy;
+        if (c == pLightTextChar) return &lightTextPolicy;
+        return nullptr;
+    }
+
+    // Connection interval is reported in units of 1.25 ms.
+    static uint32_t connIntervalUs(NimBLEConnInfo& connInfo) {
+        return (uint32_t)connInfo.getConnInterval() * 1250;
+    }
+
+    // Preallocated buffers for the notify path so publishing a sample never touches the heap.
+    uint8_t lightPayload[LightPayload::SIZE];
+    char    lightText[24];
+    uint8_t statsPayload[StreamingStats::SUMMARY_SIZE];
+    uint8_t latencyPayload[LatencyStats::SNAPSHOT_SIZE]; // host task only (onRead)
+
+    // Every notify on the publish path is timed; a false return (stack out of buffers, or the
+    // peer gone) counts as a failure.
+    static bool timedNotify(NimBLECharacteristic* c, const uint8_t* data, size_t len, uint16_t conn) {
+        bool sent;
+        {
+            LatencyStats::Scope timed(latencyStats, LatencyStats::STAGE_BLE_NOTIFY);
+            sent = c->notify(data, len, conn);
+        }
+        if (!sent) latencyStats.fail(LatencyStats::STAGE_BLE_NOTIFY);
+        return sent;
+    }
 
 public:
-    BleLightSensorService() : pWifiNetwork(nullptr) {}
+    BleLightSensorService()
+        : pWifiConnection(nullptr), pWifiScanner(nullptr), wifiLinkUp(false),
+          scanStreamActive(false), scanCursor(0), scanChunkIndex(0) {}
+
+    // Scan requests go to this scanner; its results are published on the SSID list (legacy
+    // text) and scan results (binary chunks) characteristics.
+    void SetWifiScanner(WifiScanner* scanner) {
+        pWifiScanner = scanner;
+        pWifiScanner->addListener(onScanResults, this);
+    }
+
+    // The connected SSID / status characteristics follow this connection's state changes.
+    void SetWifiConnection(WifiConnection* connection) {
+        pWifiConnection = connection;
+        pWifiConnection->addListener(onWifiStateChanged, this);
+    }
+
+    void SetHistoryTransfer(HistoryTransfer* history) {
+        pHistory = history;
+    }
 
-    void SetWifiNetwork(WifiNetwork* wifiNet) {
-        pWifiNetwork = wifiNet;
+    // Must be set before begin(); the settings characteristics read and write through it.
+    void SetSettings(SettingsManager* settings) {
+        pSettings = settings;
+        pSettings->addListener(onSettingsChanged, this);
     }
 
     // NimBLEServerCallbacks overrides
-    void onConnect(NimBLEServer* pServer) {
-        Serial.println("===================================");
-        Serial.println("Central CONNECTED!");
-        Serial.println("===================================");
-    }
-    void onDisconnect(NimBLEServer* pServer) {
-        Serial.println("===================================");
-        Serial.println("Central DISCONNECTED!");
-        Serial.println("===================================");
-        Serial.println("Restarting advertising...");
+    void onConnect(NimBLEServer*, NimBLEConnInfo& connInfo) override {
+        LatencyStats::Scope timed(latencyStats, LatencyStats::STAGE_BLE_CALLBACK);
+        TRACE_INFO("ble: central connected, conn %u", connInfo.getConnHandle());
+    }
+    void onDisconnect(NimBLEServer*, NimBLEConnInfo& connInfo, int reason) override {
+        LatencyStats::Scope timed(latencyStats, LatencyStats::STAGE_BLE_CALLBACK);
+        TRACE_INFO("ble: central disconnected, conn %u reason 0x%x", connInfo.getConnHandle(), reason);
+        {
+            std::lock_guard<std::mutex> lock(publishMutex);
+            lightPolicy.disconnect(connInfo.getConnHandle());
+            lightTextPolicy.disconnect(connInfo.getConnHandle());
+        }
         NimBLEDevice::getAdvertising()->start();
     }
+    void onConnParamsUpdate(NimBLEConnInfo& connInfo) override {
+        LatencyStats::Scope timed(latencyStats, LatencyStats::STAGE_BLE_CALLBACK);
+        std::lock_guard<std::mutex> lock(publishMutex);
+        lightPolicy.updateInterval(connInfo.getConnHandle(), connIntervalUs(connInfo));
+        lightTextPolicy.updateInterval(connInfo.getConnHandle(), connIntervalUs(connInfo));
+    }
 
     void scanForPeers(){
-        Serial.println("Scanning for connected peers...");
         std::vector<uint16_t> peerDevices = pServer->getPeerDevices();
-        Serial.print("Currently connected peers: "); Serial.println(peerDevices.size());
+        TRACE_DEBUG("ble: %u connected peers", peerDevices.size());
 
         if (peerDevices.size() > 0){
             for (uint16_t i = 0; i < peerDevices.size(); i++){
                 NimBLEConnInfo info = pServer->getPeerInfo(peerDevices[i]);
-                Serial.print("Peer ID: "); Serial.println(peerDevices[i]);
-                Serial.print(" Address: "); Serial.println(info.getAddress().toString().c_str());
-                Serial.print(" ID Address: "); Serial.println(info.getIdAddress().toString().c_str());
-                Serial.print(" Conn Handle: "); Serial.println(String(info.getConnHandle()).c_str());
-                String ssid = pWifiNetwork->getSSID();
-                if (ssid.length() > 0){
-                    Serial.print("Currently connected to SSID: "); Serial.println(ssid);
-                    pWifiConnectedSSIDChar->setValue(ssid.c_str());
-                    pWifiConnectedSSIDChar->notify();
-                    pWifiConnectedStatusChar->setValue("1");
-                    pWifiConnectedStatusChar->notify();
-                }
-                else
-                {
-                    Serial.println("Not connected to any Wi-Fi network.");
-                    pWifiConnectedSSIDChar->setValue("");
-                    pWifiConnectedSSIDChar->notify();
-                    pWifiConnectedStatusChar->setValue("0");
-                    pWifiConnectedStatusChar->notify();
-                }
+                TRACE_DEBUG("ble: peer conn %u address %012llx id %012llx", info.getConnHandle(),
+                            (uint64_t)info.getAddress(), (uint64_t)info.getIdAddress());
             }
         }
         else
         {
-            Serial.println("No connected peers found.");
             NimBLEAdvertising* pAdvertising = NimBLEDevice::getAdvertising();
             if (!pAdvertising->isAdvertising()) {
-                Serial.println("No connected peers; restarting advertising.");
+                TRACE_INFO("ble: no connected peers; restarting advertising");
                 // In void begin() I am setting pServer->advertiseOnDisconnect(true); so advertising should automatically
                 // restart on disconnect. Theoretically this is redundant. Maybe can remove it later because it may
                 // never get called.
                 pAdvertising->start();
-            } else {
-                Serial.println("No connected peers; already advertising.");
             }
         }
     }
@@ -276,93 +414,228 @@ public:
         pServer = NimBLEDevice::createServer();
         pServer->setCallbacks(this);
 
-        // Load settings for initial values
-        SettingsManager settingsManager; settingsManager.begin(); settingsManager.loadSettings();
-        SensorSettings currentSettings = settingsManager.getSettings(); settingsManager.end();
-
-        // --- Light Level Service ---
-        pLightService = pServer->createService(UUID_LIGHT_SERVICE);
-         pLightLevelChar = pLightService->createCharacteristic(UUID_LIGHT_CHARACTERISTIC, NIMBLE_PROPERTY::READ | NIMBLE_PROPERTY::NOTIFY);
-        pLightLevelChar->setValue("-1");
-
-        // --- WiFi Service ---
-        Serial.println("Creating WiFi Service...");
-        pWifiService = pServer->createService(UUID_WIFI_SERVICE);
-        pWifiSSIDsChar    = pWifiService->createCharacteristic(UUID_WIFI_SSIDS_CHAR,    NIMBLE_PROPERTY::READ | NIMBLE_PROPERTY::NOTIFY);
-        pWifiScanCmdChar  = pWifiService->createCharacteristic(UUID_WIFI_SCAN_CMD_CHAR, NIMBLE_PROPERTY::WRITE);
-        pWifiConnectedSSIDChar   = pWifiService->createCharacteristic(UUID_WIFI_CONNECTED_SSID_CHAR,   NIMBLE_PROPERTY::READ | NIMBLE_PROPERTY::NOTIFY);
-        pWifiConnectedStatusChar = pWifiService->createCharacteristic(UUID_WIFI_CONNECTED_STATUS_CHAR, NIMBLE_PROPERTY::READ | NIMBLE_PROPERTY::NOTIFY);
-
-        pWifiSSIDsChar->setValue("");
-        pWifiScanCmdChar->setValue("0");
-        pWifiConnectedSSIDChar->setValue("");
-        pWifiConnectedStatusChar->setValue("0");
-
-
-        // --- Settings Service ---
-        pSettingsService = pServer->createService(UUID_SETTINGS_SERVICE);
-        pSensorNameChar   = pSettingsService->createCharacteristic(UUID_SENSOR_NAME_CHAR,  NIMBLE_PROPERTY::READ | NIMBLE_PROPERTY::WRITE | NIMBLE_PROPERTY::NOTIFY);
-        pScanIntervalChar = pSettingsService->createCharacteristic(UUID_SCAN_INTERVAL_CHAR, NIMBLE_PROPERTY::READ | NIMBLE_PROPERTY::WRITE | NIMBLE_PROPERTY::NOTIFY);
-
-        pWifiSSIDCharAndPassword = pSettingsService->createCharacteristic(UUID_WIFI_SSID_AND_PASSWORD_CHAR,     NIMBLE_PROPERTY::READ | NIMBLE_PROPERTY::WRITE | NIMBLE_PROPERTY::NOTIFY);
-        pWifiEnabledChar  = pSettingsService->createCharacteristic(UUID_WIFI_ENABLED_CHAR,  NIMBLE_PROPERTY::READ | NIMBLE_PROPERTY::WRITE | NIMBLE_PROPERTY::NOTIFY);
-
-        // Initial values
-        pSensorNameChar->setValue(currentSettings.sensorName.c_str());
-        pScanIntervalChar->setValue(String(currentSettings.updateInterval).c_str());
-        pWifiSSIDCharAndPassword->setValue(currentSettings.pWifiSSIDCharAndPassword.c_str());
-        pWifiEnabledChar->setValue(currentSettings.wifiEnabled ? "1" : "0");
-
-        // Start services
-        pLightService->start();
-        pWifiService->start();
-        pSettingsService->start();
-
-        // Attach callbacks to writable characteristics (AFTER services are started)
-        Serial.println("Setting callbacks...");
-        Serial.print("genericCallback address: "); Serial.println((unsigned long)&genericCallback, HEX);
-        
-        Serial.println("Setting WiFi Scan CMD callback...");
-        pWifiScanCmdChar->setCallbacks(&genericCallback);
-        Serial.print("  Callback object address: "); Serial.println((unsigned long)pWifiScanCmdChar->getCallbacks(), HEX);
-        
-        pSensorNameChar->setCallbacks(&genericCallback);
-        pScanIntervalChar->setCallbacks(&genericCallback);
-        pWifiSSIDCharAndPassword->setCallbacks(&genericCallback);
-        pWifiEnabledChar->setCallbacks(&genericCallback);
-        Serial.println("All callbacks set.");
+        // Initial values come from the settings cache, no NVS access here
+        initialSettings = pSettings->getSettings();
+
+        // Services and characteristics come from the registry tables.
+        gatt.server = pServer;
+        GattBuilder::declare(gatt, SERVICES, CHARACTERISTICS, this);
+        pLightService    = gatt.services[SVC_LIGHT];
+        pWifiService     = gatt.services[SVC_WIFI];
+        pSettingsService = gatt.services[SVC_SETTINGS];
+        pHistoryService  = gatt.services[SVC_HISTORY];
+        pDiagnosticsService = gatt.services[SVC_DIAGNOSTICS];
+        pLightLevelChar          = gatt.characteristics[CHAR_LIGHT];
+        pLightTextChar           = gatt.characteristics[CHAR_LIGHT_TEXT];
+        pLightStatsChar          = gatt.characteristics[CHAR_LIGHT_STATS];
+        pWifiSSIDsChar           = gatt.characteristics[CHAR_WIFI_SSIDS];
+        pWifiScanCmdChar         = gatt.characteristics[CHAR_WIFI_SCAN_CMD];
+        pWifiConnectedSSIDChar   = gatt.characteristics[CHAR_WIFI_CONNECTED_SSID];
+        pWifiConnectedStatusChar = gatt.characteristics[CHAR_WIFI_CONNECTED_STATUS];
+        pWifiScanResultsChar     = gatt.characteristics[CHAR_WIFI_SCAN_RESULTS];
+        pSensorNameChar          = gatt.characteristics[CHAR_SENSOR_NAME];
+        pScanIntervalChar        = gatt.characteristics[CHAR_SCAN_INTERVAL];
+        pWifiSSIDCharAndPassword = gatt.characteristics[CHAR_WIFI_SSID_AND_PASSWORD];
+        pWifiEnabledChar         = gatt.characteristics[CHAR_WIFI_ENABLED];
+        pHistoryControlChar      = gatt.characteristics[CHAR_HISTORY_CONTROL];
+        pHistoryDataChar         = gatt.characteristics[CHAR_HISTORY_DATA];
+        pBootTimingChar          = gatt.characteristics[CHAR_BOOT_TIMING];
+        pLatencyStatsChar        = gatt.characteristics[CHAR_LATENCY_STATS];
+
+        // Format descriptor: { format version, payload length } so centrals can reject layouts they don't know.
+        NimBLEDescriptor* pLightFormatDesc = pLightLevelChar->createDescriptor(UUID_LIGHT_FORMAT_DESCRIPTOR, NIMBLE_PROPERTY::READ, 2);
+        const uint8_t lightFormat[2] = { LightPayload::FORMAT_VERSION, (uint8_t)LightPayload::SIZE };
+        pLightFormatDesc->setValue(lightFormat, sizeof(lightFormat));
+
+        for (size_t i = 0; i < CHAR_COUNT; i++) gatt.characteristics[i]->setCallbacks(&gattCallbacks);
+        for (size_t i = 0; i < SVC_COUNT; i++) gatt.services[i]->start();
+
+        // Handles are assigned when the server starts; bind them for write dispatch.
+        pServer->start();
+        size_t bound = GattBuilder::bind(gatt, CHARACTERISTICS, dispatcher);
+        TRACE_INFO("ble: GATT registry: %u of %u characteristics bound", bound, CHAR_COUNT);
 
         // Setup advertising
         NimBLEAdvertising* pAdvertising = NimBLEDevice::getAdvertising();
-        pAdvertising->addServiceUUID(UUID_LIGHT_SERVICE);
-        pAdvertising->addServiceUUID(UUID_WIFI_SERVICE);
-        pAdvertising->addServiceUUID(UUID_SETTINGS_SERVICE);
+        for (size_t i = 0; i < SVC_COUNT; i++) {
+            if (SERVICES[i].advertised) pAdvertising->addServiceUUID(SERVICES[i].uuid);
+        }
         //pAdvertising->setScanResponse(true);
         pAdvertising->start();
+        advertisingSinceUs = (uint64_t)esp_timer_get_time();
         pServer->advertiseOnDisconnect(true); // Takes care of dead connections such as when you stop the debugger on the IOS app in XCode :)
-        Serial.println("NimBLE Light Sensor Service started & advertising.");
+        TRACE_INFO("ble: service started, advertising");
     }
 
-    void updateLightValue(const String& value) {
+    // Updates the readable value and offers the sample to the publish policies; notifications
+    // only go out to subscribers, outside the deadband, and no faster than each connection's interval.
+    void updateLightValue(const LightSample& sample, uint64_t nowUs) {
         if(!pLightLevelChar) return;
-        pLightLevelChar->setValue(value.c_str());
-        // Notify only if there are subscribed clients
+        size_t len = LightPayload::encode(sample, lightPayload, sizeof(lightPayload));
+        pLightLevelChar->setValue(lightPayload, len);
+        len = LightPayload::formatText(sample, lightText, sizeof(lightText));
+        pLightTextChar->setValue((const uint8_t*)lightText, len);
 
-            // Serial.print("Notifying light value: "); Serial.println(value);
-            pLightLevelChar->notify();
-    
+        {
+            std::lock_guard<std::mutex> lock(publishMutex);
+            lightPolicy.offer(sample, nowUs);
+            lightTextPolicy.offer(sample, nowUs);
+        }
+        flushLightNotifications(nowUs);
     }
 
-    // Persistence helpers (wrap SettingsManager so callback class can reuse)
-    void saveSensorName(const String& name) {
-        SettingsManager settings; settings.begin(); settings.loadSettings(); settings.setSensorName(name); settings.end();
-        Serial.println("Sensor name saved to settings.");
+    // Sends values held back by the per-connection rate limit once their interval has elapsed.
+    void flushLightNotifications(uint64_t nowUs) {
+        if(!pLightLevelChar) return;
+        std::lock_guard<std::mutex> lock(publishMutex);
+        lightPolicy.flush(nowUs, [this](uint16_t conn, const LightSample& s) {
+            size_t len = LightPayload::encode(s, lightPayload, sizeof(lightPayload));
+            return timedNotify(pLightLevelChar, lightPayload, len, conn);
+        });
+        lightTextPolicy.flush(nowUs, [this](uint16_t conn, const LightSample& s) {
+            size_t len = LightPayload::formatText(s, lightText, sizeof(lightText));
+            return timedNotify(pLightTextChar, (const uint8_t*)lightText, len, conn);
+        });
     }
 
-    void saveScanInterval(int interval) {
-        SettingsManager settings; settings.begin(); settings.loadSettings(); settings.setScanInterval(interval); settings.end();
-        Serial.println("Scan interval saved to settings.");
+    // Publishes a closed statistics window. At one notification per window there is nothing for
+    // a publish policy to gate.
+    void updateLightStats(const StreamingStats::Summary& summary) {
+        if(!pLightStatsChar) return;
+        size_t len = StreamingStats::encode(summary, statsPayload, sizeof(statsPayload));
+        pLightStatsChar->setValue(statsPayload, len);
+        pLightStatsChar->notify();
+    }
+
+    // Streams the scan result chunks to every connected central, sized to the smallest MTU.
+    // Stops early when the stack runs out of buffers; the chunk is retried on the next call.
+    void pumpScanResults() {
+        if (!scanStreamActive || !pWifiScanner) return;
+        uint16_t mtu = 0;
+        for (uint16_t peer : pServer->getPeerDevices()) {
+            uint16_t m = pServer->getPeerMTU(peer);
+            if (mtu == 0 || m < mtu) mtu = m;
+        }
+        if (mtu == 0) {
+            scanStreamActive = false;
+            return;
+        }
+        size_t maxLen = (size_t)mtu - HistoryTransfer::ATT_HEADER;
+        if (maxLen > MAX_SCAN_CHUNK) maxLen = MAX_SCAN_CHUNK;
+
+        while (scanStreamActive) {
+            size_t next = scanCursor;
+            size_t len = pWifiScanner->encodeChunk(next, scanChunkIndex, scanChunk, maxLen);
+            if (len == 0) {
+                scanStreamActive = false; // MTU too small for a record
+                break;
+            }
+            if (!pWifiScanResultsChar->notify(scanChunk, len)) break;
+            scanCursor = next;
+            scanChunkIndex++;
+            if (scanChunk[2] & WifiScanner::CHUNK_LAST) scanStreamActive = false;
+        }
+    }
+
+    // Boot-timing report (BootSequence::encodeReport) for the diagnostics service; read-only.
+    void updateBootReport(const uint8_t* report, size_t len) {
+        if(!pBootTimingChar) return;
+        pBootTimingChar->setValue(report, len);
+    }
+
+    // When begin() started advertising (esp_timer microseconds), 0 before that.
+    uint64_t advertisingStartedUs() const { return advertisingSinceUs; }
+
+    const PublishPolicy::Stats& lightPublishStats() const { return lightPolicy.getStats(); }
+    const PublishPolicy::Stats& lightTextPublishStats() const { return lightTextPolicy.getStats(); }
+
+    // Streams pending history packets to the central that requested them, sized to its MTU.
+    // Stops early when the stack runs out of buffers; the packet is retried on the next call.
+    void pumpHistory() {
+        if (!pHistory || !pHistory->active()) return;
+
+        uint16_t conn = historyConnHandle;
+        bool connected = false;
+        for (uint16_t peer : pServer->getPeerDevices()) connected |= (peer == conn);
+        if (!connected) {
+            pHistory->cancel();
+            return;
+        }
+
+        uint16_t mtu = pServer->getPeerMTU(conn);
+        for (int i = 0; i < MAX_HISTORY_PACKETS_PER_PUMP; i++) {
+            const uint8_t* packet;
+            size_t len = pHistory->nextPacket(mtu, packet);
+            if (len == 0 || !pHistoryDataChar->notify(packet, len, conn)) break;
+            pHistory->packetSent();
+        }
+    }
+
+private:
+    bool wifiLinkUp; // last status pushed to the Wi-Fi characteristics
+
+    // Scan result stream state; loop() only.
+    bool scanStreamActive;
+    size_t scanCursor;
+    uint8_t scanChunkIndex;
+    uint8_t scanChunk[MAX_SCAN_CHUNK];
+    char ssidListText[MAX_SCAN_CHUNK];
+
+    static void onScanResults(void* context, bool) {
+        BleLightSensorService* self = static_cast<BleLightSensorService*>(context);
+        if (!self->pWifiSSIDsChar) return;
+        size_t len = self->pWifiScanner->formatSsidList(self->ssidListText, sizeof(self->ssidListText));
+        self->pWifiSSIDsChar->setValue((const uint8_t*)self->ssidListText, len);
+        self->pWifiSSIDsChar->notify();
+        self->scanCursor = 0;
+        self->scanChunkIndex = 0;
+        self->scanStreamActive = true;
+        self->pumpScanResults();
+    }
+
+    // Connecting, backing off and idle all read as "not connected"; only a change between
+    // connected and not connected (or to another network) is notified.
+    static void onWifiStateChanged(void* context, WifiConnection::State state, const char* ssid) {
+        BleLightSensorService* self = static_cast<BleLightSensorService*>(context);
+        if (!self->pWifiConnectedSSIDChar) return;
+        bool up = state == WifiConnection::STATE_CONNECTED;
+        if (up == self->wifiLinkUp && !up) return;
+        self->wifiLinkUp = up;
+        self->pWifiConnectedSSIDChar->setValue(up ? ssid : "");
+        self->pWifiConnectedSSIDChar->notify();
+        self->pWifiConnectedStatusChar->setValue(up ? "1" : "0");
+        self->pWifiConnectedStatusChar->notify();
+    }
+
+    // Keeps the settings characteristics in step with the cache, whoever changed it.
+    static void onSettingsChanged(void* context, uint32_t changed, const SensorSettings& s) {
+        BleLightSensorService* self = static_cast<BleLightSensorService*>(context);
+        if (!self->pSensorNameChar) return;
+        if (changed & SettingsManager::FIELD_SENSOR_NAME) {
+            self->pSensorNameChar->setValue(s.sensorName);
+            self->pSensorNameChar->notify();
+        }
+        if (changed & SettingsManager::FIELD_UPDATE_INTERVAL) {
+            char text[12];
+            snprintf(text, sizeof(text), "%d", s.updateInterval);
+            self->pScanIntervalChar->setValue(text);
+            self->pScanIntervalChar->notify();
+        }
+        if (changed & SettingsManager::FIELD_WIFI_CREDENTIALS) {
+            self->pWifiSSIDCharAndPassword->setValue(s.pWifiSSIDCharAndPassword);
+            self->pWifiSSIDCharAndPassword->notify();
+        }
+        if (changed & SettingsManager::FIELD_WIFI_ENABLED) {
+            self->pWifiEnabledChar->setValue(s.wifiEnabled ? "1" : "0");
+            self->pWifiEnabledChar->notify();
+        }
     }
 };
 
+static_assert(GATT_READ == NIMBLE_PROPERTY::READ && GATT_WRITE == NIMBLE_PROPERTY::WRITE &&
+              GATT_WRITE_NR == NIMBLE_PROPERTY::WRITE_NR && GATT_NOTIFY == NIMBLE_PROPERTY::NOTIFY &&
+              GATT_INDICATE == NIMBLE_PROPERTY::INDICATE, "GattProperty must match NIMBLE_PROPERTY");
+static_assert(gattTableValid(BleLightSensorService::SERVICES, BleLightSensorService::CHARACTERISTICS),
+              "GATT registry: ids out of order, bad or duplicate UUID, or write property without handler");
+
 #endif // BLE_LIGHT_SENSOR_SERVICE_H
\ No newline at end of file
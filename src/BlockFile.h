@@ -0,0 +1,33 @@
+#ifndef __BLOCK_FILE_H__
+#define __BLOCK_FILE_H__
+
+#include <stddef.h>
+#include <stdint.h>
+
+// A file addressed in whole 512-byte blocks. The sample log only ever reads and writes
+// complete, sector-aligned blocks through this interface, so it runs unchanged against the
+// SD card (SdBlockFile) or a plain file on a host.
+class BlockFile {
+public:
+    static constexpr size_t BLOCK_SIZE = 512;
+
+    virtual ~BlockFile() {}
+
+    // Opens name (relative to the implementation's root directory). With create set, a missing
+    // file is created and grown to preallocBlocks up front so cluster allocation does not happen
+    // on the write path. Content of preallocated blocks is unspecified.
+    virtual bool open(const char* name, bool create, uint32_t preallocBlocks = 0) = 0;
+    virtual bool isOpen() const = 0;
+    virtual void close() = 0;
+
+    // Allocated size of the open file in blocks (including preallocated, unwritten ones).
+    virtual uint32_t blockCount() = 0;
+
+    virtual bool readBlock(uint32_t index, uint8_t* out) = 0;
+    virtual bool writeBlock(uint32_t index, const uint8_t* data) = 0;
+
+    // Pushes buffered writes down to the medium.
+    virtual bool sync() = 0;
+};
+
+#endif // __BLOCK_FILE_H__
@@ -0,0 +1,285 @@
+#ifndef __BOOT_SEQUENCE_H__
+#define __BOOT_SEQUENCE_H__
+
+#include <atomic>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include "ByteCodec.h"
+
+// Start-up as a set of stages with dependencies instead of one long setup(). run() starts every
+// stage as soon as the stages it depends on have finished: foreground stages run inline on the
+// caller's task, background stages on a task of their own (through the injected spawn function),
+// so independent work (NimBLE bring-up, SD mount, the sensor) overlaps. A stage whose dependency
+// failed is skipped, unless the failed stage is optional (hardware the device can run without,
+// like the SD card): its failure is reported but its dependents still run. Detached stages (e.g. waiting for a USB serial host) run in the background
+// and run() does not wait for them; nothing may depend on one.
+//
+// Each stage's start and duration are recorded against the injected clock (microseconds since
+// reset on the device), along with named milestones such as the first sample, and can be
+// encoded as a report (little-endian):
+//   u8 format version, u8 stage count, u8 milestone count
+//   per stage:     u8 status, u32 start us, u32 duration us, u8 name length, name
+//   per milestone: u32 time us (0 = not reached), u8 name length, name
+class BootSequence {
+public:
+    static constexpr size_t  MAX_STAGES     = 16;
+    static constexpr size_t  MAX_MILESTONES = 4;
+    static constexpr size_t  MAX_NAME       = 15;
+    static constexpr uint8_t FORMAT_VERSION = 1;
+    static constexpr int     INVALID_STAGE  = -1;
+    static constexpr size_t  MAX_REPORT     = 3 + MAX_STAGES * (10 + MAX_NAME) + MAX_MILESTONES * (5 + MAX_NAME);
+
+    using StageFn = bool (*)(void* context);   // false marks the stage failed
+    using ClockFn = uint64_t (*)();            // monotonic microseconds
+    using EntryFn = void (*)(void* arg);
+    using SpawnFn = bool (*)(EntryFn entry, void* arg, const char* name); // run entry(arg) on another task
+    using WaitFn  = void (*)();                // yield while background stages run
+
+    enum Flags : uint8_t {
+        STAGE_BACKGROUND = 0x01,
+        STAGE_DETACHED   = 0x02 | STAGE_BACKGROUND,
+        STAGE_OPTIONAL   = 0x04,
+    };
+
+    enum Status : uint8_t {
+        STATUS_PENDING,
+        STATUS_RUNNING,
+        STATUS_DONE,
+        STATUS_FAILED,
+        STATUS_SKIPPED,   // a dependency failed
+    };
+
+    explicit BootSequence(ClockFn clock_) : clock(clock_), stageCount(0), milestonesUsed(0), beganUs(0), finishedUs(0) {}
+
+    static constexpr uint32_t after(int id) { return id >= 0 ? 1u << id : 0; }
+
+    // Declares a stage that runs once every stage in dependsOn (a mask built with after()) is done.
+    int add(const char* name, StageFn fn, void* context = nullptr, uint32_t dependsOn = 0, uint8_t flags = 0) {
+        if (stageCount >= MAX_STAGES || !fn) return INVALID_STAGE;
+        Stage& s = stages[stageCount];
+        s.name = name;
+        s.fn = fn;
+        s.context = context;
+        s.dependsOn = dependsOn;
+        s.flags = flags;
+        s.status.store(STATUS_PENDING, std::memory_order_relaxed);
+        s.startUs = 0;
+        s.durationUs = 0;
+        s.owner = this;
+        return (int)stageCount++;
+    }
+
+    // Checks that every dependency names a declared, non-detached stage and that there is no
+    // cycle. run() refuses to start otherwise.
+    bool valid() const {
+        uint32_t declared = stageCount >= 32 ? UINT32_MAX : (1u << stageCount) - 1;
+        uint32_t detached = 0;
+        for (size_t i = 0; i < stageCount; i++) {
+            if ((stages[i].flags & STAGE_DETACHED) == STAGE_DETACHED) detached |= 1u << i;
+        }
+        for (size_t i = 0; i < stageCount; i++) {
+            if (stages[i].dependsOn & ~declared) return false;
+            if (stages[i].dependsOn & detached) return false;
+        }
+        // Kahn's algorithm: repeatedly retire stages whose dependencies are all retired.
+        uint32_t retired = 0;
+        for (size_t pass = 0; pass < stageCount; pass++) {
+            bool progress = false;
+            for (size_t i = 0; i < stageCount; i++) {
+                if (retired & (1u << i)) continue;
+                if ((stages[i].dependsOn & ~retired) == 0) {
+                    retired |= 1u << i;
+                    progress = true;
+                }
+            }
+            if (!progress) break;
+        }
+        return retired == declared;
+    }
+
+    // Runs the stages. spawn may be null (everything inline, in dependency order). Returns true
+    // if every waited-for stage succeeded.
+    bool run(SpawnFn spawn, WaitFn wait) {
+        if (!valid()) return false;
+        beganUs = clock();
+        for (;;) {
+            bool ranInline = false;
+            for (size_t i = 0; i < stageCount; i++) {
+                Stage& s = stages[i];
+                if (s.status.load(std::memory_order_acquire) != STATUS_PENDING) continue;
+                uint32_t optional = flagged(STAGE_OPTIONAL);
+                uint32_t failed = maskOf(STATUS_FAILED);
+                if (s.dependsOn & ((failed & ~optional) | maskOf(STATUS_SKIPPED))) {
+                    s.status.store(STATUS_SKIPPED, std::memory_order_release);
+                    continue;
+                }
+                if ((s.dependsOn & ~(maskOf(STATUS_DONE) | (failed & optional))) != 0) continue;
+
+                s.status.store(STATUS_RUNNING, std::memory_order_release);
+                s.startUs = clock();
+                if ((s.flags & STAGE_BACKGROUND) && spawn && spawn(stageEntry, &s, s.name)) continue;
+                // Inline: afterwards rescan from the top so newly ready stages go in declaration order.
+                execute(s);
+                ranInline = true;
+                break;
+            }
+            if (ranInline) continue;
+            if (waitingOn() == 0) break;
+            if (wait) wait();
+        }
+        finishedUs = clock();
+        for (size_t i = 0; i < stageCount; i++) {
+            if ((stages[i].flags & STAGE_DETACHED) == STAGE_DETACHED) continue;
+            if (stages[i].status.load(std::memory_order_acquire) != STATUS_DONE) return false;
+        }
+        return true;
+    }
+
+    // Records (or updates) a milestone, in microseconds on the same clock as the stages.
+    void setMilestone(const char* name, uint64_t us) {
+        for (size_t i = 0; i < milestonesUsed; i++) {
+            if (strcmp(milestones[i].name, name) == 0) {
+                milestones[i].us = us;
+                return;
+            }
+        }
+        if (milestonesUsed >= MAX_MILESTONES) return;
+        milestones[milestonesUsed].name = name;
+        milestones[milestonesUsed].us = us;
+        milestonesUsed++;
+    }
+
+    size_t count() const { return stageCount; }
+    const char* name(int id) const { return stages[id].name; }
+    Status status(int id) const { return (Status)stages[id].status.load(std::memory_order_acquire); }
+    uint64_t startUs(int id) const { return stages[id].startUs; }
+    uint64_t durationUs(int id) const { return finished(stages[id]) ? stages[id].durationUs : 0; }
+    uint64_t beganAtUs() const { return beganUs; }
+    uint64_t finishedAtUs() const { return finishedUs; }
+    size_t milestoneCount() const { return milestonesUsed; }
+    const char* milestoneName(size_t i) const { return milestones[i].name; }
+    uint64_t milestoneUs(size_t i) const { return milestones[i].us; }
+
+    static const char* statusName(Status s) {
+        switch (s) {
+            case STATUS_PENDING: return "pending";
+            case STATUS_RUNNING: return "running";
+            case STATUS_DONE:    return "done";
+            case STATUS_FAILED:  return "failed";
+            case STATUS_SKIPPED: return "skipped";
+        }
+        return "?";
+    }
+
+    size_t reportSize() const {
+        size_t n = 3;
+        for (size_t i = 0; i < stageCount; i++) n += 10 + nameLength(stages[i].name);
+        for (size_t i = 0; i < milestonesUsed; i++) n += 5 + nameLength(milestones[i].name);
+        return n;
+    }
+
+    size_t encodeReport(uint8_t* out, size_t outLen) const {
+        if (outLen < reportSize()) return 0;
+        size_t n = 0;
+        out[n++] = FORMAT_VERSION;
+        out[n++] = (uint8_t)stageCount;
+        out[n++] = (uint8_t)milestonesUsed;
+        for (size_t i = 0; i < stageCount; i++) {
+            const Stage& s = stages[i];
+            out[n++] = s.status.load(std::memory_order_acquire);
+            putLe32(out + n, clamp32(s.startUs)); n += 4;
+            putLe32(out + n, clamp32(finished(s) ? s.durationUs : 0)); n += 4;
+            n += putName(out + n, s.name);
+        }
+        for (size_t i = 0; i < milestonesUsed; i++) {
+            putLe32(out + n, clamp32(milestones[i].us)); n += 4;
+            n += putName(out + n, milestones[i].name);
+        }
+        return n;
+    }
+
+private:
+    struct Stage {
+        const char* name;
+        StageFn fn;
+        void* context;
+        uint32_t dependsOn;
+        uint8_t flags;
+        std::atomic<uint8_t> status;
+        uint64_t startUs;
+        uint64_t durationUs;
+        BootSequence* owner;
+    };
+
+    struct Milestone {
+        const char* name;
+        uint64_t us;
+    };
+
+    static void stageEntry(void* arg) {
+        Stage* s = static_cast<Stage*>(arg);
+        s->owner->execute(*s);
+    }
+
+    // startUs is set by run() before the stage is handed over; durationUs is published by the
+    // final status store and only read after observing it.
+    void execute(Stage& s) {
+        bool ok = s.fn(s.context);
+        s.durationUs = clock() - s.startUs;
+        s.status.store(ok ? STATUS_DONE : STATUS_FAILED, std::memory_order_release);
+    }
+
+    static bool finished(const Stage& s) {
+        uint8_t st = s.status.load(std::memory_order_acquire);
+        return st == STATUS_DONE || st == STATUS_FAILED;
+    }
+
+    uint32_t maskOf(Status st) const {
+        uint32_t mask = 0;
+        for (size_t i = 0; i < stageCount; i++) {
+            if (stages[i].status.load(std::memory_order_acquire) == st) mask |= 1u << i;
+        }
+        return mask;
+    }
+
+    uint32_t flagged(uint8_t flag) const {
+        uint32_t mask = 0;
+        for (size_t i = 0; i < stageCount; i++) {
+            if (stages[i].flags & flag) mask |= 1u << i;
+        }
+        return mask;
+    }
+
+    // Stages run() still has to wait for: not finished and not detached.
+    uint32_t waitingOn() const {
+        uint32_t mask = 0;
+        for (size_t i = 0; i < stageCount; i++) {
+            if ((stages[i].flags & STAGE_DETACHED) == STAGE_DETACHED) continue;
+            uint8_t st = stages[i].status.load(std::memory_order_acquire);
+            if (st == STATUS_PENDING || st == STATUS_RUNNING) mask |= 1u << i;
+        }
+        return mask;
+    }
+
+    static uint32_t clamp32(uint64_t v) { return v > UINT32_MAX ? UINT32_MAX : (uint32_t)v; }
+
+    static size_t nameLength(const char* s) { return strnlen(s, MAX_NAME); }
+
+    static size_t putName(uint8_t* out, const char* s) {
+        size_t len = nameLength(s);
+        out[0] = (uint8_t)len;
+        memcpy(out + 1, s, len);
+        return len + 1;
+    }
+
+    ClockFn clock;
+    Stage stages[MAX_STAGES];
+    size_t stageCount;
+    Milestone milestones[MAX_MILESTONES];
+    size_t milestonesUsed;
+    uint64_t beganUs;
+    uint64_t finishedUs;
+};
+
+#endif // __BOOT_SEQUENCE_H__
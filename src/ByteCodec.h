@@ -0,0 +1,59 @@
+#ifndef __BYTE_CODEC_H__
+#define __BYTE_CODEC_H__
+
+#include <stdint.h>
+
+// Little-endian field helpers for the packed binary formats (BLE payloads, log records).
+// Explicit byte access keeps the wire layout independent of struct padding and host endianness.
+// Network protocols that are big-endian (NTP) use the Be variants.
+
+static inline void putLe16(uint8_t* p, uint16_t v) {
+    p[0] = (uint8_t)v;
+    p[1] = (uint8_t)(v >> 8);
+}
+
+static inline void putLe32(uint8_t* p, uint32_t v) {
+    p[0] = (uint8_t)v;
+    p[1] = (uint8_t)(v >> 8);
+    p[2] = (uint8_t)(v >> 16);
+    p[3] = (uint8_t)(v >> 24);
+}
+
+static inline void putLe48(uint8_t* p, uint64_t v) {
+    putLe32(p, (uint32_t)v);
+    putLe16(p + 4, (uint16_t)(v >> 32));
+}
+
+static inline void putLe64(uint8_t* p, uint64_t v) {
+    putLe32(p, (uint32_t)v);
+    putLe32(p + 4, (uint32_t)(v >> 32));
+}
+
+static inline uint16_t getLe16(const uint8_t* p) {
+    return (uint16_t)(p[0] | (p[1] << 8));
+}
+
+static inline uint32_t getLe32(const uint8_t* p) {
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static inline uint64_t getLe48(const uint8_t* p) {
+    return (uint64_t)getLe32(p) | ((uint64_t)getLe16(p + 4) << 32);
+}
+
+static inline uint64_t getLe64(const uint8_t* p) {
+    return (uint64_t)getLe32(p) | ((uint64_t)getLe32(p + 4) << 32);
+}
+
+static inline void putBe32(uint8_t* p, uint32_t v) {
+    p[0] = (uint8_t)(v >> 24);
+    p[1] = (uint8_t)(v >> 16);
+    p[2] = (uint8_t)(v >> 8);
+    p[3] = (uint8_t)v;
+}
+
+static inline uint32_t getBe32(const uint8_t* p) {
+    return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | (uint32_t)p[3];
+}
+
+#endif // __BYTE_CODEC_H__
@@ -0,0 +1,37 @@
+#ifndef __CRC32_H__
+#define __CRC32_H__
+
+#include <stddef.h>
+#include <stdint.h>
+
+// CRC-32 (IEEE 802.3, reflected polynomial 0xEDB88320), table built at compile time.
+// Written to C++11 constexpr rules (single-return functions), so it builds under any -std.
+struct Crc32 {
+    static uint32_t compute(const uint8_t* data, size_t len, uint32_t crc = 0) {
+        crc = ~crc;
+        for (size_t i = 0; i < len; i++) crc = table().v[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+        return ~crc;
+    }
+
+private:
+    struct Table { uint32_t v[256]; };
+
+    // The table entry for byte value c: eight shift-and-xor rounds.
+    static constexpr uint32_t entry(uint32_t c, int rounds = 8) {
+        return rounds == 0 ? c : entry((c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1, rounds - 1);
+    }
+
+    template <uint32_t... I> struct Indices {};
+    template <uint32_t N, uint32_t... I> struct MakeIndices : MakeIndices<N - 1, N - 1, I...> {};
+    template <uint32_t... I> struct MakeIndices<0, I...> { typedef Indices<I...> type; };
+
+    template <uint32_t... I>
+    static constexpr Table build(Indices<I...>) { return Table{{entry(I)...}}; }
+
+    static const Table& table() {
+        static constexpr Table t = build(MakeIndices<256>::type());
+        return t;
+    }
+};
+
+#endif // __CRC32_H__
@@ -0,0 +1,19 @@
+#ifndef __CYCLE_COUNTER_H__
+#define __CYCLE_COUNTER_H__
+
+#include <Arduino.h>
+
+// CPU cycle counter for timing short code paths: CCOUNT on the ESP32, the host's TSC in native
+// builds. Reading it costs a handful of cycles and never blocks, so it can be used from ISRs and
+// the BLE host task. The count is 32 bits: differences are exact for spans under 2^32 cycles
+// (17.9 s at 240 MHz), longer ones wrap.
+class CycleCounter {
+public:
+    static uint32_t now() { return ESP.getCycleCount(); }
+    static uint32_t since(uint32_t start) { return now() - start; }
+
+    static uint32_t hz() { return ESP.getCpuFreqMHz() * 1000000UL; }
+    static double toNs(double cycles) { return cycles * 1e9 / hz(); }
+};
+
+#endif // __CYCLE_COUNTER_H__
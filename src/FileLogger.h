@@ -1,27 +1,73 @@
 #ifndef _FILE_LOGGER_H_
 #define _FILE_LOGGER_H_
 #include <SD.h>
+#include "SampleLog.h"
+#include "SdBlockFile.h"
 
 class FileLogger
 {
     
 private:
     uint8_t csPin; // Chip Select pin for the SD card
+    bool ready;
+    SdBlockFile logFile;
+    SdBlockFile indexFile;
+    SampleLog sampleLog;
 
 public:
-    FileLogger(uint8_t csPin) {
-        this->csPin = csPin;
+    static constexpr const char* LOG_DIR = "/log";
+
+    FileLogger(uint8_t csPin)
+        : csPin(csPin), ready(false), logFile(LOG_DIR), indexFile(LOG_DIR),
+          sampleLog(logFile, indexFile, SampleLog::blocksPerDay(1000, SampleLog::ENCODING_DELTA)) {
+        sampleLog.setEncoding(SampleLog::ENCODING_DELTA);
     }
 
-    void begin()
+    // sampleIntervalMs sizes the preallocation of each day file and paces partial-block commits.
+    void begin(uint32_t sampleIntervalMs = 1000)
     {
+        setSampleInterval(sampleIntervalMs);
         if (!SD.begin(csPin)) // Assuming CS pin is 4
         {
             Serial.println("SD card initialization failed!");
             return;
         }
+        ready = true;
         Serial.println("SD card initialized successfully.");
     }
+
+    bool isReady() const { return ready; }
+
+    // Call from the logging task when the sample interval changes.
+    void setSampleInterval(uint32_t sampleIntervalMs)
+    {
+        sampleLog.setPreallocBlocks(SampleLog::blocksPerDay(sampleIntervalMs, SampleLog::ENCODING_DELTA));
+        sampleLog.setCommitInterval(SampleLog::commitIntervalFor(sampleIntervalMs));
+    }
+
+    // Stages a sample in the block buffer; nothing touches the card until service().
+    bool log(const LightSample& sample)
+    {
+        if (!ready) return false;
+        return sampleLog.append(sample);
+    }
+
+    // Writes sealed blocks and periodically commits the partially filled one.
+    void service(uint64_t nowMs)
+    {
+        if (ready) sampleLog.service(nowMs);
+    }
+
+    void flush()
+    {
+        if (ready) sampleLog.flush();
+    }
+
+    const SampleLog::Stats& stats() const { return sampleLog.getStats(); }
+
+    // Range queries go through a SampleLogReader with its own pair of files, e.g.
+    //   SdBlockFile data(FileLogger::LOG_DIR), index(FileLogger::LOG_DIR);
+    //   SampleLogReader reader(data, index);
 };
 
-#endif // _FILE_LOGGER_H_
\ No newline at end of file
+#endif // _FILE_LOGGER_H_
@@ -0,0 +1,206 @@
+#ifndef __GATT_REGISTRY_H__
+#define __GATT_REGISTRY_H__
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Declarative GATT table and write dispatch, independent of the BLE stack.
+// Services and characteristics are declared once in constexpr arrays; a stack adapter builds
+// the server from them and binds each characteristic's attribute handle, after which a write is
+// routed with one array lookup by handle. Nothing is parsed, compared as a string or allocated
+// on the write path. Tables are checked at compile time (see gattTableValid).
+
+// Characteristic properties. Values match the NimBLE / BLE_GATT_CHR_F_* flags.
+enum GattProperty : uint16_t {
+    GATT_READ     = 0x0002,
+    GATT_WRITE_NR = 0x0004,
+    GATT_WRITE    = 0x0008,
+    GATT_NOTIFY   = 0x0010,
+    GATT_INDICATE = 0x0020,
+};
+
+// ATT's limit on an attribute value; also the largest initial value GattBuilder can set.
+static constexpr uint16_t GATT_MAX_VALUE = 512;
+
+// A 128-bit UUID in over-the-air (little-endian) byte order, parsed from the usual
+// "xxxxxxxx-xxxx-xxxx-xxxx-xxxxxxxxxxxx" text form at compile time.
+struct GattUuid {
+    uint8_t bytes[16];
+
+    constexpr bool operator==(const GattUuid& o) const {
+        for (size_t i = 0; i < 16; i++) if (bytes[i] != o.bytes[i]) return false;
+        return true;
+    }
+    constexpr bool operator!=(const GattUuid& o) const { return !(*this == o); }
+
+    static constexpr int hexValue(char c) {
+        return c >= '0' && c <= '9' ? c - '0'
+             : c >= 'a' && c <= 'f' ? c - 'a' + 10
+             : c >= 'A' && c <= 'F' ? c - 'A' + 10
+             : -1;
+    }
+
+    static constexpr bool valid(const char* s) {
+        size_t digits = 0, i = 0;
+        for (; s[i] != '\0'; i++) {
+            bool dash = i == 8 || i == 13 || i == 18 || i == 23;
+            if (dash ? s[i] != '-' : hexValue(s[i]) < 0) return false;
+            if (!dash) digits++;
+        }
+        return i == 36 && digits == 32;
+    }
+
+    static constexpr GattUuid parse(const char* s) {
+        GattUuid u = {};
+        if (!valid(s)) return u;
+        size_t out = 15;
+        bool high = true;
+        for (size_t i = 0; s[i] != '\0'; i++) {
+            if (s[i] == '-') continue;
+            uint8_t nibble = (uint8_t)hexValue(s[i]);
+            if (high) u.bytes[out] = (uint8_t)(nibble << 4);
+            else u.bytes[out--] |= nibble;
+            high = !high;
+        }
+        return u;
+    }
+};
+
+// Writes the initial value of a characteristic into out; returns its length.
+using GattInitFn  = size_t (*)(void* owner, uint8_t* out, size_t capacity);
+using GattWriteFn = void (*)(void* owner, const uint8_t* data, size_t len, uint16_t connHandle);
+
+struct GattServiceDef {
+    const char* uuid;
+    bool advertised;
+};
+
+struct GattCharacteristicDef {
+    uint8_t id;           // must equal the entry's position in the table
+    uint8_t service;      // index into the service table
+    const char* uuid;
+    uint16_t properties;  // GattProperty bits
+    uint16_t maxLength;   // 0 = stack default, at most GATT_MAX_VALUE
+    GattInitFn initial;   // nullptr = empty
+    GattWriteFn onWrite;  // nullptr = not writable through the registry
+};
+
+// Compile-time table check: ids in order, service indices in range, every UUID well formed
+// and unique, lengths within ATT's limit, and writable characteristics (and only those) have a
+// handler.
+template <size_t S, size_t C>
+constexpr bool gattTableValid(const GattServiceDef (&services)[S], const GattCharacteristicDef (&chars)[C]) {
+    for (size_t i = 0; i < S; i++) {
+        if (!GattUuid::valid(services[i].uuid)) return false;
+        for (size_t j = 0; j < i; j++) if (GattUuid::parse(services[i].uuid) == GattUuid::parse(services[j].uuid)) return false;
+    }
+    for (size_t i = 0; i < C; i++) {
+        const GattCharacteristicDef& c = chars[i];
+        if (c.id != i || c.service >= S || !GattUuid::valid(c.uuid) || c.maxLength > GATT_MAX_VALUE) return false;
+        bool writable = (c.properties & (GATT_WRITE | GATT_WRITE_NR)) != 0;
+        if (writable != (c.onWrite != nullptr)) return false;
+        for (size_t j = 0; j < i; j++) if (GattUuid::parse(c.uuid) == GattUuid::parse(chars[j].uuid)) return false;
+    }
+    return true;
+}
+
+// Routes writes to the handler of the characteristic that owns an attribute handle.
+// bind() is called once per characteristic after the stack has assigned handles.
+class GattDispatcher {
+public:
+    static constexpr size_t  MAX_HANDLES = 256; // ATT handles on this device stay well below
+    static constexpr uint8_t UNBOUND     = 0xFF;
+
+    GattDispatcher(const GattCharacteristicDef* chars_, size_t count_, void* owner_)
+        : chars(chars_), count(count_), owner(owner_), misses(0) {
+        clear();
+    }
+
+    void clear() {
+        for (size_t i = 0; i < MAX_HANDLES; i++) byHandle[i] = UNBOUND;
+        for (size_t i = 0; i < MAX_CHARACTERISTICS; i++) uuids[i] = GattUuid();
+    }
+
+    bool bind(uint16_t handle, uint8_t index) {
+        if (handle >= MAX_HANDLES || index >= count || index >= MAX_CHARACTERISTICS) return false;
+        byHandle[handle] = index;
+        uuids[index] = GattUuid::parse(chars[index].uuid);
+        return true;
+    }
+
+    // Index of the characteristic bound to handle, or -1.
+    int indexOf(uint16_t handle) const {
+        if (handle >= MAX_HANDLES || byHandle[handle] == UNBOUND) return -1;
+        return byHandle[handle];
+    }
+
+    // Fallback for stacks that report the UUID rather than the handle; compares the parsed
+    // 16 bytes, never strings.
+    int indexOf(const GattUuid& uuid) const {
+        for (size_t i = 0; i < count && i < MAX_CHARACTERISTICS; i++) if (uuids[i] == uuid) return (int)i;
+        return -1;
+    }
+
+    // Calls the write handler for handle. False (and counted) if nothing is bound there.
+    bool dispatch(uint16_t handle, const uint8_t* data, size_t len, uint16_t connHandle) {
+        return dispatchIndex(indexOf(handle), data, len, connHandle);
+    }
+
+    bool dispatch(const GattUuid& uuid, const uint8_t* data, size_t len, uint16_t connHandle) {
+        return dispatchIndex(indexOf(uuid), data, len, connHandle);
+    }
+
+    uint32_t missCount() const { return misses; }
+
+private:
+    static constexpr size_t MAX_CHARACTERISTICS = 32;
+
+    bool dispatchIndex(int index, const uint8_t* data, size_t len, uint16_t connHandle) {
+        if (index < 0 || !chars[index].onWrite) {
+            misses++;
+            return false;
+        }
+        chars[index].onWrite(owner, data, len, connHandle);
+        return true;
+    }
+
+    const GattCharacteristicDef* chars;
+    size_t count;
+    void* owner;
+    uint8_t byHandle[MAX_HANDLES];
+    GattUuid uuids[MAX_CHARACTERISTICS];
+    uint32_t misses;
+};
+
+// Builds a server from the tables through a stack adapter. The adapter provides:
+//   void createService(size_t index, const GattServiceDef&)
+//   void createCharacteristic(size_t index, const GattCharacteristicDef&)
+//   void setValue(size_t index, const uint8_t* data, size_t len)
+//   uint16_t handleOf(size_t index)          (valid once the stack has started)
+// declare() creates everything and sets initial values; the caller may add extras (descriptors,
+// callbacks) and start the stack, then bind() records the handles in the dispatcher.
+class GattBuilder {
+public:
+    static constexpr size_t INIT_BUFFER = GATT_MAX_VALUE;
+
+    template <typename Adapter, size_t S, size_t C>
+    static void declare(Adapter& adapter, const GattServiceDef (&services)[S], const GattCharacteristicDef (&chars)[C], void* owner) {
+        for (size_t i = 0; i < S; i++) adapter.createService(i, services[i]);
+        uint8_t value[INIT_BUFFER];
+        for (size_t i = 0; i < C; i++) {
+            adapter.createCharacteristic(i, chars[i]);
+            if (!chars[i].initial) continue;
+            size_t len = chars[i].initial(owner, value, sizeof(value));
+            adapter.setValue(i, value, len);
+        }
+    }
+
+    template <typename Adapter, size_t C>
+    static size_t bind(Adapter& adapter, const GattCharacteristicDef (&)[C], GattDispatcher& dispatcher) {
+        size_t bound = 0;
+        for (size_t i = 0; i < C; i++) bound += dispatcher.bind(adapter.handleOf(i), (uint8_t)i) ? 1 : 0;
+        return bound;
+    }
+};
+
+#endif // __GATT_REGISTRY_H__
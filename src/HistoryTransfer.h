@@ -0,0 +1,385 @@
+#ifndef __HISTORY_TRANSFER_H__
+#define __HISTORY_TRANSFER_H__
+
+#include <atomic>
+#include <stddef.h>
+#include <stdint.h>
+#include "ByteCodec.h"
+#include "LightSample.h"
+#include "SampleCodec.h"
+#include "SampleLog.h"
+#include "SampleLogReader.h"
+#include "SpscRing.h"
+
+// Bulk download of logged samples, independent of the BLE stack.
+// The central writes a request to the control characteristic; the device answers with a stream
+// of notifications on the data characteristic, each packed with as many 16-byte log records as
+// the negotiated MTU allows, followed by an end-of-transfer packet.
+//
+// Requests (control characteristic, little-endian):
+//   0x01 START_TIME      u48 from ms, u48 to ms, u8 window [, u8 encoding]
+//   0x02 START_SEQUENCE  u32 from sequence, u32 to sequence, u8 window [, u8 encoding]
+//   0x03 CREDIT          u8 packets
+//   0x04 ABORT
+// window is the number of packets the device may send before it needs CREDIT (0 = no flow
+// control beyond the stack's own buffering). To resume after a drop, the central issues
+// START_SEQUENCE from one past the last sequence it received. encoding selects raw records
+// (0, the default) or a SampleCodec chunk per packet (1), which fits several times more.
+//
+// Packets (data characteristic):
+//   0x10 DATA        u8 counter, u32 first sequence, records... (count = (length - 6) / 16)
+//   0x12 DATA_DELTA  u8 counter, u32 first sequence, u8 count, SampleCodec chunk
+//   0x11 END         u8 counter, u32 next sequence, u32 records sent, u8 status
+// counter increments by one per packet so the central can spot a lost notification.
+class HistoryTransfer {
+public:
+    enum Command : uint8_t {
+        CMD_START_TIME     = 0x01,
+        CMD_START_SEQUENCE = 0x02,
+        CMD_CREDIT         = 0x03,
+        CMD_ABORT          = 0x04,
+    };
+
+    enum PacketType : uint8_t {
+        PKT_DATA = 0x10,
+        PKT_END  = 0x11,
+        PKT_DATA_DELTA = 0x12,
+    };
+
+    enum Encoding : uint8_t {
+        ENCODING_RAW   = 0,
+        ENCODING_DELTA = 1,
+    };
+
+    enum Status : uint8_t {
+        STATUS_COMPLETE       = 0,
+        STATUS_ABORTED        = 1,
+        STATUS_BAD_REQUEST    = 2,
+        STATUS_NO_DATA        = 3,
+        STATUS_MTU_TOO_SMALL  = 4,
+    };
+
+    static constexpr size_t ATT_HEADER       = 3;
+    static constexpr size_t DATA_HEADER      = 6;
+    static constexpr size_t DELTA_HEADER     = 7;
+    static constexpr size_t END_SIZE         = 11;
+    static constexpr size_t MAX_PACKET       = 512;
+    static constexpr uint16_t MIN_MTU        = ATT_HEADER + DATA_HEADER + SampleLog::RECORD_SIZE;
+    static constexpr uint16_t MIN_MTU_DELTA  = ATT_HEADER + DELTA_HEADER + SampleCodec::MAX_RECORD_SIZE;
+
+    using TimestampFn = uint64_t (*)(); // epoch milliseconds, bounds sequence searches
+    using PrepareFn   = void (*)();     // called before a transfer starts (e.g. flush the log writer)
+
+    struct Stats {
+        uint32_t transfers;
+        uint32_t packetsSent;
+        uint32_t recordsSent;
+        uint32_t aborted;
+    };
+
+    HistoryTransfer(SampleLogReader& reader_, TimestampFn now_, PrepareFn prepare_ = nullptr)
+        : reader(reader_), now(now_), prepare(prepare_),
+          abortPending(false), credits(0), stats() {
+        resetState();
+    }
+
+    // Called from the BLE write callback (NimBLE host task). Only queues the request; the
+    // SD work happens in nextPacket() on the caller's task. Start requests cross over through a
+    // ring so the loop never copies one the host task is still writing; the newest one wins.
+    bool handleCommand(const uint8_t* data, size_t len) {
+        if (len == 0) return false;
+        Request request = {};
+        switch (data[0]) {
+            case CMD_START_TIME:
+                if (len < 14) return false;
+                request.bySequence = false;
+                request.fromMs = getLe48(data + 1);
+                request.toMs = getLe48(data + 7);
+                request.window = data[13];
+                request.encoding = len > 14 ? data[14] : (uint8_t)ENCODING_RAW;
+                break;
+            case CMD_START_SEQUENCE:
+                if (len < 10) return false;
+                request.bySequence = true;
+                request.fromSeq = getLe32(data + 1);
+                request.toSeq = getLe32(data + 5);
+                request.window = data[9];
+                request.encoding = len > 10 ? data[10] : (uint8_t)ENCODING_RAW;
+                break;
+            case CMD_CREDIT:
+                if (len < 2) return false;
+                credits.fetch_add(data[1], std::memory_order_relaxed);
+                return true;
+            case CMD_ABORT:
+                abortPending.store(true, std::memory_order_release);
+                return true;
+            default:
+                return false;
+        }
+        return requests.push(request);
+    }
+
+    bool active() const {
+        return phase != PHASE_IDLE || !requests.empty() || abortPending.load(std::memory_order_acquire);
+    }
+
+    // Returns the packet to send next (building it if needed), or 0 if there is nothing to send
+    // right now (idle, or waiting for credit). The same packet is returned until packetSent()
+    // is called, so a notify that fails for lack of buffers is simply retried.
+    size_t nextPacket(uint16_t mtu, const uint8_t*& packet) {
+        applyRequests();
+        if (pendingLen == 0) build(mtu);
+        packet = this->packet;
+        return pendingLen;
+    }
+
+    void packetSent() {
+        if (pendingLen == 0) return;
+        stats.packetsSent++;
+        stats.recordsSent += pendingRecords;
+        if (flowControl) credits.fetch_sub(1, std::memory_order_relaxed);
+        pendingLen = 0;
+        counter++;
+        if (phase == PHASE_END_SENT) {
+            phase = PHASE_IDLE;
+            reader.close();
+        }
+    }
+
+    // The central went away: drop any transfer in progress.
+    void cancel() {
+        Request dropped;
+        requests.popLatest(dropped);
+        abortPending.store(false, std::memory_order_release);
+        reader.close();
+        resetState();
+    }
+
+    const Stats& getStats() const { return stats; }
+
+private:
+    enum Phase { PHASE_IDLE, PHASE_STREAMING, PHASE_END_READY, PHASE_END_SENT };
+
+    static constexpr size_t REQUEST_QUEUE = 4;
+
+    struct Request {
+        bool bySequence;
+        uint64_t fromMs, toMs;
+        uint32_t fromSeq, toSeq;
+        uint8_t window;
+        uint8_t encoding;
+    };
+
+    void resetState() {
+        phase = PHASE_IDLE;
+        pendingLen = 0;
+        pendingRecords = 0;
+        counter = 0;
+        encoding = ENCODING_RAW;
+        flowControl = false;
+        sentRecords = 0;
+        nextSequence = 0;
+        haveHeld = false;
+        status = STATUS_COMPLETE;
+    }
+
+    void applyRequests() {
+        if (abortPending.exchange(false, std::memory_order_acq_rel) && phase == PHASE_STREAMING) {
+            stats.aborted++;
+            endWith(STATUS_ABORTED);
+        }
+        Request r;
+        if (!requests.popLatest(r)) return;
+
+        reader.close();
+        resetState();
+        stats.transfers++;
+        flowControl = r.window > 0;
+        encoding = r.encoding == ENCODING_DELTA ? ENCODING_DELTA : ENCODING_RAW;
+        credits.store(r.window, std::memory_order_relaxed);
+        if (prepare) prepare();
+
+        bool ok;
+        if (r.bySequence) {
+            nextSequence = r.fromSeq;
+            ok = reader.seekSequence(r.fromSeq, r.toSeq, (uint32_t)(now() / SampleLog::MS_PER_DAY));
+        } else {
+            ok = reader.seek(r.fromMs, r.toMs);
+        }
+        phase = PHASE_STREAMING;
+        if (!ok) {
+            bool valid = r.bySequence ? r.toSeq >= r.fromSeq : r.toMs >= r.fromMs;
+            endWith(valid ? STATUS_NO_DATA : STATUS_BAD_REQUEST);
+        }
+    }
+
+    void endWith(Status s) {
+        status = s;
+        phase = PHASE_END_READY;
+        pendingLen = 0;
+        pendingRecords = 0;
+    }
+
+    void build(uint16_t mtu) {
+        if (phase == PHASE_IDLE || phase == PHASE_END_SENT) return;
+        // The end packet is always let through so an aborted or stalled transfer still terminates.
+        if (phase == PHASE_STREAMING && flowControl && credits.load(std::memory_order_relaxed) <= 0) return;
+
+        size_t payload = mtu > ATT_HEADER ? mtu - ATT_HEADER : 0;
+        if (payload > MAX_PACKET) payload = MAX_PACKET;
+
+        bool delta = encoding == ENCODING_DELTA;
+        if (phase == PHASE_STREAMING && mtu < (delta ? MIN_MTU_DELTA : MIN_MTU)) endWith(STATUS_MTU_TOO_SMALL);
+        if (phase == PHASE_STREAMING) {
+            size_t header = delta ? DELTA_HEADER : DATA_HEADER;
+            size_t used = header;
+            size_t count = 0;
+            LightSample s;
+            codec.reset();
+            while (delta ? count < UINT8_MAX : used + SampleLog::RECORD_SIZE <= payload) {
+                if (haveHeld) { s = held; haveHeld = false; }
+                else if (!reader.next(s)) break;
+                // Records in one packet must have consecutive sequence numbers.
+                if (count > 0 && s.sequence != firstInPacket + count) { held = s; haveHeld = true; break; }
+                size_t n;
+                if (delta) {
+                    n = codec.encode(s, packet + used, payload - used);
+                    if (n == 0) { held = s; haveHeld = true; break; }
+                } else {
+                    SampleLog::encodeRecord(s, packet + used);
+                    n = SampleLog::RECORD_SIZE;
+                }
+                if (count == 0) firstInPacket = s.sequence;
+                used += n;
+                count++;
+            }
+            if (count > 0) {
+                packet[0] = delta ? PKT_DATA_DELTA : PKT_DATA;
+                packet[1] = counter;
+                putLe32(packet + 2, firstInPacket);
+                if (delta) packet[6] = (uint8_t)count;
+                pendingLen = used;
+                pendingRecords = (uint32_t)count;
+                sentRecords += (uint32_t)count;
+                nextSequence = firstInPacket + (uint32_t)count;
+                return;
+            }
+            endWith(STATUS_COMPLETE);
+        }
+
+        // PHASE_END_READY
+        packet[0] = PKT_END;
+        packet[1] = counter;
+        putLe32(packet + 2, nextSequence);
+        putLe32(packet + 6, sentRecords);
+        packet[10] = status;
+        pendingLen = END_SIZE;
+        pendingRecords = 0;
+        phase = PHASE_END_SENT;
+    }
+
+    SampleLogReader& reader;
+    TimestampFn now;
+    PrepareFn prepare;
+
+    SpscRing<Request, REQUEST_QUEUE> requests; // host task -> loop
+    std::atomic<bool> abortPending;
+    std::atomic<int32_t> credits;
+
+    Phase phase;
+    bool flowControl;
+    uint8_t counter;
+    uint32_t sentRecords;
+    uint32_t nextSequence;
+    uint32_t firstInPacket;
+    bool haveHeld;
+    LightSample held;
+    Status status;
+    uint8_t encoding;
+    SampleCodec::Encoder codec;
+    size_t pendingLen;
+    uint32_t pendingRecords;
+    uint8_t packet[MAX_PACKET];
+    Stats stats;
+};
+
+// Central-side reassembly of a history stream. Used by host tools and simulations to check the
+// device's output; it reports records through a callback and tells the caller where to resume
+// when a packet goes missing.
+class HistoryReassembler {
+public:
+    using RecordFn = void (*)(const LightSample& s, void* context);
+
+    enum Result { RESULT_OK, RESULT_GAP, RESULT_END, RESULT_INVALID };
+
+    HistoryReassembler(RecordFn onRecord_, void* context_) : onRecord(onRecord_), context(context_) { reset(0); }
+
+    // Starts tracking a transfer that was requested from sequence fromSeq.
+    void reset(uint32_t fromSeq) {
+        expectedSequence = fromSeq;
+        haveCounter = false;
+        expectedCounter = 0;
+        received = 0;
+        endStatus = 0;
+    }
+
+    // Feeds one notification. On RESULT_GAP the caller should re-request from resumeSequence().
+    // RESULT_INVALID packets are to be ignored; that includes late copies of packets already
+    // handled and leftovers from a transfer this one replaced (each starts again at counter 0).
+    Result feed(const uint8_t* data, size_t len) {
+        if (len < 2) return RESULT_INVALID;
+        int8_t ahead = (int8_t)(data[1] - (haveCounter ? expectedCounter : 0));
+        if (ahead < 0) return RESULT_INVALID;
+        if (ahead > 0) return RESULT_GAP;
+
+        if (data[0] == HistoryTransfer::PKT_END) {
+            if (len < HistoryTransfer::END_SIZE) return RESULT_INVALID;
+            haveCounter = true;
+            expectedCounter = (uint8_t)(data[1] + 1);
+            endStatus = data[10];
+            return RESULT_END;
+        }
+        bool delta = data[0] == HistoryTransfer::PKT_DATA_DELTA;
+        if (!delta && data[0] != HistoryTransfer::PKT_DATA) return RESULT_INVALID;
+        if (len < (delta ? HistoryTransfer::DELTA_HEADER : HistoryTransfer::DATA_HEADER)) return RESULT_INVALID;
+
+        uint32_t first = getLe32(data + 2);
+        size_t count = delta ? data[6] : (len - HistoryTransfer::DATA_HEADER) / SampleLog::RECORD_SIZE;
+        if (first < expectedSequence) return RESULT_INVALID;
+        SampleCodec::Decoder decoder;
+        size_t offset = delta ? HistoryTransfer::DELTA_HEADER : HistoryTransfer::DATA_HEADER;
+        for (size_t i = 0; i < count; i++) {
+            LightSample s;
+            s.sequence = first + (uint32_t)i;
+            if (delta) {
+                size_t n = decoder.decode(data + offset, len - offset, s);
+                if (n == 0) return RESULT_INVALID;
+                offset += n;
+            } else {
+                SampleLog::decodeRecord(data + offset, first + (uint32_t)i, s);
+                offset += SampleLog::RECORD_SIZE;
+            }
+            if (onRecord) onRecord(s, context);
+        }
+        haveCounter = true;
+        expectedCounter = (uint8_t)(data[1] + 1);
+        expectedSequence = first + (uint32_t)count;
+        received += (uint32_t)count;
+        return RESULT_OK;
+    }
+
+    uint32_t resumeSequence() const { return expectedSequence; }
+    uint32_t recordsReceived() const { return received; }
+    uint8_t status() const { return endStatus; }
+
+private:
+    RecordFn onRecord;
+    void* context;
+    uint32_t expectedSequence;
+    bool haveCounter;
+    uint8_t expectedCounter;
+    uint32_t received;
+    uint8_t endStatus;
+};
+
+#endif // __HISTORY_TRANSFER_H__
@@ -0,0 +1,69 @@
+#ifndef __HOST_LOOKUP_H__
+#define __HOST_LOOKUP_H__
+
+#include <stdint.h>
+#include <lwip/dns.h>
+#include <lwip/tcpip.h>
+
+// Non-blocking DNS lookup. The Arduino helpers (WiFiUDP::beginPacket(host), WiFiClient::connect(host))
+// resolve names synchronously, which can hold loop() for seconds; this starts the lookup on the
+// lwIP thread and resolve() reports ready once the answer is in. A failed lookup is not retried
+// until the owner says so (retry() or reset()), so a caller polling resolve() while the name
+// server is unreachable asks once per attempt of its own, at its own backoff.
+class HostLookup {
+public:
+    explicit HostLookup(const char* host_) : host(host_), lookup(LOOKUP_NONE), resolvedAddress(0) {}
+
+    // Starts a lookup unless one is running, done or failed. True once the address is known.
+    bool resolve() {
+        if (lookup == LOOKUP_NONE) {
+            lookup = LOOKUP_PENDING;
+            if (tcpip_callback(startLookup, this) != ERR_OK) lookup = LOOKUP_FAILED;
+        }
+        return lookup == LOOKUP_DONE;
+    }
+
+    // IPv4 address in network byte order; valid once resolve() returned true.
+    uint32_t address() const { return resolvedAddress; }
+
+    // Lets the next resolve() ask again after a failed lookup; a known address is kept.
+    void retry() {
+        if (lookup == LOOKUP_FAILED) lookup = LOOKUP_NONE;
+    }
+
+    // Forgets the answer so the next resolve() asks again (a pool server may have gone away).
+    void reset() {
+        if (lookup != LOOKUP_PENDING) lookup = LOOKUP_NONE;
+    }
+
+private:
+    enum Lookup : uint8_t { LOOKUP_NONE, LOOKUP_PENDING, LOOKUP_DONE, LOOKUP_FAILED };
+
+    // Runs on the lwIP thread. Answers from the DNS cache come back at once, others through onLookup().
+    static void startLookup(void* arg) {
+        HostLookup* self = static_cast<HostLookup*>(arg);
+        ip_addr_t addr;
+        err_t err = dns_gethostbyname(self->host, &addr, onLookup, self);
+        if (err == ERR_OK) self->resolved(&addr);
+        else if (err != ERR_INPROGRESS) self->lookup = LOOKUP_FAILED;
+    }
+
+    static void onLookup(const char* name, const ip_addr_t* addr, void* arg) {
+        static_cast<HostLookup*>(arg)->resolved(addr);
+    }
+
+    void resolved(const ip_addr_t* addr) {
+        if (!addr || !IP_IS_V4(addr)) {
+            lookup = LOOKUP_FAILED;
+            return;
+        }
+        resolvedAddress = ip4_addr_get_u32(ip_2_ip4(addr));
+        lookup = LOOKUP_DONE;
+    }
+
+    const char* host;
+    volatile Lookup lookup;
+    volatile uint32_t resolvedAddress;
+};
+
+#endif // __HOST_LOOKUP_H__
@@ -0,0 +1,435 @@
+#ifndef __HTTP_SERVER_H__
+#define __HTTP_SERVER_H__
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include "LightSample.h"
+#include "SampleLogReader.h"
+
+// Listening socket and its connections: lwIP sockets on the device (ArduinoHttpTransport),
+// POSIX sockets in host tests (PosixHttpTransport). None of the calls block.
+class HttpTransport {
+public:
+    virtual ~HttpTransport() {}
+    virtual bool listen(uint16_t port) = 0;
+    // A newly accepted connection, or -1 if none is waiting.
+    virtual int accept() = 0;
+    // Bytes read or written, 0 if the socket isn't ready, -1 once the connection is gone.
+    virtual int read(int conn, uint8_t* out, size_t capacity) = 0;
+    virtual int write(int conn, const uint8_t* data, size_t len) = 0;
+    virtual void close(int conn) = 0;
+};
+
+// Small HTTP/1.1 server for the LAN, polled from loop():
+//   GET /latest                 newest sample as JSON
+//   GET /history?from=&to=      logged samples in [from, to] (epoch ms) as CSV, chunked; to
+//                               defaults to now, from to a day earlier, and a range is cut to
+//                               its last MAX_HISTORY_DAYS so one request can't walk years of days
+//   GET /metrics                Prometheus text format, from the registered metrics
+//   GET /trace                  the trace log, binary, for tools/trace_decode.py
+//
+// Everything is preallocated: at most MAX_CONNECTIONS clients (further ones get a 503 and are
+// closed), one request buffer and one send buffer each. Responses are formatted straight from
+// the samples and metric values into a connection's send buffer a bufferful at a time, as the
+// socket drains, so a long history download costs no more memory than a short one, and each
+// service() call produces at most CHUNKS_PER_SERVICE buffers per connection. One history download runs at a time
+// (there is one log reader); a second gets a 503 with Retry-After. Connections are kept alive
+// between requests and closed after IDLE_TIMEOUT_MS without traffic.
+class HttpServer {
+public:
+    static constexpr size_t   MAX_CONNECTIONS = 4;
+    static constexpr size_t   MAX_REQUEST     = 512;
+    static constexpr size_t   TX_BUFFER       = 1024;
+    static constexpr size_t   MAX_METRICS     = 32;
+    static constexpr uint32_t IDLE_TIMEOUT_MS = 15000;
+    static constexpr uint32_t MAX_HISTORY_DAYS = SampleLog::MAX_LOOKBACK_DAYS;
+    static constexpr size_t   CHUNKS_PER_SERVICE = 4;
+
+    using LatestFn  = bool (*)(LightSample& out);
+    using EpochFn   = uint64_t (*)();   // Unix epoch milliseconds
+    using FlushFn   = void (*)();
+    using MetricFn  = double (*)(void* context);
+    // Fills out with the next piece of the trace dump, cursor 0 at the start; 0 when done.
+    using TraceFn   = size_t (*)(void* context, uint32_t& cursor, uint8_t* out, size_t capacity);
+
+    enum MetricType : uint8_t { METRIC_GAUGE, METRIC_COUNTER };
+
+    struct Stats {
+        uint32_t connections;
+        uint32_t rejected;      // turned away: all connection slots busy
+        uint32_t requests;
+        uint32_t errors;        // 4xx/5xx responses
+        uint32_t historyStreams;
+        uint32_t bytesSent;
+        uint32_t peakConnections;
+    };
+
+    explicit HttpServer(HttpTransport& transport_)
+        : transport(transport_), listening(false), latest(nullptr), history(nullptr), epochMs(nullptr), flushLog(nullptr),
+          trace(nullptr), traceContext(nullptr), historyOwner(-1), metricCount(0), openCount(0), stats() {
+        for (size_t i = 0; i < MAX_CONNECTIONS; i++) conns[i].fd = -1;
+    }
+
+    void setLatest(LatestFn fn) { latest = fn; }
+
+    // Log reader for /history; flush (optional) commits buffered samples before a download.
+    void setHistory(SampleLogReader* reader, EpochFn epochMs_, FlushFn flush = nullptr) {
+        history = reader;
+        epochMs = epochMs_;
+        flushLog = flush;
+    }
+
+    void setTrace(TraceFn fn, void* context = nullptr) {
+        trace = fn;
+        traceContext = context;
+    }
+
+    // Registers a /metrics value. name and help must outlive the server. Call during setup.
+    bool addMetric(const char* name, const char* help, MetricType type, MetricFn fn, void* context = nullptr) {
+        if (metricCount >= MAX_METRICS || !fn) return false;
+        Metric& m = metrics[metricCount++];
+        m.name = name;
+        m.help = help;
+        m.type = type;
+        m.fn = fn;
+        m.context = context;
+        return true;
+    }
+
+    bool begin(uint16_t port) {
+        listening = transport.listen(port);
+        return listening;
+    }
+
+    // Accepts, reads and writes whatever is ready. Call every few tens of milliseconds.
+    void service(uint32_t nowMs) {
+        if (!listening) return;
+        acceptNew(nowMs);
+        for (size_t i = 0; i < MAX_CONNECTIONS; i++) {
+            if (conns[i].fd >= 0) serviceConnection((int)i, nowMs);
+        }
+    }
+
+    bool isListening() const { return listening; }
+    size_t connectionCount() const { return openCount; }
+    const Stats& getStats() const { return stats; }
+
+private:
+    enum Route : uint8_t { ROUTE_NONE, ROUTE_FIXED, ROUTE_HISTORY, ROUTE_METRICS, ROUTE_TRACE };
+
+    struct Metric {
+        const char* name;
+        const char* help;
+        MetricType type;
+        MetricFn fn;
+        void* context;
+    };
+
+    struct Connection {
+        int fd;
+        uint32_t lastActivityMs;
+        char request[MAX_REQUEST + 1];
+        size_t requestLen;
+        uint8_t tx[TX_BUFFER];
+        size_t txLen;
+        size_t txSent;
+        Route route;
+        bool finished;    // nothing left to produce for the current response
+        bool keepAlive;
+        uint32_t cursor;  // route-specific progress (metric index, rows sent, trace cursor)
+    };
+
+    // Room kept back in a chunk for the "xxxx\r\n" size line, the trailing "\r\n" and the last-chunk marker.
+    static constexpr size_t CHUNK_HEAD  = 6;
+    static constexpr size_t CHUNK_TAIL  = 2 + 5;
+    static constexpr size_t MAX_CSV_ROW = 64;
+    static constexpr size_t MAX_METRIC_TEXT = 320;
+
+    void acceptNew(uint32_t nowMs) {
+        int fd;
+        while ((fd = transport.accept()) >= 0) {
+            Connection* c = nullptr;
+            for (size_t i = 0; i < MAX_CONNECTIONS && !c; i++) {
+                if (conns[i].fd < 0) c = &conns[i];
+            }
+            if (!c) {
+                // Best effort: the socket buffer is empty, so this short reply normally goes out whole.
+                static const char busy[] = "HTTP/1.1 503 Service Unavailable\r\nRetry-After: 1\r\nContent-Length: 0\r\nConnection: close\r\n\r\n";
+                transport.write(fd, (const uint8_t*)busy, sizeof(busy) - 1);
+                transport.close(fd);
+                stats.rejected++;
+                continue;
+            }
+            c->fd = fd;
+            c->lastActivityMs = nowMs;
+            resetRequest(*c);
+            stats.connections++;
+            if (++openCount > stats.peakConnections) stats.peakConnections = (uint32_t)openCount;
+        }
+    }
+
+    void serviceConnection(int id, uint32_t nowMs) {
+        Connection& c = conns[id];
+        size_t produced = 0;
+        for (;;) {
+            if (c.txSent < c.txLen) {
+                int n = transport.write(c.fd, c.tx + c.txSent, c.txLen - c.txSent);
+                if (n < 0) return closeConnection(id);
+                if (n == 0) break;
+                c.txSent += (size_t)n;
+                stats.bytesSent += (uint32_t)n;
+                c.lastActivityMs = nowMs;
+                if (c.txSent < c.txLen) break;
+            }
+            c.txLen = c.txSent = 0;
+            if (c.route != ROUTE_NONE) {
+                if (!c.finished) {
+                    if (produced++ == CHUNKS_PER_SERVICE) break;
+                    produce(id);
+                    continue;
+                }
+                if (!c.keepAlive) return closeConnection(id);
+                resetRequest(c);
+            }
+            if (!readRequest(id, nowMs)) break;
+        }
+        if (c.fd >= 0 && nowMs - c.lastActivityMs >= IDLE_TIMEOUT_MS) closeConnection(id);
+    }
+
+    // Reads until the request head is complete, then starts the response. False if there is
+    // nothing more to do right now.
+    bool readRequest(int id, uint32_t nowMs) {
+        Connection& c = conns[id];
+        while (c.requestLen < MAX_REQUEST) {
+            int n = transport.read(c.fd, (uint8_t*)c.request + c.requestLen, MAX_REQUEST - c.requestLen);
+            if (n < 0) {
+                closeConnection(id);
+                return false;
+            }
+            if (n == 0) return false;
+            c.requestLen += (size_t)n;
+            c.request[c.requestLen] = '\0';
+            c.lastActivityMs = nowMs;
+            if (strstr(c.request, "\r\n\r\n")) {
+                dispatch(id);
+                return true;
+            }
+        }
+        c.keepAlive = false;
+        respondFixed(c, 431, "Request Header Fields Too Large", "text/plain", "request too large\n");
+        return true;
+    }
+
+    void dispatch(int id) {
+        Connection& c = conns[id];
+        stats.requests++;
+        char method[8], target[128], version[10];
+        if (sscanf(c.request, "%7s %127s %9s", method, target, version) != 3 || strncmp(version, "HTTP/1.", 7) != 0) {
+            c.keepAlive = false;
+            return respondFixed(c, 400, "Bad Request", "text/plain", "bad request\n");
+        }
+        c.keepAlive = strcmp(version, "HTTP/1.1") == 0 && !headerHas(c.request, "connection:", "close");
+        if (strcmp(method, "GET") != 0) return respondFixed(c, 405, "Method Not Allowed", "text/plain", "GET only\n");
+
+        char* query = strchr(target, '?');
+        if (query) *query++ = '\0';
+        if (strcmp(target, "/latest") == 0) return startLatest(c);
+        if (strcmp(target, "/history") == 0) return startHistory(id, query);
+        if (strcmp(target, "/metrics") == 0) return startChunked(c, ROUTE_METRICS, "text/plain; version=0.0.4");
+        if (strcmp(target, "/trace") == 0 && trace) return startChunked(c, ROUTE_TRACE, "application/octet-stream");
+        respondFixed(c, 404, "Not Found", "text/plain", "not found\n");
+    }
+
+    void startLatest(Connection& c) {
+        LightSample s;
+        if (!latest || !latest(s)) return respondFixed(c, 503, "Service Unavailable", "text/plain", "no sample yet\n");
+        char body[192];
+        snprintf(body, sizeof(body),
+                 "{\"sequence\":%lu,\"timestamp_ms\":%llu,\"lux\":%lu.%02lu,\"ch0\":%u,\"ch1\":%u,\"control\":%u,\"flags\":%u}\n",
+                 (unsigned long)s.sequence, (unsigned long long)s.timestampMs, (unsigned long)(s.centiLux / 100),
+                 (unsigned long)(s.centiLux % 100), (unsigned)s.fullCount, (unsigned)s.irCount, (unsigned)s.control,
+                 (unsigned)s.flags);
+        respondFixed(c, 200, "OK", "application/json", body);
+    }
+
+    void startHistory(int id, const char* query) {
+        Connection& c = conns[id];
+        if (!history) return respondFixed(c, 404, "Not Found", "text/plain", "no sample log\n");
+        if (historyOwner >= 0) return respondFixed(c, 503, "Service Unavailable", "text/plain", "history busy\n", true);
+        uint64_t toMs = epochMs ? epochMs() : 0, fromMs;
+        if (!queryValue(query, "to", toMs) && hasKey(query, "to")) {
+            return respondFixed(c, 400, "Bad Request", "text/plain", "bad to\n");
+        }
+        fromMs = toMs > SampleLog::MS_PER_DAY ? toMs - SampleLog::MS_PER_DAY : 0;
+        if (!queryValue(query, "from", fromMs) && hasKey(query, "from")) {
+            return respondFixed(c, 400, "Bad Request", "text/plain", "bad from\n");
+        }
+        if (toMs < fromMs) return respondFixed(c, 400, "Bad Request", "text/plain", "to before from\n");
+        uint64_t maxSpanMs = (uint64_t)MAX_HISTORY_DAYS * SampleLog::MS_PER_DAY;
+        if (toMs - fromMs > maxSpanMs) fromMs = toMs - maxSpanMs;
+        if (flushLog) flushLog();
+        history->seek(fromMs, toMs);
+        historyOwner = id;
+        stats.historyStreams++;
+        startChunked(c, ROUTE_HISTORY, "text/csv");
+    }
+
+    void startChunked(Connection& c, Route route, const char* type) {
+        int n = snprintf((char*)c.tx, TX_BUFFER,
+                         "HTTP/1.1 200 OK\r\nContent-Type: %s\r\nTransfer-Encoding: chunked\r\nCache-Control: no-store\r\n%s\r\n",
+                         type, c.keepAlive ? "" : "Connection: close\r\n");
+        c.txLen = (size_t)n;
+        c.txSent = 0;
+        c.route = route;
+        c.finished = false;
+        c.cursor = 0;
+    }
+
+    void respondFixed(Connection& c, int status, const char* reason, const char* type, const char* body, bool retry = false) {
+        size_t len = strlen(body);
+        int n = snprintf((char*)c.tx, TX_BUFFER, "HTTP/1.1 %d %s\r\nContent-Type: %s\r\nContent-Length: %u\r\n%s%s\r\n%s",
+                         status, reason, type, (unsigned)len, retry ? "Retry-After: 1\r\n" : "",
+                         c.keepAlive ? "" : "Connection: close\r\n", body);
+        c.txLen = n > 0 && (size_t)n < TX_BUFFER ? (size_t)n : 0;
+        c.txSent = 0;
+        c.route = ROUTE_FIXED;
+        c.finished = true;
+        if (status >= 400) stats.errors++;
+    }
+
+    // Fills the send buffer with the next chunk of a streamed response.
+    void produce(int id) {
+        Connection& c = conns[id];
+        char* body = (char*)c.tx + CHUNK_HEAD;
+        size_t cap = TX_BUFFER - CHUNK_HEAD - CHUNK_TAIL;
+        size_t len = 0;
+        bool done = false;
+        if (c.route == ROUTE_HISTORY) {
+            if (c.cursor == 0) len += (size_t)snprintf(body, cap, "sequence,timestamp_ms,lux,ch0,ch1,control,flags\n");
+            LightSample s;
+            while (cap - len > MAX_CSV_ROW) {
+                if (!history->next(s)) {
+                    done = true;
+                    break;
+                }
+                len += (size_t)snprintf(body + len, cap - len, "%lu,%llu,%lu.%02lu,%u,%u,%u,%u\n",
+                                        (unsigned long)s.sequence, (unsigned long long)s.timestampMs,
+                                        (unsigned long)(s.centiLux / 100), (unsigned long)(s.centiLux % 100),
+                                        (unsigned)s.fullCount, (unsigned)s.irCount, (unsigned)s.control, (unsigned)s.flags);
+                c.cursor++;
+            }
+            if (c.cursor == 0) c.cursor = 1; // header written
+        } else if (c.route == ROUTE_TRACE) {
+            len = trace(traceContext, c.cursor, (uint8_t*)body, cap);
+            done = len == 0;
+        } else {
+            while (c.cursor < metricCount && cap - len > MAX_METRIC_TEXT) {
+                len += formatMetric(metrics[c.cursor], body + len, cap - len);
+                c.cursor++;
+            }
+            done = c.cursor >= metricCount;
+        }
+
+        size_t n = 0;
+        if (len > 0) {
+            char head[CHUNK_HEAD + 1];
+            snprintf(head, sizeof(head), "%04x\r\n", (unsigned)len);
+            memcpy(c.tx, head, CHUNK_HEAD);
+            n = CHUNK_HEAD + len;
+            c.tx[n++] = '\r';
+            c.tx[n++] = '\n';
+        }
+        if (done) {
+            memcpy(c.tx + n, "0\r\n\r\n", 5);
+            n += 5;
+            c.finished = true;
+            if (c.route == ROUTE_HISTORY) historyOwner = -1;
+        }
+        c.txLen = n;
+        c.txSent = 0;
+    }
+
+    static size_t formatMetric(const Metric& m, char* out, size_t cap) {
+        int n = snprintf(out, cap, "# HELP %s %s\n# TYPE %s %s\n%s %.10g\n", m.name, m.help, m.name,
+                         m.type == METRIC_COUNTER ? "counter" : "gauge", m.name, m.fn(m.context));
+        return n > 0 && (size_t)n < cap ? (size_t)n : 0;
+    }
+
+    // Parses key=<unsigned> from a query string. False if the key is absent or not a number.
+    static bool queryValue(const char* query, const char* key, uint64_t& out) {
+        size_t keyLen = strlen(key);
+        for (const char* p = query; p && *p; ) {
+            if (strncmp(p, key, keyLen) == 0 && p[keyLen] == '=') {
+                char* end;
+                unsigned long long v = strtoull(p + keyLen + 1, &end, 10);
+                if (end == p + keyLen + 1 || (*end != '\0' && *end != '&')) return false;
+                out = v;
+                return true;
+            }
+            p = strchr(p, '&');
+            if (p) p++;
+        }
+        return false;
+    }
+
+    static bool hasKey(const char* query, const char* key) {
+        size_t keyLen = strlen(key);
+        for (const char* p = query; p && *p; ) {
+            if (strncmp(p, key, keyLen) == 0 && p[keyLen] == '=') return true;
+            p = strchr(p, '&');
+            if (p) p++;
+        }
+        return false;
+    }
+
+    // True if a header (name includes the colon, lower case) is present and its value starts with value.
+    static bool headerHas(const char* request, const char* name, const char* value) {
+        size_t nameLen = strlen(name), valueLen = strlen(value);
+        for (const char* line = strstr(request, "\r\n"); line; line = strstr(line + 2, "\r\n")) {
+            if (strncasecmp(line + 2, name, nameLen) != 0) continue;
+            const char* v = line + 2 + nameLen;
+            while (*v == ' ') v++;
+            return strncasecmp(v, value, valueLen) == 0;
+        }
+        return false;
+    }
+
+    void resetRequest(Connection& c) {
+        c.requestLen = 0;
+        c.request[0] = '\0';
+        c.txLen = c.txSent = 0;
+        c.route = ROUTE_NONE;
+        c.finished = false;
+        c.keepAlive = true;
+        c.cursor = 0;
+    }
+
+    void closeConnection(int id) {
+        Connection& c = conns[id];
+        transport.close(c.fd);
+        c.fd = -1;
+        if (historyOwner == id) historyOwner = -1;
+        openCount--;
+    }
+
+    HttpTransport& transport;
+    bool listening;
+    LatestFn latest;
+    SampleLogReader* history;
+    EpochFn epochMs;
+    FlushFn flushLog;
+    TraceFn trace;
+    void* traceContext;
+    int historyOwner;
+    Metric metrics[MAX_METRICS];
+    size_t metricCount;
+    Connection conns[MAX_CONNECTIONS];
+    size_t openCount;
+    Stats stats;
+};
+
+#endif // __HTTP_SERVER_H__
@@ -0,0 +1,131 @@
+#ifndef __LATENCY_STATS_H__
+#define __LATENCY_STATS_H__
+
+#include <atomic>
+#include <stdint.h>
+#include "ByteCodec.h"
+#include "CycleCounter.h"
+
+// Hot-path latency histograms for field diagnostics: one fixed set of log2 buckets (in CPU
+// cycles) per stage, plus a failure counter and the worst case. Recording is a bucket increment
+// and a compare against the maximum on relaxed atomics, so any task (or the NimBLE host) can
+// record without a lock and without being blocked by a reader; a snapshot read while others
+// record is consistent per counter, not across counters.
+//
+// Snapshot (little-endian), read from the diagnostics service:
+//   0  u8   format version
+//   1  u8   stage count
+//   2  u8   bucket count
+//   3  u8   FIRST_BITS: bucket 0 holds < 2^FIRST_BITS cycles, bucket k >= 1 holds
+//           [2^(FIRST_BITS+k-1), 2^(FIRST_BITS+k)), the last bucket everything above
+//   4  u16  CPU clock, MHz (cycles per microsecond)
+//   6  u32  milliseconds since the last reset
+//  10  per stage, in Stage order:
+//        u32 count, u32 failures, u32 max cycles, u16 bucket counts (saturating)
+class LatencyStats {
+public:
+    enum Stage : uint8_t {
+        STAGE_SENSOR,        // SensorTask: one TSL2591 service (or a polled read, integration included)
+        STAGE_LUX,           // lux from the raw channels
+        STAGE_BLE_NOTIFY,    // one notify() into the stack; failures: no buffer / not connected
+        STAGE_SETTINGS_WRITE,// the settings blob to NVS; failures: write failed
+        STAGE_WIFI,          // one Wi-Fi driver call (connect, status, scan)
+        STAGE_BLE_CALLBACK,  // a GATT or connection callback on the NimBLE host task
+        STAGE_COUNT
+    };
+
+    static constexpr uint8_t  FORMAT_VERSION = 1;
+    static constexpr size_t   BUCKETS        = 24;
+    static constexpr uint8_t  FIRST_BITS     = 8;
+    static constexpr size_t   HEADER_SIZE    = 10;
+    static constexpr size_t   STAGE_SIZE     = 12 + 2 * BUCKETS;
+    static constexpr size_t   SNAPSHOT_SIZE  = HEADER_SIZE + STAGE_COUNT * STAGE_SIZE;
+
+    // Times the enclosing block into one stage.
+    class Scope {
+    public:
+        Scope(LatencyStats& stats_, Stage stage_) : stats(stats_), stage(stage_), start(CycleCounter::now()) {}
+        ~Scope() { stats.record(stage, CycleCounter::since(start)); }
+        Scope(const Scope&) = delete;
+        Scope& operator=(const Scope&) = delete;
+
+    private:
+        LatencyStats& stats;
+        Stage stage;
+        uint32_t start;
+    };
+
+    static uint8_t bucketOf(uint32_t cycles) {
+        uint8_t bits = (uint8_t)(32 - __builtin_clz(cycles | 1));
+        if (bits <= FIRST_BITS) return 0;
+        uint8_t b = bits - FIRST_BITS;
+        return b < BUCKETS ? b : (uint8_t)(BUCKETS - 1);
+    }
+
+    void record(Stage stage, uint32_t cycles) {
+        Counters& c = stages[stage];
+        c.buckets[bucketOf(cycles)].fetch_add(1, std::memory_order_relaxed);
+        uint32_t max = c.maxCycles.load(std::memory_order_relaxed);
+        while (cycles > max && !c.maxCycles.compare_exchange_weak(max, cycles, std::memory_order_relaxed)) {}
+    }
+
+    void fail(Stage stage) {
+        stages[stage].failures.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    uint32_t count(Stage stage) const {
+        uint32_t n = 0;
+        for (size_t b = 0; b < BUCKETS; b++) n += stages[stage].buckets[b].load(std::memory_order_relaxed);
+        return n;
+    }
+
+    uint32_t failures(Stage stage) const { return stages[stage].failures.load(std::memory_order_relaxed); }
+    uint32_t maxCycles(Stage stage) const { return stages[stage].maxCycles.load(std::memory_order_relaxed); }
+
+    // Records that race a reset may survive it.
+    void reset(uint32_t nowMs) {
+        for (size_t s = 0; s < STAGE_COUNT; s++) {
+            for (size_t b = 0; b < BUCKETS; b++) stages[s].buckets[b].store(0, std::memory_order_relaxed);
+            stages[s].failures.store(0, std::memory_order_relaxed);
+            stages[s].maxCycles.store(0, std::memory_order_relaxed);
+        }
+        resetAtMs.store(nowMs, std::memory_order_relaxed);
+    }
+
+    size_t encode(uint8_t* out, size_t outLen, uint32_t nowMs) const {
+        if (outLen < SNAPSHOT_SIZE) return 0;
+        size_t n = 0;
+        out[n++] = FORMAT_VERSION;
+        out[n++] = STAGE_COUNT;
+        out[n++] = BUCKETS;
+        out[n++] = FIRST_BITS;
+        putLe16(out + n, (uint16_t)(CycleCounter::hz() / 1000000UL)); n += 2;
+        putLe32(out + n, nowMs - resetAtMs.load(std::memory_order_relaxed)); n += 4;
+        for (size_t s = 0; s < STAGE_COUNT; s++) {
+            const Counters& c = stages[s];
+            putLe32(out + n, count((Stage)s)); n += 4;
+            putLe32(out + n, c.failures.load(std::memory_order_relaxed)); n += 4;
+            putLe32(out + n, c.maxCycles.load(std::memory_order_relaxed)); n += 4;
+            for (size_t b = 0; b < BUCKETS; b++) {
+                uint32_t v = c.buckets[b].load(std::memory_order_relaxed);
+                putLe16(out + n, (uint16_t)(v > 0xFFFF ? 0xFFFF : v)); n += 2;
+            }
+        }
+        return n;
+    }
+
+private:
+    struct Counters {
+        std::atomic<uint32_t> buckets[BUCKETS];
+        std::atomic<uint32_t> failures;
+        std::atomic<uint32_t> maxCycles;
+    };
+
+    Counters stages[STAGE_COUNT];
+    std::atomic<uint32_t> resetAtMs;
+};
+
+// The firmware's one set of histograms; zero at boot (static storage), shared by every task.
+inline LatencyStats latencyStats;
+
+#endif // __LATENCY_STATS_H__
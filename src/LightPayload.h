@@ -0,0 +1,62 @@
+#ifndef __LIGHT_PAYLOAD_H__
+#define __LIGHT_PAYLOAD_H__
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include "ByteCodec.h"
+#include "LightSample.h"
+
+// Packed binary value of the light characteristic.
+// Layout (little-endian, 20 bytes so it fits a default 23-byte ATT MTU notification):
+//   0  u8   flags (LightSample::Flags)
+//   1  u32  sequence
+//   5  u48  timestamp, Unix epoch milliseconds
+//   11 u32  lux * 100
+//   15 u16  CH0 full-spectrum count
+//   17 u16  CH1 infrared count
+//   19 u8   TSL2591 CONTROL value (gain bits 5:4, integration bits 2:0)
+// The format version is published in a descriptor on the characteristic, not in every payload.
+struct LightPayload {
+    static constexpr uint8_t FORMAT_VERSION = 1;
+    static constexpr size_t  SIZE           = 20;
+
+    static size_t encode(const LightSample& s, uint8_t* out, size_t outLen) {
+        if (outLen < SIZE) return 0;
+        out[0] = s.flags;
+        putLe32(out + 1, s.sequence);
+        putLe48(out + 5, s.timestampMs);
+        putLe32(out + 11, s.centiLux);
+        putLe16(out + 15, s.fullCount);
+        putLe16(out + 17, s.irCount);
+        out[19] = s.control;
+        return SIZE;
+    }
+
+    static bool decode(const uint8_t* in, size_t inLen, LightSample& s) {
+        if (inLen < SIZE) return false;
+        s.flags       = in[0];
+        s.sequence    = getLe32(in + 1);
+        s.timestampMs = getLe48(in + 5);
+        s.centiLux    = getLe32(in + 11);
+        s.fullCount   = getLe16(in + 15);
+        s.irCount     = getLe16(in + 17);
+        s.control     = in[19];
+        return true;
+    }
+
+    // Legacy text form ("123.45 lux" or "-- lux") written into a caller-owned buffer.
+    static size_t formatText(const LightSample& s, char* out, size_t outLen) {
+        if (outLen == 0) return 0;
+        int n;
+        if (s.flags & (LightSample::FLAG_SATURATED | LightSample::FLAG_NO_SIGNAL)) {
+            n = snprintf(out, outLen, "-- lux");
+        } else {
+            n = snprintf(out, outLen, "%lu.%02lu lux", (unsigned long)(s.centiLux / 100), (unsigned long)(s.centiLux % 100));
+        }
+        if (n < 0) { out[0] = '\0'; return 0; }
+        return (size_t)n < outLen ? (size_t)n : outLen - 1;
+    }
+};
+
+#endif // __LIGHT_PAYLOAD_H__
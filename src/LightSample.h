@@ -0,0 +1,23 @@
+#ifndef __LIGHT_SAMPLE_H__
+#define __LIGHT_SAMPLE_H__
+
+#include <stdint.h>
+
+// One light reading as it moves through the firmware (BLE, SD log, uplink).
+// Lux is kept in fixed point (hundredths of a lux) so nothing downstream needs float math.
+struct LightSample {
+    enum Flags : uint8_t {
+        FLAG_SATURATED = 0x01, // a channel hit its ADC ceiling, lux is a lower bound
+        FLAG_NO_SIGNAL = 0x02, // visible channel read zero
+    };
+
+    uint32_t sequence;     // increments by one per sample since boot
+    uint64_t timestampMs;  // Unix epoch milliseconds
+    uint32_t centiLux;     // lux * 100
+    uint16_t fullCount;    // raw CH0 (full spectrum) count
+    uint16_t irCount;      // raw CH1 (infrared) count
+    uint8_t  control;      // TSL2591 CONTROL register value: gain in bits 5:4, integration time in bits 2:0
+    uint8_t  flags;
+};
+
+#endif // __LIGHT_SAMPLE_H__
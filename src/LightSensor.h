@@ -3,16 +3,22 @@
 
 #include <Adafruit_Sensor.h>
 #include <Adafruit_TSL2591.h>
+#include "AlsAcquisition.h"
+#include "AutoRange.h"
+#include "LatencyStats.h"
+#include "LightSample.h"
+#include "LuxEngine.h"
+#include "WireTsl2591Bus.h"
 
 class LightSensor {
 public:
-    LightSensor() : tsl(2591) {}
+    LightSensor() : tsl(2591), acquisition(bus), nextSequence(0), autoRanging(true) {}
 
     bool begin() {
         if (tsl.begin()) {
             Serial.println("TSL2591 sensor found.");
-            tsl.setGain(TSL2591_GAIN_MED); // Options: LOW, MED, HIGH, MAX
-            tsl.setTiming(TSL2591_INTEGRATIONTIME_100MS);
+            // Starts at MED gain / 100 ms; auto-ranging moves it from there.
+            applySetting(autoRange.setting());
             return true;
         } else {
             Serial.println("Could not find TSL2591. Check wiring.");
@@ -20,13 +26,15 @@ public:
         }
     }
 
+    // Debug print of one reading. Goes through the raw-channel path like read(), but leaves
+    // the sequence counter and auto-ranging alone.
     void printLightLevel() {
-        sensors_event_t event;
-        tsl.getEvent(&event);
-        if (event.light) {
-            Serial.print("Light: ");
-            Serial.print(event.light);
-            Serial.println(" lux");
+        uint32_t lum = tsl.getFullLuminosity();
+        LuxEngine::Channels c = LuxEngine::channels(lum & 0xFFFF, lum >> 16);
+        uint32_t centiLux = LuxEngine::centiLuxFromControl(c.full, c.ir, (uint8_t)(tsl.getGain() | tsl.getTiming()));
+        if (centiLux != LuxEngine::OVERFLOW && c.full != 0) {
+            Serial.printf("Light: %lu.%02lu lux (visible %u, IR %u, full %u)\n",
+                          (unsigned long)(centiLux / 100), (unsigned long)(centiLux % 100), c.visible, c.ir, c.full);
         } 
         else 
         {
@@ -34,21 +42,97 @@ public:
         }
     }
 
-    String getLightAsString() {
-        sensors_event_t event;
-        tsl.getEvent(&event);
+    // Polled mode: takes one reading of both raw channels into sample, blocking through the
+    // integration. Does not allocate.
+    bool read(LightSample& sample, uint64_t timestampMs) {
+        uint32_t lum = tsl.getFullLuminosity();
+        uint16_t ir = lum >> 16;
+        uint16_t full = lum & 0xFFFF;
 
-        if (event.light) {
-            return String(event.light, 2) + " lux"; // two decimal places
-        } 
-        else 
-        {
-            return "-- lux";
+        fill(sample, full, ir, (uint8_t)(tsl.getGain() | tsl.getTiming()), timestampMs);
+
+        // The driver powers the sensor up for every read, so a new setting applies cleanly from
+        // the next conversion.
+        if (autoRanging && autoRange.update(full, ir)) applySetting(autoRange.setting());
+        return true;
+    }
+
+    // Interrupt mode: leaves the ALS running continuously with INT raised per conversion or per
+    // threshold crossing (see AlsAcquisition). read() must not be used afterwards, the driver
+    // would power the chip down after every call.
+    bool startInterrupts(AlsAcquisition::Mode mode) {
+        return acquisition.begin(mode, autoRange.setting());
+    }
+
+    bool interruptsEnabled() const { return acquisition.running(); }
+
+    void setThresholdWindow(uint16_t permille, uint8_t persist) { acquisition.setThresholdWindow(permille, persist); }
+
+    // Interrupt mode: services INT (or a timer poll) and runs auto-ranging on any reading.
+    // A reading only becomes a sample (and takes a sequence number) through toSample().
+    AlsAcquisition::Event service(bool interrupted, AlsAcquisition::Reading& reading) {
+        AlsAcquisition::Event event = acquisition.service(interrupted, reading);
+        if ((event == AlsAcquisition::EVENT_CONVERSION || event == AlsAcquisition::EVENT_THRESHOLD)
+            && autoRanging && autoRange.update(reading.full, reading.ir)) {
+            applySetting(autoRange.setting());
         }
+        return event;
+    }
+
+    void toSample(const AlsAcquisition::Reading& reading, LightSample& sample, uint64_t timestampMs) {
+        fill(sample, reading.full, reading.ir, reading.control, timestampMs);
     }
 
+    const AlsAcquisition::Stats& acquisitionStats() const { return acquisition.getStats(); }
+
+    // With auto-ranging off the sensor stays at whatever setting it has now.
+    void setAutoRanging(bool enabled) { autoRanging = enabled; }
+
+    // Minimum CH0 count auto-ranging aims for; higher means finer resolution in the dark at
+    // the cost of longer integration.
+    void setTargetCounts(uint16_t counts) { autoRange.setTarget(counts); }
+
+    uint32_t rangeAdjustments() const { return autoRange.adjustmentCount(); }
+
 private:
+    void fill(LightSample& sample, uint16_t full, uint16_t ir, uint8_t control, uint64_t timestampMs) {
+        sample.sequence = nextSequence++;
+        sample.timestampMs = timestampMs;
+        sample.fullCount = full;
+        sample.irCount = ir;
+        sample.control = control;
+        sample.flags = 0;
+        sample.centiLux = 0;
+
+        // ADC ceiling for the integration time the reading was taken at.
+        uint16_t ceiling = AutoRange::maxCount(control & 0x07);
+        if (full >= ceiling || ir >= ceiling) {
+            sample.flags |= LightSample::FLAG_SATURATED;
+        } else if (full == 0) {
+            sample.flags |= LightSample::FLAG_NO_SIGNAL;
+        } else {
+            LatencyStats::Scope timed(latencyStats, LatencyStats::STAGE_LUX);
+            sample.centiLux = LuxEngine::centiLuxFromControl(full, ir, control);
+        }
+    }
+
+    // AutoRange indices map directly onto the driver's register encodings. In interrupt mode the
+    // change goes through the acquisition state machine so the ALS keeps running.
+    void applySetting(AutoRange::Setting s) {
+        if (acquisition.running()) {
+            acquisition.setSetting(s);
+            return;
+        }
+        tsl.setGain((tsl2591Gain_t)(s.gain << 4));
+        tsl.setTiming((tsl2591IntegrationTime_t)s.time);
+    }
+
     Adafruit_TSL2591 tsl; ///< TSL2591 light sensor instance
+    WireTsl2591Bus bus;
+    AlsAcquisition acquisition;
+    uint32_t nextSequence;
+    AutoRange autoRange;
+    bool autoRanging;
 };
 
 #endif // __LIGHT_SENSOR_H__
\ No newline at end of file
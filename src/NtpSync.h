@@ -0,0 +1,446 @@
+#ifndef __NTP_SYNC_H__
+#define __NTP_SYNC_H__
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include "ByteCodec.h"
+#include "RtcDevice.h"
+
+// Datagram link to an NTP server. Nothing blocks: open() is called repeatedly until the server
+// is reachable (a DNS lookup may be in flight), receive() returns 0 while nothing has arrived.
+// ArduinoNtpTransport uses WiFiUDP; a local stand-in server is used on a host.
+class NtpTransport {
+public:
+    virtual ~NtpTransport() {}
+    virtual bool open() = 0;
+    virtual bool send(const uint8_t* packet, size_t len) = 0;
+    virtual size_t receive(uint8_t* out, size_t capacity) = 0;
+    virtual void close() = 0;
+};
+
+// Keeps the DS3231 on time from NTP in the background, driven from loop() through service().
+//
+// Each sync finds the RTC's second boundary against the monotonic clock (the DS3231 only
+// reports whole seconds), then takes a short burst of SNTP exchanges and keeps the one with
+// the lowest round-trip delay. The resulting offset (NTP minus RTC) is either
+//   - stepped out, when the RTC lost power or is off by more than stepThresholdUs: the new
+//     second is written at the moment NTP time crosses a whole second, or
+//   - slewed out through the aging-offset register, by running the oscillator slightly fast
+//     or slow (at most maxSlewPpm) until the offset is gone.
+// Between syncs the offset change gives the oscillator's own frequency error, with the aging
+// offset in force factored out. It is averaged over days (weighted by interval length) and the
+// aging register is programmed to cancel it, so the RTC stays close even while Wi-Fi is gone.
+//
+// service() does at most one I2C read or one datagram per call and returns how long it can be
+// left alone: a few milliseconds while a sync is in progress, up to the poll interval otherwise.
+class NtpSync {
+public:
+    static constexpr size_t   PACKET_SIZE      = 48;
+    static constexpr uint32_t NTP_UNIX_OFFSET  = 2208988800UL; // 1900-01-01 to 1970-01-01, seconds
+    static constexpr size_t   MAX_LISTENERS    = 2;
+
+    enum State : uint8_t {
+        STATE_IDLE,       // waiting for the next poll or for the network
+        STATE_OPENING,    // waiting for the transport (DNS)
+        STATE_ALIGNING,   // looking for the RTC's next second boundary
+        STATE_EXCHANGING, // SNTP requests in flight
+        STATE_STEPPING,   // waiting for the whole second at which to set the RTC
+    };
+
+    struct Config {
+        uint32_t pollIntervalMs;     // between successful syncs
+        uint32_t retryMinMs;         // after a failed sync, doubling up to the poll interval
+        uint32_t verifyAfterStepMs;  // re-sync this soon after stepping to measure the residual
+        uint32_t openTimeoutMs;
+        uint32_t replyTimeoutMs;     // per request
+        uint32_t alignPollMs;        // RTC read spacing while aligning (the phase resolution)
+        uint8_t  samplesPerSync;
+        uint32_t stepThresholdUs;
+        float    maxSlewPpm;
+        uint32_t slewHorizonS;       // time over which an offset is slewed out, before clamping
+        uint32_t minDriftBaselineS;  // shorter intervals are too noisy to measure frequency
+        uint32_t driftTimeConstantS; // older frequency measurements fade out over this
+    };
+
+    struct Stats {
+        uint32_t syncs;
+        uint32_t failures;
+        uint32_t steps;
+        uint32_t agingWrites;
+        uint32_t requests;
+        uint32_t badReplies;     // wrong origin, kiss-o'-death or unsynchronized server
+        int64_t  lastOffsetUs;   // NTP minus RTC at the last sync
+        uint32_t lastDelayUs;    // round trip of the sample used
+        float    driftPpm;       // oscillator frequency error without aging (positive: fast)
+        int8_t   aging;
+    };
+
+    // Called after every successful sync; stepped is true if the RTC was set.
+    using ListenerFn = void (*)(void* context, int64_t offsetUs, bool stepped);
+
+    NtpSync(NtpTransport& transport_, RtcDevice& rtc_)
+        : transport(transport_), rtc(rtc_), current(STATE_IDLE), syncRequested(true), nextPollUs(0), retryMs(0),
+          stateSinceUs(0), alignSeconds(0), alignReadUs(0), edgeSeconds(0), edgeUs(0), attempts(0), haveBest(false),
+          bestOffsetUs(0), bestDelayUs(0), bestServerUs(0), sentRtcUs(0), sentUs(0), stepSeconds(0), stepAtUs(0),
+          haveBaseline(false), baselineOffsetUs(0), baselineServerUs(0), driftWeightS(0), driftWeighted(0),
+          agingKnown(false), listenerCount(0), stats() {
+        config.pollIntervalMs = 3600000;
+        config.retryMinMs = 30000;
+        config.verifyAfterStepMs = 60000;
+        config.openTimeoutMs = 10000;
+        config.replyTimeoutMs = 1500;
+        config.alignPollMs = 10;
+        config.samplesPerSync = 4;
+        config.stepThresholdUs = 250000;
+        config.maxSlewPpm = 5.0f;
+        config.slewHorizonS = 21600;
+        config.minDriftBaselineS = 1800;
+        config.driftTimeConstantS = 172800;
+        retryMs = config.retryMinMs;
+    }
+
+    void setConfig(const Config& c) {
+        config = c;
+        if (config.samplesPerSync == 0) config.samplesPerSync = 1;
+        retryMs = config.retryMinMs;
+    }
+
+    // Syncs at the next service() with the network up, e.g. as soon as Wi-Fi connects.
+    void requestSync() {
+        syncRequested = true;
+    }
+
+    bool addListener(ListenerFn fn, void* context = nullptr) {
+        if (listenerCount >= MAX_LISTENERS) return false;
+        listeners[listenerCount].fn = fn;
+        listeners[listenerCount].context = context;
+        listenerCount++;
+        return true;
+    }
+
+    // Advances the sync. nowUs is the monotonic clock (esp_timer). Returns the number of
+    // milliseconds until it next needs to run.
+    uint32_t service(uint64_t nowUs, bool networkUp) {
+        if (current != STATE_IDLE && current != STATE_STEPPING && !networkUp) {
+            fail(nowUs); // the link went away mid-sync
+        }
+        switch (current) {
+            case STATE_IDLE:
+                if (!networkUp) return config.pollIntervalMs;
+                if (!syncRequested && (int64_t)(nowUs - nextPollUs) < 0) return untilMs(nowUs, nextPollUs);
+                syncRequested = false;
+                enter(STATE_OPENING, nowUs);
+                [[fallthrough]];
+            case STATE_OPENING:
+                if (transport.open()) {
+                    enter(STATE_ALIGNING, nowUs);
+                    alignReadUs = 0;
+                    return 0;
+                }
+                if (elapsedMs(nowUs) >= config.openTimeoutMs) fail(nowUs);
+                return config.alignPollMs;
+            case STATE_ALIGNING:
+                return align(nowUs);
+            case STATE_EXCHANGING:
+                return exchange(nowUs);
+            case STATE_STEPPING:
+                if ((int64_t)(nowUs - stepAtUs) < 0) return untilMs(nowUs, stepAtUs);
+                step(nowUs);
+                return untilMs(nowUs, nextPollUs);
+        }
+        return config.alignPollMs;
+    }
+
+    State state() const { return current; }
+    bool synced() const { return stats.syncs > 0; }
+    const Stats& getStats() const { return stats; }
+
+    static const char* stateName(State s) {
+        switch (s) {
+            case STATE_IDLE:       return "idle";
+            case STATE_OPENING:    return "opening";
+            case STATE_ALIGNING:   return "aligning";
+            case STATE_EXCHANGING: return "exchanging";
+            case STATE_STEPPING:   return "stepping";
+        }
+        return "?";
+    }
+
+    // --- SNTP (RFC 4330) packet helpers ---
+
+    // Client request carrying originUs (Unix microseconds) as its transmit timestamp; the
+    // server echoes it back as the originate timestamp.
+    static void encodeRequest(int64_t originUs, uint8_t* out) {
+        memset(out, 0, PACKET_SIZE);
+        out[0] = (0 << 6) | (4 << 3) | 3; // LI 0, version 4, mode 3 (client)
+        putTimestamp(out + 40, originUs);
+    }
+
+    struct Reply {
+        int64_t originUs;   // T1, echoed
+        int64_t receiveUs;  // T2, server clock
+        int64_t transmitUs; // T3, server clock
+        uint8_t stratum;
+    };
+
+    // False for anything that is not a usable server reply: wrong mode, kiss-o'-death
+    // (stratum 0) or an unsynchronized server (leap indicator 3).
+    static bool decodeReply(const uint8_t* in, size_t len, Reply& out) {
+        if (len < PACKET_SIZE) return false;
+        uint8_t leap = in[0] >> 6;
+        uint8_t mode = in[0] & 0x07;
+        if (mode != 4 || leap == 3 || in[1] == 0 || in[1] > 15) return false;
+        out.stratum = in[1];
+        out.originUs = getTimestamp(in + 24);
+        out.receiveUs = getTimestamp(in + 32);
+        out.transmitUs = getTimestamp(in + 40);
+        return out.transmitUs != 0;
+    }
+
+    static void putTimestamp(uint8_t* p, int64_t unixUs) {
+        uint64_t seconds = (uint64_t)(unixUs / 1000000) + NTP_UNIX_OFFSET;
+        uint64_t micros = (uint64_t)(unixUs % 1000000);
+        putBe32(p, (uint32_t)seconds);
+        putBe32(p + 4, (uint32_t)((micros << 32) / 1000000));
+    }
+
+    // NTP era 0 ends in 2036; seconds with the top bit clear are taken to be in era 1.
+    static int64_t getTimestamp(const uint8_t* p) {
+        uint64_t seconds = getBe32(p);
+        uint64_t fraction = getBe32(p + 4);
+        if (seconds == 0 && fraction == 0) return 0;
+        if ((seconds & 0x80000000UL) == 0) seconds += 0x100000000ULL;
+        return (int64_t)(seconds - NTP_UNIX_OFFSET) * 1000000 + (int64_t)((fraction * 1000000) >> 32);
+    }
+
+private:
+    struct Listener {
+        ListenerFn fn;
+        void* context;
+    };
+
+    void enter(State s, uint64_t nowUs) {
+        current = s;
+        stateSinceUs = nowUs;
+    }
+
+    uint32_t elapsedMs(uint64_t nowUs) const { return (uint32_t)((nowUs - stateSinceUs) / 1000); }
+
+    static uint32_t untilMs(uint64_t nowUs, uint64_t atUs) {
+        if ((int64_t)(atUs - nowUs) <= 0) return 0;
+        uint64_t ms = (atUs - nowUs + 999) / 1000;
+        return ms > UINT32_MAX ? UINT32_MAX : (uint32_t)ms;
+    }
+
+    // RTC time in microseconds at monotonic time nowUs, from the last second boundary seen.
+    int64_t rtcUsAt(uint64_t nowUs) const {
+        return (int64_t)edgeSeconds * 1000000 + (int64_t)(nowUs - edgeUs);
+    }
+
+    // Reads the RTC every alignPollMs until the seconds change; the boundary is taken halfway
+    // between the last read of the old second and the first read of the new one.
+    uint32_t align(uint64_t nowUs) {
+        uint32_t seconds;
+        if (!rtc.readSeconds(seconds)) {
+            fail(nowUs);
+            return untilMs(nowUs, nextPollUs);
+        }
+        if (alignReadUs != 0 && seconds != alignSeconds) {
+            edgeSeconds = seconds;
+            edgeUs = alignReadUs + (nowUs - alignReadUs) / 2;
+            attempts = 0;
+            haveBest = false;
+            enter(STATE_EXCHANGING, nowUs);
+            sentUs = 0;
+            return exchange(nowUs);
+        }
+        alignSeconds = seconds;
+        alignReadUs = nowUs;
+        if (elapsedMs(nowUs) > 2000 + config.alignPollMs) fail(nowUs); // the RTC is not ticking
+        return config.alignPollMs;
+    }
+
+    uint32_t exchange(uint64_t nowUs) {
+        if (sentUs == 0) {
+            if (attempts >= config.samplesPerSync) {
+                finish(nowUs);
+                return untilMs(nowUs, current == STATE_STEPPING ? stepAtUs : nextPollUs);
+            }
+            sentRtcUs = rtcUsAt(nowUs);
+            encodeRequest(sentRtcUs, packet);
+            memcpy(sentStamp, packet + 40, sizeof(sentStamp));
+            attempts++;
+            stats.requests++;
+            if (!transport.send(packet, PACKET_SIZE)) return config.alignPollMs; // counts as lost
+            sentUs = nowUs;
+            return config.alignPollMs;
+        }
+
+        size_t len;
+        while ((len = transport.receive(packet, sizeof(packet))) > 0) {
+            Reply reply;
+            // Anything but the answer to the request in flight (late replies, forgeries) is ignored.
+            if (!decodeReply(packet, len, reply) || memcmp(packet + 24, sentStamp, sizeof(sentStamp)) != 0) {
+                stats.badReplies++;
+                continue;
+            }
+            int64_t t1 = sentRtcUs;
+            int64_t t4 = rtcUsAt(nowUs);
+            int64_t offset = ((reply.receiveUs - t1) + (reply.transmitUs - t4)) / 2;
+            int64_t delay = (t4 - t1) - (reply.transmitUs - reply.receiveUs);
+            if (delay < 0) delay = 0;
+            if (!haveBest || delay < bestDelayUs) {
+                haveBest = true;
+                bestOffsetUs = offset;
+                bestDelayUs = delay;
+                bestServerUs = t4 + offset;
+            }
+            sentUs = 0;
+            return 0;
+        }
+        if (elapsedSince(nowUs, sentUs) >= config.replyTimeoutMs) sentUs = 0; // lost; try the next one
+        return config.alignPollMs;
+    }
+
+    static uint32_t elapsedSince(uint64_t nowUs, uint64_t thenUs) { return (uint32_t)((nowUs - thenUs) / 1000); }
+
+    void finish(uint64_t nowUs) {
+        transport.close();
+        if (!haveBest) {
+            fail(nowUs);
+            return;
+        }
+        if (!agingKnown) {
+            int8_t aging;
+            agingKnown = rtc.readAging(aging);
+            stats.aging = agingKnown ? aging : 0;
+        }
+        stats.lastOffsetUs = bestOffsetUs;
+        stats.lastDelayUs = (uint32_t)bestDelayUs;
+        retryMs = config.retryMinMs;
+
+        int64_t magnitude = bestOffsetUs < 0 ? -bestOffsetUs : bestOffsetUs;
+        if (rtc.lostPower() || magnitude > (int64_t)config.stepThresholdUs) {
+            // Set the RTC at the next whole NTP second at least 100 ms out, so the write lands
+            // on a boundary of the new timescale.
+            int64_t trueUs = rtcUsAt(nowUs) + bestOffsetUs;
+            int64_t target = (trueUs / 1000000 + 1) * 1000000;
+            if (target - trueUs < 100000) target += 1000000;
+            stepSeconds = (uint32_t)(target / 1000000);
+            stepAtUs = nowUs + (uint64_t)(target - trueUs);
+            enter(STATE_STEPPING, nowUs);
+            return;
+        }
+
+        updateDrift();
+        discipline();
+        nextPollUs = nowUs + (uint64_t)config.pollIntervalMs * 1000;
+        enter(STATE_IDLE, nowUs);
+        stats.syncs++;
+        notify(bestOffsetUs, false);
+    }
+
+    void step(uint64_t nowUs) {
+        if (!rtc.writeSeconds(stepSeconds)) {
+            fail(nowUs);
+            return;
+        }
+        stats.steps++;
+        stats.syncs++;
+        // The interval across a step says nothing about frequency: start a new baseline, and
+        // come back soon to measure what is left and start the frequency measurement.
+        haveBaseline = false;
+        nextPollUs = nowUs + (uint64_t)config.verifyAfterStepMs * 1000;
+        enter(STATE_IDLE, nowUs);
+        notify(bestOffsetUs, true);
+    }
+
+    // Frequency error over the interval since the baseline sync, corrected for the aging offset
+    // that was in force. Offsets shrink when the RTC runs fast.
+    void updateDrift() {
+        if (haveBaseline) {
+            float intervalS = (float)(bestServerUs - baselineServerUs) / 1e6f;
+            if (intervalS < (float)config.minDriftBaselineS) return; // keep the older, longer baseline
+            float measured = -(float)(bestOffsetUs - baselineOffsetUs) / intervalS; // us per s = ppm
+            float natural = measured + RtcDevice::AGING_PPM_PER_STEP * stats.aging;
+            float keep = 1.0f / (1.0f + intervalS / (float)config.driftTimeConstantS);
+            driftWeightS = driftWeightS * keep + intervalS;
+            driftWeighted = driftWeighted * keep + natural * intervalS;
+            stats.driftPpm = driftWeighted / driftWeightS;
+        }
+        haveBaseline = true;
+        baselineOffsetUs = bestOffsetUs;
+        baselineServerUs = bestServerUs;
+    }
+
+    // Aging offset that cancels the measured frequency error and adds a bounded slew toward
+    // zero offset. Until there is a frequency measurement the current aging is assumed right.
+    void discipline() {
+        float slew = (float)bestOffsetUs / (float)config.slewHorizonS; // ppm; positive: run fast
+        if (slew > config.maxSlewPpm) slew = config.maxSlewPpm;
+        if (slew < -config.maxSlewPpm) slew = -config.maxSlewPpm;
+        float natural = driftWeightS > 0 ? stats.driftPpm : RtcDevice::AGING_PPM_PER_STEP * stats.aging;
+        float target = (natural - slew) / RtcDevice::AGING_PPM_PER_STEP;
+        int aging = (int)(target < 0 ? target - 0.5f : target + 0.5f);
+        if (aging > 127) aging = 127;
+        if (aging < -128) aging = -128;
+        if (aging == stats.aging) return;
+        if (rtc.writeAging((int8_t)aging)) {
+            stats.aging = (int8_t)aging;
+            stats.agingWrites++;
+        }
+    }
+
+    void fail(uint64_t nowUs) {
+        transport.close();
+        stats.failures++;
+        nextPollUs = nowUs + (uint64_t)retryMs * 1000;
+        retryMs = retryMs >= config.pollIntervalMs / 2 ? config.pollIntervalMs : retryMs * 2;
+        enter(STATE_IDLE, nowUs);
+    }
+
+    void notify(int64_t offsetUs, bool stepped) {
+        for (size_t i = 0; i < listenerCount; i++) listeners[i].fn(listeners[i].context, offsetUs, stepped);
+    }
+
+    NtpTransport& transport;
+    RtcDevice& rtc;
+    Config config;
+    State current;
+    volatile bool syncRequested;
+    uint64_t nextPollUs;
+    uint32_t retryMs;
+    uint64_t stateSinceUs;
+
+    uint32_t alignSeconds;
+    uint64_t alignReadUs;
+    uint32_t edgeSeconds;
+    uint64_t edgeUs;
+
+    uint8_t packet[PACKET_SIZE];
+    uint8_t attempts;
+    bool haveBest;
+    int64_t bestOffsetUs;
+    int64_t bestDelayUs;
+    int64_t bestServerUs;   // NTP time of the best sample
+    int64_t sentRtcUs;
+    uint8_t sentStamp[8];   // transmit timestamp as sent, echoed back as the origin
+    uint64_t sentUs;        // 0: no request in flight
+
+    uint32_t stepSeconds;
+    uint64_t stepAtUs;
+
+    bool haveBaseline;
+    int64_t baselineOffsetUs;
+    int64_t baselineServerUs;
+    float driftWeightS;
+    float driftWeighted;
+    bool agingKnown;
+
+    Listener listeners[MAX_LISTENERS];
+    size_t listenerCount;
+    Stats stats;
+};
+
+#endif // __NTP_SYNC_H__
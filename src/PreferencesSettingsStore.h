@@ -0,0 +1,56 @@
+#ifndef __PREFERENCES_SETTINGS_STORE_H__
+#define __PREFERENCES_SETTINGS_STORE_H__
+
+#include <Arduino.h>
+#include <Preferences.h>
+#include "LatencyStats.h"
+#include "Settings.h"
+
+// SettingsStore in NVS: the whole blob is one key, so a commit is a single NVS write.
+class PreferencesSettingsStore : public SettingsStore {
+public:
+    static constexpr const char* NAMESPACE = "sensorSettings";
+    static constexpr const char* BLOB_KEY  = "blob";
+
+    size_t read(uint8_t* out, size_t capacity) override {
+        if (!preferences.begin(NAMESPACE, true)) return 0;
+        size_t len = preferences.getBytesLength(BLOB_KEY);
+        if (len > capacity) len = 0;
+        if (len > 0) len = preferences.getBytes(BLOB_KEY, out, len);
+        preferences.end();
+        return len;
+    }
+
+    bool write(const uint8_t* data, size_t len) override {
+        LatencyStats::Scope timed(latencyStats, LatencyStats::STAGE_SETTINGS_WRITE);
+        bool ok = preferences.begin(NAMESPACE, false);
+        if (ok) {
+            ok = preferences.putBytes(BLOB_KEY, data, len) == len;
+            preferences.end();
+        }
+        if (!ok) latencyStats.fail(LatencyStats::STAGE_SETTINGS_WRITE);
+        return ok;
+    }
+
+    // Keys written by the per-field SettingsManager before the blob existed.
+    bool readLegacy(SensorSettings& out) override {
+        if (!preferences.begin(NAMESPACE, true)) return false;
+        bool found = preferences.isKey("sensorName") || preferences.isKey("updateInterval") ||
+                     preferences.isKey("wifiEnabled") || preferences.isKey("wifiSSIDAndPassword");
+        if (found) {
+            String name = preferences.getString("sensorName", out.sensorName);
+            String creds = preferences.getString("wifiSSIDAndPassword", "");
+            strlcpy(out.sensorName, name.c_str(), sizeof(out.sensorName));
+            strlcpy(out.pWifiSSIDCharAndPassword, creds.c_str(), sizeof(out.pWifiSSIDCharAndPassword));
+            out.updateInterval = preferences.getInt("updateInterval", out.updateInterval);
+            out.wifiEnabled = preferences.getBool("wifiEnabled", true);
+        }
+        preferences.end();
+        return found;
+    }
+
+private:
+    Preferences preferences;
+};
+
+#endif // __PREFERENCES_SETTINGS_STORE_H__
@@ -0,0 +1,164 @@
+#ifndef __PUBLISH_POLICY_H__
+#define __PUBLISH_POLICY_H__
+
+#include <stddef.h>
+#include <stdint.h>
+#include "LightSample.h"
+
+// Decides when a notifying characteristic actually goes on air, per subscribed connection.
+//  - Nothing is queued while nobody is subscribed.
+//  - A new value within the deadband of what a connection last received is dropped
+//    (|delta| <= max(absolute, relative * last)), unless maxSilenceUs has passed since the last
+//    notification to that connection, or the sample's flags changed.
+//  - Each connection is notified at most once per connection interval (or minIntervalUs if
+//    larger); values offered in between replace the pending one (latest wins).
+// Pure logic with no BLE dependencies: the caller supplies the send function and the clock.
+class PublishPolicy {
+public:
+    static constexpr size_t   MAX_CONNECTIONS = 4;
+    static constexpr uint16_t NO_CONNECTION   = 0xFFFF;
+
+    struct Config {
+        uint32_t absoluteCentiLux;  // absolute deadband, lux * 100
+        uint16_t relativePermille;  // relative deadband, 1/1000 of the last sent value
+        uint32_t minIntervalUs;     // floor on the per-connection notification spacing
+        uint64_t maxSilenceUs;      // resend even inside the deadband after this long (0 = never)
+    };
+
+    struct Stats {
+        uint32_t offered;               // values handed to offer()
+        uint32_t sent;                  // notifications that went out (summed over connections)
+        uint32_t suppressedNoSubscriber;
+        uint32_t suppressedDeadband;    // per connection
+        uint32_t coalesced;             // pending values replaced by a newer one before sending
+        uint32_t sendFailures;
+    };
+
+    PublishPolicy() : stats() {
+        config.absoluteCentiLux = 5;
+        config.relativePermille = 10;
+        config.minIntervalUs = 0;
+        config.maxSilenceUs = 30000000ULL;
+        for (size_t i = 0; i < MAX_CONNECTIONS; i++) clearSlot(slots[i]);
+    }
+
+    void setConfig(const Config& c) { config = c; }
+    const Config& getConfig() const { return config; }
+
+    // connIntervalUs is the negotiated connection interval of that link.
+    void subscribe(uint16_t conn, bool subscribed, uint32_t connIntervalUs) {
+        Slot* s = find(conn);
+        if (!subscribed) {
+            if (s) clearSlot(*s);
+            return;
+        }
+        if (!s) s = find(NO_CONNECTION);
+        if (!s) return; // more subscribers than we track; they still get the value on read
+        if (s->conn != conn) {
+            clearSlot(*s);
+            s->conn = conn;
+        }
+        s->intervalUs = connIntervalUs;
+    }
+
+    void updateInterval(uint16_t conn, uint32_t connIntervalUs) {
+        Slot* s = find(conn);
+        if (s) s->intervalUs = connIntervalUs;
+    }
+
+    void disconnect(uint16_t conn) {
+        Slot* s = find(conn);
+        if (s) clearSlot(*s);
+    }
+
+    bool hasSubscribers() const {
+        for (size_t i = 0; i < MAX_CONNECTIONS; i++) if (slots[i].conn != NO_CONNECTION) return true;
+        return false;
+    }
+
+    void offer(const LightSample& sample, uint64_t nowUs) {
+        stats.offered++;
+        if (!hasSubscribers()) {
+            stats.suppressedNoSubscriber++;
+            return;
+        }
+        for (size_t i = 0; i < MAX_CONNECTIONS; i++) {
+            Slot& s = slots[i];
+            if (s.conn == NO_CONNECTION) continue;
+            if (s.hasLast && withinDeadband(s.last, sample) && !silenceExpired(s, nowUs)) {
+                if (s.hasPending) stats.coalesced++;
+                s.hasPending = false;
+                stats.suppressedDeadband++;
+                continue;
+            }
+            if (s.hasPending) stats.coalesced++;
+            s.pending = sample;
+            s.hasPending = true;
+        }
+    }
+
+    // Sends the pending value to every connection whose interval has elapsed.
+    // send(conn, sample) returns false if the stack could not queue it; it is retried next time.
+    template <typename SendFn>
+    void flush(uint64_t nowUs, SendFn send) {
+        for (size_t i = 0; i < MAX_CONNECTIONS; i++) {
+            Slot& s = slots[i];
+            if (s.conn == NO_CONNECTION || !s.hasPending) continue;
+            uint64_t spacing = s.intervalUs > config.minIntervalUs ? s.intervalUs : config.minIntervalUs;
+            if (s.hasLast && nowUs - s.lastSentUs < spacing) continue;
+            if (!send(s.conn, s.pending)) {
+                stats.sendFailures++;
+                continue;
+            }
+            s.last = s.pending;
+            s.hasLast = true;
+            s.hasPending = false;
+            s.lastSentUs = nowUs;
+            stats.sent++;
+        }
+    }
+
+    const Stats& getStats() const { return stats; }
+
+private:
+    struct Slot {
+        uint16_t conn;
+        uint32_t intervalUs;
+        bool hasLast;
+        bool hasPending;
+        uint64_t lastSentUs;
+        LightSample last;
+        LightSample pending;
+    };
+
+    static void clearSlot(Slot& s) {
+        s.conn = NO_CONNECTION;
+        s.intervalUs = 0;
+        s.hasLast = false;
+        s.hasPending = false;
+        s.lastSentUs = 0;
+    }
+
+    Slot* find(uint16_t conn) {
+        for (size_t i = 0; i < MAX_CONNECTIONS; i++) if (slots[i].conn == conn) return &slots[i];
+        return nullptr;
+    }
+
+    bool withinDeadband(const LightSample& last, const LightSample& next) const {
+        if (last.flags != next.flags) return false;
+        uint32_t delta = next.centiLux > last.centiLux ? next.centiLux - last.centiLux : last.centiLux - next.centiLux;
+        uint32_t relative = (uint32_t)((uint64_t)last.centiLux * config.relativePermille / 1000);
+        uint32_t band = relative > config.absoluteCentiLux ? relative : config.absoluteCentiLux;
+        return delta <= band;
+    }
+
+    bool silenceExpired(const Slot& s, uint64_t nowUs) const {
+        return config.maxSilenceUs != 0 && nowUs - s.lastSentUs >= config.maxSilenceUs;
+    }
+
+    Config config;
+    Slot slots[MAX_CONNECTIONS];
+    Stats stats;
+};
+
+#endif // __PUBLISH_POLICY_H__
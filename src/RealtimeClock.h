@@ -2,14 +2,15 @@
 #define __REALTIME_CLOCK_H__
 #include <Arduino.h>
 #include <RTClib.h>
-#include <NTPClient.h>
+#include <Wire.h>
 
-#include "WifiNetwork.h"
-#include <WiFiUdp.h>
+#include "RtcDevice.h"
 
-class RealtimeClock {
+// DS3231 on the default I2C bus. Setting the time and trimming the oscillator is left to
+// NtpSync, which uses the RtcDevice side of this class.
+class RealtimeClock : public RtcDevice {
 public:
-    RealtimeClock(WifiNetwork &wifiNetwork_) : rtc(RTC_DS3231()), wifiNetwork(wifiNetwork_) {}
+    RealtimeClock() : rtc(RTC_DS3231()) {}
 
     bool begin() {
         bool result = rtc.begin();
@@ -18,12 +19,12 @@ public:
         } 
         else {
             Serial.println("RealtimeClock initialized successfully.");
-            adjustClockIfPowerLost();
+            if (lostPower()) Serial.println("RTC lost power; the time will be set from NTP once Wi-Fi connects.");
         }
         return result;
     }
 
-    bool lostPower() {
+    bool lostPower() override {
         return rtc.lostPower();
     }
 
@@ -34,6 +35,11 @@ public:
     DateTime now() {
         return rtc.now();
     }
+
+    // 1 Hz on SQW/INT (open drain; the falling edge is the seconds rollover), for Timebase.
+    void enableSquareWave() {
+        rtc.writeSqwPinMode(DS3231_SquareWave1Hz);
+    }
     String timestamp(DateTime::timestampOpt opt = DateTime::TIMESTAMP_FULL) {
         return rtc.now().timestamp(opt);
     }
@@ -50,32 +56,63 @@ public:
         return String(hour12) + ":" + minuteStr + " " + meridian;
     }
 
+    // --- RtcDevice ---
 
-private:
-    void adjustClockIfPowerLost() {
-        if (lostPower()) {
-            Serial.println("RTC lost power, adjusting time from NTP...");
-            if (wifiNetwork.isConnected()) {
-                // Use NTP to get the current time
-                WiFiUDP ntpUDP;
-                NTPClient timeClient(ntpUDP, "pool.ntp.org", 0, 60000);
-                timeClient.begin();
-                if (timeClient.forceUpdate()) {
-                    DateTime ntpTime = DateTime(timeClient.getEpochTime());
-                    adjust(ntpTime);
-                    Serial.print("RTC adjusted to: ");
-                    Serial.println(ntpTime.timestamp());
-                } else {
-                    Serial.println("Failed to update RTC from NTP.");
-                }
-            } else {
-                Serial.println("Wi-Fi not connected, cannot adjust RTC.");
-            }
+    bool readSeconds(uint32_t& epoch) override {
+        epoch = rtc.now().unixtime();
+        return true;
+    }
+
+    // adjust() writes the seconds register first, which restarts the 1 Hz countdown, and clears
+    // the oscillator-stop flag.
+    bool writeSeconds(uint32_t epoch) override {
+        rtc.adjust(DateTime(epoch));
+        return true;
+    }
+
+    bool readAging(int8_t& aging) override {
+        uint8_t value;
+        if (!readRegister(REG_AGING, value)) return false;
+        aging = (int8_t)value;
+        return true;
+    }
+
+    // A new aging offset only reaches the oscillator at the next temperature conversion, so
+    // one is started right away unless the chip is already busy with one.
+    bool writeAging(int8_t aging) override {
+        if (!writeRegister(REG_AGING, (uint8_t)aging)) return false;
+        uint8_t status, control;
+        if (readRegister(REG_STATUS, status) && !(status & STATUS_BSY) && readRegister(REG_CONTROL, control)) {
+            writeRegister(REG_CONTROL, control | CONTROL_CONV);
         }
+        return true;
+    }
+
+private:
+    static constexpr uint8_t ADDRESS      = 0x68;
+    static constexpr uint8_t REG_CONTROL  = 0x0E;
+    static constexpr uint8_t REG_STATUS   = 0x0F;
+    static constexpr uint8_t REG_AGING    = 0x10;
+    static constexpr uint8_t CONTROL_CONV = 0x20;
+    static constexpr uint8_t STATUS_BSY   = 0x04;
+
+    static bool readRegister(uint8_t reg, uint8_t& value) {
+        Wire.beginTransmission(ADDRESS);
+        Wire.write(reg);
+        if (Wire.endTransmission(false) != 0) return false;
+        if (Wire.requestFrom(ADDRESS, (uint8_t)1) != 1) return false;
+        value = Wire.read();
+        return true;
+    }
+
+    static bool writeRegister(uint8_t reg, uint8_t value) {
+        Wire.beginTransmission(ADDRESS);
+        Wire.write(reg);
+        Wire.write(value);
+        return Wire.endTransmission() == 0;
     }
-    RTC_DS3231 rtc;
-    WifiNetwork &wifiNetwork;
 
+    RTC_DS3231 rtc;
 };
 
 #endif // __REALTIME_CLOCK_H__
\ No newline at end of file
@@ -0,0 +1,29 @@
+#ifndef __RTC_DEVICE_H__
+#define __RTC_DEVICE_H__
+
+#include <stdint.h>
+
+// The DS3231 operations clock discipline needs. RealtimeClock implements them over I2C; a
+// simulated DS3231 with configurable drift stands in on a host.
+class RtcDevice {
+public:
+    // One aging-offset step, in ppm of frequency (datasheet typical at 25 C). Positive values
+    // slow the oscillator down.
+    static constexpr float AGING_PPM_PER_STEP = 0.1f;
+
+    virtual ~RtcDevice() {}
+
+    // Whole seconds since the Unix epoch.
+    virtual bool readSeconds(uint32_t& epoch) = 0;
+    // Sets the time. Writing the seconds register also restarts the 1 Hz countdown, so the new
+    // second starts at the moment of the write. Clears the power-lost flag.
+    virtual bool writeSeconds(uint32_t epoch) = 0;
+
+    virtual bool readAging(int8_t& aging) = 0;
+    virtual bool writeAging(int8_t aging) = 0;
+
+    // The oscillator stopped at some point (battery removed or flat): the time is not valid.
+    virtual bool lostPower() = 0;
+};
+
+#endif // __RTC_DEVICE_H__
@@ -0,0 +1,156 @@
+#ifndef __SAMPLE_CODEC_H__
+#define __SAMPLE_CODEC_H__
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include "LightSample.h"
+#include "LuxEngine.h"
+
+// Compact streaming encoding of a LightSample series, used for SD log blocks and history
+// transfer packets. A chunk (one block, one packet) starts from a reset state, so every chunk
+// decodes on its own. Each record is:
+//   varint  zigzag(timestamp delta-of-delta) << 2 | luxExplicit << 1 | metaChanged
+//   [u8 flags, u8 control]          if metaChanged (always on the first record of a chunk)
+//   [varint zigzag(lux delta)]      if luxExplicit
+//   varint  zigzag(CH0 delta)
+//   varint  zigzag(CH1 delta)
+// Lux is normally not stored at all: LightSensor derives it from the channels and CONTROL
+// through LuxEngine, so the decoder recomputes it and only readings that disagree carry it.
+// A steadily sampled, slowly changing series costs 3-5 bytes per record against 16 raw.
+// The sequence number is not encoded; chunks carry the first one and records are consecutive.
+class SampleCodec {
+public:
+    static constexpr size_t MAX_RECORD_SIZE = 23; // 10 + 2 + 5 + 3 + 3
+    static constexpr size_t MIN_RECORD_SIZE = 3;
+
+    // What LightSensor reports as lux for these counts (0 when saturated).
+    static uint32_t predictedCentiLux(const LightSample& s) {
+        if (s.flags & LightSample::FLAG_SATURATED) return 0;
+        return LuxEngine::centiLuxFromControl(s.fullCount, s.irCount, s.control);
+    }
+
+    class Encoder {
+    public:
+        Encoder() { reset(); }
+
+        void reset() {
+            memset(&prev, 0, sizeof(prev));
+            prevDelta = 0;
+            first = true;
+        }
+
+        // Appends s to out. Returns the bytes written, or 0 (state unchanged) if it doesn't fit.
+        size_t encode(const LightSample& s, uint8_t* out, size_t outLen) {
+            uint8_t tmp[MAX_RECORD_SIZE];
+            size_t n = 0;
+            int64_t delta = (int64_t)(s.timestampMs - prev.timestampMs);
+            bool meta = first || s.flags != prev.flags || s.control != prev.control;
+            bool lux = s.centiLux != predictedCentiLux(s);
+
+            n += putVarint(tmp + n, (zigzag(delta - prevDelta) << 2) | ((uint64_t)lux << 1) | (uint64_t)meta);
+            if (meta) {
+                tmp[n++] = s.flags;
+                tmp[n++] = s.control;
+            }
+            if (lux) n += putVarint(tmp + n, zigzag((int64_t)s.centiLux - (int64_t)prev.centiLux));
+            n += putVarint(tmp + n, zigzag((int64_t)s.fullCount - (int64_t)prev.fullCount));
+            n += putVarint(tmp + n, zigzag((int64_t)s.irCount - (int64_t)prev.irCount));
+            if (n > outLen) return 0;
+
+            memcpy(out, tmp, n);
+            prevDelta = first ? 0 : delta;
+            prev = s;
+            first = false;
+            return n;
+        }
+
+    private:
+        LightSample prev;
+        int64_t prevDelta;
+        bool first;
+    };
+
+    class Decoder {
+    public:
+        Decoder() { reset(); }
+
+        void reset() {
+            memset(&prev, 0, sizeof(prev));
+            prevDelta = 0;
+            first = true;
+        }
+
+        // Reads one record into s (sequence is left to the caller). Returns the bytes consumed,
+        // or 0 if the input is truncated or malformed.
+        size_t decode(const uint8_t* in, size_t inLen, LightSample& s) {
+            size_t n = 0, used;
+            uint64_t tag;
+            if (!(used = getVarint(in + n, inLen - n, tag))) return 0;
+            n += used;
+            bool meta = tag & 1;
+            bool lux = tag & 2;
+            if (first && !meta) return 0;
+
+            LightSample next = prev;
+            int64_t delta = prevDelta + unzigzag(tag >> 2);
+            next.timestampMs = prev.timestampMs + (uint64_t)delta;
+            if (meta) {
+                if (inLen - n < 2) return 0;
+                next.flags = in[n++];
+                next.control = in[n++];
+            }
+            uint64_t v;
+            int64_t luxDelta = 0;
+            if (lux) {
+                if (!(used = getVarint(in + n, inLen - n, v))) return 0;
+                n += used;
+                luxDelta = unzigzag(v);
+            }
+            if (!(used = getVarint(in + n, inLen - n, v))) return 0;
+            n += used;
+            next.fullCount = (uint16_t)(prev.fullCount + unzigzag(v));
+            if (!(used = getVarint(in + n, inLen - n, v))) return 0;
+            n += used;
+            next.irCount = (uint16_t)(prev.irCount + unzigzag(v));
+            next.centiLux = lux ? (uint32_t)((int64_t)prev.centiLux + luxDelta) : predictedCentiLux(next);
+
+            prevDelta = first ? 0 : delta;
+            prev = next;
+            first = false;
+            uint32_t sequence = s.sequence;
+            s = next;
+            s.sequence = sequence;
+            return n;
+        }
+
+    private:
+        LightSample prev;
+        int64_t prevDelta;
+        bool first;
+    };
+
+    static uint64_t zigzag(int64_t v) { return ((uint64_t)v << 1) ^ (uint64_t)(v >> 63); }
+    static int64_t unzigzag(uint64_t v) { return (int64_t)(v >> 1) ^ -(int64_t)(v & 1); }
+
+    static size_t putVarint(uint8_t* out, uint64_t v) {
+        size_t n = 0;
+        while (v >= 0x80) {
+            out[n++] = (uint8_t)(v | 0x80);
+            v >>= 7;
+        }
+        out[n++] = (uint8_t)v;
+        return n;
+    }
+
+    static size_t getVarint(const uint8_t* in, size_t inLen, uint64_t& v) {
+        v = 0;
+        for (size_t i = 0; i < inLen && i < 10; i++) {
+            v |= (uint64_t)(in[i] & 0x7F) << (7 * i);
+            if (!(in[i] & 0x80)) return i + 1;
+        }
+        return 0;
+    }
+};
+
+#endif // __SAMPLE_CODEC_H__
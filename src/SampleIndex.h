@@ -0,0 +1,183 @@
+#ifndef __SAMPLE_INDEX_H__
+#define __SAMPLE_INDEX_H__
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include "BlockFile.h"
+#include "ByteCodec.h"
+#include "Crc32.h"
+
+// Sparse time index over one day file of the sample log ("YYYYMMDD.idx").
+// Entry i holds the time of the first record of data block i, as milliseconds since the start
+// of the day, so a whole day of 1 Hz samples (~2900 data blocks) indexes into ~24 index blocks.
+// Lookups binary-search the index blocks, then the entries of one block, and land on the data
+// block to start reading from: a handful of sector reads regardless of how much is logged.
+//
+// Index block layout (little-endian):
+//   0  u32 magic "PIQX"      8  u16 entry count
+//   4  u32 day               10 u16 reserved
+//   12 u32 CRC-32 of bytes 0..11 and 16..511
+//   16 u32 entries[124]
+class SampleIndex {
+public:
+    static constexpr size_t   BLOCK_SIZE        = BlockFile::BLOCK_SIZE;
+    static constexpr size_t   HEADER_SIZE       = 16;
+    static constexpr size_t   ENTRY_SIZE        = 4;
+    static constexpr size_t   ENTRIES_PER_BLOCK = (BLOCK_SIZE - HEADER_SIZE) / ENTRY_SIZE;
+    static constexpr uint32_t MAGIC             = 0x58514950; // "PIQX"
+    static constexpr uint64_t MS_PER_DAY        = 86400000ULL;
+
+    explicit SampleIndex(BlockFile& file_) : file(file_) { reset(); }
+
+    // Index blocks needed to cover dataBlocks data blocks.
+    static uint32_t blocksFor(uint32_t dataBlocks) {
+        return dataBlocks / ENTRIES_PER_BLOCK + 1;
+    }
+
+    // Opens (creating if needed) the index of day and returns how many data blocks it covers.
+    // The caller appends entries for any data blocks beyond that to bring it up to date.
+    uint32_t open(const char* name, uint32_t day_, uint32_t preallocBlocks) {
+        close();
+        if (!file.open(name, true, preallocBlocks)) return 0;
+        day = day_;
+
+        uint32_t blocks = validBlockCount();
+        if (blocks > 0 && file.readBlock(blocks - 1, staging)) {
+            uint16_t n = getLe16(staging + 8);
+            entries = (blocks - 1) * ENTRIES_PER_BLOCK + n;
+            if (n == ENTRIES_PER_BLOCK) startBlock(blocks);
+            else stagingBlock = blocks - 1;
+        } else {
+            startBlock(0);
+        }
+        return entries;
+    }
+
+    bool isOpen() const { return file.isOpen(); }
+
+    void close() {
+        if (file.isOpen()) {
+            flush();
+            file.close();
+        }
+        reset();
+    }
+
+    // Records the first timestamp of data block blockIndex. Blocks must be added in order;
+    // anything else is rejected, since a gap would misalign every later entry.
+    bool add(uint32_t blockIndex, uint64_t firstTimestampMs) {
+        if (!file.isOpen() || blockIndex != entries) return false;
+        uint32_t slot = entries % ENTRIES_PER_BLOCK;
+        putLe32(staging + HEADER_SIZE + slot * ENTRY_SIZE, (uint32_t)(firstTimestampMs - (uint64_t)day * MS_PER_DAY));
+        entries++;
+        dirty = true;
+        if (slot + 1 == ENTRIES_PER_BLOCK) {
+            writeStaging();
+            startBlock(stagingBlock + 1);
+        }
+        return true;
+    }
+
+    void flush() {
+        if (dirty) writeStaging();
+        if (file.isOpen()) file.sync();
+    }
+
+    uint32_t entryCount() const { return entries; }
+
+    // Reader side: finds the data block to start reading at for a record at tsMs, i.e. the last
+    // block whose first record is not later than tsMs (block 0 if tsMs precedes the day).
+    // idx must already be open on the day's index. scratch needs BLOCK_SIZE bytes.
+    // Returns false if the index has no entries. readsOut (optional) counts block reads.
+    static bool findBlock(BlockFile& idx, uint32_t day, uint64_t tsMs, uint32_t& blockIndex, uint8_t* scratch, uint32_t* readsOut = nullptr) {
+        uint64_t dayStart = (uint64_t)day * MS_PER_DAY;
+        uint32_t target = tsMs <= dayStart ? 0 : (uint32_t)(tsMs - dayStart);
+        uint32_t reads = 0;
+
+        // Last index block that is valid and starts at or before target (a monotone predicate:
+        // valid blocks form a prefix and their first entries increase).
+        uint32_t lo = 0, hi = idx.blockCount();
+        while (lo < hi) {
+            uint32_t mid = lo + (hi - lo) / 2;
+            reads++;
+            if (idx.readBlock(mid, scratch) && parseBlock(scratch, day) && getLe32(scratch + HEADER_SIZE) <= target) lo = mid + 1;
+            else hi = mid;
+        }
+        uint32_t found = lo > 0 ? lo - 1 : 0;
+        reads++;
+        if (!idx.readBlock(found, scratch) || !parseBlock(scratch, day)) {
+            if (readsOut) *readsOut += reads;
+            return false;
+        }
+
+        uint16_t n = getLe16(scratch + 8);
+        uint32_t a = 0, b = n;
+        while (a < b) {
+            uint32_t mid = a + (b - a) / 2;
+            if (getLe32(scratch + HEADER_SIZE + mid * ENTRY_SIZE) <= target) a = mid + 1;
+            else b = mid;
+        }
+        blockIndex = found * ENTRIES_PER_BLOCK + (a > 0 ? a - 1 : 0);
+        if (readsOut) *readsOut += reads;
+        return true;
+    }
+
+    static bool parseBlock(const uint8_t* block, uint32_t expectedDay) {
+        if (getLe32(block) != MAGIC || getLe32(block + 4) != expectedDay) return false;
+        uint16_t n = getLe16(block + 8);
+        if (n == 0 || n > ENTRIES_PER_BLOCK) return false;
+        return getLe32(block + 12) == blockCrc(block);
+    }
+
+private:
+    static uint32_t blockCrc(const uint8_t* block) {
+        uint32_t crc = Crc32::compute(block, 12);
+        return Crc32::compute(block + HEADER_SIZE, BLOCK_SIZE - HEADER_SIZE, crc);
+    }
+
+    void reset() {
+        day = 0;
+        entries = 0;
+        stagingBlock = 0;
+        dirty = false;
+        memset(staging, 0, sizeof(staging));
+    }
+
+    void startBlock(uint32_t blockIndex) {
+        stagingBlock = blockIndex;
+        memset(staging, 0, sizeof(staging));
+        dirty = false;
+    }
+
+    void writeStaging() {
+        uint32_t n = entries - stagingBlock * ENTRIES_PER_BLOCK;
+        if (n == 0) return;
+        putLe32(staging, MAGIC);
+        putLe32(staging + 4, day);
+        putLe16(staging + 8, (uint16_t)n);
+        putLe16(staging + 10, 0);
+        putLe32(staging + 12, blockCrc(staging));
+        file.writeBlock(stagingBlock, staging);
+        dirty = false;
+    }
+
+    uint32_t validBlockCount() {
+        uint32_t lo = 0, hi = file.blockCount();
+        while (lo < hi) {
+            uint32_t mid = lo + (hi - lo) / 2;
+            if (file.readBlock(mid, staging) && parseBlock(staging, day)) lo = mid + 1;
+            else hi = mid;
+        }
+        return lo;
+    }
+
+    BlockFile& file;
+    uint32_t day;
+    uint32_t entries;
+    uint32_t stagingBlock;
+    bool dirty;
+    uint8_t staging[BLOCK_SIZE];
+};
+
+#endif // __SAMPLE_INDEX_H__
@@ -0,0 +1,472 @@
+#ifndef __SAMPLE_LOG_H__
+#define __SAMPLE_LOG_H__
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include "BlockFile.h"
+#include "ByteCodec.h"
+#include "Crc32.h"
+#include "LightSample.h"
+#include "SampleCodec.h"
+#include "SampleIndex.h"
+
+// Append-only binary sample log, one file per UTC day ("YYYYMMDD.plg") with a sparse time
+// index alongside it ("YYYYMMDD.idx", see SampleIndex).
+// Records are staged in one of two 512-byte block buffers; a full block is sealed (header + CRC)
+// and handed to service() for writing while the other buffer keeps filling, so the card only
+// ever sees whole, sector-aligned block writes. A partially filled block is also committed in
+// place every commitIntervalMs so little is lost on power failure; commitIntervalFor() ties that
+// to the sample rate so slow logging doesn't rewrite the same sector for every record.
+//
+// Block layout (little-endian):
+//   0  u32 magic "PIQL"          16 u32 log sequence of the first record
+//   4  u8  format version        20 u64 timestamp of the first record (epoch ms)
+//   5  u8  encoding              28 u32 CRC-32 of bytes 0..27 and 32..511
+//   6  u16 record count          32 ... records
+//   8  u32 day (days since epoch)
+//   12 u32 block sequence (increments by one per block, across files)
+// Records are either raw (ENCODING_RAW, 16 bytes each: u48 timestamp ms, u8 flags, u8 control,
+// u32 lux*100, u16 CH0, u16 CH1) or a SampleCodec chunk (ENCODING_DELTA, variable length, reset
+// at the start of every block). The encoding is recorded per block, so files may mix both.
+// The log sequence numbers records contiguously in the order they were logged, independent
+// of the sensor's own sample sequence (which may have gaps when a consumer overruns).
+class SampleLog {
+public:
+    static constexpr size_t   BLOCK_SIZE        = BlockFile::BLOCK_SIZE;
+    static constexpr size_t   HEADER_SIZE       = 32;
+    static constexpr size_t   RECORD_SIZE       = 16;
+    static constexpr size_t   RECORDS_PER_BLOCK = (BLOCK_SIZE - HEADER_SIZE) / RECORD_SIZE;
+    static constexpr uint32_t MAGIC             = 0x4C514950; // "PIQL"
+    static constexpr uint8_t  FORMAT_VERSION    = 1;
+    static constexpr uint8_t  ENCODING_RAW      = 0;
+    static constexpr uint8_t  ENCODING_DELTA    = 1;
+    static constexpr uint64_t MS_PER_DAY        = 86400000ULL;
+    static constexpr uint32_t MAX_LOOKBACK_DAYS = 31;
+    static constexpr size_t   FILE_NAME_LEN     = 32;
+    static constexpr uint32_t COMMIT_EVERY_RECORDS   = 10;
+    static constexpr uint32_t MIN_COMMIT_INTERVAL_MS = 60000;
+
+    struct BlockHeader {
+        uint8_t  version;
+        uint8_t  encoding;
+        uint16_t recordCount;
+        uint32_t day;
+        uint32_t blockSequence;
+        uint32_t firstSequence;
+        uint64_t firstTimestampMs;
+    };
+
+    struct Stats {
+        uint32_t recordsAppended;
+        uint32_t blocksWritten;     // full blocks sealed and written
+        uint32_t partialCommits;    // in-place rewrites of the block still being filled
+        uint32_t writeErrors;
+        uint32_t droppedRecords;    // records that could not be staged (file could not be opened)
+    };
+
+    SampleLog(BlockFile& file_, BlockFile& indexFile, uint32_t preallocBlocks_,
+              uint32_t commitIntervalMs_ = MIN_COMMIT_INTERVAL_MS)
+        : file(file_), index(indexFile), preallocBlocks(preallocBlocks_), commitIntervalMs(commitIntervalMs_), encoding(ENCODING_RAW) {
+        reset();
+        sequenceKnown = false;
+        nextBlockSequence = 0;
+        nextRecordSequence = 0;
+        stats = Stats();
+    }
+
+    // Blocks needed for one day of samples at the given interval, plus a little slack. Delta
+    // blocks are sized for 8 bytes a record; a noisier day just grows the file past the preallocation.
+    static uint32_t blocksPerDay(uint32_t sampleIntervalMs, uint8_t enc = ENCODING_RAW) {
+        if (sampleIntervalMs == 0) sampleIntervalMs = 1;
+        uint32_t records = (uint32_t)(MS_PER_DAY / sampleIntervalMs);
+        uint32_t perBlock = enc == ENCODING_DELTA ? (BLOCK_SIZE - HEADER_SIZE) / 8 : RECORDS_PER_BLOCK;
+        return records / perBlock + 2;
+    }
+
+    // Partial-block commit interval for a sample interval: about every COMMIT_EVERY_RECORDS
+    // records, but at most once a minute. At most that many records are lost on power failure.
+    static uint32_t commitIntervalFor(uint32_t sampleIntervalMs) {
+        uint64_t ms = (uint64_t)sampleIntervalMs * COMMIT_EVERY_RECORDS;
+        if (ms < MIN_COMMIT_INTERVAL_MS) return MIN_COMMIT_INTERVAL_MS;
+        return ms > UINT32_MAX ? UINT32_MAX : (uint32_t)ms;
+    }
+
+    // Takes effect for day files created from now on.
+    void setPreallocBlocks(uint32_t blocks) { preallocBlocks = blocks; }
+
+    void setCommitInterval(uint32_t ms) { commitIntervalMs = ms; }
+
+    // Takes effect from the next block started.
+    void setEncoding(uint8_t e) { encoding = e == ENCODING_DELTA ? ENCODING_DELTA : ENCODING_RAW; }
+
+    // Upper bound on records in one block of the given encoding.
+    static size_t maxRecords(uint8_t enc) {
+        return enc == ENCODING_DELTA ? (BLOCK_SIZE - HEADER_SIZE) / SampleCodec::MIN_RECORD_SIZE : RECORDS_PER_BLOCK;
+    }
+
+    // Stages one sample. Opens or rotates the day file as needed.
+    bool append(const LightSample& s) {
+        uint32_t day = (uint32_t)(s.timestampMs / MS_PER_DAY);
+        if (!file.isOpen() || day != currentDay) {
+            if (!rotate(day)) {
+                stats.droppedRecords++;
+                return false;
+            }
+        }
+
+        if (activeCount == 0) beginBlock(s);
+        size_t n = stage(s);
+        if (n == 0) {
+            // A delta block only knows it is full when the next record doesn't fit.
+            seal();
+            beginBlock(s);
+            n = stage(s);
+        }
+        activeBytes += n;
+        activeCount++;
+        activeDirty = true;
+        nextRecordSequence++;
+        stats.recordsAppended++;
+
+        if (activeCount == maxRecords(activeEncoding) || BLOCK_SIZE - HEADER_SIZE - activeBytes < SampleCodec::MIN_RECORD_SIZE) seal();
+        return true;
+    }
+
+    // Writes a sealed block if one is waiting and commits the partial block once it is old enough.
+    // Call regularly from the logging task; nowMs only needs to be monotonic.
+    void service(uint64_t nowMs) {
+        writePending();
+        if (activeDirty && activeCount > 0) {
+            if (nowMs - lastCommitMs >= commitIntervalMs) {
+                commitActive();
+                index.flush();
+                lastCommitMs = nowMs;
+            }
+        } else {
+            lastCommitMs = nowMs;
+        }
+    }
+
+    // Writes everything staged, including the partial block, and syncs the file.
+    void flush() {
+        writePending();
+        if (activeDirty && activeCount > 0) commitActive();
+        if (file.isOpen()) file.sync();
+        index.flush();
+    }
+
+    uint32_t nextSequence() const { return nextRecordSequence; }
+    uint32_t openDay() const { return currentDay; }
+    const Stats& getStats() const { return stats; }
+
+    // --- Format helpers (shared with readers) ---
+
+    static void formatFileName(uint32_t day, char* out, size_t outLen, const char* extension = "plg") {
+        int y; unsigned m, d;
+        civilFromDays(day, y, m, d);
+        snprintf(out, outLen, "%04d%02u%02u.%s", y, m, d, extension);
+    }
+
+    static void encodeRecord(const LightSample& s, uint8_t* out) {
+        putLe48(out, s.timestampMs);
+        out[6] = s.flags;
+        out[7] = s.control;
+        putLe32(out + 8, s.centiLux);
+        putLe16(out + 12, s.fullCount);
+        putLe16(out + 14, s.irCount);
+    }
+
+    static void decodeRecord(const uint8_t* in, uint32_t sequence, LightSample& s) {
+        s.sequence    = sequence;
+        s.timestampMs = getLe48(in);
+        s.flags       = in[6];
+        s.control     = in[7];
+        s.centiLux    = getLe32(in + 8);
+        s.fullCount   = getLe16(in + 12);
+        s.irCount     = getLe16(in + 14);
+    }
+
+    // Sequential access to the records of a parsed block, whatever its encoding.
+    class RecordCursor {
+    public:
+        RecordCursor() : block(nullptr), encoding(ENCODING_RAW), count(0), index(0), offset(0) {}
+
+        void begin(const uint8_t* block_, const BlockHeader& h) {
+            block = block_;
+            encoding = h.encoding;
+            count = h.recordCount;
+            first = h.firstSequence;
+            index = 0;
+            offset = HEADER_SIZE;
+            decoder.reset();
+        }
+
+        // False at the end of the block, or on a record that fails to decode.
+        bool next(LightSample& s) {
+            if (!block || index >= count) return false;
+            if (encoding == ENCODING_DELTA) {
+                size_t n = decoder.decode(block + offset, BLOCK_SIZE - offset, s);
+                if (n == 0) { index = count; return false; }
+                offset += n;
+                s.sequence = first + index;
+            } else {
+                decodeRecord(block + offset, first + index, s);
+                offset += RECORD_SIZE;
+            }
+            index++;
+            return true;
+        }
+
+        size_t bytesUsed() const { return offset - HEADER_SIZE; }
+
+    private:
+        const uint8_t* block;
+        uint8_t encoding;
+        uint16_t count;
+        uint32_t first;
+        uint16_t index;
+        size_t offset;
+        SampleCodec::Decoder decoder;
+    };
+
+    // Checks magic, version, CRC and (unless expectedDay is UINT32_MAX) that the block belongs to
+    // the expected day. Preallocated space may hold stale data from deleted files, so the day
+    // check is what separates written blocks from leftovers.
+    static bool parseBlock(const uint8_t* block, BlockHeader& h, uint32_t expectedDay = UINT32_MAX) {
+        if (getLe32(block) != MAGIC) return false;
+        h.version          = block[4];
+        h.encoding         = block[5];
+        h.recordCount      = getLe16(block + 6);
+        h.day              = getLe32(block + 8);
+        h.blockSequence    = getLe32(block + 12);
+        h.firstSequence    = getLe32(block + 16);
+        h.firstTimestampMs = getLe64(block + 20);
+        if (h.version != FORMAT_VERSION || h.encoding > ENCODING_DELTA) return false;
+        if (h.recordCount == 0 || h.recordCount > maxRecords(h.encoding)) return false;
+        if (expectedDay != UINT32_MAX && h.day != expectedDay) return false;
+        return getLe32(block + 28) == blockCrc(block);
+    }
+
+    // Days since 1970-01-01 to a proleptic Gregorian date (H. Hinnant's civil_from_days).
+    static void civilFromDays(uint32_t days, int& year, unsigned& month, unsigned& day) {
+        int32_t z = (int32_t)days + 719468;
+        int32_t era = z / 146097;
+        uint32_t doe = (uint32_t)(z - era * 146097);
+        uint32_t yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+        uint32_t doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+        uint32_t mp = (5 * doy + 2) / 153;
+        day = doy - (153 * mp + 2) / 5 + 1;
+        month = mp < 10 ? mp + 3 : mp - 9;
+        year = (int)yoe + era * 400 + (month <= 2 ? 1 : 0);
+    }
+
+private:
+    static uint32_t blockCrc(const uint8_t* block) {
+        uint32_t crc = Crc32::compute(block, 28);
+        return Crc32::compute(block + HEADER_SIZE, BLOCK_SIZE - HEADER_SIZE, crc);
+    }
+
+    void reset() {
+        active = 0;
+        activeCount = 0;
+        activeBytes = 0;
+        activeEncoding = encoding;
+        activeDirty = false;
+        activeBlockIndex = 0;
+        pending = -1;
+        pendingBlockIndex = 0;
+        lastCommitMs = 0;
+        currentDay = UINT32_MAX;
+    }
+
+    void beginBlock(const LightSample& s) {
+        activeFirstSequence = nextRecordSequence;
+        activeFirstTimestampMs = s.timestampMs;
+        activeEncoding = encoding;
+        encoder.reset();
+        index.add(activeBlockIndex, s.timestampMs);
+    }
+
+    // Writes s into the active block; 0 if it doesn't fit.
+    size_t stage(const LightSample& s) {
+        uint8_t* out = buffers[active] + HEADER_SIZE + activeBytes;
+        size_t room = BLOCK_SIZE - HEADER_SIZE - activeBytes;
+        if (activeEncoding == ENCODING_DELTA) return encoder.encode(s, out, room);
+        if (room < RECORD_SIZE) return 0;
+        encodeRecord(s, out);
+        return RECORD_SIZE;
+    }
+
+    void finalizeHeader(uint8_t* block, uint16_t count, uint32_t blockSequence) {
+        putLe32(block, MAGIC);
+        block[4] = FORMAT_VERSION;
+        block[5] = activeEncoding;
+        putLe16(block + 6, count);
+        putLe32(block + 8, currentDay);
+        putLe32(block + 12, blockSequence);
+        putLe32(block + 16, activeFirstSequence);
+        putLe64(block + 20, activeFirstTimestampMs);
+        // Unused space is zeroed so the CRC covers deterministic content.
+        memset(block + HEADER_SIZE + activeBytes, 0, BLOCK_SIZE - HEADER_SIZE - activeBytes);
+        putLe32(block + 28, blockCrc(block));
+    }
+
+    // Hands the full active block to the writer and switches to the other buffer.
+    void seal() {
+        writePending(); // the other buffer must be free before we switch to it
+        finalizeHeader(buffers[active], (uint16_t)activeCount, activeBlockSequence);
+        pending = active;
+        pendingBlockIndex = activeBlockIndex;
+        active ^= 1;
+        activeCount = 0;
+        activeBytes = 0;
+        activeDirty = false;
+        activeBlockIndex++;
+        activeBlockSequence = nextBlockSequence++;
+    }
+
+    void writePending() {
+        if (pending < 0) return;
+        if (file.writeBlock(pendingBlockIndex, buffers[pending])) stats.blocksWritten++;
+        else stats.writeErrors++;
+        pending = -1;
+    }
+
+    void commitActive() {
+        uint8_t* block = buffers[active];
+        finalizeHeader(block, (uint16_t)activeCount, activeBlockSequence);
+        if (file.writeBlock(activeBlockIndex, block)) stats.partialCommits++;
+        else stats.writeErrors++;
+        activeDirty = false;
+    }
+
+    bool rotate(uint32_t day) {
+        if (file.isOpen()) {
+            flush();
+            file.close();
+        }
+        index.close();
+        reset();
+
+        if (!sequenceKnown) recoverSequences(day);
+
+        char name[FILE_NAME_LEN];
+        formatFileName(day, name, sizeof(name));
+        if (!file.open(name, true, preallocBlocks)) return false;
+        currentDay = day;
+
+        // Resume after the last valid block; a partially filled one is reloaded and continued.
+        uint32_t count = validBlockCount(day);
+        activeBlockIndex = count;
+        BlockHeader h;
+        uint8_t* block = buffers[active];
+        if (count > 0 && file.readBlock(count - 1, block) && parseBlock(block, h, day)) {
+            nextRecordSequence = h.firstSequence + h.recordCount;
+            nextBlockSequence = h.blockSequence + 1;
+            if (h.recordCount < maxRecords(h.encoding) && resumeBlock(block, h)) {
+                activeBlockIndex = count - 1;
+                nextBlockSequence = h.blockSequence;
+                activeCount = h.recordCount;
+                activeFirstSequence = h.firstSequence;
+                activeFirstTimestampMs = h.firstTimestampMs;
+            }
+        }
+        activeBlockSequence = nextBlockSequence++;
+        sequenceKnown = true;
+
+        // Bring the index up to date with blocks written since it was last flushed (or with a
+        // log that predates the index). Only the missing tail is read, not the whole day.
+        formatFileName(day, name, sizeof(name), "idx");
+        uint32_t indexed = index.open(name, day, SampleIndex::blocksFor(preallocBlocks));
+        uint8_t* probe = buffers[active ^ 1];
+        for (uint32_t i = indexed; i < count && index.isOpen(); i++) {
+            if (!file.readBlock(i, probe) || !parseBlock(probe, h, day)) break;
+            index.add(i, h.firstTimestampMs);
+        }
+        return true;
+    }
+
+    // Replays a partial block through the encoder so appending continues the same chunk.
+    // False if the block has no room left (it then stays as written and a new one is started).
+    bool resumeBlock(const uint8_t* block, const BlockHeader& h) {
+        activeEncoding = h.encoding;
+        encoder.reset();
+        RecordCursor cursor;
+        cursor.begin(block, h);
+        LightSample s;
+        uint8_t scratch[SampleCodec::MAX_RECORD_SIZE];
+        while (cursor.next(s)) {
+            if (activeEncoding == ENCODING_DELTA) encoder.encode(s, scratch, sizeof(scratch));
+        }
+        activeBytes = cursor.bytesUsed();
+        if (BLOCK_SIZE - HEADER_SIZE - activeBytes < SampleCodec::MIN_RECORD_SIZE) {
+            activeBytes = 0;
+            activeEncoding = encoding;
+            return false;
+        }
+        return true;
+    }
+
+    // Written blocks form a prefix of the file, so the end of the log is found by binary search.
+    uint32_t validBlockCount(uint32_t day) {
+        uint8_t* probe = buffers[active ^ 1];
+        BlockHeader h;
+        uint32_t lo = 0, hi = file.blockCount();
+        while (lo < hi) {
+            uint32_t mid = lo + (hi - lo) / 2;
+            if (file.readBlock(mid, probe) && parseBlock(probe, h, day)) lo = mid + 1;
+            else hi = mid;
+        }
+        return lo;
+    }
+
+    // On the first open after boot, continue the sequence numbers of the most recent earlier day file.
+    void recoverSequences(uint32_t day) {
+        char name[FILE_NAME_LEN];
+        for (uint32_t back = 1; back <= MAX_LOOKBACK_DAYS && back <= day; back++) {
+            formatFileName(day - back, name, sizeof(name));
+            if (!file.open(name, false)) continue;
+            uint32_t count = validBlockCount(day - back);
+            BlockHeader h;
+            uint8_t* block = buffers[active ^ 1];
+            if (count > 0 && file.readBlock(count - 1, block) && parseBlock(block, h, day - back)) {
+                nextRecordSequence = h.firstSequence + h.recordCount;
+                nextBlockSequence = h.blockSequence + 1;
+            }
+            file.close();
+            break;
+        }
+        sequenceKnown = true;
+    }
+
+    BlockFile& file;
+    SampleIndex index;
+    uint32_t preallocBlocks;
+    uint32_t commitIntervalMs;
+    uint8_t encoding;
+    SampleCodec::Encoder encoder;
+
+    uint8_t buffers[2][BLOCK_SIZE];
+    int      active;
+    size_t   activeCount;
+    size_t   activeBytes;
+    uint8_t  activeEncoding;
+    bool     activeDirty;
+    uint32_t activeBlockIndex;
+    uint32_t activeBlockSequence;
+    uint32_t activeFirstSequence;
+    uint64_t activeFirstTimestampMs;
+    int      pending;
+    uint32_t pendingBlockIndex;
+    uint64_t lastCommitMs;
+
+    uint32_t currentDay;
+    bool     sequenceKnown;
+    uint32_t nextBlockSequence;
+    uint32_t nextRecordSequence;
+    Stats    stats;
+};
+
+#endif // __SAMPLE_LOG_H__
@@ -0,0 +1,164 @@
+#ifndef __SAMPLE_LOG_READER_H__
+#define __SAMPLE_LOG_READER_H__
+
+#include <stddef.h>
+#include <stdint.h>
+#include "BlockFile.h"
+#include "LightSample.h"
+#include "SampleIndex.h"
+#include "SampleLog.h"
+
+// Pull-style range query over the sample log.
+// seek() uses each day's sparse index to jump straight to the first data block of interest,
+// then next() walks records in order until the end of the range. seekSequence() does the same
+// for a range of log sequence numbers, which is what resumable transfers key on. Readers use their own
+// BlockFile instances so they never disturb the writer's open files; they only see blocks the
+// writer has already committed.
+class SampleLogReader {
+public:
+    static constexpr uint32_t MAX_SEQUENCE_SEARCH_DAYS = 366;
+
+    SampleLogReader(BlockFile& data_, BlockFile& index_) : data(data_), index(index_) { clear(); }
+
+    // Positions the reader on the first record with fromMs <= timestamp <= toMs.
+    // Returns false if the range is empty or reversed; next() then returns nothing.
+    bool seek(uint64_t fromMs, uint64_t toMs) {
+        clear();
+        if (toMs < fromMs) return false;
+        this->fromMs = fromMs;
+        this->toMs = toMs;
+        day = (uint32_t)(fromMs / SampleLog::MS_PER_DAY);
+        lastDay = (uint32_t)(toMs / SampleLog::MS_PER_DAY);
+        active = openDay(true);
+        return active;
+    }
+
+    // Positions the reader on the first record with fromSeq <= sequence <= toSeq.
+    // latestDay bounds the search (normally today); days are probed backwards from it by the
+    // first block of each file, then the right day is binary-searched by block sequence.
+    bool seekSequence(uint32_t fromSeq, uint32_t toSeq, uint32_t latestDay) {
+        clear();
+        if (toSeq < fromSeq) return false;
+        this->fromSeq = fromSeq;
+        this->toSeq = toSeq;
+        toMs = UINT64_MAX;
+        lastDay = latestDay;
+
+        char name[SampleLog::FILE_NAME_LEN];
+        bool found = false;
+        uint32_t oldest = latestDay;
+        for (uint32_t back = 0; back <= MAX_SEQUENCE_SEARCH_DAYS && back <= latestDay; back++) {
+            uint32_t d = latestDay - back;
+            SampleLog::formatFileName(d, name, sizeof(name));
+            if (!data.open(name, false)) continue;
+            day = d;
+            bool ok = loadBlock(0);
+            data.close();
+            if (!ok) continue;
+            oldest = d;
+            if (header.firstSequence <= fromSeq) { found = true; break; }
+        }
+        day = oldest;
+        if (!found) return active = openDay(false); // everything logged is newer than fromSeq
+
+        SampleLog::formatFileName(day, name, sizeof(name));
+        if (!data.open(name, false)) return false;
+        uint32_t lo = 0, hi = data.blockCount();
+        while (lo < hi) {
+            uint32_t mid = lo + (hi - lo) / 2;
+            if (loadBlock(mid) && header.firstSequence <= fromSeq) lo = mid + 1;
+            else hi = mid;
+        }
+        active = loadBlock(lo > 0 ? lo - 1 : 0);
+        if (!active) finish();
+        return active;
+    }
+
+    // Returns the next record in range, or false once the range is exhausted.
+    bool next(LightSample& s) {
+        while (active) {
+            if (cursor.next(s)) {
+                if (s.timestampMs > toMs || s.sequence > toSeq) { finish(); return false; }
+                if (s.timestampMs < fromMs || s.sequence < fromSeq) continue;
+                return true;
+            }
+            if (!loadBlock(blockIndex + 1)) {
+                day++;
+                active = openDay(false);
+            }
+        }
+        return false;
+    }
+
+    // Sector reads issued since the last seek(), index and data combined.
+    uint32_t blocksRead() const { return reads; }
+
+    void close() { finish(); }
+
+private:
+    void clear() {
+        fromMs = toMs = 0;
+        fromSeq = 0;
+        toSeq = UINT32_MAX;
+        day = lastDay = 0;
+        blockIndex = 0;
+        reads = 0;
+        active = false;
+        header = SampleLog::BlockHeader();
+        cursor = SampleLog::RecordCursor();
+    }
+
+    void finish() {
+        active = false;
+        data.close();
+        index.close();
+    }
+
+    // Opens the next day that has a log file, starting at day. Only the first day of the range
+    // needs an index lookup; later days are read from their first block.
+    bool openDay(bool useIndex) {
+        char name[SampleLog::FILE_NAME_LEN];
+        for (; day <= lastDay; day++, useIndex = false) {
+            SampleLog::formatFileName(day, name, sizeof(name));
+            if (!data.open(name, false)) continue;
+
+            uint32_t start = 0;
+            if (useIndex) {
+                SampleLog::formatFileName(day, name, sizeof(name), "idx");
+                if (index.open(name, false)) {
+                    SampleIndex::findBlock(index, day, fromMs, start, block, &reads);
+                    index.close();
+                }
+            }
+            if (loadBlock(start)) return true;
+            data.close();
+        }
+        finish();
+        return false;
+    }
+
+    bool loadBlock(uint32_t i) {
+        reads++;
+        if (!data.readBlock(i, block) || !SampleLog::parseBlock(block, header, day)) return false;
+        blockIndex = i;
+        cursor.begin(block, header);
+        return true;
+    }
+
+    BlockFile& data;
+    BlockFile& index;
+    uint64_t fromMs;
+    uint64_t toMs;
+    uint32_t fromSeq;
+    uint32_t toSeq;
+    uint32_t day;
+    uint32_t lastDay;
+    uint32_t blockIndex;
+    SampleLog::RecordCursor cursor;
+    uint32_t reads;
+    bool active;
+    SampleLog::BlockHeader header;
+    uint8_t block[SampleLog::BLOCK_SIZE];
+};
+
+#endif // __SAMPLE_LOG_READER_H__
@@ -0,0 +1,155 @@
+#ifndef __SCHEDULER_H__
+#define __SCHEDULER_H__
+
+#include <stdint.h>
+#include <stddef.h>
+
+// Cooperative deadline scheduler driven from loop().
+// Periodic tasks run at absolute deadlines (next = previous deadline + period) so a
+// late run does not shift the phase of the runs that follow it. One-shot tasks run
+// once at their deadline and then disable themselves.
+// The clock is injected so the scheduler can be driven by a simulated clock off-device.
+
+struct TaskStats {
+    uint32_t runs;
+    uint32_t missedDeadlines;   // whole periods skipped because the task ran too late
+    uint64_t lastJitterUs;      // start time minus deadline of the most recent run
+    uint64_t maxJitterUs;
+    uint64_t totalJitterUs;
+    uint64_t lastRunUs;         // duration of the most recent run
+    uint64_t maxRunUs;
+
+    uint64_t meanJitterUs() const { return runs ? totalJitterUs / runs : 0; }
+};
+
+class Scheduler {
+public:
+    using ClockFn = uint64_t (*)();             // monotonic microseconds
+    using TaskFn  = void (*)(void* context);
+
+    static constexpr size_t MAX_TASKS    = 16;
+    static constexpr int    INVALID_TASK = -1;
+
+    explicit Scheduler(ClockFn clock_) : clock(clock_), taskCount(0) {}
+
+    // Registers a task that runs every periodUs, first after initialDelayUs.
+    int addPeriodic(const char* name, uint64_t periodUs, TaskFn fn, void* context = nullptr, uint64_t initialDelayUs = 0) {
+        if (periodUs == 0) return INVALID_TASK;
+        return add(name, periodUs, fn, context, initialDelayUs);
+    }
+
+    // Registers a task that runs once, delayUs from now. Re-arm it with schedule().
+    int addOneShot(const char* name, uint64_t delayUs, TaskFn fn, void* context = nullptr) {
+        return add(name, 0, fn, context, delayUs);
+    }
+
+    // Re-arms a task to run delayUs from now (keeps its period).
+    void schedule(int id, uint64_t delayUs) {
+        if (!valid(id)) return;
+        tasks[id].deadline = clock() + delayUs;
+        tasks[id].enabled = true;
+    }
+
+    // Changes the period of a periodic task. The new period applies from the next deadline.
+    void setPeriod(int id, uint64_t periodUs) {
+        if (!valid(id) || periodUs == 0 || tasks[id].period == 0) return;
+        Task& t = tasks[id];
+        if (periodUs < t.period) {
+            // Shortening the period should not leave the task waiting out the old, longer one.
+            uint64_t now = clock();
+            if (t.deadline > now + periodUs) t.deadline = now + periodUs;
+        }
+        t.period = periodUs;
+    }
+
+    uint64_t period(int id) const { return valid(id) ? tasks[id].period : 0; }
+
+    void setEnabled(int id, bool enabled) {
+        if (!valid(id)) return;
+        if (enabled && !tasks[id].enabled) tasks[id].deadline = clock() + tasks[id].period;
+        tasks[id].enabled = enabled;
+    }
+
+    // Runs every task whose deadline has passed, earliest deadline first.
+    // Returns the number of microseconds until the next deadline (0 if a task is already due,
+    // UINT64_MAX if nothing is scheduled) so the caller can sleep instead of spinning.
+    uint64_t runDue() {
+        for (;;) {
+            int next = earliest();
+            if (next == INVALID_TASK) return UINT64_MAX;
+
+            uint64_t now = clock();
+            Task& t = tasks[next];
+            if (now < t.deadline) return t.deadline - now;
+
+            uint64_t jitter = now - t.deadline;
+            if (t.period) {
+                uint64_t skipped = jitter / t.period;
+                t.stats.missedDeadlines += (uint32_t)skipped;
+                t.deadline += t.period * (skipped + 1);
+            } else {
+                t.enabled = false;
+            }
+
+            t.stats.runs++;
+            t.stats.lastJitterUs = jitter;
+            t.stats.totalJitterUs += jitter;
+            if (jitter > t.stats.maxJitterUs) t.stats.maxJitterUs = jitter;
+
+            t.fn(t.context);
+
+            uint64_t duration = clock() - now;
+            t.stats.lastRunUs = duration;
+            if (duration > t.stats.maxRunUs) t.stats.maxRunUs = duration;
+        }
+    }
+
+    size_t count() const { return taskCount; }
+    const char* name(int id) const { return valid(id) ? tasks[id].name : ""; }
+    const TaskStats& stats(int id) const { return tasks[valid(id) ? id : 0].stats; }
+
+    void resetStats() {
+        for (size_t i = 0; i < taskCount; i++) tasks[i].stats = TaskStats();
+    }
+
+private:
+    struct Task {
+        const char* name;
+        TaskFn fn;
+        void* context;
+        uint64_t period;    // 0 for one-shot tasks
+        uint64_t deadline;
+        bool enabled;
+        TaskStats stats;
+    };
+
+    bool valid(int id) const { return id >= 0 && (size_t)id < taskCount; }
+
+    int add(const char* name, uint64_t periodUs, TaskFn fn, void* context, uint64_t delayUs) {
+        if (taskCount >= MAX_TASKS || fn == nullptr) return INVALID_TASK;
+        Task& t = tasks[taskCount];
+        t.name = name;
+        t.fn = fn;
+        t.context = context;
+        t.period = periodUs;
+        t.deadline = clock() + delayUs;
+        t.enabled = true;
+        t.stats = TaskStats();
+        return (int)taskCount++;
+    }
+
+    int earliest() const {
+        int best = INVALID_TASK;
+        for (size_t i = 0; i < taskCount; i++) {
+            if (!tasks[i].enabled) continue;
+            if (best == INVALID_TASK || tasks[i].deadline < tasks[best].deadline) best = (int)i;
+        }
+        return best;
+    }
+
+    ClockFn clock;
+    Task tasks[MAX_TASKS];
+    size_t taskCount;
+};
+
+#endif // __SCHEDULER_H__
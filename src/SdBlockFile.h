@@ -0,0 +1,69 @@
+#ifndef __SD_BLOCK_FILE_H__
+#define __SD_BLOCK_FILE_H__
+
+#include <Arduino.h>
+#include <SD.h>
+#include "BlockFile.h"
+
+// BlockFile on the SD card's FAT volume.
+class SdBlockFile : public BlockFile {
+public:
+    explicit SdBlockFile(const char* rootDir_) : rootDir(rootDir_) {}
+
+    bool open(const char* name, bool create, uint32_t preallocBlocks = 0) override {
+        close();
+        char path[64];
+        snprintf(path, sizeof(path), "%s/%s", rootDir, name);
+
+        if (!SD.exists(path)) {
+            if (!create) return false;
+            if (!SD.exists(rootDir)) SD.mkdir(rootDir);
+            File created = SD.open(path, FILE_WRITE);
+            if (!created) return false;
+            // Growing the file to its full size now makes FAT allocate the whole cluster chain
+            // once, instead of a cluster at a time in the middle of logging.
+            if (preallocBlocks > 0) {
+                uint8_t zero = 0;
+                created.seek((size_t)preallocBlocks * BLOCK_SIZE - 1);
+                created.write(&zero, 1);
+            }
+            created.close();
+        }
+
+        // "r+" allows in-place block rewrites; FILE_APPEND would ignore seek() on write.
+        file = SD.open(path, "r+");
+        return (bool)file;
+    }
+
+    bool isOpen() const override { return (bool)file; }
+
+    void close() override {
+        if (file) file.close();
+    }
+
+    uint32_t blockCount() override {
+        return file ? (uint32_t)(file.size() / BLOCK_SIZE) : 0;
+    }
+
+    bool readBlock(uint32_t index, uint8_t* out) override {
+        if (!file || !file.seek((size_t)index * BLOCK_SIZE)) return false;
+        return file.read(out, BLOCK_SIZE) == BLOCK_SIZE;
+    }
+
+    bool writeBlock(uint32_t index, const uint8_t* data) override {
+        if (!file || !file.seek((size_t)index * BLOCK_SIZE)) return false;
+        return file.write(data, BLOCK_SIZE) == BLOCK_SIZE;
+    }
+
+    bool sync() override {
+        if (!file) return false;
+        file.flush();
+        return true;
+    }
+
+private:
+    const char* rootDir;
+    File file;
+};
+
+#endif // __SD_BLOCK_FILE_H__
@@ -0,0 +1,150 @@
+#ifndef __SENSOR_TASK_H__
+#define __SENSOR_TASK_H__
+
+#include <Arduino.h>
+#include "LatencyStats.h"
+#include "LightSensor.h"
+#include "LightSample.h"
+#include "SpscRing.h"
+
+// Dedicated FreeRTOS task that owns the TSL2591 and samples it at a fixed rate.
+// Every sample is pushed into one SPSC ring per consumer (BLE publisher, SD logger, uplink),
+// so each consumer drains at its own pace and a slow notify() or a blocking Wi-Fi call
+// elsewhere never delays acquisition. When a consumer falls behind and its ring fills up,
+// new samples are dropped for that consumer only and counted as overruns on its ring.
+//
+// Acquisition is either polled (read() every interval, blocking through the integration) or
+// interrupt-driven (startInterrupt()): the ALS runs continuously and an ISR on the TSL2591 INT
+// pin notifies the task, which otherwise sleeps. In MODE_CONVERSION the task wakes once per
+// conversion and emits the first conversion at or after each interval tick; in MODE_THRESHOLD
+// it emits a sample at every threshold crossing plus the latest conversion at each tick.
+// A watchdog timeout polls the chip in case an INT edge was missed.
+//
+// The time the first sample reached the sinks is kept for the boot-timing report.
+class SensorTask {
+public:
+    static constexpr size_t RING_SIZE = 64;
+    static constexpr size_t MAX_SINKS = 4;
+    using SampleRing = SpscRing<LightSample, RING_SIZE>;
+    using TimestampFn = uint64_t (*)(); // epoch milliseconds
+
+    SensorTask(LightSensor& sensor_, TimestampFn timestamp_)
+        : sensor(sensor_), timestamp(timestamp_), sinkCount(0), intervalMs(1000), handle(nullptr),
+          interruptPin(-1), mode(AlsAcquisition::MODE_CONVERSION), missedInterrupts(0), firstSampleAt(0) {}
+
+    // Registers a consumer ring. Must be called before start().
+    bool addSink(SampleRing* ring) {
+        if (handle != nullptr || sinkCount >= MAX_SINKS) return false;
+        sinks[sinkCount++] = ring;
+        return true;
+    }
+
+    // Sampling runs on core 1 alongside loop() at a higher priority, leaving core 0 to the radio stacks.
+    bool start(uint32_t intervalMs_, UBaseType_t priority = 2, BaseType_t core = 1) {
+        setInterval(intervalMs_);
+        return xTaskCreatePinnedToCore(taskEntry, "sensor", 4096, this, priority, &handle, core) == pdPASS;
+    }
+
+    // Interrupt-driven acquisition on pin (TSL2591 INT: open drain, active low). Falls back to
+    // polling if the sensor can't be switched to continuous mode.
+    bool startInterrupt(uint32_t intervalMs_, int pin, AlsAcquisition::Mode mode_, UBaseType_t priority = 2, BaseType_t core = 1) {
+        if (!sensor.startInterrupts(mode_)) return start(intervalMs_, priority, core);
+        interruptPin = pin;
+        mode = mode_;
+        setInterval(intervalMs_);
+        if (xTaskCreatePinnedToCore(taskEntry, "sensor", 4096, this, priority, &handle, core) != pdPASS) return false;
+        pinMode(pin, INPUT_PULLUP);
+        attachInterruptArg(digitalPinToInterrupt(pin), onInterrupt, this, FALLING);
+        return true;
+    }
+
+    void setInterval(uint32_t ms) {
+        intervalMs = ms > 0 ? ms : 1;
+    }
+
+    uint32_t interval() const { return intervalMs; }
+
+    // Watchdog polls that found INT still asserted: an edge the ISR never saw.
+    uint32_t missedInterruptCount() const { return missedInterrupts; }
+
+    // esp_timer time (microseconds since reset) at which the first sample was emitted; 0 until then.
+    uint32_t firstSampleUs() const { return firstSampleAt; }
+
+private:
+    static void taskEntry(void* arg) {
+        static_cast<SensorTask*>(arg)->run();
+    }
+
+    static void IRAM_ATTR onInterrupt(void* arg) {
+        BaseType_t woken = pdFALSE;
+        vTaskNotifyGiveFromISR(static_cast<SensorTask*>(arg)->handle, &woken);
+        if (woken == pdTRUE) portYIELD_FROM_ISR();
+    }
+
+    void emit(const LightSample& sample) {
+        for (size_t i = 0; i < sinkCount; i++) sinks[i]->push(sample);
+        if (firstSampleAt == 0) firstSampleAt = (uint32_t)esp_timer_get_time();
+    }
+
+    void run() {
+        if (interruptPin >= 0) runInterrupt();
+        TickType_t lastWake = xTaskGetTickCount();
+        for (;;) {
+            LightSample sample;
+            bool ok;
+            {
+                LatencyStats::Scope timed(latencyStats, LatencyStats::STAGE_SENSOR);
+                ok = sensor.read(sample, timestamp());
+            }
+            if (ok) emit(sample);
+            TickType_t period = pdMS_TO_TICKS(intervalMs);
+            vTaskDelayUntil(&lastWake, period > 0 ? period : 1);
+        }
+    }
+
+    void runInterrupt() {
+        // Longest integration plus margin: no INT for this long in conversion mode means a lost edge.
+        const TickType_t watchdog = pdMS_TO_TICKS(AutoRange::TIMES[AutoRange::TIME_COUNT - 1] * 2);
+        TickType_t nextDue = xTaskGetTickCount();
+        for (;;) {
+            TickType_t now = xTaskGetTickCount();
+            TickType_t untilDue = (int32_t)(nextDue - now) > 0 ? nextDue - now : 0;
+            TickType_t wait = mode == AlsAcquisition::MODE_CONVERSION ? watchdog : untilDue;
+            bool interrupted = ulTaskNotifyTake(pdTRUE, wait) > 0;
+            if (!interrupted && mode == AlsAcquisition::MODE_CONVERSION && digitalRead(interruptPin) == LOW) missedInterrupts++;
+
+            AlsAcquisition::Reading reading;
+            uint32_t start = CycleCounter::now();
+            AlsAcquisition::Event event = sensor.service(interrupted, reading);
+            latencyStats.record(LatencyStats::STAGE_SENSOR, CycleCounter::since(start));
+            if (event == AlsAcquisition::EVENT_ERROR) latencyStats.fail(LatencyStats::STAGE_SENSOR);
+            now = xTaskGetTickCount();
+            bool due = (int32_t)(now - nextDue) >= 0;
+            bool fresh = event == AlsAcquisition::EVENT_CONVERSION || event == AlsAcquisition::EVENT_THRESHOLD;
+            if (fresh && (due || event == AlsAcquisition::EVENT_THRESHOLD)) {
+                LightSample sample;
+                sensor.toSample(reading, sample, timestamp());
+                emit(sample);
+            }
+            if (due && (fresh || mode == AlsAcquisition::MODE_THRESHOLD)) {
+                TickType_t period = pdMS_TO_TICKS(intervalMs);
+                if (period == 0) period = 1;
+                nextDue += period;
+                if ((int32_t)(now - nextDue) >= 0) nextDue = now + period; // fell behind: don't burst
+            }
+        }
+    }
+
+    LightSensor& sensor;
+    TimestampFn timestamp;
+    SampleRing* sinks[MAX_SINKS];
+    size_t sinkCount;
+    volatile uint32_t intervalMs;
+    TaskHandle_t handle;
+    int interruptPin;
+    AlsAcquisition::Mode mode;
+    volatile uint32_t missedInterrupts;
+    volatile uint32_t firstSampleAt;
+};
+
+#endif // __SENSOR_TASK_H__
@@ -1,90 +1,311 @@
 #ifndef SETTINGS_H
 #define SETTINGS_H
 
-#include <Arduino.h>
-#include <Preferences.h>
+#include <mutex>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include "ByteCodec.h"
+#include "Crc32.h"
 
 struct SensorSettings {
-    String sensorName;
+    static constexpr size_t MAX_NAME             = 32;
+    static constexpr size_t MAX_WIFI_CREDENTIALS = 96; // "ssid,password"
+
+    char sensorName[MAX_NAME + 1];
     int updateInterval;
-    String pWifiSSIDCharAndPassword;
+    char pWifiSSIDCharAndPassword[MAX_WIFI_CREDENTIALS + 1];
     bool wifiEnabled;
 };
 
+// Where the settings blob lives. The device keeps it in NVS (PreferencesSettingsStore); host
+// builds use a plain file. read() returns the blob length, 0 if there is none.
+class SettingsStore {
+public:
+    virtual ~SettingsStore() {}
+    virtual size_t read(uint8_t* out, size_t capacity) = 0;
+    virtual bool write(const uint8_t* data, size_t len) = 0;
+
+    // Settings saved by firmware that predates the blob (one NVS key per field). Only consulted
+    // when there is no valid blob; false if there is nothing to migrate.
+    virtual bool readLegacy(SensorSettings&) { return false; }
+};
+
+// Long-lived, write-back settings cache. Reads come from RAM; setters update the RAM copy, mark
+// the changed fields dirty and tell listeners right away. service() commits everything dirty as
+// one blob once no change has arrived for the debounce period, so a burst of BLE writes costs a
+// single flash write and a multi-field update is never half persisted.
+//
+// Setters may be called from the NimBLE host task while service() runs on loop(); a mutex
+// guards the RAM copy. Listeners run on the setter's task, outside the lock.
+//
+// Blob layout (little-endian):
+//   0  u8   format version            9  u8   flags (bit 0: Wi-Fi enabled)
+//   1  u32  commit sequence           10 u8   name length, then the name
+//   5  i32  update interval, seconds  .. u8   credentials length, then "ssid,password"
+//   .. u32  CRC-32 of everything before it
+// Later versions append fields before the CRC; older readers take the fields they know.
 class SettingsManager {
 public:
-    SettingsManager()
-    {
-        // Set default settings
-        settings.sensorName = "PhotonIQSensor";
-        settings.updateInterval = 60; // Default to 60 seconds
-        settings.wifiEnabled = false;
-        settings.pWifiSSIDCharAndPassword = "";
+    static constexpr uint8_t  FORMAT_VERSION = 1;
+    static constexpr size_t   MAX_BLOB       = 1 + 4 + 4 + 1 + 1 + SensorSettings::MAX_NAME + 1 + SensorSettings::MAX_WIFI_CREDENTIALS + 4;
+    static constexpr size_t   MIN_BLOB       = 1 + 4 + 4 + 1 + 1 + 1 + 4;
+    static constexpr uint32_t DEFAULT_DEBOUNCE_MS = 2000;
+    static constexpr size_t   MAX_LISTENERS  = 4;
+
+    enum Field : uint32_t {
+        FIELD_SENSOR_NAME      = 1 << 0,
+        FIELD_UPDATE_INTERVAL  = 1 << 1,
+        FIELD_WIFI_CREDENTIALS = 1 << 2,
+        FIELD_WIFI_ENABLED     = 1 << 3,
+        FIELD_ALL              = 0x0F,
+    };
+
+    // changed is a mask of Field bits; settings is the state after the change.
+    using ListenerFn = void (*)(void* context, uint32_t changed, const SensorSettings& settings);
+
+    struct Stats {
+        uint32_t commits;
+        uint32_t commitFailures;
+        uint32_t changes;       // setter calls that changed a value
+        uint32_t unchanged;     // setter calls that wrote the current value (no flash work)
+        uint32_t migrated;      // 1 if begin() converted legacy keys
+    };
+
+    explicit SettingsManager(SettingsStore& store_, uint32_t debounceMs_ = DEFAULT_DEBOUNCE_MS)
+        : store(store_), debounceMs(debounceMs_), dirty(0), sequence(0), changeCount(0), seenChangeCount(0),
+          lastChangeMs(0), batchDepth(0), batchChanged(0), listenerCount(0), stats() {
+        setDefaults(settings);
     }
 
-    void begin()
-    {
-        preferences.begin("sensorSettings", false);
+    // Loads the blob, falling back to legacy keys and then to defaults. Migrated or defaulted
+    // settings are marked dirty so the next service() writes a blob.
+    void begin() {
+        uint8_t blob[MAX_BLOB];
+        size_t len = store.read(blob, sizeof(blob));
+        std::lock_guard<std::mutex> lock(mutex);
+        setDefaults(settings);
+        if (len > 0 && decode(blob, len, settings, sequence)) {
+            dirty = 0;
+            return;
+        }
+        setDefaults(settings);
+        if (store.readLegacy(settings)) stats.migrated = 1;
+        dirty = FIELD_ALL;
+        changeCount++;
     }
 
-    void end()
-    {
-        preferences.end();
+    SensorSettings getSettings() const {
+        std::lock_guard<std::mutex> lock(mutex);
+        return settings;
     }
 
-    void loadSettings()
-    {
-        settings.sensorName = preferences.getString("sensorName", "PhotonIQSensor");
-        settings.updateInterval = preferences.getInt("updateInterval", 60);
-        settings.wifiEnabled = preferences.getBool("wifiEnabled", true);
-        settings.pWifiSSIDCharAndPassword = preferences.getString("wifiSSIDAndPassword", "");
+    void setSensorName(const char* name, size_t len) {
+        update(FIELD_SENSOR_NAME, [&](SensorSettings& s) { return copyText(s.sensorName, SensorSettings::MAX_NAME, name, len); });
     }
+    void setSensorName(const char* name) { setSensorName(name, strlen(name)); }
 
-    void saveSettings()
-    {
-        preferences.putString("sensorName", settings.sensorName);
-        preferences.putInt("updateInterval", settings.updateInterval);
-        preferences.putBool("wifiEnabled", settings.wifiEnabled);
-        preferences.putString("wifiSSIDAndPassword", settings.pWifiSSIDCharAndPassword);
+    void setScanInterval(int interval) {
+        update(FIELD_UPDATE_INTERVAL, [&](SensorSettings& s) {
+            if (s.updateInterval == interval) return false;
+            s.updateInterval = interval;
+            return true;
+        });
     }
 
-    void setSensorName(const String &name)
-    {
-        settings.sensorName = name;
-        saveSettings();
+    void setWiFiCredentials(const char* ssidAndPassword, size_t len) {
+        update(FIELD_WIFI_CREDENTIALS, [&](SensorSettings& s) {
+            return copyText(s.pWifiSSIDCharAndPassword, SensorSettings::MAX_WIFI_CREDENTIALS, ssidAndPassword, len);
+        });
     }
+    void setWiFiCredentials(const char* ssidAndPassword) { setWiFiCredentials(ssidAndPassword, strlen(ssidAndPassword)); }
 
-    void setScanInterval(int interval)
-    {
-        settings.updateInterval = interval;
-        saveSettings();
+    void setWifiEnabled(bool enabled) {
+        update(FIELD_WIFI_ENABLED, [&](SensorSettings& s) {
+            if (s.wifiEnabled == enabled) return false;
+            s.wifiEnabled = enabled;
+            return true;
+        });
     }
 
-    void setWiFiCredentials(const String &wifiSSIDAndPassword)
-    {
-        settings.pWifiSSIDCharAndPassword = wifiSSIDAndPassword;
-        saveSettings();
+    // Groups several setters into one change: listeners hear about it once, at endUpdate(), with
+    // every changed field, and service() cannot commit in between.
+    void beginUpdate() {
+        std::lock_guard<std::mutex> lock(mutex);
+        batchDepth++;
     }
 
-    void setWifiEnabled(bool enabled)
-    {
-        settings.wifiEnabled = enabled;
-        saveSettings();
+    void endUpdate() {
+        uint32_t changed;
+        SensorSettings copy;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (batchDepth == 0 || --batchDepth > 0) return;
+            changed = batchChanged;
+            batchChanged = 0;
+            copy = settings;
+        }
+        if (changed) notify(changed, copy);
     }
 
-    WifiCredentials getWifiCredentials()
-    {
-        return WifiNetwork::parseCredentials(settings.pWifiSSIDCharAndPassword);
+    // Registers a change listener. Call during setup, before setters can run concurrently.
+    bool addListener(ListenerFn fn, void* context = nullptr) {
+        if (listenerCount >= MAX_LISTENERS) return false;
+        listeners[listenerCount].fn = fn;
+        listeners[listenerCount].context = context;
+        listenerCount++;
+        return true;
     }
 
-    SensorSettings getSettings()
-    {
-        return settings;
+    // Commits dirty fields once they have been quiet for the debounce period. Call periodically.
+    // Returns true if a blob was written.
+    bool service(uint32_t nowMs) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (changeCount != seenChangeCount) {
+                seenChangeCount = changeCount;
+                lastChangeMs = nowMs;
+                return false;
+            }
+            if (!dirty || batchDepth > 0 || nowMs - lastChangeMs < debounceMs) return false;
+        }
+        return commit();
+    }
+
+    // Writes dirty fields now (e.g. before a restart).
+    bool flush() {
+        return commit();
+    }
+
+    bool isDirty() const {
+        std::lock_guard<std::mutex> lock(mutex);
+        return dirty != 0;
+    }
+
+    const Stats& getStats() const { return stats; }
+
+    static void setDefaults(SensorSettings& s) {
+        memset(&s, 0, sizeof(s));
+        strcpy(s.sensorName, "PhotonIQSensor");
+        s.updateInterval = 60; // Default to 60 seconds
+        s.wifiEnabled = true;
+    }
+
+    static size_t encode(const SensorSettings& s, uint32_t sequence, uint8_t* out, size_t outLen) {
+        size_t nameLen = strnlen(s.sensorName, SensorSettings::MAX_NAME);
+        size_t credLen = strnlen(s.pWifiSSIDCharAndPassword, SensorSettings::MAX_WIFI_CREDENTIALS);
+        size_t len = MIN_BLOB + nameLen + credLen;
+        if (outLen < len) return 0;
+        size_t n = 0;
+        out[n++] = FORMAT_VERSION;
+        putLe32(out + n, sequence); n += 4;
+        putLe32(out + n, (uint32_t)s.updateInterval); n += 4;
+        out[n++] = s.wifiEnabled ? 1 : 0;
+        out[n++] = (uint8_t)nameLen;
+        memcpy(out + n, s.sensorName, nameLen); n += nameLen;
+        out[n++] = (uint8_t)credLen;
+        memcpy(out + n, s.pWifiSSIDCharAndPassword, credLen); n += credLen;
+        putLe32(out + n, Crc32::compute(out, n)); n += 4;
+        return n;
+    }
+
+    static bool decode(const uint8_t* in, size_t len, SensorSettings& s, uint32_t& sequence) {
+        if (len < MIN_BLOB || in[0] < 1) return false;
+        if (Crc32::compute(in, len - 4) != getLe32(in + len - 4)) return false;
+        size_t end = len - 4;
+        size_t n = 1;
+        sequence = getLe32(in + n); n += 4;
+        int interval = (int)getLe32(in + n); n += 4;
+        bool enabled = (in[n++] & 1) != 0;
+        size_t nameLen = in[n++];
+        if (nameLen > SensorSettings::MAX_NAME || n + nameLen + 1 > end) return false;
+        const uint8_t* name = in + n; n += nameLen;
+        size_t credLen = in[n++];
+        if (credLen > SensorSettings::MAX_WIFI_CREDENTIALS || n + credLen > end) return false;
+
+        memset(&s, 0, sizeof(s));
+        memcpy(s.sensorName, name, nameLen);
+        memcpy(s.pWifiSSIDCharAndPassword, in + n, credLen);
+        s.updateInterval = interval;
+        s.wifiEnabled = enabled;
+        return true;
     }
 
 private:
-    Preferences preferences;
+    struct Listener {
+        ListenerFn fn;
+        void* context;
+    };
+
+    static bool copyText(char* dst, size_t cap, const char* src, size_t len) {
+        if (len > cap) len = cap;
+        if (strnlen(dst, cap) == len && memcmp(dst, src, len) == 0) return false;
+        memcpy(dst, src, len);
+        dst[len] = '\0';
+        return true;
+    }
+
+    template <typename Fn>
+    void update(uint32_t field, Fn apply) {
+        SensorSettings copy;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (!apply(settings)) {
+                stats.unchanged++;
+                return;
+            }
+            stats.changes++;
+            dirty |= field;
+            changeCount++;
+            if (batchDepth > 0) {
+                batchChanged |= field;
+                return;
+            }
+            copy = settings;
+        }
+        notify(field, copy);
+    }
+
+    void notify(uint32_t changed, const SensorSettings& s) {
+        for (size_t i = 0; i < listenerCount; i++) listeners[i].fn(listeners[i].context, changed, s);
+    }
+
+    bool commit() {
+        uint8_t blob[MAX_BLOB];
+        size_t len;
+        uint32_t committed;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (!dirty) return false;
+            len = encode(settings, sequence + 1, blob, sizeof(blob));
+            committed = changeCount;
+        }
+        if (!store.write(blob, len)) {
+            stats.commitFailures++;
+            return false;
+        }
+        std::lock_guard<std::mutex> lock(mutex);
+        sequence++;
+        stats.commits++;
+        // A change that landed while the blob was being written stays dirty for the next commit.
+        if (changeCount == committed) dirty = 0;
+        return true;
+    }
+
+    SettingsStore& store;
+    uint32_t debounceMs;
+    mutable std::mutex mutex;
     SensorSettings settings;
+    uint32_t dirty;
+    uint32_t sequence;
+    uint32_t changeCount;
+    uint32_t seenChangeCount;
+    uint32_t lastChangeMs;
+    uint32_t batchDepth;
+    uint32_t batchChanged;
+    Listener listeners[MAX_LISTENERS];
+    size_t listenerCount;
+    Stats stats;
 };
 
-#endif // SETTINGS_H
\ No newline at end of file
+#endif // SETTINGS_H
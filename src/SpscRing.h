@@ -0,0 +1,73 @@
+#ifndef __SPSC_RING_H__
+#define __SPSC_RING_H__
+
+#include <atomic>
+#include <stddef.h>
+#include <stdint.h>
+
+// Fixed-size lock-free single-producer/single-consumer ring buffer.
+// One thread calls push(), one (other) thread calls pop()/peek(). Nothing allocates after
+// construction and neither side ever blocks: a push into a full ring is dropped and counted
+// as an overrun so a slow consumer cannot stall the producer.
+// Head and tail live on separate cache lines so the two sides do not false-share.
+// No Arduino dependencies, so it can be exercised with std::thread on a host.
+template <typename T, size_t N>
+class SpscRing {
+    static_assert(N >= 2 && (N & (N - 1)) == 0, "SpscRing capacity must be a power of two");
+
+public:
+    static constexpr size_t CAPACITY = N;
+
+    SpscRing() : head(0), tail(0), overruns(0) {}
+
+    // Producer side. Returns false (and counts an overrun) when the ring is full.
+    bool push(const T& item) {
+        uint32_t h = head.load(std::memory_order_relaxed);
+        if (h - tail.load(std::memory_order_acquire) >= N) {
+            overruns.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+        slots[h & MASK] = item;
+        head.store(h + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Consumer side. Returns false when empty.
+    bool pop(T& item) {
+        uint32_t t = tail.load(std::memory_order_relaxed);
+        if (t == head.load(std::memory_order_acquire)) return false;
+        item = slots[t & MASK];
+        tail.store(t + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Consumer side. Drops everything queued and returns the newest item, if any.
+    bool popLatest(T& item) {
+        uint32_t h = head.load(std::memory_order_acquire);
+        uint32_t t = tail.load(std::memory_order_relaxed);
+        if (t == h) return false;
+        item = slots[(h - 1) & MASK];
+        tail.store(h, std::memory_order_release);
+        return true;
+    }
+
+    // Approximate when called from a third thread; exact from either side.
+    size_t size() const {
+        return head.load(std::memory_order_acquire) - tail.load(std::memory_order_acquire);
+    }
+
+    bool empty() const { return size() == 0; }
+
+    uint32_t overrunCount() const { return overruns.load(std::memory_order_relaxed); }
+
+private:
+    static constexpr uint32_t MASK = N - 1;
+    static constexpr size_t CACHE_LINE = 64;
+
+    alignas(CACHE_LINE) std::atomic<uint32_t> head;     // written by the producer only
+    alignas(CACHE_LINE) std::atomic<uint32_t> tail;     // written by the consumer only
+    alignas(CACHE_LINE) std::atomic<uint32_t> overruns; // written by the producer only
+    alignas(CACHE_LINE) T slots[N];
+};
+
+#endif // __SPSC_RING_H__
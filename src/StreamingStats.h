@@ -0,0 +1,245 @@
+#ifndef __STREAMING_STATS_H__
+#define __STREAMING_STATS_H__
+
+#include <math.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "ByteCodec.h"
+#include "LightSample.h"
+
+// Constant-memory quantile estimate (Jain & Chlamtac P² algorithm): five markers whose heights
+// are nudged with a piecewise-parabolic fit as samples arrive. Exact for the first five samples.
+// Markers move one position per sample, so a step change part-way through (a light switched off)
+// leaves the estimate near the old level for a long time; bench p2_* metrics show how far.
+class P2Quantile {
+public:
+    explicit P2Quantile(float p_ = 0.5f) { reset(p_); }
+
+    void reset(float p_) {
+        p = p_;
+        count = 0;
+        dn[0] = 0.0f; dn[1] = p / 2.0f; dn[2] = p; dn[3] = (1.0f + p) / 2.0f; dn[4] = 1.0f;
+    }
+
+    void reset() { reset(p); }
+
+    void add(float x) {
+        if (count < 5) {
+            // Insertion sort of the first five samples into the marker heights.
+            size_t i = count++;
+            while (i > 0 && q[i - 1] > x) { q[i] = q[i - 1]; i--; }
+            q[i] = x;
+            if (count == 5) {
+                for (int k = 0; k < 5; k++) { n[k] = (float)k; np[k] = 4.0f * dn[k]; }
+            }
+            return;
+        }
+        count++;
+
+        int k;
+        if (x < q[0])       { q[0] = x; k = 0; }
+        else if (x >= q[4]) { q[4] = x; k = 3; }
+        else { k = 0; while (x >= q[k + 1]) k++; }
+        for (int i = k + 1; i < 5; i++) n[i] += 1.0f;
+        for (int i = 0; i < 5; i++) np[i] += dn[i];
+
+        for (int i = 1; i <= 3; i++) {
+            float d = np[i] - n[i];
+            if ((d >= 1.0f && n[i + 1] - n[i] > 1.0f) || (d <= -1.0f && n[i - 1] - n[i] < -1.0f)) {
+                float s = d >= 0.0f ? 1.0f : -1.0f;
+                float h = parabolic(i, s);
+                q[i] = (q[i - 1] < h && h < q[i + 1]) ? h : linear(i, s);
+                n[i] += s;
+            }
+        }
+    }
+
+    float value() const {
+        if (count == 0) return 0.0f;
+        if (count < 5) {
+            size_t i = (size_t)(p * (float)(count - 1) + 0.5f);
+            return q[i];
+        }
+        return q[2];
+    }
+
+    uint32_t samples() const { return count; }
+
+private:
+    float parabolic(int i, float s) const {
+        return q[i] + s / (n[i + 1] - n[i - 1]) *
+               ((n[i] - n[i - 1] + s) * (q[i + 1] - q[i]) / (n[i + 1] - n[i]) +
+                (n[i + 1] - n[i] - s) * (q[i] - q[i - 1]) / (n[i] - n[i - 1]));
+    }
+
+    float linear(int i, float s) const {
+        int j = i + (int)s;
+        return q[i] + s * (q[j] - q[i]) / (n[j] - n[i]);
+    }
+
+    float p;
+    uint32_t count;
+    float q[5];   // marker heights
+    float n[5];   // marker positions
+    float np[5];  // desired positions
+    float dn[5];  // desired position increments
+};
+
+// On-device aggregation of light samples into fixed windows (aligned to multiples of windowMs
+// in epoch time, so 60 s windows are calendar minutes): count, min, max, mean and standard
+// deviation (Welford), an exponential moving average that runs across windows, and three P²
+// quantiles. Saturated samples carry no usable lux; they are counted but not aggregated.
+// Memory and per-sample cost are constant regardless of window length.
+//
+// Summary layout (little-endian, 47 bytes; needs an ATT MTU of 50 to notify in one piece):
+//   0  u8   format version           15 u32 min lux * 100
+//   1  u48  window start, epoch ms   19 u32 max
+//   7  u32  window length ms         23 u32 mean
+//   11 u16  samples aggregated       27 u32 standard deviation
+//   13 u16  saturated samples        31 u32 EMA
+//   35 u32  quantile[0]  39 u32 quantile[1]  43 u32 quantile[2]
+class StreamingStats {
+public:
+    static constexpr uint8_t FORMAT_VERSION = 1;
+    static constexpr size_t  SUMMARY_SIZE   = 47;
+    static constexpr size_t  QUANTILES      = 3;
+
+    struct Config {
+        uint32_t windowMs;
+        float emaAlpha;              // weight of each new sample
+        float quantiles[QUANTILES];
+    };
+
+    struct Summary {
+        uint64_t startMs;
+        uint32_t windowMs;
+        uint16_t count;
+        uint16_t saturated;
+        uint32_t minCentiLux;
+        uint32_t maxCentiLux;
+        uint32_t meanCentiLux;
+        uint32_t stddevCentiLux;
+        uint32_t emaCentiLux;
+        uint32_t quantileCentiLux[QUANTILES];
+    };
+
+    StreamingStats() : haveEma(false), ema(0.0f), windowOpen(false), summaries(0) {
+        config.windowMs = 60000;
+        config.emaAlpha = 0.1f;
+        config.quantiles[0] = 0.5f;
+        config.quantiles[1] = 0.9f;
+        config.quantiles[2] = 0.99f;
+        resetWindow(0);
+    }
+
+    // Takes effect from the next window.
+    void setConfig(const Config& c) {
+        config = c;
+        if (config.windowMs == 0) config.windowMs = 1;
+    }
+    const Config& getConfig() const { return config; }
+
+    // Adds one sample. Returns true if it closed the previous window, whose summary is then
+    // available from last() until the next window closes.
+    bool add(const LightSample& s) {
+        bool closed = closeIfDue(s.timestampMs);
+        if (!windowOpen) {
+            resetWindow(s.timestampMs - s.timestampMs % config.windowMs);
+            windowOpen = true;
+        }
+
+        if (s.flags & LightSample::FLAG_SATURATED) {
+            if (saturated < UINT16_MAX) saturated++;
+            return closed;
+        }
+        if (count == UINT16_MAX) return closed;
+
+        float x = (float)s.centiLux;
+        count++;
+        float delta = x - mean;
+        mean += delta / (float)count;
+        m2 += delta * (x - mean);
+        if (s.centiLux < minValue) minValue = s.centiLux;
+        if (s.centiLux > maxValue) maxValue = s.centiLux;
+        ema = haveEma ? ema + config.emaAlpha * (x - ema) : x;
+        haveEma = true;
+        for (size_t i = 0; i < QUANTILES; i++) quantiles[i].add(x);
+        return closed;
+    }
+
+    // Closes the open window if nowMs is past its end (lets an idle period still produce a summary).
+    bool closeIfDue(uint64_t nowMs) {
+        if (!windowOpen || nowMs < windowStart + config.windowMs) return false;
+        summarize();
+        windowOpen = false;
+        return true;
+    }
+
+    const Summary& last() const { return summary; }
+    uint32_t summaryCount() const { return summaries; }
+
+    static size_t encode(const Summary& s, uint8_t* out, size_t outLen) {
+        if (outLen < SUMMARY_SIZE) return 0;
+        out[0] = FORMAT_VERSION;
+        putLe48(out + 1, s.startMs);
+        putLe32(out + 7, s.windowMs);
+        putLe16(out + 11, s.count);
+        putLe16(out + 13, s.saturated);
+        putLe32(out + 15, s.minCentiLux);
+        putLe32(out + 19, s.maxCentiLux);
+        putLe32(out + 23, s.meanCentiLux);
+        putLe32(out + 27, s.stddevCentiLux);
+        putLe32(out + 31, s.emaCentiLux);
+        for (size_t i = 0; i < QUANTILES; i++) putLe32(out + 35 + i * 4, s.quantileCentiLux[i]);
+        return SUMMARY_SIZE;
+    }
+
+private:
+    static uint32_t toCentiLux(float v) {
+        if (v <= 0.0f) return 0;
+        if (v >= 4294967040.0f) return UINT32_MAX;
+        return (uint32_t)(v + 0.5f);
+    }
+
+    void resetWindow(uint64_t startMs) {
+        windowStart = startMs;
+        count = 0;
+        saturated = 0;
+        mean = 0.0f;
+        m2 = 0.0f;
+        minValue = UINT32_MAX;
+        maxValue = 0;
+        for (size_t i = 0; i < QUANTILES; i++) quantiles[i].reset(config.quantiles[i]);
+    }
+
+    void summarize() {
+        summary.startMs = windowStart;
+        summary.windowMs = config.windowMs;
+        summary.count = count;
+        summary.saturated = saturated;
+        summary.minCentiLux = count ? minValue : 0;
+        summary.maxCentiLux = maxValue;
+        summary.meanCentiLux = toCentiLux(mean);
+        summary.stddevCentiLux = count > 1 ? toCentiLux(sqrtf(m2 / (float)(count - 1))) : 0;
+        summary.emaCentiLux = toCentiLux(ema);
+        for (size_t i = 0; i < QUANTILES; i++) summary.quantileCentiLux[i] = toCentiLux(quantiles[i].value());
+        summaries++;
+    }
+
+    Config config;
+    bool haveEma;
+    float ema;
+    bool windowOpen;
+    uint64_t windowStart;
+    uint16_t count;
+    uint16_t saturated;
+    float mean;
+    float m2;
+    uint32_t minValue;
+    uint32_t maxValue;
+    P2Quantile quantiles[QUANTILES];
+    Summary summary = {};
+    uint32_t summaries;
+};
+
+#endif // __STREAMING_STATS_H__
@@ -0,0 +1,388 @@
+#ifndef __TIMEBASE_H__
+#define __TIMEBASE_H__
+
+#include <atomic>
+#include <stddef.h>
+#include <stdint.h>
+#include "RtcDevice.h"
+
+// Wall-clock time in microseconds without touching the I2C bus: the DS3231's epoch seconds are
+// anchored to the monotonic microsecond timer (esp_timer) at a second boundary, and nowUs()
+// extrapolates along that line. The line's rate follows the RTC (the timer's crystal and the
+// DS3231 disagree by some ppm), measured across anchors up to an hour apart.
+//
+// Second boundaries come from the DS3231's 1 Hz SQW output when it is wired to an interrupt
+// (onSquareWaveEdge(), falling edge = seconds rollover), otherwise from reading the seconds
+// register until it changes. Once the boundary is known, later reads are only made in a short
+// window around the one predicted from the last boundary seen, a few reads every re-anchor
+// period. A boundary found by that search is only as good as its read spacing, so it is read
+// again through a window at the next second; only windowed and SQW boundaries measure the rate.
+//
+// nowUs() does not go backwards. A new anchor that disagrees with the line is slewed in (at most
+// maxSlewPpm); a larger error is stepped forward, or taken out by running at half speed if the
+// line is ahead (e.g. after the RTC was set back); only a line more than an hour ahead is
+// stepped back. If the SQW interrupt stops, boundaries are found by polling again. begin() gives
+// a coarse anchor from one read (half a second in), so timestamps are available at once and
+// refined within a couple of seconds.
+//
+// nowUs() may be called from any task; the line is published with a sequence lock. service()
+// and the other calls belong to one task (loop()), onSquareWaveEdge() to an ISR.
+class Timebase {
+public:
+    struct Config {
+        uint32_t reanchorPeriodMs;
+        uint32_t searchPollUs;     // read spacing while the boundary is unknown
+        uint32_t windowPollUs;     // read spacing around a predicted boundary (the resolution)
+        uint32_t windowUs;         // reads start this long before the predicted boundary
+        uint32_t stepThresholdUs;
+        uint32_t maxSlewPpm;
+        uint32_t rateWindowS;      // rate is measured against the oldest anchor within this
+        uint32_t minRateBaselineS;
+    };
+
+    struct Stats {
+        uint32_t anchors;
+        uint32_t squareWaveAnchors;
+        uint32_t steps;
+        uint32_t rtcReads;
+        uint32_t missedWindows;    // boundary not found where predicted; searched again
+        int32_t  lastErrorUs;      // new anchor minus the line, at the last anchor
+        int32_t  maxErrorUs;       // largest magnitude since begin(), after the first fine anchor
+        int32_t  ratePpb;          // RTC rate relative to the timer, minus one
+    };
+
+    explicit Timebase(RtcDevice& rtc_)
+        : rtc(rtc_), squareWave(false), sqwCount(0), sqwEdgeUs(0), sqwUsed(0), searching(false), windowOpen(false),
+          windowStartUs(0), windowEndUs(0), searchSeconds(0), searchReadUs(0), nextAnchorUs(0), anchorRequested(false),
+          rtcSet(false), fine(false), beganUs(0), lastEdgeUs(0), historyCount(0), historyNext(0), stats() {
+        config.reanchorPeriodMs = 600000;
+        config.searchPollUs = 10000;
+        config.windowPollUs = 1000;
+        config.windowUs = 15000;
+        config.stepThresholdUs = 200000;
+        config.maxSlewPpm = 500;
+        config.rateWindowS = 3600;
+        config.minRateBaselineS = 300;
+        line.baseMonoUs = 0;
+        line.baseEpochUs = 0;
+        line.slewEndUs = 0;
+        line.slewPpb = 0;
+        line.ratePpb = 0;
+        published.store(0, std::memory_order_relaxed);
+        seq.store(0, std::memory_order_relaxed);
+    }
+
+    void setConfig(const Config& c) { config = c; }
+
+    // Boundaries from the SQW interrupt instead of register polling.
+    void useSquareWave(bool enabled) { squareWave = enabled; }
+
+    // SQW falling edge; call from the ISR with the timer value.
+    void onSquareWaveEdge(uint64_t monoUs) {
+        sqwEdgeUs = monoUs;
+        sqwCount = sqwCount + 1;
+    }
+
+    // Coarse anchor from a single read. False if the RTC can't be read.
+    bool begin(uint64_t monoUs) {
+        uint32_t seconds;
+        stats.rtcReads++;
+        if (!rtc.readSeconds(seconds)) return false;
+        Line l = line;
+        l.baseMonoUs = monoUs;
+        l.baseEpochUs = (int64_t)seconds * 1000000 + 500000;
+        l.slewEndUs = monoUs;
+        publish(l);
+        beganUs = monoUs;
+        nextAnchorUs = monoUs; // refine right away, from SQW edges or by searching
+        return true;
+    }
+
+    // Anchors again as soon as possible after the RTC was set. The rate is measured afresh from
+    // that anchor: across the set, RTC seconds say nothing about its rate.
+    void requestAnchor() {
+        rtcSet = true;
+        anchorRequested = true;
+    }
+
+    bool valid() const { return published.load(std::memory_order_acquire) != 0; }
+
+    // True once a second boundary has been seen (not just the coarse begin() anchor).
+    bool precise() const { return fine; }
+
+    // Unix epoch microseconds at monotonic time monoUs; 0 before begin().
+    int64_t nowUs(uint64_t monoUs) const {
+        Line l;
+        uint32_t s;
+        do {
+            s = seq.load(std::memory_order_acquire);
+            l = line;
+            std::atomic_thread_fence(std::memory_order_acquire);
+        } while ((s & 1) || s != seq.load(std::memory_order_relaxed));
+        if (!published.load(std::memory_order_relaxed)) return 0;
+        return evaluate(l, monoUs);
+    }
+
+    // Runs the anchoring. Returns the number of microseconds until it needs to run again.
+    uint64_t service(uint64_t monoUs) {
+        if (!valid()) return config.searchPollUs;
+        if (squareWave && takeSquareWaveEdge(monoUs)) return untilNextAnchor(monoUs);
+
+        bool due = anchorRequested || (int64_t)(monoUs - nextAnchorUs) >= 0;
+        if (!searching && !windowOpen) {
+            if (!due) return untilNextAnchor(monoUs);
+            if (squareWave && squareWaveAlive(monoUs)) return 100000; // wait for the next edge
+            anchorRequested = false;
+            if (fine) openWindow(monoUs);
+            else startSearch();
+        }
+        if (windowOpen && (int64_t)(monoUs - windowStartUs) < 0) return windowStartUs - monoUs;
+
+        uint32_t seconds;
+        stats.rtcReads++;
+        if (!rtc.readSeconds(seconds)) {
+            searching = windowOpen = false;
+            nextAnchorUs = monoUs + 1000000;
+            return 1000000;
+        }
+        if (searchReadUs != 0 && seconds != searchSeconds) {
+            // The boundary lies between the previous read and this one.
+            uint64_t edge = searchReadUs + (monoUs - searchReadUs) / 2;
+            bool coarse = searching;
+            searching = windowOpen = false;
+            anchor(seconds, edge, monoUs, coarse);
+            return untilNextAnchor(monoUs);
+        }
+        searchSeconds = seconds;
+        searchReadUs = monoUs;
+        if (windowOpen && (int64_t)(monoUs - windowEndUs) > 0) {
+            // Not where the line said: the line is off by more than the window; search from scratch.
+            stats.missedWindows++;
+            windowOpen = false;
+            startSearch();
+        }
+        return windowOpen ? config.windowPollUs : config.searchPollUs;
+    }
+
+    const Stats& getStats() const { return stats; }
+
+private:
+    struct Line {
+        uint64_t baseMonoUs;
+        int64_t  baseEpochUs;
+        uint64_t slewEndUs;   // slewPpb applies from base to here, ratePpb after
+        int32_t  slewPpb;
+        int32_t  ratePpb;
+    };
+
+    struct Anchor {
+        uint64_t monoUs;
+        uint32_t seconds;
+    };
+
+    static constexpr size_t  HISTORY   = 8;
+    static constexpr int32_t CATCH_UP_PPB = -500000000; // half speed
+    static constexpr int64_t MAX_CATCH_UP_US = 3600000000LL;
+
+    static int64_t scale(int64_t us, int32_t ppb) {
+        return us + us * (int64_t)ppb / 1000000000;
+    }
+
+    static int64_t evaluate(const Line& l, uint64_t monoUs) {
+        int64_t d = (int64_t)(monoUs - l.baseMonoUs);
+        int64_t slew = (int64_t)(l.slewEndUs - l.baseMonoUs);
+        if (d <= slew) return l.baseEpochUs + scale(d, l.slewPpb);
+        return l.baseEpochUs + scale(slew, l.slewPpb) + scale(d - slew, l.ratePpb);
+    }
+
+    void publish(const Line& l) {
+        seq.fetch_add(1, std::memory_order_acq_rel);
+        std::atomic_thread_fence(std::memory_order_release);
+        line = l;
+        seq.fetch_add(1, std::memory_order_release);
+        published.store(1, std::memory_order_release);
+    }
+
+    uint64_t untilNextAnchor(uint64_t monoUs) const {
+        if (anchorRequested) return 0;
+        int64_t d = (int64_t)(nextAnchorUs - monoUs);
+        return d > 0 ? (uint64_t)d : 0;
+    }
+
+    void startSearch() {
+        searching = true;
+        searchReadUs = 0;
+    }
+
+    // Reads from shortly before the next boundary, counted on from the last one seen at the
+    // measured rate, until shortly after it. Not from the line: that may be slewing or catching up.
+    void openWindow(uint64_t monoUs) {
+        int64_t now = scale((int64_t)(monoUs - lastEdgeUs), line.ratePpb); // RTC time since that boundary
+        int64_t next = (now / 1000000 + 1) * 1000000;
+        if (next - now < (int64_t)config.windowUs + 1000) next += 1000000;
+        int64_t untilEdge = (next - now) - (next - now) * (int64_t)line.ratePpb / 1000000000;
+        uint64_t edgeUs = monoUs + (uint64_t)untilEdge;
+        windowStartUs = edgeUs - config.windowUs;
+        windowEndUs = edgeUs + config.windowUs;
+        windowOpen = true;
+        searchReadUs = 0;
+    }
+
+    // The ISR may interrupt the read; retry until the count is stable around it.
+    void latestEdge(uint32_t& count, uint64_t& edge) const {
+        do {
+            count = sqwCount;
+            edge = sqwEdgeUs;
+        } while (count != sqwCount);
+    }
+
+    // Edges arrive every second, or are still expected shortly after begin().
+    bool squareWaveAlive(uint64_t monoUs) const {
+        uint32_t count;
+        uint64_t edge;
+        latestEdge(count, edge);
+        if (count == 0) return monoUs - beganUs < 2000000;
+        return monoUs - edge < 2000000;
+    }
+
+    // Uses the latest SQW edge once it is safely past the register update; the seconds read
+    // then belong to that edge.
+    bool takeSquareWaveEdge(uint64_t monoUs) {
+        uint32_t count;
+        uint64_t edge;
+        latestEdge(count, edge);
+        if (count == sqwUsed) return false;
+        bool due = anchorRequested || (int64_t)(monoUs - nextAnchorUs) >= 0;
+        if (!due) return false;
+        // An edge from before the anchor fell due would leave the rate baseline short of
+        // minRateBaselineS, and the rate unmeasured for another period: wait for the next one.
+        if (!anchorRequested && (int64_t)(edge - nextAnchorUs) < 0) return false;
+        uint64_t age = monoUs - edge;
+        if (age < 5000 || age > 800000) return false; // too close to the update, or the next edge is near
+        uint32_t seconds;
+        stats.rtcReads++;
+        if (!rtc.readSeconds(seconds)) return false;
+        sqwUsed = count;
+        anchorRequested = false;
+        stats.squareWaveAnchors++;
+        anchor(seconds, edge, monoUs, false);
+        return true;
+    }
+
+    // New boundary observation: seconds began at edgeUs (coarse: to within the search's read
+    // spacing). Re-bases the line at monoUs (no reader can have seen a later time yet) so it
+    // stays continuous.
+    void anchor(uint32_t seconds, uint64_t edgeUs, uint64_t monoUs, bool coarse) {
+        stats.anchors++;
+        searching = windowOpen = false;
+        Line l = line;
+        int64_t current = evaluate(l, monoUs); // where readers are now; the new line starts here
+        int64_t error = (int64_t)seconds * 1000000 + scale((int64_t)(monoUs - edgeUs), l.ratePpb) - current;
+
+        // The coarse begin() anchor is only good to half a second: replace it, don't slew it.
+        int64_t threshold = fine ? (int64_t)config.stepThresholdUs : 0;
+        bool discontinuity = error > threshold || error < -threshold;
+        stats.lastErrorUs = (int32_t)clampError(error);
+        if (fine) {
+            int32_t mag = stats.lastErrorUs < 0 ? -stats.lastErrorUs : stats.lastErrorUs;
+            if (mag > stats.maxErrorUs) stats.maxErrorUs = mag;
+            if (discontinuity) stats.steps++;
+        }
+        fine = true;
+
+        // A step in the RTC says nothing about its rate: measure again from here.
+        if (discontinuity || rtcSet) historyCount = 0;
+        rtcSet = false;
+        lastEdgeUs = edgeUs;
+        if (coarse) {
+            nextAnchorUs = monoUs; // refine through a window at the next boundary
+        } else {
+            remember(seconds, edgeUs);
+            updateRate(l);
+            // Until the rate is measured over a full window, anchor as often as a baseline allows.
+            uint64_t intervalUs = (uint64_t)config.reanchorPeriodMs * 1000;
+            uint64_t baselineUs = (uint64_t)config.minRateBaselineS * 1000000;
+            if (historyCount < 2 && baselineUs < intervalUs) intervalUs = baselineUs;
+            nextAnchorUs = monoUs + intervalUs;
+        }
+
+        int64_t target = (int64_t)seconds * 1000000 + scale((int64_t)(monoUs - edgeUs), l.ratePpb);
+        error = target - current;
+        l.baseMonoUs = monoUs;
+        l.baseEpochUs = current;
+        l.slewEndUs = monoUs;
+        l.slewPpb = l.ratePpb;
+        if (error > threshold || error < -MAX_CATCH_UP_US) {
+            l.baseEpochUs = target;
+        } else if (error != 0) {
+            int64_t slewPpb = error < -threshold ? -(int64_t)CATCH_UP_PPB : (int64_t)config.maxSlewPpm * 1000;
+            int64_t magnitude = error < 0 ? -error : error;
+            l.slewEndUs = monoUs + (uint64_t)(magnitude * 1000000000 / slewPpb);
+            l.slewPpb = l.ratePpb + (int32_t)(error < 0 ? -slewPpb : slewPpb);
+        }
+        publish(l);
+    }
+
+    static int64_t clampError(int64_t e) {
+        if (e > INT32_MAX) return INT32_MAX;
+        if (e < -INT32_MAX) return -INT32_MAX;
+        return e;
+    }
+
+    void remember(uint32_t seconds, uint64_t edgeUs) {
+        history[historyNext].seconds = seconds;
+        history[historyNext].monoUs = edgeUs;
+        historyNext = (historyNext + 1) % HISTORY;
+        if (historyCount < HISTORY) historyCount++;
+    }
+
+    // RTC seconds per timer second, from the oldest anchor within the rate window to the newest.
+    void updateRate(Line& l) {
+        if (historyCount < 2) return;
+        const Anchor& newest = history[(historyNext + HISTORY - 1) % HISTORY];
+        for (size_t i = historyCount; i >= 2; i--) {
+            const Anchor& oldest = history[(historyNext + HISTORY - i) % HISTORY];
+            uint64_t spanUs = newest.monoUs - oldest.monoUs;
+            if (spanUs > (uint64_t)config.rateWindowS * 1000000 && i > 2) continue;
+            if (spanUs < (uint64_t)config.minRateBaselineS * 1000000) return;
+            int64_t rtcUs = (int64_t)(newest.seconds - oldest.seconds) * 1000000;
+            int64_t ppb = (rtcUs - (int64_t)spanUs) * 1000000000 / (int64_t)spanUs;
+            if (ppb > 1000000 || ppb < -1000000) return; // over 1000 ppm: a bad anchor, not a rate
+            l.ratePpb = (int32_t)ppb;
+            stats.ratePpb = l.ratePpb;
+            return;
+        }
+    }
+
+    RtcDevice& rtc;
+    Config config;
+
+    bool squareWave;
+    volatile uint32_t sqwCount;
+    volatile uint64_t sqwEdgeUs;
+    uint32_t sqwUsed;
+
+    bool searching;
+    bool windowOpen;
+    uint64_t windowStartUs;
+    uint64_t windowEndUs;
+    uint32_t searchSeconds;
+    uint64_t searchReadUs;
+    uint64_t nextAnchorUs;
+    volatile bool anchorRequested;
+    bool rtcSet;            // requestAnchor() since the last anchor
+    bool fine;
+    uint64_t beganUs;
+    uint64_t lastEdgeUs;    // timer time of the last boundary seen
+
+    Anchor history[HISTORY];
+    size_t historyCount;
+    size_t historyNext;
+
+    Line line;
+    std::atomic<uint32_t> seq;
+    std::atomic<uint8_t> published;
+    Stats stats;
+};
+
+#endif // __TIMEBASE_H__
@@ -0,0 +1,405 @@
+#ifndef __TRACE_LOG_H__
+#define __TRACE_LOG_H__
+
+#include <atomic>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <type_traits>
+#include <Arduino.h>
+#include "ByteCodec.h"
+
+// Trace levels. Call sites below TRACE_LEVEL compile to nothing, arguments included; set it with
+// -DTRACE_LEVEL=... (TRACE_LEVEL_OFF strips every call site).
+#define TRACE_LEVEL_DEBUG 0
+#define TRACE_LEVEL_INFO  1
+#define TRACE_LEVEL_WARN  2
+#define TRACE_LEVEL_ERROR 3
+#define TRACE_LEVEL_OFF   4
+
+#ifndef TRACE_LEVEL
+#define TRACE_LEVEL TRACE_LEVEL_INFO
+#endif
+
+// One TRACE_x() call site, in flash. The id is the FNV-1a hash of the format string, which is how
+// tools/trace_decode.py finds the format for a dumped record: it hashes the TRACE_x() formats in
+// the sources.
+struct TraceSite {
+    const char* format;
+    uint32_t id;
+    uint8_t level;
+};
+
+constexpr uint32_t traceFormatId(const char* s) {
+    uint32_t h = 2166136261u;
+    while (*s) {
+        h ^= (uint8_t)*s++;
+        h *= 16777619u;
+    }
+    return h;
+}
+
+// A string argument that isn't NUL-terminated, such as a GATT write value.
+struct TraceBytes {
+    TraceBytes(const uint8_t* data_, size_t len_) : data((const char*)data_), len(len_) {}
+    TraceBytes(const char* data_, size_t len_) : data(data_), len(len_) {}
+    const char* data;
+    size_t len;
+};
+
+// Deferred-formatting trace log. A call site stores a pointer to its TraceSite, a timestamp and
+// its arguments in binary into a RAM ring, and returns; nothing is formatted and nothing waits for
+// the UART. drain() formats the records later, from a low-priority task, and dump() hands them to
+// the host undecoded (GET /trace, or --trace in the native build) for tools/trace_decode.py.
+//
+// Any task may write: a writer claims a slot with one atomic increment and publishes it with a
+// per-slot sequence number, so writers never block each other or a reader. The ring keeps the
+// newest CAPACITY records; older ones are overwritten whether or not they were drained (counted
+// as lost), which leaves the last moments before a fault in RAM for a dump.
+//
+// Arguments are stored as a type tag and the raw value: integers up to 64 bits, floating point as
+// float, strings copied (at most MAX_STRING bytes). Arguments that don't fit in ARG_BYTES are
+// dropped and print as '?'. Formats take printf conversions; length modifiers are ignored, the
+// stored type decides.
+class TraceLog {
+public:
+    static constexpr size_t   CAPACITY   = 256;   // records, power of two
+    static constexpr size_t   ARG_BYTES  = 30;
+    static constexpr size_t   MAX_STRING = 20;
+    static constexpr size_t   MAX_LINE   = 160;   // formatted record, prefix included
+    static constexpr uint8_t  FORMAT_VERSION = 1;
+
+    // dump() layout (little-endian): a header, then one record after another.
+    //   header: "PTRC", u8 version, u8 TRACE_LEVEL, u16 capacity, u32 records written, u32 lost
+    //   record: u32 index, u32 time (esp_timer us, low 32 bits), u32 format id, u8 level,
+    //           u8 argument bytes, the arguments (tag byte + value each; strings: tag, length, bytes)
+    static constexpr size_t DUMP_HEADER = 16;
+    static constexpr size_t DUMP_RECORD = 14;
+
+    enum ArgType : uint8_t {
+        ARG_END    = 0,
+        ARG_INT    = 'i',   // 4 bytes
+        ARG_UINT   = 'u',
+        ARG_INT64  = 'I',   // 8 bytes
+        ARG_UINT64 = 'U',
+        ARG_FLOAT  = 'f',   // 4 bytes, IEEE single
+        ARG_STRING = 's',   // u8 length, then the bytes
+    };
+
+    struct Record {
+        uint32_t index;
+        uint32_t timeUs;
+        const TraceSite* site;
+        uint8_t len;
+        uint8_t args[ARG_BYTES];
+    };
+
+    template <typename... Args>
+    void write(const TraceSite* site, const Args&... args) {
+        uint32_t index = head.fetch_add(1, std::memory_order_relaxed);
+        Slot& s = slots[index & MASK];
+        s.seq.store(0, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        s.timeUs = (uint32_t)esp_timer_get_time();
+        s.site = site;
+        size_t n = 0;
+        (put(s.args, n, args), ...);
+        s.len = (uint8_t)n;
+        s.seq.store(index + 1, std::memory_order_release);
+    }
+
+    // Formats up to maxRecords records, oldest first, onto out. One caller at a time.
+    size_t drain(Print& out, size_t maxRecords) {
+        char line[MAX_LINE];
+        size_t done = 0;
+        while (done < maxRecords) {
+            uint32_t newest = head.load(std::memory_order_acquire);
+            if (tail == newest) break;
+            if (newest - tail > CAPACITY) {
+                lost.fetch_add(newest - tail - CAPACITY, std::memory_order_relaxed);
+                tail = newest - CAPACITY;
+            }
+            Record r;
+            if (!read(tail, r)) {
+                if (inProgress(tail)) break; // its writer is still at it; next time
+                lost.fetch_add(1, std::memory_order_relaxed);
+                tail++;
+                continue;
+            }
+            out.write((const uint8_t*)line, format(r, line, sizeof(line)));
+            tail++;
+            done++;
+        }
+        return done;
+    }
+
+    bool pending() const { return tail != head.load(std::memory_order_relaxed); }
+
+    // Records that were overwritten before drain() got to them.
+    uint32_t lostCount() const { return lost.load(std::memory_order_relaxed); }
+    uint32_t writtenCount() const { return head.load(std::memory_order_relaxed); }
+
+    // The ring in dump format, a piece at a time: cursor starts at 0 and is advanced past what was
+    // written. Returns 0 once the newest record is out. Independent of drain().
+    size_t dump(uint32_t& cursor, uint8_t* out, size_t capacity) const {
+        uint32_t newest = head.load(std::memory_order_acquire);
+        size_t n = 0;
+        if (cursor == 0) {
+            if (capacity < DUMP_HEADER) return 0;
+            memcpy(out, "PTRC", 4);
+            out[4] = FORMAT_VERSION;
+            out[5] = TRACE_LEVEL;
+            putLe16(out + 6, (uint16_t)CAPACITY);
+            putLe32(out + 8, newest);
+            putLe32(out + 12, lostCount());
+            n = DUMP_HEADER;
+            cursor = (newest > CAPACITY ? newest - CAPACITY : 0) + 1;
+        }
+        while (capacity - n >= DUMP_RECORD + ARG_BYTES) {
+            uint32_t index = cursor - 1;
+            if (index == newest) break;
+            if (newest - index > CAPACITY) {
+                cursor = newest - CAPACITY + 1;
+                continue;
+            }
+            cursor++;
+            Record r;
+            if (!read(index, r)) continue;
+            putLe32(out + n, r.index);
+            putLe32(out + n + 4, r.timeUs);
+            putLe32(out + n + 8, r.site->id);
+            out[n + 12] = r.site->level;
+            out[n + 13] = r.len;
+            memcpy(out + n + DUMP_RECORD, r.args, r.len);
+            n += DUMP_RECORD + r.len;
+        }
+        return n;
+    }
+
+    // "[   12.345678] I message\r\n", cut to cap.
+    static size_t format(const Record& r, char* out, size_t cap) {
+        static const char LEVELS[] = "DIWE";
+        int n = snprintf(out, cap, "[%5lu.%06lu] %c ", (unsigned long)(r.timeUs / 1000000),
+                         (unsigned long)(r.timeUs % 1000000), LEVELS[r.site->level & 3]);
+        size_t len = n > 0 && (size_t)n < cap ? (size_t)n : 0;
+        len += formatMessage(r.site->format, r.args, r.len, out + len, cap - len - 2);
+        out[len++] = '\r';
+        out[len++] = '\n';
+        return len;
+    }
+
+    // printf over stored arguments; the output is NUL-terminated and at most cap - 1 bytes long.
+    static size_t formatMessage(const char* fmt, const uint8_t* args, size_t argLen, char* out, size_t cap) {
+        size_t n = 0, pos = 0;
+        if (cap == 0) return 0;
+        while (*fmt && n + 1 < cap) {
+            if (*fmt != '%') {
+                out[n++] = *fmt++;
+                continue;
+            }
+            if (fmt[1] == '%') {
+                out[n++] = '%';
+                fmt += 2;
+                continue;
+            }
+            // %[flags][width][.precision][length]conversion, rebuilt with the stored type's length.
+            // formatArg() appends up to SPEC_SUFFIX bytes ("#llx" for %p, and the NUL).
+            char spec[24];
+            size_t s = 0;
+            spec[s++] = *fmt++;
+            while (*fmt && strchr("-+ #0123456789.", *fmt) && s < sizeof(spec) - SPEC_SUFFIX) spec[s++] = *fmt++;
+            while (*fmt && strchr("hlLqjzt", *fmt)) fmt++;
+            char conv = *fmt ? *fmt++ : 'd';
+            int written = formatArg(spec, s, conv, args, argLen, pos, out + n, cap - n);
+            if (written > 0) n += (size_t)written < cap - n ? (size_t)written : cap - n - 1;
+        }
+        out[n] = '\0';
+        return n;
+    }
+
+private:
+    static constexpr uint32_t MASK = CAPACITY - 1;
+    static constexpr size_t SPEC_SUFFIX = 5;
+    static_assert((CAPACITY & MASK) == 0, "TraceLog capacity must be a power of two");
+
+    struct Slot {
+        std::atomic<uint32_t> seq;   // index + 1 once written, 0 while being written
+        uint32_t timeUs;
+        const TraceSite* site;
+        uint8_t len;
+        uint8_t args[ARG_BYTES];
+    };
+
+    bool read(uint32_t index, Record& out) const {
+        const Slot& s = slots[index & MASK];
+        uint32_t seq = s.seq.load(std::memory_order_acquire);
+        if (seq != index + 1) return false;
+        out.index = index;
+        out.timeUs = s.timeUs;
+        out.site = s.site;
+        out.len = s.len <= ARG_BYTES ? s.len : ARG_BYTES;
+        memcpy(out.args, s.args, ARG_BYTES);
+        std::atomic_thread_fence(std::memory_order_acquire);
+        return s.seq.load(std::memory_order_relaxed) == seq;
+    }
+
+    // The slot for index is claimed but not yet (or not any more) holding a newer record.
+    bool inProgress(uint32_t index) const {
+        uint32_t seq = slots[index & MASK].seq.load(std::memory_order_acquire);
+        return seq == 0 || (int32_t)(seq - (index + 1)) < 0;
+    }
+
+    // Once an argument doesn't fit, the rest are dropped too so the ones stored stay in order.
+    static bool reserve(uint8_t* out, size_t& n, size_t need) {
+        if (n + need <= ARG_BYTES) return true;
+        if (n < ARG_BYTES) out[n] = ARG_END;
+        n = ARG_BYTES;
+        return false;
+    }
+
+    static void putString(uint8_t* out, size_t& n, const char* s, size_t len) {
+        if (!reserve(out, n, 2)) return;
+        size_t room = ARG_BYTES - n - 2;
+        if (len > MAX_STRING) len = MAX_STRING;
+        if (len > room) len = room;
+        out[n++] = ARG_STRING;
+        out[n++] = (uint8_t)len;
+        memcpy(out + n, s, len);
+        n += len;
+    }
+
+    static void put(uint8_t* out, size_t& n, const TraceBytes& b) { putString(out, n, b.data, b.len); }
+    static void put(uint8_t* out, size_t& n, const String& s) { putString(out, n, s.c_str(), s.length()); }
+
+    template <typename T>
+    static void put(uint8_t* out, size_t& n, const T& v) {
+        using D = typename std::decay<T>::type;
+        if constexpr (std::is_same<D, const char*>::value || std::is_same<D, char*>::value) {
+            const char* s = v ? (const char*)v : "(null)";
+            size_t len = 0;
+            while (len < MAX_STRING && s[len]) len++;
+            putString(out, n, s, len);
+        } else if constexpr (std::is_floating_point<D>::value) {
+            if (!reserve(out, n, 5)) return;
+            float f = (float)v;
+            uint32_t bits;
+            memcpy(&bits, &f, 4);
+            out[n] = ARG_FLOAT;
+            putLe32(out + n + 1, bits);
+            n += 5;
+        } else if constexpr (std::is_enum<D>::value) {
+            put(out, n, (int32_t)v);
+        } else if constexpr (std::is_pointer<D>::value) {
+            put(out, n, (uint64_t)(uintptr_t)v);
+        } else {
+            static_assert(std::is_integral<D>::value, "TRACE arguments: integers, floating point, strings");
+            if constexpr (sizeof(D) > 4) {
+                if (!reserve(out, n, 9)) return;
+                out[n] = std::is_signed<D>::value ? ARG_INT64 : ARG_UINT64;
+                putLe64(out + n + 1, (uint64_t)v);
+                n += 9;
+            } else {
+                if (!reserve(out, n, 5)) return;
+                out[n] = std::is_signed<D>::value ? ARG_INT : ARG_UINT;
+                putLe32(out + n + 1, (uint32_t)(int32_t)v);
+                n += 5;
+            }
+        }
+    }
+
+    // Formats the next stored argument with one conversion; '?' if it is missing or doesn't suit.
+    static int formatArg(char* spec, size_t s, char conv, const uint8_t* args, size_t argLen, size_t& pos,
+                         char* out, size_t cap) {
+        uint8_t tag = pos < argLen ? args[pos] : (uint8_t)ARG_END;
+        size_t size = tag == ARG_INT || tag == ARG_UINT || tag == ARG_FLOAT ? 4
+                    : tag == ARG_INT64 || tag == ARG_UINT64 ? 8
+                    : tag == ARG_STRING && pos + 1 < argLen ? 1 + args[pos + 1] : 0;
+        if (size == 0 || pos + 1 + size > argLen) return snprintf(out, cap, "?");
+        const uint8_t* v = args + pos + 1;
+        pos += 1 + size;
+
+        if (tag == ARG_STRING) {
+            if (conv != 's') return snprintf(out, cap, "?");
+            char text[MAX_STRING + 1];
+            memcpy(text, v + 1, v[0]);
+            text[v[0]] = '\0';
+            spec[s++] = 's';
+            spec[s] = '\0';
+            return snprintf(out, cap, spec, text);
+        }
+        double real;
+        long long integer;
+        if (tag == ARG_FLOAT) {
+            uint32_t bits = getLe32(v);
+            float f;
+            memcpy(&f, &bits, 4);
+            real = f;
+            integer = (long long)f;
+        } else {
+            integer = tag == ARG_INT ? (long long)(int32_t)getLe32(v)
+                    : tag == ARG_UINT ? (long long)getLe32(v) : (long long)getLe64(v);
+            real = tag == ARG_UINT64 ? (double)(unsigned long long)integer : (double)integer;
+        }
+        if (strchr("fFeEgGaA", conv)) {
+            spec[s++] = conv;
+            spec[s] = '\0';
+            return snprintf(out, cap, spec, real);
+        }
+        if (conv == 'c') {
+            spec[s++] = 'c';
+            spec[s] = '\0';
+            return snprintf(out, cap, spec, (int)integer);
+        }
+        if (conv == 'p') {
+            spec[s++] = '#';
+            conv = 'x';
+        } else if (!strchr("diuxXo", conv)) {
+            return snprintf(out, cap, "?");
+        }
+        spec[s++] = 'l';
+        spec[s++] = 'l';
+        spec[s++] = conv;
+        spec[s] = '\0';
+        return snprintf(out, cap, spec, integer);
+    }
+
+    Slot slots[CAPACITY];
+    std::atomic<uint32_t> head;
+    std::atomic<uint32_t> lost;
+    uint32_t tail;             // drain() only
+};
+
+// The firmware's trace ring; zero at boot (static storage).
+inline TraceLog traceLog;
+
+#define TRACE_AT(level_, format_, ...)                                                                  \
+    do {                                                                                                \
+        static constexpr TraceSite traceSite_ = {format_, traceFormatId(format_), level_};              \
+        traceLog.write(&traceSite_, ##__VA_ARGS__);                                                     \
+    } while (0)
+
+#if TRACE_LEVEL <= TRACE_LEVEL_DEBUG
+#define TRACE_DEBUG(format_, ...) TRACE_AT(TRACE_LEVEL_DEBUG, format_, ##__VA_ARGS__)
+#else
+#define TRACE_DEBUG(format_, ...) do {} while (0)
+#endif
+
+#if TRACE_LEVEL <= TRACE_LEVEL_INFO
+#define TRACE_INFO(format_, ...) TRACE_AT(TRACE_LEVEL_INFO, format_, ##__VA_ARGS__)
+#else
+#define TRACE_INFO(format_, ...) do {} while (0)
+#endif
+
+#if TRACE_LEVEL <= TRACE_LEVEL_WARN
+#define TRACE_WARN(format_, ...) TRACE_AT(TRACE_LEVEL_WARN, format_, ##__VA_ARGS__)
+#else
+#define TRACE_WARN(format_, ...) do {} while (0)
+#endif
+
+#if TRACE_LEVEL <= TRACE_LEVEL_ERROR
+#define TRACE_ERROR(format_, ...) TRACE_AT(TRACE_LEVEL_ERROR, format_, ##__VA_ARGS__)
+#else
+#define TRACE_ERROR(format_, ...) do {} while (0)
+#endif
+
+#endif // __TRACE_LOG_H__
@@ -0,0 +1,41 @@
+#ifndef __TSL2591_BUS_H__
+#define __TSL2591_BUS_H__
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Register-level access to a TSL2591. The interrupt-driven acquisition path talks to the chip
+// only through this interface, so it runs unchanged against the I2C bus (WireTsl2591Bus) or a
+// simulated sensor on a host.
+class Tsl2591Bus {
+public:
+    // Register addresses (the implementation adds the command / transaction bits).
+    static constexpr uint8_t REG_ENABLE  = 0x00;
+    static constexpr uint8_t REG_CONTROL = 0x01;
+    static constexpr uint8_t REG_AILTL   = 0x04; // ALS interrupt low threshold, CH0, 4 bytes with high
+    static constexpr uint8_t REG_PERSIST = 0x0C;
+    static constexpr uint8_t REG_STATUS  = 0x13;
+    static constexpr uint8_t REG_C0DATAL = 0x14; // CH0 low, CH0 high, CH1 low, CH1 high
+
+    static constexpr uint8_t ENABLE_PON  = 0x01;
+    static constexpr uint8_t ENABLE_AEN  = 0x02;
+    static constexpr uint8_t ENABLE_AIEN = 0x10; // persist-filtered ALS interrupt
+
+    static constexpr uint8_t STATUS_AVALID = 0x01; // an ALS cycle has completed since AEN was set
+    static constexpr uint8_t STATUS_AINT   = 0x10; // ALS interrupt asserted
+
+    // PERSIST values: every cycle raises an interrupt, or any cycle outside the thresholds.
+    static constexpr uint8_t PERSIST_EVERY = 0x00;
+    static constexpr uint8_t PERSIST_ANY   = 0x01;
+
+    // Special-function command clearing the ALS and no-persist interrupts (releases INT).
+    static constexpr uint8_t CMD_CLEAR_INTERRUPTS = 0xE7;
+
+    virtual ~Tsl2591Bus() {}
+
+    virtual bool write8(uint8_t reg, uint8_t value) = 0;
+    virtual bool command(uint8_t cmd) = 0;
+    virtual bool read(uint8_t reg, uint8_t* out, size_t len) = 0;
+};
+
+#endif // __TSL2591_BUS_H__
@@ -0,0 +1,501 @@
+#ifndef __UPLINK_H__
+#define __UPLINK_H__
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include "ByteCodec.h"
+#include "LightSample.h"
+#include "SampleCodec.h"
+#include "UplinkSpool.h"
+
+// A byte stream to the collection server: a TCP socket on the device (ArduinoUplinkTransport),
+// an in-process server in host tests (LocalUplinkServer). None of the calls block.
+class UplinkTransport {
+public:
+    virtual ~UplinkTransport() {}
+    // Starts connecting, or checks on a connection in progress. True once it is up.
+    virtual bool connect() = 0;
+    // False once the connection failed or the peer closed it.
+    virtual bool connected() = 0;
+    // Takes up to len bytes for sending; returns how many were accepted (0 if the buffer is full).
+    virtual size_t write(const uint8_t* data, size_t len) = 0;
+    // Returns bytes received so far, 0 if nothing is waiting.
+    virtual size_t read(uint8_t* out, size_t capacity) = 0;
+    virtual void close() = 0;
+};
+
+// Store-and-forward upload of samples to an HTTP collector over Wi-Fi.
+//
+// Samples are packed into batches of up to one SD block (SampleCodec, a few bytes per sample).
+// A batch is sealed when it is full, when it has been open for maxBatchAgeMs, or at a gap in
+// the sample sequence. setSampleInterval() ties the age limit to the sample rate (batchAgeFor())
+// so slow sampling still packs a useful number of samples into each batch and spool block. Sealed batches queue in RAM and, once that is full, spill oldest-first
+// to an UplinkSpool file, so a long outage costs SD space rather than samples; without a spool
+// the oldest batch is dropped (and counted).
+//
+// Batches are sent one at a time, oldest first, as HTTP/1.1 POSTs on a persistent connection
+// that stays open between requests for idleCloseMs. A 2xx reply acknowledges the batch; only
+// then is it removed (a spooled batch stays on the card until acknowledged, so a reboot mid-
+// request resends it rather than losing it). The batch sequence in the header lets the server
+// discard a resend whose reply was lost. 408, 429 and 5xx replies, timeouts and dropped
+// connections are retried after an exponential backoff; other statuses mean the server will
+// never take the batch, so it is dropped. While a backlog drains after an outage, requests are
+// spaced by drainIntervalMs so catching up does not monopolise the radio.
+//
+// Batch layout (little-endian), the POST body:
+//   0  u8  format version          4  u32 boot id (random per boot)
+//   1  u8  encoding (delta)        8  u32 batch sequence (per boot)
+//   2  u16 record count            12 u32 sample sequence of the first record
+//   16 ... SampleCodec chunk (records have consecutive sample sequences)
+//
+// add() and service() belong to one task (loop()).
+class Uplink {
+public:
+    static constexpr size_t  HEADER_SIZE       = 16;
+    static constexpr size_t  MAX_BATCH         = UplinkSpool::MAX_BATCH;
+    static constexpr size_t  QUEUE_SLOTS       = 8;
+    static constexpr size_t  MAX_RESPONSE_HEAD = 512;
+    static constexpr size_t  MAX_DEVICE_NAME   = 32;
+    static constexpr uint8_t FORMAT_VERSION    = 1;
+    static constexpr uint8_t ENCODING_DELTA    = 1;
+
+    static constexpr uint32_t BATCH_EVERY_SAMPLES = 30;
+    static constexpr uint32_t MIN_BATCH_AGE_MS    = 60000;
+    static constexpr uint32_t MAX_BATCH_AGE_MS    = 1800000;
+
+    enum State : uint8_t {
+        STATE_IDLE,        // nothing to send, or waiting for the drain interval
+        STATE_CONNECTING,
+        STATE_SENDING,     // writing the request
+        STATE_AWAITING,    // reading the reply
+        STATE_BACKOFF,     // after a failure, until the next attempt
+    };
+
+    struct Config {
+        uint32_t maxBatchAgeMs;
+        uint32_t connectTimeoutMs;
+        uint32_t responseTimeoutMs;
+        uint32_t idleCloseMs;
+        uint32_t drainIntervalMs;
+        uint32_t minBackoffMs;
+        uint32_t maxBackoffMs;
+    };
+
+    struct Stats {
+        uint32_t samples;          // added
+        uint32_t batchesSealed;
+        uint32_t batchesAcked;
+        uint32_t samplesAcked;
+        uint32_t batchesRejected;  // refused by the server and dropped
+        uint32_t retries;          // failed attempts: connect, timeout, dropped connection, 5xx
+        uint32_t connects;
+        uint32_t spilled;          // batches moved from RAM to the spool
+        uint32_t samplesDropped;   // lost to a full backlog
+        uint32_t lastRoundTripMs;
+        uint16_t lastStatus;
+    };
+
+    struct BatchHeader {
+        uint8_t  version;
+        uint8_t  encoding;
+        uint16_t recordCount;
+        uint32_t bootId;
+        uint32_t batchSequence;
+        uint32_t firstSequence;
+    };
+
+    Uplink(UplinkTransport& transport_, const char* host_, const char* path_)
+        : transport(transport_), host(host_), path(path_), spool(nullptr), bootId(0), batchSequence(0),
+          openLen(0), openCount(0), openedMs(0), nextSampleSequence(0), queueHead(0), queueCount(0),
+          haveInFlight(false), inFlightFromSpool(false), current(STATE_IDLE), linkOpen(false), reused(false),
+          stateSinceMs(0), lastRequestMs(0), lastAckMs(0), retryAtMs(0), backoffMs(0), txHeadLen(0), txSent(0),
+          headLen(0), headDone(false), bodyRemaining(0), status(0), closeAfter(false), stats() {
+        config.maxBatchAgeMs = MIN_BATCH_AGE_MS;
+        config.connectTimeoutMs = 10000;
+        config.responseTimeoutMs = 10000;
+        config.idleCloseMs = 180000;
+        config.drainIntervalMs = 250;
+        config.minBackoffMs = 2000;
+        config.maxBackoffMs = 300000;
+        deviceName[0] = '\0';
+    }
+
+    void setConfig(const Config& c) { config = c; }
+
+    // Batch age limit for a sample interval: about BATCH_EVERY_SAMPLES samples a batch, but
+    // between a minute and half an hour, which bounds how stale the collector's view can get.
+    static uint32_t batchAgeFor(uint32_t sampleIntervalMs) {
+        uint64_t ms = (uint64_t)sampleIntervalMs * BATCH_EVERY_SAMPLES;
+        if (ms < MIN_BATCH_AGE_MS) return MIN_BATCH_AGE_MS;
+        return ms > MAX_BATCH_AGE_MS ? MAX_BATCH_AGE_MS : (uint32_t)ms;
+    }
+
+    // Takes effect for the open batch too.
+    void setSampleInterval(uint32_t sampleIntervalMs) { config.maxBatchAgeMs = batchAgeFor(sampleIntervalMs); }
+
+    // Where batches go when the RAM queue is full (normally a file on the SD card).
+    void setSpool(UplinkSpool* s) { spool = s; }
+
+    // Sent with every request so the server can tell devices apart.
+    void setDeviceName(const char* name) {
+        strncpy(deviceName, name, MAX_DEVICE_NAME);
+        deviceName[MAX_DEVICE_NAME] = '\0';
+    }
+
+    // bootId distinguishes this boot's batch sequence numbers from the previous one's.
+    void begin(uint32_t bootId_) { bootId = bootId_; }
+
+    void add(const LightSample& s, uint32_t nowMs) {
+        stats.samples++;
+        if (openCount > 0 && s.sequence != nextSampleSequence) seal();
+        if (openCount == 0) openBatch(s, nowMs);
+        size_t n = encoder.encode(s, open + openLen, sizeof(open) - openLen);
+        if (n == 0) {
+            seal();
+            openBatch(s, nowMs);
+            n = encoder.encode(s, open + openLen, sizeof(open) - openLen);
+        }
+        openLen += n;
+        openCount++;
+        nextSampleSequence = s.sequence + 1;
+    }
+
+    // Seals the open batch now rather than at its age limit.
+    void flush() {
+        if (openCount > 0) seal();
+    }
+
+    // Runs the upload. Returns the number of milliseconds until it needs to run again.
+    uint32_t service(uint32_t nowMs, bool networkUp) {
+        if (openCount > 0 && nowMs - openedMs >= config.maxBatchAgeMs) seal();
+        if (!networkUp) {
+            // Not a failure of the server: whatever was in flight is simply sent again later.
+            closeLink();
+            if (current != STATE_IDLE) enter(STATE_IDLE, nowMs);
+            return idleWait(nowMs);
+        }
+
+        switch (current) {
+            case STATE_BACKOFF:
+                if ((int32_t)(retryAtMs - nowMs) > 0) return retryAtMs - nowMs;
+                enter(STATE_IDLE, nowMs);
+                // fall through
+            case STATE_IDLE: {
+                if (!haveInFlight && !takeNext()) {
+                    if (linkOpen && nowMs - lastRequestMs >= config.idleCloseMs) closeLink();
+                    return idleWait(nowMs);
+                }
+                uint32_t sinceAck = nowMs - lastAckMs;
+                if (lastAckMs != 0 && sinceAck < config.drainIntervalMs) return config.drainIntervalMs - sinceAck;
+                if (linkOpen && !transport.connected()) closeLink(); // the server closed it while idle
+                if (!linkOpen) {
+                    enter(STATE_CONNECTING, nowMs);
+                    return 0;
+                }
+                reused = true;
+                startRequest(nowMs);
+                return 0;
+            }
+            case STATE_CONNECTING:
+                if (transport.connect()) {
+                    linkOpen = true;
+                    reused = false;
+                    stats.connects++;
+                    startRequest(nowMs);
+                    return 0;
+                }
+                if (nowMs - stateSinceMs >= config.connectTimeoutMs) return fail(nowMs);
+                return 10;
+            case STATE_SENDING:
+                if (!transport.connected()) return dropped(nowMs);
+                if (!sendSome()) return 5;
+                enter(STATE_AWAITING, nowMs);
+                return 5;
+            case STATE_AWAITING:
+                return awaitReply(nowMs);
+        }
+        return 1000;
+    }
+
+    // Batches not yet acknowledged: queued, spooled and in flight.
+    uint32_t backlog() const {
+        uint32_t n = (uint32_t)queueCount + (haveInFlight && !inFlightFromSpool ? 1 : 0);
+        if (spool) n += spool->count();
+        return n;
+    }
+
+    State state() const { return current; }
+    const Stats& getStats() const { return stats; }
+
+    static const char* stateName(State s) {
+        switch (s) {
+            case STATE_IDLE:       return "idle";
+            case STATE_CONNECTING: return "connecting";
+            case STATE_SENDING:    return "sending";
+            case STATE_AWAITING:   return "awaiting";
+            case STATE_BACKOFF:    return "backoff";
+        }
+        return "?";
+    }
+
+    static bool parseHeader(const uint8_t* in, size_t len, BatchHeader& h) {
+        if (len < HEADER_SIZE || in[0] < 1) return false;
+        h.version = in[0];
+        h.encoding = in[1];
+        h.recordCount = getLe16(in + 2);
+        h.bootId = getLe32(in + 4);
+        h.batchSequence = getLe32(in + 8);
+        h.firstSequence = getLe32(in + 12);
+        return true;
+    }
+
+private:
+    struct Batch {
+        uint16_t len;
+        uint8_t bytes[MAX_BATCH];
+    };
+
+    void openBatch(const LightSample& s, uint32_t nowMs) {
+        encoder.reset();
+        openLen = HEADER_SIZE;
+        openCount = 0;
+        openedMs = nowMs;
+        putLe32(open + 12, s.sequence);
+    }
+
+    void seal() {
+        open[0] = FORMAT_VERSION;
+        open[1] = ENCODING_DELTA;
+        putLe16(open + 2, openCount);
+        putLe32(open + 4, bootId);
+        putLe32(open + 8, batchSequence++);
+        stats.batchesSealed++;
+        if (queueCount == QUEUE_SLOTS) {
+            Batch& oldest = queue[queueHead];
+            if (spool && spool->push(oldest.bytes, oldest.len)) stats.spilled++;
+            else stats.samplesDropped += getLe16(oldest.bytes + 2);
+            queueHead = (queueHead + 1) % QUEUE_SLOTS;
+            queueCount--;
+        }
+        Batch& b = queue[(queueHead + queueCount) % QUEUE_SLOTS];
+        memcpy(b.bytes, open, openLen);
+        b.len = (uint16_t)openLen;
+        queueCount++;
+        openLen = 0;
+        openCount = 0;
+    }
+
+    // The spool holds the oldest batches, so it drains first. A spooled batch is only read
+    // here; it is removed once acknowledged.
+    bool takeNext() {
+        if (spool && spool->available() && !spool->empty()) {
+            size_t len = spool->peek(inFlight.bytes, sizeof(inFlight.bytes));
+            if (len > 0) {
+                inFlight.len = (uint16_t)len;
+                haveInFlight = inFlightFromSpool = true;
+                return true;
+            }
+        }
+        if (queueCount == 0) return false;
+        inFlight = queue[queueHead];
+        queueHead = (queueHead + 1) % QUEUE_SLOTS;
+        queueCount--;
+        haveInFlight = true;
+        inFlightFromSpool = false;
+        return true;
+    }
+
+    uint32_t idleWait(uint32_t nowMs) const {
+        uint32_t wait = 1000;
+        if (openCount > 0) {
+            uint32_t age = nowMs - openedMs;
+            uint32_t left = age < config.maxBatchAgeMs ? config.maxBatchAgeMs - age : 0;
+            if (left < wait) wait = left;
+        }
+        return wait;
+    }
+
+    void enter(State s, uint32_t nowMs) {
+        current = s;
+        stateSinceMs = nowMs;
+    }
+
+    void closeLink() {
+        if (linkOpen || current == STATE_CONNECTING) transport.close();
+        linkOpen = false;
+    }
+
+    void startRequest(uint32_t nowMs) {
+        int n = snprintf(txHead, sizeof(txHead),
+                         "POST %s HTTP/1.1\r\nHost: %s\r\nContent-Type: application/octet-stream\r\n"
+                         "Content-Length: %u\r\nX-Sensor-Name: %s\r\n\r\n",
+                         path, host, (unsigned)inFlight.len, deviceName);
+        txHeadLen = n > 0 && (size_t)n < sizeof(txHead) ? (size_t)n : 0;
+        txSent = 0;
+        headLen = 0;
+        headDone = false;
+        bodyRemaining = 0;
+        status = 0;
+        closeAfter = false;
+        lastRequestMs = nowMs;
+        enter(STATE_SENDING, nowMs);
+    }
+
+    // True once the whole request has been handed to the transport.
+    bool sendSome() {
+        size_t total = txHeadLen + inFlight.len;
+        while (txSent < total) {
+            size_t n = txSent < txHeadLen
+                ? transport.write((const uint8_t*)txHead + txSent, txHeadLen - txSent)
+                : transport.write(inFlight.bytes + (txSent - txHeadLen), total - txSent);
+            if (n == 0) return false;
+            txSent += n;
+        }
+        return true;
+    }
+
+    uint32_t awaitReply(uint32_t nowMs) {
+        uint8_t buf[128];
+        size_t n;
+        while ((n = transport.read(buf, sizeof(buf))) > 0) {
+            size_t used = 0;
+            if (!headDone) {
+                used = takeHead(buf, n);
+                if (!headDone && headLen >= MAX_RESPONSE_HEAD) return fail(nowMs);
+            }
+            size_t rest = n - used;
+            bodyRemaining = rest >= bodyRemaining ? 0 : bodyRemaining - rest;
+            if (headDone && bodyRemaining == 0) return complete(nowMs);
+        }
+        if (!transport.connected()) return dropped(nowMs);
+        if (nowMs - stateSinceMs >= config.responseTimeoutMs) return fail(nowMs);
+        return 5;
+    }
+
+    // Collects the status line and headers. Returns how many of the n bytes belong to them.
+    size_t takeHead(const uint8_t* in, size_t n) {
+        size_t used = 0;
+        while (used < n && headLen < MAX_RESPONSE_HEAD) {
+            responseHead[headLen++] = (char)in[used++];
+            if (headLen >= 4 && memcmp(responseHead + headLen - 4, "\r\n\r\n", 4) == 0) {
+                responseHead[headLen] = '\0';
+                parseHead();
+                headDone = true;
+                break;
+            }
+        }
+        return used;
+    }
+
+    void parseHead() {
+        unsigned code = 0;
+        if (sscanf(responseHead, "HTTP/1.%*u %u", &code) != 1) code = 0;
+        status = (uint16_t)code;
+        const char* length = findHeader("content-length:");
+        if (length) bodyRemaining = strtoul(length, nullptr, 10);
+        const char* connection = findHeader("connection:");
+        if (connection && strncasecmp(connection, "close", 5) == 0) closeAfter = true;
+        // Without a length the body runs until the server closes; don't wait for it.
+        if (!length && status != 204 && status != 304) closeAfter = true;
+        if (strncmp(responseHead, "HTTP/1.0", 8) == 0 && !findHeader("keep-alive")) closeAfter = true;
+    }
+
+    // Value of a header (name includes the colon), leading spaces skipped; null if absent.
+    const char* findHeader(const char* name) const {
+        size_t len = strlen(name);
+        for (const char* line = strstr(responseHead, "\r\n"); line; line = strstr(line + 2, "\r\n")) {
+            if (strncasecmp(line + 2, name, len) != 0) continue;
+            const char* v = line + 2 + len;
+            while (*v == ' ' || *v == '\t') v++;
+            return v;
+        }
+        return nullptr;
+    }
+
+    uint32_t complete(uint32_t nowMs) {
+        stats.lastStatus = status;
+        stats.lastRoundTripMs = nowMs - lastRequestMs;
+        if (closeAfter) closeLink();
+        if (status == 408 || status == 429 || status >= 500 || status < 100) return fail(nowMs);
+        if (status >= 200 && status < 300) {
+            stats.batchesAcked++;
+            stats.samplesAcked += getLe16(inFlight.bytes + 2);
+        } else {
+            stats.batchesRejected++;
+        }
+        if (inFlightFromSpool) spool->pop();
+        haveInFlight = false;
+        backoffMs = 0;
+        lastAckMs = nowMs ? nowMs : 1;
+        enter(STATE_IDLE, nowMs);
+        return 0;
+    }
+
+    // The connection went away mid-request. On a reused connection that is most likely the
+    // server having timed it out while idle, so reconnect and resend at once; otherwise back off.
+    uint32_t dropped(uint32_t nowMs) {
+        if (!reused || headLen > 0) return fail(nowMs);
+        closeLink();
+        reused = false;
+        enter(STATE_CONNECTING, nowMs);
+        return 0;
+    }
+
+    uint32_t fail(uint32_t nowMs) {
+        closeLink();
+        stats.retries++;
+        backoffMs = backoffMs == 0 ? config.minBackoffMs : backoffMs * 2;
+        if (backoffMs > config.maxBackoffMs) backoffMs = config.maxBackoffMs;
+        retryAtMs = nowMs + backoffMs;
+        enter(STATE_BACKOFF, nowMs);
+        return backoffMs;
+    }
+
+    UplinkTransport& transport;
+    const char* host;
+    const char* path;
+    UplinkSpool* spool;
+    Config config;
+    char deviceName[MAX_DEVICE_NAME + 1];
+    uint32_t bootId;
+    uint32_t batchSequence;
+
+    SampleCodec::Encoder encoder;
+    uint8_t open[MAX_BATCH];
+    size_t openLen;
+    uint16_t openCount;
+    uint32_t openedMs;
+    uint32_t nextSampleSequence;
+
+    Batch queue[QUEUE_SLOTS];
+    size_t queueHead;
+    size_t queueCount;
+    Batch inFlight;
+    bool haveInFlight;
+    bool inFlightFromSpool;
+
+    State current;
+    bool linkOpen;
+    bool reused;
+    uint32_t stateSinceMs;
+    uint32_t lastRequestMs;
+    uint32_t lastAckMs;
+    uint32_t retryAtMs;
+    uint32_t backoffMs;
+    char txHead[256];
+    size_t txHeadLen;
+    size_t txSent;
+    char responseHead[MAX_RESPONSE_HEAD + 1];
+    size_t headLen;
+    bool headDone;
+    size_t bodyRemaining;
+    uint16_t status;
+    bool closeAfter;
+    Stats stats;
+};
+
+#endif // __UPLINK_H__
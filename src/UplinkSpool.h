@@ -0,0 +1,125 @@
+#ifndef __UPLINK_SPOOL_H__
+#define __UPLINK_SPOOL_H__
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include "BlockFile.h"
+#include "ByteCodec.h"
+#include "Crc32.h"
+
+// First-in, first-out queue of uplink batches in a preallocated file, one batch per block, for
+// when the RAM queue overflows while the network is down. Block 0 holds the queue state and
+// blocks 1..capacity form the ring, so the file never grows and a power cut loses at most the
+// batch being written.
+//
+// State block (little-endian):          Batch block:
+//   0  u32 magic "PIQU"                   0  u32 CRC-32 of bytes 4..511
+//   4  u8  format version                 4  u16 batch length
+//   8  u32 capacity (blocks)              6  ... batch
+//   12 u32 head (oldest batch, 0-based)
+//   16 u32 count
+//   20 u32 CRC-32 of bytes 0..19
+class UplinkSpool {
+public:
+    static constexpr size_t   BLOCK_SIZE       = BlockFile::BLOCK_SIZE;
+    static constexpr size_t   MAX_BATCH        = BLOCK_SIZE - 6;
+    static constexpr uint32_t MAGIC            = 0x55514950; // "PIQU"
+    static constexpr uint8_t  FORMAT_VERSION   = 1;
+    static constexpr uint32_t DEFAULT_CAPACITY = 2048;       // 1 MB
+
+    UplinkSpool(BlockFile& file_, const char* name_, uint32_t capacity_ = DEFAULT_CAPACITY)
+        : file(file_), name(name_), capacity(capacity_), head(0), used(0), ready(false), failed(false), corrupt(0) {}
+
+    // Opens (creating if needed) the spool file and picks up a queue left by the previous boot.
+    // Called lazily by the first push or pop; false if the medium is unusable.
+    bool begin() {
+        if (ready) return true;
+        if (failed) return false;
+        if (!file.open(name, true, capacity + 1) || file.blockCount() < capacity + 1) {
+            file.close();
+            failed = true;
+            return false;
+        }
+        uint8_t block[BLOCK_SIZE];
+        head = used = 0;
+        if (file.readBlock(0, block) && getLe32(block) == MAGIC && block[4] == FORMAT_VERSION &&
+            getLe32(block + 8) == capacity && Crc32::compute(block, 20) == getLe32(block + 20)) {
+            uint32_t h = getLe32(block + 12), n = getLe32(block + 16);
+            if (h < capacity && n <= capacity) {
+                head = h;
+                used = n;
+            }
+        }
+        ready = true;
+        return true;
+    }
+
+    bool available() { return begin(); }
+    bool empty() const { return used == 0; }
+    bool full() const { return used >= capacity; }
+    uint32_t count() const { return used; }
+
+    bool push(const uint8_t* batch, size_t len) {
+        if (len > MAX_BATCH || !begin() || full()) return false;
+        uint8_t block[BLOCK_SIZE];
+        memset(block, 0, sizeof(block));
+        putLe16(block + 4, (uint16_t)len);
+        memcpy(block + 6, batch, len);
+        putLe32(block, Crc32::compute(block + 4, BLOCK_SIZE - 4));
+        if (!file.writeBlock(1 + (head + used) % capacity, block)) return false;
+        used++;
+        return writeState();
+    }
+
+    // Copies the oldest batch out without removing it. Returns its length, 0 if the queue is
+    // empty. A batch that fails its CRC is dropped and the next one tried.
+    size_t peek(uint8_t* out, size_t outLen) {
+        uint8_t block[BLOCK_SIZE];
+        while (begin() && used > 0) {
+            if (file.readBlock(1 + head, block) && Crc32::compute(block + 4, BLOCK_SIZE - 4) == getLe32(block)) {
+                size_t len = getLe16(block + 4);
+                if (len > 0 && len <= MAX_BATCH && len <= outLen) {
+                    memcpy(out, block + 6, len);
+                    return len;
+                }
+            }
+            corrupt++;
+            if (!pop()) return 0;
+        }
+        return 0;
+    }
+
+    bool pop() {
+        if (!begin() || used == 0) return false;
+        head = (head + 1) % capacity;
+        used--;
+        return writeState();
+    }
+
+    uint32_t corruptCount() const { return corrupt; }
+
+private:
+    bool writeState() {
+        uint8_t block[BLOCK_SIZE];
+        memset(block, 0, sizeof(block));
+        putLe32(block, MAGIC);
+        block[4] = FORMAT_VERSION;
+        putLe32(block + 8, capacity);
+        putLe32(block + 12, head);
+        putLe32(block + 16, used);
+        putLe32(block + 20, Crc32::compute(block, 20));
+        return file.writeBlock(0, block) && file.sync();
+    }
+
+    BlockFile& file;
+    const char* name;
+    uint32_t capacity;
+    uint32_t head;
+    uint32_t used;
+    bool ready;
+    bool failed;
+    uint32_t corrupt;
+};
+
+#endif // __UPLINK_SPOOL_H__
@@ -0,0 +1,231 @@
+#ifndef __WIFI_CONNECTION_H__
+#define __WIFI_CONNECTION_H__
+
+#include <mutex>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include "WifiDriver.h"
+
+// Event-driven Wi-Fi station connection. Nothing here waits on the radio: configure() only
+// records a request (safe from the NimBLE host task), and service(), called periodically from
+// loop(), polls the driver and moves the state machine:
+//
+//   DISABLED / IDLE --configure--> CONNECTING --link up--> CONNECTED
+//                                      |  ^                    |
+//                       fail / timeout v  | backoff elapsed    | link lost
+//                                    BACKOFF <-----------------+ (reconnects at once first)
+//
+// Failed attempts back off exponentially (backoffMinMs doubling up to backoffMaxMs); a
+// successful connection resets the backoff. Listeners hear about each state change, so status
+// is pushed when it changes instead of being polled.
+class WifiConnection {
+public:
+    static constexpr size_t MAX_SSID      = 32;
+    static constexpr size_t MAX_PASSWORD  = 64;
+    static constexpr size_t MAX_LISTENERS = 4;
+
+    enum State : uint8_t {
+        STATE_DISABLED,   // Wi-Fi turned off in settings
+        STATE_IDLE,       // enabled, but no credentials
+        STATE_CONNECTING,
+        STATE_CONNECTED,
+        STATE_BACKOFF,    // waiting to retry after a failed attempt
+    };
+
+    struct Config {
+        uint32_t attemptTimeoutMs;
+        uint32_t backoffMinMs;
+        uint32_t backoffMaxMs;
+    };
+
+    struct Stats {
+        uint32_t attempts;
+        uint32_t connects;
+        uint32_t failures;   // attempts that timed out or were refused
+        uint32_t drops;      // established links that went down
+    };
+
+    // ssid is the network of the current attempt or connection ("" when there is none).
+    using ListenerFn = void (*)(void* context, State state, const char* ssid);
+
+    explicit WifiConnection(WifiDriver& driver_)
+        : driver(driver_), current(STATE_DISABLED), retryRequested(false), requestPending(false), requestEnabled(false),
+          attemptStartMs(0), retryAtMs(0), backoffMs(0), listenerCount(0), stats() {
+        config.attemptTimeoutMs = 15000;
+        config.backoffMinMs = 2000;
+        config.backoffMaxMs = 120000;
+        backoffMs = config.backoffMinMs;
+        ssid[0] = password[0] = '\0';
+        requestSsid[0] = requestPassword[0] = '\0';
+    }
+
+    void setConfig(const Config& c) {
+        config = c;
+        if (backoffMs < config.backoffMinMs || backoffMs > config.backoffMaxMs) backoffMs = config.backoffMinMs;
+    }
+
+    // Requests a network (or, with enabled false, turning Wi-Fi off). Returns immediately; the
+    // next service() acts on it. A request for the network already connected is a no-op.
+    void configure(const char* ssid_, const char* password_, bool enabled) {
+        std::lock_guard<std::mutex> lock(mutex);
+        copyText(requestSsid, sizeof(requestSsid), ssid_);
+        copyText(requestPassword, sizeof(requestPassword), password_);
+        requestEnabled = enabled;
+        requestPending = true;
+    }
+
+    // Skips the remaining backoff and tries again on the next service().
+    void retryNow() {
+        retryRequested = true;
+    }
+
+    bool addListener(ListenerFn fn, void* context = nullptr) {
+        if (listenerCount >= MAX_LISTENERS) return false;
+        listeners[listenerCount].fn = fn;
+        listeners[listenerCount].context = context;
+        listenerCount++;
+        return true;
+    }
+
+    // Advances the state machine. Returns the state after this step.
+    State service(uint32_t nowMs) {
+        State before = current;
+        applyRequest(nowMs);
+        bool retry = retryRequested;
+        retryRequested = false;
+        if (retry) backoffMs = config.backoffMinMs;
+
+        switch (current) {
+            case STATE_CONNECTING: {
+                WifiDriver::LinkStatus link = driver.status();
+                if (link == WifiDriver::LINK_UP) {
+                    current = STATE_CONNECTED;
+                    backoffMs = config.backoffMinMs;
+                    stats.connects++;
+                } else if (link == WifiDriver::LINK_NO_AP || link == WifiDriver::LINK_AUTH_FAILED ||
+                           nowMs - attemptStartMs >= config.attemptTimeoutMs) {
+                    fail(nowMs);
+                }
+                break;
+            }
+            case STATE_CONNECTED:
+                if (driver.status() != WifiDriver::LINK_UP) {
+                    // A dropped link usually comes straight back; retry once before backing off.
+                    stats.drops++;
+                    startAttempt(nowMs);
+                }
+                break;
+            case STATE_BACKOFF:
+                if (retry || (int32_t)(nowMs - retryAtMs) >= 0) startAttempt(nowMs);
+                break;
+            default:
+                break;
+        }
+
+        if (current != before) notify();
+        return current;
+    }
+
+    State state() const { return current; }
+    bool connected() const { return current == STATE_CONNECTED; }
+    const Stats& getStats() const { return stats; }
+
+    // Delay before the next retry once the current attempt fails.
+    uint32_t currentBackoffMs() const { return backoffMs; }
+
+    // The network being used; only valid on the task that calls service().
+    const char* currentSsid() const { return ssid; }
+
+    static const char* stateName(State s) {
+        switch (s) {
+            case STATE_DISABLED:   return "disabled";
+            case STATE_IDLE:       return "idle";
+            case STATE_CONNECTING: return "connecting";
+            case STATE_CONNECTED:  return "connected";
+            case STATE_BACKOFF:    return "backoff";
+        }
+        return "?";
+    }
+
+private:
+    struct Listener {
+        ListenerFn fn;
+        void* context;
+    };
+
+    static void copyText(char* dst, size_t cap, const char* src) {
+        size_t len = src ? strnlen(src, cap - 1) : 0;
+        memcpy(dst, src, len);
+        dst[len] = '\0';
+    }
+
+    void applyRequest(uint32_t nowMs) {
+        char nextSsid[MAX_SSID + 1];
+        char nextPassword[MAX_PASSWORD + 1];
+        bool enabled;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (!requestPending) return;
+            requestPending = false;
+            memcpy(nextSsid, requestSsid, sizeof(nextSsid));
+            memcpy(nextPassword, requestPassword, sizeof(nextPassword));
+            enabled = requestEnabled;
+        }
+
+        bool same = strcmp(nextSsid, ssid) == 0 && strcmp(nextPassword, password) == 0;
+        bool active = current == STATE_CONNECTING || current == STATE_CONNECTED || current == STATE_BACKOFF;
+        if (enabled && same && active) return;
+
+        if (current == STATE_CONNECTING || current == STATE_CONNECTED) driver.disconnect();
+        memcpy(ssid, nextSsid, sizeof(ssid));
+        memcpy(password, nextPassword, sizeof(password));
+        backoffMs = config.backoffMinMs;
+
+        if (!enabled) current = STATE_DISABLED;
+        else if (ssid[0] == '\0') current = STATE_IDLE;
+        else startAttempt(nowMs);
+    }
+
+    void startAttempt(uint32_t nowMs) {
+        stats.attempts++;
+        attemptStartMs = nowMs;
+        current = STATE_CONNECTING;
+        driver.begin(ssid, password);
+    }
+
+    void fail(uint32_t nowMs) {
+        stats.failures++;
+        driver.disconnect();
+        current = STATE_BACKOFF;
+        retryAtMs = nowMs + backoffMs;
+        backoffMs = backoffMs >= config.backoffMaxMs / 2 ? config.backoffMaxMs : backoffMs * 2;
+    }
+
+    void notify() {
+        const char* network = (current == STATE_DISABLED || current == STATE_IDLE) ? "" : ssid;
+        for (size_t i = 0; i < listenerCount; i++) listeners[i].fn(listeners[i].context, current, network);
+    }
+
+    WifiDriver& driver;
+    Config config;
+    volatile State current;
+    volatile bool retryRequested;
+    char ssid[MAX_SSID + 1];
+    char password[MAX_PASSWORD + 1];
+
+    std::mutex mutex; // guards the request fields
+    bool requestPending;
+    char requestSsid[MAX_SSID + 1];
+    char requestPassword[MAX_PASSWORD + 1];
+    bool requestEnabled;
+
+    uint32_t attemptStartMs;
+    uint32_t retryAtMs;
+    uint32_t backoffMs;
+    Listener listeners[MAX_LISTENERS];
+    size_t listenerCount;
+    Stats stats;
+};
+
+#endif // __WIFI_CONNECTION_H__
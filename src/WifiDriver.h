@@ -0,0 +1,56 @@
+#ifndef __WIFI_DRIVER_H__
+#define __WIFI_DRIVER_H__
+
+#include <stddef.h>
+#include <stdint.h>
+
+// The few radio operations WifiConnection and WifiScanner need, none of which block: begin()
+// only starts association and status() reports how far it got; startScan() starts a scan and
+// scanStatus() reports when it is done. ArduinoWifiDriver runs them on the ESP32 Wi-Fi stack;
+// a simulated access point stands in on a host.
+class WifiDriver {
+public:
+    enum LinkStatus : uint8_t {
+        LINK_DOWN,        // not associated (includes "still trying")
+        LINK_UP,          // associated and holding an IP address
+        LINK_NO_AP,       // the SSID is not in range
+        LINK_AUTH_FAILED, // the AP rejected the password
+    };
+
+    // Same values as ESP-IDF's wifi_auth_mode_t, so they go over the air unchanged.
+    enum AuthMode : uint8_t {
+        AUTH_OPEN            = 0,
+        AUTH_WEP             = 1,
+        AUTH_WPA_PSK         = 2,
+        AUTH_WPA2_PSK        = 3,
+        AUTH_WPA_WPA2_PSK    = 4,
+        AUTH_WPA2_ENTERPRISE = 5,
+        AUTH_WPA3_PSK        = 6,
+        AUTH_WPA2_WPA3_PSK   = 7,
+    };
+
+    struct ScanEntry {
+        char ssid[33];
+        int8_t rssi;      // dBm
+        uint8_t channel;
+        uint8_t auth;     // AuthMode
+    };
+
+    static constexpr int SCAN_RUNNING = -1;
+    static constexpr int SCAN_FAILED  = -2;
+
+    virtual ~WifiDriver() {}
+    virtual void begin(const char* ssid, const char* password) = 0;
+    virtual void disconnect() = 0;
+    virtual LinkStatus status() = 0;
+
+    // Starts an asynchronous scan of all channels. False if one could not be started.
+    virtual bool startScan() = 0;
+    // SCAN_RUNNING, SCAN_FAILED, or the number of networks found once the scan is complete.
+    virtual int scanStatus() = 0;
+    virtual bool scanEntry(int index, ScanEntry& out) = 0;
+    // Releases the stack's copy of the results.
+    virtual void scanDelete() = 0;
+};
+
+#endif // __WIFI_DRIVER_H__
@@ -3,6 +3,8 @@
 
 #include <Arduino.h>
 #include <WiFi.h>
+#include <esp_wifi.h>
+#include "TraceLog.h"
 
 struct WifiCredentials {
     String ssid;
@@ -14,30 +16,8 @@ public:
     WifiNetwork() {
     }
 
-    bool connect(WifiCredentials creds) {
-        Serial.print("Connecting to Wi-Fi on ");
-        Serial.print(creds.ssid);
-        Serial.print(" ...");
-        WiFi.begin(creds.ssid, creds.password);
-        int attempts = 0;
-        while (WiFi.status() != WL_CONNECTED && attempts < 20) {
-            delay(CONNECT_WAIT_DELAY);
-            Serial.print(".");
-            attempts++;
-        }
-        if (WiFi.status() == WL_CONNECTED) {
-            Serial.println("\nConnected!");
-            return true;
-        } else {
-            Serial.println("\nFailed to connect.");
-            return false;
-        }
-    }
-
-    void connect(const char* ssid_, const char* password_) {
-        WifiCredentials creds = {String(ssid_), String(password_)};
-        connect(creds);
-    }
+    // Connecting is WifiConnection's job (non-blocking); this class reports on the link. Reports
+    // go to the trace log, which formats them off the calling task.
 
     bool isConnected() {
         return WiFi.status() == WL_CONNECTED;
@@ -45,32 +25,31 @@ public:
 
     void disconnect() {
         WiFi.disconnect();
-        Serial.println("Disconnected from Wi-Fi.");
+        TRACE_INFO("wifi: disconnected");
     }
 
     void printStatus() {
         if (isConnected()) {
-            Serial.println("Wi-Fi is connected.");
-            Serial.print("IP Address: ");
-            Serial.println(WiFi.localIP());
+            IPAddress ip = WiFi.localIP();
+            TRACE_INFO("wifi: connected, IP %u.%u.%u.%u", ip[0], ip[1], ip[2], ip[3]);
         } else {
-            Serial.println("Wi-Fi is not connected.");
+            TRACE_INFO("wifi: not connected");
         }
     }
     void printSSID() {
-        Serial.print("Current SSID: ");
-        Serial.println(WiFi.SSID());
+        TRACE_INFO("wifi: SSID %s", WiFi.SSID());
     }
 
     void printSignalStrength() {
-        long rssi = WiFi.RSSI();
-        Serial.print("Signal Strength (RSSI): ");
-        Serial.println(rssi);
+        TRACE_INFO("wifi: RSSI %d dBm", WiFi.RSSI());
     }
 
     void printBSSID() {
-        Serial.print("BSSID: ");
-        Serial.println(WiFi.BSSIDstr());
+        const uint8_t* b = WiFi.BSSID();
+        if (!b) return;
+        uint64_t bssid = 0;
+        for (int i = 0; i < 6; i++) bssid = (bssid << 8) | b[i];
+        TRACE_INFO("wifi: BSSID %012llx", bssid);
     }
 
     String getSSID(){
@@ -81,43 +60,25 @@ public:
     }
 
     void printEncryptionType() {
-        Serial.print("Encryption Type: ");
-        // ESP32 does not provide encryption type for the connected network directly
-        // So we scan and match SSID
-        int n = WiFi.scanNetworks();
-        for (int i = 0; i < n; ++i) {
-            if (WiFi.SSID(i) == WiFi.SSID()) {
-                uint8_t encType = WiFi.encryptionType(i);
-                switch (encType) {
-                    case WIFI_AUTH_OPEN:
-                        Serial.println("Open");
-                        break;
-                    case WIFI_AUTH_WEP:
-                        Serial.println("WEP");
-                        break;
-                    case WIFI_AUTH_WPA_PSK:
-                        Serial.println("WPA_PSK");
-                        break;
-                    case WIFI_AUTH_WPA2_PSK:
-                        Serial.println("WPA2_PSK");
-                        break;
-                    case WIFI_AUTH_WPA_WPA2_PSK:
-                        Serial.println("WPA_WPA2_PSK");
-                        break;
-                    case WIFI_AUTH_WPA2_ENTERPRISE:
-                        Serial.println("WPA2_ENTERPRISE");
-                        break;
-                    default:
-                        Serial.println("Unknown");
-                }
-                return;
+        // The station's AP record carries the auth mode of the connected network; no scan needed.
+        const char* type = "Unknown";
+        wifi_ap_record_t ap;
+        if (esp_wifi_sta_get_ap_info(&ap) == ESP_OK) {
+            switch (ap.authmode) {
+                case WIFI_AUTH_OPEN:            type = "Open"; break;
+                case WIFI_AUTH_WEP:             type = "WEP"; break;
+                case WIFI_AUTH_WPA_PSK:         type = "WPA_PSK"; break;
+                case WIFI_AUTH_WPA2_PSK:        type = "WPA2_PSK"; break;
+                case WIFI_AUTH_WPA_WPA2_PSK:    type = "WPA_WPA2_PSK"; break;
+                case WIFI_AUTH_WPA2_ENTERPRISE: type = "WPA2_ENTERPRISE"; break;
+                default: break;
             }
         }
-        Serial.println("Unknown");
+        TRACE_INFO("wifi: encryption %s", type);
     }
     void printNetworkDetails() {
         if (!isConnected()) {
-            Serial.println("Not connected to any Wi-Fi network.");
+            TRACE_INFO("wifi: not connected to any network");
             return;
         }
         printStatus();
@@ -139,9 +100,6 @@ public:
         }
         return creds;
     }
-
-private:
-    static const int CONNECT_WAIT_DELAY = 1000;
 };
 
 #endif // __WIFI_NETWORK_H__
\ No newline at end of file
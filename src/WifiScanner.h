@@ -0,0 +1,255 @@
+#ifndef __WIFI_SCANNER_H__
+#define __WIFI_SCANNER_H__
+
+#include <mutex>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include "WifiDriver.h"
+
+// Asynchronous Wi-Fi scan with a result cache. request() returns at once from any task (the
+// BLE write callback included); service(), called from loop(), starts the scan, collects the
+// results when the radio is done and tells listeners. A request made while the cache is younger
+// than the TTL is answered from the cache without touching the radio.
+//
+// Results are one entry per SSID (the strongest AP when several share a name; hidden networks
+// are left out), sorted by RSSI, strongest first, and are shipped as binary chunks that fit a
+// notification:
+//   chunk   u8 generation, u8 chunk index, u8 flags (bit 0: last, bit 1: scan failed),
+//           u8 record count, records...
+//   record  u8 SSID length, SSID bytes, i8 RSSI dBm, u8 channel, u8 auth (WifiDriver::AuthMode)
+// generation changes with every completed scan, so a central can tell a fresh list from a
+// repeat and spot chunks of two different scans interleaved. Records never straddle chunks.
+class WifiScanner {
+public:
+    static constexpr size_t   MAX_RESULTS     = 32;
+    static constexpr size_t   CHUNK_HEADER    = 4;
+    static constexpr size_t   MAX_RECORD_SIZE = 1 + 32 + 3;
+    static constexpr uint32_t DEFAULT_TTL_MS  = 30000;
+    static constexpr uint32_t SCAN_TIMEOUT_MS = 15000;
+    static constexpr size_t   MAX_LISTENERS   = 2;
+
+    enum Request : uint8_t {
+        REQUEST_STARTED, // a scan will start on the next service()
+        REQUEST_PENDING, // a scan is already under way; its results will be delivered
+        REQUEST_CACHED,  // the cache is fresh; it will be delivered on the next service()
+    };
+
+    enum ChunkFlags : uint8_t {
+        CHUNK_LAST   = 0x01,
+        CHUNK_FAILED = 0x02,
+    };
+
+    struct Stats {
+        uint32_t requests;
+        uint32_t cacheHits;
+        uint32_t scans;
+        uint32_t failures;
+        uint32_t lastScanMs; // duration of the most recent scan
+    };
+
+    // Results are ready (or the scan failed, ok false) and may be read from this task.
+    using ListenerFn = void (*)(void* context, bool ok);
+
+    explicit WifiScanner(WifiDriver& driver_, uint32_t ttlMs_ = DEFAULT_TTL_MS)
+        : driver(driver_), ttlMs(ttlMs_), startRequested(false), deliverRequested(false), scanning(false),
+          haveResults(false), lastOk(false), completedMs(0), startedMs(0), resultCount(0), gen(0),
+          listenerCount(0), stats() {}
+
+    Request request(uint32_t nowMs) {
+        std::lock_guard<std::mutex> lock(mutex);
+        stats.requests++;
+        if (scanning || startRequested) return REQUEST_PENDING;
+        if (haveResults && nowMs - completedMs < ttlMs) {
+            stats.cacheHits++;
+            deliverRequested = true;
+            return REQUEST_CACHED;
+        }
+        startRequested = true;
+        return REQUEST_STARTED;
+    }
+
+    bool addListener(ListenerFn fn, void* context = nullptr) {
+        if (listenerCount >= MAX_LISTENERS) return false;
+        listeners[listenerCount].fn = fn;
+        listeners[listenerCount].context = context;
+        listenerCount++;
+        return true;
+    }
+
+    void service(uint32_t nowMs) {
+        bool start, deliver;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            start = startRequested && !scanning;
+            deliver = deliverRequested;
+            deliverRequested = false;
+        }
+
+        if (start) {
+            bool started = driver.startScan();
+            std::lock_guard<std::mutex> lock(mutex);
+            startRequested = false;
+            scanning = started;
+            startedMs = nowMs;
+            if (!started) {
+                stats.failures++;
+                lastOk = false;
+                deliver = true;
+            }
+        } else if (scanning) {
+            int n = driver.scanStatus();
+            bool timedOut = nowMs - startedMs >= SCAN_TIMEOUT_MS;
+            if (n != WifiDriver::SCAN_RUNNING || timedOut) {
+                bool ok = n >= 0;
+                if (ok) collect(n);
+                driver.scanDelete();
+                std::lock_guard<std::mutex> lock(mutex);
+                scanning = false;
+                lastOk = ok;
+                stats.lastScanMs = nowMs - startedMs;
+                if (ok) {
+                    haveResults = true;
+                    completedMs = nowMs;
+                    gen++;
+                    stats.scans++;
+                } else {
+                    stats.failures++;
+                }
+                deliver = true;
+            }
+        }
+
+        if (deliver) {
+            for (size_t i = 0; i < listenerCount; i++) listeners[i].fn(listeners[i].context, lastOk);
+        }
+    }
+
+    // The cached results; read them on the task that calls service().
+    size_t count() const { return resultCount; }
+    const WifiDriver::ScanEntry& entry(size_t i) const { return results[i]; }
+    uint8_t generation() const { return gen; }
+    bool scanInProgress() const { return scanning; }
+    bool lastScanOk() const { return lastOk; }
+    const Stats& getStats() const { return stats; }
+
+    bool find(const char* ssid, WifiDriver::ScanEntry& out) const {
+        for (size_t i = 0; i < resultCount; i++) {
+            if (strcmp(results[i].ssid, ssid) == 0) {
+                out = results[i];
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // Writes the chunk holding the records from cursor on, as many as fit in maxLen, and
+    // advances cursor. Start with cursor 0 and chunk index 0; the chunk flagged CHUNK_LAST
+    // ends the list (an empty or failed scan is a single such chunk). Returns 0 if maxLen
+    // cannot hold the header plus the next record.
+    size_t encodeChunk(size_t& cursor, uint8_t chunkIndex, uint8_t* out, size_t maxLen) const {
+        if (maxLen < CHUNK_HEADER) return 0;
+        size_t n = CHUNK_HEADER;
+        uint8_t records = 0;
+        size_t i = lastOk ? cursor : resultCount;
+        for (; i < resultCount; i++) {
+            const WifiDriver::ScanEntry& e = results[i];
+            size_t ssidLen = strnlen(e.ssid, sizeof(e.ssid) - 1);
+            if (n + 1 + ssidLen + 3 > maxLen) break;
+            out[n++] = (uint8_t)ssidLen;
+            memcpy(out + n, e.ssid, ssidLen);
+            n += ssidLen;
+            out[n++] = (uint8_t)e.rssi;
+            out[n++] = e.channel;
+            out[n++] = e.auth;
+            records++;
+        }
+        if (records == 0 && i < resultCount) return 0;
+        out[0] = gen;
+        out[1] = chunkIndex;
+        out[2] = (uint8_t)((i >= resultCount ? CHUNK_LAST : 0) | (lastOk ? 0 : CHUNK_FAILED));
+        out[3] = records;
+        cursor = i;
+        return n;
+    }
+
+    // Comma-separated SSIDs, strongest first, truncated at a whole name to fit capacity
+    // (including the terminator). Returns the length written.
+    size_t formatSsidList(char* out, size_t capacity) const {
+        if (capacity == 0) return 0;
+        size_t n = 0;
+        for (size_t i = 0; i < resultCount; i++) {
+            size_t len = strlen(results[i].ssid);
+            size_t sep = n > 0 ? 2 : 0;
+            if (n + sep + len + 1 > capacity) break;
+            if (sep) { out[n++] = ','; out[n++] = ' '; }
+            memcpy(out + n, results[i].ssid, len);
+            n += len;
+        }
+        out[n] = '\0';
+        return n;
+    }
+
+private:
+    struct Listener {
+        ListenerFn fn;
+        void* context;
+    };
+
+    void collect(int found) {
+        resultCount = 0;
+        for (int i = 0; i < found; i++) {
+            WifiDriver::ScanEntry e;
+            if (!driver.scanEntry(i, e) || e.ssid[0] == '\0') continue;
+            e.ssid[sizeof(e.ssid) - 1] = '\0';
+
+            // Same SSID from several APs: keep the strongest.
+            size_t at = resultCount;
+            for (size_t j = 0; j < resultCount; j++) {
+                if (strcmp(results[j].ssid, e.ssid) == 0) { at = j; break; }
+            }
+            if (at < resultCount) {
+                if (e.rssi <= results[at].rssi) continue;
+                removeAt(at);
+            } else if (resultCount == MAX_RESULTS) {
+                if (e.rssi <= results[resultCount - 1].rssi) continue;
+                resultCount--; // drop the weakest
+            }
+            insertSorted(e);
+        }
+    }
+
+    void removeAt(size_t at) {
+        for (size_t j = at; j + 1 < resultCount; j++) results[j] = results[j + 1];
+        resultCount--;
+    }
+
+    void insertSorted(const WifiDriver::ScanEntry& e) {
+        size_t j = resultCount++;
+        while (j > 0 && results[j - 1].rssi < e.rssi) {
+            results[j] = results[j - 1];
+            j--;
+        }
+        results[j] = e;
+    }
+
+    WifiDriver& driver;
+    uint32_t ttlMs;
+    std::mutex mutex; // request() runs on other tasks
+    bool startRequested;
+    bool deliverRequested;
+    volatile bool scanning;
+    bool haveResults;
+    bool lastOk;
+    uint32_t completedMs;
+    uint32_t startedMs;
+
+    WifiDriver::ScanEntry results[MAX_RESULTS];
+    size_t resultCount;
+    uint8_t gen;
+    Listener listeners[MAX_LISTENERS];
+    size_t listenerCount;
+    Stats stats;
+};
+
+#endif // __WIFI_SCANNER_H__
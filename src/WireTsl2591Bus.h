@@ -0,0 +1,41 @@
+#ifndef __WIRE_TSL2591_BUS_H__
+#define __WIRE_TSL2591_BUS_H__
+
+#include <Wire.h>
+#include "Tsl2591Bus.h"
+
+// Tsl2591Bus over the Arduino Wire library, at the chip's fixed address.
+class WireTsl2591Bus : public Tsl2591Bus {
+public:
+    static constexpr uint8_t ADDRESS     = 0x29;
+    static constexpr uint8_t COMMAND_BIT = 0xA0; // command, normal register transaction
+
+    explicit WireTsl2591Bus(TwoWire& wire_ = Wire) : wire(wire_) {}
+
+    bool write8(uint8_t reg, uint8_t value) override {
+        wire.beginTransmission(ADDRESS);
+        wire.write((uint8_t)(COMMAND_BIT | reg));
+        wire.write(value);
+        return wire.endTransmission() == 0;
+    }
+
+    bool command(uint8_t cmd) override {
+        wire.beginTransmission(ADDRESS);
+        wire.write(cmd);
+        return wire.endTransmission() == 0;
+    }
+
+    bool read(uint8_t reg, uint8_t* out, size_t len) override {
+        wire.beginTransmission(ADDRESS);
+        wire.write((uint8_t)(COMMAND_BIT | reg));
+        if (wire.endTransmission() != 0) return false;
+        if (wire.requestFrom(ADDRESS, (uint8_t)len) != len) return false;
+        for (size_t i = 0; i < len; i++) out[i] = (uint8_t)wire.read();
+        return true;
+    }
+
+private:
+    TwoWire& wire;
+};
+
+#endif // __WIRE_TSL2591_BUS_H__
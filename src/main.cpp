@@ -2,88 +2,667 @@
 #include <SPI.h>
 #include <Wire.h>
 #include "RealtimeClock.h"
+#include "NtpSync.h"
+#include "ArduinoNtpTransport.h"
+#include "Timebase.h"
+#include "Uplink.h"
+#include "UplinkSpool.h"
+#include "ArduinoUplinkTransport.h"
+#include "HttpServer.h"
+#include "ArduinoHttpTransport.h"
 #include "WifiNetwork.h"
+#include "WifiConnection.h"
+#include "ArduinoWifiDriver.h"
+#include "WifiScanner.h"
 #include "LightSensor.h"
 // Removed LightDisplay.h include
 #include "FileLogger.h"
 #include "BLELightSensorService.h"
 #include "Settings.h"
+#include "PreferencesSettingsStore.h"
+#include "Scheduler.h"
+#include "SensorTask.h"
+#include "HistoryTransfer.h"
+#include "SampleLogReader.h"
+#include "StreamingStats.h"
+#include "BootSequence.h"
+#include "TraceLog.h"
 
 
 // Helper functions
 // Removed GetDisplayValues callback and related display code
 void waitForSerial(uint16_t timeout = 2000);
 
-SettingsManager settingsManager;
+PreferencesSettingsStore settingsStore;
+SettingsManager settingsManager(settingsStore); // Settings cache; changes reach NVS as one debounced blob write.
 
 WifiNetwork wifiNetwork; // Create an instance of the WifiNetwork class.
+ArduinoWifiDriver wifiDriver;
+WifiConnection wifiConnection(wifiDriver); // Connects and reconnects in the background, driven from loop().
+WifiScanner wifiScanner(wifiDriver);       // Asynchronous scans, cached for repeat requests.
 
-RealtimeClock realtimeClock(wifiNetwork); // Create an instance of the RealtimeClock class. Uses WifiNetwork to adjust clock if clock's power was lost.
+RealtimeClock realtimeClock; // Create an instance of the RealtimeClock class.
+ArduinoNtpTransport ntpTransport("pool.ntp.org");
+NtpSync ntpSync(ntpTransport, realtimeClock); // Keeps the RTC on NTP time in the background while Wi-Fi is up.
+Timebase timebase(realtimeClock);              // Sub-second wall time from esp_timer, anchored to the RTC.
 
 LightSensor lightSensor; // Create an instance of the LightSensor class.
 
+uint64_t epochMillis();
+SensorTask sensorTask(lightSensor, epochMillis); // Samples the light sensor on its own FreeRTOS task.
+SensorTask::SampleRing bleSampleRing;            // Samples waiting to be published over BLE.
+SensorTask::SampleRing logSampleRing;            // Samples waiting to be written to the SD log.
+SensorTask::SampleRing statsSampleRing;          // Samples waiting to be aggregated.
+SensorTask::SampleRing uplinkSampleRing;         // Samples waiting to be batched for the uplink.
+
+StreamingStats lightStats; // 1-minute summaries published over BLE.
+
 FileLogger fileLogger(6); // Create my file system wrapper.
 
 BleLightSensorService bleLightSensorService; // Create an instance of the BLE Light Sensor Service.
 
-unsigned long lastPeerScan = 0;
-const unsigned long peerScanPeriod = 5000; // 5 seconds
+void flushSampleLog();
+SdBlockFile historyDataFile(FileLogger::LOG_DIR);  // History reads use their own file handles
+SdBlockFile historyIndexFile(FileLogger::LOG_DIR); // so they never disturb the log writer.
+SampleLogReader historyReader(historyDataFile, historyIndexFile);
+HistoryTransfer historyTransfer(historyReader, epochMillis, flushSampleLog); // Bulk history download over BLE.
+
+const char uplinkHost[] = "photoniq-collector.local";
+const uint16_t uplinkPort = 8080;
+const char uplinkPath[] = "/ingest";
+ArduinoUplinkTransport uplinkTransport(uplinkHost, uplinkPort);
+Uplink uplink(uplinkTransport, uplinkHost, uplinkPath); // Batched store-and-forward upload over Wi-Fi.
+SdBlockFile uplinkSpoolFile("/uplink");
+UplinkSpool uplinkSpool(uplinkSpoolFile, "spool.q");    // Backlog that outlives the RAM queue (and a reboot).
+volatile bool uplinkNameChanged = false;
+volatile bool uplinkIntervalChanged = false;
+volatile bool logIntervalChanged = false;
+
+ArduinoHttpTransport httpTransport;
+HttpServer httpServer(httpTransport);               // Latest reading, history and metrics on the LAN.
+SdBlockFile httpDataFile(FileLogger::LOG_DIR);      // Its own log reader, so a download over HTTP
+SdBlockFile httpIndexFile(FileLogger::LOG_DIR);     // and one over BLE don't share a cursor.
+SampleLogReader httpHistoryReader(httpDataFile, httpIndexFile);
+LightSample latestSample;                           // Newest reading published, for /latest.
+bool haveLatestSample = false;
+
+uint64_t schedulerClock();
+Scheduler scheduler(schedulerClock); // Paces publishing and housekeeping from loop().
+
+BootSequence bootSequence(schedulerClock); // Start-up stages; independent ones run concurrently.
+
+const uint64_t publishPeriodUs         = 250000ULL;    // 250 ms
+const uint64_t historyPeriodUs         = 20000ULL;     // 20 ms
+const uint64_t logPeriodUs             = 1000000ULL;   // 1 second
+const uint64_t statsPeriodUs           = 1000000ULL;   // 1 second
+const uint64_t settingsPeriodUs        = 500000ULL;    // 500 ms
+const uint64_t wifiPeriodUs            = 250000ULL;    // 250 ms
+const uint64_t scanPeriodUs            = 100000ULL;    // 100 ms
+const uint64_t peerScanPeriodUs        = 5000000ULL;   // 5 seconds
+const uint64_t schedulerReportPeriodUs = 300000000ULL; // 5 minutes
+const uint64_t bootReportDelayUs       = 5000000ULL;   // 5 seconds, once detached stages have settled
+const uint64_t uplinkMaxWaitUs         = 1000000ULL;   // 1 second
+const uint64_t httpPeriodUs            = 20000ULL;     // 20 ms
+const uint16_t httpPort                = 80;
+const uint32_t maxIdleMs               = 1000;         // Upper bound on a single sleep in loop()
+const uint32_t statsCloseGraceMs       = 2000;
+const uint32_t bootStageStackSize      = 8192;
+const uint32_t traceStackSize          = 3072;
+const uint32_t tracePeriodMs           = 50;
+const size_t traceBatch                = 16;           // Records formatted per trace task pass
+
+const int sensorInterruptPin = 4; // TSL2591 INT; -1 to poll the sensor instead
+const AlsAcquisition::Mode sensorInterruptMode = AlsAcquisition::MODE_THRESHOLD;
+const int rtcSquareWavePin = -1;  // DS3231 SQW/INT, if wired; -1 to find second boundaries by polling
+
+void publishLight(void* context);
+void logSamples(void* context);
+void aggregateSamples(void* context);
+void pumpHistory(void* context);
+void scanForPeers(void* context);
+void commitSettings(void* context);
+void serviceWifi(void* context);
+void serviceWifiScan(void* context);
+void serviceNtp(void* context);
+void serviceTimebase(void* context);
+void serviceUplink(void* context);
+void serviceHttp(void* context);
+void registerMetrics();
+void onClockSynced(void* context, int64_t offsetUs, bool stepped);
+int ntpTask = Scheduler::INVALID_TASK;
+int timebaseTask = Scheduler::INVALID_TASK;
+int uplinkTask = Scheduler::INVALID_TASK;
+// Polls a running scan and streams finished results to BLE centrals.
+void serviceWifiScan(void* context)
+{
+  wifiScanner.service(millis());
+  bleLightSensorService.pumpScanResults();
+}
+
+void onWifiStateChanged(void* context, WifiConnection::State state, const char* ssid);
+void applyWifiSettings(const SensorSettings& settings);
+void printSchedulerReport(void* context);
+void onSettingsChanged(void* context, uint32_t changed, const SensorSettings& settings);
+
+uint32_t loadSampleIntervalMsFromSettings();
 
-WifiCredentials loadWifiCredentialsFromSettings();
+bool bootSerial(void* context);
+bool bootSettings(void* context);
+bool bootBle(void* context);
+bool bootStorage(void* context);
+bool bootClock(void* context);
+bool bootSensor(void* context);
+bool bootSampling(void* context);
+bool bootWifi(void* context);
+bool bootScheduler(void* context);
+bool spawnBootStage(BootSequence::EntryFn entry, void* arg, const char* name);
+void waitForBootStages();
+void publishBootReport(void* context);
+void traceTaskEntry(void* param);
 
 // Arduino Setup function
 void setup()
 {
   Serial.begin(115200);
-  waitForSerial();
+  // TRACE_x() records are formatted onto Serial here, at idle priority, not by the task that logged them.
+  xTaskCreatePinnedToCore(traceTaskEntry, "trace", traceStackSize, nullptr, tskIDLE_PRIORITY, nullptr, 0);
 
-  // Initialize Wi-Fi
-  WifiCredentials wifiCreds = loadWifiCredentialsFromSettings();
-  wifiNetwork.connect(wifiCreds);
-  wifiNetwork.printNetworkDetails();
+  // Start-up is a set of stages rather than one serial sequence. Stages run as soon as their
+  // dependencies are done: BLE and the SD card come up on tasks of their own while the clock,
+  // the sensor and sampling start here, and nobody waits for a serial monitor.
+  typedef BootSequence B;
+  int settings = bootSequence.add("settings", bootSettings);
+  bootSequence.add("serial", bootSerial, nullptr, 0, B::STAGE_DETACHED);
+  int ble = bootSequence.add("ble", bootBle, nullptr, B::after(settings), B::STAGE_BACKGROUND);
+  int sd = bootSequence.add("sd", bootStorage, nullptr, B::after(settings), B::STAGE_BACKGROUND | B::STAGE_OPTIONAL);
+  int rtc = bootSequence.add("rtc", bootClock, nullptr, 0, B::STAGE_OPTIONAL);
+  int sensor = bootSequence.add("sensor", bootSensor, nullptr, 0, B::STAGE_OPTIONAL);
+  int sampling = bootSequence.add("sampling", bootSampling, nullptr, B::after(settings) | B::after(rtc) | B::after(sensor),
+                                  B::STAGE_OPTIONAL);
+  // After BLE: both register Wi-Fi listeners, and listeners are added before anything runs concurrently.
+  int wifi = bootSequence.add("wifi", bootWifi, nullptr, B::after(settings) | B::after(ble));
+  bootSequence.add("scheduler", bootScheduler, nullptr, B::after(sampling) | B::after(sd) | B::after(wifi));
 
-  // Initialize RTC
-  realtimeClock.begin();
+  if (!bootSequence.run(spawnBootStage, waitForBootStages)) {
+    Serial.println("Boot completed with failed stages.");
+  }
+  publishBootReport(nullptr);
+  scheduler.addOneShot("boot", bootReportDelayUs, publishBootReport);
 
-  // Initialize light sensor
-  lightSensor.begin();
+  // Removed initial display update code
+  Serial.println("Setup completed successfully.");
+}
 
-  // Initialize file system (SD card)
-  fileLogger.begin();
+// Arduino Loop function
+void loop()
+{
+  uint64_t idleUs = scheduler.runDue();
+
+  // Sleep until the next deadline instead of spinning. delay() yields to FreeRTOS so the
+  // BLE and Wi-Fi stacks get the CPU while we wait. Round up: a wait under a millisecond still
+  // sleeps a tick, or loop() would spin on runDue() until the deadline passed.
+  uint64_t idleMs = (idleUs + 999) / 1000;
+  if (idleMs > 0) {
+    delay(idleMs > maxIdleMs ? maxIdleMs : (uint32_t)idleMs);
+  }
+}
+
+uint64_t schedulerClock()
+{
+  return (uint64_t)esp_timer_get_time();
+}
 
-  // Removed e-Paper display initialization
+bool bootSerial(void* context)
+{
+  waitForSerial();
+  return true;
+}
 
+// Settings are read from NVS once; everything after this uses the cached copy
+bool bootSettings(void* context)
+{
+  settingsManager.begin();
+  settingsManager.addListener(onSettingsChanged);
+  return true;
+}
+
+bool bootBle(void* context)
+{
   Serial.println("BLE Initiailization...");
-  bleLightSensorService.SetWifiNetwork(&wifiNetwork);
+  bleLightSensorService.SetWifiConnection(&wifiConnection);
+  bleLightSensorService.SetWifiScanner(&wifiScanner);
+  bleLightSensorService.SetHistoryTransfer(&historyTransfer);
+  bleLightSensorService.SetSettings(&settingsManager);
   bleLightSensorService.begin(); // Initialize BLE Light Sensor Service
+  return true;
+}
 
-  // Removed initial display update code
-  Serial.println("Setup completed successfully.");
+// Initialize file system (SD card)
+bool bootStorage(void* context)
+{
+  fileLogger.begin(loadSampleIntervalMsFromSettings());
+  return fileLogger.isReady();
 }
 
-// Arduino Loop function
-void loop()
+void IRAM_ATTR onRtcSquareWave()
+{
+  timebase.onSquareWaveEdge((uint64_t)esp_timer_get_time());
+}
+
+bool bootClock(void* context)
+{
+  ntpSync.addListener(onClockSynced);
+  if (!realtimeClock.begin()) return false;
+  if (rtcSquareWavePin >= 0) {
+    realtimeClock.enableSquareWave();
+    pinMode(rtcSquareWavePin, INPUT_PULLUP);
+    attachInterrupt(digitalPinToInterrupt(rtcSquareWavePin), onRtcSquareWave, FALLING);
+    timebase.useSquareWave(true);
+  }
+  return timebase.begin(schedulerClock());
+}
+
+bool bootSensor(void* context)
+{
+  return lightSensor.begin();
+}
+
+// Sampling runs on its own task at the configured update interval; loop() only drains the results.
+bool bootSampling(void* context)
+{
+  sensorTask.addSink(&bleSampleRing);
+  sensorTask.addSink(&logSampleRing);
+  sensorTask.addSink(&statsSampleRing);
+  sensorTask.addSink(&uplinkSampleRing);
+  bool sensorStarted = sensorInterruptPin >= 0
+    ? sensorTask.startInterrupt(loadSampleIntervalMsFromSettings(), sensorInterruptPin, sensorInterruptMode)
+    : sensorTask.start(loadSampleIntervalMsFromSettings());
+  if (!sensorStarted) {
+    Serial.println("Failed to start sensor task!");
+  }
+  return sensorStarted;
+}
+
+// Start Wi-Fi; the connection is made in the background by the "wifi" task
+bool bootWifi(void* context)
+{
+  wifiConnection.addListener(onWifiStateChanged);
+  applyWifiSettings(settingsManager.getSettings());
+  return true;
+}
+
+bool bootScheduler(void* context)
+{
+  scheduler.addPeriodic("publish", publishPeriodUs, publishLight);
+  scheduler.addPeriodic("log", logPeriodUs, logSamples);
+  scheduler.addPeriodic("stats", statsPeriodUs, aggregateSamples);
+  scheduler.addPeriodic("history", historyPeriodUs, pumpHistory);
+  scheduler.addPeriodic("settings", settingsPeriodUs, commitSettings);
+  scheduler.addPeriodic("wifi", wifiPeriodUs, serviceWifi);
+  scheduler.addPeriodic("scan", scanPeriodUs, serviceWifiScan);
+  ntpTask = scheduler.addOneShot("ntp", 0, serviceNtp);
+  timebaseTask = scheduler.addOneShot("timebase", 0, serviceTimebase);
+  uplink.setDeviceName(settingsManager.getSettings().sensorName);
+  uplink.setSampleInterval(loadSampleIntervalMsFromSettings());
+  if (fileLogger.isReady()) uplink.setSpool(&uplinkSpool);
+  uplink.begin(esp_random());
+  uplinkTask = scheduler.addOneShot("uplink", 0, serviceUplink);
+  httpServer.setLatest([](LightSample& out) { out = latestSample; return haveLatestSample; });
+  if (fileLogger.isReady()) httpServer.setHistory(&httpHistoryReader, epochMillis, flushSampleLog);
+  httpServer.setTrace([](void*, uint32_t& cursor, uint8_t* out, size_t capacity) {
+    return traceLog.dump(cursor, out, capacity);
+  });
+  registerMetrics();
+  scheduler.addPeriodic("http", httpPeriodUs, serviceHttp);
+  scheduler.addPeriodic("peers", peerScanPeriodUs, scanForPeers, nullptr, peerScanPeriodUs);
+  scheduler.addPeriodic("report", schedulerReportPeriodUs, printSchedulerReport, nullptr, schedulerReportPeriodUs);
+  return true;
+}
+
+// Drains the trace ring; sleeps only once it has caught up.
+void traceTaskEntry(void* param)
+{
+  for (;;) {
+    if (traceLog.drain(Serial, traceBatch) < traceBatch) vTaskDelay(pdMS_TO_TICKS(tracePeriodMs));
+  }
+}
+
+struct BootTask {
+  BootSequence::EntryFn entry;
+  void* arg;
+};
+BootTask bootTasks[BootSequence::MAX_STAGES];
+size_t bootTaskCount = 0;
+
+static void bootTaskEntry(void* param)
+{
+  BootTask* task = static_cast<BootTask*>(param);
+  task->entry(task->arg);
+  vTaskDelete(nullptr);
+}
+
+// Background stages get a short-lived task each, on whichever core is free.
+bool spawnBootStage(BootSequence::EntryFn entry, void* arg, const char* name)
 {
-  // Run scanForPeers every 5 seconds
-  if (millis() - lastPeerScan >= peerScanPeriod) {
-    bleLightSensorService.scanForPeers();
-    lastPeerScan = millis();
+  if (bootTaskCount >= BootSequence::MAX_STAGES) return false;
+  BootTask* task = &bootTasks[bootTaskCount];
+  task->entry = entry;
+  task->arg = arg;
+  if (xTaskCreatePinnedToCore(bootTaskEntry, name, bootStageStackSize, task, 1, nullptr, tskNO_AFFINITY) != pdPASS) {
+    return false; // the stage then runs inline
+  }
+  bootTaskCount++;
+  return true;
+}
+
+void waitForBootStages()
+{
+  delay(1);
+}
+
+// Prints the boot-timing report and publishes it over BLE. Runs at the end of setup() and
+// again a few seconds later, once the first sample and detached stages have had time to land.
+void publishBootReport(void* context)
+{
+  bootSequence.setMilestone("first sample", sensorTask.firstSampleUs());
+  bootSequence.setMilestone("advertising", bleLightSensorService.advertisingStartedUs());
+
+  Serial.printf("Boot timing (stage: status, start/duration us), setup %llu..%llu us\n",
+                (unsigned long long)bootSequence.beganAtUs(), (unsigned long long)bootSequence.finishedAtUs());
+  for (size_t i = 0; i < bootSequence.count(); i++) {
+    Serial.printf("  %-9s %-7s %llu/%llu\n", bootSequence.name((int)i),
+                  BootSequence::statusName(bootSequence.status((int)i)),
+                  (unsigned long long)bootSequence.startUs((int)i), (unsigned long long)bootSequence.durationUs((int)i));
+  }
+  for (size_t i = 0; i < bootSequence.milestoneCount(); i++) {
+    Serial.printf("  %s at %llu us\n", bootSequence.milestoneName(i), (unsigned long long)bootSequence.milestoneUs(i));
   }
 
-  // lightSensor.printLightLevel(); // Print light level to Serial Monitor
-  String lightValue = lightSensor.getLightAsString();
-  bleLightSensorService.updateLightValue(lightValue); // Update BLE service with light value
-  // Serial.println("updated light value over BLE");
+  uint8_t report[BootSequence::MAX_REPORT];
+  size_t len = bootSequence.encodeReport(report, sizeof(report));
+  bleLightSensorService.updateBootReport(report, len);
+}
+
+// Sample and history timestamps. Called from the sensor task too, so it must not touch I2C once
+// the timebase is up; the RTC is only read directly if it never could be.
+uint64_t epochMillis()
+{
+  if (timebase.valid()) return (uint64_t)timebase.nowUs(schedulerClock()) / 1000ULL;
+  return (uint64_t)realtimeClock.now().unixtime() * 1000ULL;
+}
+
+void publishLight(void* context)
+{
+  // Only the newest reading is worth a notification; anything older is superseded.
+  uint64_t nowUs = schedulerClock();
+  LightSample sample;
+  if (bleSampleRing.popLatest(sample)) {
+    bleLightSensorService.updateLightValue(sample, nowUs); // Update BLE service with light value
+    latestSample = sample;
+    haveLatestSample = true;
+  } else {
+    bleLightSensorService.flushLightNotifications(nowUs);
+  }
+}
+
+void logSamples(void* context)
+{
+  // Every sample goes to the log; records are batched into 512-byte blocks before hitting the card.
+  if (logIntervalChanged) {
+    logIntervalChanged = false;
+    fileLogger.setSampleInterval(loadSampleIntervalMsFromSettings());
+  }
+  LightSample sample;
+  while (logSampleRing.pop(sample)) {
+    fileLogger.log(sample);
+  }
+  fileLogger.service(millis());
+}
+
+void aggregateSamples(void* context)
+{
+  // Every sample feeds the statistics; a summary goes out each time a window closes.
+  LightSample sample;
+  while (statsSampleRing.pop(sample)) {
+    if (lightStats.add(sample)) bleLightSensorService.updateLightStats(lightStats.last());
+  }
+  // Idle windows close on the clock, late enough that no in-flight sample still belongs to them.
+  if (lightStats.closeIfDue(epochMillis() - statsCloseGraceMs)) bleLightSensorService.updateLightStats(lightStats.last());
+}
+
+// Makes everything sampled so far visible to history readers before a transfer starts.
+void flushSampleLog()
+{
+  logSamples(nullptr);
+  fileLogger.flush();
+}
+
+void pumpHistory(void* context)
+{
+  bleLightSensorService.pumpHistory();
+}
+
+void scanForPeers(void* context)
+{
+  bleLightSensorService.scanForPeers();
+}
+
+void commitSettings(void* context)
+{
+  settingsManager.service(millis());
+}
+
+// A new update interval takes effect on the sensor task right away, without a restart; new
+// Wi-Fi settings are handed to the connection, which reconnects in the background.
+void onSettingsChanged(void* context, uint32_t changed, const SensorSettings& settings)
+{
+  if (changed & SettingsManager::FIELD_UPDATE_INTERVAL) {
+    sensorTask.setInterval(loadSampleIntervalMsFromSettings());
+    logIntervalChanged = true;    // picked up by logSamples on loop()
+    uplinkIntervalChanged = true; // and by serviceUplink
+  }
+  if (changed & (SettingsManager::FIELD_WIFI_CREDENTIALS | SettingsManager::FIELD_WIFI_ENABLED)) {
+    applyWifiSettings(settings);
+  }
+  if (changed & SettingsManager::FIELD_SENSOR_NAME) {
+    uplinkNameChanged = true; // picked up by serviceUplink on loop()
+  }
+}
+
+void applyWifiSettings(const SensorSettings& settings)
+{
+  WifiCredentials creds = WifiNetwork::parseCredentials(settings.pWifiSSIDCharAndPassword);
+  wifiConnection.configure(creds.ssid.c_str(), creds.password.c_str(), settings.wifiEnabled);
+}
+
+void serviceWifi(void* context)
+{
+  wifiConnection.service(millis());
+}
+
+void onWifiStateChanged(void* context, WifiConnection::State state, const char* ssid)
+{
+  Serial.printf("Wi-Fi %s %s\n", WifiConnection::stateName(state), ssid);
+  if (state == WifiConnection::STATE_CONNECTED) {
+    wifiNetwork.printStatus();
+    ntpSync.requestSync();
+    scheduler.schedule(ntpTask, 0);
+  }
+}
+
+// Reschedules itself for whenever the sync next needs attention: every few milliseconds while
+// one is in progress, otherwise not until the next poll (or until Wi-Fi connects).
+void serviceNtp(void* context)
+{
+  uint32_t nextMs = ntpSync.service(schedulerClock(), wifiConnection.connected());
+  scheduler.schedule(ntpTask, (uint64_t)nextMs * 1000);
+}
+
+// Reschedules itself like serviceNtp: every millisecond or so while a second boundary is being
+// located, otherwise not until the next re-anchor.
+void serviceTimebase(void* context)
+{
+  scheduler.schedule(timebaseTask, timebase.service(schedulerClock()));
+}
+
+// Batches whatever the sensor task produced and moves the upload along. Runs at least every
+// uplinkMaxWaitUs so the sample ring never fills, sooner while a request is in progress.
+void serviceUplink(void* context)
+{
+  if (uplinkNameChanged) {
+    uplinkNameChanged = false;
+    uplink.setDeviceName(settingsManager.getSettings().sensorName);
+  }
+  if (uplinkIntervalChanged) {
+    uplinkIntervalChanged = false;
+    uplink.setSampleInterval(loadSampleIntervalMsFromSettings());
+  }
+  uint32_t nowMs = millis();
+  LightSample sample;
+  while (uplinkSampleRing.pop(sample)) {
+    uplink.add(sample, nowMs);
+  }
+  uint64_t nextUs = (uint64_t)uplink.service(nowMs, wifiConnection.connected()) * 1000;
+  scheduler.schedule(uplinkTask, nextUs < uplinkMaxWaitUs ? nextUs : uplinkMaxWaitUs);
+}
+
+// The listening socket can only be opened once Wi-Fi has brought up the TCP/IP stack.
+void serviceHttp(void* context)
+{
+  if (!httpServer.isListening()) {
+    if (!wifiConnection.connected() || !httpServer.begin(httpPort)) return;
+    Serial.printf("HTTP server on port %u\n", (unsigned)httpPort);
+  }
+  httpServer.service(millis());
+}
+
+uint64_t maxLoopLatencyUs()
+{
+  uint64_t worst = 0;
+  for (size_t i = 0; i < scheduler.count(); i++) {
+    if (scheduler.stats((int)i).maxJitterUs > worst) worst = scheduler.stats((int)i).maxJitterUs;
+  }
+  return worst;
+}
+
+void registerMetrics()
+{
+  typedef HttpServer H;
+  httpServer.addMetric("photoniq_uptime_seconds", "Time since boot.", H::METRIC_GAUGE,
+                       [](void*) { return (double)schedulerClock() / 1e6; });
+  httpServer.addMetric("photoniq_samples_total", "Light samples taken since boot.", H::METRIC_COUNTER,
+                       [](void*) { return haveLatestSample ? (double)latestSample.sequence + 1 : 0.0; });
+  httpServer.addMetric("photoniq_sample_interval_seconds", "Configured sampling interval.", H::METRIC_GAUGE,
+                       [](void*) { return (double)loadSampleIntervalMsFromSettings() / 1000; });
+  httpServer.addMetric("photoniq_lux", "Newest light reading.", H::METRIC_GAUGE,
+                       [](void*) { return (double)latestSample.centiLux / 100; });
+  httpServer.addMetric("photoniq_ble_notifications_sent_total", "Light notifications sent.", H::METRIC_COUNTER,
+                       [](void*) { return (double)bleLightSensorService.lightPublishStats().sent; });
+  httpServer.addMetric("photoniq_ble_notifications_suppressed_total", "Light notifications suppressed (no subscriber or deadband).", H::METRIC_COUNTER,
+                       [](void*) {
+                         const PublishPolicy::Stats& st = bleLightSensorService.lightPublishStats();
+                         return (double)st.suppressedNoSubscriber + st.suppressedDeadband;
+                       });
+  httpServer.addMetric("photoniq_ble_notifications_coalesced_total", "Light notifications merged into a later one.", H::METRIC_COUNTER,
+                       [](void*) { return (double)bleLightSensorService.lightPublishStats().coalesced; });
+  httpServer.addMetric("photoniq_heap_free_bytes", "Free heap.", H::METRIC_GAUGE,
+                       [](void*) { return (double)ESP.getFreeHeap(); });
+  httpServer.addMetric("photoniq_heap_min_free_bytes", "Lowest free heap since boot.", H::METRIC_GAUGE,
+                       [](void*) { return (double)ESP.getMinFreeHeap(); });
+  httpServer.addMetric("photoniq_loop_latency_max_us", "Worst lateness of a scheduled loop() task.", H::METRIC_GAUGE,
+                       [](void*) { return (double)maxLoopLatencyUs(); });
+  httpServer.addMetric("photoniq_sample_ring_overruns_total", "Samples the BLE publisher missed.", H::METRIC_COUNTER,
+                       [](void*) { return (double)bleSampleRing.overrunCount(); });
+  httpServer.addMetric("photoniq_uplink_backlog_batches", "Uplink batches waiting to be acknowledged.", H::METRIC_GAUGE,
+                       [](void*) { return (double)uplink.backlog(); });
+  httpServer.addMetric("photoniq_uplink_samples_acked_total", "Samples acknowledged by the collector.", H::METRIC_COUNTER,
+                       [](void*) { return (double)uplink.getStats().samplesAcked; });
+  httpServer.addMetric("photoniq_http_requests_total", "HTTP requests served.", H::METRIC_COUNTER,
+                       [](void*) { return (double)httpServer.getStats().requests; });
+  httpServer.addMetric("photoniq_trace_records_lost_total", "Trace records overwritten before they were printed.", H::METRIC_COUNTER,
+                       [](void*) { return (double)traceLog.lostCount(); });
+}
+
+void onClockSynced(void* context, int64_t offsetUs, bool stepped)
+{
+  if (stepped) {
+    timebase.requestAnchor();
+    scheduler.schedule(timebaseTask, 0);
+  }
+  const NtpSync::Stats& st = ntpSync.getStats();
+  Serial.printf("NTP: RTC %s, offset %lld us, delay %lu us, drift %.2f ppm, aging %d\n",
+                stepped ? "set" : "trimmed", (long long)offsetUs, (unsigned long)st.lastDelayUs, st.driftPpm, st.aging);
+}
+
+void printSchedulerReport(void* context)
+{
+  Serial.println("Scheduler report (task: runs, missed, jitter mean/max us, run max us)");
+  for (size_t i = 0; i < scheduler.count(); i++) {
+    const TaskStats& st = scheduler.stats((int)i);
+    Serial.printf("  %-8s %lu, %lu, %llu/%llu, %llu\n", scheduler.name((int)i),
+                  (unsigned long)st.runs, (unsigned long)st.missedDeadlines,
+                  (unsigned long long)st.meanJitterUs(), (unsigned long long)st.maxJitterUs,
+                  (unsigned long long)st.maxRunUs);
+  }
+  Serial.printf("  BLE sample ring overruns: %lu\n", (unsigned long)bleSampleRing.overrunCount());
+  Serial.printf("  Log sample ring overruns: %lu\n", (unsigned long)logSampleRing.overrunCount());
+  Serial.printf("  Uplink sample ring overruns: %lu\n", (unsigned long)uplinkSampleRing.overrunCount());
+  Serial.printf("  Sensor range adjustments: %lu\n", (unsigned long)lightSensor.rangeAdjustments());
+  if (lightSensor.interruptsEnabled()) {
+    const AlsAcquisition::Stats& als = lightSensor.acquisitionStats();
+    Serial.printf("  Sensor INT: %lu interrupts (%lu spurious, %lu missed), %lu readings, %lu threshold events, %lu bus errors\n",
+                  (unsigned long)als.interrupts, (unsigned long)als.spurious, (unsigned long)sensorTask.missedInterruptCount(),
+                  (unsigned long)als.readings, (unsigned long)als.thresholdEvents, (unsigned long)als.busErrors);
+  }
+  const PublishPolicy::Stats& pub = bleLightSensorService.lightPublishStats();
+  Serial.printf("  Light notify: %lu sent, suppressed %lu (no subscriber) %lu (deadband), %lu coalesced, %lu failed\n",
+                (unsigned long)pub.sent, (unsigned long)pub.suppressedNoSubscriber,
+                (unsigned long)pub.suppressedDeadband, (unsigned long)pub.coalesced,
+                (unsigned long)pub.sendFailures);
+  const SampleLog::Stats& logStats = fileLogger.stats();
+  Serial.printf("  SD log: %lu records, %lu blocks, %lu partial commits, %lu write errors, %lu dropped\n",
+                (unsigned long)logStats.recordsAppended, (unsigned long)logStats.blocksWritten,
+                (unsigned long)logStats.partialCommits, (unsigned long)logStats.writeErrors,
+                (unsigned long)logStats.droppedRecords);
+  const SettingsManager::Stats& settingsStats = settingsManager.getStats();
+  Serial.printf("  Settings: %lu changes, %lu unchanged writes, %lu commits, %lu commit failures\n",
+                (unsigned long)settingsStats.changes, (unsigned long)settingsStats.unchanged,
+                (unsigned long)settingsStats.commits, (unsigned long)settingsStats.commitFailures);
+  const WifiConnection::Stats& wifiStats = wifiConnection.getStats();
+  Serial.printf("  Wi-Fi: %s, %lu attempts, %lu connects, %lu failures, %lu drops\n",
+                WifiConnection::stateName(wifiConnection.state()), (unsigned long)wifiStats.attempts,
+                (unsigned long)wifiStats.connects, (unsigned long)wifiStats.failures, (unsigned long)wifiStats.drops);
+  const WifiScanner::Stats& scanStats = wifiScanner.getStats();
+  Serial.printf("  Wi-Fi scan: %lu requests, %lu from cache, %lu scans, %lu failures, last %lu ms\n",
+                (unsigned long)scanStats.requests, (unsigned long)scanStats.cacheHits, (unsigned long)scanStats.scans,
+                (unsigned long)scanStats.failures, (unsigned long)scanStats.lastScanMs);
+  const NtpSync::Stats& ntpStats = ntpSync.getStats();
+  Serial.printf("  NTP: %lu syncs, %lu failures, %lu steps, last offset %lld us, drift %.2f ppm, aging %d\n",
+                (unsigned long)ntpStats.syncs, (unsigned long)ntpStats.failures, (unsigned long)ntpStats.steps,
+                (long long)ntpStats.lastOffsetUs, ntpStats.driftPpm, ntpStats.aging);
+  const Timebase::Stats& tbStats = timebase.getStats();
+  Serial.printf("  Timebase: %lu anchors (%lu SQW), %lu steps, %lu RTC reads, %lu missed windows, last error %ld us, max %ld us, rate %ld ppb\n",
+                (unsigned long)tbStats.anchors, (unsigned long)tbStats.squareWaveAnchors, (unsigned long)tbStats.steps,
+                (unsigned long)tbStats.rtcReads, (unsigned long)tbStats.missedWindows, (long)tbStats.lastErrorUs,
+                (long)tbStats.maxErrorUs, (long)tbStats.ratePpb);
+  const Uplink::Stats& upStats = uplink.getStats();
+  Serial.printf("  Uplink: %s, %lu batches acked (%lu samples), %lu rejected, %lu retries, %lu connects, backlog %lu, %lu spilled, %lu samples dropped, last %u in %lu ms\n",
+                Uplink::stateName(uplink.state()), (unsigned long)upStats.batchesAcked, (unsigned long)upStats.samplesAcked,
+                (unsigned long)upStats.batchesRejected, (unsigned long)upStats.retries, (unsigned long)upStats.connects,
+                (unsigned long)uplink.backlog(), (unsigned long)upStats.spilled, (unsigned long)upStats.samplesDropped,
+                (unsigned)upStats.lastStatus, (unsigned long)upStats.lastRoundTripMs);
+  const HttpServer::Stats& httpStats = httpServer.getStats();
+  Serial.printf("  HTTP: %lu connections (%lu turned away, peak %lu), %lu requests, %lu errors, %lu history downloads, %lu bytes\n",
+                (unsigned long)httpStats.connections, (unsigned long)httpStats.rejected, (unsigned long)httpStats.peakConnections,
+                (unsigned long)httpStats.requests, (unsigned long)httpStats.errors, (unsigned long)httpStats.historyStreams,
+                (unsigned long)httpStats.bytesSent);
 }
 
-WifiCredentials loadWifiCredentialsFromSettings()
+uint32_t loadSampleIntervalMsFromSettings()
 {
-    WifiCredentials creds;
-    settingsManager.begin();
-    settingsManager.loadSettings();
-    creds = settingsManager.getWifiCredentials();
-    settingsManager.end();
-    return creds;
+    int seconds = settingsManager.getSettings().updateInterval;
+    if (seconds <= 0) seconds = 1;
+    return (uint32_t)seconds * 1000;
 }
 
 
@@ -93,7 +672,7 @@ void waitForSerial(uint16_t timeout)
   unsigned long start = millis();
   while (!Serial && (millis() - start < timeout))
   {
-    ; // spin briefly
+    delay(10); // runs as a detached boot stage: leave the CPU to the others
   }
 }
 
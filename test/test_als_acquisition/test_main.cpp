@@ -0,0 +1,256 @@
+// AlsAcquisition through the firmware's WireTsl2591Bus, over the native Wire and I2C bus, to a
+// SimulatedTsl2591 behind Tsl2591I2cDevice: an event per integration in conversion mode; in
+// threshold mode silence inside the window, an event on a crossing and the window re-armed
+// around it; setSetting() reporting the first conversion at the new setting; spurious edges, bus
+// errors, and the minimum window in the dark. Time moves only when a test advances the sensor.
+
+#include <unity.h>
+#include "../../hal/native/NativeBoard.h"
+#include "../../hal/native/SimulatedTsl2591.h"
+#include "../../hal/native/Tsl2591I2cDevice.h"
+#include "../../src/AlsAcquisition.h"
+#include "../../src/WireTsl2591Bus.h"
+
+enum { LOW, MED, HIGH, MAX };
+
+// Attached to the native board's I2C bus in main(); the board is never begun, so it is alone there.
+static SimulatedTsl2591 sensor;
+static Tsl2591I2cDevice device(sensor);
+
+// One integration at the sensor's current setting.
+static void integrate(uint32_t cycles = 1) { sensor.advance(sensor.cycleMs() * cycles); }
+
+void setUp() { sensor = SimulatedTsl2591(); }
+void tearDown() {}
+
+// Each completed integration pulls INT low once; service() reads it and lets INT go.
+void test_conversion_mode_reports_every_integration() {
+    WireTsl2591Bus bus;
+    AlsAcquisition als(bus);
+    AlsAcquisition::Reading r = {};
+    sensor.setScene(4);
+    TEST_ASSERT_TRUE(als.begin(AlsAcquisition::MODE_CONVERSION, { MED, 0 }));
+    TEST_ASSERT_EQUAL(AlsAcquisition::EVENT_NONE, als.service(false, r));
+
+    sensor.advance(50);
+    TEST_ASSERT_FALSE(sensor.interruptAsserted());
+    for (int i = 0; i < 5; i++) {
+        integrate();
+        TEST_ASSERT_TRUE(sensor.interruptAsserted());
+        TEST_ASSERT_EQUAL(AlsAcquisition::EVENT_CONVERSION, als.service(true, r));
+        TEST_ASSERT_FALSE(sensor.interruptAsserted());
+        TEST_ASSERT_EQUAL_UINT16(10000, r.full);
+        TEST_ASSERT_EQUAL_UINT16(2500, r.ir);
+        TEST_ASSERT_EQUAL_HEX8(0x10, r.control);
+    }
+    // A timer poll picks up the latest conversion without waiting for one.
+    sensor.setScene(2);
+    integrate();
+    TEST_ASSERT_EQUAL(AlsAcquisition::EVENT_CONVERSION, als.service(false, r));
+    TEST_ASSERT_EQUAL_UINT16(5000, r.full);
+
+    const AlsAcquisition::Stats& stats = als.getStats();
+    TEST_ASSERT_EQUAL_UINT32(5, stats.interrupts);
+    TEST_ASSERT_EQUAL_UINT32(6, stats.readings);
+    TEST_ASSERT_EQUAL_UINT32(0, stats.spurious);
+    TEST_ASSERT_EQUAL_UINT32(0, stats.thresholdEvents);
+    TEST_ASSERT_EQUAL_UINT32(0, stats.rearms);
+    TEST_ASSERT_EQUAL_UINT32(6, sensor.cyclesCompleted());
+}
+
+// The first reading arms a +-5 % window; readings inside it stay silent, one outside it
+// interrupts and the window moves to it.
+void test_threshold_mode_window() {
+    WireTsl2591Bus bus;
+    AlsAcquisition als(bus);
+    AlsAcquisition::Reading r = {};
+    als.setThresholdWindow(50, Tsl2591Bus::PERSIST_ANY);
+    sensor.setScene(4);
+    TEST_ASSERT_TRUE(als.begin(AlsAcquisition::MODE_THRESHOLD, { MED, 0 }));
+
+    integrate();
+    TEST_ASSERT_TRUE(sensor.interruptAsserted());
+    TEST_ASSERT_EQUAL(AlsAcquisition::EVENT_CONVERSION, als.service(true, r));
+    TEST_ASSERT_EQUAL_UINT16(10000, r.full);
+    TEST_ASSERT_EQUAL_UINT16(9500, als.lowThreshold());
+    TEST_ASSERT_EQUAL_UINT16(10500, als.highThreshold());
+
+    sensor.setScene(4.16);      // 10400
+    integrate(10);
+    TEST_ASSERT_FALSE(sensor.interruptAsserted());
+    sensor.setScene(3.84);      // 9600
+    integrate(10);
+    TEST_ASSERT_FALSE(sensor.interruptAsserted());
+
+    sensor.setScene(4.4);       // 11000
+    integrate();
+    TEST_ASSERT_TRUE(sensor.interruptAsserted());
+    TEST_ASSERT_EQUAL(AlsAcquisition::EVENT_THRESHOLD, als.service(true, r));
+    TEST_ASSERT_EQUAL_UINT16(11000, r.full);
+    TEST_ASSERT_FALSE(sensor.interruptAsserted());
+    TEST_ASSERT_EQUAL_UINT16(10450, als.lowThreshold());
+    TEST_ASSERT_EQUAL_UINT16(11550, als.highThreshold());
+
+    integrate(5);
+    TEST_ASSERT_FALSE(sensor.interruptAsserted());
+    sensor.setScene(3.6);       // 9000: below the new window
+    integrate();
+    TEST_ASSERT_EQUAL(AlsAcquisition::EVENT_THRESHOLD, als.service(true, r));
+    TEST_ASSERT_EQUAL_UINT16(9000, r.full);
+
+    const AlsAcquisition::Stats& stats = als.getStats();
+    TEST_ASSERT_EQUAL_UINT32(3, stats.interrupts);
+    TEST_ASSERT_EQUAL_UINT32(2, stats.thresholdEvents);
+    TEST_ASSERT_EQUAL_UINT32(3, stats.rearms);
+    TEST_ASSERT_EQUAL_UINT32(0, stats.spurious);
+}
+
+// With PERSIST at 2 a single cycle outside the window is not enough.
+void test_threshold_persist_filters_single_cycle() {
+    WireTsl2591Bus bus;
+    AlsAcquisition als(bus);
+    AlsAcquisition::Reading r = {};
+    als.setThresholdWindow(50, 2);
+    sensor.setScene(4);
+    TEST_ASSERT_TRUE(als.begin(AlsAcquisition::MODE_THRESHOLD, { MED, 0 }));
+    integrate();
+    als.service(true, r);
+
+    sensor.setScene(4.4);
+    integrate();
+    sensor.setScene(4);
+    integrate(5);
+    TEST_ASSERT_FALSE(sensor.interruptAsserted());
+    sensor.setScene(4.4);
+    integrate(2);
+    TEST_ASSERT_TRUE(sensor.interruptAsserted());
+    TEST_ASSERT_EQUAL(AlsAcquisition::EVENT_THRESHOLD, als.service(true, r));
+}
+
+// A gain / time change opens the window, so the first conversion at the new setting is reported
+// even when it lands inside the old window; nothing from the old setting is read after it.
+void test_set_setting_disarms() {
+    WireTsl2591Bus bus;
+    AlsAcquisition als(bus);
+    AlsAcquisition::Reading r = {};
+    sensor.setScene(4);
+    TEST_ASSERT_TRUE(als.begin(AlsAcquisition::MODE_THRESHOLD, { MED, 0 }));
+    integrate();
+    als.service(true, r);
+    TEST_ASSERT_EQUAL_UINT16(9500, als.lowThreshold());
+
+    sensor.setScene(4.0 * 25 / 428);    // about 10000 at HIGH too
+    TEST_ASSERT_TRUE(als.setSetting({ HIGH, 1 }));
+    TEST_ASSERT_EQUAL_UINT16(0, als.lowThreshold());
+    TEST_ASSERT_EQUAL_UINT16(0xFFFF, als.highThreshold());
+    TEST_ASSERT_EQUAL(AlsAcquisition::EVENT_NONE, als.service(false, r));
+    TEST_ASSERT_EQUAL_UINT32(200, sensor.cycleMs());
+
+    sensor.advance(100);
+    TEST_ASSERT_FALSE(sensor.interruptAsserted());
+    sensor.advance(100);
+    TEST_ASSERT_TRUE(sensor.interruptAsserted());
+    TEST_ASSERT_EQUAL(AlsAcquisition::EVENT_CONVERSION, als.service(true, r));
+    TEST_ASSERT_EQUAL_HEX8(0x21, r.control);
+    TEST_ASSERT_UINT32_WITHIN(1, 20000, r.full);
+    TEST_ASSERT_UINT32_WITHIN(1, 19000, als.lowThreshold());
+    TEST_ASSERT_EQUAL_UINT32(2, als.getStats().rearms);
+    TEST_ASSERT_EQUAL_UINT32(0, als.getStats().thresholdEvents);
+
+    // Off the chip, the setting is only remembered.
+    als.stop();
+    TEST_ASSERT_FALSE(als.running());
+    TEST_ASSERT_TRUE(als.setSetting({ LOW, 0 }));
+    TEST_ASSERT_EQUAL(AlsAcquisition::EVENT_NONE, als.service(true, r));
+    TEST_ASSERT_EQUAL_UINT32(2, als.getStats().interrupts);
+}
+
+// An edge with no conversion behind it (AVALID clear) reads nothing and is counted.
+void test_spurious_edge() {
+    WireTsl2591Bus bus;
+    AlsAcquisition als(bus);
+    AlsAcquisition::Reading r = {};
+    sensor.setScene(4);
+    TEST_ASSERT_TRUE(als.begin(AlsAcquisition::MODE_CONVERSION, { MED, 0 }));
+    TEST_ASSERT_EQUAL(AlsAcquisition::EVENT_NONE, als.service(true, r));
+    TEST_ASSERT_TRUE(als.setSetting({ LOW, 0 }));
+    TEST_ASSERT_EQUAL(AlsAcquisition::EVENT_NONE, als.service(true, r));
+    TEST_ASSERT_EQUAL(AlsAcquisition::EVENT_NONE, als.service(false, r));   // a poll is not an edge
+
+    const AlsAcquisition::Stats& stats = als.getStats();
+    TEST_ASSERT_EQUAL_UINT32(2, stats.interrupts);
+    TEST_ASSERT_EQUAL_UINT32(2, stats.spurious);
+    TEST_ASSERT_EQUAL_UINT32(0, stats.readings);
+
+    integrate();
+    TEST_ASSERT_EQUAL(AlsAcquisition::EVENT_CONVERSION, als.service(true, r));
+    TEST_ASSERT_EQUAL_UINT16(400, r.full);
+}
+
+// A NAK on the status read is an error event; the next service() reads normally.
+void test_bus_error() {
+    WireTsl2591Bus bus;
+    AlsAcquisition als(bus);
+    AlsAcquisition::Reading r = {};
+    sensor.setScene(4);
+
+    sensor.failNext(1);
+    TEST_ASSERT_FALSE(als.begin(AlsAcquisition::MODE_CONVERSION, { MED, 0 }));
+    TEST_ASSERT_FALSE(als.running());
+    TEST_ASSERT_EQUAL(AlsAcquisition::EVENT_NONE, als.service(true, r));
+    TEST_ASSERT_TRUE(als.begin(AlsAcquisition::MODE_CONVERSION, { MED, 0 }));
+
+    integrate();
+    sensor.failNext(1);
+    TEST_ASSERT_EQUAL(AlsAcquisition::EVENT_ERROR, als.service(true, r));
+    TEST_ASSERT_TRUE(sensor.interruptAsserted());       // still pending
+    TEST_ASSERT_EQUAL(AlsAcquisition::EVENT_CONVERSION, als.service(true, r));
+    TEST_ASSERT_EQUAL_UINT16(10000, r.full);
+    TEST_ASSERT_EQUAL_UINT32(2, als.getStats().busErrors);
+    TEST_ASSERT_EQUAL_UINT32(1, als.getStats().readings);
+}
+
+// In the dark 5 % of the reading is under a count; the window never gets narrower than
+// MIN_WINDOW_COUNTS either side, so a count or two of noise stays silent.
+void test_dark_window_floor() {
+    WireTsl2591Bus bus;
+    AlsAcquisition als(bus);
+    AlsAcquisition::Reading r = {};
+    sensor.setScene(0.25);      // 25 counts at LOW / 100 ms
+    TEST_ASSERT_TRUE(als.begin(AlsAcquisition::MODE_THRESHOLD, { LOW, 0 }));
+    integrate();
+    TEST_ASSERT_EQUAL(AlsAcquisition::EVENT_CONVERSION, als.service(true, r));
+    TEST_ASSERT_EQUAL_UINT16(25, r.full);
+    TEST_ASSERT_EQUAL_UINT16(25 - AlsAcquisition::MIN_WINDOW_COUNTS, als.lowThreshold());
+    TEST_ASSERT_EQUAL_UINT16(25 + AlsAcquisition::MIN_WINDOW_COUNTS, als.highThreshold());
+
+    sensor.setScene(0.27);      // 27
+    integrate(5);
+    TEST_ASSERT_FALSE(sensor.interruptAsserted());
+    sensor.setScene(0.3125);    // 31
+    integrate();
+    TEST_ASSERT_EQUAL(AlsAcquisition::EVENT_THRESHOLD, als.service(true, r));
+
+    sensor.setScene(0);
+    integrate();
+    TEST_ASSERT_EQUAL(AlsAcquisition::EVENT_THRESHOLD, als.service(true, r));
+    TEST_ASSERT_EQUAL_UINT16(0, r.full);
+    TEST_ASSERT_EQUAL_UINT16(0, als.lowThreshold());
+    TEST_ASSERT_EQUAL_UINT16(AlsAcquisition::MIN_WINDOW_COUNTS, als.highThreshold());
+    sensor.setScene(0.03);      // 3
+    integrate(5);
+    TEST_ASSERT_FALSE(sensor.interruptAsserted());
+}
+
+int main(int argc, char** argv) {
+    NativeBoard::instance().getBus().attach(Tsl2591I2cDevice::ADDRESS, &device);
+    UNITY_BEGIN();
+    RUN_TEST(test_conversion_mode_reports_every_integration);
+    RUN_TEST(test_threshold_mode_window);
+    RUN_TEST(test_threshold_persist_filters_single_cycle);
+    RUN_TEST(test_set_setting_disarms);
+    RUN_TEST(test_spurious_edge);
+    RUN_TEST(test_bus_error);
+    RUN_TEST(test_dark_window_floor);
+    return UNITY_END();
+}
@@ -0,0 +1,157 @@
+// AutoRange fed by the count model in SimulatedTsl2591, read through AlsAcquisition as the
+// sensor task does: saturation stepping integration time down before gain (including the 37888
+// ceiling at 100 ms), the hysteresis band holding a setting at its edges, the shortest time that
+// reaches the target, a dark scene climbing to MAX / 600 ms and a bright one settling at
+// LOW / 100 ms with a reading every cycle on the way. Scenes are counts per (gain x ms).
+
+#include <unity.h>
+#include "../../hal/native/SimulatedTsl2591.h"
+#include "../../src/AlsAcquisition.h"
+#include "../../src/AutoRange.h"
+
+enum { LOW, MED, HIGH, MAX };
+enum { MS100, MS200, MS300, MS400, MS500, MS600 };
+
+static void assertSetting(uint8_t gain, uint8_t time, AutoRange::Setting s) {
+    TEST_ASSERT_EQUAL_UINT8(gain, s.gain);
+    TEST_ASSERT_EQUAL_UINT8(time, s.time);
+}
+
+// A sensor, the acquisition reading it every conversion, and the auto-range steering both.
+struct Rig {
+    SimulatedTsl2591 sensor;
+    AlsAcquisition als;
+    AutoRange range;
+
+    Rig(AutoRange::Setting start, double scene) : als(sensor) {
+        sensor.setScene(scene);
+        range.setSetting(start);
+        TEST_ASSERT_TRUE(als.begin(AlsAcquisition::MODE_CONVERSION, start));
+    }
+
+    // One integration at the current setting. Every cycle must yield a reading taken at that
+    // setting; AutoRange then sees it and any change goes to the chip before the next cycle.
+    AlsAcquisition::Reading cycle() {
+        sensor.advance(sensor.cycleMs());
+        AlsAcquisition::Reading r = {};
+        TEST_ASSERT_TRUE(sensor.interruptAsserted());
+        TEST_ASSERT_EQUAL(AlsAcquisition::EVENT_CONVERSION, als.service(true, r));
+        TEST_ASSERT_EQUAL_HEX8(AlsAcquisition::controlFor(range.setting()), r.control);
+        if (range.update(r.full, r.ir)) TEST_ASSERT_TRUE(als.setSetting(range.setting()));
+        return r;
+    }
+};
+
+void setUp() {}
+void tearDown() {}
+
+// Saturated at HIGH / 400 ms: integration drops to 100 ms first, then gain one step per reading.
+void test_saturation_steps_time_then_gain() {
+    Rig rig({ HIGH, MS400 }, 10);
+    TEST_ASSERT_EQUAL_UINT16(65535, rig.cycle().full);
+    assertSetting(HIGH, MS100, rig.range.setting());
+    TEST_ASSERT_EQUAL_UINT16(AutoRange::maxCount(MS100), rig.cycle().full);  // 37888, not 65535
+    assertSetting(MED, MS100, rig.range.setting());
+    TEST_ASSERT_EQUAL_UINT16(25000, rig.cycle().full);
+    assertSetting(MED, MS100, rig.range.setting());                         // in band: kept
+    TEST_ASSERT_EQUAL_UINT32(2, rig.range.adjustmentCount());
+}
+
+// At 100 ms full scale is 37888, so a channel reading 37888 there is saturated; at 200 ms it is not.
+void test_100ms_ceiling() {
+    AutoRange range;
+    range.setSetting({ MAX, MS100 });
+    assertSetting(HIGH, MS100, range.choose(100, 37888));   // IR saturated: step down
+    assertSetting(MAX, MS600, range.choose(100, 37887));    // just dark
+    range.setSetting({ LOW, MS100 });
+    assertSetting(LOW, MS100, range.choose(37888, 9000));   // nothing less sensitive to go to
+    TEST_ASSERT_FALSE(range.update(37888, 9000));
+    range.setSetting({ LOW, MS200 });
+    assertSetting(LOW, MS100, range.choose(37888, 9000));   // in range at 200 ms, but 100 ms will do
+}
+
+// MED / 100 ms keeps its setting for readings in [target / 2, high-water] and leaves it outside.
+void test_hysteresis_band_edges() {
+    AutoRange range(1000, 80);
+    range.setSetting({ MED, MS100 });
+    uint16_t highWater = (uint16_t)(AutoRange::maxCount(MS100) * 80 / 100);
+    assertSetting(MED, MS100, range.choose(500, 125));
+    assertSetting(HIGH, MS100, range.choose(499, 125));
+    assertSetting(MED, MS100, range.choose(highWater, 7000));
+    assertSetting(LOW, MS100, range.choose(highWater + 1, 7000));
+}
+
+// A scene that reads either side of the lower band edge at MED moves once to HIGH and stays.
+void test_no_oscillation_at_band_edge() {
+    Rig rig({ MED, MS100 }, 0.2010);
+    rig.cycle();
+    assertSetting(MED, MS100, rig.range.setting());
+    for (int i = 0; i < 40; i++) {
+        rig.sensor.setScene(i % 2 ? 0.2010 : 0.1990);
+        rig.cycle();
+    }
+    assertSetting(HIGH, MS100, rig.range.setting());
+    TEST_ASSERT_EQUAL_UINT32(1, rig.range.adjustmentCount());
+}
+
+// Too dim for any gain at 100 or 200 ms: the first integration time that reaches the target wins.
+void test_shortest_time_reaching_target() {
+    Rig rig({ MED, MS100 }, 0.0005);
+    rig.cycle();
+    assertSetting(MAX, MS300, rig.range.setting());
+    uint16_t full = rig.cycle().full;
+    TEST_ASSERT_GREATER_OR_EQUAL(1000, full);
+    assertSetting(MAX, MS300, rig.range.setting());
+
+    // Brighter: 100 ms is enough, at the lowest gain that gets there.
+    rig.sensor.setScene(5);
+    rig.cycle();    // MAX / 300 saturates
+    for (int i = 0; i < 4; i++) rig.cycle();
+    assertSetting(MED, MS100, rig.range.setting());
+    TEST_ASSERT_EQUAL_UINT16(12500, rig.cycle().full);
+}
+
+// No light at all: the zero reading counts as one, which steers up to MAX / 600 ms and holds there.
+void test_dark_scene_climbs_to_most_sensitive() {
+    Rig rig({ LOW, MS100 }, 0);
+    TEST_ASSERT_EQUAL_UINT16(0, rig.cycle().full);
+    assertSetting(MAX, MS100, rig.range.setting());
+    TEST_ASSERT_EQUAL_UINT16(0, rig.cycle().full);
+    assertSetting(MAX, MS600, rig.range.setting());
+    for (int i = 0; i < 5; i++) TEST_ASSERT_EQUAL_UINT16(0, rig.cycle().full);
+    assertSetting(MAX, MS600, rig.range.setting());
+    TEST_ASSERT_EQUAL_UINT32(2, rig.range.adjustmentCount());
+
+    AutoRange range;
+    range.setSetting({ MAX, MS600 });
+    assertSetting(MAX, MS600, range.choose(0, 0));
+}
+
+// From MAX / 600 ms into sunlight: one step per reading, no conversion lost, down to LOW / 100 ms.
+void test_bright_scene_reaches_least_sensitive() {
+    Rig rig({ MAX, MS600 }, 200);
+    for (int i = 0; i < 6; i++) rig.cycle();
+    assertSetting(LOW, MS100, rig.range.setting());
+    TEST_ASSERT_EQUAL_UINT32(4, rig.range.adjustmentCount());
+    TEST_ASSERT_EQUAL_UINT16(20000, rig.cycle().full);
+
+    // Brighter than LOW / 100 ms can measure: it stays there, saturated, still reading every cycle.
+    rig.sensor.setScene(1000);
+    for (int i = 0; i < 5; i++) TEST_ASSERT_EQUAL_UINT16(AutoRange::maxCount(MS100), rig.cycle().full);
+    assertSetting(LOW, MS100, rig.range.setting());
+    TEST_ASSERT_EQUAL_UINT32(4, rig.range.adjustmentCount());
+    TEST_ASSERT_EQUAL_UINT32(rig.sensor.cyclesCompleted(), rig.als.getStats().readings);
+    TEST_ASSERT_EQUAL_UINT32(0, rig.als.getStats().spurious);
+}
+
+int main(int argc, char** argv) {
+    UNITY_BEGIN();
+    RUN_TEST(test_saturation_steps_time_then_gain);
+    RUN_TEST(test_100ms_ceiling);
+    RUN_TEST(test_hysteresis_band_edges);
+    RUN_TEST(test_no_oscillation_at_band_edge);
+    RUN_TEST(test_shortest_time_reaching_target);
+    RUN_TEST(test_dark_scene_climbs_to_most_sensitive);
+    RUN_TEST(test_bright_scene_reaches_least_sensitive);
+    return UNITY_END();
+}
@@ -0,0 +1,305 @@
+// BootSequence ordering: no stage starts before everything it depends on has finished, whether
+// stages run inline or on tasks of their own (std::thread here); failures skip dependents unless
+// the failed stage is optional; detached stages do not hold up run(); and the report encodes
+// what happened.
+
+#include <unity.h>
+#include <atomic>
+#include <chrono>
+#include <random>
+#include <thread>
+#include <vector>
+#include "../../src/BootSequence.h"
+
+using B = BootSequence;
+
+// Simulated microseconds, advanced by the stages themselves.
+static std::atomic<uint64_t> fakeUs(0);
+static uint64_t fakeClock() { return fakeUs.load(); }
+
+static uint64_t steadyClock() {
+    return (uint64_t)std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// Background stages run on threads joined at the end of each test, like short-lived boot tasks.
+static std::vector<std::thread> tasks;
+static bool spawnThread(B::EntryFn entry, void* arg, const char*) {
+    tasks.emplace_back(entry, arg);
+    return true;
+}
+static bool refuseSpawn(B::EntryFn, void*, const char*) { return false; }
+static void yieldTask() { std::this_thread::yield(); }
+
+// A stage that checks its dependencies have finished when it starts and logs the start order.
+struct Probe {
+    static constexpr size_t MAX = B::MAX_STAGES;
+
+    B* boot;
+    int id;
+    uint32_t dependsOn;
+    bool result;
+    uint64_t costUs;
+    uint32_t sleepMs;
+    std::atomic<int>* order;
+    std::atomic<int>* violations;
+    int startedAs;
+
+    static bool run(void* context) {
+        Probe* p = (Probe*)context;
+        for (int d = 0; d < (int)B::MAX_STAGES; d++) {
+            if (!(p->dependsOn & B::after(d))) continue;
+            B::Status st = p->boot->status(d);
+            if (st != B::STATUS_DONE && st != B::STATUS_FAILED) (*p->violations)++;
+        }
+        p->startedAs = (*p->order)++;
+        if (p->sleepMs) std::this_thread::sleep_for(std::chrono::milliseconds(p->sleepMs));
+        fakeUs += p->costUs;
+        return p->result;
+    }
+};
+
+// A sequence of probes over one clock, declared with add().
+struct Plan {
+    B boot;
+    Probe probes[Probe::MAX];
+    std::atomic<int> order;
+    std::atomic<int> violations;
+
+    explicit Plan(B::ClockFn clock = fakeClock) : boot(clock), order(0), violations(0) {}
+
+    int add(const char* name, uint32_t dependsOn = 0, uint8_t flags = 0, bool result = true, uint64_t costUs = 1000,
+            uint32_t sleepMs = 0) {
+        size_t i = boot.count();
+        if (i >= Probe::MAX) return boot.add(name, Probe::run, nullptr, dependsOn, flags);
+        probes[i] = { &boot, (int)i, dependsOn, result, costUs, sleepMs, &order, &violations, -1 };
+        return boot.add(name, Probe::run, &probes[i], dependsOn, flags);
+    }
+
+    int startedAs(int id) const { return probes[id].startedAs; }
+};
+
+static void joinTasks() {
+    for (std::thread& t : tasks) t.join();
+    tasks.clear();
+}
+
+void setUp() { fakeUs = 0; }
+void tearDown() { joinTasks(); }
+
+void test_inline_runs_in_dependency_order() {
+    Plan plan;
+    int wifi = plan.add("wifi", B::after(2));               // declared before what it needs
+    int settings = plan.add("settings");
+    int ble = plan.add("ble", B::after(settings));
+    int rtc = plan.add("rtc");
+    int sensor = plan.add("sensor", B::after(rtc) | B::after(settings));
+    TEST_ASSERT_TRUE(plan.boot.valid());
+    TEST_ASSERT_TRUE(plan.boot.run(nullptr, nullptr));
+
+    // Ready stages go in declaration order; a stage that becomes ready goes before later ones.
+    TEST_ASSERT_EQUAL_INT(0, plan.startedAs(settings));
+    TEST_ASSERT_EQUAL_INT(1, plan.startedAs(ble));
+    TEST_ASSERT_EQUAL_INT(2, plan.startedAs(wifi));
+    TEST_ASSERT_EQUAL_INT(3, plan.startedAs(rtc));
+    TEST_ASSERT_EQUAL_INT(4, plan.startedAs(sensor));
+    TEST_ASSERT_EQUAL_INT(0, plan.violations.load());
+
+    // Times come from the injected clock.
+    TEST_ASSERT_EQUAL_UINT64(0, plan.boot.startUs(settings));
+    TEST_ASSERT_EQUAL_UINT64(1000, plan.boot.durationUs(settings));
+    TEST_ASSERT_EQUAL_UINT64(4000, plan.boot.startUs(sensor));
+    TEST_ASSERT_EQUAL_UINT64(5000, plan.boot.finishedAtUs());
+    for (int i = 0; i < (int)plan.boot.count(); i++) TEST_ASSERT_EQUAL(B::STATUS_DONE, plan.boot.status(i));
+}
+
+void test_invalid_plans_do_not_run() {
+    {
+        Plan plan;
+        plan.add("a", B::after(1));
+        plan.add("b", B::after(0));                          // a cycle
+        TEST_ASSERT_FALSE(plan.boot.valid());
+        TEST_ASSERT_FALSE(plan.boot.run(nullptr, nullptr));
+        TEST_ASSERT_EQUAL_INT(0, plan.order.load());
+    }
+    {
+        Plan plan;
+        plan.add("a", B::after(5));                          // not declared
+        TEST_ASSERT_FALSE(plan.boot.run(nullptr, nullptr));
+        TEST_ASSERT_EQUAL(B::STATUS_PENDING, plan.boot.status(0));
+    }
+    {
+        Plan plan;
+        int serial = plan.add("serial", 0, B::STAGE_DETACHED);
+        plan.add("log", B::after(serial));                  // nothing may wait on a detached stage
+        TEST_ASSERT_FALSE(plan.boot.run(spawnThread, yieldTask));
+        TEST_ASSERT_EQUAL_INT(0, plan.order.load());
+    }
+    {
+        Plan plan;
+        plan.add("self", B::after(0));
+        TEST_ASSERT_FALSE(plan.boot.valid());
+    }
+    Plan full;
+    for (size_t i = 0; i < B::MAX_STAGES; i++) TEST_ASSERT_NOT_EQUAL(B::INVALID_STAGE, full.add("s"));
+    TEST_ASSERT_EQUAL(B::INVALID_STAGE, full.add("one too many"));
+    TEST_ASSERT_EQUAL(B::INVALID_STAGE, full.boot.add("no function", nullptr));
+}
+
+void test_failure_skips_dependents() {
+    Plan plan;
+    int rtc = plan.add("rtc", 0, 0, false);
+    int clock = plan.add("clock", B::after(rtc));
+    int ntp = plan.add("ntp", B::after(clock));             // skipped through a skipped stage
+    int ble = plan.add("ble");
+    TEST_ASSERT_FALSE(plan.boot.run(nullptr, nullptr));
+    TEST_ASSERT_EQUAL(B::STATUS_FAILED, plan.boot.status(rtc));
+    TEST_ASSERT_EQUAL(B::STATUS_SKIPPED, plan.boot.status(clock));
+    TEST_ASSERT_EQUAL(B::STATUS_SKIPPED, plan.boot.status(ntp));
+    TEST_ASSERT_EQUAL(B::STATUS_DONE, plan.boot.status(ble));
+    TEST_ASSERT_EQUAL_INT(-1, plan.startedAs(clock));
+    TEST_ASSERT_EQUAL_UINT64(0, plan.boot.durationUs(clock));
+    TEST_ASSERT_EQUAL_UINT64(1000, plan.boot.durationUs(rtc));
+}
+
+void test_optional_failure_runs_dependents() {
+    Plan plan;
+    int sd = plan.add("sd", 0, B::STAGE_OPTIONAL | B::STAGE_BACKGROUND, false);
+    int log = plan.add("log", B::after(sd));
+    TEST_ASSERT_FALSE(plan.boot.run(spawnThread, yieldTask));   // the failure is still reported
+    TEST_ASSERT_EQUAL(B::STATUS_FAILED, plan.boot.status(sd));
+    TEST_ASSERT_EQUAL(B::STATUS_DONE, plan.boot.status(log));
+    TEST_ASSERT_EQUAL_INT(1, plan.startedAs(log));
+}
+
+void test_background_stages_overlap() {
+    Plan plan(steadyClock);
+    // Two 50 ms bring-ups on their own tasks and one inline stage: together well under 150 ms.
+    int ble = plan.add("ble", 0, B::STAGE_BACKGROUND, true, 0, 50);
+    int sd = plan.add("sd", 0, B::STAGE_BACKGROUND, true, 0, 50);
+    int sensor = plan.add("sensor", 0, 0, true, 0, 50);
+    int wifi = plan.add("wifi", B::after(ble));
+    int log = plan.add("log", B::after(sd) | B::after(sensor));
+    TEST_ASSERT_TRUE(plan.boot.run(spawnThread, yieldTask));
+    TEST_ASSERT_EQUAL_INT(0, plan.violations.load());
+    TEST_ASSERT_EQUAL(2, tasks.size());
+
+    uint64_t total = plan.boot.finishedAtUs() - plan.boot.beganAtUs();
+    TEST_ASSERT_LESS_THAN_UINT32(120000, (uint32_t)total);
+    TEST_ASSERT_GREATER_OR_EQUAL_UINT32(50000, (uint32_t)total);
+    TEST_ASSERT_TRUE(plan.boot.startUs(wifi) >= plan.boot.startUs(ble) + plan.boot.durationUs(ble));
+    TEST_ASSERT_TRUE(plan.boot.startUs(log) >= plan.boot.startUs(sd) + plan.boot.durationUs(sd));
+    // The inline stage started while the background ones were running.
+    TEST_ASSERT_TRUE(plan.boot.startUs(sensor) < plan.boot.startUs(ble) + plan.boot.durationUs(ble));
+}
+
+void test_detached_stage_does_not_hold_up_run() {
+    Plan plan(steadyClock);
+    int serial = plan.add("serial", 0, B::STAGE_DETACHED, true, 0, 200);
+    int sensor = plan.add("sensor");
+    uint64_t began = steadyClock();
+    TEST_ASSERT_TRUE(plan.boot.run(spawnThread, yieldTask));
+    TEST_ASSERT_LESS_THAN_UINT32(150000, (uint32_t)(steadyClock() - began));
+    TEST_ASSERT_EQUAL(B::STATUS_DONE, plan.boot.status(sensor));
+    TEST_ASSERT_EQUAL(B::STATUS_RUNNING, plan.boot.status(serial));
+    TEST_ASSERT_EQUAL_UINT64(0, plan.boot.durationUs(serial));
+
+    joinTasks();
+    TEST_ASSERT_EQUAL(B::STATUS_DONE, plan.boot.status(serial));
+    TEST_ASSERT_GREATER_OR_EQUAL_UINT32(200000, (uint32_t)plan.boot.durationUs(serial));
+}
+
+void test_refused_spawn_runs_inline() {
+    Plan plan;
+    int ble = plan.add("ble", 0, B::STAGE_BACKGROUND);
+    int wifi = plan.add("wifi", B::after(ble));
+    TEST_ASSERT_TRUE(plan.boot.run(refuseSpawn, yieldTask));
+    TEST_ASSERT_EQUAL_INT(0, plan.startedAs(ble));
+    TEST_ASSERT_EQUAL_INT(1, plan.startedAs(wifi));
+}
+
+void test_random_graphs_respect_dependencies() {
+    std::mt19937 rng(17);
+    for (int round = 0; round < 200; round++) {
+        Plan plan;
+        bool optional[B::MAX_STAGES];
+        int n = 2 + (int)(rng() % (B::MAX_STAGES - 1));
+        for (int i = 0; i < n; i++) {
+            // Depending only on earlier stages keeps the graph acyclic.
+            uint32_t deps = i ? (uint32_t)rng() & (uint32_t)rng() & ((1u << i) - 1) : 0;
+            uint8_t flags = (rng() % 2) ? B::STAGE_BACKGROUND : 0;
+            optional[i] = rng() % 8 == 0;
+            if (optional[i]) flags |= B::STAGE_OPTIONAL;
+            plan.add("s", deps, flags, rng() % 10 != 0, 10, rng() % 4 == 0 ? 1 : 0);
+        }
+        plan.boot.run(spawnThread, yieldTask);
+        joinTasks();
+        TEST_ASSERT_EQUAL_INT(0, plan.violations.load());
+
+        // A stage ran exactly when none of its dependencies was skipped or failed for good.
+        for (int i = 0; i < n; i++) {
+            bool blocked = false;
+            for (int d = 0; d < i; d++) {
+                if (!(plan.probes[i].dependsOn & B::after(d))) continue;
+                B::Status st = plan.boot.status(d);
+                if (st == B::STATUS_SKIPPED || (st == B::STATUS_FAILED && !optional[d])) blocked = true;
+            }
+            B::Status expected = blocked ? B::STATUS_SKIPPED : plan.probes[i].result ? B::STATUS_DONE : B::STATUS_FAILED;
+            TEST_ASSERT_EQUAL(expected, plan.boot.status(i));
+        }
+    }
+}
+
+void test_report_encoding() {
+    Plan plan;
+    int settings = plan.add("settings");
+    int sensor = plan.add("a-stage-name-longer-than-fifteen", B::after(settings), 0, false);
+    plan.boot.run(nullptr, nullptr);
+    plan.boot.setMilestone("first_sample", 123456);
+    plan.boot.setMilestone("advertising", 7000);
+    plan.boot.setMilestone("first_sample", 234567);        // updated, not added
+    plan.boot.setMilestone("a", 1);
+    plan.boot.setMilestone("b", 2);
+    plan.boot.setMilestone("c", 3);                         // beyond MAX_MILESTONES: dropped
+    TEST_ASSERT_EQUAL(B::MAX_MILESTONES, plan.boot.milestoneCount());
+
+    uint8_t report[B::MAX_REPORT];
+    size_t len = plan.boot.encodeReport(report, sizeof(report));
+    TEST_ASSERT_EQUAL(plan.boot.reportSize(), len);
+    TEST_ASSERT_EQUAL(0, plan.boot.encodeReport(report, len - 1));
+    len = plan.boot.encodeReport(report, len);
+
+    size_t n = 0;
+    TEST_ASSERT_EQUAL_UINT8(B::FORMAT_VERSION, report[n++]);
+    TEST_ASSERT_EQUAL_UINT8(2, report[n++]);
+    TEST_ASSERT_EQUAL_UINT8(B::MAX_MILESTONES, report[n++]);
+    TEST_ASSERT_EQUAL_UINT8(B::STATUS_DONE, report[n++]);
+    TEST_ASSERT_EQUAL_UINT32(0, getLe32(report + n)); n += 4;
+    TEST_ASSERT_EQUAL_UINT32(1000, getLe32(report + n)); n += 4;
+    TEST_ASSERT_EQUAL_UINT8(8, report[n++]);
+    TEST_ASSERT_EQUAL_MEMORY("settings", report + n, 8); n += 8;
+    TEST_ASSERT_EQUAL_UINT8(B::STATUS_FAILED, report[n++]);
+    TEST_ASSERT_EQUAL_UINT32((uint32_t)plan.boot.startUs(sensor), getLe32(report + n)); n += 4;
+    TEST_ASSERT_EQUAL_UINT32(1000, getLe32(report + n)); n += 4;
+    TEST_ASSERT_EQUAL_UINT8(B::MAX_NAME, report[n++]);     // names are cut at MAX_NAME
+    TEST_ASSERT_EQUAL_MEMORY("a-stage-name-lo", report + n, B::MAX_NAME); n += B::MAX_NAME;
+    TEST_ASSERT_EQUAL_UINT32(234567, getLe32(report + n)); n += 4;
+    TEST_ASSERT_EQUAL_UINT8(12, report[n++]);
+    TEST_ASSERT_EQUAL_MEMORY("first_sample", report + n, 12); n += 12;
+    n += 4 + 1 + 11 + 4 + 2 + 4 + 2;                         // advertising, a, b
+    TEST_ASSERT_EQUAL(len, n);
+}
+
+int main(int argc, char** argv) {
+    UNITY_BEGIN();
+    RUN_TEST(test_inline_runs_in_dependency_order);
+    RUN_TEST(test_invalid_plans_do_not_run);
+    RUN_TEST(test_failure_skips_dependents);
+    RUN_TEST(test_optional_failure_runs_dependents);
+    RUN_TEST(test_background_stages_overlap);
+    RUN_TEST(test_detached_stage_does_not_hold_up_run);
+    RUN_TEST(test_refused_spawn_runs_inline);
+    RUN_TEST(test_random_graphs_respect_dependencies);
+    RUN_TEST(test_report_encoding);
+    return UNITY_END();
+}
@@ -0,0 +1,159 @@
+// The GATT registry on FakeGatt: the firmware's constexpr table builds the expected attribute
+// layout, every characteristic's handle binds back to its table index, and writes reach the
+// handler of the characteristic that owns the handle and nothing else.
+
+#include <unity.h>
+#include "../../hal/native/FakeGatt.h"
+#include "../../src/BLELightSensorService.h"
+
+using Service = BleLightSensorService;
+
+// Static, so its settings snapshot is zeroed like it is before begin() on the device.
+static Service service;
+
+// Attributes an ATT server adds for the table: a declaration per service; per characteristic a
+// declaration and the value, plus a CCCD when it notifies or indicates.
+static constexpr uint16_t expectedAttributes() {
+    uint16_t n = Service::SVC_COUNT;
+    for (const GattCharacteristicDef& c : Service::CHARACTERISTICS) n += (c.properties & (GATT_NOTIFY | GATT_INDICATE)) ? 3 : 2;
+    return n;
+}
+
+// The table check catches the mistakes it is meant to.
+static constexpr GattServiceDef ONE_SERVICE[] = { { "9a3d0001-6b7c-4f2e-9d1a-5c3e8b7f2a10", true } };
+static void onTestWrite(void*, const uint8_t*, size_t, uint16_t) {}
+static constexpr GattCharacteristicDef IDS_OUT_OF_ORDER[] = {
+    { 1, 0, "9a3d0002-6b7c-4f2e-9d1a-5c3e8b7f2a10", GATT_READ, 0, nullptr, nullptr },
+};
+static constexpr GattCharacteristicDef DUPLICATE_UUID[] = {
+    { 0, 0, "9a3d0002-6b7c-4f2e-9d1a-5c3e8b7f2a10", GATT_READ, 0, nullptr, nullptr },
+    { 1, 0, "9A3D0002-6B7C-4F2E-9D1A-5C3E8B7F2A10", GATT_READ, 0, nullptr, nullptr },
+};
+static constexpr GattCharacteristicDef WRITABLE_WITHOUT_HANDLER[] = {
+    { 0, 0, "9a3d0002-6b7c-4f2e-9d1a-5c3e8b7f2a10", GATT_WRITE, 0, nullptr, nullptr },
+};
+static constexpr GattCharacteristicDef HANDLER_WITHOUT_WRITE[] = {
+    { 0, 0, "9a3d0002-6b7c-4f2e-9d1a-5c3e8b7f2a10", GATT_READ, 0, nullptr, onTestWrite },
+};
+static constexpr GattCharacteristicDef BAD_SERVICE_INDEX[] = {
+    { 0, 1, "9a3d0002-6b7c-4f2e-9d1a-5c3e8b7f2a10", GATT_READ, 0, nullptr, nullptr },
+};
+static constexpr GattCharacteristicDef TOO_LONG[] = {
+    { 0, 0, "9a3d0002-6b7c-4f2e-9d1a-5c3e8b7f2a10", GATT_READ, GATT_MAX_VALUE + 1, nullptr, nullptr },
+};
+static constexpr GattCharacteristicDef MALFORMED_UUID[] = {
+    { 0, 0, "9a3d0002-6b7c-4f2e-9d1a5c3e8b7f2a10-", GATT_READ, 0, nullptr, nullptr },
+};
+static_assert(!gattTableValid(ONE_SERVICE, IDS_OUT_OF_ORDER), "ids out of order");
+static_assert(!gattTableValid(ONE_SERVICE, DUPLICATE_UUID), "duplicate UUID, different case");
+static_assert(!gattTableValid(ONE_SERVICE, WRITABLE_WITHOUT_HANDLER), "writable without handler");
+static_assert(!gattTableValid(ONE_SERVICE, HANDLER_WITHOUT_WRITE), "handler on a read-only characteristic");
+static_assert(!gattTableValid(ONE_SERVICE, BAD_SERVICE_INDEX), "service index out of range");
+static_assert(!gattTableValid(ONE_SERVICE, TOO_LONG), "longer than ATT allows");
+static_assert(!gattTableValid(ONE_SERVICE, MALFORMED_UUID), "malformed UUID");
+
+struct Server {
+    FakeGatt<> gatt;
+    GattDispatcher dispatcher;
+    size_t bound;
+
+    Server() : dispatcher(Service::CHARACTERISTICS, Service::CHAR_COUNT, &service) {
+        GattBuilder::declare(gatt, Service::SERVICES, Service::CHARACTERISTICS, &service);
+        bound = GattBuilder::bind(gatt, Service::CHARACTERISTICS, dispatcher);
+    }
+};
+
+void setUp() {}
+void tearDown() {}
+
+void test_characteristic_and_attribute_counts() {
+    Server s;
+    TEST_ASSERT_EQUAL_UINT32(Service::CHAR_COUNT, s.gatt.characteristics());
+    TEST_ASSERT_EQUAL_UINT32(Service::CHAR_COUNT, s.bound);
+    TEST_ASSERT_EQUAL_UINT32(expectedAttributes(), s.gatt.attributeCount());
+    TEST_ASSERT_LESS_THAN(GattDispatcher::MAX_HANDLES, s.gatt.attributeCount());
+}
+
+void test_every_handle_binds_to_its_index() {
+    Server s;
+    uint16_t previous = 0;
+    for (size_t i = 0; i < Service::CHAR_COUNT; i++) {
+        uint16_t handle = s.gatt.handleOf(i);
+        TEST_ASSERT_GREATER_THAN(previous, handle); // declaration order
+        TEST_ASSERT_EQUAL_INT((int)i, s.dispatcher.indexOf(handle));
+        TEST_ASSERT_EQUAL_INT(-1, s.dispatcher.indexOf((uint16_t)(handle - 1))); // its declaration
+        bool cccd = Service::CHARACTERISTICS[i].properties & (GATT_NOTIFY | GATT_INDICATE);
+        if (cccd) TEST_ASSERT_EQUAL_INT(-1, s.dispatcher.indexOf((uint16_t)(handle + 1)));
+        previous = handle;
+    }
+    TEST_ASSERT_EQUAL_INT(-1, s.dispatcher.indexOf((uint16_t)0));
+    TEST_ASSERT_EQUAL_INT(-1, s.dispatcher.indexOf((uint16_t)(s.gatt.attributeCount() + 1)));
+    TEST_ASSERT_EQUAL_INT(-1, s.dispatcher.indexOf((uint16_t)GattDispatcher::MAX_HANDLES));
+}
+
+void test_uuid_lookup_matches_table() {
+    Server s;
+    for (size_t i = 0; i < Service::CHAR_COUNT; i++) {
+        TEST_ASSERT_EQUAL_INT((int)i, s.dispatcher.indexOf(GattUuid::parse(Service::CHARACTERISTICS[i].uuid)));
+    }
+    TEST_ASSERT_EQUAL_INT(-1, s.dispatcher.indexOf(GattUuid::parse(Service::UUID_LIGHT_SERVICE)));
+    // Over-the-air order: the last text byte pair comes first.
+    GattUuid u = GattUuid::parse(Service::UUID_HISTORY_CONTROL_CHAR);
+    TEST_ASSERT_EQUAL_HEX8(0x10, u.bytes[0]);
+    TEST_ASSERT_EQUAL_HEX8(0x9a, u.bytes[15]);
+    TEST_ASSERT_EQUAL_HEX8(0x02, u.bytes[12]);
+}
+
+void test_writes_reach_only_writable_characteristics() {
+    Server s;
+    const uint8_t abort[] = { HistoryTransfer::CMD_ABORT };
+    for (size_t i = 0; i < Service::CHAR_COUNT; i++) {
+        const GattCharacteristicDef& c = Service::CHARACTERISTICS[i];
+        bool writable = c.properties & (GATT_WRITE | GATT_WRITE_NR);
+        TEST_ASSERT_EQUAL(writable, c.onWrite != nullptr);
+    }
+    uint32_t misses = s.dispatcher.missCount();
+    TEST_ASSERT_FALSE(s.gatt.write(s.dispatcher, s.gatt.handleOf(Service::CHAR_LIGHT), abort, sizeof(abort)));
+    TEST_ASSERT_FALSE(s.gatt.write(s.dispatcher, s.gatt.handleOf(Service::CHAR_HISTORY_DATA), abort, sizeof(abort)));
+    TEST_ASSERT_FALSE(s.dispatcher.dispatch((uint16_t)(s.gatt.handleOf(Service::CHAR_HISTORY_CONTROL) - 1), abort, sizeof(abort), 0));
+    TEST_ASSERT_EQUAL_UINT32(misses + 3, s.dispatcher.missCount());
+
+    // No history transfer attached: the handler returns without touching anything.
+    TEST_ASSERT_TRUE(s.gatt.write(s.dispatcher, s.gatt.handleOf(Service::CHAR_HISTORY_CONTROL), abort, sizeof(abort)));
+    TEST_ASSERT_EQUAL_UINT32(1, s.gatt.valueLength(Service::CHAR_HISTORY_CONTROL));
+    TEST_ASSERT_EQUAL_UINT32(misses + 3, s.dispatcher.missCount());
+
+    latencyStats.record(LatencyStats::STAGE_LUX, 100);
+    TEST_ASSERT_TRUE(latencyStats.count(LatencyStats::STAGE_LUX) > 0);
+    const uint8_t reset[] = { Service::LATENCY_STATS_RESET };
+    TEST_ASSERT_TRUE(s.gatt.write(s.dispatcher, s.gatt.handleOf(Service::CHAR_LATENCY_STATS), reset, sizeof(reset)));
+    TEST_ASSERT_EQUAL_UINT32(0, latencyStats.count(LatencyStats::STAGE_LUX));
+}
+
+// Every initial value is set in full; the latency snapshot is the largest.
+void test_initial_values() {
+    Server s;
+    TEST_ASSERT_EQUAL_UINT32(LightPayload::SIZE, s.gatt.valueLength(Service::CHAR_LIGHT));
+    TEST_ASSERT_EQUAL_UINT32(StreamingStats::SUMMARY_SIZE, s.gatt.valueLength(Service::CHAR_LIGHT_STATS));
+    TEST_ASSERT_EQUAL_UINT32(LatencyStats::SNAPSHOT_SIZE, s.gatt.valueLength(Service::CHAR_LATENCY_STATS));
+    TEST_ASSERT_EQUAL_UINT32(2, s.gatt.valueLength(Service::CHAR_LIGHT_TEXT));
+    TEST_ASSERT_EQUAL_MEMORY("-1", s.gatt.value(Service::CHAR_LIGHT_TEXT), 2);
+    TEST_ASSERT_EQUAL_UINT32(1, s.gatt.valueLength(Service::CHAR_WIFI_SCAN_CMD));
+    TEST_ASSERT_EQUAL_MEMORY("0", s.gatt.value(Service::CHAR_WIFI_SCAN_CMD), 1);
+    TEST_ASSERT_EQUAL_UINT32(0, s.gatt.valueLength(Service::CHAR_WIFI_SSIDS));
+    TEST_ASSERT_EQUAL_UINT32(0, s.gatt.valueLength(Service::CHAR_HISTORY_DATA));
+
+    LightSample decoded;
+    TEST_ASSERT_TRUE(LightPayload::decode(s.gatt.value(Service::CHAR_LIGHT), LightPayload::SIZE, decoded));
+    TEST_ASSERT_EQUAL_HEX8(LightSample::FLAG_NO_SIGNAL, decoded.flags & LightSample::FLAG_NO_SIGNAL);
+}
+
+int main(int argc, char** argv) {
+    UNITY_BEGIN();
+    RUN_TEST(test_characteristic_and_attribute_counts);
+    RUN_TEST(test_every_handle_binds_to_its_index);
+    RUN_TEST(test_uuid_lookup_matches_table);
+    RUN_TEST(test_writes_reach_only_writable_characteristics);
+    RUN_TEST(test_initial_values);
+    return UNITY_END();
+}
@@ -0,0 +1,289 @@
+// HistoryTransfer against HistoryReassembler over a simulated link that drops and reorders
+// notifications, with the control writes going through a GATT table on FakeGatt. Also the
+// hand-off of requests from the BLE host task to the loop, with two threads.
+
+#include <unity.h>
+#include <atomic>
+#include <deque>
+#include <random>
+#include <thread>
+#include <vector>
+#include "../../hal/native/FakeGatt.h"
+#include "../../hal/native/LogCard.h"
+#include "../../src/HistoryTransfer.h"
+
+static const uint32_t DAY = 20370;
+static const uint64_t T0 = (uint64_t)DAY * SampleLog::MS_PER_DAY + 6 * 3600000ULL;
+static const uint32_t RECORDS = 3000;
+
+static uint64_t nowMs() { return T0 + 12 * 3600000ULL; }
+
+static uint32_t luxAt(uint32_t sequence) { return LogCard::luxAt(T0 + (uint64_t)sequence * 1000); }
+
+// A day of one-second samples on a scratch card, and a transfer reading it.
+struct Device : LogCard {
+    HistoryTransfer transfer;
+
+    Device() : transfer(reader, nowMs) { TEST_ASSERT_TRUE(write(T0, RECORDS)); }
+};
+
+// The history service as the firmware declares it, cut down to its two characteristics.
+enum { CHAR_CONTROL, CHAR_DATA };
+
+static void onControl(void* owner, const uint8_t* data, size_t len, uint16_t) {
+    static_cast<HistoryTransfer*>(owner)->handleCommand(data, len);
+}
+
+static constexpr GattServiceDef SERVICES[] = {
+    { "9a3d0001-6b7c-4f2e-9d1a-5c3e8b7f2a10", false },
+};
+static constexpr GattCharacteristicDef CHARS[] = {
+    { CHAR_CONTROL, 0, "9a3d0002-6b7c-4f2e-9d1a-5c3e8b7f2a10", GATT_WRITE,  20,                          nullptr, onControl },
+    { CHAR_DATA,    0, "9a3d0003-6b7c-4f2e-9d1a-5c3e8b7f2a10", GATT_NOTIFY, HistoryTransfer::MAX_PACKET, nullptr, nullptr },
+};
+static_assert(gattTableValid(SERVICES, CHARS), "history test table");
+
+// Notifications in flight. Each one is dropped with probability loss, otherwise queued up to
+// depth places ahead of packets sent before it.
+struct LossyLink {
+    std::deque<std::vector<uint8_t>> inFlight;
+    std::mt19937 rng;
+    double loss;
+    uint32_t depth;
+    uint32_t sent, dropped;
+
+    LossyLink(uint32_t seed, double loss_, uint32_t depth_) : rng(seed), loss(loss_), depth(depth_), sent(0), dropped(0) {}
+
+    void send(const uint8_t* data, size_t len) {
+        sent++;
+        if (std::uniform_real_distribution<double>(0, 1)(rng) < loss) {
+            dropped++;
+            return;
+        }
+        uint32_t back = depth ? std::uniform_int_distribution<uint32_t>(0, depth)(rng) : 0;
+        if (back > inFlight.size()) back = (uint32_t)inFlight.size();
+        inFlight.insert(inFlight.end() - back, std::vector<uint8_t>(data, data + len));
+    }
+};
+
+struct Central {
+    FakeGatt<> gatt;
+    GattDispatcher dispatcher;
+    HistoryReassembler reassembler;
+    std::vector<uint32_t> luxBySequence; // 0 = not received yet
+    uint32_t duplicates;
+    uint32_t requests;
+    std::vector<std::vector<uint8_t>> held; // arrived ahead of the one the reassembler needs next
+    uint8_t nextCounter;
+
+    explicit Central(HistoryTransfer& transfer)
+        : dispatcher(CHARS, 2, &transfer), reassembler(onRecord, this),
+          luxBySequence(RECORDS, 0), duplicates(0), requests(0), nextCounter(0) {
+        GattBuilder::declare(gatt, SERVICES, CHARS, &transfer);
+        TEST_ASSERT_EQUAL_UINT32(2, GattBuilder::bind(gatt, CHARS, dispatcher));
+    }
+
+    static void onRecord(const LightSample& s, void* context) {
+        Central* self = static_cast<Central*>(context);
+        TEST_ASSERT_LESS_THAN_UINT32(RECORDS, s.sequence);
+        TEST_ASSERT_EQUAL_UINT32(luxAt(s.sequence), s.centiLux);
+        TEST_ASSERT_EQUAL_UINT64(T0 + (uint64_t)s.sequence * 1000, s.timestampMs);
+        if (self->luxBySequence[s.sequence]) self->duplicates++;
+        self->luxBySequence[s.sequence] = s.centiLux;
+    }
+
+    void requestFrom(uint32_t fromSeq, uint8_t encoding, uint8_t window = 0) {
+        uint8_t cmd[11] = { HistoryTransfer::CMD_START_SEQUENCE };
+        putLe32(cmd + 1, fromSeq);
+        putLe32(cmd + 5, RECORDS - 1);
+        cmd[9] = window;
+        cmd[10] = encoding;
+        reassembler.reset(fromSeq);
+        TEST_ASSERT_TRUE(gatt.write(dispatcher, gatt.handleOf(CHAR_CONTROL), cmd, sizeof(cmd)));
+        requests++;
+        held.clear();
+        nextCounter = 0;
+    }
+
+    // Puts notifications back in counter order before the reassembler sees them. Once more than
+    // REORDER_WINDOW are waiting, the one in front of them was lost: re-request from the gap.
+    void receive(const std::vector<uint8_t>& packet, uint8_t encoding) {
+        static const size_t REORDER_WINDOW = 4;
+        held.push_back(packet);
+        for (size_t i = 0; i < held.size();) {
+            if ((int8_t)(held[i][1] - nextCounter) > 0) { i++; continue; }
+            HistoryReassembler::Result r = reassembler.feed(held[i].data(), held[i].size());
+            if (r == HistoryReassembler::RESULT_OK || r == HistoryReassembler::RESULT_END) nextCounter = (uint8_t)(held[i][1] + 1);
+            held.erase(held.begin() + (ptrdiff_t)i);
+            i = 0;
+        }
+        if (held.size() > REORDER_WINDOW) {
+            std::vector<uint8_t> first = held.front();
+            for (const std::vector<uint8_t>& p : held) if ((int8_t)(p[1] - first[1]) < 0) first = p;
+            TEST_ASSERT_EQUAL(HistoryReassembler::RESULT_GAP, reassembler.feed(first.data(), first.size()));
+            requestFrom(reassembler.resumeSequence(), encoding);
+        }
+    }
+
+    bool complete() const { return reassembler.resumeSequence() >= RECORDS; }
+};
+
+// Pumps device and link until every record has arrived. The central re-requests from where it
+// got to on a gap, and again if the device goes quiet before the log is complete.
+static void runTransfer(uint8_t encoding, uint16_t mtu, double loss, uint32_t depth, uint32_t seed) {
+    Device device;
+    Central central(device.transfer);
+    LossyLink link(seed, loss, depth);
+    central.requestFrom(0, encoding);
+
+    for (int step = 0; step < 100000 && !central.complete(); step++) {
+        for (int i = 0; i < 16; i++) { // BLELightSensorService::MAX_HISTORY_PACKETS_PER_PUMP
+            const uint8_t* packet;
+            size_t len = device.transfer.nextPacket(mtu, packet);
+            if (len == 0) break;
+            TEST_ASSERT_LESS_OR_EQUAL(mtu - HistoryTransfer::ATT_HEADER, len);
+            device.transfer.packetSent();
+            link.send(packet, len);
+        }
+        while (!link.inFlight.empty()) {
+            central.receive(link.inFlight.front(), encoding);
+            link.inFlight.pop_front();
+        }
+        if (!device.transfer.active() && !central.complete()) {
+            central.requestFrom(central.reassembler.resumeSequence(), encoding);
+        }
+    }
+
+    TEST_ASSERT_TRUE(central.complete());
+    for (uint32_t i = 0; i < RECORDS; i++) TEST_ASSERT_EQUAL_UINT32(luxAt(i), central.luxBySequence[i]);
+    TEST_ASSERT_EQUAL_UINT32(0, central.duplicates);
+    if (loss > 0) {
+        TEST_ASSERT_GREATER_THAN(0, link.dropped);
+        TEST_ASSERT_GREATER_THAN(1, central.requests);
+    }
+}
+
+void setUp() {}
+void tearDown() {}
+
+void test_clean_link_raw() { runTransfer(HistoryTransfer::ENCODING_RAW, 247, 0, 0, 1); }
+void test_clean_link_delta() { runTransfer(HistoryTransfer::ENCODING_DELTA, 247, 0, 0, 1); }
+void test_loss_raw() { runTransfer(HistoryTransfer::ENCODING_RAW, 247, 0.05, 0, 2); }
+void test_loss_delta() { runTransfer(HistoryTransfer::ENCODING_DELTA, 185, 0.05, 0, 3); }
+void test_loss_and_reorder_raw() { runTransfer(HistoryTransfer::ENCODING_RAW, 247, 0.05, 3, 4); }
+void test_loss_and_reorder_delta() { runTransfer(HistoryTransfer::ENCODING_DELTA, 247, 0.10, 3, 5); }
+void test_reorder_minimum_mtu() { runTransfer(HistoryTransfer::ENCODING_RAW, HistoryTransfer::MIN_MTU, 0.02, 2, 6); }
+
+// Every packet of one clean transfer is sized to the MTU and counted in order.
+void test_packets_fill_mtu() {
+    Device device;
+    Central central(device.transfer);
+    central.requestFrom(0, HistoryTransfer::ENCODING_RAW);
+    const uint16_t mtu = 100;
+    const size_t perPacket = (mtu - HistoryTransfer::ATT_HEADER - HistoryTransfer::DATA_HEADER) / SampleLog::RECORD_SIZE;
+    const uint8_t* packet;
+    size_t len;
+    uint8_t counter = 0;
+    uint32_t dataPackets = 0;
+    while ((len = device.transfer.nextPacket(mtu, packet)) > 0) {
+        TEST_ASSERT_EQUAL_HEX8(counter++, packet[1]);
+        central.gatt.setValue(CHAR_DATA, packet, len);
+        device.transfer.packetSent();
+        if (packet[0] == HistoryTransfer::PKT_END) break;
+        TEST_ASSERT_EQUAL_UINT32(perPacket * dataPackets, getLe32(packet + 2));
+        if ((dataPackets + 1) * perPacket <= RECORDS) TEST_ASSERT_EQUAL_UINT32(HistoryTransfer::DATA_HEADER + perPacket * SampleLog::RECORD_SIZE, len);
+        dataPackets++;
+    }
+    TEST_ASSERT_EQUAL_UINT32((RECORDS + perPacket - 1) / perPacket, dataPackets);
+    const uint8_t* end = central.gatt.value(CHAR_DATA);
+    TEST_ASSERT_EQUAL_UINT32(HistoryTransfer::END_SIZE, central.gatt.valueLength(CHAR_DATA));
+    TEST_ASSERT_EQUAL_HEX8(HistoryTransfer::PKT_END, end[0]);
+    TEST_ASSERT_EQUAL_UINT32(RECORDS, getLe32(end + 2));
+    TEST_ASSERT_EQUAL_UINT32(RECORDS, getLe32(end + 6));
+    TEST_ASSERT_EQUAL_HEX8(HistoryTransfer::STATUS_COMPLETE, end[10]);
+    TEST_ASSERT_FALSE(device.transfer.active());
+}
+
+// With a window the device stops after that many packets until the central grants credit.
+void test_flow_control_window() {
+    Device device;
+    Central central(device.transfer);
+    central.requestFrom(0, HistoryTransfer::ENCODING_RAW, 3);
+    const uint8_t* packet;
+    for (int i = 0; i < 3; i++) {
+        TEST_ASSERT_GREATER_THAN(0, device.transfer.nextPacket(247, packet));
+        device.transfer.packetSent();
+    }
+    TEST_ASSERT_EQUAL_UINT32(0, device.transfer.nextPacket(247, packet));
+    const uint8_t credit[] = { HistoryTransfer::CMD_CREDIT, 1 };
+    TEST_ASSERT_TRUE(central.gatt.write(central.dispatcher, central.gatt.handleOf(CHAR_CONTROL), credit, sizeof(credit)));
+    TEST_ASSERT_GREATER_THAN(0, device.transfer.nextPacket(247, packet));
+    device.transfer.packetSent();
+    TEST_ASSERT_EQUAL_UINT32(0, device.transfer.nextPacket(247, packet));
+
+    const uint8_t abort[] = { HistoryTransfer::CMD_ABORT };
+    TEST_ASSERT_TRUE(central.gatt.write(central.dispatcher, central.gatt.handleOf(CHAR_CONTROL), abort, sizeof(abort)));
+    TEST_ASSERT_EQUAL_UINT32(HistoryTransfer::END_SIZE, device.transfer.nextPacket(247, packet));
+    TEST_ASSERT_EQUAL_HEX8(HistoryTransfer::STATUS_ABORTED, packet[10]);
+}
+
+// The host task writes requests while the loop serves them. Each request asks for exactly four
+// records, so a transfer built from halves of two different requests shows up as a wrong count.
+void test_requests_from_another_thread() {
+    Device device;
+    HistoryTransfer& transfer = device.transfer;
+    std::atomic<bool> done(false);
+    std::atomic<uint32_t> rejected(0);
+
+    std::thread host([&] {
+        uint8_t cmd[11] = { HistoryTransfer::CMD_START_SEQUENCE };
+        for (uint32_t i = 0; i < 20000; i++) {
+            uint32_t from = (i * 7919) % (RECORDS - 4);
+            putLe32(cmd + 1, from);
+            putLe32(cmd + 5, from + 3);
+            if (!transfer.handleCommand(cmd, sizeof(cmd))) {
+                rejected++;
+                std::this_thread::yield();
+            }
+        }
+        done = true;
+    });
+
+    uint32_t completed = 0, firstSequence = 0, records = 0;
+    bool sawData = false;
+    while (!done.load() || transfer.active()) {
+        const uint8_t* packet;
+        size_t len = transfer.nextPacket(247, packet);
+        if (len == 0) { std::this_thread::yield(); continue; }
+        if (packet[0] == HistoryTransfer::PKT_DATA) {
+            if (packet[1] == 0) { firstSequence = getLe32(packet + 2); records = 0; sawData = true; }
+            records += (uint32_t)((len - HistoryTransfer::DATA_HEADER) / SampleLog::RECORD_SIZE);
+        } else if (packet[0] == HistoryTransfer::PKT_END) {
+            TEST_ASSERT_EQUAL_HEX8(HistoryTransfer::STATUS_COMPLETE, packet[10]);
+            TEST_ASSERT_TRUE(sawData);
+            TEST_ASSERT_EQUAL_UINT32(4, records);
+            TEST_ASSERT_EQUAL_UINT32(4, getLe32(packet + 6));
+            TEST_ASSERT_EQUAL_UINT32(firstSequence + 4, getLe32(packet + 2));
+            completed++;
+            sawData = false;
+        }
+        transfer.packetSent();
+    }
+    host.join();
+    TEST_ASSERT_GREATER_THAN(0, completed);
+}
+
+int main(int argc, char** argv) {
+    UNITY_BEGIN();
+    RUN_TEST(test_clean_link_raw);
+    RUN_TEST(test_clean_link_delta);
+    RUN_TEST(test_loss_raw);
+    RUN_TEST(test_loss_delta);
+    RUN_TEST(test_loss_and_reorder_raw);
+    RUN_TEST(test_loss_and_reorder_delta);
+    RUN_TEST(test_reorder_minimum_mtu);
+    RUN_TEST(test_packets_fill_mtu);
+    RUN_TEST(test_flow_control_window);
+    RUN_TEST(test_requests_from_another_thread);
+    return UNITY_END();
+}
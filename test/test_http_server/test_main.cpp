@@ -0,0 +1,362 @@
+// HttpServer over host sockets (PosixHttpTransport on a loopback port), driven by a plain
+// socket client: /latest, /history from a sample log on a scratch directory, /metrics and /trace
+// responses checked byte for byte after de-chunking, plus keep-alive, errors, the single history
+// stream and the connection limit.
+
+#include <unity.h>
+#include <string>
+#include "../../hal/native/LogCard.h"
+#include "../../hal/native/PosixHttpTransport.h"
+#include "../../src/HttpServer.h"
+#include "../../src/TraceLog.h"
+
+static const uint64_t DAY_MS = SampleLog::MS_PER_DAY;
+static const uint64_t T0 = 20370ULL * DAY_MS + 8 * 3600000ULL;   // 2025-10-09 08:00, first sample
+
+// A response as the client saw it; body de-chunked.
+struct Response {
+    int status;
+    std::string head;
+    std::string body;
+    bool closed;      // the server closed the connection after it
+
+    bool hasHeader(const char* line) const { return head.find(std::string("\r\n") + line + "\r\n") != std::string::npos; }
+};
+
+static uint64_t nowEpochMs = T0;
+static uint64_t epochNow() { return nowEpochMs; }
+
+static LightSample latest;
+static bool haveLatest;
+static bool latestFn(LightSample& out) {
+    out = latest;
+    return haveLatest;
+}
+
+// The server on an ephemeral loopback port, serviced by the client helpers as they wait.
+struct Site {
+    PosixHttpTransport transport;
+    HttpServer server;
+    uint32_t nowMs;
+
+    Site() : server(transport), nowMs(0) {
+        TEST_ASSERT_TRUE(server.begin(0));
+        TEST_ASSERT_NOT_EQUAL(0, transport.boundPort());
+    }
+
+    void service() {
+        server.service(nowMs);
+        nowMs += 10;
+    }
+
+    int connect() {
+        int fd = socket(AF_INET, SOCK_STREAM, 0);
+        TEST_ASSERT_TRUE(fd >= 0);
+        sockaddr_in addr;
+        memset(&addr, 0, sizeof(addr));
+        addr.sin_family = AF_INET;
+        addr.sin_port = htons(transport.boundPort());
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        TEST_ASSERT_EQUAL(0, ::connect(fd, (sockaddr*)&addr, sizeof(addr)));
+        return fd;
+    }
+
+    void send(int fd, const std::string& request) {
+        TEST_ASSERT_EQUAL((int)request.size(), (int)::send(fd, request.data(), request.size(), MSG_NOSIGNAL));
+    }
+
+    // Services the server and reads until one whole response is in (or the server closed).
+    Response receive(int fd) {
+        std::string raw;
+        Response r = {0, "", "", false};
+        for (int i = 0; i < 100000; i++) {
+            service();
+            char buf[4096];
+            ssize_t n;
+            while ((n = recv(fd, buf, sizeof(buf), MSG_DONTWAIT)) > 0) raw.append(buf, (size_t)n);
+            if (n == 0) r.closed = true;
+            if (parse(raw, r) || r.closed) break;
+        }
+        return r;
+    }
+
+    Response get(int fd, const char* target, const char* headers = "") {
+        send(fd, std::string("GET ") + target + " HTTP/1.1\r\nHost: photoniq\r\n" + headers + "\r\n");
+        return receive(fd);
+    }
+
+    // One request on its own connection.
+    Response get(const char* target) {
+        int fd = connect();
+        Response r = get(fd, target);
+        ::close(fd);
+        return r;
+    }
+
+    // True once raw holds a complete response; fills r.
+    static bool parse(const std::string& raw, Response& r) {
+        size_t end = raw.find("\r\n\r\n");
+        if (end == std::string::npos) return false;
+        r.head = raw.substr(0, end + 2);
+        if (sscanf(r.head.c_str(), "HTTP/1.1 %d", &r.status) != 1) return false;
+        size_t at = end + 4;
+        size_t length = r.head.find("\r\nContent-Length: ");
+        if (length != std::string::npos) {
+            size_t len = strtoul(r.head.c_str() + length + 18, nullptr, 10);
+            if (raw.size() < at + len) return false;
+            r.body = raw.substr(at, len);
+            return true;
+        }
+        TEST_ASSERT_TRUE(r.hasHeader("Transfer-Encoding: chunked"));
+        r.body.clear();
+        for (;;) {
+            size_t line = raw.find("\r\n", at);
+            if (line == std::string::npos) return false;
+            size_t len = strtoul(raw.c_str() + at, nullptr, 16);
+            if (raw.size() < line + 2 + len + 2) return false;
+            if (len == 0) return true;
+            r.body.append(raw, line + 2, len);
+            TEST_ASSERT_EQUAL_STRING("\r\n", raw.substr(line + 2 + len, 2).c_str());
+            at = line + 2 + len + 2;
+        }
+    }
+};
+
+static size_t countLines(const std::string& s) {
+    size_t n = 0;
+    for (char ch : s) n += ch == '\n';
+    return n;
+}
+
+void setUp() {
+    haveLatest = false;
+    nowEpochMs = T0;
+}
+void tearDown() {}
+
+void test_latest_before_first_sample() {
+    Site site;
+    site.server.setLatest(latestFn);
+    Response r = site.get("/latest");
+    TEST_ASSERT_EQUAL(503, r.status);
+    TEST_ASSERT_EQUAL_STRING("no sample yet\n", r.body.c_str());
+
+    Site bare;
+    TEST_ASSERT_EQUAL(503, bare.get("/latest").status);
+}
+
+void test_latest_as_json() {
+    Site site;
+    site.server.setLatest(latestFn);
+    latest = {};
+    latest.sequence = 4711;
+    latest.timestampMs = 1760000000123ULL;
+    latest.centiLux = 123405;
+    latest.fullCount = 3100;
+    latest.irCount = 410;
+    latest.control = 0x15;
+    latest.flags = LightSample::FLAG_SATURATED;
+    haveLatest = true;
+    Response r = site.get("/latest");
+    TEST_ASSERT_EQUAL(200, r.status);
+    TEST_ASSERT_TRUE(r.hasHeader("Content-Type: application/json"));
+    TEST_ASSERT_EQUAL_STRING("{\"sequence\":4711,\"timestamp_ms\":1760000000123,\"lux\":1234.05,\"ch0\":3100,\"ch1\":410,"
+                             "\"control\":21,\"flags\":1}\n", r.body.c_str());
+}
+
+// 2000 samples, a second apart: the requested hour comes back as a header and one row per
+// sample, over many chunks.
+void test_history_range_as_csv() {
+    LogCard card;
+    TEST_ASSERT_TRUE(card.write(T0, 2000));
+    Site site;
+    site.server.setHistory(&card.reader, epochNow);
+    Response r = site.get("/history?from=1760000000000&to=0"); // to before from
+    TEST_ASSERT_EQUAL(400, r.status);
+
+    char target[96];
+    snprintf(target, sizeof(target), "/history?from=%llu&to=%llu", (unsigned long long)(T0 + 100000),
+             (unsigned long long)(T0 + 100000 + 3599000));
+    r = site.get(target);
+    TEST_ASSERT_EQUAL(200, r.status);
+    TEST_ASSERT_TRUE(r.hasHeader("Content-Type: text/csv"));
+    TEST_ASSERT_EQUAL(1 + 1900, countLines(r.body)); // the log ends inside the hour
+    TEST_ASSERT_EQUAL(0, r.body.find("sequence,timestamp_ms,lux,ch0,ch1,control,flags\n"));
+
+    char row[96];
+    uint64_t first = T0 + 100000;
+    uint32_t lux = LogCard::luxAt(first);
+    snprintf(row, sizeof(row), ",%llu,%lu.%02lu,%u,%u,17,0\n", (unsigned long long)first, (unsigned long)(lux / 100),
+             (unsigned long)(lux % 100), (unsigned)(lux / 4), (unsigned)(lux / 16));
+    TEST_ASSERT_TRUE(r.body.find(row) != std::string::npos);
+    TEST_ASSERT_TRUE(r.body.find(std::to_string(T0 + 99000) + ",") == std::string::npos);
+    TEST_ASSERT_TRUE(r.body.find(std::to_string(T0 + 1999000) + ",") != std::string::npos);
+    TEST_ASSERT_EQUAL(1, site.server.getStats().historyStreams);
+}
+
+// Without a range: the last day up to now. Malformed bounds are refused.
+void test_history_defaults_and_bad_queries() {
+    LogCard card;
+    TEST_ASSERT_TRUE(card.write(T0, 600));
+    nowEpochMs = T0 + 299500;
+    Site site;
+    site.server.setHistory(&card.reader, epochNow);
+    Response r = site.get("/history");
+    TEST_ASSERT_EQUAL(200, r.status);
+    TEST_ASSERT_EQUAL(1 + 300, countLines(r.body));
+
+    TEST_ASSERT_EQUAL(400, site.get("/history?from=yesterday").status);
+    TEST_ASSERT_EQUAL(400, site.get("/history?to=12x").status);
+
+    Site noLog;
+    TEST_ASSERT_EQUAL(404, noLog.get("/history").status);
+}
+
+// One history stream at a time: a second download gets a 503 with Retry-After until the first is done.
+void test_history_one_stream_at_a_time() {
+    LogCard card;
+    TEST_ASSERT_TRUE(card.write(T0, 3000));
+    nowEpochMs = T0 + 3000000;
+    Site site;
+    site.server.setHistory(&card.reader, epochNow);
+    int first = site.connect();
+    site.send(first, "GET /history HTTP/1.1\r\n\r\n");
+    site.service();
+    site.service();
+    Response busy = site.get("/history");
+    TEST_ASSERT_EQUAL(503, busy.status);
+    TEST_ASSERT_TRUE(busy.hasHeader("Retry-After: 1"));
+
+    Response r = site.receive(first);
+    TEST_ASSERT_EQUAL(200, r.status);
+    TEST_ASSERT_EQUAL(1 + 3000, countLines(r.body));
+    TEST_ASSERT_EQUAL(200, site.get(first, "/history").status);
+    ::close(first);
+}
+
+static double metricValue(void* context) { return *static_cast<double*>(context); }
+
+// Every registered metric in Prometheus text format, in registration order, across chunks.
+void test_metrics_in_text_format() {
+    Site site;
+    static double values[HttpServer::MAX_METRICS];
+    static char names[HttpServer::MAX_METRICS][32];
+    for (size_t i = 0; i < HttpServer::MAX_METRICS; i++) {
+        values[i] = i * 1.5;
+        snprintf(names[i], sizeof(names[i]), "photoniq_test_%02u", (unsigned)i);
+        TEST_ASSERT_TRUE(site.server.addMetric(names[i], "A test value.", i % 2 ? HttpServer::METRIC_COUNTER : HttpServer::METRIC_GAUGE,
+                                               metricValue, &values[i]));
+    }
+    TEST_ASSERT_FALSE(site.server.addMetric("photoniq_one_too_many", "x", HttpServer::METRIC_GAUGE, metricValue, &values[0]));
+
+    Response r = site.get("/metrics");
+    TEST_ASSERT_EQUAL(200, r.status);
+    TEST_ASSERT_TRUE(r.hasHeader("Content-Type: text/plain; version=0.0.4"));
+    std::string expected;
+    for (size_t i = 0; i < HttpServer::MAX_METRICS; i++) {
+        char text[160];
+        snprintf(text, sizeof(text), "# HELP %s A test value.\n# TYPE %s %s\n%s %.10g\n", names[i], names[i],
+                 i % 2 ? "counter" : "gauge", names[i], values[i]);
+        expected += text;
+    }
+    TEST_ASSERT_GREATER_THAN(HttpServer::TX_BUFFER, expected.size());
+    TEST_ASSERT_EQUAL_STRING(expected.c_str(), r.body.c_str());
+
+    values[3] = 42;
+    TEST_ASSERT_TRUE(site.get("/metrics").body.find("\nphotoniq_test_03 42\n") != std::string::npos);
+}
+
+static size_t traceDump(void* context, uint32_t& cursor, uint8_t* out, size_t capacity) {
+    return static_cast<TraceLog*>(context)->dump(cursor, out, capacity);
+}
+
+// /trace is TraceLog::dump() verbatim: more records than the ring holds, so the oldest are gone.
+void test_trace_is_the_ring_dump() {
+    static TraceLog log;
+    static constexpr TraceSite site_ = {"test record %u of %s", traceFormatId("test record %u of %s"), TRACE_LEVEL_INFO};
+    const char* who = "test_http_server";
+    for (uint32_t i = 0; i < TraceLog::CAPACITY + 44; i++) log.write(&site_, i, who);
+
+    Site site;
+    TEST_ASSERT_EQUAL(404, site.get("/trace").status); // not registered
+    site.server.setTrace(traceDump, &log);
+    Response r = site.get("/trace");
+    TEST_ASSERT_EQUAL(200, r.status);
+    TEST_ASSERT_TRUE(r.hasHeader("Content-Type: application/octet-stream"));
+
+    std::string expected;
+    uint32_t cursor = 0;
+    uint8_t piece[512];
+    size_t n;
+    while ((n = log.dump(cursor, piece, sizeof(piece))) > 0) expected.append((const char*)piece, n);
+    TEST_ASSERT_EQUAL(expected.size(), r.body.size());
+    TEST_ASSERT_TRUE(expected == r.body);
+
+    const uint8_t* body = (const uint8_t*)r.body.data();
+    TEST_ASSERT_EQUAL_MEMORY("PTRC", body, 4);
+    TEST_ASSERT_EQUAL_UINT32(TraceLog::CAPACITY + 44, getLe32(body + 8));
+    TEST_ASSERT_EQUAL_UINT32(44, getLe32(body + TraceLog::DUMP_HEADER)); // index of the oldest record kept
+}
+
+// Requests follow one another on a kept-alive connection; errors keep it open, close ends it.
+void test_keep_alive_and_errors() {
+    Site site;
+    site.server.setLatest(latestFn);
+    haveLatest = true;
+    int fd = site.connect();
+    TEST_ASSERT_EQUAL(200, site.get(fd, "/latest").status);
+    TEST_ASSERT_EQUAL(404, site.get(fd, "/nowhere").status);
+    site.send(fd, "POST /latest HTTP/1.1\r\nContent-Length: 0\r\n\r\n");
+    TEST_ASSERT_EQUAL(405, site.receive(fd).status);
+    Response last = site.get(fd, "/latest", "Connection: close\r\n");
+    TEST_ASSERT_EQUAL(200, last.status);
+    TEST_ASSERT_TRUE(last.hasHeader("Connection: close"));
+    TEST_ASSERT_TRUE(site.receive(fd).closed);
+    ::close(fd);
+
+    fd = site.connect();
+    site.send(fd, "nonsense\r\n\r\n");
+    Response bad = site.receive(fd);
+    TEST_ASSERT_EQUAL(400, bad.status);
+    ::close(fd);
+
+    const HttpServer::Stats& stats = site.server.getStats();
+    TEST_ASSERT_EQUAL_UINT32(2, stats.connections);
+    TEST_ASSERT_EQUAL_UINT32(5, stats.requests);
+    TEST_ASSERT_EQUAL_UINT32(3, stats.errors);
+}
+
+// Beyond MAX_CONNECTIONS a client is turned away at once; idle connections time out.
+void test_connection_limit_and_idle_timeout() {
+    Site site;
+    site.server.setLatest(latestFn);
+    int fds[HttpServer::MAX_CONNECTIONS];
+    for (size_t i = 0; i < HttpServer::MAX_CONNECTIONS; i++) fds[i] = site.connect();
+    site.service();
+    TEST_ASSERT_EQUAL(HttpServer::MAX_CONNECTIONS, site.server.connectionCount());
+
+    int extra = site.connect();
+    Response r = site.receive(extra);
+    TEST_ASSERT_EQUAL(503, r.status);
+    TEST_ASSERT_TRUE(r.hasHeader("Retry-After: 1"));
+    TEST_ASSERT_EQUAL_UINT32(1, site.server.getStats().rejected);
+    ::close(extra);
+
+    for (uint32_t waited = 0; waited <= HttpServer::IDLE_TIMEOUT_MS; waited += 10) site.service();
+    TEST_ASSERT_EQUAL(0, site.server.connectionCount());
+    for (size_t i = 0; i < HttpServer::MAX_CONNECTIONS; i++) ::close(fds[i]);
+}
+
+int main(int argc, char** argv) {
+    UNITY_BEGIN();
+    RUN_TEST(test_latest_before_first_sample);
+    RUN_TEST(test_latest_as_json);
+    RUN_TEST(test_history_range_as_csv);
+    RUN_TEST(test_history_defaults_and_bad_queries);
+    RUN_TEST(test_history_one_stream_at_a_time);
+    RUN_TEST(test_metrics_in_text_format);
+    RUN_TEST(test_trace_is_the_ring_dump);
+    RUN_TEST(test_keep_alive_and_errors);
+    RUN_TEST(test_connection_limit_and_idle_timeout);
+    return UNITY_END();
+}
@@ -0,0 +1,151 @@
+// LightPayload: the 20-byte light characteristic value, round trips and bounds.
+
+#include <string.h>
+#include <unity.h>
+#include "../../src/LightPayload.h"
+
+static LightSample makeSample() {
+    LightSample s;
+    s.flags = LightSample::FLAG_SATURATED;
+    s.sequence = 0x12345678;
+    s.timestampMs = 0x0000BA9876543210ULL;   // 48 bits
+    s.centiLux = 0xCAFEF00D;
+    s.fullCount = 0xBEEF;
+    s.irCount = 0x0102;
+    s.control = 0x25;
+    return s;
+}
+
+static void assertSameSample(const LightSample& a, const LightSample& b) {
+    TEST_ASSERT_EQUAL_UINT8(a.flags, b.flags);
+    TEST_ASSERT_EQUAL_UINT32(a.sequence, b.sequence);
+    TEST_ASSERT_EQUAL_UINT64(a.timestampMs, b.timestampMs);
+    TEST_ASSERT_EQUAL_UINT32(a.centiLux, b.centiLux);
+    TEST_ASSERT_EQUAL_UINT16(a.fullCount, b.fullCount);
+    TEST_ASSERT_EQUAL_UINT16(a.irCount, b.irCount);
+    TEST_ASSERT_EQUAL_UINT8(a.control, b.control);
+}
+
+void setUp() {}
+void tearDown() {}
+
+void test_round_trip() {
+    LightSample in = makeSample(), out = {};
+    uint8_t buf[LightPayload::SIZE];
+    TEST_ASSERT_EQUAL(LightPayload::SIZE, LightPayload::encode(in, buf, sizeof(buf)));
+    TEST_ASSERT_TRUE(LightPayload::decode(buf, sizeof(buf), out));
+    assertSameSample(in, out);
+}
+
+// Field offsets and byte order as documented in LightPayload.h.
+void test_layout_is_little_endian() {
+    uint8_t buf[LightPayload::SIZE];
+    LightPayload::encode(makeSample(), buf, sizeof(buf));
+    const uint8_t expected[LightPayload::SIZE] = {
+        0x01,                               // flags
+        0x78, 0x56, 0x34, 0x12,             // sequence
+        0x10, 0x32, 0x54, 0x76, 0x98, 0xBA, // timestamp, 48 bits
+        0x0D, 0xF0, 0xFE, 0xCA,             // centi-lux
+        0xEF, 0xBE,                         // CH0
+        0x02, 0x01,                         // CH1
+        0x25,                               // CONTROL
+    };
+    TEST_ASSERT_EQUAL_HEX8_ARRAY(expected, buf, LightPayload::SIZE);
+}
+
+void test_extremes_round_trip() {
+    LightSample zero = {}, out;
+    uint8_t buf[LightPayload::SIZE];
+    LightPayload::encode(zero, buf, sizeof(buf));
+    TEST_ASSERT_TRUE(LightPayload::decode(buf, sizeof(buf), out));
+    assertSameSample(zero, out);
+
+    LightSample max;
+    max.flags = 0xFF;
+    max.sequence = UINT32_MAX;
+    max.timestampMs = 0xFFFFFFFFFFFFULL;
+    max.centiLux = UINT32_MAX;
+    max.fullCount = UINT16_MAX;
+    max.irCount = UINT16_MAX;
+    max.control = 0xFF;
+    LightPayload::encode(max, buf, sizeof(buf));
+    TEST_ASSERT_TRUE(LightPayload::decode(buf, sizeof(buf), out));
+    assertSameSample(max, out);
+}
+
+// Timestamps are carried in 48 bits; anything above is dropped, not smeared into other fields.
+void test_timestamp_truncated_to_48_bits() {
+    LightSample in = makeSample(), out;
+    in.timestampMs = 0xFFFF000000000001ULL;
+    uint8_t buf[LightPayload::SIZE];
+    LightPayload::encode(in, buf, sizeof(buf));
+    LightPayload::decode(buf, sizeof(buf), out);
+    TEST_ASSERT_EQUAL_UINT64(1, out.timestampMs);
+    TEST_ASSERT_EQUAL_UINT32(in.centiLux, out.centiLux);
+}
+
+void test_encode_rejects_short_buffer() {
+    uint8_t buf[LightPayload::SIZE + 1];
+    memset(buf, 0xAA, sizeof(buf));
+    TEST_ASSERT_EQUAL(0, LightPayload::encode(makeSample(), buf, LightPayload::SIZE - 1));
+    TEST_ASSERT_EQUAL(0, LightPayload::encode(makeSample(), buf, 0));
+    for (size_t i = 0; i < sizeof(buf); i++) TEST_ASSERT_EQUAL_HEX8(0xAA, buf[i]);
+}
+
+// A larger buffer is fine, and nothing past SIZE is touched.
+void test_encode_writes_exactly_size_bytes() {
+    uint8_t buf[LightPayload::SIZE + 4];
+    memset(buf, 0xAA, sizeof(buf));
+    TEST_ASSERT_EQUAL(LightPayload::SIZE, LightPayload::encode(makeSample(), buf, sizeof(buf)));
+    for (size_t i = LightPayload::SIZE; i < sizeof(buf); i++) TEST_ASSERT_EQUAL_HEX8(0xAA, buf[i]);
+}
+
+void test_decode_rejects_short_input() {
+    uint8_t buf[LightPayload::SIZE];
+    LightPayload::encode(makeSample(), buf, sizeof(buf));
+    LightSample out = {};
+    TEST_ASSERT_FALSE(LightPayload::decode(buf, LightPayload::SIZE - 1, out));
+    TEST_ASSERT_FALSE(LightPayload::decode(buf, 0, out));
+    TEST_ASSERT_EQUAL_UINT32(0, out.sequence);
+}
+
+void test_format_text() {
+    LightSample s = makeSample();
+    s.flags = 0;
+    s.centiLux = 12345;
+    char text[32];
+    TEST_ASSERT_EQUAL(10, LightPayload::formatText(s, text, sizeof(text)));
+    TEST_ASSERT_EQUAL_STRING("123.45 lux", text);
+
+    s.centiLux = 7;
+    LightPayload::formatText(s, text, sizeof(text));
+    TEST_ASSERT_EQUAL_STRING("0.07 lux", text);
+
+    s.flags = LightSample::FLAG_NO_SIGNAL;
+    LightPayload::formatText(s, text, sizeof(text));
+    TEST_ASSERT_EQUAL_STRING("-- lux", text);
+}
+
+void test_format_text_truncates() {
+    LightSample s = makeSample();
+    s.flags = 0;
+    s.centiLux = 12345;
+    char text[5];
+    TEST_ASSERT_EQUAL(4, LightPayload::formatText(s, text, sizeof(text)));
+    TEST_ASSERT_EQUAL_STRING("123.", text);
+    TEST_ASSERT_EQUAL(0, LightPayload::formatText(s, text, 0));
+}
+
+int main(int argc, char** argv) {
+    UNITY_BEGIN();
+    RUN_TEST(test_round_trip);
+    RUN_TEST(test_layout_is_little_endian);
+    RUN_TEST(test_extremes_round_trip);
+    RUN_TEST(test_timestamp_truncated_to_48_bits);
+    RUN_TEST(test_encode_rejects_short_buffer);
+    RUN_TEST(test_encode_writes_exactly_size_bytes);
+    RUN_TEST(test_decode_rejects_short_input);
+    RUN_TEST(test_format_text);
+    RUN_TEST(test_format_text_truncates);
+    return UNITY_END();
+}
@@ -0,0 +1,123 @@
+// LuxEngine's fixed-point lux against the float formula it replaces, swept over every gain and
+// integration time and over the channel counts each can report.
+
+#include <unity.h>
+#include <math.h>
+#include <random>
+#include "../../src/LuxEngine.h"
+
+// The model in double precision: the reference both paths are measured against.
+static double exactCentiLux(uint16_t full, uint16_t ir, uint8_t gain, uint8_t time) {
+    double cpl = (double)AutoRange::TIMES[time] * AutoRange::GAINS[gain] / LuxEngine::LUX_DF;
+    return 100.0 * (full - ir) * (1.0 - (double)ir / full) / cpl;
+}
+
+// Adafruit_TSL2591::calculateLux() as the firmware used to call it, in single precision.
+static double floatCentiLux(uint16_t full, uint16_t ir, uint8_t gain, uint8_t time) {
+    float cpl = ((float)AutoRange::TIMES[time] * (float)AutoRange::GAINS[gain]) / (float)LuxEngine::LUX_DF;
+    float lux = (((float)full - (float)ir)) * (1.0F - ((float)ir / (float)full)) / cpl;
+    return (double)lux * 100.0;
+}
+
+struct Errors {
+    double fixedMax, floatMax;
+    uint32_t points;
+};
+
+static void check(uint16_t full, uint16_t ir, uint8_t gain, uint8_t time, Errors& e) {
+    double exact = exactCentiLux(full, ir, gain, time);
+    uint32_t fixed = LuxEngine::centiLux(full, ir, gain, time);
+    double fixedError = fabs((double)fixed - exact);
+    double floatError = fabs(floor(floatCentiLux(full, ir, gain, time) + 0.5) - exact);
+    if (fixedError > e.fixedMax) e.fixedMax = fixedError;
+    if (floatError > e.floatMax) e.floatMax = floatError;
+    e.points++;
+    // The documented bound: 1 hundredth of a lux.
+    if (fixedError > 1.0) {
+        char message[96];
+        snprintf(message, sizeof(message), "full %u ir %u gain %u time %u: %u vs %.3f", full, ir, gain, time, fixed, exact);
+        TEST_FAIL_MESSAGE(message);
+    }
+}
+
+void setUp() {}
+void tearDown() {}
+
+void test_coefficients_match_formula() {
+    for (uint8_t g = 0; g < AutoRange::GAIN_COUNT; g++) {
+        for (uint8_t t = 0; t < AutoRange::TIME_COUNT; t++) {
+            double expected = 100.0 * LuxEngine::LUX_DF * 16777216.0 / ((double)AutoRange::GAINS[g] * AutoRange::TIMES[t]);
+            TEST_ASSERT_TRUE(fabs((double)LuxEngine::coefficient(g, t) - expected) <= 0.5);
+        }
+    }
+}
+
+// Every gain and time over a grid of counts up to that time's full scale, denser at the low end
+// where a count matters most.
+void test_grid_sweep() {
+    for (uint8_t g = 0; g < AutoRange::GAIN_COUNT; g++) {
+        for (uint8_t t = 0; t < AutoRange::TIME_COUNT; t++) {
+            Errors e = {};
+            uint16_t ceiling = AutoRange::maxCount(t);
+            for (uint32_t full = 1; full < ceiling; full += full < 256 ? 1 : full / 64) {
+                for (uint32_t ir = 0; ir < full; ir += ir < 64 ? 1 : (full - ir) / 8 + 1) {
+                    check((uint16_t)full, (uint16_t)ir, g, t, e);
+                }
+            }
+            TEST_ASSERT_GREATER_THAN(10000, e.points);
+        }
+    }
+}
+
+// Random counts, including the top of each range where the float path loses digits.
+void test_random_sweep_against_float() {
+    std::mt19937 rng(2591);
+    for (uint8_t g = 0; g < AutoRange::GAIN_COUNT; g++) {
+        for (uint8_t t = 0; t < AutoRange::TIME_COUNT; t++) {
+            Errors e = {};
+            uint16_t ceiling = AutoRange::maxCount(t);
+            for (int i = 0; i < 20000; i++) {
+                uint16_t full = (uint16_t)std::uniform_int_distribution<uint32_t>(1, ceiling - 1)(rng);
+                uint16_t ir = (uint16_t)std::uniform_int_distribution<uint32_t>(0, full - 1)(rng);
+                check(full, ir, g, t, e);
+            }
+            // Single precision is never closer, and at LOW gain (bright scenes) it is worse.
+            TEST_ASSERT_TRUE(e.fixedMax <= e.floatMax + 0.01);
+            if (g == 0) TEST_ASSERT_TRUE(e.fixedMax < e.floatMax);
+        }
+    }
+}
+
+void test_edges() {
+    for (uint8_t t = 0; t < AutoRange::TIME_COUNT; t++) {
+        uint16_t ceiling = AutoRange::maxCount(t);
+        TEST_ASSERT_EQUAL_UINT32(LuxEngine::OVERFLOW, LuxEngine::centiLux(ceiling, 0, 0, t));
+        TEST_ASSERT_EQUAL_UINT32(LuxEngine::OVERFLOW, LuxEngine::centiLux(100, ceiling, 0, t));
+        TEST_ASSERT_NOT_EQUAL(LuxEngine::OVERFLOW, LuxEngine::centiLux(ceiling - 1, 0, 0, t));
+    }
+    TEST_ASSERT_EQUAL_UINT32(0, LuxEngine::centiLux(0, 0, 1, 1));
+    TEST_ASSERT_EQUAL_UINT32(0, LuxEngine::centiLux(500, 500, 1, 1));  // IR at full spectrum
+    TEST_ASSERT_EQUAL_UINT32(0, LuxEngine::centiLux(500, 900, 1, 1));
+    TEST_ASSERT_EQUAL_UINT32(0, LuxEngine::centiLux(500, 10, AutoRange::GAIN_COUNT, 0));
+    TEST_ASSERT_EQUAL_UINT32(0, LuxEngine::centiLux(500, 10, 0, AutoRange::TIME_COUNT));
+}
+
+// The CONTROL register keeps gain in bits 5:4 and integration time in bits 2:0.
+void test_control_register_decoding() {
+    for (uint8_t g = 0; g < AutoRange::GAIN_COUNT; g++) {
+        for (uint8_t t = 0; t < AutoRange::TIME_COUNT; t++) {
+            uint8_t control = (uint8_t)(g << 4 | t);
+            TEST_ASSERT_EQUAL_UINT32(LuxEngine::centiLux(20000, 3000, g, t), LuxEngine::centiLuxFromControl(20000, 3000, control));
+        }
+    }
+}
+
+int main(int argc, char** argv) {
+    UNITY_BEGIN();
+    RUN_TEST(test_coefficients_match_formula);
+    RUN_TEST(test_grid_sweep);
+    RUN_TEST(test_random_sweep_against_float);
+    RUN_TEST(test_edges);
+    RUN_TEST(test_control_register_decoding);
+    return UNITY_END();
+}
@@ -0,0 +1,118 @@
+// The whole firmware on the simulated board (hal/native) for 20 simulated minutes, flat out:
+// setup(), then loop() until the kernel's deadline, where the checks below run with every task
+// parked. From the first re-anchor (ten minutes in) the timebase reads the RTC in a short window
+// around a predicted second boundary, and its waits drop under a millisecond; a loop() that stops
+// yielding then freezes simulated time short of the deadline, and the host-time alarm fails the run.
+// Sampling is set to once a second so the uplink seals a batch a minute; with nothing listening at
+// the collector address each of its attempts is refused.
+
+#include <unity.h>
+#include <signal.h>
+#include <unistd.h>
+#include <chrono>
+#include "../../hal/native/NativeBoard.h"
+#include "../../hal/native/TempDir.h"
+#include "../../src/main.cpp"
+
+static const double RUN_S = 1200;
+static const unsigned HOST_LIMIT_S = 60;
+
+static TempDir* dataDir;
+static std::chrono::steady_clock::time_point hostStart;
+
+static void onHostTimeout(int) {
+    static const char message[] = "test_native_run: simulated time stopped short of the deadline; is loop() yielding?\n";
+    if (write(2, message, sizeof(message) - 1) < 0) {}
+    _exit(1);
+}
+
+void setUp() {}
+void tearDown() {}
+
+void test_run_reaches_deadline() {
+    TEST_ASSERT_GREATER_OR_EQUAL_UINT32((uint32_t)RUN_S, (uint32_t)(NativeBoard::instance().getKernel().now() / 1000000));
+    double hostS = std::chrono::duration<double>(std::chrono::steady_clock::now() - hostStart).count();
+    TEST_ASSERT_TRUE(hostS < HOST_LIMIT_S);
+}
+
+// Every periodic loop() task ran once per period for the whole run, none skipped.
+void test_periodic_tasks_kept_time() {
+    for (size_t i = 0; i < scheduler.count(); i++) {
+        uint64_t period = scheduler.period((int)i);
+        if (period == 0) continue;
+        const TaskStats& stats = scheduler.stats((int)i);
+        uint32_t expected = (uint32_t)(RUN_S * 1e6 / (double)period);
+        TEST_ASSERT_UINT32_WITHIN_MESSAGE(expected / 100 + 1, expected, stats.runs, scheduler.name((int)i));
+        TEST_ASSERT_EQUAL_UINT32_MESSAGE(0, stats.missedDeadlines, scheduler.name((int)i));
+    }
+}
+
+// One sample per interval from the first (which came at the end of the boot-time interval).
+void test_samples_kept_coming() {
+    TEST_ASSERT_TRUE(haveLatestSample);
+    uint32_t expected = 1 + (uint32_t)((RUN_S * 1e6 - sensorTask.firstSampleUs()) / 1000 / sensorTask.interval());
+    TEST_ASSERT_UINT32_WITHIN(2, expected, latestSample.sequence + 1);
+}
+
+void test_clock_and_network_settled() {
+    TEST_ASSERT_TRUE(wifiConnection.connected());
+    TEST_ASSERT_TRUE(ntpSync.synced());
+    TEST_ASSERT_TRUE(timebase.valid());
+    TEST_ASSERT_TRUE(timebase.precise());
+}
+
+// Nothing listens at the collector address, so every upload attempt is refused. Each failed
+// attempt waits out the uplink's backoff, and the address is kept across them rather than
+// looked up again on every poll.
+void test_refused_uplink_backs_off() {
+    const Uplink::Stats& stats = uplink.getStats();
+    TEST_ASSERT_EQUAL_UINT32(0, stats.connects);
+    TEST_ASSERT_GREATER_OR_EQUAL_UINT32(5, stats.retries);
+    TEST_ASSERT_LESS_OR_EQUAL_UINT32(15, stats.retries);
+    TEST_ASSERT_LESS_OR_EQUAL_UINT32(stats.retries, NativeBoard::instance().getStats().lookups);
+}
+
+// Runs the checks at the deadline, on whichever task's thread reached it, and ends the process.
+static void onDeadline(void*) {
+    UNITY_BEGIN();
+    RUN_TEST(test_run_reaches_deadline);
+    RUN_TEST(test_periodic_tasks_kept_time);
+    RUN_TEST(test_samples_kept_coming);
+    RUN_TEST(test_clock_and_network_settled);
+    RUN_TEST(test_refused_uplink_backs_off);
+    int failures = UNITY_END();
+    delete dataDir;
+    fflush(stdout);
+    _exit(failures);
+}
+
+int main(int argc, char** argv) {
+    dataDir = new TempDir();
+    NativeBoardOptions options = {};
+    options.speed = 0;
+    options.durationS = RUN_S;
+    options.dataDir = dataDir->path();
+    options.sdCard = true;
+    options.lux = 250;
+    options.noisePercent = 2;
+    options.centralAtS = 2;
+    options.provision = "PhotonIQ-Lab,photoniq";
+    options.apSsid = "PhotonIQ-Lab";
+    options.apPassword = "photoniq";
+    options.collector = "127.0.0.1";
+    options.rtcDriftPpm = 15;
+    options.rtcOffsetS = -3;
+    options.quiet = true;
+    options.seed = 1;
+
+    signal(SIGALRM, onHostTimeout);
+    alarm(HOST_LIMIT_S);
+    hostStart = std::chrono::steady_clock::now();
+
+    NativeBoard& board = NativeBoard::instance();
+    board.begin(options);
+    board.stopAfter((uint64_t)(RUN_S * 1e6), onDeadline, nullptr);
+    setup();
+    settingsManager.setScanInterval(1); // a sample a second: an uplink batch a minute
+    for (;;) loop();
+}
@@ -0,0 +1,265 @@
+// NtpSync disciplining a SimulatedDs3231 from a LocalNtpServer in simulated time: a lost or far-off
+// RTC is stepped onto the server's second, a small offset is slewed out through the aging register,
+// a drifting oscillator is measured and cancelled, and lost replies, kiss-o'-death replies and an
+// unreachable server end a sync cleanly and back off.
+
+#include <unity.h>
+#include <math.h>
+#include "../../hal/native/LocalNtpServer.h"
+#include "../../hal/native/SimulatedDs3231.h"
+#include "../../src/NtpSync.h"
+
+static const int64_t TRUE_START_US = 1760000000LL * 1000000 + 300000; // 2025-10-09, 0.3 s into a second
+static const uint64_t HOUR_US = 3600ULL * 1000000;
+
+// A server, an RTC and the sync on one simulated clock. run() calls service() when it asks to be
+// called and advances everything in between, the way the scheduler task drives it on the device.
+struct Lab {
+    LocalNtpServer server;
+    SimulatedDs3231 rtc;
+    NtpSync sync;
+    uint64_t monoUs;
+    uint64_t dueUs;
+    bool networkUp;
+    uint32_t synced;
+    uint32_t stepped;
+    int64_t lastOffsetUs;
+
+    explicit Lab(int64_t rtcMinusTrueS = 0, float driftPpm = 0)
+        : server(TRUE_START_US), rtc((uint32_t)(TRUE_START_US / 1000000 + rtcMinusTrueS), driftPpm), sync(server, rtc),
+          monoUs(1000000), dueUs(0), networkUp(true), synced(0), stepped(0), lastOffsetUs(0) {
+        rtc.advance(TRUE_START_US % 1000000);                              // in phase with true time
+        sync.addListener(onSync, this);
+    }
+
+    static void onSync(void* context, int64_t offsetUs, bool step) {
+        Lab* lab = (Lab*)context;
+        lab->synced++;
+        if (step) lab->stepped++;
+        lab->lastOffsetUs = offsetUs;
+    }
+
+    void run(uint64_t durationUs) {
+        uint64_t endUs = monoUs + durationUs;
+        while (monoUs < endUs) {
+            if (monoUs >= dueUs) dueUs = monoUs + (uint64_t)sync.service(monoUs, networkUp) * 1000;
+            uint64_t stepUs = (dueUs < endUs ? dueUs : endUs) - monoUs;
+            server.advance(stepUs);
+            rtc.advance(stepUs);
+            monoUs += stepUs;
+        }
+    }
+
+    // RTC minus true time.
+    double rtcErrorUs() const { return rtc.timeSeconds() * 1e6 - (double)server.now(); }
+};
+
+void setUp() {}
+void tearDown() {}
+
+void test_timestamps_round_trip() {
+    uint8_t packet[NtpSync::PACKET_SIZE];
+    const int64_t times[] = { TRUE_START_US, 1000000, 2085978495999999LL, 2085978496000001LL, 4000000000LL * 1000000 + 5 };
+    for (int64_t us : times) {
+        NtpSync::putTimestamp(packet, us);
+        TEST_ASSERT_INT64_WITHIN(1, us, NtpSync::getTimestamp(packet));   // 2^-32 s fractions
+    }
+    // 2036-02-07 is NTP era 1: the seconds field wraps and still decodes forward.
+    NtpSync::putTimestamp(packet, 2085978496LL * 1000000 + 500000);
+    TEST_ASSERT_EQUAL_HEX32(0, getBe32(packet));
+}
+
+void test_decode_rejects_unusable_replies() {
+    uint8_t request[NtpSync::PACKET_SIZE], reply[NtpSync::PACKET_SIZE];
+    NtpSync::encodeRequest(TRUE_START_US, request);
+    TEST_ASSERT_EQUAL_HEX8(0x23, request[0]);                               // v4, client
+
+    memset(reply, 0, sizeof(reply));
+    reply[0] = 0x24;
+    reply[1] = 2;
+    memcpy(reply + 24, request + 40, 8);
+    NtpSync::putTimestamp(reply + 32, TRUE_START_US + 1000);
+    NtpSync::putTimestamp(reply + 40, TRUE_START_US + 1100);
+    NtpSync::Reply r;
+    TEST_ASSERT_TRUE(NtpSync::decodeReply(reply, sizeof(reply), r));
+    TEST_ASSERT_INT64_WITHIN(1, TRUE_START_US, r.originUs);
+    TEST_ASSERT_EQUAL_UINT8(2, r.stratum);
+    TEST_ASSERT_FALSE(NtpSync::decodeReply(reply, sizeof(reply) - 1, r));
+
+    reply[1] = 0;                                                           // kiss-o'-death
+    TEST_ASSERT_FALSE(NtpSync::decodeReply(reply, sizeof(reply), r));
+    reply[1] = 16;                                                          // unsynchronized stratum
+    TEST_ASSERT_FALSE(NtpSync::decodeReply(reply, sizeof(reply), r));
+    reply[1] = 2;
+    reply[0] = 0xE4;                                                        // leap indicator 3
+    TEST_ASSERT_FALSE(NtpSync::decodeReply(reply, sizeof(reply), r));
+    reply[0] = 0x23;                                                        // a client packet
+    TEST_ASSERT_FALSE(NtpSync::decodeReply(reply, sizeof(reply), r));
+}
+
+void test_lost_power_steps_onto_the_second() {
+    Lab lab(-86400);
+    lab.rtc.setLostPower(true);
+    lab.run(5000000);
+    TEST_ASSERT_EQUAL_UINT32(1, lab.stepped);
+    TEST_ASSERT_EQUAL_UINT32(1, lab.rtc.writeCount());
+    TEST_ASSERT_FALSE(lab.rtc.lostPower());
+    TEST_ASSERT_TRUE(fabs(lab.rtcErrorUs()) < 10000);
+    TEST_ASSERT_INT64_WITHIN(15000, 86400LL * 1000000, lab.lastOffsetUs);
+
+    // The verification sync a minute later finds only the residual and slews it.
+    lab.run(65000000);
+    TEST_ASSERT_EQUAL_UINT32(2, lab.synced);
+    TEST_ASSERT_EQUAL_UINT32(1, lab.stepped);
+    TEST_ASSERT_INT64_WITHIN(15000, 0, lab.lastOffsetUs);
+    TEST_ASSERT_EQUAL_UINT32(1, lab.rtc.writeCount());
+}
+
+void test_offset_over_threshold_steps() {
+    Lab lab(-1);                                                            // one second slow
+    lab.run(5000000);
+    TEST_ASSERT_EQUAL_UINT32(1, lab.sync.getStats().steps);
+    TEST_ASSERT_TRUE(fabs(lab.rtcErrorUs()) < 10000);
+}
+
+void test_small_offset_is_slewed() {
+    // A 200 ms slow RTC (under the 250 ms step threshold) is brought in by running it fast.
+    Lab lab(0);
+    lab.server.setSkewUs(200000);
+    lab.run(5000000);
+    TEST_ASSERT_EQUAL_UINT32(0, lab.stepped);
+    TEST_ASSERT_EQUAL_UINT32(1, lab.synced);
+    TEST_ASSERT_INT64_WITHIN(15000, 200000, lab.lastOffsetUs);
+    // 200 ms over the 6 h horizon would be 9 ppm; the slew is clamped to 5 ppm, 50 aging steps.
+    TEST_ASSERT_EQUAL_INT8(-50, lab.rtc.agingOffset());
+
+    double before = lab.rtcErrorUs();
+    lab.run(6 * HOUR_US);
+    TEST_ASSERT_EQUAL_UINT32(0, lab.stepped);
+    TEST_ASSERT_TRUE(lab.rtcErrorUs() - before > 90000);                   // gaining on the server
+    TEST_ASSERT_TRUE(lab.lastOffsetUs < 120000);
+}
+
+void test_drift_is_measured_and_cancelled() {
+    // A DS3231 running 6 ppm fast: half a second a day left alone.
+    Lab lab(0, 6.0f);
+    lab.run(4 * 24 * HOUR_US);
+    const NtpSync::Stats& st = lab.sync.getStats();
+    TEST_ASSERT_EQUAL_UINT32(0, st.steps);
+    TEST_ASSERT_EQUAL_UINT32(0, st.failures);
+    TEST_ASSERT_TRUE(fabsf(st.driftPpm - 6.0f) < 0.3f);
+    TEST_ASSERT_INT_WITHIN(6, 60, lab.rtc.agingOffset());
+    TEST_ASSERT_TRUE(fabs(lab.rtcErrorUs()) < 15000);
+
+    // With the network gone for a day the cancelled oscillator keeps the RTC close.
+    lab.networkUp = false;
+    lab.run(24 * HOUR_US);
+    TEST_ASSERT_TRUE(fabs(lab.rtcErrorUs()) < 60000);
+}
+
+void test_server_skew_is_followed() {
+    // The RTC follows the server's clock, not the host's: a server 3 s ahead is stepped to.
+    Lab lab(0);
+    lab.server.setSkewUs(3000000);
+    lab.run(5000000);
+    TEST_ASSERT_EQUAL_UINT32(1, lab.stepped);
+    TEST_ASSERT_TRUE(fabs(lab.rtcErrorUs() - 3000000) < 10000);
+}
+
+void test_lowest_delay_sample_wins() {
+    // Asymmetric jittery paths: best-of-four keeps the error near the one-way asymmetry floor.
+    Lab lab(0);
+    lab.server.setDelays(4000, 4000, 60000);
+    lab.run(5000000);
+    TEST_ASSERT_EQUAL_UINT32(1, lab.synced);
+    TEST_ASSERT_EQUAL_UINT32(4, lab.server.requestCount());
+    TEST_ASSERT_TRUE(lab.sync.getStats().lastDelayUs < 60000);
+    TEST_ASSERT_INT64_WITHIN(40000, 0, lab.lastOffsetUs);
+}
+
+void test_lost_replies_are_skipped() {
+    Lab lab(0);
+    lab.server.setDropEvery(2);
+    lab.run(10000000);
+    TEST_ASSERT_EQUAL_UINT32(1, lab.synced);
+    TEST_ASSERT_EQUAL_UINT32(4, lab.sync.getStats().requests);
+    TEST_ASSERT_EQUAL_UINT32(0, lab.sync.getStats().failures);
+    TEST_ASSERT_INT64_WITHIN(15000, 0, lab.lastOffsetUs);
+}
+
+void test_all_lost_backs_off() {
+    Lab lab(0);
+    lab.server.setDropEvery(1);
+    lab.run(10 * 60 * 1000000ULL);
+    // Retries at 30 s, then 60, 120, 240 s after each failed sync of four 1.5 s timeouts.
+    const NtpSync::Stats& st = lab.sync.getStats();
+    TEST_ASSERT_EQUAL_UINT32(0, lab.synced);
+    TEST_ASSERT_EQUAL_UINT32(5, st.failures);
+    TEST_ASSERT_EQUAL_UINT32(5 * 4, lab.server.requestCount());
+    TEST_ASSERT_EQUAL_UINT32(0, lab.rtc.writeCount());
+
+    // Recovery: the next retry succeeds and the backoff starts over.
+    lab.server.setDropEvery(0);
+    lab.run(10 * 60 * 1000000ULL);
+    TEST_ASSERT_EQUAL_UINT32(1, lab.synced);
+}
+
+void test_kiss_of_death_is_not_used() {
+    Lab lab(-5);
+    lab.server.setKissOfDeath(true);
+    lab.run(10000000);                                                      // four 1.5 s reply timeouts
+    const NtpSync::Stats& st = lab.sync.getStats();
+    TEST_ASSERT_EQUAL_UINT32(0, lab.synced);
+    TEST_ASSERT_EQUAL_UINT32(1, st.failures);
+    TEST_ASSERT_EQUAL_UINT32(4, st.badReplies);
+    TEST_ASSERT_EQUAL_UINT32(0, lab.rtc.writeCount());
+    TEST_ASSERT_EQUAL_INT8(0, lab.rtc.agingOffset());
+
+    // No faster than the backoff: the next try comes 30 s after the failure.
+    uint32_t requests = lab.server.requestCount();
+    lab.run(25000000);
+    TEST_ASSERT_EQUAL_UINT32(requests, lab.server.requestCount());
+    lab.server.setKissOfDeath(false);
+    lab.run(30000000);
+    TEST_ASSERT_EQUAL_UINT32(1, lab.stepped);
+}
+
+void test_unreachable_server_and_network_loss() {
+    Lab lab(0);
+    lab.server.setReachable(false);
+    lab.run(15000000);
+    TEST_ASSERT_EQUAL_UINT32(1, lab.sync.getStats().failures);             // after the 10 s open timeout
+    TEST_ASSERT_EQUAL_UINT32(0, lab.server.requestCount());
+
+    // Wi-Fi down: nothing is attempted, and a link lost mid-sync ends that sync.
+    Lab quiet(0);
+    quiet.networkUp = false;
+    quiet.run(HOUR_US);
+    TEST_ASSERT_EQUAL_UINT32(0, quiet.server.requestCount());
+    TEST_ASSERT_EQUAL(NtpSync::STATE_IDLE, quiet.sync.state());
+    quiet.networkUp = true;
+    quiet.server.setDelays(400000, 400000);
+    quiet.run(1500000);
+    TEST_ASSERT_EQUAL(NtpSync::STATE_EXCHANGING, quiet.sync.state());
+    quiet.networkUp = false;
+    quiet.run(1000);
+    TEST_ASSERT_EQUAL(NtpSync::STATE_IDLE, quiet.sync.state());
+    TEST_ASSERT_EQUAL_UINT32(1, quiet.sync.getStats().failures);
+}
+
+int main(int argc, char** argv) {
+    UNITY_BEGIN();
+    RUN_TEST(test_timestamps_round_trip);
+    RUN_TEST(test_decode_rejects_unusable_replies);
+    RUN_TEST(test_lost_power_steps_onto_the_second);
+    RUN_TEST(test_offset_over_threshold_steps);
+    RUN_TEST(test_small_offset_is_slewed);
+    RUN_TEST(test_drift_is_measured_and_cancelled);
+    RUN_TEST(test_server_skew_is_followed);
+    RUN_TEST(test_lowest_delay_sample_wins);
+    RUN_TEST(test_lost_replies_are_skipped);
+    RUN_TEST(test_all_lost_backs_off);
+    RUN_TEST(test_kiss_of_death_is_not_used);
+    RUN_TEST(test_unreachable_server_and_network_loss);
+    return UNITY_END();
+}
@@ -0,0 +1,193 @@
+// SampleLogReader and SampleIndex range lookups at the edges: before the first sample, after the
+// last, across a gap that spans blocks, across midnight and a missing day file.
+
+#include <unity.h>
+#include "../../hal/native/FileBlockFile.h"
+#include "../../hal/native/LogCard.h"
+
+static const uint64_t DAY_MS = SampleLog::MS_PER_DAY;
+static const uint32_t DAY = 20370;                           // 2025-10-09
+static const uint64_t DAY_START = (uint64_t)DAY * DAY_MS;
+static const uint64_t T0 = DAY_START + 8 * 3600000ULL;       // first sample, 08:00
+
+// The shared scratch card, plus a range query that checks what it reads.
+struct Card : LogCard {
+    // Reads [fromMs, toMs]; returns the count and checks order and content on the way.
+    uint32_t query(uint64_t fromMs, uint64_t toMs, uint64_t* firstMs = nullptr, uint64_t* lastMs = nullptr) {
+        uint32_t n = 0;
+        LightSample s;
+        uint64_t previous = 0;
+        reader.seek(fromMs, toMs);
+        while (reader.next(s)) {
+            TEST_ASSERT_TRUE(s.timestampMs >= fromMs && s.timestampMs <= toMs);
+            TEST_ASSERT_TRUE(n == 0 || s.timestampMs > previous);
+            TEST_ASSERT_EQUAL_UINT32(luxAt(s.timestampMs), s.centiLux);
+            if (n == 0 && firstMs) *firstMs = s.timestampMs;
+            previous = s.timestampMs;
+            n++;
+        }
+        if (lastMs) *lastMs = previous;
+        return n;
+    }
+};
+
+void setUp() {}
+void tearDown() {}
+
+void test_range_inside_log() {
+    Card card;
+    TEST_ASSERT_TRUE(card.write(T0, 2000));
+    uint64_t first = 0, last = 0;
+    TEST_ASSERT_EQUAL_UINT32(101, card.query(T0 + 500000, T0 + 600000, &first, &last));
+    TEST_ASSERT_EQUAL_UINT64(T0 + 500000, first);
+    TEST_ASSERT_EQUAL_UINT64(T0 + 600000, last);
+    TEST_ASSERT_LESS_OR_EQUAL(8, card.reader.blocksRead());
+}
+
+void test_range_starting_before_first_sample() {
+    Card card;
+    TEST_ASSERT_TRUE(card.write(T0, 300));
+    uint64_t first = 0;
+    TEST_ASSERT_EQUAL_UINT32(11, card.query(DAY_START, T0 + 10000, &first));
+    TEST_ASSERT_EQUAL_UINT64(T0, first);
+    // From the previous day, which has no file at all.
+    TEST_ASSERT_EQUAL_UINT32(11, card.query(DAY_START - DAY_MS, T0 + 10000, &first));
+    TEST_ASSERT_EQUAL_UINT64(T0, first);
+}
+
+void test_range_entirely_before_first_sample() {
+    Card card;
+    TEST_ASSERT_TRUE(card.write(T0, 300));
+    TEST_ASSERT_EQUAL_UINT32(0, card.query(DAY_START, T0 - 1));
+    TEST_ASSERT_EQUAL_UINT32(0, card.query(DAY_START - DAY_MS, DAY_START - 1));
+}
+
+void test_range_after_last_sample() {
+    Card card;
+    TEST_ASSERT_TRUE(card.write(T0, 300));
+    uint64_t lastSample = T0 + 299000;
+    uint64_t last = 0;
+    TEST_ASSERT_EQUAL_UINT32(1, card.query(lastSample, lastSample + 3600000, nullptr, &last));
+    TEST_ASSERT_EQUAL_UINT64(lastSample, last);
+    TEST_ASSERT_EQUAL_UINT32(0, card.query(lastSample + 1, lastSample + 3600000));
+    TEST_ASSERT_EQUAL_UINT32(0, card.query(DAY_START + DAY_MS, DAY_START + 3 * DAY_MS));
+}
+
+void test_range_bounds_are_inclusive() {
+    Card card;
+    TEST_ASSERT_TRUE(card.write(T0, 300));
+    uint64_t first = 0, last = 0;
+    TEST_ASSERT_EQUAL_UINT32(1, card.query(T0 + 42000, T0 + 42000, &first, &last));
+    TEST_ASSERT_EQUAL_UINT64(T0 + 42000, first);
+    TEST_ASSERT_EQUAL_UINT32(0, card.query(T0 + 42001, T0 + 42999));
+}
+
+void test_reversed_range_is_empty() {
+    Card card;
+    TEST_ASSERT_TRUE(card.write(T0, 300));
+    TEST_ASSERT_FALSE(card.reader.seek(T0 + 1000, T0));
+    TEST_ASSERT_EQUAL_UINT32(0, card.query(T0 + 1000, T0));
+}
+
+// Logging stops for two hours (power off, say) after several full blocks, then resumes.
+void test_gap_spanning_blocks() {
+    Card card;
+    const uint64_t resume = T0 + 3 * 3600000ULL;
+    TEST_ASSERT_TRUE(card.write(T0, 1000));
+    uint32_t blocksBefore = card.log.getStats().blocksWritten;
+    TEST_ASSERT_TRUE(card.write(resume, 1000));
+    TEST_ASSERT_GREATER_THAN(2, blocksBefore);
+    TEST_ASSERT_GREATER_THAN(blocksBefore, card.log.getStats().blocksWritten);
+
+    uint64_t first = 0, last = 0;
+    TEST_ASSERT_EQUAL_UINT32(0, card.query(T0 + 1000000, resume - 1));                // inside the gap
+    TEST_ASSERT_EQUAL_UINT32(5, card.query(T0 + 1000000, resume + 4000, &first));     // starts in the gap
+    TEST_ASSERT_EQUAL_UINT64(resume, first);
+    TEST_ASSERT_EQUAL_UINT32(10, card.query(T0 + 995000, resume + 4000, &first, &last)); // spans it
+    TEST_ASSERT_EQUAL_UINT64(T0 + 995000, first);
+    TEST_ASSERT_EQUAL_UINT64(resume + 4000, last);
+}
+
+void test_range_across_midnight_and_missing_day() {
+    Card card;
+    TEST_ASSERT_TRUE(card.write(DAY_START + DAY_MS - 5000, 10));  // 23:59:55 .. 00:00:04
+    TEST_ASSERT_TRUE(card.write(DAY_START + 3 * DAY_MS, 5));       // two days later; the day between has no file
+    uint64_t first = 0, last = 0;
+    TEST_ASSERT_EQUAL_UINT32(15, card.query(DAY_START, DAY_START + 4 * DAY_MS, &first, &last));
+    TEST_ASSERT_EQUAL_UINT64(DAY_START + DAY_MS - 5000, first);
+    TEST_ASSERT_EQUAL_UINT64(DAY_START + 3 * DAY_MS + 4000, last);
+    TEST_ASSERT_EQUAL_UINT32(5, card.query(DAY_START + DAY_MS, DAY_START + DAY_MS + 3600000ULL));
+    TEST_ASSERT_EQUAL_UINT32(0, card.query(DAY_START + 2 * DAY_MS, DAY_START + 3 * DAY_MS - 1));
+}
+
+// The index alone: the block to start at for instants before, on and after block boundaries.
+void test_index_find_block_boundaries() {
+    Card card;
+    TEST_ASSERT_TRUE(card.write(T0, 2000));
+    FileBlockFile idx(card.dir.path());
+    char name[SampleLog::FILE_NAME_LEN];
+    SampleLog::formatFileName(DAY, name, sizeof(name), "idx");
+    TEST_ASSERT_TRUE(idx.open(name, false));
+
+    // The first timestamp of every data block, straight from the data file.
+    FileBlockFile data(card.dir.path());
+    SampleLog::formatFileName(DAY, name, sizeof(name));
+    TEST_ASSERT_TRUE(data.open(name, false));
+    uint8_t block[SampleLog::BLOCK_SIZE], scratch[SampleIndex::BLOCK_SIZE];
+    uint64_t firsts[64];
+    uint32_t blocks = 0;
+    SampleLog::BlockHeader h;
+    while (blocks < 64 && data.readBlock(blocks, block) && SampleLog::parseBlock(block, h, DAY)) firsts[blocks++] = h.firstTimestampMs;
+    TEST_ASSERT_GREATER_THAN(3, blocks);
+
+    uint32_t found = 99;
+    TEST_ASSERT_TRUE(SampleIndex::findBlock(idx, DAY, DAY_START, found, scratch));
+    TEST_ASSERT_EQUAL_UINT32(0, found);
+    TEST_ASSERT_TRUE(SampleIndex::findBlock(idx, DAY, T0 - 1, found, scratch));
+    TEST_ASSERT_EQUAL_UINT32(0, found);
+    for (uint32_t b = 1; b < blocks; b++) {
+        TEST_ASSERT_TRUE(SampleIndex::findBlock(idx, DAY, firsts[b], found, scratch));
+        TEST_ASSERT_EQUAL_UINT32(b, found);
+        TEST_ASSERT_TRUE(SampleIndex::findBlock(idx, DAY, firsts[b] - 1, found, scratch));
+        TEST_ASSERT_EQUAL_UINT32(b - 1, found);
+    }
+    TEST_ASSERT_TRUE(SampleIndex::findBlock(idx, DAY, DAY_START + DAY_MS - 1, found, scratch));
+    TEST_ASSERT_EQUAL_UINT32(blocks - 1, found);
+}
+
+// Sequence ranges (what resumable transfers use), at both ends of the log.
+void test_sequence_range_boundaries() {
+    Card card;
+    TEST_ASSERT_TRUE(card.write(T0, 500));
+    LightSample s;
+    TEST_ASSERT_TRUE(card.reader.seekSequence(0, 2, DAY));
+    for (uint32_t i = 0; i <= 2; i++) {
+        TEST_ASSERT_TRUE(card.reader.next(s));
+        TEST_ASSERT_EQUAL_UINT32(i, s.sequence);
+    }
+    TEST_ASSERT_FALSE(card.reader.next(s));
+
+    TEST_ASSERT_TRUE(card.reader.seekSequence(499, 10000, DAY));
+    TEST_ASSERT_TRUE(card.reader.next(s));
+    TEST_ASSERT_EQUAL_UINT32(499, s.sequence);
+    TEST_ASSERT_EQUAL_UINT64(T0 + 499000, s.timestampMs);
+    TEST_ASSERT_FALSE(card.reader.next(s));
+
+    card.reader.seekSequence(500, 10000, DAY);
+    TEST_ASSERT_FALSE(card.reader.next(s));
+}
+
+int main(int argc, char** argv) {
+    UNITY_BEGIN();
+    RUN_TEST(test_range_inside_log);
+    RUN_TEST(test_range_starting_before_first_sample);
+    RUN_TEST(test_range_entirely_before_first_sample);
+    RUN_TEST(test_range_after_last_sample);
+    RUN_TEST(test_range_bounds_are_inclusive);
+    RUN_TEST(test_reversed_range_is_empty);
+    RUN_TEST(test_gap_spanning_blocks);
+    RUN_TEST(test_range_across_midnight_and_missing_day);
+    RUN_TEST(test_index_find_block_boundaries);
+    RUN_TEST(test_sequence_range_boundaries);
+    return UNITY_END();
+}
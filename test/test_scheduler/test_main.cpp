@@ -0,0 +1,235 @@
+// Scheduler on a fake clock that only moves when a test (or a task, to model its run time)
+// moves it: absolute deadlines that hold their phase through a late run, missed-deadline and
+// jitter accounting on an overrun, one-shots, re-arming and re-periodising, the idle wait
+// runDue() hands back, and the task table limit.
+
+#include <unity.h>
+#include <vector>
+#include "../../src/Scheduler.h"
+
+static uint64_t fakeNow;
+static uint64_t clockNow() { return fakeNow; }
+
+// What one task saw: the clock at each of its runs. busyUs is how long its next run takes.
+struct Probe {
+    std::vector<uint64_t> startedUs;
+    uint64_t busyUs = 0;
+    int tag = 0;
+    std::vector<int>* order = nullptr;   // shared between probes to record who ran first
+
+    static void run(void* context) {
+        Probe* p = static_cast<Probe*>(context);
+        p->startedUs.push_back(fakeNow);
+        if (p->order) p->order->push_back(p->tag);
+        fakeNow += p->busyUs;
+        p->busyUs = 0;
+    }
+};
+
+void setUp() { fakeNow = 1000000; }
+void tearDown() {}
+
+// A run 300 us late does not push the following deadlines back by 300 us.
+void test_late_run_keeps_phase() {
+    Scheduler scheduler(clockNow);
+    Probe probe;
+    int id = scheduler.addPeriodic("tick", 1000, Probe::run, &probe);
+    uint64_t t0 = fakeNow;
+
+    TEST_ASSERT_EQUAL_UINT64(1000, scheduler.runDue());
+    fakeNow = t0 + 1300;
+    TEST_ASSERT_EQUAL_UINT64(700, scheduler.runDue());
+    fakeNow = t0 + 2000;
+    TEST_ASSERT_EQUAL_UINT64(1000, scheduler.runDue());
+    fakeNow = t0 + 3050;
+    scheduler.runDue();
+
+    TEST_ASSERT_EQUAL_size_t(4, probe.startedUs.size());
+    TEST_ASSERT_EQUAL_UINT64(t0 + 1300, probe.startedUs[1]);
+    TEST_ASSERT_EQUAL_UINT64(t0 + 2000, probe.startedUs[2]);
+    const TaskStats& stats = scheduler.stats(id);
+    TEST_ASSERT_EQUAL_UINT32(4, stats.runs);
+    TEST_ASSERT_EQUAL_UINT32(0, stats.missedDeadlines);
+    TEST_ASSERT_EQUAL_UINT64(50, stats.lastJitterUs);
+    TEST_ASSERT_EQUAL_UINT64(300, stats.maxJitterUs);
+    TEST_ASSERT_EQUAL_UINT64(350, stats.totalJitterUs);
+    TEST_ASSERT_EQUAL_UINT64(87, stats.meanJitterUs());
+}
+
+// A run that takes three and a half periods skips the deadlines it overran, once each, and the
+// next run lands back on the original phase.
+void test_overrun_counts_missed_deadlines() {
+    Scheduler scheduler(clockNow);
+    Probe probe;
+    probe.busyUs = 3500;
+    int id = scheduler.addPeriodic("slow", 1000, Probe::run, &probe);
+    uint64_t t0 = fakeNow;
+
+    // Runs at t0 (taking 3500 us), then once at t0 + 3500 for the deadline at t0 + 1000.
+    TEST_ASSERT_EQUAL_UINT64(500, scheduler.runDue());
+    TEST_ASSERT_EQUAL_size_t(2, probe.startedUs.size());
+    const TaskStats& stats = scheduler.stats(id);
+    TEST_ASSERT_EQUAL_UINT32(2, stats.runs);
+    TEST_ASSERT_EQUAL_UINT32(2, stats.missedDeadlines);     // t0 + 2000 and t0 + 3000
+    TEST_ASSERT_EQUAL_UINT64(2500, stats.lastJitterUs);
+    TEST_ASSERT_EQUAL_UINT64(2500, stats.maxJitterUs);
+    TEST_ASSERT_EQUAL_UINT64(3500, stats.maxRunUs);
+    TEST_ASSERT_EQUAL_UINT64(0, stats.lastRunUs);
+
+    fakeNow = t0 + 4000;
+    scheduler.runDue();
+    TEST_ASSERT_EQUAL_UINT64(t0 + 4000, probe.startedUs.back());
+    TEST_ASSERT_EQUAL_UINT32(2, stats.missedDeadlines);
+
+    scheduler.resetStats();
+    TEST_ASSERT_EQUAL_UINT32(0, scheduler.stats(id).runs);
+    TEST_ASSERT_EQUAL_UINT64(0, scheduler.stats(id).meanJitterUs());
+}
+
+// A one-shot fires once, then stays quiet until it is re-armed.
+void test_one_shot_fires_once() {
+    Scheduler scheduler(clockNow);
+    Probe probe;
+    int id = scheduler.addOneShot("once", 500, Probe::run, &probe);
+    uint64_t t0 = fakeNow;
+
+    TEST_ASSERT_EQUAL_UINT64(500, scheduler.runDue());
+    fakeNow = t0 + 800;
+    TEST_ASSERT_EQUAL_UINT64(UINT64_MAX, scheduler.runDue());
+    fakeNow = t0 + 100000;
+    TEST_ASSERT_EQUAL_UINT64(UINT64_MAX, scheduler.runDue());
+    TEST_ASSERT_EQUAL_size_t(1, probe.startedUs.size());
+    TEST_ASSERT_EQUAL_UINT64(300, scheduler.stats(id).lastJitterUs);
+    TEST_ASSERT_EQUAL_UINT64(0, scheduler.period(id));
+
+    scheduler.schedule(id, 200);
+    TEST_ASSERT_EQUAL_UINT64(200, scheduler.runDue());
+    fakeNow += 200;
+    TEST_ASSERT_EQUAL_UINT64(UINT64_MAX, scheduler.runDue());
+    TEST_ASSERT_EQUAL_size_t(2, probe.startedUs.size());
+    TEST_ASSERT_EQUAL_UINT64(0, scheduler.stats(id).lastJitterUs);
+}
+
+// schedule() moves a periodic task's next deadline; the period carries on from there.
+void test_schedule_rephases_periodic() {
+    Scheduler scheduler(clockNow);
+    Probe probe;
+    int id = scheduler.addPeriodic("tick", 1000, Probe::run, &probe);
+    uint64_t t0 = fakeNow;
+    scheduler.runDue();
+
+    fakeNow = t0 + 100;
+    scheduler.schedule(id, 250);
+    TEST_ASSERT_EQUAL_UINT64(250, scheduler.runDue());
+    fakeNow = t0 + 350;
+    TEST_ASSERT_EQUAL_UINT64(1000, scheduler.runDue());
+    fakeNow = t0 + 1350;
+    scheduler.runDue();
+    TEST_ASSERT_EQUAL_size_t(3, probe.startedUs.size());
+    TEST_ASSERT_EQUAL_UINT32(0, scheduler.stats(id).missedDeadlines);
+    TEST_ASSERT_EQUAL_UINT64(0, scheduler.stats(id).maxJitterUs);
+
+    // Disabled tasks never come due; re-enabling one starts a fresh period from now.
+    scheduler.setEnabled(id, false);
+    fakeNow = t0 + 10000;
+    TEST_ASSERT_EQUAL_UINT64(UINT64_MAX, scheduler.runDue());
+    scheduler.setEnabled(id, true);
+    TEST_ASSERT_EQUAL_UINT64(1000, scheduler.runDue());
+}
+
+// A longer period applies from the next deadline; a shorter one pulls that deadline in.
+void test_set_period() {
+    Scheduler scheduler(clockNow);
+    Probe probe;
+    int id = scheduler.addPeriodic("tick", 1000, Probe::run, &probe);
+    uint64_t t0 = fakeNow;
+    scheduler.runDue();
+
+    scheduler.setPeriod(id, 5000);
+    TEST_ASSERT_EQUAL_UINT64(5000, scheduler.period(id));
+    TEST_ASSERT_EQUAL_UINT64(1000, scheduler.runDue());
+    fakeNow = t0 + 1000;
+    TEST_ASSERT_EQUAL_UINT64(5000, scheduler.runDue());
+
+    fakeNow = t0 + 2000;                    // next deadline t0 + 6000
+    scheduler.setPeriod(id, 500);
+    TEST_ASSERT_EQUAL_UINT64(500, scheduler.runDue());
+    fakeNow = t0 + 2500;
+    TEST_ASSERT_EQUAL_UINT64(500, scheduler.runDue());
+    TEST_ASSERT_EQUAL_size_t(3, probe.startedUs.size());
+
+    // A shorter period that would end after the pending deadline leaves that deadline alone.
+    fakeNow = t0 + 2800;                    // next deadline t0 + 3000
+    scheduler.setPeriod(id, 400);
+    TEST_ASSERT_EQUAL_UINT64(200, scheduler.runDue());
+    fakeNow = t0 + 3000;
+    TEST_ASSERT_EQUAL_UINT64(400, scheduler.runDue());
+    scheduler.setPeriod(id, 0);
+    TEST_ASSERT_EQUAL_UINT64(400, scheduler.period(id));
+
+    // One-shots have no period to change.
+    int once = scheduler.addOneShot("once", 100, Probe::run, &probe);
+    scheduler.setPeriod(once, 1000);
+    TEST_ASSERT_EQUAL_UINT64(0, scheduler.period(once));
+}
+
+// runDue() returns the wait to the earliest deadline, and runs due tasks earliest first.
+void test_idle_wait_and_order() {
+    Scheduler scheduler(clockNow);
+    TEST_ASSERT_EQUAL_UINT64(UINT64_MAX, scheduler.runDue());
+
+    std::vector<int> order;
+    Probe a, b, c;
+    a.tag = 1; b.tag = 2; c.tag = 3;
+    a.order = b.order = c.order = &order;
+    uint64_t t0 = fakeNow;
+    scheduler.addPeriodic("a", 1000, Probe::run, &a, 700);
+    scheduler.addPeriodic("b", 250, Probe::run, &b, 300);
+    scheduler.addOneShot("c", 600, Probe::run, &c);
+
+    TEST_ASSERT_EQUAL_UINT64(300, scheduler.runDue());
+    fakeNow = t0 + 100;
+    TEST_ASSERT_EQUAL_UINT64(200, scheduler.runDue());
+    TEST_ASSERT_TRUE(order.empty());
+
+    fakeNow = t0 + 750;                     // b (300), b (550), c (600), a (700) all due
+    TEST_ASSERT_EQUAL_UINT64(50, scheduler.runDue());   // b again at 800
+    TEST_ASSERT_EQUAL_size_t(3, order.size());
+    TEST_ASSERT_EQUAL_INT(2, order[0]);
+    TEST_ASSERT_EQUAL_INT(3, order[1]);
+    TEST_ASSERT_EQUAL_INT(1, order[2]);
+    TEST_ASSERT_EQUAL_size_t(1, b.startedUs.size());     // 550 was skipped, not run twice
+}
+
+void test_task_table_limit() {
+    Scheduler scheduler(clockNow);
+    Probe probe;
+    TEST_ASSERT_EQUAL_INT(Scheduler::INVALID_TASK, scheduler.addPeriodic("zero", 0, Probe::run, &probe));
+    TEST_ASSERT_EQUAL_INT(Scheduler::INVALID_TASK, scheduler.addOneShot("none", 10, nullptr));
+    for (size_t i = 0; i < Scheduler::MAX_TASKS; i++) {
+        TEST_ASSERT_EQUAL_INT((int)i, scheduler.addPeriodic("task", 1000 + i, Probe::run, &probe));
+    }
+    TEST_ASSERT_EQUAL_INT(Scheduler::INVALID_TASK, scheduler.addPeriodic("extra", 1000, Probe::run, &probe));
+    TEST_ASSERT_EQUAL_INT(Scheduler::INVALID_TASK, scheduler.addOneShot("extra", 10, Probe::run, &probe));
+    TEST_ASSERT_EQUAL_size_t(Scheduler::MAX_TASKS, scheduler.count());
+
+    // Out-of-range ids are ignored rather than trusted.
+    scheduler.schedule(Scheduler::INVALID_TASK, 0);
+    scheduler.schedule((int)Scheduler::MAX_TASKS, 0);
+    scheduler.setPeriod(Scheduler::INVALID_TASK, 10);
+    TEST_ASSERT_EQUAL_STRING("", scheduler.name(Scheduler::INVALID_TASK));
+    TEST_ASSERT_EQUAL_UINT64(0, scheduler.period((int)Scheduler::MAX_TASKS));
+    TEST_ASSERT_EQUAL_UINT64(1000, scheduler.runDue());
+}
+
+int main(int argc, char** argv) {
+    UNITY_BEGIN();
+    RUN_TEST(test_late_run_keeps_phase);
+    RUN_TEST(test_overrun_counts_missed_deadlines);
+    RUN_TEST(test_one_shot_fires_once);
+    RUN_TEST(test_schedule_rephases_periodic);
+    RUN_TEST(test_set_period);
+    RUN_TEST(test_idle_wait_and_order);
+    RUN_TEST(test_task_table_limit);
+    return UNITY_END();
+}
@@ -0,0 +1,354 @@
+// SettingsManager over FileSettingsStore: a burst of setter calls costs one debounced blob write,
+// the blob's CRC catches any damaged byte, and a corrupt, truncated or oversized blob falls back
+// to legacy keys or defaults and is rewritten on the next commit.
+
+#include <unity.h>
+#include <stdio.h>
+#include <string.h>
+#include "../../hal/native/FileSettingsStore.h"
+#include "../../hal/native/TempDir.h"
+#include "../../src/Settings.h"
+
+static const uint32_t DEBOUNCE_MS = SettingsManager::DEFAULT_DEBOUNCE_MS;
+
+// A settings file in a scratch directory, as the native build keeps it next to the SD card.
+struct Flash {
+    TempDir dir;
+    char path[128];
+
+    Flash() { snprintf(path, sizeof(path), "%s/settings.bin", dir.path()); }
+
+    size_t readRaw(uint8_t* out, size_t cap) {
+        FILE* fp = fopen(path, "rb");
+        if (!fp) return 0;
+        size_t len = fread(out, 1, cap, fp);
+        fclose(fp);
+        return len;
+    }
+
+    void writeRaw(const uint8_t* data, size_t len) {
+        FILE* fp = fopen(path, "wb");
+        TEST_ASSERT_NOT_NULL(fp);
+        TEST_ASSERT_EQUAL(len, fwrite(data, 1, len, fp));
+        fclose(fp);
+    }
+};
+
+// Firmware before the blob kept one key per field; this one has a name and an interval.
+class LegacyStore : public FileSettingsStore {
+public:
+    explicit LegacyStore(const char* path) : FileSettingsStore(path) {}
+
+    bool readLegacy(SensorSettings& out) override {
+        strcpy(out.sensorName, "Greenhouse");
+        out.updateInterval = 15;
+        return true;
+    }
+};
+
+// Refuses writes while failing is set, like NVS with no free page.
+class FailingStore : public FileSettingsStore {
+public:
+    explicit FailingStore(const char* path) : FileSettingsStore(path), failing(true) {}
+
+    bool write(const uint8_t* data, size_t len) override {
+        return failing ? false : FileSettingsStore::write(data, len);
+    }
+
+    bool failing;
+};
+
+static SensorSettings sampleSettings() {
+    SensorSettings s;
+    SettingsManager::setDefaults(s);
+    strcpy(s.sensorName, "Lab bench");
+    s.updateInterval = 5;
+    strcpy(s.pWifiSSIDCharAndPassword, "PhotonIQ-Lab,photoniq");
+    s.wifiEnabled = false;
+    return s;
+}
+
+static void assertSameSettings(const SensorSettings& expected, const SensorSettings& actual) {
+    TEST_ASSERT_EQUAL_STRING(expected.sensorName, actual.sensorName);
+    TEST_ASSERT_EQUAL_INT(expected.updateInterval, actual.updateInterval);
+    TEST_ASSERT_EQUAL_STRING(expected.pWifiSSIDCharAndPassword, actual.pWifiSSIDCharAndPassword);
+    TEST_ASSERT_EQUAL(expected.wifiEnabled, actual.wifiEnabled);
+}
+
+// A fresh manager over the same file, as after a restart.
+static SensorSettings reload(const char* path) {
+    FileSettingsStore store(path);
+    SettingsManager settings(store);
+    settings.begin();
+    TEST_ASSERT_FALSE(settings.isDirty());
+    return settings.getSettings();
+}
+
+void setUp() {}
+void tearDown() {}
+
+void test_burst_commits_once_after_quiet_period() {
+    Flash flash;
+    FileSettingsStore store(flash.path);
+    SettingsManager settings(store);
+    settings.begin();
+    TEST_ASSERT_TRUE(settings.flush());                      // no blob yet: defaults are written
+    TEST_ASSERT_EQUAL_UINT32(1, store.writeCount());
+
+    // Writes arriving every 500 ms keep pushing the commit out.
+    uint32_t now = 10000;
+    for (int i = 1; i <= 10; i++) {
+        settings.setScanInterval(i);
+        TEST_ASSERT_FALSE(settings.service(now));
+        now += 500;
+        TEST_ASSERT_FALSE(settings.service(now));
+    }
+    settings.setSensorName("Lab bench");
+    TEST_ASSERT_FALSE(settings.service(now));
+    TEST_ASSERT_FALSE(settings.service(now + DEBOUNCE_MS - 1));
+    TEST_ASSERT_EQUAL_UINT32(1, store.writeCount());
+    TEST_ASSERT_TRUE(settings.service(now + DEBOUNCE_MS));
+    TEST_ASSERT_EQUAL_UINT32(2, store.writeCount());
+    TEST_ASSERT_FALSE(settings.isDirty());
+    TEST_ASSERT_FALSE(settings.service(now + 10 * DEBOUNCE_MS));
+    TEST_ASSERT_EQUAL_UINT32(2, store.writeCount());
+
+    SensorSettings loaded = reload(flash.path);
+    TEST_ASSERT_EQUAL_STRING("Lab bench", loaded.sensorName);
+    TEST_ASSERT_EQUAL_INT(10, loaded.updateInterval);
+    TEST_ASSERT_EQUAL_UINT32(11, settings.getStats().changes);
+}
+
+void test_unchanged_values_cost_no_write() {
+    Flash flash;
+    FileSettingsStore store(flash.path);
+    SettingsManager settings(store);
+    settings.begin();
+    settings.flush();
+    SensorSettings defaults = settings.getSettings();
+
+    settings.setSensorName(defaults.sensorName);
+    settings.setScanInterval(defaults.updateInterval);
+    settings.setWifiEnabled(defaults.wifiEnabled);
+    TEST_ASSERT_FALSE(settings.isDirty());
+    TEST_ASSERT_FALSE(settings.service(0));
+    TEST_ASSERT_FALSE(settings.service(10 * DEBOUNCE_MS));
+    TEST_ASSERT_EQUAL_UINT32(1, store.writeCount());
+    TEST_ASSERT_EQUAL_UINT32(3, settings.getStats().unchanged);
+}
+
+static void countNotification(void* context, uint32_t changed, const SensorSettings&) {
+    uint32_t* seen = (uint32_t*)context;
+    seen[0]++;
+    seen[1] |= changed;
+}
+
+void test_batch_is_one_change() {
+    Flash flash;
+    FileSettingsStore store(flash.path);
+    SettingsManager settings(store);
+    uint32_t seen[2] = {};
+    settings.addListener(countNotification, seen);
+    settings.begin();
+    settings.flush();
+
+    SensorSettings wanted = sampleSettings();
+    settings.beginUpdate();
+    settings.setSensorName(wanted.sensorName);
+    settings.setScanInterval(wanted.updateInterval);
+    TEST_ASSERT_FALSE(settings.service(0));
+    TEST_ASSERT_FALSE(settings.service(10 * DEBOUNCE_MS));   // not while the batch is open
+    settings.setWiFiCredentials(wanted.pWifiSSIDCharAndPassword);
+    settings.setWifiEnabled(wanted.wifiEnabled);
+    TEST_ASSERT_EQUAL_UINT32(0, seen[0]);
+    settings.endUpdate();
+    TEST_ASSERT_EQUAL_UINT32(1, seen[0]);
+    TEST_ASSERT_EQUAL_HEX32(SettingsManager::FIELD_ALL, seen[1]);
+
+    TEST_ASSERT_FALSE(settings.service(20 * DEBOUNCE_MS));
+    TEST_ASSERT_TRUE(settings.service(21 * DEBOUNCE_MS));
+    TEST_ASSERT_EQUAL_UINT32(2, store.writeCount());
+    assertSameSettings(wanted, reload(flash.path));
+}
+
+void test_failed_write_stays_dirty() {
+    Flash flash;
+    FailingStore store(flash.path);
+    SettingsManager settings(store);
+    settings.begin();
+    settings.setScanInterval(30);
+    TEST_ASSERT_FALSE(settings.service(0));
+    TEST_ASSERT_FALSE(settings.service(DEBOUNCE_MS));
+    TEST_ASSERT_EQUAL_UINT32(1, settings.getStats().commitFailures);
+    TEST_ASSERT_TRUE(settings.isDirty());
+
+    store.failing = false;
+    TEST_ASSERT_TRUE(settings.service(2 * DEBOUNCE_MS));
+    TEST_ASSERT_EQUAL_UINT32(1, settings.getStats().commits);
+    TEST_ASSERT_EQUAL_INT(30, reload(flash.path).updateInterval);
+}
+
+void test_blob_round_trip() {
+    SensorSettings s = sampleSettings();
+    uint8_t blob[SettingsManager::MAX_BLOB];
+    size_t len = SettingsManager::encode(s, 7, blob, sizeof(blob));
+    TEST_ASSERT_EQUAL(SettingsManager::MIN_BLOB + strlen(s.sensorName) + strlen(s.pWifiSSIDCharAndPassword), len);
+    TEST_ASSERT_EQUAL_HEX32(Crc32::compute(blob, len - 4), getLe32(blob + len - 4));
+
+    SensorSettings decoded;
+    uint32_t sequence = 0;
+    TEST_ASSERT_TRUE(SettingsManager::decode(blob, len, decoded, sequence));
+    TEST_ASSERT_EQUAL_UINT32(7, sequence);
+    assertSameSettings(s, decoded);
+
+    // Full-length fields fit the largest blob exactly.
+    memset(s.sensorName, 'n', SensorSettings::MAX_NAME);
+    memset(s.pWifiSSIDCharAndPassword, 'w', SensorSettings::MAX_WIFI_CREDENTIALS);
+    TEST_ASSERT_EQUAL(SettingsManager::MAX_BLOB, SettingsManager::encode(s, 8, blob, sizeof(blob)));
+    TEST_ASSERT_EQUAL(0, SettingsManager::encode(s, 8, blob, sizeof(blob) - 1));
+    TEST_ASSERT_TRUE(SettingsManager::decode(blob, SettingsManager::MAX_BLOB, decoded, sequence));
+    assertSameSettings(s, decoded);
+}
+
+void test_crc_catches_every_damaged_byte() {
+    uint8_t blob[SettingsManager::MAX_BLOB];
+    size_t len = SettingsManager::encode(sampleSettings(), 3, blob, sizeof(blob));
+    SensorSettings decoded;
+    uint32_t sequence;
+    for (size_t i = 0; i < len; i++) {
+        for (int bit = 0; bit < 8; bit++) {
+            blob[i] ^= (uint8_t)(1 << bit);
+            TEST_ASSERT_FALSE(SettingsManager::decode(blob, len, decoded, sequence));
+            blob[i] ^= (uint8_t)(1 << bit);
+        }
+    }
+    for (size_t cut = 0; cut < len; cut++) TEST_ASSERT_FALSE(SettingsManager::decode(blob, cut, decoded, sequence));
+    TEST_ASSERT_TRUE(SettingsManager::decode(blob, len, decoded, sequence));
+}
+
+void test_newer_blob_keeps_known_fields() {
+    // A later format version appends a field before the CRC; this reader takes what it knows.
+    SensorSettings s = sampleSettings();
+    uint8_t blob[SettingsManager::MAX_BLOB + 8];
+    size_t len = SettingsManager::encode(s, 4, blob, SettingsManager::MAX_BLOB) - 4;
+    blob[0] = SettingsManager::FORMAT_VERSION + 1;
+    const uint8_t extra[] = { 0x2A, 0x00, 0x10 };
+    memcpy(blob + len, extra, sizeof(extra));
+    len += sizeof(extra);
+    putLe32(blob + len, Crc32::compute(blob, len));
+    len += 4;
+
+    SensorSettings decoded;
+    uint32_t sequence = 0;
+    TEST_ASSERT_TRUE(SettingsManager::decode(blob, len, decoded, sequence));
+    TEST_ASSERT_EQUAL_UINT32(4, sequence);
+    assertSameSettings(s, decoded);
+}
+
+void test_corrupt_blob_falls_back_to_defaults() {
+    Flash flash;
+    {
+        FileSettingsStore store(flash.path);
+        SettingsManager settings(store);
+        settings.begin();
+        settings.setSensorName("Lab bench");
+        TEST_ASSERT_TRUE(settings.flush());
+    }
+    uint8_t raw[SettingsManager::MAX_BLOB];
+    size_t len = flash.readRaw(raw, sizeof(raw));
+    raw[12] ^= 0x40;                                         // one bit of the name
+    flash.writeRaw(raw, len);
+
+    FileSettingsStore store(flash.path);
+    SettingsManager settings(store);
+    settings.begin();
+    SensorSettings defaults;
+    SettingsManager::setDefaults(defaults);
+    assertSameSettings(defaults, settings.getSettings());
+    TEST_ASSERT_TRUE(settings.isDirty());
+    TEST_ASSERT_EQUAL_UINT32(0, settings.getStats().migrated);
+
+    // The next commit replaces the damaged blob with a valid one.
+    TEST_ASSERT_FALSE(settings.service(0));
+    TEST_ASSERT_TRUE(settings.service(DEBOUNCE_MS));
+    assertSameSettings(defaults, reload(flash.path));
+}
+
+void test_truncated_and_oversized_files_fall_back() {
+    Flash flash;
+    uint8_t blob[SettingsManager::MAX_BLOB + 1];
+    size_t len = SettingsManager::encode(sampleSettings(), 1, blob, SettingsManager::MAX_BLOB);
+    SensorSettings defaults;
+    SettingsManager::setDefaults(defaults);
+
+    flash.writeRaw(blob, len / 2);                           // torn by a power cut on a plain file
+    assertSameSettings(defaults, [&] {
+        FileSettingsStore store(flash.path);
+        SettingsManager settings(store);
+        settings.begin();
+        TEST_ASSERT_TRUE(settings.isDirty());
+        return settings.getSettings();
+    }());
+
+    memset(blob, 0xA5, sizeof(blob));                        // longer than any blob we write
+    flash.writeRaw(blob, sizeof(blob));
+    FileSettingsStore store(flash.path);
+    uint8_t out[SettingsManager::MAX_BLOB];
+    TEST_ASSERT_EQUAL(0, store.read(out, sizeof(out)));
+}
+
+void test_legacy_keys_migrate_when_blob_is_bad() {
+    Flash flash;
+    const uint8_t garbage[] = { 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15, 16 };
+    flash.writeRaw(garbage, sizeof(garbage));
+
+    LegacyStore store(flash.path);
+    SettingsManager settings(store);
+    settings.begin();
+    TEST_ASSERT_EQUAL_UINT32(1, settings.getStats().migrated);
+    TEST_ASSERT_EQUAL_STRING("Greenhouse", settings.getSettings().sensorName);
+    TEST_ASSERT_EQUAL_INT(15, settings.getSettings().updateInterval);
+    TEST_ASSERT_TRUE(settings.flush());
+
+    // Once the blob is valid the legacy keys are no longer consulted.
+    LegacyStore again(flash.path);
+    SettingsManager restarted(again);
+    restarted.begin();
+    TEST_ASSERT_EQUAL_UINT32(0, restarted.getStats().migrated);
+    TEST_ASSERT_FALSE(restarted.isDirty());
+    TEST_ASSERT_EQUAL_STRING("Greenhouse", restarted.getSettings().sensorName);
+}
+
+void test_sequence_advances_per_commit() {
+    Flash flash;
+    FileSettingsStore store(flash.path);
+    SettingsManager settings(store);
+    settings.begin();
+    for (int i = 0; i < 3; i++) {
+        settings.setScanInterval(10 + i);
+        TEST_ASSERT_TRUE(settings.flush());
+    }
+    uint8_t raw[SettingsManager::MAX_BLOB];
+    size_t len = flash.readRaw(raw, sizeof(raw));
+    SensorSettings decoded;
+    uint32_t sequence = 0;
+    TEST_ASSERT_TRUE(SettingsManager::decode(raw, len, decoded, sequence));
+    TEST_ASSERT_EQUAL_UINT32(3, sequence);
+    TEST_ASSERT_EQUAL_UINT32(3, store.writeCount());
+}
+
+int main(int argc, char** argv) {
+    UNITY_BEGIN();
+    RUN_TEST(test_burst_commits_once_after_quiet_period);
+    RUN_TEST(test_unchanged_values_cost_no_write);
+    RUN_TEST(test_batch_is_one_change);
+    RUN_TEST(test_failed_write_stays_dirty);
+    RUN_TEST(test_blob_round_trip);
+    RUN_TEST(test_crc_catches_every_damaged_byte);
+    RUN_TEST(test_newer_blob_keeps_known_fields);
+    RUN_TEST(test_corrupt_blob_falls_back_to_defaults);
+    RUN_TEST(test_truncated_and_oversized_files_fall_back);
+    RUN_TEST(test_legacy_keys_migrate_when_blob_is_bad);
+    RUN_TEST(test_sequence_advances_per_commit);
+    return UNITY_END();
+}
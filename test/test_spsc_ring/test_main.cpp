@@ -0,0 +1,157 @@
+// SpscRing: single-threaded contract, then a producer and a consumer on real threads.
+
+#include <atomic>
+#include <thread>
+#include <unity.h>
+#include "../../src/LightSample.h"
+#include "../../src/SpscRing.h"
+
+using Ring = SpscRing<LightSample, 64>;
+
+static const uint32_t STRESS_ITEMS = 1000000;
+
+// Every field derived from the sequence, so a torn copy shows up as a mismatch.
+static LightSample sampleFor(uint32_t sequence) {
+    LightSample s;
+    s.sequence = sequence;
+    s.timestampMs = 1760000000000ULL + sequence;
+    s.centiLux = sequence * 2654435761u;
+    s.fullCount = (uint16_t)(sequence ^ 0x5A5A);
+    s.irCount = (uint16_t)(sequence >> 3);
+    s.control = (uint8_t)sequence;
+    s.flags = (uint8_t)(sequence >> 8);
+    return s;
+}
+
+static bool intact(const LightSample& s) {
+    LightSample expected = sampleFor(s.sequence);
+    return s.timestampMs == expected.timestampMs && s.centiLux == expected.centiLux &&
+           s.fullCount == expected.fullCount && s.irCount == expected.irCount &&
+           s.control == expected.control && s.flags == expected.flags;
+}
+
+void setUp() {}
+void tearDown() {}
+
+void test_fifo_order() {
+    Ring ring;
+    LightSample out;
+    TEST_ASSERT_TRUE(ring.empty());
+    TEST_ASSERT_FALSE(ring.pop(out));
+    for (uint32_t i = 0; i < 10; i++) TEST_ASSERT_TRUE(ring.push(sampleFor(i)));
+    TEST_ASSERT_EQUAL(10, ring.size());
+    for (uint32_t i = 0; i < 10; i++) {
+        TEST_ASSERT_TRUE(ring.pop(out));
+        TEST_ASSERT_EQUAL_UINT32(i, out.sequence);
+    }
+    TEST_ASSERT_TRUE(ring.empty());
+}
+
+void test_full_ring_drops_and_counts() {
+    Ring ring;
+    for (uint32_t i = 0; i < Ring::CAPACITY; i++) TEST_ASSERT_TRUE(ring.push(sampleFor(i)));
+    TEST_ASSERT_FALSE(ring.push(sampleFor(999)));
+    TEST_ASSERT_FALSE(ring.push(sampleFor(1000)));
+    TEST_ASSERT_EQUAL_UINT32(2, ring.overrunCount());
+    LightSample out;
+    TEST_ASSERT_TRUE(ring.pop(out));
+    TEST_ASSERT_EQUAL_UINT32(0, out.sequence);   // the oldest survives; the new ones were dropped
+    TEST_ASSERT_TRUE(ring.push(sampleFor(64)));
+}
+
+void test_pop_latest_skips_backlog() {
+    Ring ring;
+    LightSample out;
+    TEST_ASSERT_FALSE(ring.popLatest(out));
+    for (uint32_t i = 0; i < 5; i++) ring.push(sampleFor(i));
+    TEST_ASSERT_TRUE(ring.popLatest(out));
+    TEST_ASSERT_EQUAL_UINT32(4, out.sequence);
+    TEST_ASSERT_TRUE(ring.empty());
+}
+
+// Indices wrap the slot array many times over.
+void test_wraps_around() {
+    Ring ring;
+    LightSample out;
+    for (uint32_t i = 0; i < 10 * Ring::CAPACITY + 3; i++) {
+        TEST_ASSERT_TRUE(ring.push(sampleFor(i)));
+        TEST_ASSERT_TRUE(ring.pop(out));
+        TEST_ASSERT_EQUAL_UINT32(i, out.sequence);
+    }
+}
+
+// Everything the producer got in comes out once, in order and intact; everything it didn't is
+// an overrun.
+void test_threaded_pop_sees_every_accepted_item() {
+    static Ring ring;
+    std::atomic<bool> done(false);
+    uint32_t accepted = 0;
+    std::thread producer([&] {
+        for (uint32_t i = 0; i < STRESS_ITEMS; i++) {
+            if (ring.push(sampleFor(i))) accepted++;
+            if ((i & 255) == 0) std::this_thread::yield();
+        }
+        done.store(true, std::memory_order_release);
+    });
+
+    uint32_t received = 0, torn = 0, reordered = 0;
+    int64_t last = -1;
+    LightSample out;
+    for (;;) {
+        if (ring.pop(out)) {
+            received++;
+            if (!intact(out)) torn++;
+            if ((int64_t)out.sequence <= last) reordered++;
+            last = out.sequence;
+        } else if (done.load(std::memory_order_acquire) && ring.empty()) {
+            break;
+        }
+    }
+    producer.join();
+
+    TEST_ASSERT_EQUAL_UINT32(0, torn);
+    TEST_ASSERT_EQUAL_UINT32(0, reordered);
+    TEST_ASSERT_EQUAL_UINT32(accepted, received);
+    TEST_ASSERT_EQUAL_UINT32(STRESS_ITEMS - accepted, ring.overrunCount());
+    TEST_ASSERT_GREATER_THAN(0, received);
+}
+
+// The BLE publisher's pattern: popLatest() never goes backwards and never tears.
+void test_threaded_pop_latest_is_monotonic() {
+    static Ring ring;
+    std::atomic<bool> done(false);
+    std::thread producer([&] {
+        for (uint32_t i = 0; i < STRESS_ITEMS; i++) {
+            ring.push(sampleFor(i));
+            if ((i & 255) == 0) std::this_thread::yield();
+        }
+        done.store(true, std::memory_order_release);
+    });
+
+    uint32_t received = 0, torn = 0, backwards = 0;
+    int64_t last = -1;
+    LightSample out;
+    while (!done.load(std::memory_order_acquire) || !ring.empty()) {
+        if (!ring.popLatest(out)) continue;
+        received++;
+        if (!intact(out)) torn++;
+        if ((int64_t)out.sequence <= last) backwards++;
+        last = out.sequence;
+    }
+    producer.join();
+
+    TEST_ASSERT_EQUAL_UINT32(0, torn);
+    TEST_ASSERT_EQUAL_UINT32(0, backwards);
+    TEST_ASSERT_GREATER_THAN(0, received);
+}
+
+int main(int argc, char** argv) {
+    UNITY_BEGIN();
+    RUN_TEST(test_fifo_order);
+    RUN_TEST(test_full_ring_drops_and_counts);
+    RUN_TEST(test_pop_latest_skips_backlog);
+    RUN_TEST(test_wraps_around);
+    RUN_TEST(test_threaded_pop_sees_every_accepted_item);
+    RUN_TEST(test_threaded_pop_latest_is_monotonic);
+    return UNITY_END();
+}
@@ -0,0 +1,355 @@
+// Timebase against a SimulatedDs3231 whose oscillator drifts by a known amount, with the timer
+// as the reference: how closely nowUs() follows the RTC once a boundary has been seen, by
+// polling and from SQW edges that reach the ISR late by a jittered few hundred microseconds;
+// the rate converging on the injected drift; nowUs() never running backwards through a slew, a
+// forward step or the RTC set back (only a set-back of over an hour is stepped back); a missed
+// window searched again; and the fall back to polling when SQW stops.
+
+#include <unity.h>
+#include <math.h>
+#include <random>
+#include "../../hal/native/SimulatedDs3231.h"
+#include "../../src/Timebase.h"
+
+static const uint32_t EPOCH = 1760000000UL;
+static const uint64_t S = 1000000;
+static const uint64_t MAX_WAIT_US = 50000;      // nowUs() is checked at least this often
+
+// Timebase's defaults, set explicitly so the bounds below can be derived from them.
+static const Timebase::Config CONFIG = { 600000, 10000, 1000, 15000, 200000, 500, 3600, 300 };
+
+// The RTC, the timebase over it and the timer clock driving both. The loop sleeps as service()
+// asks, waking early for SQW edges and every MAX_WAIT_US to look at nowUs().
+struct Bench {
+    SimulatedDs3231 rtc;
+    Timebase timebase;
+    std::mt19937 rng;
+    uint64_t monoUs;
+    double driftPpm;
+    bool squareWave;
+    uint32_t latencyUs;     // SQW edges are timestamped up to this late
+    uint64_t wakeUs;        // next service() call
+    int64_t lastNowUs;
+    uint32_t backwards;     // times nowUs() went back
+    int64_t largestBackUs;
+    int32_t maxErrorUs;     // largest |nowUs() - RTC| since resetError(), once precise()
+
+    Bench(double ppm, bool sqw = false, uint32_t latency = 0)
+        : rtc(EPOCH, (float)ppm), timebase(rtc), rng(7), monoUs(10 * S), driftPpm(ppm), squareWave(sqw),
+          latencyUs(latency), wakeUs(0), lastNowUs(0), backwards(0), largestBackUs(0), maxErrorUs(0) {
+        rtc.advance(123456);
+        timebase.setConfig(CONFIG);
+        timebase.useSquareWave(sqw);
+        TEST_ASSERT_TRUE(timebase.begin(monoUs));
+        wakeUs = monoUs;
+        lastNowUs = timebase.nowUs(monoUs);
+    }
+
+    int32_t errorUs() const { return (int32_t)llround((double)timebase.nowUs(monoUs) - rtc.timeSeconds() * 1e6); }
+    void resetError() { maxErrorUs = 0; }
+
+    // Timer time of the RTC's next seconds rollover (its SQW falling edge).
+    uint64_t nextEdgeUs() const {
+        double t = rtc.timeSeconds();
+        double left = (floor(t) + 1 - t) * 1e6 / (1 + driftPpm * 1e-6);
+        return monoUs + (uint64_t)ceil(left);
+    }
+
+    void advanceTo(uint64_t us) {
+        rtc.advance(us - monoUs);
+        monoUs = us;
+    }
+
+    void run(uint64_t us) {
+        uint64_t end = monoUs + us;
+        while (monoUs < end) {
+            if (monoUs >= wakeUs) {
+                uint64_t wait = timebase.service(monoUs);
+                wakeUs = monoUs + (wait ? wait : 1);
+            }
+            uint64_t edge = nextEdgeUs();
+            uint64_t next = wakeUs < monoUs + MAX_WAIT_US ? wakeUs : monoUs + MAX_WAIT_US;
+            if (end < next) next = end;
+            if (squareWave && edge <= next) {
+                advanceTo(edge);
+                uint64_t stamped = edge + (latencyUs ? rng() % latencyUs : 0);
+                advanceTo(stamped);
+                timebase.onSquareWaveEdge(stamped);
+            } else {
+                advanceTo(next);
+            }
+            check();
+        }
+    }
+
+    void check() {
+        int64_t now = timebase.nowUs(monoUs);
+        if (now < lastNowUs) {
+            backwards++;
+            if (lastNowUs - now > largestBackUs) largestBackUs = lastNowUs - now;
+        }
+        lastNowUs = now;
+        if (timebase.precise()) {
+            int32_t e = abs(errorUs());
+            if (e > maxErrorUs) maxErrorUs = e;
+        }
+    }
+
+    // Sets the RTC to `seconds` (the new second starting now) and asks for an anchor, as the
+    // firmware does after an NTP correction.
+    void setRtc(uint32_t seconds, bool announce = true) {
+        TEST_ASSERT_TRUE(rtc.writeSeconds(seconds));
+        if (announce) timebase.requestAnchor();
+        wakeUs = monoUs;
+    }
+
+    uint32_t rtcSeconds() {
+        uint32_t s;
+        rtc.readSeconds(s);
+        return s;
+    }
+};
+
+void setUp() {}
+void tearDown() {}
+
+// Rate error allowed once measured across the rate window: the edge uncertainty at both ends
+// over the shortest span the window guarantees (one re-anchor period less than the window).
+static int32_t rateToleranceFor(uint32_t edgeUncertaintyUs) {
+    const Timebase::Config& c = CONFIG;
+    uint64_t spanUs = ((uint64_t)c.rateWindowS - c.reanchorPeriodMs / 1000) * S;
+    return (int32_t)((uint64_t)edgeUncertaintyUs * 1000000000 / spanUs);
+}
+
+// Runs for us, checking the measured rate against the injected drift every anchor period.
+static void runCheckingRate(Bench& b, uint64_t us, int32_t tolerancePpb) {
+    uint64_t periodUs = (uint64_t)CONFIG.reanchorPeriodMs * 1000;
+    for (uint64_t t = 0; t < us; t += periodUs) {
+        b.run(periodUs);
+        TEST_ASSERT_INT32_WITHIN(tolerancePpb, (int32_t)(b.driftPpm * 1000), b.timebase.getStats().ratePpb);
+    }
+}
+
+// Polled boundaries. The first comes from the coarse search, and the drift is unknown until two
+// anchors a baseline apart; after that the line stays within the window's read spacing.
+void test_polled_follows_drifting_rtc() {
+    const Timebase::Config& c = CONFIG;
+    double ppms[] = { 20, -35, 100 };
+    for (double ppm : ppms) {
+        Bench b(ppm);
+        b.run(2 * S);
+        TEST_ASSERT_TRUE(b.timebase.precise());
+        TEST_ASSERT_EQUAL_UINT32(0, b.timebase.getStats().squareWaveAnchors);
+
+        b.resetError();
+        b.run((uint64_t)c.rateWindowS * S + (uint64_t)c.reanchorPeriodMs * 1000);
+        int32_t settling = (int32_t)(c.searchPollUs / 2 + c.windowPollUs + fabs(ppm) * c.minRateBaselineS);
+        TEST_ASSERT_LESS_OR_EQUAL(settling, b.maxErrorUs);
+
+        // 100 ppm over the baseline is more than the window; that miss is searched again, once.
+        uint32_t missed = b.timebase.getStats().missedWindows;
+        TEST_ASSERT_LESS_OR_EQUAL_UINT32(fabs(ppm) * c.minRateBaselineS > c.windowUs ? 1 : 0, missed);
+
+        b.resetError();
+        runCheckingRate(b, 2 * 3600 * S, rateToleranceFor(c.windowPollUs));
+        TEST_ASSERT_LESS_OR_EQUAL(c.windowPollUs, b.maxErrorUs);
+        TEST_ASSERT_EQUAL_UINT32(0, b.backwards);
+        TEST_ASSERT_EQUAL_UINT32(0, b.timebase.getStats().steps);
+        TEST_ASSERT_EQUAL_UINT32(missed, b.timebase.getStats().missedWindows);
+    }
+}
+
+// SQW edges timestamped up to 400 us late: one register read per anchor, and the line within
+// the latency of the RTC.
+void test_square_wave_follows_drifting_rtc() {
+    const Timebase::Config& c = CONFIG;
+    const uint32_t latencyUs = 400;
+    double ppms[] = { 20, -35 };
+    for (double ppm : ppms) {
+        Bench b(ppm, true, latencyUs);
+        b.run(2 * S);
+        TEST_ASSERT_TRUE(b.timebase.precise());
+
+        b.resetError();
+        b.run((uint64_t)c.rateWindowS * S + (uint64_t)c.reanchorPeriodMs * 1000);
+        TEST_ASSERT_LESS_OR_EQUAL((int32_t)(latencyUs + fabs(ppm) * c.minRateBaselineS), b.maxErrorUs);
+
+        b.resetError();
+        runCheckingRate(b, 2 * 3600 * S, rateToleranceFor(latencyUs));
+        TEST_ASSERT_LESS_OR_EQUAL(latencyUs, b.maxErrorUs);
+        const Timebase::Stats& stats = b.timebase.getStats();
+        TEST_ASSERT_EQUAL_UINT32(stats.anchors, stats.squareWaveAnchors);
+        TEST_ASSERT_EQUAL_UINT32(stats.anchors + 1, stats.rtcReads);
+        TEST_ASSERT_EQUAL_UINT32(0, b.backwards);
+    }
+}
+
+// The coarse begin() anchor is ahead of the RTC here; the first fine anchor takes that out at
+// half speed rather than stepping back, and the window after it slews out the search's error.
+void test_first_anchor_never_goes_back() {
+    Bench b(0);
+    TEST_ASSERT_FALSE(b.timebase.precise());
+    b.run(1 * S);
+    TEST_ASSERT_TRUE(b.timebase.precise());
+    TEST_ASSERT_LESS_THAN(-(int32_t)CONFIG.stepThresholdUs, b.timebase.getStats().lastErrorUs);
+    b.run(2 * S);
+    TEST_ASSERT_EQUAL_UINT32(2, b.timebase.getStats().anchors);
+    TEST_ASSERT_LESS_OR_EQUAL(CONFIG.searchPollUs / 2, abs(b.errorUs()));
+    b.run(CONFIG.searchPollUs / 2 * 1000000ULL / CONFIG.maxSlewPpm);  // the slew, at most
+    b.resetError();
+    b.run(CONFIG.minRateBaselineS * S);
+    TEST_ASSERT_LESS_OR_EQUAL(CONFIG.windowPollUs, b.maxErrorUs);
+    TEST_ASSERT_EQUAL_UINT32(0, b.backwards);
+    TEST_ASSERT_EQUAL_UINT32(0, b.timebase.getStats().steps);
+}
+
+// A settled timebase, its RTC then set with the new second starting at fraction f of the current one.
+static void settle(Bench& b) {
+    b.run(2 * 3600 * S);
+    b.resetError();
+    b.backwards = 0;
+}
+
+static void runToFraction(Bench& b, double f) {
+    b.run(b.nextEdgeUs() - b.monoUs + (uint64_t)(f * 1e6));
+}
+
+// RTC 50 ms ahead, then 50 ms behind: both slewed in at maxSlewPpm, the clock running on throughout.
+void test_small_corrections_slew() {
+    const Timebase::Config& c = CONFIG;
+    Bench b(20);
+    settle(b);
+    uint32_t steps = b.timebase.getStats().steps;
+
+    runToFraction(b, 0.95);
+    b.setRtc(b.rtcSeconds() + 1);
+    b.run(2 * S);
+    TEST_ASSERT_INT32_WITHIN(c.searchPollUs / 2, 50000, b.timebase.getStats().lastErrorUs);
+    TEST_ASSERT_LESS_OR_EQUAL(50000, b.maxErrorUs);
+    b.run(100 * S + 700 * S);   // 50 ms at 500 ppm, then a windowed anchor to settle the search's error
+
+    runToFraction(b, 0.05);
+    b.setRtc(b.rtcSeconds());
+    b.run(2 * S);
+    TEST_ASSERT_INT32_WITHIN(c.searchPollUs / 2, -50000, b.timebase.getStats().lastErrorUs);
+    b.run(100 * S + 700 * S);   // 50 ms at 500 ppm, then a windowed anchor to settle the search's error
+
+    b.resetError();
+    b.run(3600 * S);
+    TEST_ASSERT_LESS_OR_EQUAL(c.windowPollUs, b.maxErrorUs);
+    TEST_ASSERT_EQUAL_UINT32(steps, b.timebase.getStats().steps);
+    TEST_ASSERT_EQUAL_UINT32(0, b.backwards);
+}
+
+// RTC set 4.5 s ahead: stepped forward at the next anchor.
+void test_forward_step() {
+    const Timebase::Config& c = CONFIG;
+    Bench b(20);
+    settle(b);
+    uint32_t steps = b.timebase.getStats().steps;
+    runToFraction(b, 0.5);
+    b.setRtc(b.rtcSeconds() + 5);
+    b.run(2 * S);
+    TEST_ASSERT_EQUAL_UINT32(steps + 1, b.timebase.getStats().steps);
+    TEST_ASSERT_LESS_OR_EQUAL(c.searchPollUs / 2, abs(b.errorUs()));
+    b.run(3600 * S);
+    TEST_ASSERT_EQUAL_UINT32(0, b.backwards);
+}
+
+// RTC set back ten minutes: the clock runs at half speed until the RTC has caught up with it.
+void test_set_back_catches_up_at_half_speed() {
+    const Timebase::Config& c = CONFIG;
+    Bench b(20);
+    settle(b);
+    b.setRtc(b.rtcSeconds() - 600);
+    b.run(2 * S);
+    TEST_ASSERT_EQUAL_UINT32(1, b.timebase.getStats().steps);
+    TEST_ASSERT_INT32_WITHIN(1000000, -600000000, b.timebase.getStats().lastErrorUs);
+
+    int64_t before = b.timebase.nowUs(b.monoUs);
+    b.run(100 * S);
+    int64_t elapsed = b.timebase.nowUs(b.monoUs) - before;
+    TEST_ASSERT_INT64_WITHIN(100000, 50 * (int64_t)S, elapsed);
+
+    b.run(1200 * S);
+    TEST_ASSERT_LESS_OR_EQUAL(c.searchPollUs / 2 + c.windowPollUs, abs(b.errorUs()));
+    b.resetError();
+    b.run(3600 * S);
+    TEST_ASSERT_LESS_OR_EQUAL(c.windowPollUs + 20 * c.minRateBaselineS, b.maxErrorUs);
+    TEST_ASSERT_EQUAL_UINT32(0, b.backwards);
+}
+
+// RTC set back two hours: too far to run slow through, so the clock steps back, once.
+void test_set_back_over_an_hour_steps_back() {
+    const Timebase::Config& c = CONFIG;
+    Bench b(20);
+    settle(b);
+    b.setRtc(b.rtcSeconds() - 7200);
+    b.run(2 * S);
+    TEST_ASSERT_EQUAL_UINT32(1, b.backwards);
+    TEST_ASSERT_INT64_WITHIN(2 * S, 7200 * (int64_t)S, b.largestBackUs);
+    TEST_ASSERT_LESS_OR_EQUAL(c.searchPollUs / 2, abs(b.errorUs()));
+    b.run(3600 * S);
+    TEST_ASSERT_EQUAL_UINT32(1, b.backwards);
+}
+
+// The RTC moved 50 ms without the timebase being told: the next window closes before the
+// boundary it predicted shows up, a fresh search finds the new one and a window at the next
+// second pins it down.
+void test_missed_window_searches_again() {
+    const Timebase::Config& c = CONFIG;
+    Bench b(20);
+    settle(b);
+    uint32_t anchors = b.timebase.getStats().anchors;
+    runToFraction(b, 0.05);
+    b.setRtc(b.rtcSeconds(), false);
+
+    b.run((uint64_t)c.reanchorPeriodMs * 1000 + 2 * S);
+    const Timebase::Stats& stats = b.timebase.getStats();
+    TEST_ASSERT_EQUAL_UINT32(1, stats.missedWindows);
+    TEST_ASSERT_EQUAL_UINT32(anchors + 2, stats.anchors);
+    TEST_ASSERT_INT32_WITHIN(c.searchPollUs / 2 + 20 * c.reanchorPeriodMs / 1000, -50000, stats.lastErrorUs);
+
+    b.run(3600 * S);
+    TEST_ASSERT_EQUAL_UINT32(1, stats.missedWindows);
+    TEST_ASSERT_LESS_OR_EQUAL(c.windowPollUs, abs(b.errorUs()));
+    TEST_ASSERT_EQUAL_UINT32(0, b.backwards);
+    TEST_ASSERT_EQUAL_UINT32(0, stats.steps);
+}
+
+// SQW stops (a broken wire): anchors carry on from polled windows; when edges return, so do
+// SQW anchors.
+void test_square_wave_stops() {
+    const Timebase::Config& c = CONFIG;
+    Bench b(20, true, 400);
+    settle(b);
+    const Timebase::Stats& stats = b.timebase.getStats();
+    uint32_t sqwAnchors = stats.squareWaveAnchors;
+    uint32_t anchors = stats.anchors;
+
+    b.squareWave = false;
+    b.run(3600 * S);
+    TEST_ASSERT_EQUAL_UINT32(sqwAnchors, stats.squareWaveAnchors);
+    TEST_ASSERT_GREATER_OR_EQUAL_UINT32(anchors + 5, stats.anchors);
+    TEST_ASSERT_EQUAL_UINT32(0, stats.missedWindows);
+    TEST_ASSERT_LESS_OR_EQUAL(c.windowPollUs, b.maxErrorUs);
+
+    b.squareWave = true;
+    b.run(3600 * S);
+    TEST_ASSERT_GREATER_THAN_UINT32(sqwAnchors, stats.squareWaveAnchors);
+    TEST_ASSERT_EQUAL_UINT32(0, b.backwards);
+}
+
+int main(int argc, char** argv) {
+    UNITY_BEGIN();
+    RUN_TEST(test_polled_follows_drifting_rtc);
+    RUN_TEST(test_square_wave_follows_drifting_rtc);
+    RUN_TEST(test_first_anchor_never_goes_back);
+    RUN_TEST(test_small_corrections_slew);
+    RUN_TEST(test_forward_step);
+    RUN_TEST(test_set_back_catches_up_at_half_speed);
+    RUN_TEST(test_set_back_over_an_hour_steps_back);
+    RUN_TEST(test_missed_window_searches_again);
+    RUN_TEST(test_square_wave_stops);
+    return UNITY_END();
+}
@@ -0,0 +1,243 @@
+// Uplink against the in-process collector (LocalUplinkServer) with a spool on a scratch
+// directory: batching and the batch age limit, keep-alive uploads, backoff on 5xx and on an
+// unreachable server, lost replies, and a backlog spilled to the spool during an outage and
+// replayed afterwards, including by the next boot.
+
+#include <unity.h>
+#include <vector>
+#include "../../hal/native/FileBlockFile.h"
+#include "../../hal/native/LocalUplinkServer.h"
+#include "../../hal/native/TempDir.h"
+#include "../../src/Uplink.h"
+#include "../../src/UplinkSpool.h"
+
+static const uint32_t SPOOL_BLOCKS = 64;
+
+// One device's uplink and the collector it talks to, on the server's clock.
+struct Link {
+    TempDir dir;
+    FileBlockFile spoolFile;
+    UplinkSpool spool;
+    LocalUplinkServer server;
+    Uplink uplink;
+    bool networkUp;
+    uint32_t nextSequence;
+    std::vector<uint32_t> delivered;   // sample sequences, in the order the server took them
+
+    Link() : spoolFile(dir.path()), spool(spoolFile, "spool.q", SPOOL_BLOCKS), uplink(server, "collector", "/ingest"),
+             networkUp(true), nextSequence(0) {
+        server.setSampleCallback(onSample, this);
+        uplink.setSpool(&spool);
+        uplink.begin(0x1234);
+    }
+
+    static void onSample(void* context, const LightSample& s) { static_cast<Link*>(context)->delivered.push_back(s.sequence); }
+
+    // Runs the uplink for ms, waking when it asks to (never sleeping past the end).
+    void run(uint32_t ms) {
+        uint32_t end = server.now() + ms;
+        while ((int32_t)(end - server.now()) > 0) {
+            uint32_t wait = uplink.service(server.now(), networkUp);
+            uint32_t left = end - server.now();
+            server.advance(wait == 0 ? 1 : wait < left ? wait : left);
+        }
+    }
+
+    // count samples, intervalMs apart, running the uplink in between.
+    void sample(uint32_t count, uint32_t intervalMs) {
+        for (uint32_t i = 0; i < count; i++) {
+            LightSample s = {};
+            s.sequence = nextSequence++;
+            s.timestampMs = 1760000000000ULL + (uint64_t)s.sequence * intervalMs;
+            s.centiLux = 25000 + (s.sequence % 50) * 10;
+            s.fullCount = 900;
+            s.irCount = 120;
+            s.control = 0x11;
+            uplink.add(s, server.now());
+            run(intervalMs);
+        }
+    }
+
+    // Seals what is open and runs until the backlog has drained (or maxMs has passed).
+    void drain(uint32_t maxMs = 3600000) {
+        uplink.flush();
+        for (uint32_t waited = 0; waited < maxMs && (uplink.backlog() > 0 || uplink.state() != Uplink::STATE_IDLE); waited += 1000) {
+            run(1000);
+        }
+    }
+
+    // Every sample from first up to nextSequence arrived exactly once, in order.
+    void checkDelivered(uint32_t first = 0) {
+        TEST_ASSERT_EQUAL_UINT32(nextSequence - first, delivered.size());
+        for (size_t i = 0; i < delivered.size(); i++) TEST_ASSERT_EQUAL_UINT32(first + i, delivered[i]);
+        TEST_ASSERT_EQUAL_UINT32(0, server.getCounters().gaps);
+        TEST_ASSERT_EQUAL_UINT32(0, server.getCounters().malformed);
+    }
+};
+
+void setUp() {}
+void tearDown() {}
+
+void test_batch_age_follows_sample_interval() {
+    TEST_ASSERT_EQUAL_UINT32(Uplink::MIN_BATCH_AGE_MS, Uplink::batchAgeFor(0));
+    TEST_ASSERT_EQUAL_UINT32(Uplink::MIN_BATCH_AGE_MS, Uplink::batchAgeFor(1000));
+    TEST_ASSERT_EQUAL_UINT32(10000 * Uplink::BATCH_EVERY_SAMPLES, Uplink::batchAgeFor(10000));
+    TEST_ASSERT_EQUAL_UINT32(Uplink::MAX_BATCH_AGE_MS, Uplink::batchAgeFor(60000));
+    TEST_ASSERT_EQUAL_UINT32(Uplink::MAX_BATCH_AGE_MS, Uplink::batchAgeFor(UINT32_MAX));
+}
+
+// At the default one-minute interval a batch carries half an hour of samples, not one.
+void test_slow_sampling_packs_batches() {
+    Link link;
+    link.uplink.setSampleInterval(60000);
+    link.sample(180, 60000);
+    link.drain();
+    const Uplink::Stats& stats = link.uplink.getStats();
+    TEST_ASSERT_LESS_OR_EQUAL_UINT32(7, stats.batchesSealed);
+    TEST_ASSERT_EQUAL_UINT32(stats.batchesSealed, stats.batchesAcked);
+    TEST_ASSERT_GREATER_OR_EQUAL_UINT32(Uplink::BATCH_EVERY_SAMPLES - 1, 180 / stats.batchesSealed);
+    link.checkDelivered();
+}
+
+void test_uploads_in_order_on_one_connection() {
+    Link link;
+    link.uplink.setSampleInterval(1000);
+    link.sample(600, 1000);
+    link.drain();
+    const Uplink::Stats& stats = link.uplink.getStats();
+    TEST_ASSERT_UINT32_WITHIN(1, 10, stats.batchesSealed);
+    TEST_ASSERT_EQUAL_UINT32(stats.batchesSealed, stats.batchesAcked);
+    TEST_ASSERT_EQUAL_UINT32(600, stats.samplesAcked);
+    TEST_ASSERT_EQUAL_UINT32(0, stats.retries);
+    TEST_ASSERT_EQUAL_UINT32(1, link.server.getCounters().connections);
+    TEST_ASSERT_EQUAL_UINT32(0, link.server.getCounters().duplicates);
+    TEST_ASSERT_EQUAL_UINT32(204, stats.lastStatus);
+    link.checkDelivered();
+}
+
+// 503s are retried after 2, 4, 8 ... s, so a five-minute outage costs a handful of requests.
+void test_server_errors_back_off() {
+    Link link;
+    link.server.setStatus(503);
+    link.sample(60, 1000);
+    link.uplink.flush();
+    link.run(300000);
+    const LocalUplinkServer::Counters& counters = link.server.getCounters();
+    TEST_ASSERT_GREATER_OR_EQUAL_UINT32(6, counters.requests);
+    TEST_ASSERT_LESS_OR_EQUAL_UINT32(9, counters.requests);
+    TEST_ASSERT_EQUAL_UINT32(counters.requests, link.uplink.getStats().retries);
+    TEST_ASSERT_EQUAL_UINT32(0, counters.samples);
+    TEST_ASSERT_EQUAL_UINT32(Uplink::STATE_BACKOFF, link.uplink.state());
+
+    link.server.setStatus(204);
+    link.drain();
+    link.checkDelivered();
+}
+
+// Connects that never complete time out and back off the same way.
+void test_unreachable_server_backs_off() {
+    Link link;
+    link.server.setReachable(false);
+    link.sample(60, 1000);
+    link.uplink.flush();
+    link.run(600000);
+    uint32_t retries = link.uplink.getStats().retries;
+    TEST_ASSERT_GREATER_OR_EQUAL_UINT32(5, retries);
+    TEST_ASSERT_LESS_OR_EQUAL_UINT32(10, retries);
+    TEST_ASSERT_EQUAL_UINT32(0, link.server.getCounters().connections);
+
+    link.server.setReachable(true);
+    link.drain();
+    link.checkDelivered();
+}
+
+// A request whose reply is lost is sent again; the server recognises the resend.
+void test_lost_replies_are_resent_once() {
+    Link link;
+    link.uplink.setSampleInterval(1000);
+    link.server.setDropReplyEvery(3);
+    link.sample(600, 1000);
+    link.drain();
+    const LocalUplinkServer::Counters& counters = link.server.getCounters();
+    TEST_ASSERT_GREATER_THAN_UINT32(0, counters.repliesDropped);
+    TEST_ASSERT_EQUAL_UINT32(counters.repliesDropped, counters.duplicates);
+    link.checkDelivered();
+}
+
+// With the network down nothing is attempted and nothing counts as a failure.
+void test_network_down_is_not_a_failure() {
+    Link link;
+    link.networkUp = false;
+    link.sample(120, 1000);
+    TEST_ASSERT_EQUAL_UINT32(0, link.uplink.getStats().retries);
+    TEST_ASSERT_EQUAL_UINT32(0, link.server.getCounters().connections);
+    link.networkUp = true;
+    link.drain();
+    link.checkDelivered();
+}
+
+// An outage longer than the RAM queue spills the oldest batches to the spool; they go first.
+void test_spool_replays_backlog_in_order() {
+    Link link;
+    link.uplink.setSampleInterval(1000);
+    link.server.setReachable(false);
+    link.sample(1200, 1000);
+    const Uplink::Stats& stats = link.uplink.getStats();
+    TEST_ASSERT_GREATER_OR_EQUAL_UINT32(10, stats.spilled);
+    TEST_ASSERT_EQUAL_UINT32(0, stats.samplesDropped);
+    TEST_ASSERT_EQUAL_UINT32(stats.spilled, link.spool.count());
+
+    link.server.setReachable(true);
+    link.drain();
+    TEST_ASSERT_TRUE(link.spool.empty());
+    TEST_ASSERT_EQUAL_UINT32(0, link.uplink.backlog());
+    link.checkDelivered();
+}
+
+// Spooled batches outlive a reboot: the next boot's uplink sends them before its own.
+void test_spool_survives_reboot() {
+    Link link;
+    link.uplink.setSampleInterval(1000);
+    link.server.setReachable(false);
+    link.sample(900, 1000);
+    uint32_t spooled = link.spool.count();
+    TEST_ASSERT_GREATER_THAN_UINT32(0, spooled);
+
+    {
+        UplinkSpool spool(link.spoolFile, "spool.q", SPOOL_BLOCKS);
+        Uplink uplink(link.server, "collector", "/ingest");
+        uplink.setSpool(&spool);
+        uplink.begin(0x5678);
+        TEST_ASSERT_TRUE(spool.available());
+        TEST_ASSERT_EQUAL_UINT32(spooled, uplink.backlog());
+        link.server.setReachable(true);
+        for (int i = 0; i < 600 && uplink.backlog() > 0; i++) {
+            link.server.advance(uplink.service(link.server.now(), true) + 1);
+        }
+        TEST_ASSERT_EQUAL_UINT32(0, uplink.backlog());
+        TEST_ASSERT_EQUAL_UINT32(spooled, uplink.getStats().batchesAcked);
+        TEST_ASSERT_TRUE(spool.empty());
+    }
+    // A contiguous run of the oldest samples, in order. The batch held for sending, the RAM queue
+    // and the open batch died with the first boot; the spool starts with the batch after the held one.
+    const LocalUplinkServer::Counters& counters = link.server.getCounters();
+    TEST_ASSERT_EQUAL_UINT32(spooled, counters.batches);
+    TEST_ASSERT_EQUAL_UINT32(0, counters.gaps);
+    TEST_ASSERT_EQUAL_UINT32(counters.samples, link.delivered.size());
+    TEST_ASSERT_UINT32_WITHIN(1, 60, link.delivered[0]); // one minute's batch
+    for (size_t i = 1; i < link.delivered.size(); i++) TEST_ASSERT_EQUAL_UINT32(link.delivered[0] + i, link.delivered[i]);
+}
+
+int main(int argc, char** argv) {
+    UNITY_BEGIN();
+    RUN_TEST(test_batch_age_follows_sample_interval);
+    RUN_TEST(test_slow_sampling_packs_batches);
+    RUN_TEST(test_uploads_in_order_on_one_connection);
+    RUN_TEST(test_server_errors_back_off);
+    RUN_TEST(test_unreachable_server_backs_off);
+    RUN_TEST(test_lost_replies_are_resent_once);
+    RUN_TEST(test_network_down_is_not_a_failure);
+    RUN_TEST(test_spool_replays_backlog_in_order);
+    RUN_TEST(test_spool_survives_reboot);
+    return UNITY_END();
+}
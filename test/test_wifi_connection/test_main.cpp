@@ -0,0 +1,254 @@
+// WifiConnection against SimulatedAccessPoint in simulated time: attempts end by the AP's answer
+// or by the attempt timeout, failures back off exponentially up to the cap, and requests made
+// from another thread are picked up by the next service() without tearing.
+
+#include <unity.h>
+#include <atomic>
+#include <stdio.h>
+#include <thread>
+#include "../../hal/native/SimulatedAccessPoint.h"
+#include "../../src/WifiConnection.h"
+
+using State = WifiConnection::State;
+
+static const uint32_t TICK_MS = 250;                         // the firmware's wifi task period
+
+// One station and its AP on a shared simulated clock, stepped like the scheduler steps service().
+struct Radio {
+    static constexpr size_t MAX_EVENTS = 64;
+
+    SimulatedAccessPoint ap;
+    WifiConnection wifi;
+    uint32_t nowMs;
+    struct Event {
+        uint32_t atMs;
+        State state;
+    } events[MAX_EVENTS];
+    size_t eventCount;
+    char lastSsid[WifiConnection::MAX_SSID + 1];
+
+    Radio() : ap("PhotonIQ-Lab", "photoniq"), wifi(ap), nowMs(1000), eventCount(0) {
+        lastSsid[0] = '\0';
+        wifi.addListener(onState, this);
+    }
+
+    static void onState(void* context, State state, const char* ssid) {
+        Radio* r = (Radio*)context;
+        if (r->eventCount < MAX_EVENTS) r->events[r->eventCount++] = { r->nowMs, state };
+        snprintf(r->lastSsid, sizeof(r->lastSsid), "%s", ssid);
+    }
+
+    void step(uint32_t ms = TICK_MS) {
+        ap.advance(ms);
+        nowMs += ms;
+        wifi.service(nowMs);
+    }
+
+    // Steps until the connection reaches state; returns the time it took, or UINT32_MAX.
+    uint32_t runUntil(State state, uint32_t limitMs) {
+        uint32_t start = nowMs;
+        while (nowMs - start < limitMs) {
+            step();
+            if (wifi.state() == state) return nowMs - start;
+        }
+        return UINT32_MAX;
+    }
+
+    // The nth time the connection entered state, or UINT32_MAX.
+    uint32_t entered(State state, size_t nth) const {
+        for (size_t i = 0; i < eventCount; i++) {
+            if (events[i].state == state && nth-- == 0) return events[i].atMs;
+        }
+        return UINT32_MAX;
+    }
+};
+
+void setUp() {}
+void tearDown() {}
+
+void test_connects_when_ap_answers() {
+    Radio r;
+    TEST_ASSERT_EQUAL(WifiConnection::STATE_DISABLED, r.wifi.state());
+    r.wifi.configure("PhotonIQ-Lab", "photoniq", true);
+    r.step();
+    TEST_ASSERT_EQUAL(WifiConnection::STATE_CONNECTING, r.wifi.state());
+    TEST_ASSERT_EQUAL_STRING("PhotonIQ-Lab", r.wifi.currentSsid());
+    TEST_ASSERT_LESS_OR_EQUAL(1000, r.runUntil(WifiConnection::STATE_CONNECTED, 5000));
+    TEST_ASSERT_EQUAL_UINT32(1, r.wifi.getStats().attempts);
+    TEST_ASSERT_EQUAL_UINT32(1, r.wifi.getStats().connects);
+    TEST_ASSERT_EQUAL_UINT32(0, r.wifi.getStats().failures);
+    TEST_ASSERT_EQUAL(2, r.eventCount);
+}
+
+void test_silent_ap_times_out() {
+    Radio r;
+    r.ap.setSilent(true);
+    r.wifi.configure("PhotonIQ-Lab", "photoniq", true);
+    r.step();
+    uint32_t started = r.nowMs;
+    TEST_ASSERT_NOT_EQUAL(UINT32_MAX, r.runUntil(WifiConnection::STATE_BACKOFF, 60000));
+    // The attempt ends on the first service() at or after the timeout, not before.
+    TEST_ASSERT_EQUAL_UINT32(15000, r.nowMs - started);
+    TEST_ASSERT_EQUAL_UINT32(1, r.wifi.getStats().failures);
+}
+
+void test_custom_timeout_is_honoured() {
+    Radio r;
+    r.ap.setSilent(true);
+    WifiConnection::Config config = { 3000, 1000, 8000 };
+    r.wifi.setConfig(config);
+    r.wifi.configure("PhotonIQ-Lab", "photoniq", true);
+    r.step();
+    uint32_t started = r.nowMs;
+    r.runUntil(WifiConnection::STATE_BACKOFF, 60000);
+    TEST_ASSERT_EQUAL_UINT32(3000, r.nowMs - started);
+}
+
+void test_backoff_doubles_up_to_cap() {
+    Radio r;
+    r.ap.setSilent(true);
+    r.wifi.configure("PhotonIQ-Lab", "photoniq", true);
+    for (int i = 0; i < 2000; i++) r.step(1000);
+
+    // Each wait is the time from a failure to the next attempt.
+    const uint32_t expected[] = { 2000, 4000, 8000, 16000, 32000, 64000, 120000, 120000 };
+    for (size_t i = 0; i < sizeof(expected) / sizeof(expected[0]); i++) {
+        uint32_t failedAt = r.entered(WifiConnection::STATE_BACKOFF, i);
+        uint32_t retriedAt = r.entered(WifiConnection::STATE_CONNECTING, i + 1);
+        TEST_ASSERT_NOT_EQUAL(UINT32_MAX, retriedAt);
+        TEST_ASSERT_EQUAL_UINT32(expected[i], retriedAt - failedAt);
+        TEST_ASSERT_EQUAL_UINT32(15000, failedAt - r.entered(WifiConnection::STATE_CONNECTING, i));
+    }
+    TEST_ASSERT_EQUAL_UINT32(120000, r.wifi.currentBackoffMs());
+    TEST_ASSERT_EQUAL_UINT32(r.wifi.getStats().attempts, r.ap.beginCount());
+}
+
+void test_refusals_end_attempt_before_timeout() {
+    Radio r;
+    r.wifi.configure("PhotonIQ-Lab", "wrong", true);
+    r.step();
+    TEST_ASSERT_LESS_OR_EQUAL(1000, r.runUntil(WifiConnection::STATE_BACKOFF, 60000));
+
+    r.ap.setInRange(false);
+    r.wifi.configure("PhotonIQ-Lab", "photoniq", true);
+    r.step();
+    TEST_ASSERT_EQUAL(WifiConnection::STATE_CONNECTING, r.wifi.state());
+    TEST_ASSERT_LESS_OR_EQUAL(1000, r.runUntil(WifiConnection::STATE_BACKOFF, 60000));
+    TEST_ASSERT_EQUAL_UINT32(2, r.wifi.getStats().failures);
+    TEST_ASSERT_EQUAL_UINT32(0, r.wifi.getStats().connects);
+}
+
+void test_success_resets_backoff() {
+    Radio r;
+    r.ap.setInRange(false);
+    r.wifi.configure("PhotonIQ-Lab", "photoniq", true);
+    for (int i = 0; i < 60; i++) r.step(1000);
+    TEST_ASSERT_GREATER_THAN_UINT32(4000, r.wifi.currentBackoffMs());
+
+    r.ap.setInRange(true);
+    TEST_ASSERT_NOT_EQUAL(UINT32_MAX, r.runUntil(WifiConnection::STATE_CONNECTED, 120000));
+    TEST_ASSERT_EQUAL_UINT32(2000, r.wifi.currentBackoffMs());
+}
+
+void test_dropped_link_retries_at_once_then_backs_off() {
+    Radio r;
+    r.wifi.configure("PhotonIQ-Lab", "photoniq", true);
+    r.runUntil(WifiConnection::STATE_CONNECTED, 5000);
+
+    // A blip: the immediate retry gets the link back without waiting out any backoff.
+    r.ap.dropLink();
+    r.step();
+    TEST_ASSERT_EQUAL(WifiConnection::STATE_CONNECTING, r.wifi.state());
+    TEST_ASSERT_LESS_OR_EQUAL(1000, r.runUntil(WifiConnection::STATE_CONNECTED, 5000));
+    TEST_ASSERT_EQUAL_UINT32(1, r.wifi.getStats().drops);
+
+    // The AP going away: the immediate retry fails and the usual backoff follows.
+    r.ap.setInRange(false);
+    r.step();
+    TEST_ASSERT_EQUAL(WifiConnection::STATE_CONNECTING, r.wifi.state());
+    r.runUntil(WifiConnection::STATE_BACKOFF, 60000);
+    uint32_t failedAt = r.nowMs;
+    r.runUntil(WifiConnection::STATE_CONNECTING, 60000);
+    TEST_ASSERT_EQUAL_UINT32(2000, r.nowMs - failedAt);
+    TEST_ASSERT_EQUAL_UINT32(2, r.wifi.getStats().drops);
+}
+
+void test_retry_now_skips_backoff() {
+    Radio r;
+    r.ap.setInRange(false);
+    r.wifi.configure("PhotonIQ-Lab", "photoniq", true);
+    for (int i = 0; i < 120; i++) r.step(1000);
+    TEST_ASSERT_EQUAL(WifiConnection::STATE_BACKOFF, r.wifi.state());
+
+    r.ap.setInRange(true);
+    r.wifi.retryNow();
+    r.step();
+    TEST_ASSERT_EQUAL(WifiConnection::STATE_CONNECTING, r.wifi.state());
+    TEST_ASSERT_LESS_OR_EQUAL(1000, r.runUntil(WifiConnection::STATE_CONNECTED, 5000));
+}
+
+void test_configure_changes() {
+    Radio r;
+    r.wifi.configure("PhotonIQ-Lab", "photoniq", true);
+    r.runUntil(WifiConnection::STATE_CONNECTED, 5000);
+
+    // The same network again does not disturb the link.
+    r.wifi.configure("PhotonIQ-Lab", "photoniq", true);
+    r.step();
+    TEST_ASSERT_EQUAL(WifiConnection::STATE_CONNECTED, r.wifi.state());
+    TEST_ASSERT_EQUAL_UINT32(1, r.ap.beginCount());
+
+    r.wifi.configure("PhotonIQ-Lab", "photoniq", false);
+    r.step();
+    TEST_ASSERT_EQUAL(WifiConnection::STATE_DISABLED, r.wifi.state());
+    TEST_ASSERT_EQUAL(WifiDriver::LINK_DOWN, r.ap.status());
+    TEST_ASSERT_EQUAL_STRING("", r.lastSsid);
+    for (int i = 0; i < 100; i++) r.step(1000);
+    TEST_ASSERT_EQUAL_UINT32(1, r.ap.beginCount());
+
+    r.wifi.configure("", "", true);
+    r.step();
+    TEST_ASSERT_EQUAL(WifiConnection::STATE_IDLE, r.wifi.state());
+    TEST_ASSERT_EQUAL_STRING("", r.wifi.currentSsid());
+
+    TEST_ASSERT_EQUAL(WifiConnection::STATE_IDLE, r.events[r.eventCount - 1].state);
+    TEST_ASSERT_EQUAL_STRING("", r.lastSsid);
+}
+
+void test_configure_from_another_thread() {
+    Radio r;
+    std::atomic<bool> done(false);
+    // The NimBLE host task writing credentials while loop() services the connection.
+    std::thread host([&] {
+        for (int i = 0; i < 5000; i++) {
+            if (i % 2) r.wifi.configure("PhotonIQ-Lab", "photoniq", true);
+            else r.wifi.configure("Neighbour-5G", "0123456789abcdef", true);
+        }
+        r.wifi.configure("PhotonIQ-Lab", "photoniq", true);
+        done = true;
+    });
+    while (!done) {
+        r.step(10);
+        const char* ssid = r.wifi.currentSsid();
+        TEST_ASSERT_TRUE(strcmp(ssid, "PhotonIQ-Lab") == 0 || strcmp(ssid, "Neighbour-5G") == 0 ||
+                         ssid[0] == '\0');
+    }
+    host.join();
+    TEST_ASSERT_NOT_EQUAL(UINT32_MAX, r.runUntil(WifiConnection::STATE_CONNECTED, 10000));
+    TEST_ASSERT_EQUAL_STRING("PhotonIQ-Lab", r.wifi.currentSsid());
+}
+
+int main(int argc, char** argv) {
+    UNITY_BEGIN();
+    RUN_TEST(test_connects_when_ap_answers);
+    RUN_TEST(test_silent_ap_times_out);
+    RUN_TEST(test_custom_timeout_is_honoured);
+    RUN_TEST(test_backoff_doubles_up_to_cap);
+    RUN_TEST(test_refusals_end_attempt_before_timeout);
+    RUN_TEST(test_success_resets_backoff);
+    RUN_TEST(test_dropped_link_retries_at_once_then_backs_off);
+    RUN_TEST(test_retry_now_skips_backoff);
+    RUN_TEST(test_configure_changes);
+    RUN_TEST(test_configure_from_another_thread);
+    return UNITY_END();
+}
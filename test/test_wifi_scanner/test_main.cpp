@@ -0,0 +1,331 @@
+// WifiScanner against SimulatedAccessPoint: results are one entry per SSID sorted by RSSI, the
+// cache answers repeat requests within its TTL, and the chunked encoding reassembles to the same
+// list at any notification size with no record split across chunks.
+
+#include <unity.h>
+#include <atomic>
+#include <stdio.h>
+#include <thread>
+#include "../../hal/native/SimulatedAccessPoint.h"
+#include "../../src/WifiScanner.h"
+
+static const uint32_t TICK_MS = 100;                         // the firmware's scanner task period
+
+// A scanner over a simulated AP, on a simulated clock, counting what its listener hears.
+struct Radio {
+    SimulatedAccessPoint ap;
+    WifiScanner scanner;
+    uint32_t nowMs;
+    uint32_t deliveries;
+    bool lastOk;
+
+    Radio() : ap("PhotonIQ-Lab", "photoniq"), scanner(ap), nowMs(1000), deliveries(0), lastOk(false) {
+        scanner.addListener(onResults, this);
+    }
+
+    static void onResults(void* context, bool ok) {
+        Radio* r = (Radio*)context;
+        r->deliveries++;
+        r->lastOk = ok;
+    }
+
+    void step(uint32_t ms = TICK_MS) {
+        ap.advance(ms);
+        nowMs += ms;
+        scanner.service(nowMs);
+    }
+
+    // Steps until the listener has heard one more delivery; false if that takes over limitMs.
+    bool runUntilDelivered(uint32_t limitMs = 30000) {
+        uint32_t before = deliveries, start = nowMs;
+        while (deliveries == before) {
+            if (nowMs - start >= limitMs) return false;
+            step();
+        }
+        return true;
+    }
+};
+
+// A list put back together from chunks, checking each chunk on the way.
+struct Reassembled {
+    WifiDriver::ScanEntry entries[WifiScanner::MAX_RESULTS];
+    size_t count;
+    size_t chunks;
+    uint8_t flags;   // of the last chunk
+
+    // Streams the scanner's list in chunks of at most maxLen bytes, as the BLE service does.
+    void stream(const WifiScanner& scanner, size_t maxLen) {
+        count = chunks = 0;
+        size_t cursor = 0;
+        uint8_t chunk[512 + 1];
+        for (;;) {
+            memset(chunk, 0xEE, sizeof(chunk));
+            size_t len = scanner.encodeChunk(cursor, (uint8_t)chunks, chunk, maxLen);
+            TEST_ASSERT_GREATER_OR_EQUAL(WifiScanner::CHUNK_HEADER, len);
+            TEST_ASSERT_LESS_OR_EQUAL(maxLen, len);
+            TEST_ASSERT_EQUAL_UINT8(0xEE, chunk[len]);     // nothing written past the returned length
+            TEST_ASSERT_EQUAL_UINT8(scanner.generation(), chunk[0]);
+            TEST_ASSERT_EQUAL_UINT8((uint8_t)chunks, chunk[1]);
+            flags = chunk[2];
+            parse(chunk, len);
+            chunks++;
+            if (flags & WifiScanner::CHUNK_LAST) break;
+            TEST_ASSERT_TRUE(chunks < 64);
+        }
+    }
+
+    // Records must fill the chunk exactly: a record cut short would leave bytes over or run out.
+    void parse(const uint8_t* chunk, size_t len) {
+        size_t n = WifiScanner::CHUNK_HEADER;
+        for (uint8_t r = 0; r < chunk[3]; r++) {
+            TEST_ASSERT_TRUE(n < len);
+            size_t ssidLen = chunk[n++];
+            TEST_ASSERT_TRUE(n + ssidLen + 3 <= len);
+            TEST_ASSERT_TRUE(count < WifiScanner::MAX_RESULTS);
+            WifiDriver::ScanEntry& e = entries[count++];
+            memcpy(e.ssid, chunk + n, ssidLen);
+            e.ssid[ssidLen] = '\0';
+            n += ssidLen;
+            e.rssi = (int8_t)chunk[n++];
+            e.channel = chunk[n++];
+            e.auth = chunk[n++];
+        }
+        TEST_ASSERT_EQUAL(len, n);
+    }
+};
+
+static void assertSameList(const WifiScanner& scanner, const Reassembled& list) {
+    TEST_ASSERT_EQUAL(scanner.count(), list.count);
+    for (size_t i = 0; i < list.count; i++) {
+        TEST_ASSERT_EQUAL_STRING(scanner.entry(i).ssid, list.entries[i].ssid);
+        TEST_ASSERT_EQUAL_INT8(scanner.entry(i).rssi, list.entries[i].rssi);
+        TEST_ASSERT_EQUAL_UINT8(scanner.entry(i).channel, list.entries[i].channel);
+        TEST_ASSERT_EQUAL_UINT8(scanner.entry(i).auth, list.entries[i].auth);
+    }
+}
+
+// A crowded band: many networks with names up to the 32-byte limit.
+static void addNeighbours(SimulatedAccessPoint& ap, int count) {
+    for (int i = 0; i < count; i++) {
+        char name[40];
+        snprintf(name, sizeof(name), "Neighbour-%02d-%.*s", i, i % 20, "abcdefghijklmnopqrstuvwxyz");
+        ap.addNeighbour(name, (int8_t)(-40 - (i * 37) % 55), (uint8_t)(1 + i % 13), WifiDriver::AUTH_WPA2_PSK);
+    }
+}
+
+void setUp() {}
+void tearDown() {}
+
+void test_scan_collects_sorted_unique_results() {
+    Radio r;
+    r.ap.addNeighbour("Office", -70, 1, WifiDriver::AUTH_WPA2_PSK);
+    r.ap.addNeighbour("", -30, 11, WifiDriver::AUTH_OPEN);                // hidden
+    r.ap.addNeighbour("Office", -48, 6, WifiDriver::AUTH_WPA2_PSK);       // the same SSID, nearer
+    r.ap.addNeighbour("Cafe guest", -81, 3, WifiDriver::AUTH_OPEN);
+    r.ap.addNeighbour("Office", -90, 11, WifiDriver::AUTH_WPA2_PSK);
+
+    TEST_ASSERT_EQUAL(WifiScanner::REQUEST_STARTED, r.scanner.request(r.nowMs));
+    r.step();
+    TEST_ASSERT_TRUE(r.scanner.scanInProgress());
+    TEST_ASSERT_EQUAL_UINT32(1, r.ap.scanStartCount());
+    TEST_ASSERT_TRUE(r.runUntilDelivered());
+    TEST_ASSERT_TRUE(r.lastOk);
+    TEST_ASSERT_FALSE(r.scanner.scanInProgress());
+
+    TEST_ASSERT_EQUAL(3, r.scanner.count());
+    TEST_ASSERT_EQUAL_STRING("Office", r.scanner.entry(0).ssid);
+    TEST_ASSERT_EQUAL_INT8(-48, r.scanner.entry(0).rssi);
+    TEST_ASSERT_EQUAL_UINT8(6, r.scanner.entry(0).channel);
+    TEST_ASSERT_EQUAL_STRING("PhotonIQ-Lab", r.scanner.entry(1).ssid);
+    TEST_ASSERT_EQUAL_STRING("Cafe guest", r.scanner.entry(2).ssid);
+    TEST_ASSERT_EQUAL_UINT32(2000, r.scanner.getStats().lastScanMs);
+}
+
+void test_keeps_strongest_when_full() {
+    Radio r;
+    addNeighbours(r.ap, 60);
+    r.scanner.request(r.nowMs);
+    TEST_ASSERT_TRUE(r.runUntilDelivered());
+    TEST_ASSERT_EQUAL(WifiScanner::MAX_RESULTS, r.scanner.count());
+
+    // Everything kept is at least as strong as everything dropped: whatever is stronger than the
+    // weakest entry kept must all have made the list.
+    int8_t weakestKept = r.scanner.entry(WifiScanner::MAX_RESULTS - 1).rssi;
+    size_t stronger = -55 > weakestKept ? 1 : 0;                            // the AP itself
+    for (int i = 0; i < 60; i++) {
+        if (-40 - (i * 37) % 55 > weakestKept) stronger++;
+    }
+    TEST_ASSERT_LESS_THAN(WifiScanner::MAX_RESULTS, stronger);
+    for (size_t i = 1; i < r.scanner.count(); i++) {
+        TEST_ASSERT_TRUE(r.scanner.entry(i - 1).rssi >= r.scanner.entry(i).rssi);
+    }
+}
+
+void test_chunks_reassemble_at_every_size() {
+    Radio r;
+    addNeighbours(r.ap, 40);
+    r.scanner.request(r.nowMs);
+    TEST_ASSERT_TRUE(r.runUntilDelivered());
+
+    // From the smallest chunk that holds a full-length record up to a 512-byte attribute.
+    Reassembled list;
+    for (size_t maxLen = WifiScanner::CHUNK_HEADER + WifiScanner::MAX_RECORD_SIZE; maxLen <= 512; maxLen++) {
+        list.stream(r.scanner, maxLen);
+        assertSameList(r.scanner, list);
+        TEST_ASSERT_EQUAL_HEX8(WifiScanner::CHUNK_LAST, list.flags);
+    }
+
+    // A default-MTU notification (20 bytes) is too small for the longest names, so streaming
+    // stops there rather than emitting a split record.
+    size_t cursor = 0;
+    uint8_t chunk[20];
+    size_t chunks = 0;
+    while (size_t len = r.scanner.encodeChunk(cursor, (uint8_t)chunks, chunk, sizeof(chunk))) {
+        TEST_ASSERT_LESS_OR_EQUAL(sizeof(chunk), len);
+        if (chunk[2] & WifiScanner::CHUNK_LAST) break;
+        chunks++;
+    }
+    TEST_ASSERT_TRUE(cursor < r.scanner.count());
+    TEST_ASSERT_GREATER_THAN(20 - WifiScanner::CHUNK_HEADER - 4, strlen(r.scanner.entry(cursor).ssid));
+}
+
+void test_chunk_too_small_for_header() {
+    Radio r;
+    r.scanner.request(r.nowMs);
+    TEST_ASSERT_TRUE(r.runUntilDelivered());
+    size_t cursor = 0;
+    uint8_t chunk[8];
+    TEST_ASSERT_EQUAL(0, r.scanner.encodeChunk(cursor, 0, chunk, WifiScanner::CHUNK_HEADER - 1));
+    TEST_ASSERT_EQUAL(0, r.scanner.encodeChunk(cursor, 0, chunk, sizeof(chunk)));
+    TEST_ASSERT_EQUAL(0, cursor);
+}
+
+void test_empty_and_failed_scans_are_one_chunk() {
+    Radio r;
+    r.ap.setInRange(false);
+    r.scanner.request(r.nowMs);
+    TEST_ASSERT_TRUE(r.runUntilDelivered());
+    TEST_ASSERT_TRUE(r.lastOk);
+    Reassembled list;
+    list.stream(r.scanner, 20);
+    TEST_ASSERT_EQUAL(1, list.chunks);
+    TEST_ASSERT_EQUAL(0, list.count);
+    TEST_ASSERT_EQUAL_HEX8(WifiScanner::CHUNK_LAST, list.flags);
+
+    r.ap.setInRange(true);
+    r.ap.setScanFails(true);
+    r.nowMs += WifiScanner::DEFAULT_TTL_MS;
+    TEST_ASSERT_EQUAL(WifiScanner::REQUEST_STARTED, r.scanner.request(r.nowMs));
+    TEST_ASSERT_TRUE(r.runUntilDelivered());
+    TEST_ASSERT_FALSE(r.lastOk);
+    list.stream(r.scanner, 20);
+    TEST_ASSERT_EQUAL(1, list.chunks);
+    TEST_ASSERT_EQUAL(0, list.count);
+    TEST_ASSERT_EQUAL_HEX8(WifiScanner::CHUNK_LAST | WifiScanner::CHUNK_FAILED, list.flags);
+    TEST_ASSERT_EQUAL_UINT32(1, r.scanner.getStats().failures);
+}
+
+void test_cache_answers_within_ttl() {
+    Radio r;
+    r.scanner.request(r.nowMs);
+    TEST_ASSERT_TRUE(r.runUntilDelivered());
+    uint8_t generation = r.scanner.generation();
+
+    // Within the TTL: delivered from the cache on the next service(), the radio left alone.
+    r.step(WifiScanner::DEFAULT_TTL_MS - 1000);
+    TEST_ASSERT_EQUAL(WifiScanner::REQUEST_CACHED, r.scanner.request(r.nowMs));
+    r.step();
+    TEST_ASSERT_EQUAL_UINT32(2, r.deliveries);
+    TEST_ASSERT_EQUAL_UINT32(1, r.ap.scanStartCount());
+    TEST_ASSERT_EQUAL_UINT8(generation, r.scanner.generation());
+    TEST_ASSERT_EQUAL_UINT32(1, r.scanner.getStats().cacheHits);
+
+    // Past it: a new scan and a new generation.
+    r.step(1000);
+    TEST_ASSERT_EQUAL(WifiScanner::REQUEST_STARTED, r.scanner.request(r.nowMs));
+    TEST_ASSERT_TRUE(r.runUntilDelivered());
+    TEST_ASSERT_EQUAL_UINT32(2, r.ap.scanStartCount());
+    TEST_ASSERT_EQUAL_UINT8((uint8_t)(generation + 1), r.scanner.generation());
+}
+
+void test_requests_during_scan_share_it() {
+    Radio r;
+    TEST_ASSERT_EQUAL(WifiScanner::REQUEST_STARTED, r.scanner.request(r.nowMs));
+    TEST_ASSERT_EQUAL(WifiScanner::REQUEST_PENDING, r.scanner.request(r.nowMs));
+    r.step();
+    TEST_ASSERT_EQUAL(WifiScanner::REQUEST_PENDING, r.scanner.request(r.nowMs));
+    TEST_ASSERT_TRUE(r.runUntilDelivered());
+    TEST_ASSERT_EQUAL_UINT32(1, r.deliveries);
+    TEST_ASSERT_EQUAL_UINT32(1, r.ap.scanStartCount());
+    TEST_ASSERT_EQUAL_UINT32(3, r.scanner.getStats().requests);
+}
+
+void test_stuck_scan_times_out() {
+    Radio r;
+    r.ap.setScanMs(60000);
+    r.scanner.request(r.nowMs);
+    r.step();
+    uint32_t started = r.nowMs;
+    TEST_ASSERT_TRUE(r.runUntilDelivered());
+    TEST_ASSERT_FALSE(r.lastOk);
+    TEST_ASSERT_EQUAL_UINT32(WifiScanner::SCAN_TIMEOUT_MS, r.nowMs - started);
+    TEST_ASSERT_EQUAL_UINT32(1, r.scanner.getStats().failures);
+
+    // A later request starts over.
+    TEST_ASSERT_EQUAL(WifiScanner::REQUEST_STARTED, r.scanner.request(r.nowMs));
+}
+
+void test_ssid_list_truncates_at_whole_names() {
+    Radio r;
+    r.ap.addNeighbour("Office", -48, 6, WifiDriver::AUTH_WPA2_PSK);
+    r.ap.addNeighbour("Cafe guest", -81, 3, WifiDriver::AUTH_OPEN);
+    r.scanner.request(r.nowMs);
+    TEST_ASSERT_TRUE(r.runUntilDelivered());
+
+    char text[64];
+    TEST_ASSERT_EQUAL(32, r.scanner.formatSsidList(text, sizeof(text)));
+    TEST_ASSERT_EQUAL_STRING("Office, PhotonIQ-Lab, Cafe guest", text);
+    TEST_ASSERT_EQUAL(20, r.scanner.formatSsidList(text, 32));
+    TEST_ASSERT_EQUAL_STRING("Office, PhotonIQ-Lab", text);
+    TEST_ASSERT_EQUAL(0, r.scanner.formatSsidList(text, 6));
+    TEST_ASSERT_EQUAL_STRING("", text);
+}
+
+void test_requests_from_another_thread() {
+    Radio r;
+    std::atomic<bool> done(false);
+    std::atomic<uint32_t> now(r.nowMs);
+    // The NimBLE host task asking for scans while loop() services the scanner.
+    std::thread host([&] {
+        for (int i = 0; i < 2000; i++) r.scanner.request(now);
+        done = true;
+    });
+    while (!done) {
+        r.step(10);
+        now = r.nowMs;
+    }
+    host.join();
+    for (int i = 0; i < 200; i++) r.step();
+    TEST_ASSERT_FALSE(r.scanner.scanInProgress());
+
+    // Every scan started was collected and every request was either served or shared.
+    const WifiScanner::Stats& stats = r.scanner.getStats();
+    TEST_ASSERT_EQUAL_UINT32(2000, stats.requests);
+    TEST_ASSERT_EQUAL_UINT32(r.ap.scanStartCount(), stats.scans + stats.failures);
+    TEST_ASSERT_EQUAL(1, r.scanner.count());
+}
+
+int main(int argc, char** argv) {
+    UNITY_BEGIN();
+    RUN_TEST(test_scan_collects_sorted_unique_results);
+    RUN_TEST(test_keeps_strongest_when_full);
+    RUN_TEST(test_chunks_reassemble_at_every_size);
+    RUN_TEST(test_chunk_too_small_for_header);
+    RUN_TEST(test_empty_and_failed_scans_are_one_chunk);
+    RUN_TEST(test_cache_answers_within_ttl);
+    RUN_TEST(test_requests_during_scan_share_it);
+    RUN_TEST(test_stuck_scan_times_out);
+    RUN_TEST(test_ssid_list_truncates_at_whole_names);
+    RUN_TEST(test_requests_from_another_thread);
+    return UNITY_END();
+}
@@ -0,0 +1,145 @@
+#!/usr/bin/env python3
+"""Writes the light trace the benches replay (bench/fixtures/lux_trace.csv).
+
+Twelve minutes of TSL2591 conversions as the firmware would take them: a modelled scene is read
+through the sensor's count model at the setting AutoRange (src/AutoRange.h, ported below) picks
+after each reading, one row per conversion. The scene covers what the statistics and the codec
+have to cope with: a steady LED lamp with people walking past, blinds opening, daylight under
+passing clouds with a spell of direct sun that saturates the sensor, then a dark room.
+
+    tools/make_lux_trace.py [--out FILE] [--seed N]
+
+Rows are "ms,full,ir,control": milliseconds from the start of the trace, CH0 and CH1 counts and
+the CONTROL register (gain << 4 | integration time). Lux and flags are left out on purpose;
+readers derive them from the counts like LightSensor::fill() does. The output is
+deterministic for a given seed, so regenerating it only changes the file if the model changes.
+
+choose() below is a copy of AutoRange's rules, so the bench replays every row's counts through
+the real AutoRange (checkLightTraceRanging() in bench/TraceFixture.h) and refuses a trace whose
+control column it would not have produced. Change both together.
+"""
+
+import argparse
+import math
+import os
+import random
+
+GAINS = [1, 25, 428, 9876]
+TIMES = [100, 200, 300, 400, 500, 600]
+LUX_DF = 408
+TARGET_COUNTS = 1000
+HIGH_WATER_PERCENT = 80
+HYSTERESIS = 2
+DURATION_MS = 12 * 60 * 1000
+
+
+def max_count(time):
+    return 37888 if time == 0 else 65535
+
+
+def high_water(time):
+    return max_count(time) * HIGH_WATER_PERCENT // 100
+
+
+def sensitivity(s):
+    return GAINS[s[0]] * TIMES[s[1]]
+
+
+def choose(current, full, ir):
+    """AutoRange::choose(); bench/TraceFixture.h checks the trace against the real one."""
+    g, t = current
+    if full >= max_count(t) or ir >= max_count(t):
+        if t > 0:
+            return (g, 0)
+        return (g - 1, 0) if g > 0 else current
+    rate = (max(full, 1) << 16) // sensitivity(current)
+
+    def predict(s):
+        return (rate * sensitivity(s)) >> 16
+
+    best, found = (len(GAINS) - 1, len(TIMES) - 1), False
+    for tt in range(len(TIMES)):
+        for gg in range(len(GAINS)):
+            if TARGET_COUNTS <= predict((gg, tt)) <= high_water(tt):
+                best, found = (gg, tt), True
+                break
+        if found:
+            break
+    if not found:
+        best = (0, 0)
+        for tt in range(len(TIMES)):
+            for gg in range(len(GAINS)):
+                if predict((gg, tt)) <= high_water(tt) and sensitivity((gg, tt)) > sensitivity(best):
+                    best = (gg, tt)
+    in_band = TARGET_COUNTS // HYSTERESIS <= full <= high_water(t)
+    if in_band:
+        faster = found and best[1] < t and predict(best) >= TARGET_COUNTS * HYSTERESIS
+        if not faster:
+            return current
+    return best
+
+
+class Scene:
+    """Lux and IR fraction of the light reaching the sensor at a given time."""
+
+    def __init__(self, rng):
+        self.rng = rng
+        # Walk-bys in the lamp-lit part: (start ms, duration ms, depth).
+        self.shadows = [(rng.uniform(10e3, 170e3), rng.uniform(800, 2500), rng.uniform(0.3, 0.7)) for _ in range(5)]
+        # Cloud cover: a transmission value every 5 s, smoothed between them.
+        self.clouds = [min(1.0, max(0.2, 0.75 + 0.35 * math.sin(i / 3.0) + rng.gauss(0, 0.12))) for i in range(200)]
+
+    def at(self, ms):
+        if ms < 180e3:                                   # LED lamp, almost no IR
+            lux, ir = 320.0, 0.04
+            for start, length, depth in self.shadows:
+                if start <= ms < start + length:
+                    lux *= 1.0 - depth * math.sin(math.pi * (ms - start) / length)
+        elif ms < 186e3:                                 # blinds opening
+            k = (ms - 180e3) / 6e3
+            lux, ir = 320.0 + k * 14000.0, 0.04 + k * 0.24
+        elif ms < 600e3:                                 # daylight, clouds, then direct sun
+            i = (ms - 186e3) / 5e3
+            a, b = self.clouds[int(i)], self.clouds[int(i) + 1]
+            lux, ir = 18000.0 * (a + (b - a) * (i - int(i))), 0.28
+            if 420e3 <= ms < 470e3:
+                lux *= 5.5                               # sun out of the clouds: saturates at LOW/100 ms
+        else:                                            # lights out, a little daylight around the blinds
+            lux, ir = 2.5 + 0.5 * math.sin(ms / 20e3), 0.35
+        return lux, ir
+
+
+def main():
+    default_out = os.path.join(os.path.dirname(os.path.abspath(__file__)), "..", "bench", "fixtures", "lux_trace.csv")
+    parser = argparse.ArgumentParser(description="Write the benches' light trace.")
+    parser.add_argument("--out", default=default_out)
+    parser.add_argument("--seed", type=int, default=2591)
+    opts = parser.parse_args()
+
+    rng = random.Random(opts.seed)
+    scene = Scene(rng)
+    setting = (1, 0)                                     # AutoRange's power-up setting
+    ms, rows = 0, []
+    while ms < DURATION_MS:
+        g, t = setting
+        ms += TIMES[t]
+        lux, ir_fraction = scene.at(ms)
+        # Inverse of the lux model for CH0, then shot noise on both channels.
+        expected = lux * TIMES[t] * GAINS[g] / (LUX_DF * (1.0 - ir_fraction) ** 2)
+        full = int(round(expected + rng.gauss(0, math.sqrt(expected) + 0.5)))
+        ir = int(round(expected * ir_fraction + rng.gauss(0, math.sqrt(expected * ir_fraction) + 0.5)))
+        ceiling = max_count(t)
+        full, ir = min(max(full, 0), ceiling), min(max(ir, 0), ceiling)
+        rows.append("%d,%d,%d,%d" % (ms, full, ir, g << 4 | t))
+        setting = choose(setting, full, ir)
+
+    os.makedirs(os.path.dirname(os.path.abspath(opts.out)), exist_ok=True)
+    with open(opts.out, "w", newline="\n") as f:
+        f.write("# PhotonIQ light trace, tools/make_lux_trace.py --seed %d\n" % opts.seed)
+        f.write("# ms,full,ir,control\n")
+        f.write("\n".join(rows) + "\n")
+    print("%s: %d conversions" % (os.path.normpath(opts.out), len(rows)))
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,157 @@
+#!/usr/bin/env python3
+"""Decodes a PhotonIQ trace dump (src/TraceLog.h) into text.
+
+The firmware stores only a hash of each format string; this tool recovers the formats by hashing
+the TRACE_x() call sites in the sources, so decode with the sources the firmware was built from.
+
+    curl http://<device>/trace > trace.bin
+    tools/trace_decode.py trace.bin [--src DIR ...]
+
+The native build writes the same dump with --trace FILE.
+"""
+
+import argparse
+import os
+import re
+import struct
+import sys
+
+LEVELS = "DIWE"
+CALL = re.compile(r'\bTRACE_(?:DEBUG|INFO|WARN|ERROR)\s*\(\s*((?:"(?:[^"\\]|\\.)*"\s*)+)')
+LITERAL = re.compile(r'"((?:[^"\\]|\\.)*)"')
+SPEC = re.compile(r'%([-+ #0-9.]*)[hlLqjzt]*([a-zA-Z%])')
+ESCAPES = {"n": "\n", "r": "\r", "t": "\t", "\\": "\\", '"': '"', "'": "'", "0": "\0", "a": "\a", "b": "\b"}
+
+HEADER = struct.Struct("<4sBBHII")
+RECORD = struct.Struct("<IIIBB")
+
+
+def fnv1a(data):
+    h = 2166136261
+    for b in data:
+        h = ((h ^ b) * 16777619) & 0xFFFFFFFF
+    return h
+
+
+def unescape(literal):
+    out, i = [], 0
+    while i < len(literal):
+        c = literal[i]
+        if c == "\\" and i + 1 < len(literal):
+            e = literal[i + 1]
+            if e == "x":
+                m = re.match(r"[0-9a-fA-F]+", literal[i + 2:])
+                out.append(chr(int(m.group(0), 16)))
+                i += 2 + len(m.group(0))
+                continue
+            out.append(ESCAPES.get(e, e))
+            i += 2
+            continue
+        out.append(c)
+        i += 1
+    return "".join(out)
+
+
+def load_formats(dirs):
+    formats = {}
+    for top in dirs:
+        for root, _, files in os.walk(top):
+            for name in files:
+                if not name.endswith((".h", ".hpp", ".cpp", ".c", ".ino")):
+                    continue
+                with open(os.path.join(root, name), encoding="utf-8", errors="replace") as f:
+                    text = f.read()
+                for m in CALL.finditer(text):
+                    fmt = "".join(unescape(s) for s in LITERAL.findall(m.group(1)))
+                    formats[fnv1a(fmt.encode("utf-8"))] = fmt
+    return formats
+
+
+def parse_args(data):
+    """The stored arguments as Python values, in order; stops at the end tag or a truncated one."""
+    args, i = [], 0
+    while i < len(data):
+        tag = chr(data[i])
+        if tag in "iuf" and i + 5 <= len(data):
+            args.append(struct.unpack_from({"i": "<i", "u": "<I", "f": "<f"}[tag], data, i + 1)[0])
+            i += 5
+        elif tag in "IU" and i + 9 <= len(data):
+            args.append(struct.unpack_from("<q" if tag == "I" else "<Q", data, i + 1)[0])
+            i += 9
+        elif tag == "s" and i + 1 < len(data) and i + 2 + data[i + 1] <= len(data):
+            n = data[i + 1]
+            args.append(data[i + 2:i + 2 + n].decode("utf-8", errors="replace"))
+            i += 2 + n
+        else:
+            break
+    return args
+
+
+def format_message(fmt, args):
+    """TraceLog::formatMessage(): the stored type decides, length modifiers are ignored."""
+    it = iter(args)
+
+    def one(m):
+        flags, conv = m.group(1), m.group(2)
+        if conv == "%":
+            return "%"
+        value = next(it, None)
+        if value is None:
+            return "?"
+        if isinstance(value, str):
+            return ("%" + flags + "s") % value if conv == "s" else "?"
+        if conv in "fFeEgGaA":
+            return ("%" + flags + (conv if conv not in "aA" else "e")) % float(value)
+        if conv == "c":
+            return ("%" + flags + "c") % (int(value) & 0xFF)
+        if conv == "p":
+            return ("%#" + flags + "x") % (int(value) & 0xFFFFFFFFFFFFFFFF)
+        if conv in "di":
+            return ("%" + flags + "d") % int(value)
+        if conv in "uxXo":
+            return ("%" + flags + ("d" if conv == "u" else conv)) % (int(value) & 0xFFFFFFFFFFFFFFFF)
+        return "?"
+
+    return SPEC.sub(one, fmt)
+
+
+def main():
+    default_src = os.path.join(os.path.dirname(os.path.abspath(__file__)), "..", "src")
+    parser = argparse.ArgumentParser(description="Decode a PhotonIQ trace dump.")
+    parser.add_argument("dump", help="trace dump (GET /trace, or --trace in the native build)")
+    parser.add_argument("--src", action="append", help="source directory to scan for TRACE_x() formats "
+                        "(repeatable; default: the repo's src/)")
+    opts = parser.parse_args()
+
+    formats = load_formats(opts.src or [default_src])
+    with open(opts.dump, "rb") as f:
+        data = f.read()
+    if len(data) < HEADER.size:
+        sys.exit("trace_decode: %s is too short for a trace dump" % opts.dump)
+    magic, version, level, capacity, written, lost = HEADER.unpack_from(data)
+    if magic != b"PTRC" or version != 1:
+        sys.exit("trace_decode: %s is not a version 1 trace dump" % opts.dump)
+    print("# %u records written, %u lost before printing, ring of %u, level %s" %
+          (written, lost, capacity, LEVELS[level] if level < len(LEVELS) else "off"))
+
+    pos, unknown = HEADER.size, 0
+    while pos + RECORD.size <= len(data):
+        index, time_us, fmt_id, rec_level, arg_len = RECORD.unpack_from(data, pos)
+        pos += RECORD.size
+        args = parse_args(data[pos:pos + arg_len])
+        pos += arg_len
+        fmt = formats.get(fmt_id)
+        if fmt is None:
+            unknown += 1
+            message = "<format %08x> %s" % (fmt_id, " ".join(repr(a) for a in args))
+        else:
+            message = format_message(fmt, args)
+        print("[%5u.%06u] %c %s" % (time_us // 1000000, time_us % 1000000,
+                                    LEVELS[rec_level & 3], message))
+    if unknown:
+        print("# %u record(s) with a format not in the sources; were they built from another revision?" % unknown,
+              file=sys.stderr)
+
+
+if __name__ == "__main__":
+    main()